@@ -0,0 +1,46 @@
+# Branchy: branches on the bits of a xorshift random number generator, half of
+# which the branch predictor cannot predict, flushing the pipeline often.
+#
+# Part of the simulator throughput benchmarks, see run_bench.py.
+
+    .option norelax
+    .equ ITERS, 150000
+
+    .text
+    .globl _start
+_start:
+    li s0, 88172645463325252        # xorshift64 seed
+    li s1, 0                        # taken branches
+    li s2, ITERS
+
+    csrr zero, 0x800                # simulation start marker
+1:  slli t0, s0, 13
+    xor s0, s0, t0
+    srli t0, s0, 7
+    xor s0, s0, t0
+    slli t0, s0, 17
+    xor s0, s0, t0
+
+    andi t1, s0, 1                  # random
+    beqz t1, 2f
+    addi s1, s1, 1
+2:  andi t1, s0, 6                  # taken 1 in 4
+    bnez t1, 3f
+    addi s1, s1, 1
+3:  srli t1, s0, 8
+    andi t1, t1, 1                  # random
+    bnez t1, 4f
+    addi s1, s1, 1
+4:  andi t1, s2, 7                  # loop pattern
+    bnez t1, 5f
+    addi s1, s1, 1
+5:  addi s2, s2, -1
+    bnez s2, 1b
+    csrr zero, 0x801                # simulation stop marker
+
+    # Power off through HTIF
+    li t1, 0x40008000
+    li t0, 1
+    sw t0, 0(t1)
+    sw zero, 4(t1)
+6:  j 6b
@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+#
+# Deterministic parallel harts check
+#
+# MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+#
+# Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+# State University of New York at Binghamton
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+
+"""Checks that 4 harts on host threads in deterministic mode (sync_quantum 1)
+simulate the shared_counter kernel exactly like 4 harts without host threads,
+on the in-order and out-of-order cores.
+
+The committed instructions and cycles of every hart must be the same in both
+runs, and the kernel must print P in both. A run with lax synchronization
+(sync_quantum 100) is also made, where only the result of the kernel is
+checked.
+"""
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+from run_bench import BENCH_DIR, CORES, make_config
+
+KERNEL = "shared_counter"
+NUM_HARTS = 4
+MODES = [("serial", "false", 500), ("deterministic", "true", 1),
+         ("lax", "true", 100)]
+
+
+def set_harts(path, parallel_harts, sync_quantum):
+    """Makes the configuration at path run NUM_HARTS harts"""
+    with open(path) as f:
+        lines = f.readlines()
+
+    with open(path, "w") as f:
+        for line in lines:
+            key = line.strip().split(":")[0]
+            if key == "num_harts":
+                line = "\t\tnum_harts: %d,\n" % NUM_HARTS
+            elif key == "parallel_harts":
+                line = "\t\tparallel_harts: \"%s\",\n" % parallel_harts
+            elif key == "sync_quantum":
+                line = "\t\tsync_quantum: %d,\n" % sync_quantum
+            f.write(line)
+
+
+def run_kernel(args, core, parallel_harts, sync_quantum):
+    """Simulates the kernel, returns what it printed and the committed
+    instructions and cycles of every hart"""
+    out_dir = tempfile.mkdtemp(prefix="marss-parallel-")
+    try:
+        config = os.path.join(out_dir, "parallel.cfg")
+        make_config(os.path.join(args.configs, CORES[core]),
+                    os.path.join(args.kernels_dir, KERNEL + ".bin"), config)
+        set_harts(config, parallel_harts, sync_quantum)
+
+        sim_dir = os.path.dirname(os.path.abspath(args.sim))
+        env = dict(os.environ)
+        env["LD_LIBRARY_PATH"] = os.pathsep.join(
+            [sim_dir, os.path.join(sim_dir, "DRAMsim3"),
+             os.path.join(sim_dir, "ramulator"),
+             env.get("LD_LIBRARY_PATH", "")])
+
+        # The console exits on end of file, so stdin is kept open until the
+        # kernel powers off the machine
+        console_path = os.path.join(out_dir, "console.txt")
+        with open(console_path, "w") as console:
+            proc = subprocess.Popen(
+                [args.sim, "-sim-mem-model", args.mem_model, "-sim-file-path",
+                 out_dir, config], stdin=subprocess.PIPE, stdout=console,
+                stderr=subprocess.STDOUT, env=env)
+            try:
+                proc.wait(timeout=args.timeout)
+            except subprocess.TimeoutExpired:
+                proc.kill()
+                proc.wait()
+                raise RuntimeError("timed out after %d seconds" % args.timeout)
+            finally:
+                proc.stdin.close()
+
+        with open(os.path.join(out_dir, "sim.log")) as f:
+            log = f.read()
+        commits = [int(v) for v in re.findall(r"total-commits: (\d+)", log)]
+        cycles = [int(v) for v in re.findall(r"total-cycles: (\d+)", log)]
+        if len(commits) != NUM_HARTS or len(cycles) != NUM_HARTS:
+            raise RuntimeError("no stats of %d harts in the simulation log, "
+                               "exit code %d" % (NUM_HARTS, proc.returncode))
+        with open(console_path, "rb") as f:
+            result = re.findall(rb"^([PF])\r?$", f.read(), re.MULTILINE)
+        return (result[-1].decode() if result else "-", commits, cycles)
+    finally:
+        shutil.rmtree(out_dir, ignore_errors=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--sim", default="./marss-riscv",
+                        help="simulator binary (default: %(default)s)")
+    parser.add_argument("--configs",
+                        default=os.path.join(BENCH_DIR, "..", "..", "configs"),
+                        help="directory of the SoC configurations")
+    parser.add_argument("--kernels-dir", default=BENCH_DIR,
+                        help="directory of the kernel binaries")
+    parser.add_argument("--mem-model", default="base",
+                        help="memory model (default: %(default)s)")
+    parser.add_argument("--timeout", type=int, default=600,
+                        help="seconds allowed for each run")
+    args = parser.parse_args()
+
+    failures = 0
+    print("%-10s %-14s %6s  %-24s %-24s  %s"
+          % ("core", "mode", "result", "commits", "cycles", "status"))
+    for core in CORES:
+        serial = None
+        for mode, parallel_harts, sync_quantum in MODES:
+            try:
+                result, commits, cycles = run_kernel(args, core,
+                                                     parallel_harts,
+                                                     sync_quantum)
+            except (OSError, RuntimeError) as e:
+                print("%-10s %-14s  error: %s" % (core, mode, e))
+                failures += 1
+                continue
+
+            status = "ok"
+            if result != "P":
+                status = "kernel failed"
+            elif mode == "serial":
+                serial = (commits, cycles)
+            elif mode == "deterministic" and serial is None:
+                status = "no serial run to compare with"
+            elif mode == "deterministic" and serial != (commits, cycles):
+                status = "differs from serial"
+            if status != "ok":
+                failures += 1
+
+            print("%-10s %-14s %6s  %-24s %-24s  %s"
+                  % (core, mode, result, ",".join(map(str, commits)),
+                     ",".join(map(str, cycles)), status))
+            sys.stdout.flush()
+
+    if failures:
+        print("%d run(s) failed" % failures)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,46 @@
+# Floating point: double precision multiply-add chains with a divide and a
+# square root every iteration, which occupy the long latency FPU units.
+#
+# Part of the simulator throughput benchmarks, see run_bench.py.
+
+    .option norelax
+    .equ ITERS, 80000
+
+    .text
+    .globl _start
+_start:
+    li t0, 0x2000                   # mstatus.FS = initial
+    csrs mstatus, t0
+    li t0, 3
+    fcvt.d.l f0, t0                 # 3.0
+    li t0, 1
+    fcvt.d.l f1, t0                 # 1.0
+    fmv.d f2, f1
+    fmv.d f3, f1
+    fmv.d f4, f1
+    li t0, 2
+    fcvt.d.l f5, t0                 # 2.0
+    li s0, ITERS
+
+    csrr zero, 0x800                # simulation start marker
+1:  fmadd.d f2, f2, f1, f0
+    fmul.d f6, f2, f5
+    fadd.d f3, f3, f6
+    fsub.d f7, f3, f2
+    fmadd.d f4, f7, f1, f4
+    fdiv.d f2, f3, f6
+    fsqrt.d f8, f3
+    fmin.d f3, f8, f3
+    fcvt.d.l f1, s0
+    fdiv.d f1, f5, f1
+    fadd.d f1, f1, f5
+    addi s0, s0, -1
+    bnez s0, 1b
+    csrr zero, 0x801                # simulation stop marker
+
+    # Power off through HTIF
+    li t1, 0x40008000
+    li t0, 1
+    sw t0, 0(t1)
+    sw zero, 4(t1)
+2:  j 2b
@@ -0,0 +1,52 @@
+# Pointer chasing: dependent loads over a 4 MB linked list of 64 byte nodes in
+# a pseudo-random order, which misses in the caches and keeps the DRAM model
+# busy with a single outstanding request. The kernel runs in machine mode
+# without paging, so it makes no page walks and does not exercise the TLBs.
+#
+# Part of the simulator throughput benchmarks, see run_bench.py.
+
+    .option norelax
+    .equ NODES, 65536               # power of 2
+    .equ NODE_SHIFT, 6
+    .equ LCG_A, 0x4e6d              # a % 4 == 1 and c odd: full period
+    .equ LCG_C, 12345
+    .equ ITERS, 25000               # 4 loads each
+
+    .text
+    .globl _start
+_start:
+    # node[i] points to node[(LCG_A * i + LCG_C) % NODES], a single cycle
+    li s0, 0x80400000
+    li t0, 0
+    li t1, NODES
+    li t2, LCG_A
+    li t3, LCG_C
+1:  mul t4, t0, t2
+    add t4, t4, t3
+    addi t5, t1, -1
+    and t4, t4, t5
+    slli t4, t4, NODE_SHIFT
+    add t4, t4, s0
+    slli t5, t0, NODE_SHIFT
+    add t5, t5, s0
+    sd t4, 0(t5)
+    addi t0, t0, 1
+    bne t0, t1, 1b
+
+    csrr zero, 0x800                # simulation start marker
+    mv t0, s0
+    li t2, ITERS
+2:  ld t0, 0(t0)
+    ld t0, 0(t0)
+    ld t0, 0(t0)
+    ld t0, 0(t0)
+    addi t2, t2, -1
+    bnez t2, 2b
+    csrr zero, 0x801                # simulation stop marker
+
+    # Power off through HTIF
+    li t1, 0x40008000
+    li t0, 1
+    sw t0, 0(t1)
+    sw zero, 4(t1)
+3:  j 3b
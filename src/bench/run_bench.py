@@ -0,0 +1,251 @@
+#!/usr/bin/env python3
+#
+# Simulator throughput benchmarks
+#
+# MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+#
+# Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+# State University of New York at Binghamton
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+
+"""Runs the bare-metal kernels of this directory on the in-order and
+out-of-order cores with every memory model, and compares the simulation speed
+in thousands of committed instructions per host second (KIPS) against a
+baseline.
+
+Each kernel is timed between its simulation start and stop markers, so the
+setup runs in emulation mode, and the fastest of several runs is kept to
+filter out the noise of the host. The kernels are deterministic: a change in
+the committed instructions means that the baseline is stale.
+"""
+
+import argparse
+import csv
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+KERNELS = ["pointer_chase", "stream", "branchy", "fp", "syscall"]
+CORES = {"inorder": "riscv64_inorder_soc.cfg",
+         "outoforder": "riscv64_outoforder_soc.cfg"}
+MEM_MODELS = ["base", "dramsim3", "ramulator", "analytical"]
+BASELINE_FIELDS = ["kernel", "core", "mem_model", "commits", "cycles", "kips"]
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+
+
+def make_config(soc_config, kernel_bin, path):
+    """Writes a copy of soc_config booting kernel_bin with 64 MB of RAM and no
+    kernel, disk or network."""
+    with open(soc_config) as f:
+        lines = f.readlines()
+
+    with open(path, "w") as f:
+        for line in lines:
+            key = line.strip().split(":")[0]
+            if key in ("kernel", "cmdline", "drive0", "eth0"):
+                continue
+            if key == "memory_size":
+                line = "\tmemory_size: 64, /* MB */\n"
+            elif key == "bios":
+                line = "\tbios: \"%s\",\n" % kernel_bin
+            f.write(line)
+
+
+def run_kernel(args, kernel, core, mem_model):
+    """Simulates a kernel and returns its committed instructions, cycles,
+    simulation time in milliseconds and host time of the whole run in
+    seconds."""
+    out_dir = tempfile.mkdtemp(prefix="marss-bench-")
+    try:
+        config = os.path.join(out_dir, "bench.cfg")
+        make_config(os.path.join(args.configs, CORES[core]),
+                    os.path.join(args.kernels_dir, kernel + ".bin"), config)
+
+        sim_dir = os.path.dirname(os.path.abspath(args.sim))
+        env = dict(os.environ)
+        env["LD_LIBRARY_PATH"] = os.pathsep.join(
+            [sim_dir, os.path.join(sim_dir, "DRAMsim3"),
+             os.path.join(sim_dir, "ramulator"),
+             env.get("LD_LIBRARY_PATH", "")])
+
+        # The console exits on end of file, so stdin is kept open until the
+        # kernel powers off the machine
+        start = time.monotonic()
+        with open(os.path.join(out_dir, "console.txt"), "w") as console:
+            proc = subprocess.Popen(
+                [args.sim, "-sim-mem-model", mem_model, "-sim-file-path",
+                 out_dir, config], stdin=subprocess.PIPE, stdout=console,
+                stderr=subprocess.STDOUT, env=env)
+            try:
+                proc.wait(timeout=args.timeout)
+            except subprocess.TimeoutExpired:
+                proc.kill()
+                proc.wait()
+                raise RuntimeError("timed out after %d seconds" % args.timeout)
+            finally:
+                proc.stdin.close()
+        host_time = time.monotonic() - start
+
+        with open(os.path.join(out_dir, "sim.log")) as f:
+            log = f.read()
+        values = {}
+        for name in ("total-commits", "total-cycles", "simulation-time"):
+            m = re.search(r"%s: (\d+)" % name, log)
+            if m is None:
+                raise RuntimeError("no %s in the simulation log, exit code %d"
+                                   % (name, proc.returncode))
+            values[name] = int(m.group(1))
+        return (values["total-commits"], values["total-cycles"],
+                values["simulation-time"], host_time)
+    finally:
+        shutil.rmtree(out_dir, ignore_errors=True)
+
+
+def read_baseline(path):
+    baseline = {}
+    if os.path.exists(path):
+        with open(path) as f:
+            for row in csv.DictReader(f):
+                baseline[(row["kernel"], row["core"], row["mem_model"])] = row
+    return baseline
+
+
+def parse_list(value, choices):
+    items = value.split(",")
+    for item in items:
+        if item not in choices:
+            raise argparse.ArgumentTypeError(
+                "%s is not one of %s" % (item, ", ".join(choices)))
+    return items
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--sim", default="./marss-riscv",
+                        help="simulator binary (default: %(default)s)")
+    parser.add_argument("--configs",
+                        default=os.path.join(BENCH_DIR, "..", "..", "configs"),
+                        help="directory of the SoC configurations")
+    parser.add_argument("--kernels-dir", default=BENCH_DIR,
+                        help="directory of the kernel binaries")
+    parser.add_argument("--baseline",
+                        default=os.path.join(BENCH_DIR, "baseline.csv"),
+                        help="baseline file (default: bench/baseline.csv)")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="KIPS drop in percent reported as a regression "
+                        "(default: %(default)s)")
+    parser.add_argument("--update-baseline", action="store_true",
+                        help="write the results to the baseline file")
+    parser.add_argument("--kernels", default=KERNELS,
+                        type=lambda v: parse_list(v, KERNELS),
+                        help="comma separated kernels (default: all)")
+    parser.add_argument("--cores", default=list(CORES),
+                        type=lambda v: parse_list(v, list(CORES)),
+                        help="comma separated core types (default: all)")
+    parser.add_argument("--mem-models", default=MEM_MODELS,
+                        type=lambda v: parse_list(v, MEM_MODELS),
+                        help="comma separated memory models (default: all)")
+    parser.add_argument("--runs", type=int, default=3,
+                        help="runs of each kernel, the fastest is kept "
+                        "(default: %(default)s)")
+    parser.add_argument("--timeout", type=int, default=600,
+                        help="seconds allowed for each run")
+    parser.add_argument("--output", help="also write the results to a CSV file")
+    args = parser.parse_args()
+
+    baseline = read_baseline(args.baseline)
+    results = []
+    failures = 0
+
+    print("%-14s %-10s %-10s %10s %10s %9s %8s %8s %8s  %s"
+          % ("kernel", "core", "mem_model", "commits", "cycles", "host_sec",
+             "kips", "base", "delta", "status"))
+    for kernel in args.kernels:
+        for core in args.cores:
+            for mem_model in args.mem_models:
+                base_kips, delta = "-", "-"
+                try:
+                    runs = [run_kernel(args, kernel, core, mem_model)
+                            for _ in range(max(args.runs, 1))]
+                    if len(set(run[0] for run in runs)) != 1:
+                        raise RuntimeError("commits differ between runs")
+                    commits, cycles, sim_ms, host_time = min(
+                        runs, key=lambda run: run[2])
+                except (OSError, RuntimeError) as e:
+                    print("%-14s %-10s %-10s  error: %s"
+                          % (kernel, core, mem_model, e))
+                    failures += 1
+                    continue
+
+                kips = commits // (sim_ms if sim_ms else 1)
+                status = "ok"
+                base = baseline.get((kernel, core, mem_model))
+                if base is not None and not args.update_baseline:
+                    base_kips = int(base["kips"])
+                    delta = "%+.1f%%" % (100.0 * (kips - base_kips)
+                                         / (base_kips if base_kips else 1))
+                    if int(base["commits"]) != commits:
+                        status = "commits differ from baseline"
+                        failures += 1
+                    elif kips < base_kips * (1.0 - args.threshold / 100.0):
+                        status = "regression"
+                        failures += 1
+                elif base is None and not args.update_baseline:
+                    status = "no baseline"
+
+                print("%-14s %-10s %-10s %10d %10d %9.2f %8d %8s %8s  %s"
+                      % (kernel, core, mem_model, commits, cycles, host_time,
+                         kips, base_kips, delta, status))
+                sys.stdout.flush()
+                results.append({"kernel": kernel, "core": core,
+                                "mem_model": mem_model, "commits": commits,
+                                "cycles": cycles, "kips": kips})
+
+    if args.output:
+        with open(args.output, "w") as f:
+            writer = csv.DictWriter(f, fieldnames=BASELINE_FIELDS)
+            writer.writeheader()
+            writer.writerows(results)
+
+    if args.update_baseline:
+        for row in results:
+            baseline[(row["kernel"], row["core"], row["mem_model"])] = row
+        with open(args.baseline, "w") as f:
+            writer = csv.DictWriter(f, fieldnames=BASELINE_FIELDS,
+                                    extrasaction="ignore")
+            writer.writeheader()
+            for key in sorted(baseline):
+                writer.writerow(baseline[key])
+        print("Saved baseline in %s" % args.baseline)
+
+    if failures:
+        print("%d run(s) failed or regressed by more than %.1f%%"
+              % (failures, args.threshold))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
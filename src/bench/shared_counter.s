@@ -0,0 +1,69 @@
+# Shared counter: every hart increments a counter shared by all the harts with
+# LR/SC, stores the value to its word of an array shared with the other harts
+# and to a line of its own array, which keeps the shared levels and the memory
+# controller busy. Hart 0 waits for the other harts, prints P if the counter
+# holds HARTS * ITERS and F otherwise, then powers off the machine.
+#
+# Used by check_parallel.py, expects 4 harts: the harts past the fourth wait
+# for interrupts.
+
+    .option norelax
+    .equ HARTS, 4
+    .equ ITERS, 2000
+
+    .text
+    .globl _start
+_start:
+    csrr s5, mhartid
+    li t0, HARTS
+    bgeu s5, t0, 9f
+    li s0, 0x80100000               # shared counter
+    li s1, 0x80100040               # harts done
+    li s2, 0x80200000               # shared array, a word per hart
+    slli t0, s5, 3
+    add s2, s2, t0
+    li s3, 0x80300000               # array of the hart, 128 KB per hart
+    slli t0, s5, 17
+    add s3, s3, t0
+
+    csrr zero, 0x800                # simulation start marker
+    li s4, ITERS
+1:  lr.d t0, (s0)
+    addi t0, t0, 1
+    sc.d t1, t0, (s0)
+    bnez t1, 1b
+    sd t0, 0(s2)
+    slli t2, s4, 6
+    add t2, s3, t2
+    sd t0, 0(t2)
+    addi s4, s4, -1
+    bnez s4, 1b
+
+    li t0, 1
+    amoadd.d zero, t0, (s1)
+    bnez s5, 9f
+    li t1, HARTS
+2:  ld t0, 0(s1)
+    bne t0, t1, 2b
+    csrr zero, 0x801                # simulation stop marker
+
+    # Print the result and power off through HTIF
+    li t1, 0x40008000
+    li t2, 0x01010000               # console device, putchar command
+    li a1, 'P'
+    ld t0, 0(s0)
+    li t3, HARTS * ITERS
+    beq t0, t3, 3f
+    li a1, 'F'
+3:  sw a1, 0(t1)
+    sw t2, 4(t1)
+    li a1, '\n'
+    sw a1, 0(t1)
+    sw t2, 4(t1)
+    li t0, 1
+    sw t0, 0(t1)
+    sw zero, 4(t1)
+4:  j 4b
+
+9:  wfi
+    j 9b
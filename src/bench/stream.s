@@ -0,0 +1,43 @@
+# Streaming: integer triad a[i] = b[i] + 3 * c[i] over three 512 KB arrays,
+# which streams lines through the caches to the DRAM model.
+#
+# Part of the simulator throughput benchmarks, see run_bench.py.
+
+    .option norelax
+    .equ ELEMS, 65536
+    .equ PASSES, 2
+
+    .text
+    .globl _start
+_start:
+    li s0, 0x80100000               # a
+    li s1, 0x80200000               # b
+    li s2, 0x80300000               # c
+
+    csrr zero, 0x800                # simulation start marker
+    li s3, PASSES
+1:  mv t0, s0
+    mv t1, s1
+    mv t2, s2
+    li t3, ELEMS
+2:  ld t4, 0(t1)
+    ld t5, 0(t2)
+    slli t6, t5, 1
+    add t5, t5, t6
+    add t4, t4, t5
+    sd t4, 0(t0)
+    addi t0, t0, 8
+    addi t1, t1, 8
+    addi t2, t2, 8
+    addi t3, t3, -1
+    bnez t3, 2b
+    addi s3, s3, -1
+    bnez s3, 1b
+    csrr zero, 0x801                # simulation stop marker
+
+    # Power off through HTIF
+    li t1, 0x40008000
+    li t0, 1
+    sw t0, 0(t1)
+    sw zero, 4(t1)
+3:  j 3b
@@ -0,0 +1,52 @@
+# System calls: a user mode loop making ecalls to a machine mode handler,
+# which takes the trap, flushes the pipeline and returns with mret.
+#
+# Part of the simulator throughput benchmarks, see run_bench.py.
+
+    .option norelax
+    .equ ITERS, 120000
+    .equ SYS_GETPID, 172
+    .equ SYS_EXIT, 93
+
+    .text
+    .globl _start
+_start:
+    la t0, trap
+    csrw mtvec, t0
+    li t0, 0x1800                   # mstatus.MPP = user
+    csrc mstatus, t0
+    la t0, user
+    csrw mepc, t0
+    li s1, 0                        # system calls served
+    csrr zero, 0x800                # simulation start marker
+    mret
+
+user:
+    li s0, ITERS
+1:  li a7, SYS_GETPID
+    ecall
+    add s2, s2, a0
+    addi s0, s0, -1
+    bnez s0, 1b
+    li a7, SYS_EXIT
+    ecall
+
+trap:
+    li t0, SYS_EXIT
+    beq a7, t0, exit
+    addi s1, s1, 1
+    mv a0, s1
+    csrr t0, mepc
+    addi t0, t0, 4
+    csrw mepc, t0
+    mret
+
+exit:
+    csrr zero, 0x801                # simulation stop marker
+
+    # Power off through HTIF
+    li t1, 0x40008000
+    li t0, 1
+    sw t0, 0(t1)
+    sw zero, 4(t1)
+2:  j 2b
@@ -27,6 +27,10 @@
 #include <string.h>
 #include <inttypes.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "cutils.h"
 #include "iomem.h"
@@ -99,6 +103,52 @@ PhysMemoryRange *register_ram_entry(PhysMemoryMap *s, uint64_t addr,
     return pr;
 }
 
+#define HUGE_PAGE_SIZE (2 << 20)
+
+/* RAM is mapped rather than allocated, so that the host only zeroes the
+   pages the guest touches. With DEVRAM_FLAG_HUGE_PAGES, the pages reserved
+   in the host hugetlbfs pool are used if there are enough of them, and
+   transparent huge pages otherwise. A file mapped over the RAM splits it in
+   4 KB pages, so it is only backed by transparent huge pages. */
+static uint8_t *ram_map(uint64_t size, int devram_flags, BOOL has_file)
+{
+    void *ptr;
+
+    ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if ((devram_flags & DEVRAM_FLAG_HUGE_PAGES) && !has_file &&
+        (size & (HUGE_PAGE_SIZE - 1)) == 0) {
+        ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (ptr == MAP_FAILED) {
+        ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (ptr == MAP_FAILED)
+            return NULL;
+#ifdef MADV_HUGEPAGE
+        if (devram_flags & DEVRAM_FLAG_HUGE_PAGES)
+            madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+    }
+    return ptr;
+}
+
+static void ram_alloc_dirty_bits(PhysMemoryRange *pr)
+{
+    size_t nb_pages;
+    int i;
+
+    nb_pages = pr->org_size >> DEVRAM_PAGE_SIZE_LOG2;
+    pr->dirty_bits_size = ((nb_pages + 31) / 32) * sizeof(uint32_t);
+    pr->dirty_bits_index = 0;
+    for(i = 0; i < 2; i++) {
+        pr->dirty_bits_tab[i] = mallocz(pr->dirty_bits_size);
+    }
+    pr->dirty_bits = pr->dirty_bits_tab[pr->dirty_bits_index];
+}
+
 static PhysMemoryRange *default_register_ram(PhysMemoryMap *s, uint64_t addr,
                                              uint64_t size, int devram_flags)
 {
@@ -106,23 +156,58 @@ static PhysMemoryRange *default_register_ram(PhysMemoryMap *s, uint64_t addr,
 
     pr = register_ram_entry(s, addr, size, devram_flags);
 
-    pr->phys_mem = mallocz(size);
+    pr->phys_mem = ram_map(size, devram_flags, FALSE);
     if (!pr->phys_mem) {
         fprintf(stderr, "Could not allocate VM memory\n");
         exit(1);
     }
 
-    if (devram_flags & DEVRAM_FLAG_DIRTY_BITS) {
-        size_t nb_pages;
-        int i;
-        nb_pages = size >> DEVRAM_PAGE_SIZE_LOG2;
-        pr->dirty_bits_size = ((nb_pages + 31) / 32) * sizeof(uint32_t);
-        pr->dirty_bits_index = 0;
-        for(i = 0; i < 2; i++) {
-            pr->dirty_bits_tab[i] = mallocz(pr->dirty_bits_size);
-        }
-        pr->dirty_bits = pr->dirty_bits_tab[pr->dirty_bits_index];
+    if (devram_flags & DEVRAM_FLAG_DIRTY_BITS)
+        ram_alloc_dirty_bits(pr);
+    return pr;
+}
+
+/* Register RAM starting with the contents of a raw image file. The file is
+   mapped copy on write, so that its pages are only read when the guest
+   touches them and the guest writes are not written back. The RAM past the
+   end of the file is zeroed. */
+PhysMemoryRange *cpu_register_ram_file(PhysMemoryMap *s, uint64_t addr,
+                                       uint64_t size, int devram_flags,
+                                       const char *filename)
+{
+    PhysMemoryRange *pr;
+    struct stat st;
+    uint64_t map_size;
+    int fd;
+
+    pr = register_ram_entry(s, addr, size, devram_flags);
+    pr->phys_mem = ram_map(size, devram_flags, TRUE);
+    if (!pr->phys_mem) {
+        fprintf(stderr, "Could not allocate VM memory\n");
+        exit(1);
     }
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(filename);
+        exit(1);
+    }
+    if (st.st_size > size) {
+        fprintf(stderr, "%s: file larger than the VM memory\n", filename);
+        exit(1);
+    }
+    map_size = (st.st_size + DEVRAM_PAGE_SIZE - 1) &
+        ~(uint64_t)(DEVRAM_PAGE_SIZE - 1);
+    if (map_size != 0 &&
+        mmap(pr->phys_mem, map_size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        perror(filename);
+        exit(1);
+    }
+    close(fd);
+
+    if (devram_flags & DEVRAM_FLAG_DIRTY_BITS)
+        ram_alloc_dirty_bits(pr);
     return pr;
 }
 
@@ -178,7 +263,7 @@ void phys_mem_reset_dirty_bit(PhysMemoryRange *pr, size_t offset)
 
 static void default_free_ram(PhysMemoryMap *s, PhysMemoryRange *pr)
 {
-    free(pr->phys_mem);
+    munmap(pr->phys_mem, pr->org_size);
 }
 
 PhysMemoryRange *cpu_register_device(PhysMemoryMap *s, uint64_t addr,
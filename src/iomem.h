@@ -38,6 +38,7 @@ typedef uint32_t DeviceReadFunc(void *opaque, uint32_t offset, int size_log2);
 #define DEVRAM_FLAG_ROM        (1 << 0) /* not writable */
 #define DEVRAM_FLAG_DIRTY_BITS (1 << 1) /* maintain dirty bits */
 #define DEVRAM_FLAG_DISABLED   (1 << 2) /* allocated but not mapped */
+#define DEVRAM_FLAG_HUGE_PAGES (1 << 3) /* back with host huge pages */
 #define DEVRAM_PAGE_SIZE_LOG2 12
 #define DEVRAM_PAGE_SIZE (1 << DEVRAM_PAGE_SIZE_LOG2)
 
@@ -89,6 +90,9 @@ static inline PhysMemoryRange *cpu_register_ram(PhysMemoryMap *s, uint64_t addr,
 {
     return s->register_ram(s, addr, size, devram_flags);
 }
+PhysMemoryRange *cpu_register_ram_file(PhysMemoryMap *s, uint64_t addr,
+                                       uint64_t size, int devram_flags,
+                                       const char *filename);
 PhysMemoryRange *cpu_register_device(PhysMemoryMap *s, uint64_t addr,
                                      uint64_t size, void *opaque,
                                      DeviceReadFunc *read_func, DeviceWriteFunc *write_func,
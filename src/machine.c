@@ -474,6 +474,37 @@ void virt_machine_load_config_file(VirtMachineParams *p,
     config_load_file(s, filename, config_file_loaded, s);
 }
 
+/* A bare-metal ELF is loaded as the bios, without the other boot files, the
+   disks, the filesystems and the network of the config */
+static void config_use_elf_file(VirtMachineParams *p)
+{
+    int i;
+
+    for(i = 0; i < VM_FILE_COUNT; i++) {
+        free(p->files[i].filename);
+        p->files[i].filename = NULL;
+    }
+    p->files[VM_FILE_BIOS].filename = strdup(p->sim_params->elf_file);
+    free(p->cmdline);
+    p->cmdline = NULL;
+
+    for(i = 0; i < p->drive_count; i++) {
+        free(p->tab_drive[i].filename);
+        free(p->tab_drive[i].device);
+    }
+    p->drive_count = 0;
+    for(i = 0; i < p->fs_count; i++) {
+        free(p->tab_fs[i].filename);
+        free(p->tab_fs[i].tag);
+    }
+    p->fs_count = 0;
+    for(i = 0; i < p->eth_count; i++) {
+        free(p->tab_eth[i].driver);
+        free(p->tab_eth[i].ifname);
+    }
+    p->eth_count = 0;
+}
+
 static void config_file_loaded(void *opaque, uint8_t *buf, int buf_len)
 {
     VMConfigLoadState *s = opaque;
@@ -481,6 +512,9 @@ static void config_file_loaded(void *opaque, uint8_t *buf, int buf_len)
 
     if (virt_machine_parse_config(p, (char *)buf, buf_len) < 0)
         exit(1);
+
+    if (p->sim_params->elf_file)
+        config_use_elf_file(p);
     
     /* load the additional files */
     s->file_index = 0;
@@ -548,6 +582,7 @@ void virt_machine_free_config(VirtMachineParams *p)
     
     free(p->machine_name);
     free(p->cmdline);
+    free(p->ram_file);
     for(i = 0; i < VM_FILE_COUNT; i++) {
         free(p->files[i].filename);
         free(p->files[i].buf);
@@ -89,6 +89,8 @@ typedef struct {
     const VirtMachineClass *vmc;
     char *machine_name;
     uint64_t ram_size;
+    char *ram_file; /* NULL means zeroed RAM */
+    BOOL ram_huge_pages;
     BOOL rtc_real_time;
     BOOL rtc_local_time;
     char *display_device; /* NULL means no display */
@@ -60,6 +60,7 @@
 //#define CONFIG_LOGFILE
 
 #include "riscv_cpu_priv.h"
+#include "riscv_vector.h"
 
 #if FLEN > 0
 #include "softfp.h"
@@ -278,7 +279,7 @@ static int get_phys_addr(RISCVCPUState *s,
         if (pte_size_log2 == 2) {
             pte = phys_read_u32(s, pte_addr);
             if (s->simcpu->simulation) {
-                s->simcpu->mem_hierarchy->mem_controller->page_walk_delay
+                s->simcpu->mem_hierarchy->page_walk_delay
                     += s->simcpu->mem_hierarchy->pte_read_delay(
                         s->simcpu->mem_hierarchy, pte_addr, 4,
                         s->hw_pg_tb_wlk_stage_id, s->priv);
@@ -287,7 +288,7 @@ static int get_phys_addr(RISCVCPUState *s,
         else {
             pte = phys_read_u64(s, pte_addr);
             if (s->simcpu->simulation) {
-                s->simcpu->mem_hierarchy->mem_controller->page_walk_delay
+                s->simcpu->mem_hierarchy->page_walk_delay
                     += s->simcpu->mem_hierarchy->pte_read_delay(
                         s->simcpu->mem_hierarchy, pte_addr, 8,
                         s->hw_pg_tb_wlk_stage_id, s->priv);
@@ -349,11 +350,112 @@ static int get_phys_addr(RISCVCPUState *s,
     return -1;
 }
 
+/* Fill the entries of addr in the emulation TLB and in the TLB of the timing
+   model, the entry evicted from the emulation TLB moves to its victim TLB */
+static void tlb_fill(RISCVCPUState *s, EmuTLB *emu_tlb, TLBEntry *sim_tlb,
+                     target_ulong addr, uint8_t *ptr, target_ulong paddr)
+{
+    TLBEntry *e;
+
+    e = &emu_tlb->tlb[(addr >> PG_SHIFT) & (EMU_TLB_SIZE - 1)];
+    if (e->vaddr != -1 && e->vaddr != (addr & ~PG_MASK)) {
+        emu_tlb->victim[emu_tlb->victim_next] = *e;
+        emu_tlb->victim_next = (emu_tlb->victim_next + 1) &
+            (EMU_VICTIM_TLB_SIZE - 1);
+    }
+    e->vaddr = addr & ~PG_MASK;
+    e->mem_addend = (uintptr_t)ptr - addr;
+    e->guest_paddr = paddr & ~PG_MASK;
+    sim_tlb[(addr >> PG_SHIFT) & (TLB_SIZE - 1)] = *e;
+}
+
+/* Look addr up in the victim TLB of the emulation and swap the matching entry
+   with the direct-mapped one. return the host address of addr, NULL if not
+   found. In simulation mode, a miss in the TLB of the timing model always
+   walks the page table. */
+static uint8_t *tlb_lookup_victim(RISCVCPUState *s, EmuTLB *emu_tlb,
+                                  target_ulong addr)
+{
+    TLBEntry *e, tmp;
+    int i;
+
+    if (s->simcpu->simulation)
+        return NULL;
+    for(i = 0; i < EMU_VICTIM_TLB_SIZE; i++) {
+        if (emu_tlb->victim[i].vaddr == (addr & ~PG_MASK)) {
+            e = &emu_tlb->tlb[(addr >> PG_SHIFT) & (EMU_TLB_SIZE - 1)];
+            tmp = *e;
+            *e = emu_tlb->victim[i];
+            emu_tlb->victim[i] = tmp;
+            return (uint8_t *)(e->mem_addend + (uintptr_t)addr);
+        }
+    }
+    return NULL;
+}
+
+static mem_uint_t ram_read(uint8_t *ptr, int size_log2)
+{
+    switch(size_log2) {
+    case 0:
+        return *(uint8_t *)ptr;
+    case 1:
+        return *(uint16_t *)ptr;
+    case 2:
+        return *(uint32_t *)ptr;
+#if MLEN >= 64
+    case 3:
+        return *(uint64_t *)ptr;
+#endif
+#if MLEN >= 128
+    case 4:
+        return *(uint128_t *)ptr;
+#endif
+    default:
+        abort();
+    }
+}
+
+static void ram_write(uint8_t *ptr, mem_uint_t val, int size_log2)
+{
+    switch(size_log2) {
+    case 0:
+        *(uint8_t *)ptr = val;
+        break;
+    case 1:
+        *(uint16_t *)ptr = val;
+        break;
+    case 2:
+        *(uint32_t *)ptr = val;
+        break;
+#if MLEN >= 64
+    case 3:
+        *(uint64_t *)ptr = val;
+        break;
+#endif
+#if MLEN >= 128
+    case 4:
+        *(uint128_t *)ptr = val;
+        break;
+#endif
+    default:
+        abort();
+    }
+}
+
+/* The aligned parts of a misaligned access go through the fast path of the
+   current mode */
+#define SPLIT_READ(s, size, pval, addr)                                        \
+    ((s)->simcpu->simulation ? target_sim_read_u##size(s, pval, addr)          \
+                             : target_read_u##size(s, pval, addr))
+#define SPLIT_WRITE(s, size, addr, val)                                        \
+    ((s)->simcpu->simulation ? target_sim_write_u##size(s, addr, val)          \
+                             : target_write_u##size(s, addr, val))
+
 /* return 0 if OK, != 0 if exception */
 int target_read_slow(RISCVCPUState *s, mem_uint_t *pval,
                      target_ulong addr, int size_log2)
 {
-    int size, tlb_idx, err, al;
+    int size, err, al;
     target_ulong paddr, offset;
     uint8_t *ptr;
     PhysMemoryRange *pr;
@@ -367,10 +469,10 @@ int target_read_slow(RISCVCPUState *s, mem_uint_t *pval,
         case 1:
             {
                 uint8_t v0, v1;
-                err = target_read_u8(s, &v0, addr);
+                err = SPLIT_READ(s, 8, &v0, addr);
                 if (err)
                     return err;
-                err = target_read_u8(s, &v1, addr + 1);
+                err = SPLIT_READ(s, 8, &v1, addr + 1);
                 if (err)
                     return err;
                 ret = v0 | (v1 << 8);
@@ -380,10 +482,10 @@ int target_read_slow(RISCVCPUState *s, mem_uint_t *pval,
             {
                 uint32_t v0, v1;
                 addr -= al;
-                err = target_read_u32(s, &v0, addr);
+                err = SPLIT_READ(s, 32, &v0, addr);
                 if (err)
                     return err;
-                err = target_read_u32(s, &v1, addr + 4);
+                err = SPLIT_READ(s, 32, &v1, addr + 4);
                 if (err)
                     return err;
                 ret = (v0 >> (al * 8)) | (v1 << (32 - al * 8));
@@ -394,10 +496,10 @@ int target_read_slow(RISCVCPUState *s, mem_uint_t *pval,
             {
                 uint64_t v0, v1;
                 addr -= al;
-                err = target_read_u64(s, &v0, addr);
+                err = SPLIT_READ(s, 64, &v0, addr);
                 if (err)
                     return err;
-                err = target_read_u64(s, &v1, addr + 8);
+                err = SPLIT_READ(s, 64, &v1, addr + 8);
                 if (err)
                     return err;
                 ret = (v0 >> (al * 8)) | (v1 << (64 - al * 8));
@@ -409,10 +511,10 @@ int target_read_slow(RISCVCPUState *s, mem_uint_t *pval,
             {
                 uint128_t v0, v1;
                 addr -= al;
-                err = target_read_u128(s, &v0, addr);
+                err = SPLIT_READ(s, 128, &v0, addr);
                 if (err)
                     return err;
-                err = target_read_u128(s, &v1, addr + 16);
+                err = SPLIT_READ(s, 128, &v1, addr + 16);
                 if (err)
                     return err;
                 ret = (v0 >> (al * 8)) | (v1 << (128 - al * 8));
@@ -422,6 +524,8 @@ int target_read_slow(RISCVCPUState *s, mem_uint_t *pval,
         default:
             abort();
         }
+    } else if ((ptr = tlb_lookup_victim(s, &s->emu_tlb_read, addr))) {
+        ret = ram_read(ptr, size_log2);
     } else {
         if (get_phys_addr(s, &paddr, addr, ACCESS_READ)) {
             s->pending_tval = addr;
@@ -437,38 +541,15 @@ int target_read_slow(RISCVCPUState *s, mem_uint_t *pval,
 #endif
             return 0;
         } else if (pr->is_ram) {
-            tlb_idx = (addr >> PG_SHIFT) & (TLB_SIZE - 1);
             ptr = pr->phys_mem + (uintptr_t)(paddr - pr->addr);
-            s->tlb_read[tlb_idx].vaddr = addr & ~PG_MASK;
-            s->tlb_read[tlb_idx].mem_addend = (uintptr_t)ptr - addr;
-            s->tlb_read[tlb_idx].guest_paddr = paddr & ~PG_MASK;
-            switch(size_log2) {
-            case 0:
-                ret = *(uint8_t *)ptr;
-                break;
-            case 1:
-                ret = *(uint16_t *)ptr;
-                break;
-            case 2:
-                ret = *(uint32_t *)ptr;
-                break;
-#if MLEN >= 64
-            case 3:
-                ret = *(uint64_t *)ptr;
-                break;
-#endif
-#if MLEN >= 128
-            case 4:
-                ret = *(uint128_t *)ptr;
-                break;
-#endif
-            default:
-                abort();
-            }
+            tlb_fill(s, &s->emu_tlb_read, s->tlb_read, addr, ptr, paddr);
+            ret = ram_read(ptr, size_log2);
         } else {
             s->is_device_io = 1;
             s->data_guest_paddr = paddr;
             offset = paddr - pr->addr;
+            if (s->io_lock)
+                pthread_mutex_lock(s->io_lock);
             if (((pr->devio_flags >> size_log2) & 1) != 0) {
                 ret = pr->read_func(pr->opaque, offset, size_log2);
             }
@@ -488,17 +569,59 @@ int target_read_slow(RISCVCPUState *s, mem_uint_t *pval,
 #endif
                 ret = 0;
             }
+            if (s->io_lock)
+                pthread_mutex_unlock(s->io_lock);
         }
     }
     *pval = ret;
     return 0;
 }
 
+/* A reservation covers the naturally aligned granule of the largest access */
+#define RES_GRANULE_MASK (~(uintptr_t)(MLEN / 8 - 1))
+
+/* return TRUE if the stores of s drop the reservation of h here. In
+   simulation with coherent caches, the coherence model drops it instead,
+   unless s and h are threads of an SMT core sharing the data cache. */
+static BOOL stores_drop_reservation(RISCVCPUState *s, RISCVCPUState *h)
+{
+    return !(s->simcpu->simulation && s->simcpu->mem_hierarchy->directory &&
+             s->simcpu->mem_hierarchy->dcache !=
+             h->simcpu->mem_hierarchy->dcache);
+}
+
+/* Drop the reservations of the other harts on the granule written at ptr.
+   return TRUE if another hart keeps a reservation in the page of ptr, in which
+   case its write TLB entry must not be filled. */
+static BOOL drop_reservations(RISCVCPUState *s, uint8_t *ptr)
+{
+    RISCVCPUState *h;
+    BOOL page_reserved;
+    int i;
+
+    page_reserved = FALSE;
+    for(i = 0; i < s->num_harts; i++) {
+        h = s->harts[i];
+        if (h == s || h->load_res == (target_ulong)-1 || !h->load_res_ptr ||
+            !stores_drop_reservation(s, h))
+            continue;
+        if (((uintptr_t)h->load_res_ptr & RES_GRANULE_MASK) ==
+            ((uintptr_t)ptr & RES_GRANULE_MASK)) {
+            h->load_res = (target_ulong)-1;
+            h->load_res_ptr = NULL;
+        } else if (((uintptr_t)h->load_res_ptr >> PG_SHIFT) ==
+                   ((uintptr_t)ptr >> PG_SHIFT)) {
+            page_reserved = TRUE;
+        }
+    }
+    return page_reserved;
+}
+
 /* return 0 if OK, != 0 if exception */
 int target_write_slow(RISCVCPUState *s, target_ulong addr,
                       mem_uint_t val, int size_log2)
 {
-    int size, i, tlb_idx, err;
+    int size, i, err;
     target_ulong paddr, offset;
     uint8_t *ptr;
     PhysMemoryRange *pr;
@@ -508,10 +631,12 @@ int target_write_slow(RISCVCPUState *s, target_ulong addr,
     if ((addr & (size - 1)) != 0) {
         /* XXX: should avoid modifying the memory in case of exception */
         for(i = 0; i < size; i++) {
-            err = target_write_u8(s, addr + i, (val >> (8 * i)) & 0xff);
+            err = SPLIT_WRITE(s, 8, addr + i, (val >> (8 * i)) & 0xff);
             if (err)
                 return err;
         }
+    } else if ((ptr = tlb_lookup_victim(s, &s->emu_tlb_write, addr))) {
+        ram_write(ptr, val, size_log2);
     } else {
         if (get_phys_addr(s, &paddr, addr, ACCESS_WRITE)) {
             s->pending_tval = addr;
@@ -527,38 +652,16 @@ int target_write_slow(RISCVCPUState *s, target_ulong addr,
 #endif
         } else if (pr->is_ram) {
             phys_mem_set_dirty_bit(pr, paddr - pr->addr);
-            tlb_idx = (addr >> PG_SHIFT) & (TLB_SIZE - 1);
             ptr = pr->phys_mem + (uintptr_t)(paddr - pr->addr);
-            s->tlb_write[tlb_idx].vaddr = addr & ~PG_MASK;
-            s->tlb_write[tlb_idx].mem_addend = (uintptr_t)ptr - addr;
-            s->tlb_write[tlb_idx].guest_paddr = paddr & ~PG_MASK;
-            switch(size_log2) {
-            case 0:
-                *(uint8_t *)ptr = val;
-                break;
-            case 1:
-                *(uint16_t *)ptr = val;
-                break;
-            case 2:
-                *(uint32_t *)ptr = val;
-                break;
-#if MLEN >= 64
-            case 3:
-                *(uint64_t *)ptr = val;
-                break;
-#endif
-#if MLEN >= 128
-            case 4:
-                *(uint128_t *)ptr = val;
-                break;
-#endif
-            default:
-                abort();
-            }
+            if (!s->harts || !drop_reservations(s, ptr))
+                tlb_fill(s, &s->emu_tlb_write, s->tlb_write, addr, ptr, paddr);
+            ram_write(ptr, val, size_log2);
         } else {
             s->is_device_io = 1;
             s->data_guest_paddr = paddr;
             offset = paddr - pr->addr;
+            if (s->io_lock)
+                pthread_mutex_lock(s->io_lock);
             if (((pr->devio_flags >> size_log2) & 1) != 0) {
                 pr->write_func(pr->opaque, offset, val, size_log2);
             }
@@ -578,11 +681,40 @@ int target_write_slow(RISCVCPUState *s, target_ulong addr,
                 printf(" width=%d bits\n", 1 << (3 + size_log2));
 #endif
             }
+            if (s->io_lock)
+                pthread_mutex_unlock(s->io_lock);
         }
     }
     return 0;
 }
 
+/* Fill the write TLB entry of addr without accessing the memory, used by the
+   atomics performed with host atomic operations. return 0 if OK, 1 if addr is
+   not an aligned RAM address, -1 if exception */
+int target_fill_tlb_write(RISCVCPUState *s, target_ulong addr, int size_log2)
+{
+    target_ulong paddr;
+    uint8_t *ptr;
+    PhysMemoryRange *pr;
+
+    if ((addr & ((1 << size_log2) - 1)) != 0)
+        return 1;
+    if (tlb_lookup_victim(s, &s->emu_tlb_write, addr))
+        return 0;
+    if (get_phys_addr(s, &paddr, addr, ACCESS_WRITE)) {
+        s->pending_tval = addr;
+        s->pending_exception = CAUSE_STORE_PAGE_FAULT;
+        return -1;
+    }
+    pr = get_phys_mem_range(s->mem_map, paddr);
+    if (!pr || !pr->is_ram)
+        return 1;
+    phys_mem_set_dirty_bit(pr, paddr - pr->addr);
+    ptr = pr->phys_mem + (uintptr_t)(paddr - pr->addr);
+    tlb_fill(s, &s->emu_tlb_write, s->tlb_write, addr, ptr, paddr);
+    return 0;
+}
+
 struct __attribute__((packed)) unaligned_u32 {
     uint32_t u32;
 };
@@ -602,11 +734,15 @@ no_inline __exception int target_read_insn_slow(RISCVCPUState *s,
                                                        uint8_t **pptr,
                                                        target_ulong addr)
 {
-    int tlb_idx;
     target_ulong paddr;
     uint8_t *ptr;
     PhysMemoryRange *pr;
     
+    ptr = tlb_lookup_victim(s, &s->emu_tlb_code, addr);
+    if (ptr) {
+        *pptr = ptr;
+        return 0;
+    }
     if (get_phys_addr(s, &paddr, addr, ACCESS_CODE)) {
         s->pending_tval = addr;
         s->pending_exception = CAUSE_FETCH_PAGE_FAULT;
@@ -619,11 +755,8 @@ no_inline __exception int target_read_insn_slow(RISCVCPUState *s,
         s->pending_exception = CAUSE_FAULT_FETCH;
         return -1;
     }
-    tlb_idx = (addr >> PG_SHIFT) & (TLB_SIZE - 1);
     ptr = pr->phys_mem + (uintptr_t)(paddr - pr->addr);
-    s->tlb_code[tlb_idx].vaddr = addr & ~PG_MASK;
-    s->tlb_code[tlb_idx].mem_addend = (uintptr_t)ptr - addr;
-    s->tlb_code[tlb_idx].guest_paddr = paddr & ~PG_MASK;
+    tlb_fill(s, &s->emu_tlb_code, s->tlb_code, addr, ptr, paddr);
     *pptr = ptr;
     return 0;
 }
@@ -632,18 +765,21 @@ no_inline __exception int target_read_insn_slow(RISCVCPUState *s,
 __exception int target_read_insn_u16(RISCVCPUState *s, uint16_t *pinsn,
                                                    target_ulong addr)
 {
-    uint32_t tlb_idx;
+    TLBEntry *e;
     uint8_t *ptr;
 
-    if (s->simcpu->simulation && !s->ins_tlb_lookup_accounted) {
-        ++s->simcpu->stats[s->priv].code_tlb_lookups;
-        s->ins_tlb_lookup_accounted = 1;
+    if (s->simcpu->simulation) {
+        if (!s->ins_tlb_lookup_accounted) {
+            ++s->simcpu->stats[s->priv].code_tlb_lookups;
+            s->ins_tlb_lookup_accounted = 1;
+        }
+        e = &s->tlb_code[(addr >> PG_SHIFT) & (TLB_SIZE - 1)];
+    } else {
+        e = &s->emu_tlb_code.tlb[(addr >> PG_SHIFT) & (EMU_TLB_SIZE - 1)];
     }
 
-    tlb_idx = (addr >> PG_SHIFT) & (TLB_SIZE - 1);
-    if (likely(s->tlb_code[tlb_idx].vaddr == (addr & ~PG_MASK))) {
-        ptr = (uint8_t *)(s->tlb_code[tlb_idx].mem_addend +
-                          (uintptr_t)addr);
+    if (likely(e->vaddr == (addr & ~PG_MASK))) {
+        ptr = (uint8_t *)(e->mem_addend + (uintptr_t)addr);
 
         if (s->simcpu->simulation && !s->ins_tlb_hit_accounted) {
             ++s->simcpu->stats[s->priv].code_tlb_hits;
@@ -658,6 +794,21 @@ __exception int target_read_insn_u16(RISCVCPUState *s, uint16_t *pinsn,
     return 0;
 }
 
+static void emu_tlb_init(EmuTLB *emu_tlb)
+{
+    int i;
+
+    for(i = 0; i < EMU_TLB_SIZE; i++) {
+        emu_tlb->tlb[i].vaddr = -1;
+        emu_tlb->tlb[i].guest_paddr = -1;
+    }
+    for(i = 0; i < EMU_VICTIM_TLB_SIZE; i++) {
+        emu_tlb->victim[i].vaddr = -1;
+        emu_tlb->victim[i].guest_paddr = -1;
+    }
+    emu_tlb->victim_next = 0;
+}
+
 static void tlb_init(RISCVCPUState *s)
 {
     int i;
@@ -670,6 +821,9 @@ static void tlb_init(RISCVCPUState *s)
         s->tlb_write[i].guest_paddr = -1;
         s->tlb_code[i].guest_paddr = -1;
     }
+    emu_tlb_init(&s->emu_tlb_read);
+    emu_tlb_init(&s->emu_tlb_write);
+    emu_tlb_init(&s->emu_tlb_code);
 
     /* Flush branch prediction unit on a tlb flush or context switch */
     if (s->simcpu->simulation && s->sim_params->enable_bpu
@@ -689,31 +843,73 @@ static void tlb_flush_vaddr(RISCVCPUState *s, target_ulong vaddr)
     tlb_flush_all(s);
 }
 
+static void tlb_flush_write_range(TLBEntry *tlb, int n, uint8_t *ram_ptr,
+                                  uint8_t *ram_end)
+{
+    uint8_t *ptr;
+    int i;
+
+    for(i = 0; i < n; i++) {
+        if (tlb[i].vaddr != -1) {
+            ptr = (uint8_t *)(tlb[i].mem_addend + (uintptr_t)tlb[i].vaddr);
+            if (ptr >= ram_ptr && ptr < ram_end) {
+                tlb[i].vaddr = -1;
+            }
+        }
+    }
+}
+
 /* XXX: inefficient but not critical as long as it is seldom used */
 static void glue(riscv_cpu_flush_tlb_write_range_ram,
                  MAX_XLEN)(RISCVCPUState *s,
                            uint8_t *ram_ptr, size_t ram_size)
 {
-    uint8_t *ptr, *ram_end;
-    int i;
+    uint8_t *ram_end;
     
     ram_end = ram_ptr + ram_size;
-    for(i = 0; i < TLB_SIZE; i++) {
-        if (s->tlb_write[i].vaddr != -1) {
-            ptr = (uint8_t *)(s->tlb_write[i].mem_addend +
-                              (uintptr_t)s->tlb_write[i].vaddr);
-            if (ptr >= ram_ptr && ptr < ram_end) {
-                s->tlb_write[i].vaddr = -1;
-            }
+    tlb_flush_write_range(s->tlb_write, TLB_SIZE, ram_ptr, ram_end);
+    tlb_flush_write_range(s->emu_tlb_write.tlb, EMU_TLB_SIZE, ram_ptr,
+                          ram_end);
+    tlb_flush_write_range(s->emu_tlb_write.victim, EMU_VICTIM_TLB_SIZE,
+                          ram_ptr, ram_end);
+}
+
+
+/* Reserve addr for a SC, called after the LR has read it. The other harts
+   stop storing to the reserved page through their write TLB, so that a store
+   to the reservation drops it. */
+void target_set_reservation(RISCVCPUState *s, target_ulong addr)
+{
+    TLBEntry *e;
+    uint8_t *page_ptr;
+    int i;
+
+    s->load_res = addr;
+    s->load_res_ptr = NULL;
+    if (!s->harts)
+        return;
+    if (s->simcpu->simulation)
+        e = &s->tlb_read[(addr >> PG_SHIFT) & (TLB_SIZE - 1)];
+    else
+        e = &s->emu_tlb_read.tlb[(addr >> PG_SHIFT) & (EMU_TLB_SIZE - 1)];
+    /* device reservations are only checked by the SC of the hart */
+    if (s->is_device_io || e->vaddr != (addr & ~PG_MASK))
+        return;
+    s->load_res_ptr = (uint8_t *)(e->mem_addend + (uintptr_t)addr);
+    page_ptr = (uint8_t *)((uintptr_t)s->load_res_ptr & ~(uintptr_t)PG_MASK);
+    for(i = 0; i < s->num_harts; i++) {
+        if (s->harts[i] != s && stores_drop_reservation(s->harts[i], s)) {
+            glue(riscv_cpu_flush_tlb_write_range_ram, MAX_XLEN)(s->harts[i],
+                                                                page_ptr,
+                                                                1 << PG_SHIFT);
         }
     }
 }
 
-
 #define SSTATUS_MASK0 (MSTATUS_UIE | MSTATUS_SIE |       \
                       MSTATUS_UPIE | MSTATUS_SPIE |     \
                       MSTATUS_SPP | \
-                      MSTATUS_FS | MSTATUS_XS | \
+                      MSTATUS_FS | MSTATUS_XS | MSTATUS_VS | \
                       MSTATUS_SUM | MSTATUS_MXR)
 #if MAX_XLEN >= 64
 #define SSTATUS_MASK (SSTATUS_MASK0 | MSTATUS_UXL_MASK)
@@ -725,11 +921,82 @@ static void glue(riscv_cpu_flush_tlb_write_range_ram,
 #define MSTATUS_MASK (MSTATUS_UIE | MSTATUS_SIE | MSTATUS_MIE |      \
                       MSTATUS_UPIE | MSTATUS_SPIE | MSTATUS_MPIE |    \
                       MSTATUS_SPP | MSTATUS_MPP | \
-                      MSTATUS_FS | \
+                      MSTATUS_FS | MSTATUS_VS | \
                       MSTATUS_MPRV | MSTATUS_SUM | MSTATUS_MXR)
 
-/* cycle and insn counters */
-#define COUNTEREN_MASK ((1 << 0) | (1 << 2))
+/* cycle, insn and hpm counters */
+#define COUNTEREN_MASK ((1 << 0) | (1 << 2) | HPM_COUNTERS_MASK)
+
+/* Value counted by a counter CSR. In emulation mode, every instruction takes
+   one cycle. In simulation mode, cycle follows the simulated clock and the
+   mhpmcounters count the simulator events selected by their mhpmevent */
+static uint64_t get_counter_source(RISCVCPUState *s, int i)
+{
+    switch(i) {
+    case 0:
+        return s->insn_counter + s->cycle_addend + s->simcpu->clock -
+               s->simcpu->icount;
+    case 2:
+        return s->insn_counter;
+    default:
+        return riscv_sim_cpu_hpm_event_count(s->simcpu, s->mhpmevent[i]);
+    }
+}
+
+static uint64_t get_counter(RISCVCPUState *s, int i)
+{
+    if ((s->mcountinhibit >> i) & 1)
+        return s->mhpmcounter[i];
+    return s->mhpmcounter[i] + get_counter_source(s, i) - s->hpm_base[i];
+}
+
+static void set_counter(RISCVCPUState *s, int i, uint64_t val)
+{
+    s->mhpmcounter[i] = val;
+    s->hpm_base[i] = get_counter_source(s, i);
+}
+
+/* counters counting again keep their value */
+static void set_mcountinhibit(RISCVCPUState *s, uint32_t val)
+{
+    uint64_t counters[32];
+    int i;
+
+    for(i = 0; i < 32; i++) {
+        if ((COUNTEREN_MASK >> i) & 1)
+            counters[i] = get_counter(s, i);
+    }
+    s->mcountinhibit = val & COUNTEREN_MASK;
+    for(i = 0; i < 32; i++) {
+        if ((COUNTEREN_MASK >> i) & 1)
+            set_counter(s, i, counters[i]);
+    }
+}
+
+static void set_mhpmevent(RISCVCPUState *s, int i, target_ulong val)
+{
+    uint64_t counter;
+
+    counter = get_counter(s, i);
+    s->mhpmevent[i] = val & (target_ulong)(HPM_EVENT_MASK | HPM_EVENT_UINH |
+                                           HPM_EVENT_SINH | HPM_EVENT_MINH);
+    set_counter(s, i, counter);
+}
+
+/* Called before the simulator resets its clock and stats for a new
+   simulation run */
+void riscv_cpu_save_hpm_counters(RISCVCPUState *s)
+{
+    int i;
+
+    s->cycle_addend += s->simcpu->clock - s->simcpu->icount;
+    for(i = 3; i < 32; i++) {
+        if (!((s->mcountinhibit >> i) & 1)) {
+            s->mhpmcounter[i] = get_counter(s, i);
+            s->hpm_base[i] = 0;
+        }
+    }
+}
 
 /* return the complete mstatus with the SD bit */
 static target_ulong get_mstatus(RISCVCPUState *s, target_ulong mask)
@@ -739,6 +1006,7 @@ static target_ulong get_mstatus(RISCVCPUState *s, target_ulong mask)
     val = s->mstatus | (s->fs << MSTATUS_FS_SHIFT);
     val &= mask;
     sd = ((val & MSTATUS_FS) == MSTATUS_FS) |
+        ((val & MSTATUS_VS) == MSTATUS_VS) |
         ((val & MSTATUS_XS) == MSTATUS_XS);
     if (sd)
         val |= (target_ulong)1 << (s->cur_xlen - 1);
@@ -768,6 +1036,8 @@ static void set_mstatus(RISCVCPUState *s, target_ulong val)
     s->fs = (val >> MSTATUS_FS_SHIFT) & 3;
 
     mask = MSTATUS_MASK & ~MSTATUS_FS;
+    if (!s->vlenb)
+        mask &= ~MSTATUS_VS;
 #if MAX_XLEN >= 64
     {
         int uxl, sxl;
@@ -815,8 +1085,42 @@ static int csr_read(RISCVCPUState *s, target_ulong *pval, uint32_t csr,
         val = s->fflags | (s->frm << 5);
         break;
 #endif
+    case 0x008: /* vstart */
+    case 0x009: /* vxsat */
+    case 0x00a: /* vxrm */
+    case 0x00f: /* vcsr */
+    case 0xc20: /* vl */
+    case 0xc21: /* vtype */
+    case 0xc22: /* vlenb */
+        if (!s->vlenb || (s->mstatus & MSTATUS_VS) == 0)
+            goto invalid_csr;
+        switch(csr) {
+        case 0x008:
+            val = s->vstart;
+            break;
+        case 0x009:
+            val = s->vxsat;
+            break;
+        case 0x00a:
+            val = s->vxrm;
+            break;
+        case 0x00f:
+            val = s->vxsat | (s->vxrm << 1);
+            break;
+        case 0xc20:
+            val = s->vl;
+            break;
+        case 0xc21:
+            val = s->vtype;
+            break;
+        default:
+            val = s->vlenb;
+            break;
+        }
+        break;
     case 0xc00: /* ucycle */
     case 0xc02: /* uinstret */
+    case 0xc03 ... 0xc1f: /* hpmcounter3..31 */
         {
             uint32_t counteren;
             if (s->priv < PRV_M) {
@@ -828,10 +1132,11 @@ static int csr_read(RISCVCPUState *s, target_ulong *pval, uint32_t csr,
                     goto invalid_csr;
             }
         }
-        val = (int64_t)s->insn_counter;
+        val = (int64_t)get_counter(s, csr & 0x1f);
         break;
     case 0xc80: /* mcycleh */
     case 0xc82: /* minstreth */
+    case 0xc83 ... 0xc9f: /* hpmcounter3h..31h */
         if (s->cur_xlen != 32)
             goto invalid_csr;
         {
@@ -845,7 +1150,7 @@ static int csr_read(RISCVCPUState *s, target_ulong *pval, uint32_t csr,
                     goto invalid_csr;
             }
         }
-        val = s->insn_counter >> 32;
+        val = get_counter(s, csr & 0x1f) >> 32;
         break;
         
     case 0x100:
@@ -915,15 +1220,23 @@ static int csr_read(RISCVCPUState *s, target_ulong *pval, uint32_t csr,
     case 0x344:
         val = s->mip;
         break;
+    case 0x320:
+        val = s->mcountinhibit;
+        break;
+    case 0x323 ... 0x33f: /* mhpmevent3..31 */
+        val = s->mhpmevent[csr & 0x1f];
+        break;
     case 0xb00: /* mcycle */
     case 0xb02: /* minstret */
-        val = (int64_t)s->insn_counter;
+    case 0xb03 ... 0xb1f: /* mhpmcounter3..31 */
+        val = (int64_t)get_counter(s, csr & 0x1f);
         break;
     case 0xb80: /* mcycleh */
     case 0xb82: /* minstreth */
+    case 0xb83 ... 0xb9f: /* mhpmcounter3h..31h */
         if (s->cur_xlen != 32)
             goto invalid_csr;
-        val = s->insn_counter >> 32;
+        val = get_counter(s, csr & 0x1f) >> 32;
         break;
     case 0xf14:
         val = s->mhartid;
@@ -971,6 +1284,18 @@ int get_insn_rm(RISCVCPUState *s, unsigned int rm)
 }
 #endif
 
+/* update the bits of mip in mask, see riscv_cpu_set_mip() */
+static void write_mip(RISCVCPUState *s, uint32_t mask, target_ulong val)
+{
+    uint32_t mip, new_mip;
+
+    mip = __atomic_load_n(&s->mip, __ATOMIC_SEQ_CST);
+    do {
+        new_mip = (mip & ~mask) | (val & mask);
+    } while (!__atomic_compare_exchange_n(&s->mip, &mip, new_mip, FALSE,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+}
+
 /* return -1 if invalid CSR, 0 if OK, 1 if the interpreter loop must be
    exited (e.g. XLEN was modified), 2 if TLBs have been flushed. */
 static int csr_write(RISCVCPUState *s, uint32_t csr, target_ulong val)
@@ -1002,6 +1327,23 @@ static int csr_write(RISCVCPUState *s, uint32_t csr, target_ulong val)
         s->fs = 3;
         break;
 #endif
+    case 0x008: /* vstart */
+        s->vstart = val & (s->vlenb * 8 - 1);
+        s->mstatus |= MSTATUS_VS;
+        break;
+    case 0x009: /* vxsat */
+        s->vxsat = val & 1;
+        s->mstatus |= MSTATUS_VS;
+        break;
+    case 0x00a: /* vxrm */
+        s->vxrm = val & 3;
+        s->mstatus |= MSTATUS_VS;
+        break;
+    case 0x00f: /* vcsr */
+        s->vxsat = val & 1;
+        s->vxrm = (val >> 1) & 3;
+        s->mstatus |= MSTATUS_VS;
+        break;
     case 0x100: /* sstatus */
         set_mstatus(s, (s->mstatus & ~SSTATUS_MASK) | (val & SSTATUS_MASK));
         break;
@@ -1029,15 +1371,16 @@ static int csr_write(RISCVCPUState *s, uint32_t csr, target_ulong val)
         break;
     case 0x144: /* sip */
         mask = s->mideleg;
-        s->mip = (s->mip & ~mask) | (val & mask);
+        write_mip(s, mask, val);
         break;
     case 0x180:
-        /* no ASID implemented */
+        /* the ASID is kept for the region of interest filter of the
+           simulator, but the TLBs are flushed on every write */
 #if MAX_XLEN == 32
         {
             int new_mode;
             new_mode = (val >> 31) & 1;
-            s->satp = (val & (((target_ulong)1 << 22) - 1)) |
+            s->satp = (val & (((target_ulong)1 << 31) - 1)) |
                 (new_mode << 31);
         }
 #else
@@ -1047,11 +1390,13 @@ static int csr_write(RISCVCPUState *s, uint32_t csr, target_ulong val)
             new_mode = (val >> 60) & 0xf;
             if (new_mode == 0 || (new_mode >= 8 && new_mode <= 9))
                 mode = new_mode;
-            s->satp = (val & (((uint64_t)1 << 44) - 1)) |
+            s->satp = (val & (((uint64_t)1 << 60) - 1)) |
                 ((uint64_t)mode << 60);
         }
 #endif
         tlb_flush_all(s);
+        if (s->simcpu->simulation)
+            riscv_sim_cpu_roi_switch(s->simcpu);
         return 2;
         
     case 0x300:
@@ -1092,6 +1437,31 @@ static int csr_write(RISCVCPUState *s, uint32_t csr, target_ulong val)
     case 0x306:
         s->mcounteren = val & COUNTEREN_MASK;
         break;
+    case 0x320:
+        set_mcountinhibit(s, val);
+        break;
+    case 0x323 ... 0x33f: /* mhpmevent3..31 */
+        set_mhpmevent(s, csr & 0x1f, val);
+        break;
+    case 0xb00: /* mcycle */
+    case 0xb02: /* minstret */
+    case 0xb03 ... 0xb1f: /* mhpmcounter3..31 */
+        if (s->cur_xlen == 32)
+            set_counter(s, csr & 0x1f,
+                        (get_counter(s, csr & 0x1f) & ~(uint64_t)0xffffffff) |
+                        (uint32_t)val);
+        else
+            set_counter(s, csr & 0x1f, val);
+        break;
+    case 0xb80: /* mcycleh */
+    case 0xb82: /* minstreth */
+    case 0xb83 ... 0xb9f: /* mhpmcounter3h..31h */
+        if (s->cur_xlen != 32)
+            return -1;
+        set_counter(s, csr & 0x1f,
+                    (get_counter(s, csr & 0x1f) & 0xffffffff) |
+                    ((uint64_t)(uint32_t)val << 32));
+        break;
     case 0x340:
         s->mscratch = val;
         break;
@@ -1106,7 +1476,7 @@ static int csr_write(RISCVCPUState *s, uint32_t csr, target_ulong val)
         break;
     case 0x344:
         mask = MIP_SSIP | MIP_STIP;
-        s->mip = (s->mip & ~mask) | (val & mask);
+        write_mip(s, mask, val);
         break;
     default:
 #ifdef DUMP_INVALID_CSR
@@ -1270,33 +1640,6 @@ static void handle_mret(RISCVCPUState *s)
     s->pc = s->mepc;
 }
 
-static inline uint32_t get_pending_irq_mask(RISCVCPUState *s)
-{
-    uint32_t pending_ints, enabled_ints;
-
-    pending_ints = s->mip & s->mie;
-    if (pending_ints == 0)
-        return 0;
-
-    enabled_ints = 0;
-    switch(s->priv) {
-    case PRV_M:
-        if (s->mstatus & MSTATUS_MIE)
-            enabled_ints = ~s->mideleg;
-        break;
-    case PRV_S:
-        enabled_ints = ~s->mideleg;
-        if (s->mstatus & MSTATUS_SIE)
-            enabled_ints |= s->mideleg;
-        break;
-    default:
-    case PRV_U:
-        enabled_ints = -1;
-        break;
-    }
-    return pending_ints & enabled_ints;
-}
-
 static __exception int raise_interrupt(RISCVCPUState *s)
 {
     uint32_t mask;
@@ -1377,9 +1720,11 @@ static uint64_t glue(riscv_cpu_get_cycles, MAX_XLEN)(RISCVCPUState *s)
     return s->insn_counter;
 }
 
+/* mip is updated atomically, as the devices and the other harts set and
+   reset its bits from other host threads */
 static void glue(riscv_cpu_set_mip, MAX_XLEN)(RISCVCPUState *s, uint32_t mask)
 {
-    s->mip |= mask;
+    __atomic_fetch_or(&s->mip, mask, __ATOMIC_SEQ_CST);
     /* exit from power down if an interrupt is pending */
     if (s->power_down_flag && (s->mip & s->mie) != 0)
         s->power_down_flag = FALSE;
@@ -1387,7 +1732,7 @@ static void glue(riscv_cpu_set_mip, MAX_XLEN)(RISCVCPUState *s, uint32_t mask)
 
 static void glue(riscv_cpu_reset_mip, MAX_XLEN)(RISCVCPUState *s, uint32_t mask)
 {
-    s->mip &= ~mask;
+    __atomic_fetch_and(&s->mip, ~mask, __ATOMIC_SEQ_CST);
 }
 
 static uint32_t glue(riscv_cpu_get_mip, MAX_XLEN)(RISCVCPUState *s)
@@ -1400,7 +1745,10 @@ static BOOL glue(riscv_cpu_get_power_down, MAX_XLEN)(RISCVCPUState *s)
     return s->power_down_flag;
 }
 
-static RISCVCPUState *glue(riscv_cpu_init, MAX_XLEN)(PhysMemoryMap *mem_map, const SimParams *p)
+/* boot_cpu is NULL for hart 0, every other hart shares the simulated memory
+   hierarchy below the L1 caches with the boot hart */
+static RISCVCPUState *glue(riscv_cpu_init, MAX_XLEN)(PhysMemoryMap *mem_map, const SimParams *p,
+                                                     int hartid, RISCVCPUState *boot_cpu)
 {
     RISCVCPUState *s;
     
@@ -1413,6 +1761,7 @@ static RISCVCPUState *glue(riscv_cpu_init, MAX_XLEN)(PhysMemoryMap *mem_map, con
     s->sim_params = (SimParams *)p;
     s->mem_map = mem_map;
     s->pc = 0x1000;
+    s->mhartid = hartid;
     s->priv = PRV_M;
     s->cur_xlen = MAX_XLEN;
     s->mxl = get_base_from_xlen(MAX_XLEN);
@@ -1431,6 +1780,9 @@ static RISCVCPUState *glue(riscv_cpu_init, MAX_XLEN)(PhysMemoryMap *mem_map, con
 #ifdef CONFIG_EXT_C
     s->misa |= MCPUID_C;
 #endif
+    if (p->enable_vector) {
+        riscv_vector_init(s, p->vlen);
+    }
 
     s->tlb_code = (TLBEntry*) malloc(sizeof(TLBEntry) * s->sim_params->tlb_size);
     s->tlb_read = (TLBEntry*) malloc(sizeof(TLBEntry) * s->sim_params->tlb_size);
@@ -1439,17 +1791,38 @@ static RISCVCPUState *glue(riscv_cpu_init, MAX_XLEN)(PhysMemoryMap *mem_map, con
     assert(s->tlb_read);
     assert(s->tlb_write);
 
-    s->simcpu = riscv_sim_cpu_init(s->sim_params, s);
+    s->simcpu = riscv_sim_cpu_init(s->sim_params, s, hartid,
+                                   boot_cpu ? boot_cpu->simcpu : NULL);
     tlb_init(s);
 
     return s;
 }
 
+/* Switch the hart to other simulation parameters, used by the children of a
+   sweep. The TLBs are sized by the simulation parameters, so they are
+   reallocated. The simulated hart is rebuilt by the caller. */
+void target_set_sim_params(RISCVCPUState *s, const SimParams *p)
+{
+    free(s->tlb_code);
+    free(s->tlb_read);
+    free(s->tlb_write);
+
+    s->sim_params = (SimParams *)p;
+    s->tlb_code = (TLBEntry*) malloc(sizeof(TLBEntry) * s->sim_params->tlb_size);
+    s->tlb_read = (TLBEntry*) malloc(sizeof(TLBEntry) * s->sim_params->tlb_size);
+    s->tlb_write = (TLBEntry*) malloc(sizeof(TLBEntry) * s->sim_params->tlb_size);
+    assert(s->tlb_code);
+    assert(s->tlb_read);
+    assert(s->tlb_write);
+    tlb_init(s);
+}
+
 static void glue(riscv_cpu_end, MAX_XLEN)(RISCVCPUState *s)
 {
     free(s->tlb_code);
     free(s->tlb_read);
     free(s->tlb_write);
+    riscv_vector_free(s);
     riscv_sim_cpu_free(&s->simcpu);
     free(s);
 }
@@ -1488,7 +1861,8 @@ const RISCVCPUClass glue(riscv_cpu_class, MAX_XLEN) = {
 };
 
 //#if CONFIG_RISCV_MAX_XLEN == MAX_XLEN
-RISCVCPUState *riscv_cpu_init(PhysMemoryMap *mem_map, int max_xlen, const SimParams *p)
+RISCVCPUState *riscv_cpu_init(PhysMemoryMap *mem_map, int max_xlen, const SimParams *p,
+                              int hartid, RISCVCPUState *boot_cpu)
 {
     const RISCVCPUClass *c;
     switch(max_xlen) {
@@ -1517,6 +1891,6 @@ RISCVCPUState *riscv_cpu_init(PhysMemoryMap *mem_map, int max_xlen, const SimPar
     default:
         return NULL;
     }
-    return c->riscv_cpu_init(mem_map, p);
+    return c->riscv_cpu_init(mem_map, p, hartid, boot_cpu);
 }
 //#endif /* CONFIG_RISCV_MAX_XLEN == MAX_XLEN */
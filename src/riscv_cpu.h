@@ -53,7 +53,8 @@
 typedef struct RISCVCPUState RISCVCPUState;
 
 typedef struct {
-    RISCVCPUState *(*riscv_cpu_init)(PhysMemoryMap *mem_map, const SimParams *p);
+    RISCVCPUState *(*riscv_cpu_init)(PhysMemoryMap *mem_map, const SimParams *p,
+                                     int hartid, RISCVCPUState *boot_cpu);
     void (*riscv_cpu_end)(RISCVCPUState *s);
     void (*riscv_cpu_interp)(RISCVCPUState *s, int n_cycles);
     uint64_t (*riscv_cpu_get_cycles)(RISCVCPUState *s);
@@ -79,7 +80,9 @@ extern const RISCVCPUClass riscv_cpu_class32;
 extern const RISCVCPUClass riscv_cpu_class64;
 extern const RISCVCPUClass riscv_cpu_class128;
 
-RISCVCPUState *riscv_cpu_init(PhysMemoryMap *mem_map, int max_xlen, const SimParams *sim_params);
+RISCVCPUState *riscv_cpu_init(PhysMemoryMap *mem_map, int max_xlen,
+                              const SimParams *sim_params, int hartid,
+                              RISCVCPUState *boot_cpu);
 static inline void riscv_cpu_end(RISCVCPUState *s)
 {
     const RISCVCPUClass *c = ((RISCVCPUCommonState *)s)->class_ptr;
@@ -35,6 +35,7 @@
 #include <sys/time.h>
 #include <errno.h>
 #include <stdio.h>
+#include <pthread.h>
 #include "riscv_cpu.h"
 #include "cutils.h"
 
@@ -99,6 +100,7 @@
 #define MCPUID_D       (1 << ('D' - 'A'))
 #define MCPUID_Q       (1 << ('Q' - 'A'))
 #define MCPUID_C       (1 << ('C' - 'A'))
+#define MCPUID_V       (1 << ('V' - 'A'))
 
 /* mstatus CSR */
 
@@ -106,6 +108,7 @@
 #define MSTATUS_MPIE_SHIFT 7
 #define MSTATUS_SPP_SHIFT 8
 #define MSTATUS_MPP_SHIFT 11
+#define MSTATUS_VS_SHIFT 9
 #define MSTATUS_FS_SHIFT 13
 #define MSTATUS_UXL_SHIFT 32
 #define MSTATUS_SXL_SHIFT 34
@@ -119,7 +122,7 @@
 #define MSTATUS_HPIE (1 << 6)
 #define MSTATUS_MPIE (1 << MSTATUS_MPIE_SHIFT)
 #define MSTATUS_SPP (1 << MSTATUS_SPP_SHIFT)
-#define MSTATUS_HPP (3 << 9)
+#define MSTATUS_VS (3 << MSTATUS_VS_SHIFT) /* was HPP */
 #define MSTATUS_MPP (3 << MSTATUS_MPP_SHIFT)
 #define MSTATUS_FS (3 << MSTATUS_FS_SHIFT)
 #define MSTATUS_XS (3 << 15)
@@ -134,7 +137,12 @@
 
 #define PG_SHIFT 12
 #define PG_MASK ((1 << PG_SHIFT) - 1)
+/* The TLBs of the timing model have tlb_size entries and are only looked up
+   in simulation mode. The emulation translates with direct-mapped TLBs of a
+   fixed size, backed by small fully associative victim TLBs. */
 #define TLB_SIZE (s->sim_params->tlb_size)
+#define EMU_TLB_SIZE 256
+#define EMU_VICTIM_TLB_SIZE 8
 
 typedef struct {
     target_ulong vaddr;
@@ -142,6 +150,12 @@ typedef struct {
     target_ulong guest_paddr;
 } TLBEntry;
 
+typedef struct {
+    TLBEntry tlb[EMU_TLB_SIZE];
+    TLBEntry victim[EMU_VICTIM_TLB_SIZE];
+    int victim_next; /* victim entry replaced by the next eviction */
+} EmuTLB;
+
 typedef struct RISCVCPUState {
     RISCVCPUCommonState common; /* must be first */
     
@@ -160,6 +174,16 @@ typedef struct RISCVCPUState {
     uint8_t frm;
 #endif
     
+    /* Vector extension state, vreg is NULL (and vlenb 0) if the extension
+       is disabled, see riscv_vector.c */
+    uint32_t vlenb;
+    uint8_t *vreg;
+    target_ulong vl;
+    target_ulong vtype;
+    target_ulong vstart;
+    uint8_t vxrm;
+    uint8_t vxsat;
+
     uint8_t cur_xlen;  /* current XLEN value, <= MAX_XLEN */
     uint8_t priv; /* see PRV_x */
     uint8_t fs; /* MSTATUS_FS value */
@@ -185,6 +209,15 @@ typedef struct RISCVCPUState {
     uint32_t medeleg;
     uint32_t mideleg;
     uint32_t mcounteren;
+    uint32_t mcountinhibit;
+
+    /* Counter CSRs: cycle (0), instret (2) and mhpmcounter3..31, see
+       get_counter() */
+    target_ulong mhpmevent[32];
+    uint64_t mhpmcounter[32]; /* value when hpm_base was taken */
+    uint64_t hpm_base[32];    /* count of the counted source at that time */
+    uint64_t cycle_addend;    /* simulated cycles minus the instructions
+                                 simulated in the previous runs */
     
     target_ulong stvec;
     target_ulong sscratch;
@@ -200,12 +233,36 @@ typedef struct RISCVCPUState {
 
     target_ulong load_res; /* for atomic LR/SC */
 
+    /* Set if the harts run on host threads with lax synchronization: the
+       atomics are performed with host atomic operations on the guest RAM,
+       and a SC succeeds only if the memory still holds load_res_val read by
+       the LR. The device accesses of harts on host threads are serialized by
+       io_lock. */
+    BOOL host_atomics;
+    target_ulong load_res_val;
+    pthread_mutex_t *io_lock;
+
+    /* Set if one hart runs at a time, on one host thread or taking turns on
+       the host threads in deterministic mode: a store to the granule
+       reserved by another hart drops its reservation. The write TLB entries
+       of a reserved page are flushed in the other harts so that their stores
+       to it take the slow path. */
+    struct RISCVCPUState **harts;
+    int num_harts;
+    uint8_t *load_res_ptr; /* host address of the reservation, NULL if none */
+
     PhysMemoryMap *mem_map;
 
+    /* TLBs of the timing model */
     TLBEntry *tlb_read;
     TLBEntry *tlb_write;
     TLBEntry *tlb_code;
 
+    /* TLBs of the emulation */
+    EmuTLB emu_tlb_read;
+    EmuTLB emu_tlb_write;
+    EmuTLB emu_tlb_code;
+
     /* used to fetch instructions from TinyEMU memory map */
     uint8_t *code_ptr, *code_end;
     target_ulong code_to_pc_addend;
@@ -231,6 +288,36 @@ typedef struct RISCVCPUState {
 
 /* Note: Below declared functions are accessed from both simulation and emulation side */
 int get_insn_rm(RISCVCPUState *s, unsigned int rm);
+void riscv_cpu_save_hpm_counters(RISCVCPUState *s);
+
+/* Interrupts pending and enabled in the current privilege mode, also checked
+   by the simulator to return a hart in the pipeline to its emulator */
+static inline uint32_t get_pending_irq_mask(RISCVCPUState *s)
+{
+    uint32_t pending_ints, enabled_ints;
+
+    pending_ints = s->mip & s->mie;
+    if (pending_ints == 0)
+        return 0;
+
+    enabled_ints = 0;
+    switch(s->priv) {
+    case PRV_M:
+        if (s->mstatus & MSTATUS_MIE)
+            enabled_ints = ~s->mideleg;
+        break;
+    case PRV_S:
+        enabled_ints = ~s->mideleg;
+        if (s->mstatus & MSTATUS_SIE)
+            enabled_ints |= s->mideleg;
+        break;
+    default:
+    case PRV_U:
+        enabled_ints = -1;
+        break;
+    }
+    return pending_ints & enabled_ints;
+}
 
 no_inline __exception int
 target_read_insn_slow(RISCVCPUState *s, uint8_t **pptr, target_ulong addr);
@@ -242,34 +329,103 @@ uint32_t get_insn32(uint8_t *ptr);
 
 #define target_read_slow glue(glue(riscv, MAX_XLEN), _read_slow)
 #define target_write_slow glue(glue(riscv, MAX_XLEN), _write_slow)
+#define target_fill_tlb_write glue(glue(riscv, MAX_XLEN), _fill_tlb_write)
+#define target_set_sim_params glue(glue(riscv, MAX_XLEN), _set_sim_params)
+#define target_set_reservation glue(glue(riscv, MAX_XLEN), _set_reservation)
 
 DLL_PUBLIC int target_read_slow(RISCVCPUState *s, mem_uint_t *pval,
                                 target_ulong addr, int size_log2);
 DLL_PUBLIC int target_write_slow(RISCVCPUState *s, target_ulong addr,
                                  mem_uint_t val, int size_log2);
-
-/* return 0 if OK, != 0 if exception */
+DLL_PUBLIC int target_fill_tlb_write(RISCVCPUState *s, target_ulong addr,
+                                     int size_log2);
+DLL_PUBLIC void target_set_sim_params(RISCVCPUState *s, const SimParams *p);
+DLL_PUBLIC void target_set_reservation(RISCVCPUState *s, target_ulong addr);
+
+/* Load, store and atomic fast paths. The target_* ones are used by the
+   emulation and look up the emulation TLBs. The target_sim_* ones are used by
+   the simulator and look up the TLBs of the timing model, counting the
+   lookups and hits, and record the guest physical address of the access.
+   return 0 if OK, != 0 if exception */
 #define TARGET_READ_WRITE(size, uint_type, size_log2)                          \
     static inline __exception int target_read_u##size(                         \
         RISCVCPUState *s, uint_type *pval, target_ulong addr)                  \
     {                                                                          \
-        uint32_t tlb_idx;                                                      \
+        TLBEntry *e;                                                           \
                                                                                \
         s->is_device_io = 0;                                                   \
-        tlb_idx = (addr >> PG_SHIFT) & (TLB_SIZE - 1);                         \
-        if (s->simcpu->simulation)                                             \
+        e = &s->emu_tlb_read.tlb[(addr >> PG_SHIFT) & (EMU_TLB_SIZE - 1)];     \
+        if (likely(e->vaddr == (addr & ~(PG_MASK & ~((size / 8) - 1)))))       \
         {                                                                      \
-            ++s->simcpu->stats[s->priv].load_tlb_lookups;                      \
+            *pval = *(uint_type *)(e->mem_addend + (uintptr_t)addr);           \
         }                                                                      \
-        if (likely(s->tlb_read[tlb_idx].vaddr                                  \
-                   == (addr & ~(PG_MASK & ~((size / 8) - 1)))))                \
+        else                                                                   \
         {                                                                      \
-            *pval = *(uint_type *)(s->tlb_read[tlb_idx].mem_addend             \
-                                   + (uintptr_t)addr);                         \
-            if (s->simcpu->simulation)                                         \
-            {                                                                  \
-                ++s->simcpu->stats[s->priv].load_tlb_hits;                     \
-            }                                                                  \
+            mem_uint_t val;                                                    \
+            int ret;                                                           \
+            ret = target_read_slow(s, &val, addr, size_log2);                  \
+            if (ret)                                                           \
+                return ret;                                                    \
+            *pval = val;                                                       \
+        }                                                                      \
+        return 0;                                                              \
+    }                                                                          \
+                                                                               \
+    static inline __exception int target_write_u##size(                        \
+        RISCVCPUState *s, target_ulong addr, uint_type val)                    \
+    {                                                                          \
+        TLBEntry *e;                                                           \
+                                                                               \
+        s->is_device_io = 0;                                                   \
+        e = &s->emu_tlb_write.tlb[(addr >> PG_SHIFT) & (EMU_TLB_SIZE - 1)];    \
+        if (likely(e->vaddr == (addr & ~(PG_MASK & ~((size / 8) - 1)))))       \
+        {                                                                      \
+            *(uint_type *)(e->mem_addend + (uintptr_t)addr) = val;             \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            int ret;                                                           \
+            ret = target_write_slow(s, addr, val, size_log2);                  \
+            if (ret)                                                           \
+                return ret;                                                    \
+        }                                                                      \
+        return 0;                                                              \
+    }                                                                          \
+                                                                               \
+    /* Host address of the guest RAM location addr for an atomic operation, */ \
+    /* checked for store permission. *pptr is NULL if addr is not an aligned */ \
+    /* RAM address. */                                                         \
+    static inline __exception int target_get_atomic_ptr_u##size(               \
+        RISCVCPUState *s, uint_type **pptr, target_ulong addr)                 \
+    {                                                                          \
+        TLBEntry *e;                                                           \
+        int ret;                                                               \
+                                                                               \
+        *pptr = NULL;                                                          \
+        s->is_device_io = 0;                                                   \
+        e = &s->emu_tlb_write.tlb[(addr >> PG_SHIFT) & (EMU_TLB_SIZE - 1)];    \
+        if (unlikely(e->vaddr != (addr & ~(PG_MASK & ~((size / 8) - 1)))))     \
+        {                                                                      \
+            ret = target_fill_tlb_write(s, addr, size_log2);                   \
+            if (ret)                                                           \
+                return (ret < 0) ? ret : 0;                                    \
+        }                                                                      \
+        *pptr = (uint_type *)(e->mem_addend + (uintptr_t)addr);                \
+        return 0;                                                              \
+    }                                                                          \
+                                                                               \
+    static inline __exception int target_sim_read_u##size(                     \
+        RISCVCPUState *s, uint_type *pval, target_ulong addr)                  \
+    {                                                                          \
+        TLBEntry *e;                                                           \
+                                                                               \
+        s->is_device_io = 0;                                                   \
+        ++s->simcpu->stats[s->priv].load_tlb_lookups;                          \
+        e = &s->tlb_read[(addr >> PG_SHIFT) & (TLB_SIZE - 1)];                 \
+        if (likely(e->vaddr == (addr & ~(PG_MASK & ~((size / 8) - 1)))))       \
+        {                                                                      \
+            *pval = *(uint_type *)(e->mem_addend + (uintptr_t)addr);           \
+            ++s->simcpu->stats[s->priv].load_tlb_hits;                         \
         }                                                                      \
         else                                                                   \
         {                                                                      \
@@ -283,32 +439,23 @@ DLL_PUBLIC int target_write_slow(RISCVCPUState *s, target_ulong addr,
                                                                                \
         if (!s->is_device_io)                                                  \
         {                                                                      \
-            s->data_guest_paddr = s->tlb_read[tlb_idx].guest_paddr             \
-                                  + (addr - s->tlb_read[tlb_idx].vaddr);       \
+            s->data_guest_paddr = e->guest_paddr + (addr - e->vaddr);          \
         }                                                                      \
         return 0;                                                              \
     }                                                                          \
                                                                                \
-    static inline __exception int target_write_u##size(                        \
+    static inline __exception int target_sim_write_u##size(                    \
         RISCVCPUState *s, target_ulong addr, uint_type val)                    \
     {                                                                          \
-        uint32_t tlb_idx;                                                      \
+        TLBEntry *e;                                                           \
                                                                                \
         s->is_device_io = 0;                                                   \
-        tlb_idx = (addr >> PG_SHIFT) & (TLB_SIZE - 1);                         \
-        if (s->simcpu->simulation)                                             \
-        {                                                                      \
-            ++s->simcpu->stats[s->priv].store_tlb_lookups;                     \
-        }                                                                      \
-        if (likely(s->tlb_write[tlb_idx].vaddr                                 \
-                   == (addr & ~(PG_MASK & ~((size / 8) - 1)))))                \
+        ++s->simcpu->stats[s->priv].store_tlb_lookups;                         \
+        e = &s->tlb_write[(addr >> PG_SHIFT) & (TLB_SIZE - 1)];                \
+        if (likely(e->vaddr == (addr & ~(PG_MASK & ~((size / 8) - 1)))))       \
         {                                                                      \
-            *(uint_type *)(s->tlb_write[tlb_idx].mem_addend + (uintptr_t)addr) \
-                = val;                                                         \
-            if (s->simcpu->simulation)                                         \
-            {                                                                  \
-                ++s->simcpu->stats[s->priv].store_tlb_hits;                    \
-            }                                                                  \
+            *(uint_type *)(e->mem_addend + (uintptr_t)addr) = val;             \
+            ++s->simcpu->stats[s->priv].store_tlb_hits;                        \
         }                                                                      \
         else                                                                   \
         {                                                                      \
@@ -320,9 +467,34 @@ DLL_PUBLIC int target_write_slow(RISCVCPUState *s, target_ulong addr,
                                                                                \
         if (!s->is_device_io)                                                  \
         {                                                                      \
-            s->data_guest_paddr = s->tlb_write[tlb_idx].guest_paddr            \
-                                  + (addr - s->tlb_write[tlb_idx].vaddr);      \
+            s->data_guest_paddr = e->guest_paddr + (addr - e->vaddr);          \
+        }                                                                      \
+        return 0;                                                              \
+    }                                                                          \
+                                                                               \
+    static inline __exception int target_sim_get_atomic_ptr_u##size(           \
+        RISCVCPUState *s, uint_type **pptr, target_ulong addr)                 \
+    {                                                                          \
+        TLBEntry *e;                                                           \
+        int ret;                                                               \
+                                                                               \
+        *pptr = NULL;                                                          \
+        s->is_device_io = 0;                                                   \
+        ++s->simcpu->stats[s->priv].store_tlb_lookups;                         \
+        e = &s->tlb_write[(addr >> PG_SHIFT) & (TLB_SIZE - 1)];                \
+        if (likely(e->vaddr == (addr & ~(PG_MASK & ~((size / 8) - 1)))))       \
+        {                                                                      \
+            ++s->simcpu->stats[s->priv].store_tlb_hits;                        \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            ret = target_fill_tlb_write(s, addr, size_log2);                   \
+            if (ret)                                                           \
+                return (ret < 0) ? ret : 0;                                    \
         }                                                                      \
+                                                                               \
+        *pptr = (uint_type *)(e->mem_addend + (uintptr_t)addr);                \
+        s->data_guest_paddr = e->guest_paddr + (addr - e->vaddr);              \
         return 0;                                                              \
     }
 
@@ -290,9 +290,16 @@ static void no_inline glue(riscv_cpu_interp_x, XLEN)(RISCVCPUState *s,
                  * them here */
                 ++s->simcpu->stats[s->priv].ins_emulated;
 
+                if (s->simcpu->params->do_pipe_trace
+                    || s->simcpu->params->do_profile)
+                {
+                    trace_system_insn(s->simcpu);
+                }
+
                 /* Add the latency for system instructions */
                 s->simcpu->clock += s->simcpu->params->system_insn_latency;
                 s->simcpu->stats[s->simcpu->emu_cpu_state->priv].cycles += s->simcpu->params->system_insn_latency;
+                topdown_system_insn(s->simcpu, s->simcpu->emu_cpu_state->priv);
 
                 if (s->simcpu->params->do_sim_trace)
                 {
@@ -306,8 +313,9 @@ static void no_inline glue(riscv_cpu_interp_x, XLEN)(RISCVCPUState *s,
             {
                 /* We executed all the n_cycles instructions for this interval,
                  * and now we must exit to virt_machine_run() to receive
-                 * interrupts. */
-                sim_assert((s->n_cycles == 0),
+                 * interrupts. A fused pair committed last may overshoot the
+                 * interval by one instruction. */
+                sim_assert((s->n_cycles <= 0),
                            "error: %s at line %d in %s(): %s", __FILE__,
                            __LINE__, __func__, "sim timeout exception "
                                                "generated even though timeout "
@@ -340,6 +348,13 @@ static void no_inline glue(riscv_cpu_interp_x, XLEN)(RISCVCPUState *s,
                 /* Simulated user specified sim_emulate_after_icount instructions,
                  * now switch to emulation mode */
                 riscv_sim_cpu_stop(s->simcpu, s->pc);
+
+                /* The switch is deferred while the harts run on the host
+                 * threads, end the interval here */
+                if (s->simcpu->simulation)
+                {
+                    s->n_cycles = 0;
+                }
                 break;
             }
 
@@ -374,10 +389,11 @@ static void no_inline glue(riscv_cpu_interp_x, XLEN)(RISCVCPUState *s,
             }
     
             addr = s->pc;
-            tlb_idx = (addr >> PG_SHIFT) & (TLB_SIZE - 1);
-            if (likely(s->tlb_code[tlb_idx].vaddr == (addr & ~PG_MASK))) {
+            tlb_idx = (addr >> PG_SHIFT) & (EMU_TLB_SIZE - 1);
+            if (likely(s->emu_tlb_code.tlb[tlb_idx].vaddr ==
+                       (addr & ~PG_MASK))) {
                 /* TLB match */ 
-                ptr = (uint8_t *)(s->tlb_code[tlb_idx].mem_addend +
+                ptr = (uint8_t *)(s->emu_tlb_code.tlb[tlb_idx].mem_addend +
                                   (uintptr_t)addr);
             } else {
                 if (unlikely(target_read_insn_slow(s, &ptr, addr)))
@@ -1376,6 +1392,10 @@ static void no_inline glue(riscv_cpu_interp_x, XLEN)(RISCVCPUState *s,
                     case MODE_SIM_START: {
                         riscv_sim_cpu_start(s->simcpu, GET_PC() + 4);
                         s->pc = GET_PC() + 4;
+                        /* the harts of a multi-hart machine are stepped
+                           together in simulation mode, end the interval */
+                        if (s->simcpu->boot_hart->num_harts > 1)
+                            s->n_cycles = 0;
                         goto the_end;
                     }
                     case MODE_SIM_STOP: {
@@ -1508,7 +1528,7 @@ static void no_inline glue(riscv_cpu_interp_x, XLEN)(RISCVCPUState *s,
             funct3 = (insn >> 12) & 7;
 #define OP_A(size)                                                      \
             {                                                           \
-                uint ## size ##_t rval;                                 \
+                uint ## size ##_t rval, *aptr = NULL;                   \
                                                                         \
                 addr = s->reg[rs1];                                     \
                 funct3 = insn >> 27;                                    \
@@ -1519,16 +1539,27 @@ static void no_inline glue(riscv_cpu_interp_x, XLEN)(RISCVCPUState *s,
                     if (target_read_u ## size(s, &rval, addr))          \
                         goto mmu_exception;                             \
                     val = (int## size ## _t)rval;                       \
-                    s->load_res = addr;                                 \
+                    target_set_reservation(s, addr);                    \
+                    s->load_res_val = rval;                             \
                     break;                                              \
                 case 3: /* sc.w */                                      \
-                    if (s->load_res == addr) {                          \
+                    if (s->load_res == addr && s->host_atomics) {       \
+                        if (target_get_atomic_ptr_u ## size(s, &aptr, addr)) \
+                            goto mmu_exception;                         \
+                    }                                                   \
+                    if (aptr) {                                         \
+                        rval = s->load_res_val;                         \
+                        val = !__atomic_compare_exchange_n(aptr, &rval, \
+                            (uint ## size ## _t)s->reg[rs2], FALSE,     \
+                            __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);        \
+                    } else if (s->load_res == addr) {                   \
                         if (target_write_u ## size(s, addr, s->reg[rs2])) \
                             goto mmu_exception;                         \
                         val = 0;                                        \
                     } else {                                            \
                         val = 1;                                        \
                     }                                                   \
+                    s->load_res = (target_ulong)-1;                     \
                     break;                                              \
                 case 1: /* amiswap.w */                                 \
                 case 0: /* amoadd.w */                                  \
@@ -1539,7 +1570,14 @@ static void no_inline glue(riscv_cpu_interp_x, XLEN)(RISCVCPUState *s,
                 case 0x14: /* amomax.w */                               \
                 case 0x18: /* amominu.w */                              \
                 case 0x1c: /* amomaxu.w */                              \
-                    if (target_read_u ## size(s, &rval, addr))          \
+                    if (s->host_atomics) {                              \
+                        if (target_get_atomic_ptr_u ## size(s, &aptr, addr)) \
+                            goto mmu_exception;                         \
+                    }                                                   \
+                    do {                                                \
+                    if (aptr)                                           \
+                        rval = __atomic_load_n(aptr, __ATOMIC_SEQ_CST); \
+                    else if (target_read_u ## size(s, &rval, addr))     \
                         goto mmu_exception;                             \
                     val = (int## size ## _t)rval;                       \
                     val2 = s->reg[rs2];                                 \
@@ -1577,7 +1615,10 @@ static void no_inline glue(riscv_cpu_interp_x, XLEN)(RISCVCPUState *s,
                     default:                                            \
                         goto illegal_insn;                              \
                     }                                                   \
-                    if (target_write_u ## size(s, addr, val2))          \
+                    } while (aptr && !__atomic_compare_exchange_n(aptr, \
+                                 &rval, (uint ## size ## _t)val2, FALSE, \
+                                 __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));  \
+                    if (!aptr && target_write_u ## size(s, addr, val2)) \
                         goto mmu_exception;                             \
                     break;                                              \
                 default:                                                \
@@ -1608,6 +1649,8 @@ static void no_inline glue(riscv_cpu_interp_x, XLEN)(RISCVCPUState *s,
 #if FLEN > 0
             /* FPU */
         case 0x07: /* fp load */
+            if (riscv_vector_is_mem_width((insn >> 12) & 7))
+                goto vector_insn;
             if (s->fs == 0)
                 goto illegal_insn;
             funct3 = (insn >> 12) & 7;
@@ -1648,6 +1691,8 @@ static void no_inline glue(riscv_cpu_interp_x, XLEN)(RISCVCPUState *s,
             s->fs = 3;
             NEXT_INSN;
         case 0x27: /* fp store */
+            if (riscv_vector_is_mem_width((insn >> 12) & 7))
+                goto vector_insn;
             if (s->fs == 0)
                 goto illegal_insn;
             funct3 = (insn >> 12) & 7;
@@ -1836,6 +1881,15 @@ static void no_inline glue(riscv_cpu_interp_x, XLEN)(RISCVCPUState *s,
             }
             NEXT_INSN;
 #endif
+        case 0x57: /* vector */
+        vector_insn:
+            switch (riscv_vector_exec(s, insn, NULL, NULL, NULL)) {
+            case RVV_EXEC_ILLEGAL:
+                goto illegal_insn;
+            case RVV_EXEC_FAULT:
+                goto mmu_exception;
+            }
+            NEXT_INSN;
         default:
             goto illegal_insn;
         }
@@ -31,6 +31,8 @@
 #include <errno.h>
 #include <unistd.h>
 #include <time.h>
+#include <poll.h>
+#include <elf.h>
 
 #include "cutils.h"
 #include "iomem.h"
@@ -49,17 +51,34 @@ typedef struct RISCVMachine {
     VirtMachine common;
     PhysMemoryMap *mem_map;
     int max_xlen;
-    RISCVCPUState *cpu_state;
+    /* Harts are scheduled in round-robin order in emulation mode and
+       stepped together in simulation mode, cpu_state[0] is the boot hart */
+    int num_harts;
+    int hart_quantum;
+    RISCVCPUState *cpu_state[NUM_MAX_HARTS];
+    /* set if the harts run on host threads */
+    HartThreads *host_threads;
     uint64_t ram_size;
     /* RTC */
     BOOL rtc_real_time;
     RTC *rtc;
-    uint64_t timecmp;
+    uint64_t timecmp[NUM_MAX_HARTS];
     /* PLIC */
     uint32_t plic_pending_irq, plic_served_irq;
+    uint8_t plic_priority[31];
+    /* enabled sources and priority threshold of each context */
+    uint32_t plic_enable[2 * NUM_MAX_HARTS];
+    uint8_t plic_threshold[2 * NUM_MAX_HARTS];
     IRQSignal plic_irq[32]; /* IRQ 0 is not used */
     /* HTIF */
     uint64_t htif_tohost, htif_fromhost;
+    /* program break of a bare-metal ELF, between the end of its segments and
+       the stacks of the harts */
+    uint64_t htif_brk, htif_brk_start, htif_brk_end;
+    /* exit requested by a hart running on a host thread or in the cycle loop
+       of the harts, made once its step completes */
+    BOOL htif_exit_pending;
+    int htif_exit_code;
     /* UART */
     uint8_t uart_dll;
     uint8_t uart_dlm;
@@ -96,6 +115,9 @@ typedef struct RISCVMachine {
 #define PLIC_SIZE      0x00400000
 #define FRAMEBUFFER_BASE_ADDR 0x41000000
 
+/* stack of each hart of a bare-metal ELF, from the end of RAM */
+#define ELF_HART_STACK_SIZE (64 << 10)
+
 
 /***************************   RTC   ***************************/
 
@@ -107,13 +129,14 @@ static uint64_t rtc_get_time(RISCVMachine *m)
 {
     uint64_t val;
     if (m->rtc_real_time) {
-        if (riscv_cpu_in_simulation(m->cpu_state)) {
-            val = riscv_cpu_in_simulation_get_mtime(m->cpu_state);
+        /* During simulation, mtime follows the clock of the boot hart */
+        if (riscv_cpu_in_simulation(m->cpu_state[0])) {
+            val = riscv_cpu_in_simulation_get_mtime(m->cpu_state[0]);
         } else {
             val = rtc_get_elasped_time(m->rtc);
         }
     } else {
-        val = riscv_cpu_get_cycles(m->cpu_state) / RTC_FREQ_DIV;
+        val = riscv_cpu_get_cycles(m->cpu_state[0]) / RTC_FREQ_DIV;
     }
     //    printf("rtc_time=%" PRId64 "\n", val);
     return val;
@@ -300,6 +323,11 @@ void uart_rx_data(VirtMachine *v, uint8_t *buf, int size)
 }
 
 
+static uint8_t *get_ram_ptr(RISCVMachine *s, uint64_t paddr, BOOL is_rw)
+{
+    return phys_mem_get_ram_ptr(s->mem_map, paddr, is_rw);
+}
+
 /***************************   HTIF   ***************************/
 
 static uint32_t htif_read(void *opaque, uint32_t offset,
@@ -329,16 +357,142 @@ static uint32_t htif_read(void *opaque, uint32_t offset,
     return val;
 }
 
+/* Saves the stats of the simulation run before exiting. The harts running on
+   host threads stop once their step completes. */
+static void htif_exit(RISCVMachine *s, int exit_code)
+{
+    RISCVSIMCPUState *simcpu = s->cpu_state[0]->simcpu;
+
+    if (simcpu->simulation) {
+        riscv_sim_cpu_stop(simcpu, s->cpu_state[0]->pc);
+        if (simcpu->simulation) {
+            s->htif_exit_pending = TRUE;
+            s->htif_exit_code = exit_code;
+            return;
+        }
+    }
+    printf("\nPower off.\n");
+    exit(exit_code);
+}
+
+/* Returns the host address of len bytes of RAM at paddr, NULL if they are not
+   all in RAM */
+static uint8_t *htif_get_ram_buf(RISCVMachine *s, uint64_t paddr,
+                                 uint64_t len, BOOL is_rw)
+{
+    uint8_t *ptr;
+
+    ptr = get_ram_ptr(s, paddr, is_rw);
+    if (!ptr || len == 0)
+        return ptr;
+    if (paddr + len < paddr ||
+        get_ram_ptr(s, paddr + len - 1, FALSE) != ptr + len - 1)
+        return NULL;
+    return ptr;
+}
+
+/* read() blocks the simulation until the host has input, as stdin is non
+   blocking for the console */
+static int64_t htif_sys_read(RISCVMachine *s, uint64_t fd, uint64_t paddr,
+                             uint64_t len)
+{
+    struct pollfd pfd;
+    uint8_t *buf;
+    ssize_t ret;
+
+    if (fd != 0)
+        return -EBADF;
+    buf = htif_get_ram_buf(s, paddr, len, TRUE);
+    if (!buf)
+        return -EFAULT;
+    for(;;) {
+        ret = read(STDIN_FILENO, buf, len);
+        if (ret >= 0)
+            return ret;
+        if (errno != EAGAIN && errno != EINTR)
+            return -errno;
+        pfd.fd = STDIN_FILENO;
+        pfd.events = POLLIN;
+        poll(&pfd, 1, -1);
+    }
+}
+
+static int64_t htif_sys_write(RISCVMachine *s, uint64_t fd, uint64_t paddr,
+                              uint64_t len)
+{
+    uint8_t *buf;
+
+    if (fd != 1 && fd != 2)
+        return -EBADF;
+    buf = htif_get_ram_buf(s, paddr, len, FALSE);
+    if (!buf)
+        return -EFAULT;
+    s->common.console->write_data(s->common.console->opaque, buf, len);
+    return len;
+}
+
+/* Like Linux, brk() returns the current break if the new one is out of
+   range */
+static int64_t htif_sys_brk(RISCVMachine *s, uint64_t addr)
+{
+    if (addr >= s->htif_brk_start && addr <= s->htif_brk_end)
+        s->htif_brk = addr;
+    return s->htif_brk;
+}
+
+/* System call proxy of bare-metal programs, with the protocol of the RISC-V
+   frontend server: tohost holds the address of 8 64-bit words, the system
+   call number followed by its arguments, and the return value is written to
+   the first word before fromhost is set to 1 */
+static void htif_syscall(RISCVMachine *s, uint64_t paddr)
+{
+    uint64_t *args;
+    int64_t ret;
+
+    args = (uint64_t *)htif_get_ram_buf(s, paddr, 8 * sizeof(uint64_t), TRUE);
+    if (!args) {
+        printf("HTIF: invalid syscall arguments at 0x%016" PRIx64 "\n", paddr);
+        s->htif_tohost = 0;
+        return;
+    }
+
+    switch(args[0]) {
+    case 63: /* read */
+        ret = htif_sys_read(s, args[1], args[2], args[3]);
+        break;
+    case 64: /* write */
+        ret = htif_sys_write(s, args[1], args[2], args[3]);
+        break;
+    case 93: /* exit */
+        htif_exit(s, (int)args[1]);
+        ret = 0;
+        break;
+    case 214: /* brk */
+        ret = htif_sys_brk(s, args[1]);
+        break;
+    default:
+        ret = -ENOSYS;
+        break;
+    }
+    args[0] = ret;
+    s->htif_tohost = 0;
+    s->htif_fromhost = 1;
+}
+
 static void htif_handle_cmd(RISCVMachine *s)
 {
     uint32_t device, cmd;
+    uint64_t payload;
 
     device = s->htif_tohost >> 56;
     cmd = (s->htif_tohost >> 48) & 0xff;
-    if (s->htif_tohost == 1) {
-        /* shuthost */
-        printf("\nPower off.\n");
-        exit(0);
+    payload = s->htif_tohost & (((uint64_t)1 << 48) - 1);
+    if (device == 0 && cmd == 0 && (payload & 1)) {
+        /* shuthost, with the exit code in the upper bits */
+        s->htif_tohost = 0;
+        htif_exit(s, (int)(payload >> 1));
+    } else if (device == 0 && cmd == 0 && payload) {
+        htif_syscall(s, payload);
     } else if (device == 1 && cmd == 1) {
         console_write_char(s, s->htif_tohost & 0xff);
         s->htif_tohost = 0;
@@ -396,25 +550,40 @@ static void htif_poll(RISCVMachine *s)
 
 /***************************   CLINT   ***************************/
 
+/* Per-hart registers: msip at CLINT_MSIP_BASE + 4 * hartid and mtimecmp at
+   CLINT_TIMECMP_BASE + 8 * hartid */
+#define CLINT_MSIP_BASE    0x0000
+#define CLINT_TIMECMP_BASE 0x4000
+#define CLINT_MTIME        0xbff8
+
 static uint32_t clint_read(void *opaque, uint32_t offset, int size_log2)
 {
     RISCVMachine *m = opaque;
     uint32_t val;
+    int hartid;
 
     assert(size_log2 == 2);
+    if (offset >= CLINT_TIMECMP_BASE &&
+        offset < CLINT_TIMECMP_BASE + 8 * m->num_harts) {
+        hartid = (offset - CLINT_TIMECMP_BASE) >> 3;
+        if (offset & 4)
+            val = m->timecmp[hartid] >> 32;
+        else
+            val = m->timecmp[hartid];
+        return val;
+    }
+    if (offset < CLINT_MSIP_BASE + 4 * m->num_harts) {
+        hartid = (offset - CLINT_MSIP_BASE) >> 2;
+        val = (riscv_cpu_get_mip(m->cpu_state[hartid]) & MIP_MSIP) != 0;
+        return val;
+    }
     switch(offset) {
-    case 0xbff8:
+    case CLINT_MTIME:
         val = rtc_get_time(m);
         break;
-    case 0xbffc:
+    case CLINT_MTIME + 4:
         val = rtc_get_time(m) >> 32;
         break;
-    case 0x4000:
-        val = m->timecmp;
-        break;
-    case 0x4004:
-        val = m->timecmp >> 32;
-        break;
     default:
         val = 0;
         break;
@@ -426,64 +595,114 @@ static void clint_write(void *opaque, uint32_t offset, uint32_t val,
                       int size_log2)
 {
     RISCVMachine *m = opaque;
+    int hartid;
 
     assert(size_log2 == 2);
-    switch(offset) {
-    case 0x4000:
-        m->timecmp = (m->timecmp & ~0xffffffff) | val;
-        riscv_cpu_reset_mip(m->cpu_state, MIP_MTIP);
-        break;
-    case 0x4004:
-        m->timecmp = (m->timecmp & 0xffffffff) | ((uint64_t)val << 32);
-        riscv_cpu_reset_mip(m->cpu_state, MIP_MTIP);
-        break;
-    default:
-        break;
+    if (offset >= CLINT_TIMECMP_BASE &&
+        offset < CLINT_TIMECMP_BASE + 8 * m->num_harts) {
+        hartid = (offset - CLINT_TIMECMP_BASE) >> 3;
+        if (offset & 4)
+            m->timecmp[hartid] = (m->timecmp[hartid] & 0xffffffff) |
+                ((uint64_t)val << 32);
+        else
+            m->timecmp[hartid] = (m->timecmp[hartid] & ~0xffffffff) | val;
+        riscv_cpu_reset_mip(m->cpu_state[hartid], MIP_MTIP);
+    } else if (offset < CLINT_MSIP_BASE + 4 * m->num_harts) {
+        /* inter-processor interrupt */
+        hartid = (offset - CLINT_MSIP_BASE) >> 2;
+        if (val & 1)
+            riscv_cpu_set_mip(m->cpu_state[hartid], MIP_MSIP);
+        else
+            riscv_cpu_reset_mip(m->cpu_state[hartid], MIP_MSIP);
     }
 }
 
 
 /***************************   PLIC   ***************************/
 
-static void plic_update_mip(RISCVMachine *s)
+/* Each hart has two contexts, 2 * hartid for the S-mode and 2 * hartid + 1 for
+   the M-mode, in the order of the interrupts-extended property of the device
+   tree. A context raises its external interrupt if a pending source, not
+   claimed yet, is enabled for it with a priority above its threshold. */
+#define PLIC_PRIORITY_BASE 0x000000
+#define PLIC_PENDING_BASE  0x001000
+#define PLIC_ENABLE_BASE   0x002000
+#define PLIC_ENABLE_SIZE   0x80
+#define PLIC_HART_BASE     0x200000
+#define PLIC_HART_SIZE     0x1000
+#define PLIC_PRIORITY_MASK 7
+
+/* return the index of the source to serve for context ctx, -1 if none */
+static int plic_get_irq(RISCVMachine *s, int ctx)
 {
-    RISCVCPUState *cpu = s->cpu_state;
     uint32_t mask;
-    mask = s->plic_pending_irq & ~s->plic_served_irq;
-    if (mask) {
-        riscv_cpu_set_mip(cpu, MIP_MEIP | MIP_SEIP);
-    } else {
-        riscv_cpu_reset_mip(cpu, MIP_MEIP | MIP_SEIP);
+    int i, irq, priority;
+
+    mask = s->plic_pending_irq & ~s->plic_served_irq & s->plic_enable[ctx];
+    irq = -1;
+    priority = s->plic_threshold[ctx];
+    while (mask != 0) {
+        i = ctz32(mask);
+        if (s->plic_priority[i] > priority) {
+            irq = i;
+            priority = s->plic_priority[i];
+        }
+        mask &= mask - 1;
     }
+    return irq;
 }
 
-#define PLIC_HART_BASE 0x200000
-#define PLIC_HART_SIZE 0x1000
+static void plic_update_mip(RISCVMachine *s)
+{
+    int i;
+    for(i = 0; i < s->num_harts; i++) {
+        if (plic_get_irq(s, 2 * i) >= 0)
+            riscv_cpu_set_mip(s->cpu_state[i], MIP_SEIP);
+        else
+            riscv_cpu_reset_mip(s->cpu_state[i], MIP_SEIP);
+        if (plic_get_irq(s, 2 * i + 1) >= 0)
+            riscv_cpu_set_mip(s->cpu_state[i], MIP_MEIP);
+        else
+            riscv_cpu_reset_mip(s->cpu_state[i], MIP_MEIP);
+    }
+}
 
+/* The registers of the source IRQ n (1 to 31) are in bit or entry n, the
+   state of source n is in bit n - 1 of the masks of the machine */
 static uint32_t plic_read(void *opaque, uint32_t offset, int size_log2)
 {
     RISCVMachine *s = opaque;
-    uint32_t val, mask;
-    int i;
+    uint32_t val;
+    int ctx, irq;
+    
     assert(size_log2 == 2);
-    switch(offset) {
-    case PLIC_HART_BASE:
-        val = 0;
-        break;
-    case PLIC_HART_BASE + 4:
-        mask = s->plic_pending_irq & ~s->plic_served_irq;
-        if (mask != 0) {
-            i = ctz32(mask);
-            s->plic_served_irq |= 1 << i;
-            plic_update_mip(s);
-            val = i + 1;
-        } else {
-            val = 0;
+    val = 0;
+    if (offset >= PLIC_HART_BASE) {
+        ctx = (offset - PLIC_HART_BASE) / PLIC_HART_SIZE;
+        if (ctx >= 2 * s->num_harts)
+            return 0;
+        switch(offset & (PLIC_HART_SIZE - 1)) {
+        case 0: /* threshold */
+            val = s->plic_threshold[ctx];
+            break;
+        case 4: /* claim */
+            irq = plic_get_irq(s, ctx);
+            if (irq >= 0) {
+                s->plic_served_irq |= 1 << irq;
+                plic_update_mip(s);
+                val = irq + 1;
+            }
+            break;
         }
-        break;
-    default:
-        val = 0;
-        break;
+    } else if (offset >= PLIC_ENABLE_BASE) {
+        ctx = (offset - PLIC_ENABLE_BASE) / PLIC_ENABLE_SIZE;
+        if (ctx < 2 * s->num_harts &&
+            (offset & (PLIC_ENABLE_SIZE - 1)) == 0)
+            val = s->plic_enable[ctx] << 1;
+    } else if (offset == PLIC_PENDING_BASE) {
+        val = s->plic_pending_irq << 1;
+    } else if (offset > PLIC_PRIORITY_BASE && offset < 32 * 4) {
+        val = s->plic_priority[(offset >> 2) - 1];
     }
     return val;
 }
@@ -492,19 +711,37 @@ static void plic_write(void *opaque, uint32_t offset, uint32_t val,
                        int size_log2)
 {
     RISCVMachine *s = opaque;
+    int ctx;
     
     assert(size_log2 == 2);
-    switch(offset) {
-    case PLIC_HART_BASE + 4:
-        val--;
-        if (val < 32) {
-            s->plic_served_irq &= ~(1 << val);
-            plic_update_mip(s);
+    if (offset >= PLIC_HART_BASE) {
+        ctx = (offset - PLIC_HART_BASE) / PLIC_HART_SIZE;
+        if (ctx >= 2 * s->num_harts)
+            return;
+        switch(offset & (PLIC_HART_SIZE - 1)) {
+        case 0: /* threshold */
+            s->plic_threshold[ctx] = val & PLIC_PRIORITY_MASK;
+            break;
+        case 4: /* complete */
+            val--;
+            if (val < 32)
+                s->plic_served_irq &= ~(1 << val);
+            break;
+        default:
+            return;
         }
-        break;
-    default:
-        break;
+    } else if (offset >= PLIC_ENABLE_BASE) {
+        ctx = (offset - PLIC_ENABLE_BASE) / PLIC_ENABLE_SIZE;
+        if (ctx >= 2 * s->num_harts ||
+            (offset & (PLIC_ENABLE_SIZE - 1)) != 0)
+            return;
+        s->plic_enable[ctx] = val >> 1;
+    } else if (offset > PLIC_PRIORITY_BASE && offset < 32 * 4) {
+        s->plic_priority[(offset >> 2) - 1] = val & PLIC_PRIORITY_MASK;
+    } else {
+        return;
     }
+    plic_update_mip(s);
 }
 
 static void plic_set_irq(void *opaque, int irq_num, int state)
@@ -521,13 +758,6 @@ static void plic_set_irq(void *opaque, int irq_num, int state)
 }
 
 
-/***************************   MISC   ***************************/
-static uint8_t *get_ram_ptr(RISCVMachine *s, uint64_t paddr, BOOL is_rw)
-{
-    return phys_mem_get_ram_ptr(s->mem_map, paddr, is_rw);
-}
-
-
 /***************************   FDT   ***************************/
 
 /* FDT machine description */
@@ -802,10 +1032,11 @@ static int riscv_build_fdt(RISCVMachine *m, uint8_t *dst,
                            const char *cmd_line)
 {
     FDTState *s;
-    int size, max_xlen, i, cur_phandle, intc_phandle, plic_phandle;
+    int size, max_xlen, i, hartid, cur_phandle, plic_phandle;
+    int intc_phandle[NUM_MAX_HARTS];
     char isa_string[128], *q;
     uint32_t misa;
-    uint32_t tab[4];
+    uint32_t tab[4 * NUM_MAX_HARTS];
     FBDevice *fb_dev;
     
     s = fdt_init();
@@ -824,15 +1055,8 @@ static int riscv_build_fdt(RISCVMachine *m, uint8_t *dst,
     fdt_prop_u32(s, "#size-cells", 0);
     fdt_prop_u32(s, "timebase-frequency", m->rtc->freq);
 
-    /* cpu */
-    fdt_begin_node_num(s, "cpu", 0);
-    fdt_prop_str(s, "device_type", "cpu");
-    fdt_prop_u32(s, "reg", 0);
-    fdt_prop_str(s, "status", "okay");
-    fdt_prop_str(s, "compatible", "riscv");
-
     max_xlen = m->max_xlen;
-    misa = riscv_cpu_get_misa(m->cpu_state);
+    misa = riscv_cpu_get_misa(m->cpu_state[0]);
     q = isa_string;
     q += snprintf(isa_string, sizeof(isa_string), "rv%d", max_xlen);
     for(i = 0; i < 26; i++) {
@@ -840,21 +1064,30 @@ static int riscv_build_fdt(RISCVMachine *m, uint8_t *dst,
             *q++ = 'a' + i;
     }
     *q = '\0';
-    fdt_prop_str(s, "riscv,isa", isa_string);
-    
-    fdt_prop_str(s, "mmu-type", max_xlen <= 32 ? "riscv,sv32" : "riscv,sv48");
-    fdt_prop_u32(s, "clock-frequency", (m->common.virt_machine_params->sim_params->cpu_freq_mhz * 1000000));
 
-    fdt_begin_node(s, "interrupt-controller");
-    fdt_prop_u32(s, "#interrupt-cells", 1);
-    fdt_prop(s, "interrupt-controller", NULL, 0);
-    fdt_prop_str(s, "compatible", "riscv,cpu-intc");
-    intc_phandle = cur_phandle++;
-    fdt_prop_u32(s, "phandle", intc_phandle);
-    fdt_end_node(s); /* interrupt-controller */
-    
-    fdt_end_node(s); /* cpu */
-    
+    for(hartid = 0; hartid < m->num_harts; hartid++) {
+        /* cpu */
+        fdt_begin_node_num(s, "cpu", hartid);
+        fdt_prop_str(s, "device_type", "cpu");
+        fdt_prop_u32(s, "reg", hartid);
+        fdt_prop_str(s, "status", "okay");
+        fdt_prop_str(s, "compatible", "riscv");
+        fdt_prop_str(s, "riscv,isa", isa_string);
+
+        fdt_prop_str(s, "mmu-type", max_xlen <= 32 ? "riscv,sv32" : "riscv,sv48");
+        fdt_prop_u32(s, "clock-frequency", (m->common.virt_machine_params->sim_params->cpu_freq_mhz * 1000000));
+
+        fdt_begin_node(s, "interrupt-controller");
+        fdt_prop_u32(s, "#interrupt-cells", 1);
+        fdt_prop(s, "interrupt-controller", NULL, 0);
+        fdt_prop_str(s, "compatible", "riscv,cpu-intc");
+        intc_phandle[hartid] = cur_phandle++;
+        fdt_prop_u32(s, "phandle", intc_phandle[hartid]);
+        fdt_end_node(s); /* interrupt-controller */
+
+        fdt_end_node(s); /* cpu */
+    }
+
     fdt_end_node(s); /* cpus */
 
     fdt_begin_node_num(s, "memory", RAM_BASE_ADDR);
@@ -866,7 +1099,51 @@ static int riscv_build_fdt(RISCVMachine *m, uint8_t *dst,
     fdt_prop_tab_u32(s, "reg", tab, 4);
     
     fdt_end_node(s); /* memory */
-    
+
+    /* SBI PMU events of the firmware mapped to the events of the
+       mhpmcounters, the raw events are the mhpmevent values */
+    {
+        static const uint32_t event_to_mhpmevent[] = {
+            0x00004, 0, HPM_EVENT_L2_MISS,           /* cache misses */
+            0x00005, 0, HPM_EVENT_BRANCH,            /* branches */
+            0x00006, 0, HPM_EVENT_BRANCH_MISPREDICT, /* branch misses */
+            0x00008, 0, HPM_EVENT_INSN_MEM_STALL,    /* frontend stalls */
+            0x00009, 0, HPM_EVENT_DATA_MEM_STALL,    /* backend stalls */
+            0x10001, 0, HPM_EVENT_DCACHE_READ_MISS,  /* L1D read miss */
+            0x10003, 0, HPM_EVENT_DCACHE_WRITE_MISS, /* L1D write miss */
+            0x10009, 0, HPM_EVENT_ICACHE_MISS,       /* L1I read miss */
+            0x10011, 0, HPM_EVENT_L2_MISS,           /* LL read miss */
+            0x10019, 0, HPM_EVENT_DTLB_MISS,         /* DTLB read miss */
+            0x10021, 0, HPM_EVENT_ITLB_MISS,         /* ITLB read miss */
+        };
+        static const uint32_t event_to_mhpmcounters[] = {
+            0x00004, 0x00006, HPM_COUNTERS_MASK,
+            0x00008, 0x00009, HPM_COUNTERS_MASK,
+            0x10001, 0x10001, HPM_COUNTERS_MASK,
+            0x10003, 0x10003, HPM_COUNTERS_MASK,
+            0x10009, 0x10009, HPM_COUNTERS_MASK,
+            0x10011, 0x10011, HPM_COUNTERS_MASK,
+            0x10019, 0x10019, HPM_COUNTERS_MASK,
+            0x10021, 0x10021, HPM_COUNTERS_MASK,
+        };
+        static const uint32_t raw_event_to_mhpmcounters[] = {
+            0, 0, 0xffffffff, ~(uint32_t)HPM_EVENT_MASK, HPM_COUNTERS_MASK,
+        };
+
+        fdt_begin_node(s, "pmu");
+        fdt_prop_str(s, "compatible", "riscv,pmu");
+        fdt_prop_tab_u32(s, "riscv,event-to-mhpmevent",
+                         (uint32_t *)event_to_mhpmevent,
+                         countof(event_to_mhpmevent));
+        fdt_prop_tab_u32(s, "riscv,event-to-mhpmcounters",
+                         (uint32_t *)event_to_mhpmcounters,
+                         countof(event_to_mhpmcounters));
+        fdt_prop_tab_u32(s, "riscv,raw-event-to-mhpmcounters",
+                         (uint32_t *)raw_event_to_mhpmcounters,
+                         countof(raw_event_to_mhpmcounters));
+        fdt_end_node(s); /* pmu */
+    }
+
     fdt_begin_node(s, "soc");
     fdt_prop_u32(s, "#address-cells", 2);
     fdt_prop_u32(s, "#size-cells", 2);
@@ -877,11 +1154,13 @@ static int riscv_build_fdt(RISCVMachine *m, uint8_t *dst,
     fdt_begin_node_num(s, "clint", CLINT_BASE_ADDR);
     fdt_prop_str(s, "compatible", "riscv,clint0");
 
-    tab[0] = intc_phandle;
-    tab[1] = 3; /* M IPI irq */
-    tab[2] = intc_phandle;
-    tab[3] = 7; /* M timer irq */
-    fdt_prop_tab_u32(s, "interrupts-extended", tab, 4);
+    for(hartid = 0; hartid < m->num_harts; hartid++) {
+        tab[4 * hartid] = intc_phandle[hartid];
+        tab[4 * hartid + 1] = 3; /* M IPI irq */
+        tab[4 * hartid + 2] = intc_phandle[hartid];
+        tab[4 * hartid + 3] = 7; /* M timer irq */
+    }
+    fdt_prop_tab_u32(s, "interrupts-extended", tab, 4 * m->num_harts);
 
     fdt_prop_tab_u64_2(s, "reg", CLINT_BASE_ADDR, CLINT_SIZE);
     
@@ -894,11 +1173,13 @@ static int riscv_build_fdt(RISCVMachine *m, uint8_t *dst,
     fdt_prop_u32(s, "riscv,ndev", 31);
     fdt_prop_tab_u64_2(s, "reg", PLIC_BASE_ADDR, PLIC_SIZE);
 
-    tab[0] = intc_phandle;
-    tab[1] = 9; /* S ext irq */
-    tab[2] = intc_phandle;
-    tab[3] = 11; /* M ext irq */
-    fdt_prop_tab_u32(s, "interrupts-extended", tab, 4);
+    for(hartid = 0; hartid < m->num_harts; hartid++) {
+        tab[4 * hartid] = intc_phandle[hartid];
+        tab[4 * hartid + 1] = 9; /* S ext irq */
+        tab[4 * hartid + 2] = intc_phandle[hartid];
+        tab[4 * hartid + 3] = 11; /* M ext irq */
+    }
+    fdt_prop_tab_u32(s, "interrupts-extended", tab, 4 * m->num_harts);
 
     plic_phandle = cur_phandle++;
     fdt_prop_u32(s, "phandle", plic_phandle);
@@ -1075,11 +1356,122 @@ static void copy_bios(RISCVMachine *s, const uint8_t *buf, int buf_len,
     q[4] = 0x00028067; /* jalr zero, t0, jump_addr */
 }
 
+/* Copies the loadable segments of a static RISC-V ELF executable to RAM and
+   returns its entry point. The program break starts after the segments. */
+static uint64_t load_elf(RISCVMachine *s, const uint8_t *buf, int buf_len)
+{
+    const Elf64_Ehdr *eh64 = (const Elf64_Ehdr *)buf;
+    const Elf32_Ehdr *eh32 = (const Elf32_Ehdr *)buf;
+    uint64_t entry, phoff, paddr, offset, filesz, memsz, end;
+    int i, phnum, is_elf64;
+    uint32_t type;
+    uint8_t *ram_ptr;
+
+    if (buf_len < sizeof(Elf32_Ehdr) || memcmp(buf, ELFMAG, SELFMAG) != 0) {
+        vm_error("ELF: not an ELF file\n");
+        exit(1);
+    }
+    is_elf64 = (buf[EI_CLASS] == ELFCLASS64);
+    if ((is_elf64 && buf_len < sizeof(Elf64_Ehdr)) ||
+        (is_elf64 ? (eh64->e_machine != EM_RISCV || eh64->e_type != ET_EXEC)
+                  : (eh32->e_machine != EM_RISCV || eh32->e_type != ET_EXEC))) {
+        vm_error("ELF: not a static RISC-V executable\n");
+        exit(1);
+    }
+    if ((is_elf64 ? 64 : 32) > s->max_xlen) {
+        vm_error("ELF: %d-bit executable on a %d-bit machine\n",
+                 is_elf64 ? 64 : 32, s->max_xlen);
+        exit(1);
+    }
+
+    entry = is_elf64 ? eh64->e_entry : eh32->e_entry;
+    phoff = is_elf64 ? eh64->e_phoff : eh32->e_phoff;
+    phnum = is_elf64 ? eh64->e_phnum : eh32->e_phnum;
+    if (phoff + (uint64_t)phnum * (is_elf64 ? sizeof(Elf64_Phdr)
+                                            : sizeof(Elf32_Phdr)) > buf_len) {
+        vm_error("ELF: truncated program headers\n");
+        exit(1);
+    }
+
+    end = RAM_BASE_ADDR;
+    for(i = 0; i < phnum; i++) {
+        if (is_elf64) {
+            const Elf64_Phdr *ph = (const Elf64_Phdr *)(buf + phoff) + i;
+            type = ph->p_type;
+            paddr = ph->p_paddr;
+            offset = ph->p_offset;
+            filesz = ph->p_filesz;
+            memsz = ph->p_memsz;
+        } else {
+            const Elf32_Phdr *ph = (const Elf32_Phdr *)(buf + phoff) + i;
+            type = ph->p_type;
+            paddr = ph->p_paddr;
+            offset = ph->p_offset;
+            filesz = ph->p_filesz;
+            memsz = ph->p_memsz;
+        }
+        if (type != PT_LOAD || memsz == 0)
+            continue;
+        if (filesz > memsz || offset + filesz > buf_len ||
+            paddr < RAM_BASE_ADDR ||
+            paddr + memsz > RAM_BASE_ADDR + s->ram_size) {
+            vm_error("ELF: segment at 0x%" PRIx64 " does not fit in RAM\n",
+                     paddr);
+            exit(1);
+        }
+        ram_ptr = get_ram_ptr(s, paddr, TRUE);
+        memcpy(ram_ptr, buf + offset, filesz);
+        memset(ram_ptr + filesz, 0, memsz - filesz);
+        if (paddr + memsz > end)
+            end = paddr + memsz;
+    }
+
+    s->htif_brk_start = (end + DEVRAM_PAGE_SIZE - 1) &
+        ~(uint64_t)(DEVRAM_PAGE_SIZE - 1);
+    s->htif_brk = s->htif_brk_start;
+    s->htif_brk_end = RAM_BASE_ADDR + s->ram_size -
+        (uint64_t)s->num_harts * ELF_HART_STACK_SIZE;
+    if (s->htif_brk_end < s->htif_brk_start)
+        s->htif_brk_end = s->htif_brk_start;
+    return entry;
+}
+
 static void riscv_flush_tlb_write_range(void *opaque, uint8_t *ram_addr,
                                         size_t ram_size)
 {
     RISCVMachine *s = opaque;
-    riscv_cpu_flush_tlb_write_range_ram(s->cpu_state, ram_addr, ram_size);
+    int i;
+    for(i = 0; i < s->num_harts; i++)
+        riscv_cpu_flush_tlb_write_range_ram(s->cpu_state[i], ram_addr, ram_size);
+}
+
+/* Runs n_cycles instructions on a hart, on its own host thread: see
+   riscv_machine_interp() */
+static void riscv_machine_run_hart(void *opaque, int hartid, int n_cycles)
+{
+    RISCVMachine *s = opaque;
+    RISCVCPUState *cpu = s->cpu_state[hartid];
+    int quantum;
+
+    if (riscv_cpu_in_simulation(cpu)) {
+        riscv_sim_cpu_run_hart(cpu->simcpu);
+        return;
+    }
+
+    while (n_cycles > 0) {
+        /* the harts switch mode together once the step is done */
+        if (cpu->simcpu->boot_hart->mode_switch_pending)
+            break;
+        /* an interrupt may have been raised by another hart while this
+           hart was entering power down */
+        if (cpu->power_down_flag && (riscv_cpu_get_mip(cpu) & cpu->mie) != 0)
+            cpu->power_down_flag = FALSE;
+        quantum = min_int(n_cycles, s->hart_quantum);
+        riscv_cpu_interp(cpu, quantum);
+        n_cycles -= quantum;
+        if (n_cycles > 0)
+            hart_threads_yield(s->host_threads, hartid);
+    }
 }
 
 static void riscv_machine_set_defaults(VirtMachineParams *p)
@@ -1091,6 +1483,7 @@ static VirtMachine *riscv_machine_init(const VirtMachineParams *p)
     RISCVMachine *s;
     VIRTIODevice *blk_dev;
     int irq_num, i, max_xlen, ram_flags;
+    uint64_t entry;
     VIRTIOBusDef vbus_s, *vbus = &vbus_s;
 
 
@@ -1119,19 +1512,32 @@ static VirtMachine *riscv_machine_init(const VirtMachineParams *p)
     /* Validate all the simulation parameters before initializing core */
     sim_params_validate(p->sim_params);
 
-    s->cpu_state = riscv_cpu_init(s->mem_map, max_xlen, p->sim_params);
-    if (!s->cpu_state) {
-        vm_error("unsupported max_xlen=%d\n", max_xlen);
-        /* XXX: should free resources */
-        return NULL;
+    s->num_harts = p->sim_params->num_harts;
+    s->hart_quantum = p->sim_params->hart_quantum;
+    for(i = 0; i < s->num_harts; i++) {
+        s->cpu_state[i] = riscv_cpu_init(s->mem_map, max_xlen, p->sim_params,
+                                         i, i ? s->cpu_state[0] : NULL);
+        if (!s->cpu_state[i]) {
+            vm_error("unsupported max_xlen=%d\n", max_xlen);
+            /* XXX: should free resources */
+            return NULL;
+        }
     }
     /* RAM */
     ram_flags = 0;
-    cpu_register_ram(s->mem_map, RAM_BASE_ADDR, p->ram_size, ram_flags);
+    if (p->ram_huge_pages)
+        ram_flags |= DEVRAM_FLAG_HUGE_PAGES;
+    if (p->ram_file) {
+        cpu_register_ram_file(s->mem_map, RAM_BASE_ADDR, p->ram_size,
+                              ram_flags, p->ram_file);
+    } else {
+        cpu_register_ram(s->mem_map, RAM_BASE_ADDR, p->ram_size, ram_flags);
+    }
     cpu_register_ram(s->mem_map, 0x00000000, LOW_RAM_SIZE, 0);
     s->rtc_real_time = p->rtc_real_time;
     s->rtc = rtc_init(p->sim_params->rtc_freq_mhz * 1000000);
-    s->cpu_state->rtc = s->rtc;
+    for(i = 0; i < s->num_harts; i++)
+        s->cpu_state[i]->rtc = s->rtc;
 
     cpu_register_device(s->mem_map, CLINT_BASE_ADDR, CLINT_SIZE, s,
                         clint_read, clint_write, DEVIO_SIZE32);
@@ -1152,8 +1558,9 @@ static VirtMachine *riscv_machine_init(const VirtMachineParams *p)
     vbus->addr = VIRTIO_BASE_ADDR;
     irq_num = VIRTIO_IRQ;
     
-    /* virtio console */
-    if (p->console) {
+    /* virtio console, a bare-metal ELF writes to the console through HTIF
+       and reads stdin directly */
+    if (p->console && !p->sim_params->elf_file) {
         vbus->irq = &s->plic_irq[irq_num];
         s->common.console_dev = virtio_console_init(vbus, p->console);
         vbus->addr += VIRTIO_SIZE;
@@ -1235,7 +1642,18 @@ static VirtMachine *riscv_machine_init(const VirtMachineParams *p)
         vm_error("No bios found");
     }
 
-    if (p->files[VM_FILE_KERNEL].buf|| p->files[VM_FILE_INITRD].buf) {
+    if (p->sim_params->elf_file) {
+        /* harts start at the entry point with a0 = mhartid and the stack
+           at the end of RAM */
+        entry = load_elf(s, p->files[VM_FILE_BIOS].buf,
+                         p->files[VM_FILE_BIOS].len);
+        for(i = 0; i < s->num_harts; i++) {
+            s->cpu_state[i]->pc = entry;
+            s->cpu_state[i]->reg[10] = i;
+            s->cpu_state[i]->reg[2] = RAM_BASE_ADDR + s->ram_size -
+                (uint64_t)i * ELF_HART_STACK_SIZE;
+        }
+    } else if (p->files[VM_FILE_KERNEL].buf|| p->files[VM_FILE_INITRD].buf) {
         copy_bios(s, p->files[VM_FILE_BIOS].buf, p->files[VM_FILE_BIOS].len,
                   p->files[VM_FILE_KERNEL].buf, p->files[VM_FILE_KERNEL].len,
                   p->files[VM_FILE_INITRD].buf, p->files[VM_FILE_INITRD].len,
@@ -1245,10 +1663,33 @@ static VirtMachine *riscv_machine_init(const VirtMachineParams *p)
                 p->cmdline);
     }
 
-    /* We are booting TinyEMU in simulation mode */
-    if (p->sim_params->start_in_sim)
+    if (p->sim_params->parallel_harts && s->num_harts > 1) {
+        s->host_threads = hart_threads_init(p->sim_params,
+                                            riscv_machine_run_hart, s);
+        for(i = 0; i < s->num_harts; i++) {
+            riscv_sim_cpu_set_host_threads(s->cpu_state[i]->simcpu,
+                                           s->host_threads);
+            s->cpu_state[i]->io_lock = &s->host_threads->io_lock;
+        }
+    }
+    /* in deterministic mode, one hart runs at a time as on one host
+       thread */
+    if (s->host_threads && !s->host_threads->deterministic) {
+        for(i = 0; i < s->num_harts; i++)
+            s->cpu_state[i]->host_atomics = TRUE;
+    } else if (s->num_harts > 1) {
+        for(i = 0; i < s->num_harts; i++) {
+            s->cpu_state[i]->harts = s->cpu_state;
+            s->cpu_state[i]->num_harts = s->num_harts;
+        }
+    }
+
+    /* We are booting TinyEMU in simulation mode, a bare-metal ELF is
+       simulated from its entry point. Every hart enters simulation at the
+       PC of its emulator, set above to the entry point of the ELF. */
+    if (p->sim_params->start_in_sim || p->sim_params->elf_file)
     {
-        riscv_sim_cpu_start(s->cpu_state->simcpu, s->cpu_state->simcpu->pc);
+        riscv_sim_cpu_start(s->cpu_state[0]->simcpu, s->cpu_state[0]->pc);
     }
 
     return (VirtMachine *)s;
@@ -1257,9 +1698,14 @@ static VirtMachine *riscv_machine_init(const VirtMachineParams *p)
 static void riscv_machine_end(VirtMachine *s1)
 {
     RISCVMachine *s = (RISCVMachine *)s1;
+    int i;
     /* XXX: stop all */
 
-    riscv_cpu_end(s->cpu_state);
+    if (s->host_threads)
+        hart_threads_free(&s->host_threads);
+    /* the boot hart owns the shared memory hierarchy, so it is freed last */
+    for(i = s->num_harts - 1; i >= 0; i--)
+        riscv_cpu_end(s->cpu_state[i]);
     rtc_free(&s->rtc);
     sim_params_free(s->common.virt_machine_params->sim_params);
     phys_mem_map_end(s->mem_map);
@@ -1270,31 +1716,81 @@ static void riscv_machine_end(VirtMachine *s1)
 static int riscv_machine_get_sleep_duration(VirtMachine *s1, int delay)
 {
     RISCVMachine *m = (RISCVMachine *)s1;
-    RISCVCPUState *s = m->cpu_state;
+    RISCVCPUState *s;
     int64_t delay1;
-    
+    int i;
+    BOOL power_down;
+
     /* wait for an event: the only asynchronous event is the RTC timer */
-    if (!(riscv_cpu_get_mip(s) & MIP_MTIP)) {
-        delay1 = m->timecmp - rtc_get_time(m);
-        if (delay1 <= 0) {
-            riscv_cpu_set_mip(s, MIP_MTIP);
-            delay = 0;
-        } else {
-            /* convert delay to ms */
-            delay1 = delay1 / (m->rtc->freq / 1000);
-            if (delay1 < delay)
-                delay = delay1;
+    power_down = TRUE;
+    for(i = 0; i < m->num_harts; i++) {
+        s = m->cpu_state[i];
+        if (!(riscv_cpu_get_mip(s) & MIP_MTIP)) {
+            delay1 = m->timecmp[i] - rtc_get_time(m);
+            if (delay1 <= 0) {
+                riscv_cpu_set_mip(s, MIP_MTIP);
+                delay = 0;
+            } else {
+                /* convert delay to ms */
+                delay1 = delay1 / (m->rtc->freq / 1000);
+                if (delay1 < delay)
+                    delay = delay1;
+            }
         }
+        if (!riscv_cpu_get_power_down(s))
+            power_down = FALSE;
     }
-    if (!riscv_cpu_get_power_down(s))
+    if (!power_down)
         delay = 0;
     return delay;
 }
 
+/* In emulation mode, harts are interleaved deterministically: each hart
+   executes hart_quantum instructions in turn, in the order of their hart ids,
+   until every hart has executed its share of max_exec_cycle. In simulation
+   mode, the timing cores of the harts are stepped together instead, one
+   cycle at a time, see riscv_sim_cpu_run_harts(). A reservation made by LR is
+   dropped by a store of another hart to the reserved granule, see
+   target_set_reservation. In simulation mode with coherent caches, it is
+   dropped when its line leaves the data cache of the hart instead.
+
+   With parallel_harts, every hart runs on its own host thread instead, see
+   HartThreads. With lax synchronization, a SC then succeeds only if the
+   reserved location still holds the value read by the LR. */
 static void riscv_machine_interp(VirtMachine *s1, int max_exec_cycle)
 {
     RISCVMachine *s = (RISCVMachine *)s1;
-    riscv_cpu_interp(s->cpu_state, max_exec_cycle);
+    int i, n_cycles, quantum;
+
+    if (s->num_harts == 1) {
+        riscv_cpu_interp(s->cpu_state[0], max_exec_cycle);
+        return;
+    }
+
+    if (riscv_cpu_in_simulation(s->cpu_state[0])) {
+        riscv_sim_cpu_run_harts(s->cpu_state[0]->simcpu, max_exec_cycle);
+    } else if (s->host_threads) {
+        hart_threads_run(s->host_threads,
+                         max_int(max_exec_cycle / s->num_harts, 1));
+        riscv_sim_cpu_process_mode_switch(s->cpu_state[0]->simcpu);
+    } else {
+        n_cycles = max_int(max_exec_cycle / s->num_harts, 1);
+        while (n_cycles > 0) {
+            quantum = min_int(n_cycles, s->hart_quantum);
+            for(i = 0; i < s->num_harts; i++) {
+                riscv_cpu_interp(s->cpu_state[i], quantum);
+                /* the harts enter simulation mode together */
+                if (riscv_cpu_in_simulation(s->cpu_state[0]))
+                    return;
+            }
+            n_cycles -= quantum;
+        }
+    }
+
+    if (s->htif_exit_pending) {
+        printf("\nPower off.\n");
+        exit(s->htif_exit_code);
+    }
 }
 
 static void riscv_vm_send_key_event(VirtMachine *s1, BOOL is_down,
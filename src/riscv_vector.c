@@ -0,0 +1,2216 @@
+/*
+ * RISCV vector extension (RVV 1.0)
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2017-2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <assert.h>
+
+#include "cutils.h"
+#include "riscv_cpu_priv.h"
+#include "riscv_vector.h"
+#if FLEN > 0
+#include "softfp.h"
+#endif
+
+/* The vector unit implements ELEN = 64. The functional model covers the
+ * configuration instructions, the unit-stride (including mask, whole register
+ * and fault-only-first), strided and indexed loads and stores with segments,
+ * the single-width and widening integer instructions, the fixed point
+ * instructions, the mask instructions, permutations, and the floating point
+ * instructions for SEW 32 and 64, the widening and narrowing ones producing
+ * or consuming double precision elements (or 16-bit integers for the
+ * conversions with single precision). Half precision is not supported.
+ *
+ * Tail and masked-off elements are always left undisturbed, which the
+ * agnostic policies allow. */
+
+#define VTYPE_VILL ((target_ulong)1 << (MAX_XLEN - 1))
+
+/* Registers 32 to 63 hold a copy of the source registers of an instruction
+ * whose destination overlaps with one of its sources, so that the results
+ * never depend on the order the elements are processed in */
+#define VREG_SCRATCH 32
+#define NUM_VREG_ALLOC 64
+
+#define OPIVV 0
+#define OPFVV 1
+#define OPMVV 2
+#define OPIVI 3
+#define OPIVX 4
+#define OPFVF 5
+#define OPMVX 6
+#define OPCFG 7
+
+typedef struct VCtx {
+    RISCVCPUState *s;
+    RVVInsnInfo *info;
+    uint32_t insn;
+    int funct3;
+    int funct6;
+    int vm;
+    int vd;
+    int vs1; /* also rs1 and the 5-bit immediate */
+    int vs2;
+    int sew; /* in bytes */
+    int lmul_log2;
+    uint32_t vl;
+    uint32_t vstart;
+    int src_base; /* 0, or VREG_SCRATCH if the sources were copied */
+} VCtx;
+
+void riscv_vector_init(RISCVCPUState *s, int vlen)
+{
+    s->vlenb = vlen / 8;
+    s->vreg = mallocz(NUM_VREG_ALLOC * s->vlenb);
+    s->vtype = VTYPE_VILL;
+    s->misa |= MCPUID_V;
+}
+
+void riscv_vector_free(RISCVCPUState *s)
+{
+    free(s->vreg);
+    s->vreg = NULL;
+}
+
+/* Vector loads and stores share the LOAD-FP and STORE-FP major opcodes,
+ * they are selected by the width field */
+int riscv_vector_is_mem_width(uint32_t funct3)
+{
+    return (funct3 == 0) || (funct3 >= 5);
+}
+
+/*===========  vtype  ===========*/
+
+static inline int vtype_lmul_log2(target_ulong vtype)
+{
+    int vlmul = vtype & 7;
+    return (vlmul & 4) ? vlmul - 8 : vlmul;
+}
+
+static inline int vtype_sew(target_ulong vtype)
+{
+    return 1 << ((vtype >> 3) & 7);
+}
+
+static int vtype_valid(target_ulong vtype)
+{
+    int vsew, vlmul;
+
+    if (vtype >> 8)
+        return FALSE;
+    vsew = (vtype >> 3) & 7;
+    vlmul = vtype & 7;
+    if (vsew > 3 || vlmul == 4)
+        return FALSE;
+    /* Fractional LMUL requires SEW <= ELEN * LMUL */
+    if ((vlmul & 4) && vsew > 3 + (vlmul - 8))
+        return FALSE;
+    return TRUE;
+}
+
+static uint32_t get_vlmax(RISCVCPUState *s, target_ulong vtype)
+{
+    int lmul_log2 = vtype_lmul_log2(vtype);
+    uint32_t n = s->vlenb / vtype_sew(vtype);
+
+    return (lmul_log2 >= 0) ? n << lmul_log2 : n >> -lmul_log2;
+}
+
+/*===========  Register file access  ===========*/
+
+static inline uint8_t *velem_ptr(RISCVCPUState *s, int reg, uint32_t i,
+                                 int eew)
+{
+    return s->vreg + reg * s->vlenb + i * eew;
+}
+
+static inline uint64_t vget(RISCVCPUState *s, int reg, uint32_t i, int eew)
+{
+    uint8_t *p = velem_ptr(s, reg, i, eew);
+
+    switch (eew) {
+    case 1:
+        return *p;
+    case 2:
+        return *(uint16_t *)p;
+    case 4:
+        return *(uint32_t *)p;
+    default:
+        return *(uint64_t *)p;
+    }
+}
+
+static inline void vput(RISCVCPUState *s, int reg, uint32_t i, int eew,
+                        uint64_t val)
+{
+    uint8_t *p = velem_ptr(s, reg, i, eew);
+
+    switch (eew) {
+    case 1:
+        *p = val;
+        break;
+    case 2:
+        *(uint16_t *)p = val;
+        break;
+    case 4:
+        *(uint32_t *)p = val;
+        break;
+    default:
+        *(uint64_t *)p = val;
+        break;
+    }
+}
+
+static inline int vmask_get(RISCVCPUState *s, int reg, uint32_t i)
+{
+    return (s->vreg[reg * s->vlenb + (i >> 3)] >> (i & 7)) & 1;
+}
+
+static inline void vmask_put(RISCVCPUState *s, int reg, uint32_t i, int bit)
+{
+    uint8_t *p = &s->vreg[reg * s->vlenb + (i >> 3)];
+
+    *p = (*p & ~(1 << (i & 7))) | ((bit & 1) << (i & 7));
+}
+
+/* Source operand accessors */
+static inline uint64_t vs(VCtx *c, int reg, uint32_t i, int eew)
+{
+    return vget(c->s, c->src_base + reg, i, eew);
+}
+
+static inline int vsmask(VCtx *c, int reg, uint32_t i)
+{
+    return vmask_get(c->s, c->src_base + reg, i);
+}
+
+static inline int elem_active(VCtx *c, uint32_t i)
+{
+    return c->vm || vsmask(c, 0, i);
+}
+
+static inline uint64_t zext_e(uint64_t v, int eew)
+{
+    return (eew >= 8) ? v : v & (((uint64_t)1 << (eew * 8)) - 1);
+}
+
+static inline int64_t sext_e(uint64_t v, int eew)
+{
+    int sh = 64 - eew * 8;
+    return (int64_t)(v << sh) >> sh;
+}
+
+static inline uint64_t umax_e(int eew)
+{
+    return zext_e(~(uint64_t)0, eew);
+}
+
+static inline int64_t smax_e(int eew)
+{
+    return (int64_t)(umax_e(eew) >> 1);
+}
+
+static inline int64_t smin_e(int eew)
+{
+    return -smax_e(eew) - 1;
+}
+
+/*===========  Register groups  ===========*/
+
+static inline int group_regs(int emul_log2)
+{
+    return (emul_log2 > 0) ? 1 << emul_log2 : 1;
+}
+
+static inline uint32_t group_mask(int reg, int nregs)
+{
+    return (uint32_t)((((uint64_t)1 << nregs) - 1) << reg);
+}
+
+static int group_ok(int reg, int emul_log2)
+{
+    int n;
+
+    if (emul_log2 < -3 || emul_log2 > 3)
+        return FALSE;
+    n = group_regs(emul_log2);
+    return !(reg & (n - 1)) && (reg + n <= 32);
+}
+
+static void add_src(VCtx *c, int reg, int emul_log2)
+{
+    c->info->src_regs |= group_mask(reg, group_regs(emul_log2));
+}
+
+static void add_dst(VCtx *c, int reg, int emul_log2)
+{
+    c->info->dst_regs |= group_mask(reg, group_regs(emul_log2));
+}
+
+/* Must be called once the source and destination registers are known */
+static void prepare_sources(VCtx *c)
+{
+    RISCVCPUState *s = c->s;
+    uint32_t m = c->info->src_regs;
+    int r;
+
+    c->src_base = 0;
+    if (!(m & c->info->dst_regs))
+        return;
+    for (r = 0; r < 32; r++) {
+        if (m & (1u << r))
+            memcpy(velem_ptr(s, VREG_SCRATCH + r, 0, 1),
+                   velem_ptr(s, r, 0, 1), s->vlenb);
+    }
+    c->src_base = VREG_SCRATCH;
+}
+
+/*===========  Fixed point rounding  ===========*/
+
+/* Rounding increment for v shifted right by shift bits, as per vxrm */
+static uint64_t get_round(RISCVCPUState *s, uint64_t v, int shift)
+{
+    uint64_t d, d1, rest;
+
+    if (shift == 0 || shift > 64)
+        return 0;
+    d = (shift < 64) ? (v >> shift) & 1 : 0;
+    d1 = (v >> (shift - 1)) & 1;
+    rest = (shift > 1) ? v & (((uint64_t)1 << (shift - 1)) - 1) : 0;
+    switch (s->vxrm) {
+    case 0: /* rnu */
+        return d1;
+    case 1: /* rne */
+        return d1 & ((rest != 0) | d);
+    case 2: /* rdn */
+        return 0;
+    default: /* rod */
+        return !d & ((d1 | (rest != 0)) != 0);
+    }
+}
+
+/*===========  Configuration  ===========*/
+
+static int exec_vset(VCtx *c)
+{
+    RISCVCPUState *s = c->s;
+    uint32_t insn = c->insn;
+    int rd = c->vd, rs1 = c->vs1;
+    target_ulong vtype, avl;
+    uint32_t vlmax;
+    int is_vsetivli = FALSE;
+
+    if ((insn >> 31) == 0) {
+        vtype = (insn >> 20) & 0x7ff; /* vsetvli */
+    } else if ((insn >> 30) == 3) {
+        vtype = (insn >> 20) & 0x3ff; /* vsetivli */
+        is_vsetivli = TRUE;
+    } else if ((insn >> 25) == 0x40) {
+        vtype = s->reg[c->vs2]; /* vsetvl */
+    } else {
+        return RVV_EXEC_ILLEGAL;
+    }
+
+    if (!vtype_valid(vtype)) {
+        s->vtype = VTYPE_VILL;
+        s->vl = 0;
+    } else {
+        vlmax = get_vlmax(s, vtype);
+        if (is_vsetivli)
+            avl = rs1;
+        else if (rs1 != 0)
+            avl = s->reg[rs1];
+        else if (rd != 0)
+            avl = vlmax;
+        else
+            avl = s->vl;
+        s->vl = (avl < vlmax) ? avl : vlmax;
+        s->vtype = vtype;
+    }
+    if (rd != 0)
+        s->reg[rd] = s->vl;
+    s->vstart = 0;
+
+    c->info->op_class = RVV_CLASS_CFG;
+    c->info->scalar_dest = TRUE;
+    return RVV_EXEC_OK;
+}
+
+/*===========  Loads and stores  ===========*/
+
+/* The simulated vector unit, which passes a hook to riscv_vector_exec(),
+ * accesses the memory through the TLBs of the timing model */
+#define VMEM_READ(s, sim, size, pval, addr)                                    \
+    ((sim) ? target_sim_read_u##size(s, pval, addr)                            \
+           : target_read_u##size(s, pval, addr))
+#define VMEM_WRITE(s, sim, size, addr, val)                                    \
+    ((sim) ? target_sim_write_u##size(s, addr, val)                            \
+           : target_write_u##size(s, addr, val))
+
+static int vmem_read(RISCVCPUState *s, int sim, target_ulong addr, int eew,
+                     uint64_t *pval)
+{
+    switch (eew) {
+    case 1: {
+        uint8_t v;
+        if (VMEM_READ(s, sim, 8, &v, addr))
+            return -1;
+        *pval = v;
+        break;
+    }
+    case 2: {
+        uint16_t v;
+        if (VMEM_READ(s, sim, 16, &v, addr))
+            return -1;
+        *pval = v;
+        break;
+    }
+    case 4: {
+        uint32_t v;
+        if (VMEM_READ(s, sim, 32, &v, addr))
+            return -1;
+        *pval = v;
+        break;
+    }
+    default: {
+#if MLEN >= 64
+        uint64_t v;
+        if (VMEM_READ(s, sim, 64, &v, addr))
+            return -1;
+        *pval = v;
+#else
+        uint32_t lo, hi;
+        if (VMEM_READ(s, sim, 32, &lo, addr)
+            || VMEM_READ(s, sim, 32, &hi, addr + 4))
+            return -1;
+        *pval = ((uint64_t)hi << 32) | lo;
+#endif
+        break;
+    }
+    }
+    return 0;
+}
+
+static int vmem_write(RISCVCPUState *s, int sim, target_ulong addr, int eew,
+                      uint64_t val)
+{
+    switch (eew) {
+    case 1:
+        return VMEM_WRITE(s, sim, 8, addr, val);
+    case 2:
+        return VMEM_WRITE(s, sim, 16, addr, val);
+    case 4:
+        return VMEM_WRITE(s, sim, 32, addr, val);
+    default:
+#if MLEN >= 64
+        return VMEM_WRITE(s, sim, 64, addr, val);
+#else
+        if (VMEM_WRITE(s, sim, 32, addr, (uint32_t)val))
+            return -1;
+        return VMEM_WRITE(s, sim, 32, addr + 4, (uint32_t)(val >> 32));
+#endif
+    }
+}
+
+/* Accesses one element of register reg, returns -1 on a memory exception */
+static int vmem_access(VCtx *c, int is_store, target_ulong addr, int reg,
+                       uint32_t i, int eew, RVVMemAccessHook hook,
+                       void *opaque, int *stop)
+{
+    RISCVCPUState *s = c->s;
+    uint64_t val;
+
+    if (is_store) {
+        if (vmem_write(s, hook != NULL, addr, eew, vget(s, reg, i, eew)))
+            return -1;
+    } else {
+        if (vmem_read(s, hook != NULL, addr, eew, &val))
+            return -1;
+        vput(s, reg, i, eew, val);
+    }
+
+    if (hook && !s->is_device_io && s->data_guest_paddr) {
+        *stop |= hook(opaque, s->data_guest_paddr, eew, is_store);
+    }
+    return 0;
+}
+
+static int exec_mem(VCtx *c, int is_store, RVVMemAccessHook hook,
+                    void *opaque)
+{
+    RISCVCPUState *s = c->s;
+    uint32_t insn = c->insn;
+    int nf = ((insn >> 29) & 7) + 1;
+    int mew = (insn >> 28) & 1;
+    int mop = (insn >> 26) & 3;
+    int umop = c->vs2;
+    int eew = (c->funct3 == 0) ? 1 : 1 << (c->funct3 - 4);
+    int eew_log2 = (c->funct3 == 0) ? 0 : c->funct3 - 4;
+    target_ulong base = s->reg[c->vs1];
+    target_ulong stride, addr;
+    int data_eew, data_emul, idx_emul, nregs, f, stop = FALSE;
+    uint32_t i, evl;
+
+    if (mew)
+        return RVV_EXEC_ILLEGAL;
+
+    c->info->op_class = is_store ? RVV_CLASS_STORE : RVV_CLASS_LOAD;
+
+    if (mop == 0 && umop == 8) {
+        /* Whole register load and store, independent of vtype */
+        if (!c->vm || (nf & (nf - 1)) || (is_store && eew != 1))
+            return RVV_EXEC_ILLEGAL;
+        if (!group_ok(c->vd, (nf == 1) ? 0 : (nf == 2) ? 1 : (nf == 4) ? 2 : 3))
+            return RVV_EXEC_ILLEGAL;
+        evl = nf * s->vlenb / eew;
+        if (is_store)
+            c->info->src_regs |= group_mask(c->vd, nf);
+        else
+            c->info->dst_regs |= group_mask(c->vd, nf);
+        c->info->elems = evl - c->vstart;
+        c->info->elem_bytes = eew;
+        for (i = c->vstart; i < evl; i++) {
+            if (vmem_access(c, is_store, base + i * eew, c->vd, i, eew, hook,
+                            opaque, &stop))
+                goto fault;
+            if (stop && i + 1 < evl) {
+                s->vstart = i + 1;
+                return RVV_EXEC_PARTIAL;
+            }
+        }
+        s->vstart = 0;
+        return RVV_EXEC_OK;
+    }
+
+    if (s->vtype & VTYPE_VILL)
+        return RVV_EXEC_ILLEGAL;
+
+    if (mop == 0 && umop == 0xb) {
+        /* vlm.v, vsm.v: mask register of ceil(vl / 8) bytes */
+        if (eew != 1 || nf != 1 || !c->vm)
+            return RVV_EXEC_ILLEGAL;
+        evl = (c->vl + 7) / 8;
+        if (is_store)
+            add_src(c, c->vd, 0);
+        else
+            add_dst(c, c->vd, 0);
+        c->info->elems = evl - c->vstart;
+        c->info->elem_bytes = 1;
+        for (i = c->vstart; i < evl; i++) {
+            if (vmem_access(c, is_store, base + i, c->vd, i, 1, hook, opaque,
+                            &stop))
+                goto fault;
+            if (stop && i + 1 < evl) {
+                s->vstart = i + 1;
+                return RVV_EXEC_PARTIAL;
+            }
+        }
+        s->vstart = 0;
+        return RVV_EXEC_OK;
+    }
+
+    if (mop == 0 && umop != 0 && !(umop == 0x10 && !is_store))
+        return RVV_EXEC_ILLEGAL;
+
+    if (mop & 1) {
+        /* Indexed: the data has EEW = SEW, the offsets have EEW = eew */
+        data_eew = c->sew;
+        data_emul = c->lmul_log2;
+        idx_emul = eew_log2 - ctz32(c->sew) + c->lmul_log2;
+        if (!group_ok(c->vs2, idx_emul))
+            return RVV_EXEC_ILLEGAL;
+        add_src(c, c->vs2, idx_emul);
+    } else {
+        data_eew = eew;
+        data_emul = eew_log2 - ctz32(c->sew) + c->lmul_log2;
+        idx_emul = 0;
+    }
+    if (!group_ok(c->vd, data_emul))
+        return RVV_EXEC_ILLEGAL;
+    nregs = group_regs(data_emul);
+    if (nf * nregs > 8 || c->vd + nf * nregs > 32)
+        return RVV_EXEC_ILLEGAL;
+    if (!is_store && !c->vm && c->vd == 0)
+        return RVV_EXEC_ILLEGAL;
+
+    if (is_store)
+        c->info->src_regs |= group_mask(c->vd, nf * nregs);
+    else
+        c->info->dst_regs |= group_mask(c->vd, nf * nregs);
+    c->info->elems = (c->vl - c->vstart) * nf;
+    c->info->elem_bytes = data_eew;
+    prepare_sources(c);
+
+    stride = (mop == 2) ? s->reg[c->vs2] : (target_ulong)(nf * data_eew);
+    for (i = c->vstart; i < c->vl; i++) {
+        if (!elem_active(c, i))
+            continue;
+        for (f = 0; f < nf; f++) {
+            if (mop & 1) {
+                addr = base + zext_e(vs(c, c->vs2, i, eew), eew)
+                       + f * data_eew;
+            } else {
+                addr = base + i * stride + f * data_eew;
+            }
+            if (vmem_access(c, is_store, addr, c->vd + f * nregs, i, data_eew,
+                            hook, opaque, &stop)) {
+                if (mop == 0 && umop == 0x10 && i > 0) {
+                    /* Fault-only-first: trim vl instead of trapping */
+                    s->pending_exception = -1;
+                    s->vl = i;
+                    break;
+                }
+                goto fault;
+            }
+        }
+        if (s->vl == i)
+            break;
+        if (stop && i + 1 < c->vl) {
+            s->vstart = i + 1;
+            return RVV_EXEC_PARTIAL;
+        }
+    }
+    s->vstart = 0;
+    return RVV_EXEC_OK;
+fault:
+    s->vstart = i;
+    return RVV_EXEC_FAULT;
+}
+
+/*===========  Integer arithmetic  ===========*/
+
+#if defined(HAVE_INT128)
+
+static inline uint64_t mulhu64_v(uint64_t a, uint64_t b)
+{
+    return ((uint128_t)a * (uint128_t)b) >> 64;
+}
+
+#else
+
+static uint64_t mulhu64_v(uint64_t a, uint64_t b)
+{
+    uint64_t a0 = (uint32_t)a, a1 = a >> 32, b0 = (uint32_t)b, b1 = b >> 32;
+    uint64_t r00, r01, r10, r11, c;
+
+    r00 = a0 * b0;
+    r01 = a0 * b1;
+    r10 = a1 * b0;
+    r11 = a1 * b1;
+    c = (r00 >> 32) + (uint32_t)r01 + (uint32_t)r10;
+    c = (c >> 32) + (r01 >> 32) + (r10 >> 32) + r11;
+    return c;
+}
+
+#endif
+
+static inline uint64_t mulh64_v(int64_t a, int64_t b)
+{
+    uint64_t r = mulhu64_v(a, b);
+    if (a < 0)
+        r -= b;
+    if (b < 0)
+        r -= a;
+    return r;
+}
+
+static inline uint64_t mulhsu64_v(int64_t a, uint64_t b)
+{
+    uint64_t r = mulhu64_v(a, b);
+    if (a < 0)
+        r -= b;
+    return r;
+}
+
+/* High half of the product of two SEW-bit elements */
+static uint64_t mul_high(int funct6, uint64_t a, uint64_t b, int sew)
+{
+    int bits = sew * 8;
+
+    switch (funct6) {
+    case 0x24: /* vmulhu */
+        if (sew == 8)
+            return mulhu64_v(a, b);
+        return (zext_e(a, sew) * zext_e(b, sew)) >> bits;
+    case 0x26: /* vmulhsu */
+        if (sew == 8)
+            return mulhsu64_v(a, b);
+        return (uint64_t)((sext_e(a, sew) * (int64_t)zext_e(b, sew)) >> bits);
+    default: /* vmulh */
+        if (sew == 8)
+            return mulh64_v(a, b);
+        return (uint64_t)((sext_e(a, sew) * sext_e(b, sew)) >> bits);
+    }
+}
+
+static uint64_t int_div(int funct6, uint64_t a, uint64_t b, int sew)
+{
+    uint64_t ua = zext_e(a, sew), ub = zext_e(b, sew);
+    int64_t sa = sext_e(a, sew), sb = sext_e(b, sew);
+
+    switch (funct6) {
+    case 0x20: /* vdivu */
+        return ub ? ua / ub : ~(uint64_t)0;
+    case 0x21: /* vdiv */
+        if (sb == 0)
+            return ~(uint64_t)0;
+        if (sa == smin_e(sew) && sb == -1)
+            return sa;
+        return sa / sb;
+    case 0x22: /* vremu */
+        return ub ? ua % ub : ua;
+    default: /* vrem */
+        if (sb == 0)
+            return sa;
+        if (sa == smin_e(sew) && sb == -1)
+            return 0;
+        return sa % sb;
+    }
+}
+
+/* Saturating add and subtract, vsmul and the scaling shifts */
+static uint64_t int_fixed(VCtx *c, int funct6, uint64_t a, uint64_t b)
+{
+    RISCVCPUState *s = c->s;
+    int sew = c->sew, bits = sew * 8, sh;
+    uint64_t ua = zext_e(a, sew), ub = zext_e(b, sew), r;
+    int64_t sa = sext_e(a, sew), sb = sext_e(b, sew), sr;
+
+    switch (funct6) {
+    case 0x20: /* vsaddu */
+        r = zext_e(ua + ub, sew);
+        if (r < ua) {
+            s->vxsat = 1;
+            return umax_e(sew);
+        }
+        return r;
+    case 0x21: /* vsadd */
+        sr = sext_e(ua + ub, sew);
+        if ((sa >= 0) == (sb >= 0) && (sr >= 0) != (sa >= 0)) {
+            s->vxsat = 1;
+            return (sa >= 0) ? smax_e(sew) : smin_e(sew);
+        }
+        return sr;
+    case 0x22: /* vssubu */
+        if (ua < ub) {
+            s->vxsat = 1;
+            return 0;
+        }
+        return ua - ub;
+    case 0x23: /* vssub */
+        sr = sext_e(ua - ub, sew);
+        if ((sa >= 0) != (sb >= 0) && (sr >= 0) != (sa >= 0)) {
+            s->vxsat = 1;
+            return (sa >= 0) ? smax_e(sew) : smin_e(sew);
+        }
+        return sr;
+    case 0x27: /* vsmul */
+        if (sa == smin_e(sew) && sb == smin_e(sew)) {
+            s->vxsat = 1;
+            return smax_e(sew);
+        }
+        if (sew == 8) {
+            uint64_t lo = (uint64_t)sa * (uint64_t)sb;
+            uint64_t hi = mulh64_v(sa, sb);
+            return ((hi << 1) | (lo >> 63)) + get_round(s, lo, 63);
+        }
+        sr = sa * sb;
+        return (sr >> (bits - 1)) + get_round(s, sr, bits - 1);
+    case 0x2a: /* vssrl */
+        sh = ub & (bits - 1);
+        return (ua >> sh) + get_round(s, ua, sh);
+    default: /* vssra */
+        sh = ub & (bits - 1);
+        return (sa >> sh) + get_round(s, sa, sh);
+    }
+}
+
+/* Averaging add and subtract, computed on SEW + 1 bits */
+static uint64_t int_avg(VCtx *c, int funct6, uint64_t a, uint64_t b)
+{
+    RISCVCPUState *s = c->s;
+    int sew = c->sew;
+    uint64_t r, top;
+    int64_t sr;
+
+    if (sew < 8) {
+        switch (funct6) {
+        case 0x08: /* vaaddu */
+            sr = zext_e(a, sew) + zext_e(b, sew);
+            break;
+        case 0x09: /* vaadd */
+            sr = sext_e(a, sew) + sext_e(b, sew);
+            break;
+        case 0x0a: /* vasubu */
+            sr = zext_e(a, sew) - zext_e(b, sew);
+            break;
+        default: /* vasub */
+            sr = sext_e(a, sew) - sext_e(b, sew);
+            break;
+        }
+        return (sr >> 1) + get_round(s, sr, 1);
+    }
+
+    switch (funct6) {
+    case 0x08:
+        r = a + b;
+        top = r < a;
+        break;
+    case 0x09:
+        r = a + b;
+        top = ((int64_t)r < 0) ^ ((((int64_t)a < 0) == ((int64_t)b < 0))
+                                   && (((int64_t)r < 0) != ((int64_t)a < 0)));
+        break;
+    case 0x0a:
+        r = a - b;
+        top = a < b;
+        break;
+    default:
+        r = a - b;
+        top = ((int64_t)r < 0) ^ ((((int64_t)a < 0) != ((int64_t)b < 0))
+                                   && (((int64_t)r < 0) != ((int64_t)a < 0)));
+        break;
+    }
+    return ((top << 63) | (r >> 1)) + get_round(s, r, 1);
+}
+
+/* Single-width elementwise operations shared by the OPI encodings */
+static uint64_t int_alu(VCtx *c, int funct6, uint64_t a, uint64_t b)
+{
+    int sew = c->sew, bits = sew * 8;
+
+    switch (funct6) {
+    case 0x00: /* vadd */
+        return a + b;
+    case 0x02: /* vsub */
+        return a - b;
+    case 0x03: /* vrsub */
+        return b - a;
+    case 0x04: /* vminu */
+        return (zext_e(a, sew) < zext_e(b, sew)) ? a : b;
+    case 0x05: /* vmin */
+        return (sext_e(a, sew) < sext_e(b, sew)) ? a : b;
+    case 0x06: /* vmaxu */
+        return (zext_e(a, sew) > zext_e(b, sew)) ? a : b;
+    case 0x07: /* vmax */
+        return (sext_e(a, sew) > sext_e(b, sew)) ? a : b;
+    case 0x09:
+        return a & b;
+    case 0x0a:
+        return a | b;
+    case 0x0b:
+        return a ^ b;
+    case 0x25: /* vsll */
+        return a << (b & (bits - 1));
+    case 0x28: /* vsrl */
+        return zext_e(a, sew) >> (b & (bits - 1));
+    case 0x29: /* vsra */
+        return sext_e(a, sew) >> (b & (bits - 1));
+    default:
+        return int_fixed(c, funct6, a, b);
+    }
+}
+
+static int int_cmp(int funct6, uint64_t a, uint64_t b, int sew)
+{
+    uint64_t ua = zext_e(a, sew), ub = zext_e(b, sew);
+    int64_t sa = sext_e(a, sew), sb = sext_e(b, sew);
+
+    switch (funct6) {
+    case 0x18:
+        return ua == ub;
+    case 0x19:
+        return ua != ub;
+    case 0x1a:
+        return ua < ub;
+    case 0x1b:
+        return sa < sb;
+    case 0x1c:
+        return ua <= ub;
+    case 0x1d:
+        return sa <= sb;
+    case 0x1e:
+        return ua > ub;
+    default:
+        return sa > sb;
+    }
+}
+
+/* Second operand of an OPI or OPM instruction for element i */
+static uint64_t get_op1(VCtx *c, uint32_t i, int eew, int uimm)
+{
+    switch (c->funct3) {
+    case OPIVV:
+    case OPMVV:
+        return vs(c, c->vs1, i, eew);
+    case OPIVI:
+        if (uimm)
+            return c->vs1;
+        return (uint64_t)(int64_t)((int32_t)((uint32_t)c->vs1 << 27) >> 27);
+    default:
+        return (uint64_t)(int64_t)(target_long)c->s->reg[c->vs1];
+    }
+}
+
+/* Checks and records the operand groups of a single-width operation */
+static int single_width_regs(VCtx *c, int mask_dest, int use_vs1, int use_vd)
+{
+    int lmul = c->lmul_log2;
+
+    if (!group_ok(c->vs2, lmul))
+        return FALSE;
+    add_src(c, c->vs2, lmul);
+    if (use_vs1) {
+        if (!group_ok(c->vs1, lmul))
+            return FALSE;
+        add_src(c, c->vs1, lmul);
+    }
+    if (mask_dest) {
+        add_dst(c, c->vd, 0);
+        add_src(c, c->vd, 0);
+    } else {
+        if (!group_ok(c->vd, lmul) || (!c->vm && c->vd == 0))
+            return FALSE;
+        add_dst(c, c->vd, lmul);
+        if (use_vd)
+            add_src(c, c->vd, lmul);
+    }
+    return TRUE;
+}
+
+static int exec_opi(VCtx *c)
+{
+    RISCVCPUState *s = c->s;
+    int f6 = c->funct6, sew = c->sew, lmul = c->lmul_log2;
+    int is_vv = (c->funct3 == OPIVV), is_vi = (c->funct3 == OPIVI);
+    int uimm = is_vi && ((f6 >= 0x0c && f6 <= 0x0f) || f6 == 0x25
+                         || (f6 >= 0x28 && f6 <= 0x2f));
+    uint32_t i, vlmax = get_vlmax(s, s->vtype);
+    uint64_t a, b, r;
+    int carry, nr;
+
+    c->info->op_class = RVV_CLASS_ALU;
+    switch (f6) {
+    case 0x00: case 0x02: case 0x03: case 0x04: case 0x05: case 0x06:
+    case 0x07: case 0x09: case 0x0a: case 0x0b: case 0x20: case 0x21:
+    case 0x22: case 0x23: case 0x25: case 0x27: case 0x28: case 0x29:
+    case 0x2a: case 0x2b:
+        if (f6 == 0x27 && is_vi) {
+            /* vmv<nr>r.v, independent of vtype and vl */
+            nr = c->vs1 + 1;
+            if (!c->vm || (nr & (nr - 1)) || nr > 8
+                || (c->vd & (nr - 1)) || (c->vs2 & (nr - 1)))
+                return RVV_EXEC_ILLEGAL;
+            c->info->src_regs |= group_mask(c->vs2, nr);
+            c->info->dst_regs |= group_mask(c->vd, nr);
+            c->info->elems = nr * s->vlenb;
+            c->info->elem_bytes = 1;
+            if (c->vd != c->vs2 && c->vstart * sew < nr * s->vlenb)
+                memmove(velem_ptr(s, c->vd, c->vstart, sew),
+                        velem_ptr(s, c->vs2, c->vstart, sew),
+                        nr * s->vlenb - c->vstart * sew);
+            return RVV_EXEC_OK;
+        }
+        if ((is_vv && f6 == 0x03)
+            || (is_vi && (f6 == 0x02 || (f6 >= 0x04 && f6 <= 0x07)
+                          || f6 == 0x22 || f6 == 0x23 || f6 == 0x27)))
+            return RVV_EXEC_ILLEGAL;
+        if (!single_width_regs(c, FALSE, is_vv, FALSE))
+            return RVV_EXEC_ILLEGAL;
+        if (f6 == 0x27)
+            c->info->op_class = RVV_CLASS_MUL;
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            if (elem_active(c, i))
+                vput(s, c->vd, i, sew,
+                     int_alu(c, f6, vs(c, c->vs2, i, sew),
+                             get_op1(c, i, sew, uimm)));
+        }
+        break;
+
+    case 0x0c: /* vrgather */
+    case 0x0e: /* vslideup, vrgatherei16 */
+    case 0x0f: /* vslidedown */
+        if (f6 == 0x0e && is_vv) {
+            int idx_emul = 1 - ctz32(sew) + lmul;
+            if (!group_ok(c->vs1, idx_emul) || !group_ok(c->vs2, lmul)
+                || !group_ok(c->vd, lmul) || (!c->vm && c->vd == 0))
+                return RVV_EXEC_ILLEGAL;
+            add_src(c, c->vs1, idx_emul);
+            add_src(c, c->vs2, lmul);
+            add_dst(c, c->vd, lmul);
+        } else if (!single_width_regs(c, FALSE, is_vv, FALSE)) {
+            return RVV_EXEC_ILLEGAL;
+        }
+        prepare_sources(c);
+        b = get_op1(c, 0, sew, uimm);
+        for (i = c->vstart; i < c->vl; i++) {
+            if (!elem_active(c, i))
+                continue;
+            if (f6 == 0x0c || (f6 == 0x0e && is_vv)) {
+                uint64_t idx = (f6 == 0x0e) ? vs(c, c->vs1, i, 2)
+                               : is_vv ? zext_e(vs(c, c->vs1, i, sew), sew) : b;
+                vput(s, c->vd, i, sew,
+                     (idx < vlmax) ? vs(c, c->vs2, idx, sew) : 0);
+            } else if (f6 == 0x0e) {
+                if (i >= b)
+                    vput(s, c->vd, i, sew, vs(c, c->vs2, i - b, sew));
+            } else {
+                vput(s, c->vd, i, sew,
+                     (b < vlmax && i + b < vlmax) ? vs(c, c->vs2, i + b, sew)
+                                                  : 0);
+            }
+        }
+        break;
+
+    case 0x10: /* vadc */
+    case 0x12: /* vsbc */
+        if (c->vm || c->vd == 0 || (is_vi && f6 == 0x12)
+            || !single_width_regs(c, FALSE, is_vv, FALSE))
+            return RVV_EXEC_ILLEGAL;
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            a = vs(c, c->vs2, i, sew);
+            b = get_op1(c, i, sew, FALSE);
+            carry = vsmask(c, 0, i);
+            vput(s, c->vd, i, sew, (f6 == 0x10) ? a + b + carry : a - b - carry);
+        }
+        break;
+
+    case 0x11: /* vmadc */
+    case 0x13: /* vmsbc */
+        if ((is_vi && f6 == 0x13) || !single_width_regs(c, TRUE, is_vv, FALSE))
+            return RVV_EXEC_ILLEGAL;
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            a = zext_e(vs(c, c->vs2, i, sew), sew);
+            b = zext_e(get_op1(c, i, sew, FALSE), sew);
+            carry = c->vm ? 0 : vsmask(c, 0, i);
+            if (f6 == 0x11) {
+                r = zext_e(a + b + carry, sew);
+                vmask_put(s, c->vd, i, (r < a) || (carry && r == a));
+            } else {
+                vmask_put(s, c->vd, i, (a < b) || (carry && a == b));
+            }
+        }
+        break;
+
+    case 0x17: /* vmerge, vmv.v */
+        if (c->vm && c->vs2 != 0)
+            return RVV_EXEC_ILLEGAL;
+        if (!group_ok(c->vd, lmul) || (!c->vm && c->vd == 0))
+            return RVV_EXEC_ILLEGAL;
+        add_dst(c, c->vd, lmul);
+        if (!c->vm)
+            add_src(c, c->vs2, lmul);
+        if (is_vv) {
+            if (!group_ok(c->vs1, lmul))
+                return RVV_EXEC_ILLEGAL;
+            add_src(c, c->vs1, lmul);
+        }
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            r = (c->vm || vsmask(c, 0, i)) ? get_op1(c, i, sew, FALSE)
+                                            : vs(c, c->vs2, i, sew);
+            vput(s, c->vd, i, sew, r);
+        }
+        break;
+
+    case 0x18: case 0x19: case 0x1a: case 0x1b:
+    case 0x1c: case 0x1d: case 0x1e: case 0x1f:
+        if ((is_vv && f6 >= 0x1e) || (is_vi && (f6 == 0x1a || f6 == 0x1b)))
+            return RVV_EXEC_ILLEGAL;
+        if (!single_width_regs(c, TRUE, is_vv, FALSE))
+            return RVV_EXEC_ILLEGAL;
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            if (elem_active(c, i))
+                vmask_put(s, c->vd, i,
+                          int_cmp(f6, vs(c, c->vs2, i, sew),
+                                  get_op1(c, i, sew, FALSE), sew));
+        }
+        break;
+
+    case 0x2c: case 0x2d: case 0x2e: case 0x2f:
+        /* vnsrl, vnsra, vnclipu, vnclip: vs2 has EEW = 2 * SEW */
+        if (sew > 4 || lmul > 2 || !group_ok(c->vs2, lmul + 1)
+            || !group_ok(c->vd, lmul) || (!c->vm && c->vd == 0))
+            return RVV_EXEC_ILLEGAL;
+        add_src(c, c->vs2, lmul + 1);
+        add_dst(c, c->vd, lmul);
+        if (is_vv) {
+            if (!group_ok(c->vs1, lmul))
+                return RVV_EXEC_ILLEGAL;
+            add_src(c, c->vs1, lmul);
+        }
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            int sh;
+            if (!elem_active(c, i))
+                continue;
+            a = vs(c, c->vs2, i, 2 * sew);
+            sh = get_op1(c, i, sew, TRUE) & (sew * 16 - 1);
+            if (f6 == 0x2c) {
+                r = zext_e(a, 2 * sew) >> sh;
+            } else if (f6 == 0x2d) {
+                r = sext_e(a, 2 * sew) >> sh;
+            } else if (f6 == 0x2e) {
+                r = (zext_e(a, 2 * sew) >> sh)
+                    + get_round(s, zext_e(a, 2 * sew), sh);
+                if (r > umax_e(sew)) {
+                    r = umax_e(sew);
+                    s->vxsat = 1;
+                }
+            } else {
+                int64_t sr = (sext_e(a, 2 * sew) >> sh)
+                             + get_round(s, sext_e(a, 2 * sew), sh);
+                if (sr > smax_e(sew) || sr < smin_e(sew)) {
+                    sr = (sr > 0) ? smax_e(sew) : smin_e(sew);
+                    s->vxsat = 1;
+                }
+                r = sr;
+            }
+            vput(s, c->vd, i, sew, r);
+        }
+        break;
+
+    case 0x30: /* vwredsumu */
+    case 0x31: /* vwredsum */
+        if (!is_vv || sew > 4 || c->vstart != 0 || !group_ok(c->vs2, lmul))
+            return RVV_EXEC_ILLEGAL;
+        add_src(c, c->vs2, lmul);
+        add_src(c, c->vs1, 0);
+        add_dst(c, c->vd, 0);
+        prepare_sources(c);
+        if (c->vl == 0)
+            break;
+        r = vs(c, c->vs1, 0, 2 * sew);
+        for (i = 0; i < c->vl; i++) {
+            if (elem_active(c, i)) {
+                a = vs(c, c->vs2, i, sew);
+                r += (f6 == 0x30) ? zext_e(a, sew) : (uint64_t)sext_e(a, sew);
+            }
+        }
+        vput(s, c->vd, 0, 2 * sew, r);
+        break;
+
+    default:
+        return RVV_EXEC_ILLEGAL;
+    }
+    return RVV_EXEC_OK;
+}
+
+/* Widening integer operations, vd has EEW = 2 * SEW */
+static uint64_t int_widen(int funct6, uint64_t a, uint64_t b, uint64_t d,
+                          int sew)
+{
+    uint64_t ua = zext_e(a, sew), ub = zext_e(b, sew);
+    int64_t sa = sext_e(a, sew), sb = sext_e(b, sew);
+
+    switch (funct6) {
+    case 0x30: /* vwaddu */
+        return ua + ub;
+    case 0x31: /* vwadd */
+        return sa + sb;
+    case 0x32: /* vwsubu */
+        return ua - ub;
+    case 0x33: /* vwsub */
+        return sa - sb;
+    case 0x34: /* vwaddu.w */
+        return a + ub;
+    case 0x35: /* vwadd.w */
+        return a + sb;
+    case 0x36: /* vwsubu.w */
+        return a - ub;
+    case 0x37: /* vwsub.w */
+        return a - sb;
+    case 0x38: /* vwmulu */
+        return ua * ub;
+    case 0x3a: /* vwmulsu: vs2 signed, vs1 unsigned */
+        return sa * (int64_t)ub;
+    case 0x3b: /* vwmul */
+        return sa * sb;
+    case 0x3c: /* vwmaccu */
+        return d + ua * ub;
+    case 0x3d: /* vwmacc */
+        return d + sa * sb;
+    case 0x3e: /* vwmaccus: vs1 unsigned, vs2 signed */
+        return d + (int64_t)ub * sa;
+    default: /* vwmaccsu: vs1 signed, vs2 unsigned */
+        return d + sb * (int64_t)ua;
+    }
+}
+
+static int exec_opm(VCtx *c)
+{
+    RISCVCPUState *s = c->s;
+    int f6 = c->funct6, sew = c->sew, lmul = c->lmul_log2;
+    int is_vv = (c->funct3 == OPMVV);
+    uint32_t i, j;
+    uint64_t a, b, r, d;
+    int bit, found;
+
+    c->info->op_class = RVV_CLASS_ALU;
+    switch (f6) {
+    case 0x00: case 0x01: case 0x02: case 0x03:
+    case 0x04: case 0x05: case 0x06: case 0x07:
+        /* Single-width reductions */
+        if (!is_vv || c->vstart != 0 || !group_ok(c->vs2, lmul))
+            return RVV_EXEC_ILLEGAL;
+        add_src(c, c->vs2, lmul);
+        add_src(c, c->vs1, 0);
+        add_dst(c, c->vd, 0);
+        prepare_sources(c);
+        if (c->vl == 0)
+            break;
+        r = vs(c, c->vs1, 0, sew);
+        for (i = 0; i < c->vl; i++) {
+            if (!elem_active(c, i))
+                continue;
+            a = vs(c, c->vs2, i, sew);
+            switch (f6) {
+            case 0x00:
+                r += a;
+                break;
+            case 0x01:
+                r &= a;
+                break;
+            case 0x02:
+                r |= a;
+                break;
+            case 0x03:
+                r ^= a;
+                break;
+            default:
+                /* vredminu, vredmin, vredmaxu, vredmax */
+                r = int_alu(c, f6, r, a);
+                break;
+            }
+        }
+        vput(s, c->vd, 0, sew, r);
+        break;
+
+    case 0x08: case 0x09: case 0x0a: case 0x0b:
+        if (!single_width_regs(c, FALSE, is_vv, FALSE))
+            return RVV_EXEC_ILLEGAL;
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            if (elem_active(c, i))
+                vput(s, c->vd, i, sew,
+                     int_avg(c, f6, vs(c, c->vs2, i, sew),
+                             get_op1(c, i, sew, FALSE)));
+        }
+        break;
+
+    case 0x0e: /* vslide1up */
+    case 0x0f: /* vslide1down */
+        if (is_vv || !single_width_regs(c, FALSE, FALSE, FALSE))
+            return RVV_EXEC_ILLEGAL;
+        prepare_sources(c);
+        b = get_op1(c, 0, sew, FALSE);
+        for (i = c->vstart; i < c->vl; i++) {
+            if (!elem_active(c, i))
+                continue;
+            if (f6 == 0x0e)
+                r = (i == 0) ? b : vs(c, c->vs2, i - 1, sew);
+            else
+                r = (i == c->vl - 1) ? b : vs(c, c->vs2, i + 1, sew);
+            vput(s, c->vd, i, sew, r);
+        }
+        break;
+
+    case 0x10:
+        if (!is_vv) {
+            /* vmv.s.x */
+            if (!c->vm || c->vs2 != 0)
+                return RVV_EXEC_ILLEGAL;
+            add_dst(c, c->vd, 0);
+            c->info->elems = 1;
+            if (c->vstart < c->vl)
+                vput(s, c->vd, 0, sew, get_op1(c, 0, sew, FALSE));
+            break;
+        }
+        c->info->scalar_dest = TRUE;
+        c->info->elems = 1;
+        if (c->vs1 == 0x00) {
+            /* vmv.x.s */
+            if (!c->vm)
+                return RVV_EXEC_ILLEGAL;
+            add_src(c, c->vs2, 0);
+            r = sext_e(vget(s, c->vs2, 0, sew), sew);
+        } else if (c->vs1 == 0x10 || c->vs1 == 0x11) {
+            /* vcpop.m, vfirst.m */
+            if (c->vstart != 0)
+                return RVV_EXEC_ILLEGAL;
+            add_src(c, c->vs2, 0);
+            c->info->elems = c->vl;
+            r = (c->vs1 == 0x10) ? 0 : (uint64_t)-1;
+            for (i = 0; i < c->vl; i++) {
+                if (elem_active(c, i) && vmask_get(s, c->vs2, i)) {
+                    if (c->vs1 == 0x11) {
+                        r = i;
+                        break;
+                    }
+                    r++;
+                }
+            }
+        } else {
+            return RVV_EXEC_ILLEGAL;
+        }
+        if (c->vd != 0)
+            s->reg[c->vd] = (target_ulong)r;
+        break;
+
+    case 0x12: {
+        /* vzext, vsext: vs2 has EEW = SEW / frac */
+        int frac_log2 = 4 - (c->vs1 >> 1);
+        int src_eew = sew >> frac_log2;
+
+        if (!is_vv || c->vs1 < 2 || c->vs1 > 7 || src_eew < 1
+            || !group_ok(c->vs2, lmul - frac_log2)
+            || !group_ok(c->vd, lmul) || (!c->vm && c->vd == 0))
+            return RVV_EXEC_ILLEGAL;
+        add_src(c, c->vs2, lmul - frac_log2);
+        add_dst(c, c->vd, lmul);
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            if (!elem_active(c, i))
+                continue;
+            a = vs(c, c->vs2, i, src_eew);
+            vput(s, c->vd, i, sew,
+                 (c->vs1 & 1) ? (uint64_t)sext_e(a, src_eew)
+                              : zext_e(a, src_eew));
+        }
+        break;
+    }
+
+    case 0x14:
+        if (!is_vv)
+            return RVV_EXEC_ILLEGAL;
+        if (c->vs1 == 0x11) {
+            /* vid.v */
+            if (c->vs2 != 0 || !group_ok(c->vd, lmul)
+                || (!c->vm && c->vd == 0))
+                return RVV_EXEC_ILLEGAL;
+            add_dst(c, c->vd, lmul);
+            prepare_sources(c);
+            for (i = c->vstart; i < c->vl; i++) {
+                if (elem_active(c, i))
+                    vput(s, c->vd, i, sew, i);
+            }
+            break;
+        }
+        if (c->vstart != 0)
+            return RVV_EXEC_ILLEGAL;
+        add_src(c, c->vs2, 0);
+        if (c->vs1 == 0x10) {
+            /* viota.m */
+            if (!group_ok(c->vd, lmul) || (!c->vm && c->vd == 0))
+                return RVV_EXEC_ILLEGAL;
+            add_dst(c, c->vd, lmul);
+            prepare_sources(c);
+            r = 0;
+            for (i = 0; i < c->vl; i++) {
+                if (!elem_active(c, i))
+                    continue;
+                vput(s, c->vd, i, sew, r);
+                r += vsmask(c, c->vs2, i);
+            }
+            break;
+        }
+        if (c->vs1 < 1 || c->vs1 > 3)
+            return RVV_EXEC_ILLEGAL;
+        /* vmsbf.m (1), vmsof.m (2), vmsif.m (3) */
+        add_dst(c, c->vd, 0);
+        add_src(c, c->vd, 0);
+        prepare_sources(c);
+        found = FALSE;
+        for (i = 0; i < c->vl; i++) {
+            if (!elem_active(c, i))
+                continue;
+            bit = vsmask(c, c->vs2, i);
+            switch (c->vs1) {
+            case 1:
+                vmask_put(s, c->vd, i, !found && !bit);
+                break;
+            case 2:
+                vmask_put(s, c->vd, i, !found && bit);
+                break;
+            default:
+                vmask_put(s, c->vd, i, !found);
+                break;
+            }
+            found |= bit;
+        }
+        break;
+
+    case 0x17: /* vcompress */
+        if (!is_vv || !c->vm || c->vstart != 0 || !group_ok(c->vs2, lmul)
+            || !group_ok(c->vd, lmul))
+            return RVV_EXEC_ILLEGAL;
+        add_src(c, c->vs2, lmul);
+        add_src(c, c->vs1, 0);
+        add_dst(c, c->vd, lmul);
+        prepare_sources(c);
+        for (i = 0, j = 0; i < c->vl; i++) {
+            if (vsmask(c, c->vs1, i))
+                vput(s, c->vd, j++, sew, vs(c, c->vs2, i, sew));
+        }
+        break;
+
+    case 0x18: case 0x19: case 0x1a: case 0x1b:
+    case 0x1c: case 0x1d: case 0x1e: case 0x1f:
+        /* Mask-register logical instructions */
+        if (!is_vv || !c->vm)
+            return RVV_EXEC_ILLEGAL;
+        add_src(c, c->vs2, 0);
+        add_src(c, c->vs1, 0);
+        add_dst(c, c->vd, 0);
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            int x = vsmask(c, c->vs2, i), y = vsmask(c, c->vs1, i);
+            switch (f6) {
+            case 0x18:
+                bit = x & !y;
+                break;
+            case 0x19:
+                bit = x & y;
+                break;
+            case 0x1a:
+                bit = x | y;
+                break;
+            case 0x1b:
+                bit = x ^ y;
+                break;
+            case 0x1c:
+                bit = x | !y;
+                break;
+            case 0x1d:
+                bit = !(x & y);
+                break;
+            case 0x1e:
+                bit = !(x | y);
+                break;
+            default:
+                bit = !(x ^ y);
+                break;
+            }
+            vmask_put(s, c->vd, i, bit);
+        }
+        break;
+
+    case 0x20: case 0x21: case 0x22: case 0x23:
+    case 0x24: case 0x25: case 0x26: case 0x27:
+        if (!single_width_regs(c, FALSE, is_vv, FALSE))
+            return RVV_EXEC_ILLEGAL;
+        c->info->op_class = (f6 < 0x24) ? RVV_CLASS_DIV : RVV_CLASS_MUL;
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            if (!elem_active(c, i))
+                continue;
+            a = vs(c, c->vs2, i, sew);
+            b = get_op1(c, i, sew, FALSE);
+            if (f6 < 0x24)
+                r = int_div(f6, a, b, sew);
+            else if (f6 == 0x25)
+                r = a * b;
+            else
+                r = mul_high(f6, a, b, sew);
+            vput(s, c->vd, i, sew, r);
+        }
+        break;
+
+    case 0x29: case 0x2b: case 0x2d: case 0x2f:
+        /* vmadd, vnmsub, vmacc, vnmsac */
+        if (!single_width_regs(c, FALSE, is_vv, TRUE))
+            return RVV_EXEC_ILLEGAL;
+        c->info->op_class = RVV_CLASS_MUL;
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            if (!elem_active(c, i))
+                continue;
+            a = vs(c, c->vs2, i, sew);
+            b = get_op1(c, i, sew, FALSE);
+            d = vs(c, c->vd, i, sew);
+            switch (f6) {
+            case 0x29:
+                r = b * d + a;
+                break;
+            case 0x2b:
+                r = a - b * d;
+                break;
+            case 0x2d:
+                r = b * a + d;
+                break;
+            default:
+                r = d - b * a;
+                break;
+            }
+            vput(s, c->vd, i, sew, r);
+        }
+        break;
+
+    case 0x30: case 0x31: case 0x32: case 0x33: case 0x34: case 0x35:
+    case 0x36: case 0x37: case 0x38: case 0x3a: case 0x3b: case 0x3c:
+    case 0x3d: case 0x3e: case 0x3f: {
+        int wide_vs2 = (f6 >= 0x34 && f6 <= 0x37);
+        int use_vd = (f6 >= 0x3c);
+
+        if (sew > 4 || lmul > 2 || (is_vv && f6 == 0x3e)
+            || !group_ok(c->vd, lmul + 1) || (!c->vm && c->vd == 0)
+            || !group_ok(c->vs2, wide_vs2 ? lmul + 1 : lmul))
+            return RVV_EXEC_ILLEGAL;
+        add_dst(c, c->vd, lmul + 1);
+        add_src(c, c->vs2, wide_vs2 ? lmul + 1 : lmul);
+        if (use_vd)
+            add_src(c, c->vd, lmul + 1);
+        if (is_vv) {
+            if (!group_ok(c->vs1, lmul))
+                return RVV_EXEC_ILLEGAL;
+            add_src(c, c->vs1, lmul);
+        }
+        if (f6 >= 0x38)
+            c->info->op_class = RVV_CLASS_MUL;
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            if (!elem_active(c, i))
+                continue;
+            a = vs(c, c->vs2, i, wide_vs2 ? 2 * sew : sew);
+            b = get_op1(c, i, sew, FALSE);
+            d = use_vd ? vs(c, c->vd, i, 2 * sew) : 0;
+            vput(s, c->vd, i, 2 * sew, int_widen(f6, a, b, d, sew));
+        }
+        break;
+    }
+
+    default:
+        return RVV_EXEC_ILLEGAL;
+    }
+    return RVV_EXEC_OK;
+}
+
+/*===========  Floating point  ===========*/
+
+#if FLEN > 0
+
+#define F_SIGN(sew) ((uint64_t)1 << ((sew) * 8 - 1))
+
+/* Single-width operation on elements of sew bytes */
+static uint64_t fp_binop(VCtx *c, int sew, int funct6, uint64_t a,
+                         uint64_t b, uint32_t *pfl)
+{
+    RoundingModeEnum rm = c->s->frm;
+    uint64_t sign = F_SIGN(sew);
+
+    switch (funct6) {
+    case 0x08: /* vfsgnj */
+        return (a & ~sign) | (b & sign);
+    case 0x09: /* vfsgnjn */
+        return (a & ~sign) | (~b & sign);
+    case 0x0a: /* vfsgnjx */
+        return a ^ (b & sign);
+    case 0x21: /* vfrdiv */
+    case 0x27: /* vfrsub */
+        return fp_binop(c, sew, (funct6 == 0x21) ? 0x20 : 0x02, b, a, pfl);
+    }
+
+    if (sew == 4) {
+        switch (funct6) {
+        case 0x00:
+            return add_sf32(a, b, rm, pfl);
+        case 0x02:
+            return sub_sf32(a, b, rm, pfl);
+        case 0x04:
+            return min_sf32(a, b, pfl, FMINMAX_IEEE754_201X);
+        case 0x06:
+            return max_sf32(a, b, pfl, FMINMAX_IEEE754_201X);
+        case 0x20:
+            return div_sf32(a, b, rm, pfl);
+        default:
+            return mul_sf32(a, b, rm, pfl);
+        }
+    }
+#if FLEN >= 64
+    switch (funct6) {
+    case 0x00:
+        return add_sf64(a, b, rm, pfl);
+    case 0x02:
+        return sub_sf64(a, b, rm, pfl);
+    case 0x04:
+        return min_sf64(a, b, pfl, FMINMAX_IEEE754_201X);
+    case 0x06:
+        return max_sf64(a, b, pfl, FMINMAX_IEEE754_201X);
+    case 0x20:
+        return div_sf64(a, b, rm, pfl);
+    default:
+        return mul_sf64(a, b, rm, pfl);
+    }
+#else
+    return 0;
+#endif
+}
+
+/* x * y + z, with the sign of the product and of the addend flipped as
+ * requested */
+static uint64_t fp_fma(VCtx *c, int sew, uint64_t x, uint64_t y, uint64_t z,
+                       int neg_prod, int neg_add, uint32_t *pfl)
+{
+    uint64_t sign = F_SIGN(sew);
+
+    if (neg_prod)
+        x ^= sign;
+    if (neg_add)
+        z ^= sign;
+    if (sew == 4)
+        return fma_sf32(x, y, z, c->s->frm, pfl);
+#if FLEN >= 64
+    return fma_sf64(x, y, z, c->s->frm, pfl);
+#else
+    return 0;
+#endif
+}
+
+static int fp_cmp(VCtx *c, int funct6, uint64_t a, uint64_t b, uint32_t *pfl)
+{
+    if (c->sew == 4) {
+        switch (funct6) {
+        case 0x18:
+            return eq_quiet_sf32(a, b, pfl);
+        case 0x19:
+            return le_sf32(a, b, pfl);
+        case 0x1b:
+            return lt_sf32(a, b, pfl);
+        case 0x1c:
+            return !eq_quiet_sf32(a, b, pfl);
+        case 0x1d:
+            return lt_sf32(b, a, pfl);
+        default:
+            return le_sf32(b, a, pfl);
+        }
+    }
+#if FLEN >= 64
+    switch (funct6) {
+    case 0x18:
+        return eq_quiet_sf64(a, b, pfl);
+    case 0x19:
+        return le_sf64(a, b, pfl);
+    case 0x1b:
+        return lt_sf64(a, b, pfl);
+    case 0x1c:
+        return !eq_quiet_sf64(a, b, pfl);
+    case 0x1d:
+        return lt_sf64(b, a, pfl);
+    default:
+        return le_sf64(b, a, pfl);
+    }
+#else
+    return 0;
+#endif
+}
+
+/* VFUNARY0 conversions and VFUNARY1 */
+static uint64_t fp_unary(VCtx *c, int funct6, int op, uint64_t a,
+                         uint32_t *pfl)
+{
+    RoundingModeEnum rm = (op == 6 || op == 7) ? RM_RTZ : c->s->frm;
+
+    if (c->sew == 4) {
+        if (funct6 == 0x13)
+            return (op == 0) ? sqrt_sf32(a, rm, pfl) : fclass_sf32(a);
+        switch (op) {
+        case 0:
+        case 6:
+            return cvt_sf32_u32(a, rm, pfl);
+        case 1:
+        case 7:
+            return (uint32_t)cvt_sf32_i32(a, rm, pfl);
+        case 2:
+            return cvt_u32_sf32(a, rm, pfl);
+        default:
+            return cvt_i32_sf32(a, rm, pfl);
+        }
+    }
+#if FLEN >= 64
+    if (funct6 == 0x13)
+        return (op == 0) ? sqrt_sf64(a, rm, pfl) : fclass_sf64(a);
+    switch (op) {
+    case 0:
+    case 6:
+        return cvt_sf64_u64(a, rm, pfl);
+    case 1:
+    case 7:
+        return cvt_sf64_i64(a, rm, pfl);
+    case 2:
+        return cvt_u64_sf64(a, rm, pfl);
+    default:
+        return cvt_i64_sf64(a, rm, pfl);
+    }
+#else
+    return 0;
+#endif
+}
+
+/* Widening (op 8 to 15) and narrowing (op 16 to 23) VFUNARY0 conversions,
+ * SEW is the width of the narrow operand or result */
+static uint64_t fp_cvt_wide(VCtx *c, int op, uint64_t a, uint32_t *pfl)
+{
+    RoundingModeEnum rm = ((op & 6) == 6) ? RM_RTZ : c->s->frm;
+    int sew = c->sew;
+    uint32_t fl = 0;
+    uint64_t r;
+
+    if (sew == 2) {
+        /* 16-bit integers from and to single precision, the results out of
+         * the 16-bit range saturate */
+        switch (op) {
+        case 10:
+            return cvt_u32_sf32(a, rm, pfl);
+        case 11:
+            return cvt_i32_sf32(sext_e(a, 2), rm, pfl);
+        case 16:
+        case 22:
+            r = cvt_sf32_u32(a, rm, &fl);
+            if (r > 0xffff) {
+                r = 0xffff;
+                fl = FFLAG_INVALID_OP;
+            }
+            break;
+        default: {
+            int32_t v = cvt_sf32_i32(a, rm, &fl);
+            if (v > INT16_MAX || v < INT16_MIN) {
+                v = (v > 0) ? INT16_MAX : INT16_MIN;
+                fl = FFLAG_INVALID_OP;
+            }
+            r = (uint16_t)v;
+            break;
+        }
+        }
+        *pfl |= fl;
+        return r;
+    }
+
+    switch (op) {
+    case 8:
+    case 14:
+        return cvt_sf32_u64(a, rm, pfl);
+    case 9:
+    case 15:
+        return cvt_sf32_i64(a, rm, pfl);
+    case 18:
+        return cvt_u64_sf32(a, rm, pfl);
+    case 19:
+        return cvt_i64_sf32(a, rm, pfl);
+    }
+#if FLEN >= 64
+    switch (op) {
+    case 10:
+        return cvt_u32_sf64(a, rm, pfl);
+    case 11:
+        return cvt_i32_sf64(a, rm, pfl);
+    case 12:
+        return cvt_sf32_sf64(a, pfl);
+    case 16:
+    case 22:
+        return cvt_sf64_u32(a, rm, pfl);
+    case 17:
+    case 23:
+        return (uint32_t)cvt_sf64_i32(a, rm, pfl);
+    case 20:
+        return cvt_sf64_sf32(a, rm, pfl);
+    default:
+        /* vfncvt.rod.f.f.w: truncated, with the lowest bit set if inexact */
+        r = cvt_sf64_sf32(a, RM_RTZ, &fl);
+        if (fl & FFLAG_INEXACT)
+            r |= 1;
+        *pfl |= fl;
+        return r;
+    }
+#else
+    return 0;
+#endif
+}
+
+/* 7-bit significands of the estimates of 1 / sqrt(x), indexed by the lowest
+ * bit of the exponent and the 6 highest bits of the significand of x, and of
+ * 1 / x, indexed by the 7 highest bits of the significand of x */
+static const uint8_t rsqrt7_table[128] = {
+    52, 51, 50, 48, 47, 46, 44, 43, 42, 41, 40, 39, 38, 36, 35, 34,
+    33, 32, 31, 30, 30, 29, 28, 27, 26, 25, 24, 23, 23, 22, 21, 20,
+    19, 19, 18, 17, 16, 16, 15, 14, 14, 13, 12, 12, 11, 10, 10, 9,
+    9, 8, 7, 7, 6, 6, 5, 4, 4, 3, 3, 2, 2, 1, 1, 0,
+    127, 125, 123, 121, 119, 118, 116, 114, 113, 111, 109, 108, 106, 105, 103, 102,
+    100, 99, 97, 96, 95, 93, 92, 91, 90, 88, 87, 86, 85, 84, 83, 82,
+    80, 79, 78, 77, 76, 75, 74, 73, 72, 71, 70, 70, 69, 68, 67, 66,
+    65, 64, 63, 63, 62, 61, 60, 59, 59, 58, 57, 56, 56, 55, 54, 53
+};
+
+static const uint8_t rec7_table[128] = {
+    127, 125, 123, 121, 119, 117, 116, 114, 112, 110, 109, 107, 105, 104, 102, 100,
+    99, 97, 96, 94, 93, 91, 90, 88, 87, 85, 84, 83, 81, 80, 79, 77,
+    76, 75, 74, 72, 71, 70, 69, 68, 66, 65, 64, 63, 62, 61, 60, 59,
+    58, 57, 56, 55, 54, 53, 52, 51, 50, 49, 48, 47, 46, 45, 44, 43,
+    42, 41, 40, 40, 39, 38, 37, 36, 35, 35, 34, 33, 32, 31, 31, 30,
+    29, 28, 28, 27, 26, 25, 25, 24, 23, 23, 22, 21, 21, 20, 19, 19,
+    18, 17, 17, 16, 15, 15, 14, 14, 13, 12, 12, 11, 11, 10, 9, 9,
+    8, 8, 7, 7, 6, 5, 5, 4, 4, 3, 3, 2, 2, 1, 1, 0
+};
+
+/* vfrsqrt7 and vfrec7 */
+static uint64_t fp_estimate(VCtx *c, int is_rec, uint64_t a, uint32_t *pfl)
+{
+    int sew = c->sew;
+    int mant_size = (sew == 4) ? 23 : 52;
+    int exp_size = sew * 8 - 1 - mant_size;
+    int bias = (1 << (exp_size - 1)) - 1;
+    uint64_t sign = a & F_SIGN(sew);
+    uint64_t mant_mask = ((uint64_t)1 << mant_size) - 1;
+    uint64_t mant = a & mant_mask;
+    uint64_t inf = (uint64_t)((1 << exp_size) - 1) << mant_size;
+    int exp = (a >> mant_size) & ((1 << exp_size) - 1);
+    int out_exp;
+    uint32_t cls;
+    RoundingModeEnum rm = c->s->frm;
+
+    cls = (sew == 4) ? fclass_sf32(a) : fclass_sf64(a);
+    if (cls & FCLASS_SNAN)
+        *pfl |= FFLAG_INVALID_OP;
+    if (cls & (FCLASS_SNAN | FCLASS_QNAN))
+        return inf | ((uint64_t)1 << (mant_size - 1));
+    if (cls & (FCLASS_NZERO | FCLASS_PZERO)) {
+        *pfl |= FFLAG_DIVIDE_ZERO;
+        return sign | inf;
+    }
+    if (cls & (FCLASS_NINF | FCLASS_PINF)) {
+        if (is_rec || !sign)
+            return sign;
+    }
+    if (!is_rec && sign) {
+        *pfl |= FFLAG_INVALID_OP;
+        return inf | ((uint64_t)1 << (mant_size - 1));
+    }
+
+    if (exp == 0) {
+        /* Subnormal: normalized, the exponent going below 0 */
+        while (!(mant & ((uint64_t)1 << (mant_size - 1)))) {
+            exp--;
+            mant <<= 1;
+        }
+        mant = (mant << 1) & mant_mask;
+    }
+
+    if (!is_rec) {
+        out_exp = (3 * bias - 1 - exp) / 2;
+        return ((uint64_t)out_exp << mant_size)
+               | ((uint64_t)rsqrt7_table[((exp & 1) << 6)
+                                         | (mant >> (mant_size - 6))]
+                  << (mant_size - 7));
+    }
+
+    if (exp < -1) {
+        /* The reciprocal overflows */
+        *pfl |= FFLAG_OVERFLOW | FFLAG_INEXACT;
+        if (rm == RM_RTZ || (rm == RM_RDN && !sign) || (rm == RM_RUP && sign))
+            return sign | (inf - 1);
+        return sign | inf;
+    }
+    out_exp = 2 * bias - 1 - exp;
+    mant = (uint64_t)rec7_table[mant >> (mant_size - 7)] << (mant_size - 7);
+    if (out_exp <= 0) {
+        /* Subnormal result */
+        mant = (mant >> 1) | ((uint64_t)1 << (mant_size - 1));
+        if (out_exp < 0) {
+            mant >>= 1;
+            out_exp = 0;
+        }
+    }
+    return sign | ((uint64_t)out_exp << mant_size) | mant;
+}
+
+static int exec_opf(VCtx *c)
+{
+    RISCVCPUState *s = c->s;
+    int f6 = c->funct6, sew = c->sew, lmul = c->lmul_log2;
+    int is_vv = (c->funct3 == OPFVV);
+    int wide = (sew == 4 && FLEN >= 64);
+    uint32_t i, fl = 0;
+    uint64_t a, b, d, r;
+
+    /* SEW 16 is only used by the conversions between 16-bit integers and
+     * single precision */
+    if (s->fs == 0 || s->frm > 4
+        || !(sew == 4 || (sew == 8 && FLEN >= 64) || (sew == 2 && f6 == 0x12)))
+        return RVV_EXEC_ILLEGAL;
+
+    /* Scalar operand, NaN-boxing is not checked as by the scalar FP
+     * instructions */
+    b = zext_e(s->fp_reg[c->vs1], sew);
+
+    c->info->op_class = RVV_CLASS_FPU;
+    switch (f6) {
+    case 0x00: case 0x02: case 0x04: case 0x06: case 0x08: case 0x09:
+    case 0x0a: case 0x20: case 0x21: case 0x24: case 0x27:
+        if (is_vv && (f6 == 0x21 || f6 == 0x27))
+            return RVV_EXEC_ILLEGAL;
+        if (!single_width_regs(c, FALSE, is_vv, FALSE))
+            return RVV_EXEC_ILLEGAL;
+        if (f6 == 0x20 || f6 == 0x21)
+            c->info->op_class = RVV_CLASS_FDIV;
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            if (elem_active(c, i))
+                vput(s, c->vd, i, sew,
+                     fp_binop(c, sew, f6, vs(c, c->vs2, i, sew),
+                              is_vv ? vs(c, c->vs1, i, sew) : b, &fl));
+        }
+        break;
+
+    case 0x01: case 0x03: case 0x05: case 0x07:
+        /* vfredusum, vfredosum, vfredmin, vfredmax: the unordered sum is
+         * computed in element order */
+        if (!is_vv || c->vstart != 0 || !group_ok(c->vs2, lmul))
+            return RVV_EXEC_ILLEGAL;
+        add_src(c, c->vs2, lmul);
+        add_src(c, c->vs1, 0);
+        add_dst(c, c->vd, 0);
+        prepare_sources(c);
+        if (c->vl == 0)
+            break;
+        r = vs(c, c->vs1, 0, sew);
+        for (i = 0; i < c->vl; i++) {
+            if (elem_active(c, i))
+                r = fp_binop(c, sew, (f6 <= 0x03) ? 0x00 : f6 - 1, r,
+                             vs(c, c->vs2, i, sew), &fl);
+        }
+        vput(s, c->vd, 0, sew, r);
+        break;
+
+    case 0x0e: /* vfslide1up */
+    case 0x0f: /* vfslide1down */
+        if (is_vv || !single_width_regs(c, FALSE, FALSE, FALSE))
+            return RVV_EXEC_ILLEGAL;
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            if (!elem_active(c, i))
+                continue;
+            if (f6 == 0x0e)
+                r = (i == 0) ? b : vs(c, c->vs2, i - 1, sew);
+            else
+                r = (i == c->vl - 1) ? b : vs(c, c->vs2, i + 1, sew);
+            vput(s, c->vd, i, sew, r);
+        }
+        break;
+
+    case 0x10:
+        if (!c->vm)
+            return RVV_EXEC_ILLEGAL;
+        c->info->elems = 1;
+        if (is_vv) {
+            /* vfmv.f.s, the value is NaN-boxed */
+            if (c->vs1 != 0)
+                return RVV_EXEC_ILLEGAL;
+            add_src(c, c->vs2, 0);
+            r = vget(s, c->vs2, 0, sew);
+            if (sew < FLEN / 8)
+                r |= ~(uint64_t)0 << (sew * 8);
+            s->fp_reg[c->vd] = r;
+            s->fs = 3;
+            c->info->scalar_dest = TRUE;
+        } else {
+            /* vfmv.s.f */
+            if (c->vs2 != 0)
+                return RVV_EXEC_ILLEGAL;
+            add_dst(c, c->vd, 0);
+            if (c->vstart < c->vl)
+                vput(s, c->vd, 0, sew, b);
+        }
+        break;
+
+    case 0x12: /* VFUNARY0 */
+    case 0x13: /* VFUNARY1 */
+        if (f6 == 0x12 && c->vs1 >= 8) {
+            /* vfwcvt (vd has EEW = 2 * SEW) and vfncvt (vs2 has EEW =
+             * 2 * SEW) */
+            int op = c->vs1;
+            int narrow = (op >= 16);
+            int eew_ok;
+
+            if (!is_vv || op == 13 || op > 23 || lmul > 2
+                || (!c->vm && c->vd == 0)
+                || !group_ok(c->vd, narrow ? lmul : lmul + 1)
+                || !group_ok(c->vs2, narrow ? lmul + 1 : lmul))
+                return RVV_EXEC_ILLEGAL;
+            if ((op & 7) == 2 || (op & 7) == 3)
+                eew_ok = narrow ? (sew == 4) : (sew == 2 || wide);
+            else if (op == 12 || op == 20 || op == 21)
+                eew_ok = wide;
+            else
+                eew_ok = narrow ? (sew == 2 || wide) : (sew == 4);
+            if (!eew_ok)
+                return RVV_EXEC_ILLEGAL;
+            add_src(c, c->vs2, narrow ? lmul + 1 : lmul);
+            add_dst(c, c->vd, narrow ? lmul : lmul + 1);
+            prepare_sources(c);
+            for (i = c->vstart; i < c->vl; i++) {
+                if (elem_active(c, i))
+                    vput(s, c->vd, i, narrow ? sew : 2 * sew,
+                         fp_cvt_wide(c, op,
+                                     vs(c, c->vs2, i,
+                                        narrow ? 2 * sew : sew),
+                                     &fl));
+            }
+            break;
+        }
+        if (sew == 2 || !is_vv || !single_width_regs(c, FALSE, FALSE, FALSE))
+            return RVV_EXEC_ILLEGAL;
+        if ((f6 == 0x12 && (c->vs1 == 4 || c->vs1 == 5))
+            || (f6 == 0x13 && c->vs1 != 0x00 && c->vs1 != 0x04
+                && c->vs1 != 0x05 && c->vs1 != 0x10))
+            return RVV_EXEC_ILLEGAL;
+        if (f6 == 0x13 && c->vs1 == 0)
+            c->info->op_class = RVV_CLASS_FDIV;
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            if (!elem_active(c, i))
+                continue;
+            a = vs(c, c->vs2, i, sew);
+            if (f6 == 0x13 && (c->vs1 == 0x04 || c->vs1 == 0x05))
+                r = fp_estimate(c, c->vs1 == 0x05, a, &fl);
+            else
+                r = fp_unary(c, f6, c->vs1, a, &fl);
+            vput(s, c->vd, i, sew, r);
+        }
+        break;
+
+    case 0x17: /* vfmerge.vfm, vfmv.v.f */
+        if (is_vv || (c->vm && c->vs2 != 0) || !group_ok(c->vd, lmul)
+            || (!c->vm && c->vd == 0))
+            return RVV_EXEC_ILLEGAL;
+        add_dst(c, c->vd, lmul);
+        if (!c->vm) {
+            if (!group_ok(c->vs2, lmul))
+                return RVV_EXEC_ILLEGAL;
+            add_src(c, c->vs2, lmul);
+        }
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            vput(s, c->vd, i, sew,
+                 (c->vm || vsmask(c, 0, i)) ? b : vs(c, c->vs2, i, sew));
+        }
+        break;
+
+    case 0x18: case 0x19: case 0x1b: case 0x1c: case 0x1d: case 0x1f:
+        if (is_vv && (f6 == 0x1d || f6 == 0x1f))
+            return RVV_EXEC_ILLEGAL;
+        if (!single_width_regs(c, TRUE, is_vv, FALSE))
+            return RVV_EXEC_ILLEGAL;
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            if (elem_active(c, i))
+                vmask_put(s, c->vd, i,
+                          fp_cmp(c, f6, vs(c, c->vs2, i, sew),
+                                 is_vv ? vs(c, c->vs1, i, sew) : b, &fl));
+        }
+        break;
+
+    case 0x28: case 0x29: case 0x2a: case 0x2b:
+    case 0x2c: case 0x2d: case 0x2e: case 0x2f:
+        if (!single_width_regs(c, FALSE, is_vv, TRUE))
+            return RVV_EXEC_ILLEGAL;
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            if (!elem_active(c, i))
+                continue;
+            a = vs(c, c->vs2, i, sew);
+            d = vs(c, c->vd, i, sew);
+            if (is_vv)
+                b = vs(c, c->vs1, i, sew);
+            /* Bit 0 negates the product, the addend (vs2 for 0x28-0x2b, vd
+             * otherwise) is negated when bits 0 and 1 differ */
+            if (f6 < 0x2c)
+                r = fp_fma(c, sew, b, d, a, f6 & 1, ((f6 >> 1) ^ f6) & 1,
+                           &fl);
+            else
+                r = fp_fma(c, sew, b, a, d, f6 & 1, ((f6 >> 1) ^ f6) & 1,
+                           &fl);
+            vput(s, c->vd, i, sew, r);
+        }
+        break;
+
+#if FLEN >= 64
+    case 0x30: case 0x32: case 0x34: case 0x36: case 0x38:
+    case 0x3c: case 0x3d: case 0x3e: case 0x3f: {
+        /* vfwadd, vfwsub, vfwadd.w, vfwsub.w, vfwmul, vfwmacc, vfwnmacc,
+         * vfwmsac, vfwnmsac: vd has EEW = 2 * SEW, the single precision
+         * operands are converted exactly */
+        int wide_vs2 = (f6 == 0x34 || f6 == 0x36);
+        int use_vd = (f6 >= 0x3c);
+
+        if (!wide || lmul > 2 || !group_ok(c->vd, lmul + 1)
+            || (!c->vm && c->vd == 0)
+            || !group_ok(c->vs2, wide_vs2 ? lmul + 1 : lmul))
+            return RVV_EXEC_ILLEGAL;
+        add_dst(c, c->vd, lmul + 1);
+        add_src(c, c->vs2, wide_vs2 ? lmul + 1 : lmul);
+        if (use_vd)
+            add_src(c, c->vd, lmul + 1);
+        if (is_vv) {
+            if (!group_ok(c->vs1, lmul))
+                return RVV_EXEC_ILLEGAL;
+            add_src(c, c->vs1, lmul);
+        }
+        prepare_sources(c);
+        for (i = c->vstart; i < c->vl; i++) {
+            if (!elem_active(c, i))
+                continue;
+            a = vs(c, c->vs2, i, wide_vs2 ? 8 : 4);
+            if (!wide_vs2)
+                a = cvt_sf32_sf64(a, &fl);
+            d = cvt_sf32_sf64(is_vv ? vs(c, c->vs1, i, 4) : b, &fl);
+            if (use_vd)
+                r = fp_fma(c, 8, d, a, vs(c, c->vd, i, 8), f6 & 1,
+                           ((f6 >> 1) ^ f6) & 1, &fl);
+            else
+                r = fp_binop(c, 8, (f6 == 0x38) ? 0x24 : f6 & 0x02, a, d,
+                             &fl);
+            vput(s, c->vd, i, 8, r);
+        }
+        break;
+    }
+
+    case 0x31: case 0x33:
+        /* vfwredusum, vfwredosum: vs1 and vd have EEW = 2 * SEW, the
+         * unordered sum is computed in element order */
+        if (!is_vv || !wide || c->vstart != 0 || !group_ok(c->vs2, lmul))
+            return RVV_EXEC_ILLEGAL;
+        add_src(c, c->vs2, lmul);
+        add_src(c, c->vs1, 0);
+        add_dst(c, c->vd, 0);
+        prepare_sources(c);
+        if (c->vl == 0)
+            break;
+        r = vs(c, c->vs1, 0, 8);
+        for (i = 0; i < c->vl; i++) {
+            if (elem_active(c, i))
+                r = add_sf64(r, cvt_sf32_sf64(vs(c, c->vs2, i, 4), &fl),
+                             s->frm, &fl);
+        }
+        vput(s, c->vd, 0, 8, r);
+        break;
+#endif
+
+    default:
+        return RVV_EXEC_ILLEGAL;
+    }
+
+    if (fl) {
+        s->fflags |= fl;
+        s->fs = 3;
+    }
+    return RVV_EXEC_OK;
+}
+
+#endif /* FLEN > 0 */
+
+/*===========  Entry point  ===========*/
+
+/* Executes the vector instruction insn (OP-V, or LOAD-FP/STORE-FP with a
+ * vector width). If info is not NULL, it receives the operands and the size
+ * of the operation for the timing model. hook, if not NULL, is called for
+ * every RAM access, a non-zero return value stops the instruction after the
+ * current element with vstart set to the next element, so that it can be
+ * resumed by executing it again. */
+int riscv_vector_exec(RISCVCPUState *s, uint32_t insn, RVVInsnInfo *info,
+                      RVVMemAccessHook hook, void *opaque)
+{
+    RVVInsnInfo dummy_info;
+    VCtx ctx, *c = &ctx;
+    int opcode = insn & 0x7f;
+    int ret, vill;
+
+    if (!info)
+        info = &dummy_info;
+    memset(info, 0, sizeof(*info));
+
+    if (s->vlenb == 0 || ((s->mstatus & MSTATUS_VS) == 0))
+        return RVV_EXEC_ILLEGAL;
+
+    c->s = s;
+    c->info = info;
+    c->insn = insn;
+    c->funct3 = (insn >> 12) & 7;
+    c->funct6 = insn >> 26;
+    c->vm = (insn >> 25) & 1;
+    c->vd = (insn >> 7) & 0x1f;
+    c->vs1 = (insn >> 15) & 0x1f;
+    c->vs2 = (insn >> 20) & 0x1f;
+    c->vl = s->vl;
+    c->vstart = s->vstart;
+    c->src_base = 0;
+    vill = (s->vtype & VTYPE_VILL) != 0;
+    c->sew = vill ? 1 : vtype_sew(s->vtype);
+    c->lmul_log2 = vill ? 0 : vtype_lmul_log2(s->vtype);
+
+    if (opcode == 0x57 && c->funct3 == OPCFG) {
+        ret = exec_vset(c);
+    } else {
+        if (!c->vm)
+            info->src_regs |= 1;
+        info->elems = (c->vl > c->vstart) ? c->vl - c->vstart : 0;
+        info->elem_bytes = c->sew;
+        if (opcode != 0x57) {
+            ret = exec_mem(c, opcode == 0x27, hook, opaque);
+        } else if (vill && !(c->funct3 == OPIVI && c->funct6 == 0x27)) {
+            ret = RVV_EXEC_ILLEGAL;
+        } else {
+            switch (c->funct3) {
+            case OPIVV:
+            case OPIVI:
+            case OPIVX:
+                ret = exec_opi(c);
+                break;
+            case OPMVV:
+            case OPMVX:
+                ret = exec_opm(c);
+                break;
+            default:
+#if FLEN > 0
+                ret = exec_opf(c);
+#else
+                ret = RVV_EXEC_ILLEGAL;
+#endif
+                break;
+            }
+        }
+        if (ret == RVV_EXEC_OK)
+            s->vstart = 0;
+    }
+
+    if (ret != RVV_EXEC_ILLEGAL)
+        s->mstatus |= MSTATUS_VS;
+    return ret;
+}
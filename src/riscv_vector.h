@@ -0,0 +1,77 @@
+/*
+ * RISCV vector extension (RVV 1.0)
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2017-2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef RISCV_VECTOR_H
+#define RISCV_VECTOR_H
+
+#include <inttypes.h>
+#include "riscv_cpu.h"
+
+#define RVV_MAX_VLEN 4096
+
+/* Return values of riscv_vector_exec() */
+#define RVV_EXEC_OK 0
+#define RVV_EXEC_PARTIAL 1 /* stopped by the access hook, vstart is set */
+#define RVV_EXEC_ILLEGAL -1
+#define RVV_EXEC_FAULT -2 /* memory exception pending, vstart is set */
+
+/* Functional unit classes of the vector instructions, used by the timing
+ * model */
+#define RVV_CLASS_CFG 0
+#define RVV_CLASS_ALU 1
+#define RVV_CLASS_MUL 2
+#define RVV_CLASS_DIV 3
+#define RVV_CLASS_FPU 4
+#define RVV_CLASS_FDIV 5
+#define RVV_CLASS_LOAD 6
+#define RVV_CLASS_STORE 7
+#define RVV_NUM_CLASSES 8
+
+/* Filled by riscv_vector_exec() with the description of the executed
+ * instruction */
+typedef struct RVVInsnInfo {
+    int op_class;
+    uint32_t src_regs; /* bitmask of the vector registers read */
+    uint32_t dst_regs; /* bitmask of the vector registers written */
+    uint32_t elems;    /* number of element positions processed */
+    int elem_bytes;    /* width of the widest element processed */
+    int scalar_dest;   /* writes an integer or floating point register */
+} RVVInsnInfo;
+
+/* Called after every element access to the guest RAM with its physical
+ * address. A non zero return value ends the execution of a memory
+ * instruction after the current element with RVV_EXEC_PARTIAL, calling
+ * riscv_vector_exec() again continues from vstart. */
+typedef int (*RVVMemAccessHook)(void *opaque, uint64_t paddr, int bytes,
+                                int is_write);
+
+void riscv_vector_init(RISCVCPUState *s, int vlen);
+void riscv_vector_free(RISCVCPUState *s);
+int riscv_vector_is_mem_width(uint32_t funct3);
+int riscv_vector_exec(RISCVCPUState *s, uint32_t insn, RVVInsnInfo *info,
+                      RVVMemAccessHook hook, void *opaque);
+
+#endif /* RISCV_VECTOR_H */
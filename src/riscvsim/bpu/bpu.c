@@ -33,20 +33,24 @@
 void
 bpu_flush(BranchPredUnit *u)
 {
-    btb_flush(u->btb);
-
-    switch (u->bpu_type)
+    /* Shared tables are flushed by the unit owning them */
+    if (u->owns_tables)
     {
-        case BPU_TYPE_BIMODAL:
-        {
-            bht_flush(u->bht);
-            break;
-        }
+        btb_flush(u->btb);
 
-        case BPU_TYPE_ADAPTIVE:
+        switch (u->bpu_type)
         {
-            adaptive_predictor_flush(u->ap);
-            break;
+            case BPU_TYPE_BIMODAL:
+            {
+                bht_flush(u->bht);
+                break;
+            }
+
+            case BPU_TYPE_ADAPTIVE:
+            {
+                adaptive_predictor_flush(u->ap);
+                break;
+            }
         }
     }
 
@@ -223,7 +227,7 @@ bpu_update(BranchPredUnit *u, target_ulong pc, target_ulong target, int pred,
 }
 
 BranchPredUnit *
-bpu_init(const SimParams *p, SimStats *s)
+bpu_init(const SimParams *p, SimStats *s, const BranchPredUnit *shared)
 {
     BranchPredUnit *u;
 
@@ -234,8 +238,23 @@ bpu_init(const SimParams *p, SimStats *s)
     u->ap = NULL;
     u->ras = NULL;
     u->stats = s;
-    u->btb = btb_init(p);
     u->bpu_type = p->bpu_type;
+    u->owns_tables = (NULL == shared);
+
+    if (p->ras_size)
+    {
+        u->ras = ras_init(p);
+    }
+
+    if (NULL != shared)
+    {
+        u->btb = shared->btb;
+        u->bht = shared->bht;
+        u->ap = shared->ap;
+        return u;
+    }
+
+    u->btb = btb_init(p);
 
     switch (u->bpu_type)
     {
@@ -252,31 +271,29 @@ bpu_init(const SimParams *p, SimStats *s)
         }
     }
 
-    if (p->ras_size)
-    {
-        u->ras = ras_init(p);
-    }
-
     return u;
 }
 
 void
 bpu_free(BranchPredUnit **u)
 {
-    btb_free(&(*u)->btb);
-
-    switch ((*u)->bpu_type)
+    if ((*u)->owns_tables)
     {
-        case BPU_TYPE_BIMODAL:
-        {
-            bht_free(&(*u)->bht);
-            break;
-        }
+        btb_free(&(*u)->btb);
 
-        case BPU_TYPE_ADAPTIVE:
+        switch ((*u)->bpu_type)
         {
-            adaptive_predictor_free(&(*u)->ap);
-            break;
+            case BPU_TYPE_BIMODAL:
+            {
+                bht_free(&(*u)->bht);
+                break;
+            }
+
+            case BPU_TYPE_ADAPTIVE:
+            {
+                adaptive_predictor_free(&(*u)->ap);
+                break;
+            }
         }
     }
 
@@ -63,9 +63,15 @@ typedef struct BranchPredUnit
 
     /* Predictor type: bimodal or adaptive */
     int bpu_type;
+
+    /* The threads of an SMT core share the BTB and the direction predictor
+     * of the unit of the first thread, the RAS and the stats are per
+     * thread */
+    int owns_tables;
 } BranchPredUnit;
 
-BranchPredUnit *bpu_init(const SimParams *p, SimStats *s);
+BranchPredUnit *bpu_init(const SimParams *p, SimStats *s,
+                         const BranchPredUnit *shared);
 target_ulong bpu_get_target(BranchPredUnit *u, target_ulong pc,
                             BtbEntry *btb_entry);
 void bpu_probe(BranchPredUnit *u, target_ulong pc, BPUResponsePkt *p, int priv);
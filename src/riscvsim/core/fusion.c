@@ -0,0 +1,131 @@
+/**
+ * Macro-op Fusion
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "../riscv_sim_macros.h"
+#include "fusion.h"
+
+int
+fusion_match(const SimParams *p, const RVInstruction *head,
+             const RVInstruction *next)
+{
+    uint32_t insn = next->binary;
+    uint32_t opcode = insn & 0x7f;
+    uint32_t funct3 = (insn >> 12) & 7;
+    int pattern = FUSION_NONE;
+
+    /* Only adjacent 32-bit instructions writing the same register, which the
+     * second one also reads, are fused */
+    if (head->fusion || head->exception || ((head->binary & 3) != 3)
+        || ((insn & 3) != 3) || (next->pc != head->pc + 4)
+        || !head->has_dest || (head->rd == 0)
+        || (((insn >> 7) & 0x1f) != head->rd)
+        || (((insn >> 15) & 0x1f) != head->rd))
+    {
+        return FUSION_NONE;
+    }
+
+    switch (head->major_opcode)
+    {
+        case LUI_MASK:
+        {
+            /* addi, addiw */
+            if (((opcode == OP_IMM_MASK) || (opcode == OP_IMM_32_MASK))
+                && (funct3 == 0))
+            {
+                pattern = FUSION_LUI_ADDI;
+            }
+            break;
+        }
+        case AUIPC_MASK:
+        {
+            if ((opcode == JALR_MASK) && (funct3 == 0))
+            {
+                pattern = FUSION_AUIPC_JALR;
+            }
+            break;
+        }
+        case OP_IMM_MASK:
+        {
+            /* slli followed by a srli by the same amount */
+            if ((head->funct3 == 1) && (opcode == OP_IMM_MASK) && (funct3 == 5)
+                && ((insn >> 26) == 0)
+                && ((insn >> 20) == (head->binary >> 20)))
+            {
+                pattern = FUSION_SLLI_SRLI;
+            }
+            break;
+        }
+        case OP_MASK:
+        {
+            /* add followed by a load */
+            if ((head->funct3 == 0) && (head->funct7 == 0)
+                && (opcode == LOAD_MASK) && (funct3 != 7))
+            {
+                pattern = FUSION_ADD_LOAD;
+            }
+            break;
+        }
+    }
+
+    return p->fusion[pattern] ? pattern : FUSION_NONE;
+}
+
+void
+fusion_merge(RVInstruction *ins, const RVInstruction *head, int pattern)
+{
+    ins->fusion = pattern;
+    ins->fused_type = head->type;
+    ins->fused_pc = head->pc;
+
+    switch (pattern)
+    {
+        case FUSION_LUI_ADDI:
+        {
+            ins->has_src1 = FALSE;
+            ins->rs1_val = (target_long)head->imm;
+            break;
+        }
+        case FUSION_AUIPC_JALR:
+        {
+            ins->has_src1 = FALSE;
+            ins->rs1_val = (target_long)(head->pc + head->imm);
+            break;
+        }
+        case FUSION_SLLI_SRLI:
+        {
+            ins->rs1 = head->rs1;
+            ins->fused_imm = head->imm;
+            break;
+        }
+        case FUSION_ADD_LOAD:
+        {
+            ins->rs1 = head->rs1;
+            ins->rs2 = head->rs2;
+            ins->has_src2 = TRUE;
+            break;
+        }
+    }
+}
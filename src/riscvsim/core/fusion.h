@@ -0,0 +1,55 @@
+/**
+ * Macro-op Fusion
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _FUSION_H_
+#define _FUSION_H_
+
+#include "../decoder/riscv_instruction.h"
+#include "../utils/sim_params.h"
+
+/* Macro-op fusion pairs the instruction leaving decode with the instruction
+ * fetched right after it. A pair is fused when the first instruction only
+ * produces an operand of the second one, and the second one overwrites the
+ * destination of the first one:
+ *
+ *   lui rd, imm1;  addi(w) rd, rd, imm2   -> load a 32-bit constant
+ *   auipc rd, imm1;  jalr rd, imm2(rd)    -> PC relative call
+ *   slli rd, rs, n;  srli rd, rd, n       -> zero-extension
+ *   add rd, rs1, rs2;  l{b,h,w,d} rd, imm(rd) -> indexed load
+ *
+ * The fused pair flows down the pipeline in the latch of the second
+ * instruction with the sources of the first one, and occupies a single
+ * dispatch slot, issue queue entry, ROB entry and FU. It commits as two
+ * instructions. */
+
+/* Returns the FUSION_* pattern formed by the decoded instruction head and
+ * the next instruction, of which only the pc and the binary are read */
+int fusion_match(const SimParams *p, const RVInstruction *head,
+                 const RVInstruction *next);
+
+/* Folds head into the decoded instruction ins following it */
+void fusion_merge(RVInstruction *ins, const RVInstruction *head, int pattern);
+#endif
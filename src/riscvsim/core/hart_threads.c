@@ -0,0 +1,272 @@
+/**
+ * Host threads running the harts of a multi-hart machine
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Copyright (c) 2018-2019 Parikshit Sarnaik {psarnai1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../utils/sim_log.h"
+#include "hart_threads.h"
+
+/* Next hart after hart, in hart order, yet to finish the step */
+static int
+next_turn(const HartThreads *ht, int hart)
+{
+    int i, next;
+
+    for (i = 1; i <= ht->num_harts; ++i)
+    {
+        next = (hart + i) % ht->num_harts;
+        if (ht->turn_mask & (1u << next))
+        {
+            return next;
+        }
+    }
+    return hart;
+}
+
+static void
+wait_turn(HartThreads *ht, int hart)
+{
+    while (ht->turn != hart)
+    {
+        pthread_cond_wait(&ht->sync_cond, &ht->lock);
+    }
+}
+
+static void
+run_step(HartThreads *ht, int hart, int n_cycles)
+{
+    if (ht->deterministic)
+    {
+        pthread_mutex_lock(&ht->lock);
+        wait_turn(ht, hart);
+        pthread_mutex_unlock(&ht->lock);
+    }
+
+    (*ht->pfn_run)(ht->opaque, hart, n_cycles);
+
+    pthread_mutex_lock(&ht->lock);
+    if (ht->deterministic)
+    {
+        ht->turn_mask &= ~(1u << hart);
+        ht->turn = next_turn(ht, hart);
+        pthread_cond_broadcast(&ht->sync_cond);
+    }
+    if (0 == --ht->num_running)
+    {
+        pthread_cond_broadcast(&ht->step_cond);
+    }
+    pthread_mutex_unlock(&ht->lock);
+}
+
+static void *
+hart_thread(void *arg)
+{
+    struct HartThreadArg *a = (struct HartThreadArg *)arg;
+    HartThreads *ht = a->ht;
+    uint64_t step = 0;
+    int n_cycles;
+
+    pthread_mutex_lock(&ht->lock);
+    while (1)
+    {
+        while (!ht->exit && (ht->step == step))
+        {
+            pthread_cond_wait(&ht->step_cond, &ht->lock);
+        }
+
+        if (ht->exit)
+        {
+            break;
+        }
+
+        step = ht->step;
+        n_cycles = ht->step_cycles;
+        pthread_mutex_unlock(&ht->lock);
+        run_step(ht, a->hart, n_cycles);
+        pthread_mutex_lock(&ht->lock);
+    }
+    pthread_mutex_unlock(&ht->lock);
+    return NULL;
+}
+
+HartThreads *
+hart_threads_init(const SimParams *p, PFN_HART_THREAD_RUN pfn_run, void *opaque)
+{
+    int i;
+    HartThreads *ht;
+    pthread_mutexattr_t attr;
+
+    ht = (HartThreads *)calloc(1, sizeof(HartThreads));
+    assert(ht);
+
+    ht->num_harts = p->num_harts;
+    ht->sync_quantum = p->sync_quantum;
+    ht->deterministic = (1 == p->sync_quantum);
+    ht->pfn_run = pfn_run;
+    ht->opaque = opaque;
+
+    pthread_mutex_init(&ht->lock, NULL);
+    pthread_cond_init(&ht->step_cond, NULL);
+    pthread_cond_init(&ht->sync_cond, NULL);
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&ht->io_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    /* Boot hart runs on the calling thread */
+    for (i = 1; i < ht->num_harts; ++i)
+    {
+        ht->args[i].ht = ht;
+        ht->args[i].hart = i;
+        sim_assert((0 == pthread_create(&ht->threads[i], NULL, &hart_thread,
+                                        &ht->args[i])),
+                   "error: %s at line %d in %s(): %s", __FILE__, __LINE__,
+                   __func__, "failed to create host thread");
+    }
+
+    sim_log_event_to_file(sim_log, "Running %d harts on host threads, %s",
+                          ht->num_harts,
+                          ht->deterministic ? "deterministic mode"
+                                            : "lax synchronization");
+    return ht;
+}
+
+/* Runs n_cycles instructions on every hart, returns once all the harts are
+ * done */
+void
+hart_threads_run(HartThreads *ht, int n_cycles)
+{
+    pthread_mutex_lock(&ht->lock);
+    ht->step_cycles = n_cycles;
+    ht->num_running = ht->num_harts;
+    ht->turn_mask = (1u << ht->num_harts) - 1;
+    ht->turn = 0;
+    ht->in_step = TRUE;
+    ++ht->step;
+    pthread_cond_broadcast(&ht->step_cond);
+    pthread_mutex_unlock(&ht->lock);
+
+    run_step(ht, 0, n_cycles);
+
+    pthread_mutex_lock(&ht->lock);
+    while (ht->num_running)
+    {
+        pthread_cond_wait(&ht->step_cond, &ht->lock);
+    }
+    ht->in_step = FALSE;
+    pthread_mutex_unlock(&ht->lock);
+}
+
+int
+hart_threads_in_step(const HartThreads *ht)
+{
+    return ht->in_step;
+}
+
+/* Called by a hart between the instruction batches of a step. In
+ * deterministic mode, passes the turn to the next hart and waits for it to
+ * come back. */
+void
+hart_threads_yield(HartThreads *ht, int hart)
+{
+    if (ht->deterministic)
+    {
+        pthread_mutex_lock(&ht->lock);
+        ht->turn = next_turn(ht, hart);
+        pthread_cond_broadcast(&ht->sync_cond);
+        wait_turn(ht, hart);
+        pthread_mutex_unlock(&ht->lock);
+    }
+}
+
+/* Called by every hart in simulation mode at the end of every sync_quantum
+ * cycles. The last hart to arrive runs pfn_barrier, returns its result. */
+int
+hart_threads_sync(HartThreads *ht, int hart,
+                  PFN_HART_THREAD_BARRIER pfn_barrier, void *opaque)
+{
+    int ret;
+    uint64_t epoch;
+
+    pthread_mutex_lock(&ht->lock);
+    epoch = ht->sync_epoch;
+    if (++ht->num_sync_arrived == ht->num_harts)
+    {
+        pthread_mutex_unlock(&ht->lock);
+        ret = (*pfn_barrier)(opaque);
+        pthread_mutex_lock(&ht->lock);
+        ht->sync_result = ret;
+        ht->num_sync_arrived = 0;
+        ++ht->sync_epoch;
+        pthread_cond_broadcast(&ht->sync_cond);
+    }
+
+    if (ht->deterministic)
+    {
+        ht->turn = next_turn(ht, hart);
+        pthread_cond_broadcast(&ht->sync_cond);
+        wait_turn(ht, hart);
+    }
+    else
+    {
+        while (epoch == ht->sync_epoch)
+        {
+            pthread_cond_wait(&ht->sync_cond, &ht->lock);
+        }
+    }
+    ret = ht->sync_result;
+    pthread_mutex_unlock(&ht->lock);
+    return ret;
+}
+
+void
+hart_threads_free(HartThreads **ht)
+{
+    int i;
+
+    pthread_mutex_lock(&(*ht)->lock);
+    (*ht)->exit = TRUE;
+    pthread_cond_broadcast(&(*ht)->step_cond);
+    pthread_mutex_unlock(&(*ht)->lock);
+
+    for (i = 1; i < (*ht)->num_harts; ++i)
+    {
+        pthread_join((*ht)->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&(*ht)->io_lock);
+    pthread_cond_destroy(&(*ht)->sync_cond);
+    pthread_cond_destroy(&(*ht)->step_cond);
+    pthread_mutex_destroy(&(*ht)->lock);
+    free(*ht);
+    *ht = NULL;
+}
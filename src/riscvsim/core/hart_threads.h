@@ -0,0 +1,110 @@
+/**
+ * Host threads running the harts of a multi-hart machine
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Copyright (c) 2018-2019 Parikshit Sarnaik {psarnai1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _HART_THREADS_H_
+#define _HART_THREADS_H_
+
+#include <pthread.h>
+
+#include "../riscv_sim_typedefs.h"
+#include "../utils/sim_params.h"
+
+/* Runs n_cycles instructions on the given hart */
+typedef void (*PFN_HART_THREAD_RUN)(void *opaque, int hart, int n_cycles);
+
+/* Run by the last hart reaching a synchronization point, while the other
+ * harts wait. Returns FALSE to end the step. */
+typedef int (*PFN_HART_THREAD_BARRIER)(void *opaque);
+
+/* Every hart of a multi-hart machine runs on its own host thread, the boot
+ * hart on the thread calling hart_threads_run(). A step runs the given number
+ * of instructions on every hart in parallel and returns once all the harts are
+ * done, the devices and the mode switches are processed between the steps.
+ *
+ * In simulation mode, all the harts meet every sync_quantum cycles (lax
+ * synchronization): the last hart reaching the end of the quantum runs the
+ * barrier function, which performs the accesses of the harts to the shared
+ * levels of the memory hierarchy, while the other harts wait. Harts in
+ * emulation mode are not synchronized.
+ *
+ * With sync_quantum 1 (deterministic mode), the harts take turns in hart order
+ * instead: a hart in simulation mode passes the turn after every cycle, a hart
+ * in emulation mode after every hart_quantum instructions. Only one hart runs
+ * at a time, in the order of the cycle loop of the machine without host
+ * threads, so the outcome is the same as without host threads, which is used
+ * to validate the parallel mode. */
+typedef struct HartThreads
+{
+    int num_harts;
+    int sync_quantum;
+    int deterministic;
+    PFN_HART_THREAD_RUN pfn_run;
+    void *opaque;
+
+    pthread_t threads[NUM_MAX_HARTS];
+    struct HartThreadArg
+    {
+        struct HartThreads *ht;
+        int hart;
+    } args[NUM_MAX_HARTS];
+
+    /* Steps dispatched to the worker threads */
+    pthread_mutex_t lock;
+    pthread_cond_t step_cond;
+    pthread_cond_t sync_cond;
+    uint64_t step;
+    int step_cycles;
+    int num_running;
+    int in_step;
+    int exit;
+
+    /* Synchronization barrier of the harts in simulation mode, and the
+     * result of its barrier function */
+    int num_sync_arrived;
+    uint64_t sync_epoch;
+    int sync_result;
+
+    /* Deterministic mode: harts yet to finish the step and the hart holding
+     * the turn */
+    uint32_t turn_mask;
+    int turn;
+
+    /* Serializes the accesses to the devices */
+    pthread_mutex_t io_lock;
+} HartThreads;
+
+HartThreads *hart_threads_init(const SimParams *p, PFN_HART_THREAD_RUN pfn_run,
+                               void *opaque);
+void hart_threads_run(HartThreads *ht, int n_cycles);
+int hart_threads_in_step(const HartThreads *ht);
+void hart_threads_yield(HartThreads *ht, int hart);
+int hart_threads_sync(HartThreads *ht, int hart,
+                      PFN_HART_THREAD_BARRIER pfn_barrier, void *opaque);
+void hart_threads_free(HartThreads **ht);
+#endif
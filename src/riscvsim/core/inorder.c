@@ -141,6 +141,7 @@ in_core_reset(void *core_type)
 
     /* Reset EX to Memory queue */
     core->ins_dispatch_id = 0;
+    core->td_recovering = FALSE;
     cq_reset(&core->ex_to_mem_queue.cq);
 
     /* Reset Data FWD latches */
@@ -212,77 +213,130 @@ in_core_pipeline_drained(const INCore *core)
     return PIPELINE_DRAINED;
 }
 
+/* Advances the pipeline by a cycle, returns TRUE once it left simulation on
+ * an exception */
+int
+in_core_step(void *core_type)
+{
+    INCore *core = (INCore *)core_type;
+    RISCVCPUState *s = core->simcpu->emu_cpu_state;
+
+    /* For 5-stage pipeline calls in_core_run_5_stage(), For 6-stage pipeline
+     * calls in_core_run_6_stage() */
+    if (core->pfn_incore_run_internal(core))
+    {
+        return TRUE;
+    }
+
+    /* If an exception occurred and pipeline is drained, safely exit from
+     * simulation */
+    if (s->simcpu->exception->pending && in_core_pipeline_drained(core))
+    {
+        return TRUE;
+    }
+
+    in_core_topdown(core);
+
+    /* Advance simulation cycle */
+    ++s->simcpu->clock;
+    ++s->simcpu->stats[s->priv].cycles;
+
+    if (NULL != s->simcpu->registry)
+    {
+        riscv_sim_cpu_sample_stats(s->simcpu);
+    }
+    return FALSE;
+}
+
 int
 in_core_run(void *core_type)
 {
     INCore *core = (INCore *)core_type;
     RISCVCPUState *s = core->simcpu->emu_cpu_state;
+    uint64_t host_time;
 
     while (1)
     {
         /* Advance DRAM clock */
+        host_time = host_profile_start(s->simcpu->host_profile);
         mem_controller_clock(s->simcpu->mem_hierarchy->mem_controller);
+        host_profile_mark(s->simcpu->host_profile, HOST_PROFILE_DRAM, host_time);
 
-        /* For 5-stage pipeline calls in_core_run_5_stage(), For 6-stage
-         * pipeline calls in_core_run_6_stage() */
-        if (core->pfn_incore_run_internal(core))
-        {
-            return s->simcpu->exception->cause;
-        }
-
-        /* If an exception occurred and pipeline is drained, safely exit from
-         * simulation */
-        if (s->simcpu->exception->pending && in_core_pipeline_drained(core))
+        if (in_core_step(core))
         {
             return s->simcpu->exception->cause;
         }
-
-        /* Advance simulation cycle */
-        ++s->simcpu->clock;
-        ++s->simcpu->stats[s->priv].cycles;
     }
 }
 
 int
 in_core_run_6_stage(INCore *core)
 {
+    SimHostProfile *hp = core->simcpu->host_profile;
+    uint64_t host_time = host_profile_start(hp);
+
     if (in_core_commit(core))
     {
         /* Timeout */
         return -1;
     }
 
+    host_time = host_profile_mark(hp, HOST_PROFILE_COMMIT, host_time);
+
     in_core_memory(core);
+    host_time = host_profile_mark(hp, HOST_PROFILE_MEMORY, host_time);
     in_core_execute_all(core);
+    host_time = host_profile_mark(hp, HOST_PROFILE_EXECUTE, host_time);
     in_core_decode(core);
 
     /* After the instruction in decode reads forwarded value, clear
      * forwarding latches. This keeps the data on forwarding latches valid
      * for exactly one cycle */
     memset((void *)core->fwd_latch, 0, sizeof(DataFWDLatch) * NUM_FWD_BUS);
+    host_time = host_profile_mark(hp, HOST_PROFILE_DECODE, host_time);
     in_core_fetch(core);
     in_core_pcgen(core);
+    host_time = host_profile_mark(hp, HOST_PROFILE_FETCH, host_time);
+    if (core->simcpu->params->enable_fusion)
+    {
+        in_core_fuse(core);
+        host_profile_mark(hp, HOST_PROFILE_FUSION, host_time);
+    }
     return 0;
 }
 
 int
 in_core_run_5_stage(INCore *core)
 {
+    SimHostProfile *hp = core->simcpu->host_profile;
+    uint64_t host_time = host_profile_start(hp);
+
     if (in_core_commit(core))
     {
         /* Timeout */
         return -1;
     }
 
+    host_time = host_profile_mark(hp, HOST_PROFILE_COMMIT, host_time);
+
     in_core_memory(core);
+    host_time = host_profile_mark(hp, HOST_PROFILE_MEMORY, host_time);
     in_core_execute_all(core);
+    host_time = host_profile_mark(hp, HOST_PROFILE_EXECUTE, host_time);
     in_core_decode(core);
 
     /* After the instruction in decode reads forwarded value, clear
      * forwarding latches. This keeps the data on forwarding latches valid
      * for exactly one cycle */
     memset((void *)core->fwd_latch, 0, sizeof(DataFWDLatch) * NUM_FWD_BUS);
+    host_time = host_profile_mark(hp, HOST_PROFILE_DECODE, host_time);
     in_core_pcgen(core);
     in_core_fetch(core);
+    host_time = host_profile_mark(hp, HOST_PROFILE_FETCH, host_time);
+    if (core->simcpu->params->enable_fusion)
+    {
+        in_core_fuse(core);
+        host_profile_mark(hp, HOST_PROFILE_FUSION, host_time);
+    }
     return 0;
 }
\ No newline at end of file
@@ -90,6 +90,11 @@ typedef struct INCore
 
     uint64_t ins_dispatch_id;
 
+    /*----------  Top-down accounting  ----------*/
+    int td_committed;       /* An instruction committed this cycle */
+    int td_recovering;      /* Refilling the pipeline after a mispredict */
+    uint64_t td_recover_id; /* First dispatch ID on the correct path */
+
     struct RISCVSIMCPUState *simcpu; /* Pointer to parent */
 } INCore;
 
@@ -97,15 +102,18 @@ typedef struct INCore
 INCore *in_core_init(const SimParams *p, struct RISCVSIMCPUState *simcpu);
 void in_core_reset(void *core_type);
 void in_core_free(void *core_type);
+int in_core_step(void *core_type);
 int in_core_run(void *core_type);
 
 /*----------  In-order core stages  ----------*/
 void in_core_pcgen(INCore *core);
 void in_core_fetch(INCore *core);
 void in_core_decode(INCore *core);
+void in_core_fuse(INCore *core);
 void in_core_execute_all(INCore *core);
 void in_core_memory(INCore *core);
 int in_core_commit(INCore *core);
+void in_core_topdown(INCore *core);
 int in_core_run_5_stage(INCore *core);
 int in_core_run_6_stage(INCore *core);
 #endif
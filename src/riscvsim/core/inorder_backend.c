@@ -99,7 +99,8 @@ static void
 fwd_data_from_ex_to_decode(INCore *core, InstructionLatch *e, int fu_type)
 {
     if (!e->data_fwd_done
-        && !(e->ins.is_load || e->ins.is_store || e->ins.is_atomic)
+        && !(e->ins.is_load || e->ins.is_store || e->ins.is_atomic
+             || e->ins.is_vector)
         && !e->keep_dest_busy
         && ((e->ins.has_dest && e->ins.rd != 0) || e->ins.has_fp_dest))
     {
@@ -120,6 +121,7 @@ push_insn_from_ex_to_mem(INCore *core, InstructionLatch *e, CPUStage *stage)
     {
         if (!core->memory.has_data)
         {
+            e->pipe_cycles.complete = core->simcpu->clock;
             cq_dequeue(&core->ex_to_mem_queue.cq);
             e->elasped_clock_cycles = 0;
             e->data_fwd_done = FALSE;
@@ -285,6 +287,12 @@ flush_speculated_cpu_state(INCore *core, InstructionLatch *e)
     int i;
     RISCVCPUState *s = core->simcpu->emu_cpu_state;
 
+    if (s->simcpu->params->do_pipe_trace)
+    {
+        sim_pipe_trace_mark_flush(s->simcpu->pipe_trace,
+                                  s->simcpu->insn_latch_pool);
+    }
+
     /* Send target PC to pcgen */
     s->code_ptr = NULL;
     s->code_end = NULL;
@@ -314,7 +322,7 @@ flush_speculated_cpu_state(INCore *core, InstructionLatch *e)
     memset((void *)core->fwd_latch, 0, sizeof(DataFWDLatch) * NUM_FWD_BUS);
 
     /* Flush memory controller queues on flush */
-    mem_controller_reset(s->simcpu->mem_hierarchy->mem_controller);
+    memory_hierarchy_flush(s->simcpu->mem_hierarchy);
 
     /* To start fetching */
     core->pcgen.has_data = TRUE;
@@ -322,6 +330,10 @@ flush_speculated_cpu_state(INCore *core, InstructionLatch *e)
     /* To start fetching target instruction from next cycle */
     core->simcpu->skip_fetch_cycle = TRUE;
 
+    /* Slots are lost to bad speculation until the correct path commits */
+    core->td_recovering = TRUE;
+    core->td_recover_id = core->ins_dispatch_id;
+
     /* Reset exception on speculated path */
     s->simcpu->exception->pending = FALSE;
 
@@ -334,6 +346,11 @@ flush_speculated_cpu_state(INCore *core, InstructionLatch *e)
             s->simcpu->insn_latch_pool[i].status = INSN_LATCH_FREE;
         }
     }
+
+    if (s->simcpu->params->do_pipe_trace)
+    {
+        sim_pipe_trace_squash(s->simcpu->pipe_trace, s->simcpu->insn_latch_pool);
+    }
 }
 
 void
@@ -358,13 +375,15 @@ in_core_memory(INCore *core)
              * latency for non-memory instructions */
             e->max_clock_cycles = 1;
 
-            if (e->ins.is_load || e->ins.is_store || e->ins.is_atomic)
+            if (e->ins.is_load || e->ins.is_store || e->ins.is_atomic
+                || e->ins.is_vector)
             {
                 mem_cpu_stage_exec(s, e);
             }
             else if (e->ins.is_branch)
             {
-                if (s->simcpu->bpu_execute_stage_handler(s, e))
+                e->mispredict = s->simcpu->bpu_execute_stage_handler(s, e);
+                if (e->mispredict)
                 {
                     flush_speculated_cpu_state(core, e);
                 }
@@ -379,32 +398,41 @@ in_core_memory(INCore *core)
              * page-table entries is complete at this point. Now request the
              * memory controller to start simulating the delay for any DRAM
              * requests generated by this cache lookup */
-            if (s->simcpu->mem_hierarchy->mem_controller
-                    ->backend_mem_access_queue.cur_size
+            if (s->simcpu->mem_hierarchy->backend_mem_access_queue.cur_size
                 && !e->cache_lookup_complete_signal_sent)
             {
                 mem_controller_cache_lookup_complete_signal(
                     s->simcpu->mem_hierarchy->mem_controller,
-                    &s->simcpu->mem_hierarchy->mem_controller
-                         ->backend_mem_access_queue);
+                    &s->simcpu->mem_hierarchy->backend_mem_access_queue);
                 e->cache_lookup_complete_signal_sent = TRUE;
             }
 
-            if ((e->ins.is_load || e->ins.is_store || e->ins.is_atomic))
+            if ((e->ins.is_load || e->ins.is_store || e->ins.is_atomic
+                 || e->ins.is_vector))
             {
                 /* Wait on memory controller callback for any pending memory
                  * accesses */
-                if (s->simcpu->mem_hierarchy->mem_controller
-                        ->backend_mem_access_queue.cur_size)
+                if (s->simcpu->mem_hierarchy->backend_mem_access_queue.cur_size)
                 {
                     ++s->simcpu->stats[s->priv].data_mem_delay;
                     return;
                 }
             }
 
+            /* Next batch of the elements of a vector load or store */
+            if (e->ins.is_vector
+                && vector_unit_resume(s->simcpu->vector_unit, s, e))
+            {
+                return;
+            }
+
             /* MMU exception */
             if (e->ins.exception)
             {
+                if (e->ins.fusion)
+                {
+                    commit_fused_head(s, e);
+                }
                 sim_exception_set(s->simcpu->exception, e);
                 cpu_stage_flush(&core->pcgen);
                 cpu_stage_flush(&core->fetch);
@@ -438,13 +466,17 @@ in_core_memory(INCore *core)
              * stage, else stall memory stage */
             if (!core->commit.has_data)
             {
-                s->simcpu->mem_hierarchy->mem_controller
-                    ->backend_mem_access_queue.cur_idx
+                s->simcpu->mem_hierarchy->backend_mem_access_queue.cur_idx
                     = 0;
                 core->memory.stage_exec_done = FALSE;
                 e->max_clock_cycles = 0;
                 e->elasped_clock_cycles = 0;
                 e->data_fwd_done = FALSE;
+                if (e->ins.is_load || e->ins.is_store || e->ins.is_atomic
+                    || e->ins.is_vector)
+                {
+                    e->pipe_cycles.memory = s->simcpu->clock;
+                }
                 core->commit = core->memory;
                 cpu_stage_flush(&core->memory);
             }
@@ -462,6 +494,156 @@ in_core_memory(INCore *core)
 =            Instruction Commit Stage            =
 ================================================*/
 
+static int
+fu_stage_busy(const CPUStage *fu, int stages)
+{
+    int i;
+
+    for (i = 0; i < stages; ++i)
+    {
+        if (fu[i].has_data)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* Top-down accounting of the single commit slot of this cycle. When nothing
+ * commits, the slot goes to the memory access in progress, to the functional
+ * units still executing, or else to the front-end */
+void
+in_core_topdown(INCore *core)
+{
+    const SimParams *p = core->simcpu->params;
+    InstructionLatch *e;
+    int category;
+
+    if (core->td_committed)
+    {
+        category = TD_RETIRING;
+    }
+    else if (core->td_recovering)
+    {
+        category = TD_BAD_SPECULATION;
+    }
+    else if (core->memory.has_data)
+    {
+        e = get_insn_latch(core->simcpu->insn_latch_pool,
+                           core->memory.insn_latch_index);
+        if ((e->ins.is_load || e->ins.is_store || e->ins.is_atomic
+             || e->ins.is_vector)
+            && core->memory.stage_exec_done)
+        {
+            category = TD_BACKEND_MEM_L1 + e->data_mem_level;
+        }
+        else
+        {
+            category = TD_BACKEND_CORE;
+        }
+    }
+    else if (fu_stage_busy(core->ialu, p->num_alu_stages)
+             || fu_stage_busy(core->imul, p->num_mul_stages)
+             || fu_stage_busy(core->idiv, p->num_div_stages)
+             || fu_stage_busy(core->fpu_fma, p->num_fpu_fma_stages)
+             || core->fpu_alu.has_data)
+    {
+        category = TD_BACKEND_CORE;
+    }
+    else
+    {
+        category = topdown_frontend_stall(core->simcpu, &core->fetch);
+    }
+
+    ++core->simcpu->stats[core->simcpu->emu_cpu_state->priv]
+          .td_slots[category];
+}
+
+/* Returns the latch of the functional unit stage holding the instruction with
+ * the given dispatch ID, NULL if none */
+static InstructionLatch *
+fu_stage_find(INCore *core, const CPUStage *fu, int stages, uint64_t id)
+{
+    int i;
+    InstructionLatch *e;
+
+    for (i = 0; i < stages; ++i)
+    {
+        if (fu[i].has_data)
+        {
+            e = get_insn_latch(core->simcpu->insn_latch_pool,
+                               fu[i].insn_latch_index);
+            if (e->ins_dispatch_id == id)
+            {
+                return e;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Charges the cycle to the oldest instruction in flight: the one in the
+ * commit or memory stage, else the oldest one issued to the functional units
+ * as given by the ex_to_mem_queue, else the one in the decode or fetch
+ * stage */
+static void
+profile_head_cycle(INCore *core)
+{
+    const SimParams *p = core->simcpu->params;
+    const CPUStage *stage = NULL;
+    InstructionLatch *e = NULL;
+    uint64_t id;
+
+    if (core->commit.has_data)
+    {
+        stage = &core->commit;
+    }
+    else if (core->memory.has_data)
+    {
+        stage = &core->memory;
+    }
+    else if (!cq_empty(&core->ex_to_mem_queue.cq))
+    {
+        id = core->ex_to_mem_queue.data[cq_front(&core->ex_to_mem_queue.cq)];
+        e = fu_stage_find(core, core->ialu, p->num_alu_stages, id);
+        if (!e)
+        {
+            e = fu_stage_find(core, core->imul, p->num_mul_stages, id);
+        }
+        if (!e)
+        {
+            e = fu_stage_find(core, core->idiv, p->num_div_stages, id);
+        }
+        if (!e)
+        {
+            e = fu_stage_find(core, core->fpu_fma, p->num_fpu_fma_stages, id);
+        }
+        if (!e)
+        {
+            e = fu_stage_find(core, &core->fpu_alu, 1, id);
+        }
+    }
+    else if (core->decode.has_data)
+    {
+        stage = &core->decode;
+    }
+    else if (core->fetch.has_data)
+    {
+        stage = &core->fetch;
+    }
+
+    if (stage)
+    {
+        e = get_insn_latch(core->simcpu->insn_latch_pool,
+                           stage->insn_latch_index);
+    }
+
+    if (e)
+    {
+        sim_profile_head_cycles(core->simcpu->profile, e->ins.pc, 1);
+    }
+}
+
 int
 in_core_commit(INCore *core)
 {
@@ -469,6 +651,14 @@ in_core_commit(INCore *core)
     RISCVCPUState *s;
 
     s = core->simcpu->emu_cpu_state;
+    core->td_committed = core->commit.has_data;
+
+    /* The cycle is charged to the oldest instruction in flight */
+    if (s->sim_params->do_profile)
+    {
+        profile_head_cycle(core);
+    }
+
     if (core->commit.has_data)
     {
         e = get_insn_latch(s->simcpu->insn_latch_pool,
@@ -501,16 +691,37 @@ in_core_commit(INCore *core)
 
         update_insn_commit_stats(s, e);
 
+        if (s->simcpu->lockstep)
+        {
+            lockstep_commit(s->simcpu->lockstep, e, s->priv);
+        }
+
         if (s->simcpu->params->do_sim_trace)
         {
             sim_trace_commit(s->simcpu->trace, s->simcpu->clock, s->priv, e);
         }
 
+        if (s->simcpu->params->do_pipe_trace)
+        {
+            sim_pipe_trace_commit(s->simcpu->pipe_trace, s->simcpu->clock, e);
+        }
+
+        if (s->sim_params->do_profile)
+        {
+            sim_profile_commit(s->simcpu->profile, e);
+        }
+
         if (s->sim_params->enable_stats_display)
         {
             write_stats_to_stats_display_shm(s->simcpu);
         }
 
+        /* The first instruction on the correct path ends the recovery */
+        if (core->td_recovering && (e->ins_dispatch_id >= core->td_recover_id))
+        {
+            core->td_recovering = FALSE;
+        }
+
         /* Commit success */
         e->status = INSN_LATCH_FREE;
         cpu_stage_flush(&core->commit);
@@ -524,8 +735,8 @@ in_core_commit(INCore *core)
             return -1;
         }
 
-        /* Check for timeout */
-        if ((--s->n_cycles) == 0)
+        /* Check for timeout, a fused pair counts as two instructions */
+        if (riscv_sim_cpu_commit(s->simcpu, e->ins.fusion ? 2 : 1))
         {
             e->ins.exception_cause = SIM_TEMU_TIMEOUT_EXCEPTION;
             sim_exception_set(s->simcpu->exception, e);
@@ -33,6 +33,7 @@
 #include "../../riscv_cpu_priv.h"
 #include "../bpu/bpu.h"
 #include "../utils/circular_queue.h"
+#include "fusion.h"
 #include "riscv_sim_cpu.h"
 
 /*===========================================
@@ -130,21 +131,18 @@ in_core_fetch(INCore *core)
              * page-table entries is complete at this point. Now request the
              * memory controller to start simulating the delay for any DRAM
              * requests generated by this cache lookup */
-            if (s->simcpu->mem_hierarchy->mem_controller
-                    ->frontend_mem_access_queue.cur_size
+            if (s->simcpu->mem_hierarchy->frontend_mem_access_queue.cur_size
                 && !e->cache_lookup_complete_signal_sent)
             {
                 mem_controller_cache_lookup_complete_signal(
                     s->simcpu->mem_hierarchy->mem_controller,
-                    &s->simcpu->mem_hierarchy->mem_controller
-                         ->frontend_mem_access_queue);
+                    &s->simcpu->mem_hierarchy->frontend_mem_access_queue);
                 e->cache_lookup_complete_signal_sent =  TRUE;
             }
 
             /* Wait on memory controller callback for any pending memory
              * accesses */
-            if (!s->simcpu->mem_hierarchy->mem_controller
-                     ->frontend_mem_access_queue.cur_size)
+            if (!s->simcpu->mem_hierarchy->frontend_mem_access_queue.cur_size)
             {
                 /* Stop fetching new instructions on a MMU exception */
                 if (e->ins.exception)
@@ -157,8 +155,8 @@ in_core_fetch(INCore *core)
                      * decode stage */
                     if (!core->decode.has_data)
                     {
-                        s->simcpu->mem_hierarchy->mem_controller
-                            ->frontend_mem_access_queue.cur_idx
+                        s->simcpu->mem_hierarchy->frontend_mem_access_queue
+                            .cur_idx
                             = 0;
 
                         core->fetch.stage_exec_done = FALSE;
@@ -552,6 +550,11 @@ in_core_decode(INCore *core)
                 break;
         }
 
+        /* The in-order core has no rename and dispatch stages, the
+         * instruction is dispatched as it is issued */
+        e->pipe_cycles.issue = s->simcpu->clock;
+        e->pipe_cycles.dispatch = e->pipe_cycles.issue;
+
         /* Add sequence number of this instruction to memory selection queue */
         ins_issue_index = cq_enqueue(&core->ex_to_mem_queue.cq);
 
@@ -574,4 +577,71 @@ exit_decode:
     }
 }
 
+/* Runs at the end of the cycle: fuses the instruction issued to the ALU in
+ * this cycle with the instruction fetched right after it, which has just
+ * entered decode */
+void
+in_core_fuse(INCore *core)
+{
+    InstructionLatch *head, *e;
+    RISCVCPUState *s;
+    int pattern;
+
+    s = core->simcpu->emu_cpu_state;
+    if (!core->ialu[0].has_data || core->ialu[0].stage_exec_done
+        || !core->decode.has_data || core->decode.stage_exec_done)
+    {
+        return;
+    }
+
+    head = get_insn_latch(s->simcpu->insn_latch_pool,
+                          core->ialu[0].insn_latch_index);
+    e = get_insn_latch(s->simcpu->insn_latch_pool,
+                       core->decode.insn_latch_index);
+    if (e->is_decoded || e->ins.exception)
+    {
+        return;
+    }
+
+    pattern = fusion_match(s->simcpu->params, &head->ins, &e->ins);
+    if (!pattern)
+    {
+        return;
+    }
+
+    decode_cpu_stage_exec(s, e);
+    if (s->simcpu->bpu_decode_stage_handler(s, e))
+    {
+        /* RAS has redirected the control flow, so flush */
+        cpu_stage_flush_free_insn_latch(&core->fetch,
+                                        s->simcpu->insn_latch_pool);
+        cpu_stage_flush_free_insn_latch(&core->pcgen,
+                                        s->simcpu->insn_latch_pool);
+        core->pcgen.has_data = TRUE;
+    }
+    e->is_decoded = TRUE;
+
+    /* The pair executes in the latch of the second instruction, which takes
+     * over the operands and the memory stage slot of the first one */
+    fusion_merge(&e->ins, &head->ins, pattern);
+    if (e->ins.has_src1)
+    {
+        e->ins.rs1_val = head->ins.rs1_val;
+    }
+    if (e->ins.has_src2)
+    {
+        e->ins.rs2_val = head->ins.rs2_val;
+    }
+    e->read_rs1 = TRUE;
+    e->read_rs2 = TRUE;
+    e->read_rs3 = TRUE;
+    e->keep_dest_busy = head->keep_dest_busy;
+    e->ins_dispatch_id = head->ins_dispatch_id;
+    e->pipe_cycles = head->pipe_cycles;
+
+    head->status = INSN_LATCH_FREE;
+    core->ialu[0].insn_latch_index = e->insn_latch_index;
+    cpu_stage_flush(&core->decode);
+}
+
 /*=====  End of Instruction Decode Stage  ======*/
\ No newline at end of file
@@ -0,0 +1,492 @@
+/**
+ * Lockstep timing of configuration variants
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../memory_hierarchy/analytical_dram.h"
+#include "../utils/sim_log.h"
+#include "../utils/sim_sweep.h"
+#include "lockstep.h"
+#include "riscv_sim_cpu.h"
+
+static void
+lockstep_shadow_init(LockstepShadow *v, const char *name, SimParams *p)
+{
+    v->name = name;
+    v->p = p;
+
+    sim_log_event_to_file(sim_log, "Setting up lockstep variant %s", name);
+    v->mem_hierarchy = memory_hierarchy_init(p, sim_log, NULL, NULL);
+    if (p->enable_bpu)
+    {
+        v->bpu = bpu_init(p, v->stats, NULL);
+    }
+
+    /* Fetch, decode and the ALU stages are flushed on a misprediction, as the
+     * in-order core resolves branches in the memory stage */
+    v->mispredict_penalty = 2 + p->num_alu_stages;
+}
+
+static void
+lockstep_shadow_free(LockstepShadow *v)
+{
+    memory_hierarchy_free(&v->mem_hierarchy);
+    if (NULL != v->bpu)
+    {
+        bpu_free(&v->bpu);
+    }
+}
+
+Lockstep *
+lockstep_init(const SimParams *p)
+{
+    int i;
+    char prefix[PATH_MAX];
+    Lockstep *l;
+    SimSweepVariant *variants;
+
+    l = (Lockstep *)calloc(1, sizeof(Lockstep));
+    assert(l);
+
+    variants = sim_sweep_load_variants(p->lockstep_file, &l->lockstep_cfg,
+                                       &l->num_variants);
+    l->variants
+        = (LockstepShadow *)calloc(l->num_variants, sizeof(LockstepShadow));
+    assert(l->variants);
+
+    lockstep_shadow_init(&l->reference, "reference", (SimParams *)p);
+    for (i = 0; i < l->num_variants; ++i)
+    {
+        snprintf(prefix, sizeof(prefix), "%s_lockstep_%s", p->sim_file_prefix,
+                 variants[i].name);
+        lockstep_shadow_init(
+            &l->variants[i], variants[i].name,
+            sim_sweep_variant_params(p->cfg_file, &variants[i], p, prefix));
+    }
+    free(variants);
+
+    sim_log_event_to_file(sim_log, "Lockstep simulation of %d variants from %s",
+                          l->num_variants, p->lockstep_file);
+    return l;
+}
+
+static void
+lockstep_shadow_start(LockstepShadow *v)
+{
+    int i;
+    MemoryHierarchy *m = v->mem_hierarchy;
+
+    sim_stats_reset(v->stats);
+    memset(v->insn_stall, 0, sizeof(v->insn_stall));
+    memset(v->data_stall, 0, sizeof(v->data_stall));
+    memset(v->branch_stall, 0, sizeof(v->branch_stall));
+
+    if ((NULL != v->bpu) && v->p->flush_bpu_on_simstart)
+    {
+        bpu_flush(v->bpu);
+    }
+
+    if (v->p->enable_l1_caches)
+    {
+        cache_reset_stats(m->icache);
+        cache_reset_stats(m->dcache);
+        for (i = 0; i < m->num_shared_cache_levels; ++i)
+        {
+            cache_reset_stats(m->shared_caches[i]);
+        }
+
+        if (v->p->flush_sim_mem_on_simstart)
+        {
+            cache_flush(m->icache);
+            cache_flush(m->dcache);
+            for (i = 0; i < m->num_shared_cache_levels; ++i)
+            {
+                cache_flush(m->shared_caches[i]);
+            }
+        }
+    }
+
+    memory_hierarchy_flush(m);
+    if (MEM_MODEL_ANALYTICAL == m->mem_controller->dram_model_type)
+    {
+        analytical_dram_reset(m->mem_controller->dram->analytical_dram);
+    }
+}
+
+void
+lockstep_start(Lockstep *l)
+{
+    int i;
+
+    lockstep_shadow_start(&l->reference);
+    for (i = 0; i < l->num_variants; ++i)
+    {
+        lockstep_shadow_start(&l->variants[i]);
+    }
+}
+
+/* Simulates the DRAM requests generated by the cache lookup of an access and
+ * returns the cycles spent until they complete */
+static int
+lockstep_drain(MemoryController *m, StageMemAccessQueue *q)
+{
+    int cycles = 0;
+
+    if (q->cur_size)
+    {
+        mem_controller_cache_lookup_complete_signal(m, q);
+        while (q->cur_size)
+        {
+            mem_controller_clock(m);
+            ++cycles;
+        }
+    }
+    mem_controller_reset_cpu_stage_queue(q);
+    return cycles;
+}
+
+static void
+lockstep_shadow_fetch(LockstepShadow *v, const InstructionLatch *e, int priv)
+{
+    int latency;
+    MemoryHierarchy *m = v->mem_hierarchy;
+
+    latency = m->insn_read_delay(m, e->insn_paddr, 4, FETCH, priv);
+    latency += lockstep_drain(m->mem_controller,
+                              &m->frontend_mem_access_queue);
+    v->insn_stall[priv] += latency - 1;
+}
+
+static void
+lockstep_shadow_memory(LockstepShadow *v, const InstructionLatch *e, int priv)
+{
+    int latency = 0;
+    MemoryHierarchy *m = v->mem_hierarchy;
+
+    if (e->ins.is_atomic_load && !e->ins.lr_yielded)
+    {
+        latency += m->data_own_delay(m, e->data_paddr, e->ins.bytes_to_rw,
+                                     MEMORY, priv);
+    }
+
+    if (e->ins.is_load || e->ins.is_atomic_load)
+    {
+        latency += m->data_read_delay(m, e->data_paddr, e->ins.bytes_to_rw,
+                                      MEMORY, priv);
+        if (e->ins.bytes_to_rw < 4)
+        {
+            latency += 1;
+        }
+    }
+
+    /* A failed SC takes a cycle, but does not write to memory */
+    if (e->ins.is_store || e->ins.is_atomic_store)
+    {
+        latency += 1;
+        if (!e->ins.sc_failed)
+        {
+            m->data_write_delay(m, e->data_paddr, e->ins.bytes_to_rw, MEMORY,
+                                priv);
+        }
+    }
+
+    latency += lockstep_drain(m->mem_controller,
+                              &m->backend_mem_access_queue);
+    if (latency > 1)
+    {
+        v->data_stall[priv] += latency - 1;
+    }
+}
+
+/* Replays the prediction of a committed branch the way the fetch, decode and
+ * execute stage handlers of the simulated core make it */
+static void
+lockstep_shadow_branch(LockstepShadow *v, const InstructionLatch *e, int priv)
+{
+    int taken, mispredict;
+    target_ulong predicted_target = 0;
+    target_ulong ras_target;
+    BPUResponsePkt pkt;
+    BranchPredUnit *u = v->bpu;
+
+    taken = (BRANCH_UNCOND == e->ins.branch_type) || e->ins.cond;
+    if (NULL == u)
+    {
+        if (taken)
+        {
+            v->branch_stall[priv] += v->mispredict_penalty;
+        }
+        return;
+    }
+
+    bpu_probe(u, e->ins.pc, &pkt, priv);
+    if (pkt.bpu_probe_status)
+    {
+        predicted_target = bpu_get_target(u, e->ins.pc, pkt.btb_entry);
+    }
+
+    if (v->p->ras_size)
+    {
+        if (e->ins.is_func_call)
+        {
+            ras_push(u->ras, ((e->ins.binary & 3) == 3 ? e->ins.pc + 4
+                                                       : e->ins.pc + 2));
+        }
+
+        if (e->ins.is_func_ret)
+        {
+            ras_target = ras_pop(u->ras);
+            if (ras_target)
+            {
+                predicted_target = ras_target;
+            }
+        }
+    }
+
+    if (!pkt.bpu_probe_status)
+    {
+        bpu_add(u, e->ins.pc, e->ins.branch_type, &pkt, priv,
+                e->ins.is_func_ret);
+    }
+
+    bpu_probe(u, e->ins.pc, &pkt, priv);
+    if (BRANCH_COND == e->ins.branch_type)
+    {
+        mispredict = (taken != (predicted_target != 0));
+        if (mispredict)
+        {
+            ++v->stats[priv].bpu_cond_incorrect;
+        }
+        else
+        {
+            ++v->stats[priv].bpu_cond_correct;
+        }
+        bpu_update(u, e->ins.pc, e->ins.target, taken, BRANCH_COND, &pkt,
+                   priv);
+    }
+    else
+    {
+        bpu_update(u, e->ins.pc, e->ins.target, TRUE, BRANCH_UNCOND, &pkt,
+                   priv);
+        mispredict = (predicted_target != e->ins.target);
+        if (mispredict)
+        {
+            ++v->stats[priv].bpu_uncond_incorrect;
+        }
+        else
+        {
+            ++v->stats[priv].bpu_uncond_correct;
+        }
+    }
+
+    if (mispredict)
+    {
+        v->branch_stall[priv] += v->mispredict_penalty;
+    }
+}
+
+static void
+lockstep_shadow_commit(LockstepShadow *v, const InstructionLatch *e, int priv)
+{
+    lockstep_shadow_fetch(v, e, priv);
+
+    if ((e->ins.is_load || e->ins.is_store || e->ins.is_atomic)
+        && e->data_paddr)
+    {
+        lockstep_shadow_memory(v, e, priv);
+    }
+
+    if (e->ins.is_branch)
+    {
+        lockstep_shadow_branch(v, e, priv);
+    }
+}
+
+void
+lockstep_commit(Lockstep *l, const InstructionLatch *e, int priv)
+{
+    int i;
+
+    lockstep_shadow_commit(&l->reference, e, priv);
+    for (i = 0; i < l->num_variants; ++i)
+    {
+        lockstep_shadow_commit(&l->variants[i], e, priv);
+    }
+}
+
+/* Adds the difference between the shadow stall cycles of a variant and of the
+ * reference to a count of the simulated core */
+static uint64_t
+lockstep_adjust(uint64_t value, uint64_t variant, uint64_t reference)
+{
+    int64_t adjusted = (int64_t)value + (int64_t)variant - (int64_t)reference;
+
+    return (adjusted > 0) ? (uint64_t)adjusted : 0;
+}
+
+/* Stats of a variant: the instruction stream is the one of the simulated core,
+ * while the cycles, the caches and the branch predictor are those of the
+ * variant */
+static void
+lockstep_shadow_stats(const Lockstep *l, LockstepShadow *v,
+                      const SimStats *stats, SimStats *out)
+{
+    int i, j;
+    const LockstepShadow *r = &l->reference;
+
+    copy_mem_hierarchy_stats(v->mem_hierarchy, v->stats);
+    memcpy(out, stats, NUM_MAX_PRV_LEVELS * sizeof(SimStats));
+
+    for (i = 0; i < NUM_MAX_PRV_LEVELS; ++i)
+    {
+        out[i].cycles = lockstep_adjust(
+            stats[i].cycles,
+            v->insn_stall[i] + v->data_stall[i] + v->branch_stall[i],
+            r->insn_stall[i] + r->data_stall[i] + r->branch_stall[i]);
+        out[i].insn_mem_delay = lockstep_adjust(
+            stats[i].insn_mem_delay, v->insn_stall[i], r->insn_stall[i]);
+        out[i].data_mem_delay = lockstep_adjust(
+            stats[i].data_mem_delay, v->data_stall[i], r->data_stall[i]);
+
+        out[i].btb_probes = v->stats[i].btb_probes;
+        out[i].btb_hits = v->stats[i].btb_hits;
+        out[i].btb_updates = v->stats[i].btb_updates;
+        out[i].btb_inserts = v->stats[i].btb_inserts;
+        out[i].bpu_cond_correct = v->stats[i].bpu_cond_correct;
+        out[i].bpu_cond_incorrect = v->stats[i].bpu_cond_incorrect;
+        out[i].bpu_uncond_correct = v->stats[i].bpu_uncond_correct;
+        out[i].bpu_uncond_incorrect = v->stats[i].bpu_uncond_incorrect;
+
+        out[i].icache_read = v->stats[i].icache_read;
+        out[i].icache_read_miss = v->stats[i].icache_read_miss;
+        out[i].dcache_read = v->stats[i].dcache_read;
+        out[i].dcache_write = v->stats[i].dcache_write;
+        out[i].dcache_read_miss = v->stats[i].dcache_read_miss;
+        out[i].dcache_write_miss = v->stats[i].dcache_write_miss;
+        out[i].victim_cache_read = v->stats[i].victim_cache_read;
+        out[i].victim_cache_read_miss = v->stats[i].victim_cache_read_miss;
+        out[i].victim_cache_fill = v->stats[i].victim_cache_fill;
+
+        for (j = 0; j < NUM_MAX_SHARED_CACHE_LEVELS; ++j)
+        {
+            out[i].shared_cache_read[j] = v->stats[i].shared_cache_read[j];
+            out[i].shared_cache_write[j] = v->stats[i].shared_cache_write[j];
+            out[i].shared_cache_read_miss[j]
+                = v->stats[i].shared_cache_read_miss[j];
+            out[i].shared_cache_write_miss[j]
+                = v->stats[i].shared_cache_write_miss[j];
+            out[i].shared_cache_back_invalidate[j]
+                = v->stats[i].shared_cache_back_invalidate[j];
+            out[i].shared_cache_victim_fill[j]
+                = v->stats[i].shared_cache_victim_fill[j];
+        }
+    }
+}
+
+/* Writes a stats file per variant, and merges the total column of the stats of
+ * the core and of every variant into a single CSV file */
+void
+lockstep_stop(Lockstep *l, const SimParams *p, const SimStats *stats,
+              uint64_t sim_time, const char *timestamp)
+{
+    int i, j;
+    uint64_t cycles, commits;
+    char name[PATH_MAX];
+    char file_name[PATH_MAX + 32];
+    char **files;
+    const char **labels;
+    SimStats out[NUM_MAX_PRV_LEVELS];
+
+    files = (char **)calloc(1 + l->num_variants, sizeof(char *));
+    labels = (const char **)calloc(1 + l->num_variants, sizeof(char *));
+    assert(files && labels);
+
+    snprintf(file_name, sizeof(file_name), "%s/%s.csv", p->sim_file_path,
+             timestamp);
+    files[0] = strdup(file_name);
+    labels[0] = "base";
+
+    sim_log_event(sim_log, "%s", "Lockstep variants:");
+    for (i = 0; i < l->num_variants; ++i)
+    {
+        lockstep_shadow_stats(l, &l->variants[i], stats, out);
+
+        snprintf(name, sizeof(name), "%slockstep_%s", timestamp,
+                 l->variants[i].name);
+        sim_stats_print_to_file(out, p->sim_file_path, sim_time, name);
+
+        snprintf(file_name, sizeof(file_name), "%s/%s.csv", p->sim_file_path,
+                 name);
+        files[1 + i] = strdup(file_name);
+        labels[1 + i] = l->variants[i].name;
+
+        cycles = 0;
+        commits = 0;
+        for (j = 0; j < NUM_MAX_PRV_LEVELS; ++j)
+        {
+            cycles += out[j].cycles;
+            commits += out[j].ins_simulated;
+        }
+        sim_log_param(sim_log, "%s-estimated-cycles: %lu",
+                      l->variants[i].name, cycles);
+        sim_log_param(sim_log, "%s-estimated-ipc: %.4lf", l->variants[i].name,
+                      cycles ? (double)commits / (double)cycles : 0.0);
+    }
+
+    snprintf(file_name, sizeof(file_name), "%s/%slockstep.csv",
+             p->sim_file_path, timestamp);
+    sim_sweep_merge_files(file_name, 1 + l->num_variants, labels,
+                          (const char *const *)files);
+    sim_log_event(sim_log, "Saved lockstep statistics in %s", file_name);
+
+    for (i = 0; i <= l->num_variants; ++i)
+    {
+        free(files[i]);
+    }
+    free(files);
+    free(labels);
+}
+
+void
+lockstep_free(Lockstep **l)
+{
+    int i;
+
+    for (i = 0; i < (*l)->num_variants; ++i)
+    {
+        lockstep_shadow_free(&(*l)->variants[i]);
+        sim_params_free((*l)->variants[i].p);
+    }
+    lockstep_shadow_free(&(*l)->reference);
+
+    json_free((*l)->lockstep_cfg);
+    free((*l)->variants);
+    free(*l);
+    *l = NULL;
+}
@@ -0,0 +1,86 @@
+/**
+ * Lockstep timing of configuration variants
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _LOCKSTEP_H_
+#define _LOCKSTEP_H_
+
+#include "../../json.h"
+#include "../bpu/bpu.h"
+#include "../memory_hierarchy/memory_hierarchy.h"
+#include "../riscv_sim_typedefs.h"
+#include "../utils/cpu_latches.h"
+#include "../utils/sim_params.h"
+#include "../utils/sim_stats.h"
+
+/* Memory hierarchy and branch predictor of a configuration timed in lockstep
+ * with the simulated core */
+typedef struct LockstepShadow
+{
+    const char *name;
+    SimParams *p;
+    MemoryHierarchy *mem_hierarchy;
+    BranchPredUnit *bpu;
+    SimStats stats[NUM_MAX_PRV_LEVELS];
+
+    /* Cycles the in-order pipeline would stall for this configuration */
+    uint64_t insn_stall[NUM_MAX_PRV_LEVELS];
+    uint64_t data_stall[NUM_MAX_PRV_LEVELS];
+    uint64_t branch_stall[NUM_MAX_PRV_LEVELS];
+    int mispredict_penalty;
+} LockstepShadow;
+
+/* Lockstep simulation times variants of the memory hierarchy and the branch
+ * predictor against the instruction stream committed by the in-order core, so
+ * that a single run gives the stats of every variant. The variants are read
+ * from a file in the sweep file format, only their memory hierarchy and
+ * branch predictor parameters are used.
+ *
+ * Every committed instruction replays its fetch, its data access and, for
+ * branches, its prediction in every variant. The DRAM requests of an access
+ * are drained on the memory controller of the variant before the next access,
+ * as the in-order pipeline stalls on them. The shadow stall cycles of a
+ * variant are the cycles above one spent by the fetch and the data accesses,
+ * and the misprediction penalty. Page table walks are not replayed.
+ *
+ * A reference shadow built from the parameters of the simulated core calibrates
+ * the model: the cycles of a variant are estimated as the cycles of the core
+ * plus the difference between the shadow stall cycles of the variant and of
+ * the reference. */
+typedef struct Lockstep
+{
+    JSONValue lockstep_cfg;
+    int num_variants;
+    LockstepShadow reference;
+    LockstepShadow *variants;
+} Lockstep;
+
+Lockstep *lockstep_init(const SimParams *p);
+void lockstep_start(Lockstep *l);
+void lockstep_commit(Lockstep *l, const InstructionLatch *e, int priv);
+void lockstep_stop(Lockstep *l, const SimParams *p, const SimStats *stats,
+                   uint64_t sim_time, const char *timestamp);
+void lockstep_free(Lockstep **l);
+#endif
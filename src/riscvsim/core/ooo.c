@@ -51,6 +51,16 @@ oo_core_log_config(const OOCore *core)
                   core->simcpu->params->iq_issue_ports);
     sim_log_param_to_file(sim_log, "%s: %d", "lsq_size",
                   core->simcpu->params->lsq_size);
+    if (core->smt)
+    {
+        sim_log_param_to_file(sim_log, "%s: %d of %d", "smt_thread",
+                              core->smt_thread, core->smt->num_threads);
+        sim_log_param_to_file(
+            sim_log, "%s: %s", "smt_resource_policy",
+            smt_resource_policy_str[core->smt->resource_policy]);
+        sim_log_param_to_file(sim_log, "%s: %s", "smt_fetch_policy",
+                              smt_fetch_policy_str[core->smt->fetch_policy]);
+    }
     sim_log_param_to_file(sim_log, "%s: %d", "int_rename_table_size", NUM_INT_REG);
     sim_log_param_to_file(sim_log, "%s: %d", "fp_rename_table_size", NUM_FP_REG);
 }
@@ -96,6 +106,10 @@ oo_core_init(const SimParams *p, struct RISCVSIMCPUState *simcpu)
     assert(core->fpu_fma);
 
     core->simcpu = simcpu;
+    if (p->smt_threads > 1)
+    {
+        oo_smt_attach(core, p);
+    }
     oo_core_log_config(core);
     return core;
 }
@@ -110,6 +124,14 @@ oo_core_reset(void *core_type)
 
     core->ins_dispatch_id = 0;
 
+    /* Dispatch IDs start over, so drop the top-down state tied to them. Slots
+     * of a branch flushed before resolving are counted as back-end bound */
+    core->simcpu->stats[core->simcpu->emu_cpu_state->priv]
+        .td_slots[TD_BACKEND_CORE]
+        += core->td_branch_slots;
+    core->td_branch_slots = 0;
+    core->td_recovering = FALSE;
+
     /* Reset front-end stages */
     cpu_stage_flush(&core->fetch);
     cpu_stage_flush(&core->decode);
@@ -219,41 +241,101 @@ oo_core_free(void *core_type)
     core->idiv = NULL;
     free(core->fpu_fma);
     core->fpu_fma = NULL;
+    if (core->smt)
+    {
+        oo_smt_detach(core);
+    }
     free(core);
 }
 
+/* Runs a cycle of the core, except for the memory controller clocked by the
+ * caller. Returns non-zero if the instruction committed last raised an
+ * exception. */
+int
+oo_core_cycle(OOCore *core)
+{
+    SimHostProfile *hp;
+    uint64_t host_time;
+
+    hp = core->simcpu->host_profile;
+    host_time = host_profile_start(hp);
+
+    if (oo_core_rob_commit(core))
+    {
+        return 1;
+    }
+    host_time = host_profile_mark(hp, HOST_PROFILE_COMMIT, host_time);
+
+    oo_core_lsq(core);
+    oo_core_lsu(core);
+
+    /* Call lsq again to mark ROB entries as complete for memory
+     * instructions which completed in a single cycle */
+    oo_core_lsq(core);
+    host_time = host_profile_mark(hp, HOST_PROFILE_MEMORY, host_time);
+
+    oo_core_execute_all(core);
+    host_time = host_profile_mark(hp, HOST_PROFILE_EXECUTE, host_time);
+    oo_core_issue(core);
+    host_time = host_profile_mark(hp, HOST_PROFILE_ISSUE, host_time);
+    oo_core_dispatch(core);
+    host_time = host_profile_mark(hp, HOST_PROFILE_DISPATCH, host_time);
+    oo_core_decode(core);
+    host_time = host_profile_mark(hp, HOST_PROFILE_DECODE, host_time);
+    oo_core_fetch(core);
+    host_time = host_profile_mark(hp, HOST_PROFILE_FETCH, host_time);
+    if (core->simcpu->params->enable_fusion)
+    {
+        oo_core_fuse(core);
+        host_profile_mark(hp, HOST_PROFILE_FUSION, host_time);
+    }
+
+    /* Advance CPU clock */
+    ++core->simcpu->clock;
+    ++core->simcpu->stats[core->simcpu->emu_cpu_state->priv].cycles;
+
+    if (NULL != core->simcpu->registry)
+    {
+        riscv_sim_cpu_sample_stats(core->simcpu);
+    }
+    return 0;
+}
+
+/* Advances the pipeline by a cycle, returns TRUE once it left simulation on
+ * an exception */
+int
+oo_core_step(void *core_type)
+{
+    OOCore *core = (OOCore *)core_type;
+
+    if (core->smt)
+    {
+        return oo_smt_step(core);
+    }
+    return (oo_core_cycle(core) != 0);
+}
+
 int
 oo_core_run(void *core_type)
 {
     OOCore *core;
+    SimHostProfile *hp;
+    uint64_t host_time;
 
     core = (OOCore *)core_type;
     while (1)
     {
+        hp = core->simcpu->host_profile;
+        host_time = host_profile_start(hp);
+
         /* Advance DRAM clock */
         mem_controller_clock(core->simcpu->mem_hierarchy->mem_controller);
+        host_profile_mark(hp, HOST_PROFILE_DRAM, host_time);
 
-        if (oo_core_rob_commit(core))
+        if (oo_core_cycle(core))
         {
             return core->simcpu->emu_cpu_state->simcpu->exception->cause;
         }
-
-        oo_core_lsq(core);
-        oo_core_lsu(core);
-
-        /* Call lsq again to mark ROB entries as complete for memory
-         * instructions which completed in a single cycle */
-        oo_core_lsq(core);
-
-        oo_core_execute_all(core);
-        oo_core_issue(core);
-        oo_core_dispatch(core);
-        oo_core_decode(core);
-        oo_core_fetch(core);
-
-        /* Advance CPU clock */
-        ++core->simcpu->clock;
-        ++core->simcpu->stats[core->simcpu->emu_cpu_state->priv].cycles;
     }
 }
 
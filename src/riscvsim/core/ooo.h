@@ -73,6 +73,30 @@ typedef struct RenameTableEntry
     int rob_idx;
 } RenameTableEntry;
 
+/* Hardware threads of a simultaneous multithreading (SMT) core. Every thread
+ * is a hart with an OOCore of its own, holding its PC, rename tables, RAS,
+ * ROB, IQ, LSQ and load-store unit. The threads arbitrate here for the fetch
+ * slot, the ROB, IQ and LSQ capacity, the issue ports and the functional
+ * units, and share the L1 caches and the BTB and direction predictor.
+ *
+ * The threads are stepped in hart order by the cycle loop of the machine, like
+ * the other harts, and enter and leave the pipeline independently. */
+typedef struct OOSmtCore
+{
+    int num_threads;
+    int num_attached;
+    int resource_policy;
+    int fetch_policy;
+    struct OOCore *threads[NUM_MAX_SMT_THREADS];
+
+    uint64_t cycle_stamp;  /* machine_clock + 1 of the cycle begun last */
+    uint32_t active_mask;  /* Threads in the pipeline */
+    uint32_t ran_mask;     /* Threads which ran in the current cycle */
+    int fetch_thread;      /* Thread allowed to start a fetch this cycle */
+    int priority_thread;   /* Thread with the issue priority this cycle */
+    int issue_ports_used;  /* Issue ports used by all threads this cycle */
+} OOSmtCore;
+
 typedef struct OOCore
 {
     /*----------  Front-end stages  ----------*/
@@ -104,6 +128,18 @@ typedef struct OOCore
     /* Dispatch ID for instruction */
     uint64_t ins_dispatch_id; /* Support for speculative execution */
 
+    /*----------  Top-down accounting  ----------*/
+    int td_recovering;        /* Refilling the pipeline after a mispredict */
+    uint64_t td_recover_id;   /* First dispatch ID on the correct path */
+    uint64_t td_branch_id;    /* Unresolved branch at the head of the ROB */
+    uint64_t td_branch_slots; /* Empty slots waiting for it to resolve */
+
+    /*----------  Simultaneous multithreading  ----------*/
+    OOSmtCore *smt; /* NULL if the core runs a single thread */
+    int smt_thread;
+    int issue_demand;   /* Ready IQ entries seen by the last issue */
+    uint32_t fu_demand; /* Bitmask of their FU types */
+
     struct RISCVSIMCPUState *simcpu; /* Pointer to parent */
 } OOCore;
 
@@ -111,7 +147,9 @@ typedef struct OOCore
 OOCore *oo_core_init(const SimParams *p, struct RISCVSIMCPUState *simcpu);
 void oo_core_reset(void *core_type);
 void oo_core_free(void *core_type);
+int oo_core_step(void *core_type);
 int oo_core_run(void *core_type);
+int oo_core_cycle(OOCore *core);
 
 /*----------  Out of order stages  ----------*/
 int oo_core_rob_commit(OOCore *core);
@@ -121,6 +159,7 @@ void oo_core_execute_all(OOCore *core);
 void oo_core_issue(OOCore *core);
 void oo_core_dispatch(OOCore *core);
 void oo_core_decode(OOCore *core);
+void oo_core_fuse(OOCore *core);
 void oo_core_fetch(OOCore *core);
 
 /*----------  Out of order core utility functions  ----------*/
@@ -136,4 +175,15 @@ void read_fp_operand_from_rob_slot(const OOCore *core, int asrc, int psrc,
                                    int current_rob_idx, uint64_t *buffer,
                                    int *read_flag);
 int rob_entry_committed(const ROB *rob, int src_idx, int current_idx);
+
+/*----------  Simultaneous multithreading  ----------*/
+void oo_smt_attach(OOCore *core, const SimParams *p);
+void oo_smt_detach(OOCore *core);
+int oo_smt_step(OOCore *core);
+int oo_smt_fetch_allowed(const OOCore *core);
+int oo_smt_rob_full(const OOCore *core);
+int oo_smt_dispatch_stall(const OOCore *core, const InstructionLatch *e);
+int oo_smt_issue_ports(const OOCore *core);
+int oo_smt_fu_busy(const OOCore *core, int fu_type);
+void oo_smt_end_issue(OOCore *core, int issued, int demand, uint32_t fu_demand);
 #endif
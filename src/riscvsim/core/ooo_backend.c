@@ -74,7 +74,7 @@ issue_ins_to_exec_unit(OOCore *core, InstructionLatch *e)
         }
     }
 
-    if (!fu->has_data)
+    if (!fu->has_data && !(core->smt && oo_smt_fu_busy(core, e->ins.fu_type)))
     {
         fu->has_data = TRUE;
         fu->stage_exec_done = FALSE;
@@ -113,6 +113,8 @@ issue_instruction(OOCore *core, IssueQueueEntry *iqe, InstructionLatch *e)
 {
     if (!issue_ins_to_exec_unit(core, e))
     {
+        e->pipe_cycles.issue = core->simcpu->clock;
+
         /* Instruction issued, deallocate IQ entry */
         iqe->valid = FALSE;
         iqe->ready = FALSE;
@@ -132,17 +134,38 @@ process_iq(OOCore *core, IssueQueueEntry *iq, int iq_size, int max_issue_ports)
     InstructionLatch *e;
     IssueQueueEntry *iqe;
     int current_issue_count = 0;
+    int demand = 0;
+    uint32_t fu_demand = 0;
 
-    for (i = 0; (i < iq_size) && (current_issue_count < max_issue_ports); ++i)
+    for (i = 0; i < iq_size; ++i)
     {
         iqe = &iq[i];
         e = iqe->e;
 
+        if (current_issue_count >= max_issue_ports)
+        {
+            if (NULL == core->smt)
+            {
+                break;
+            }
+
+            /* On an SMT core, keep counting the ready entries, the demand
+             * is reserved when this thread has the issue priority */
+            if (iqe->valid && iqe->ready)
+            {
+                ++demand;
+                fu_demand |= (1u << e->ins.fu_type);
+            }
+            continue;
+        }
+
         if (iqe->valid == TRUE)
         {
             /* Entry is ready to issue */
             if (iqe->ready)
             {
+                ++demand;
+                fu_demand |= (1u << e->ins.fu_type);
                 if (issue_instruction(core, iqe, e))
                 {
                     current_issue_count++;
@@ -177,6 +200,8 @@ process_iq(OOCore *core, IssueQueueEntry *iq, int iq_size, int max_issue_ports)
             /* Try to issue instruction again after reading the sources */
             if (iqe->ready)
             {
+                ++demand;
+                fu_demand |= (1u << e->ins.fu_type);
                 if (issue_instruction(core, iqe, e))
                 {
                     current_issue_count++;
@@ -185,13 +210,24 @@ process_iq(OOCore *core, IssueQueueEntry *iq, int iq_size, int max_issue_ports)
             }
         }
     }
+
+    if (core->smt)
+    {
+        oo_smt_end_issue(core, current_issue_count, demand, fu_demand);
+    }
 }
 
 void
 oo_core_issue(OOCore *core)
 {
-    process_iq(core, core->iq, core->simcpu->params->iq_size,
-               core->simcpu->params->iq_issue_ports);
+    int max_issue_ports = core->simcpu->params->iq_issue_ports;
+
+    if (core->smt)
+    {
+        max_issue_ports = oo_smt_issue_ports(core);
+    }
+
+    process_iq(core, core->iq, core->simcpu->params->iq_size, max_issue_ports);
 }
 
 /*=====  End of Instruction Issue Stage  ======*/
@@ -264,7 +300,8 @@ oo_core_execute_non_pipe(OOCore *core, int fu_type, CPUStage *stage)
          * instruction to the next stage, else stall */
         if (e->elasped_clock_cycles == e->max_clock_cycles)
         {
-            if (e->ins.is_load || e->ins.is_store || e->ins.is_atomic)
+            if (e->ins.is_load || e->ins.is_store || e->ins.is_atomic
+                || e->ins.is_vector)
             {
                 /* Inform the LSQ entry that address is calculated */
                 core->lsq.entries[e->lsq_idx].ready = TRUE;
@@ -286,6 +323,7 @@ oo_core_execute_non_pipe(OOCore *core, int fu_type, CPUStage *stage)
             }
 
             /* Execution complete */
+            e->pipe_cycles.complete = core->simcpu->clock;
             e->max_clock_cycles = 0;
             e->elasped_clock_cycles = 0;
             cpu_stage_flush(stage);
@@ -328,7 +366,8 @@ oo_core_execute_pipe(OOCore *core, int cur_stage_id, int fu_type, CPUStage *stag
             /* Instruction is in last stage of FU*/
             if (cur_stage_id == max_stage_id)
             {
-                if (e->ins.is_load || e->ins.is_store || e->ins.is_atomic)
+                if (e->ins.is_load || e->ins.is_store || e->ins.is_atomic
+                    || e->ins.is_vector)
                 {
                     /* Inform the LSQ entry that address is calculated */
                     core->lsq.entries[e->lsq_idx].ready = TRUE;
@@ -350,6 +389,7 @@ oo_core_execute_pipe(OOCore *core, int cur_stage_id, int fu_type, CPUStage *stag
                 }
 
                 /* Execution complete */
+                e->pipe_cycles.complete = core->simcpu->clock;
                 e->max_clock_cycles = 0;
                 e->elasped_clock_cycles = 0;
                 cpu_stage_flush(stage);
@@ -422,6 +462,72 @@ rob_can_commit(const ROB *rob)
     return FALSE;
 }
 
+/* Top-down accounting of the commit slots of this cycle: the committed ones
+ * are retiring, the others are attributed to what stalls the head of the ROB,
+ * or to the front-end if the ROB is empty */
+static void
+oo_core_topdown(OOCore *core, int commits)
+{
+    InstructionLatch *e;
+    InstructionLatch *lsu_e;
+    int slots, category;
+    SimStats *stats;
+
+    stats = &core->simcpu->stats[core->simcpu->emu_cpu_state->priv];
+    slots = core->simcpu->params->rob_commit_ports - commits;
+    stats->td_slots[TD_RETIRING] += commits;
+    if (!slots)
+    {
+        return;
+    }
+
+    if (cq_empty(&core->rob.cq))
+    {
+        if (core->td_recovering)
+        {
+            category = TD_BAD_SPECULATION;
+        }
+        else
+        {
+            category = topdown_frontend_stall(core->simcpu, &core->fetch);
+        }
+        stats->td_slots[category] += slots;
+        return;
+    }
+
+    e = core->rob.entries[cq_front(&core->rob.cq)].e;
+    if (core->td_recovering && (e->ins_dispatch_id >= core->td_recover_id))
+    {
+        /* The correct path is still filling the pipeline */
+        category = TD_BAD_SPECULATION;
+    }
+    else if (e->ins.is_branch && !e->branch_processed)
+    {
+        /* Attributed when the branch resolves */
+        if (core->td_branch_slots && (core->td_branch_id != e->ins_dispatch_id))
+        {
+            stats->td_slots[TD_BACKEND_CORE] += core->td_branch_slots;
+            core->td_branch_slots = 0;
+        }
+        core->td_branch_id = e->ins_dispatch_id;
+        core->td_branch_slots += slots;
+        return;
+    }
+    else if ((e->ins.is_load || e->ins.is_store || e->ins.is_atomic
+              || e->ins.is_vector)
+             && core->lsu.has_data && core->lsu.stage_exec_done)
+    {
+        lsu_e = get_insn_latch(core->simcpu->insn_latch_pool,
+                               core->lsu.insn_latch_index);
+        category = TD_BACKEND_MEM_L1 + lsu_e->data_mem_level;
+    }
+    else
+    {
+        category = TD_BACKEND_CORE;
+    }
+    stats->td_slots[category] += slots;
+}
+
 int
 oo_core_rob_commit(OOCore *core)
 {
@@ -431,6 +537,15 @@ oo_core_rob_commit(OOCore *core)
     int commits = 0;
 
     s = core->simcpu->emu_cpu_state;
+
+    /* The cycle is charged to the instruction blocking the commit */
+    if (s->sim_params->do_profile && !cq_empty(&core->rob.cq))
+    {
+        sim_profile_head_cycles(
+            s->simcpu->profile,
+            core->rob.entries[cq_front(&core->rob.cq)].e->ins.pc, 1);
+    }
+
     while (rob_can_commit(&core->rob))
     {
         rbe = &core->rob.entries[cq_front(&core->rob.cq)];
@@ -442,6 +557,10 @@ oo_core_rob_commit(OOCore *core)
 
         if (e->ins.exception)
         {
+            if (e->ins.fusion)
+            {
+                commit_fused_head(s, e);
+            }
             sim_exception_set(s->simcpu->exception, e);
             return -1;
         }
@@ -480,11 +599,29 @@ oo_core_rob_commit(OOCore *core)
                                                s->simcpu->clock, s->priv, e);
             }
 
+            if (s->simcpu->params->do_pipe_trace)
+            {
+                sim_pipe_trace_commit(s->simcpu->pipe_trace, s->simcpu->clock,
+                                      e);
+            }
+
+            if (s->sim_params->do_profile)
+            {
+                sim_profile_commit(s->simcpu->profile, e);
+            }
+
             if (s->sim_params->enable_stats_display)
             {
                 write_stats_to_stats_display_shm(s->simcpu);
             }
 
+            /* The first instruction on the correct path ends the recovery */
+            if (core->td_recovering
+                && (e->ins_dispatch_id >= core->td_recover_id))
+            {
+                core->td_recovering = FALSE;
+            }
+
             /* Free up insn_latch_pool entry */
             e->status = INSN_LATCH_FREE;
 
@@ -504,8 +641,8 @@ oo_core_rob_commit(OOCore *core)
                 return -1;
             }
 
-            /* Check for timeout */
-            if ((--s->n_cycles) == 0)
+            /* Check for timeout, a fused pair counts as two instructions */
+            if (riscv_sim_cpu_commit(core->simcpu, e->ins.fusion ? 2 : 1))
             {
                 e->ins.exception_cause = SIM_TEMU_TIMEOUT_EXCEPTION;
                 sim_exception_set(s->simcpu->exception, e);
@@ -520,6 +657,7 @@ oo_core_rob_commit(OOCore *core)
         }
     }
 
+    oo_core_topdown(core, commits);
     return 0;
 }
 /*=====  End of ROB Commit Stage  ======*/
@@ -45,11 +45,11 @@ restore_cpu_frontend(OOCore *core, const InstructionLatch *e)
     /* Invalidate the entries added to mem_request_queue on the speculated path */
     mem_controller_invalidate_mem_request_queue_entries(
         s->simcpu->mem_hierarchy->mem_controller,
-        &s->simcpu->mem_hierarchy->mem_controller->frontend_mem_access_queue);
+        &s->simcpu->mem_hierarchy->frontend_mem_access_queue);
 
     /* Flush the memory transactions added by fetch stage */
     mem_controller_reset_cpu_stage_queue(
-        &s->simcpu->mem_hierarchy->mem_controller->frontend_mem_access_queue);
+        &s->simcpu->mem_hierarchy->frontend_mem_access_queue);
 
     /* Set the new target address into fetch and enable fetch unit to start
      * fetching from the target */
@@ -206,7 +206,7 @@ restore_lsu(OOCore *core, uint64_t tag)
                                             core->simcpu->insn_latch_pool);
 
             /* Flush memory controller queues on flush */
-            mem_controller_reset(core->simcpu->mem_hierarchy->mem_controller);
+            memory_hierarchy_flush(core->simcpu->mem_hierarchy);
         }
     }
 }
@@ -340,6 +340,12 @@ reallocate_active_insn_latch_pool_entries(OOCore *core)
 static void
 rollback_speculated_cpu_state(OOCore *core, InstructionLatch *e)
 {
+    if (core->simcpu->params->do_pipe_trace)
+    {
+        sim_pipe_trace_mark_flush(core->simcpu->pipe_trace,
+                                  core->simcpu->insn_latch_pool);
+    }
+
     restore_cpu_frontend(core, e);
     restore_rob(core, e, e->ins_dispatch_id);
     restore_iq(core->iq, core->simcpu->params->iq_size, e->ins_dispatch_id);
@@ -359,6 +365,12 @@ rollback_speculated_cpu_state(OOCore *core, InstructionLatch *e)
     fix_rename_tables(core, core->fp_rat, NUM_FP_REG);
     reset_insn_latch_pool(core->simcpu->insn_latch_pool);
     reallocate_active_insn_latch_pool_entries(core);
+
+    if (core->simcpu->params->do_pipe_trace)
+    {
+        sim_pipe_trace_squash(core->simcpu->pipe_trace,
+                              core->simcpu->insn_latch_pool);
+    }
 }
 
 void
@@ -370,6 +382,20 @@ oo_process_branch(OOCore *core, InstructionLatch *e)
     if (e->mispredict)
     {
         rollback_speculated_cpu_state(core, e);
+
+        /* Slots are lost to bad speculation until the correct path commits */
+        core->td_recovering = TRUE;
+        core->td_recover_id = core->ins_dispatch_id;
+    }
+
+    /* Commit slots lost while this branch waited at the head of the ROB were
+     * spent on the wrong path if it was mispredicted */
+    if (core->td_branch_slots && (core->td_branch_id == e->ins_dispatch_id))
+    {
+        core->simcpu->stats[core->simcpu->emu_cpu_state->priv]
+            .td_slots[e->mispredict ? TD_BAD_SPECULATION : TD_BACKEND_CORE]
+            += core->td_branch_slots;
+        core->td_branch_slots = 0;
     }
 
     switch (e->ins.branch_type)
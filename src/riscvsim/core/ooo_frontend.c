@@ -27,6 +27,7 @@
 #include "ooo.h"
 #include "../../riscv_cpu_priv.h"
 #include "../utils/circular_queue.h"
+#include "fusion.h"
 #include "riscv_sim_cpu.h"
 
 /*===============================================
@@ -53,6 +54,12 @@ oo_core_fetch(OOCore *core)
                 return;
             }
 
+            /* On an SMT core, wait for the fetch slot of this thread */
+            if (core->smt && !oo_smt_fetch_allowed(core))
+            {
+                return;
+            }
+
             /* Calculate current PC*/
             s->simcpu->pc
                 = (target_ulong)((uintptr_t)s->code_ptr + s->code_to_pc_addend);
@@ -82,28 +89,24 @@ oo_core_fetch(OOCore *core)
              * page-table entries is complete at this point. Now request the
              * memory controller to start simulating the delay for any DRAM
              * requests generated by this cache lookup */
-            if (s->simcpu->mem_hierarchy->mem_controller
-                    ->frontend_mem_access_queue.cur_size
+            if (s->simcpu->mem_hierarchy->frontend_mem_access_queue.cur_size
                 && !e->cache_lookup_complete_signal_sent)
             {
                 mem_controller_cache_lookup_complete_signal(
                     s->simcpu->mem_hierarchy->mem_controller,
-                    &s->simcpu->mem_hierarchy->mem_controller
-                         ->frontend_mem_access_queue);
+                    &s->simcpu->mem_hierarchy->frontend_mem_access_queue);
                 e->cache_lookup_complete_signal_sent = TRUE;
             }
 
             /* Wait on memory controller callback for any pending memory
              * accesses */
-            if (!s->simcpu->mem_hierarchy->mem_controller
-                     ->frontend_mem_access_queue.cur_size)
+            if (!s->simcpu->mem_hierarchy->frontend_mem_access_queue.cur_size)
             {
                 /* If the next stage is available, send this instruction to next
                    stage, else stall fetch */
                 if (!core->decode.has_data)
                 {
-                    s->simcpu->mem_hierarchy->mem_controller->frontend_mem_access_queue
-                        .cur_idx
+                    s->simcpu->mem_hierarchy->frontend_mem_access_queue.cur_idx
                         = 0;
 
                     core->fetch.stage_exec_done = FALSE;
@@ -179,6 +182,53 @@ oo_core_decode(OOCore *core)
     }
 }
 
+/* Runs at the end of the cycle: fuses the instruction waiting for dispatch
+ * with the instruction fetched right after it, which has just entered
+ * decode */
+void
+oo_core_fuse(OOCore *core)
+{
+    InstructionLatch *head, *e;
+    RISCVCPUState *s;
+    int pattern;
+
+    s = core->simcpu->emu_cpu_state;
+    if (!core->dispatch.has_data || !core->decode.has_data
+        || core->decode.stage_exec_done)
+    {
+        return;
+    }
+
+    head = get_insn_latch(s->simcpu->insn_latch_pool,
+                          core->dispatch.insn_latch_index);
+    e = get_insn_latch(s->simcpu->insn_latch_pool, core->decode.insn_latch_index);
+    if (e->is_decoded || e->ins.exception)
+    {
+        return;
+    }
+
+    pattern = fusion_match(s->simcpu->params, &head->ins, &e->ins);
+    if (!pattern)
+    {
+        return;
+    }
+
+    decode_cpu_stage_exec(s, e);
+    if (s->simcpu->bpu_decode_stage_handler(s, e))
+    {
+        cpu_stage_flush_free_insn_latch(&core->fetch, s->simcpu->insn_latch_pool);
+        core->fetch.has_data = TRUE;
+    }
+    e->is_decoded = TRUE;
+
+    /* The pair is dispatched from the latch of the second instruction */
+    fusion_merge(&e->ins, &head->ins, pattern);
+    e->pipe_cycles = head->pipe_cycles;
+    head->status = INSN_LATCH_FREE;
+    core->dispatch.insn_latch_index = e->insn_latch_index;
+    cpu_stage_flush(&core->decode);
+}
+
 /*=====  End of Instruction Decode Stage  ======*/
 
 /*==================================================
@@ -261,12 +311,19 @@ stall_insn_dispatch(const OOCore *core, const InstructionLatch *e)
     }
 
     if (cq_full(&core->rob.cq) || iq_full(core->iq, core->simcpu->params->iq_size)
-        || ((e->ins.is_load || e->ins.is_store || e->ins.is_atomic)
+        || ((e->ins.is_load || e->ins.is_store || e->ins.is_atomic
+             || e->ins.is_vector)
             && cq_full(&core->lsq.cq)))
     {
         return TRUE;
     }
 
+    /* On an SMT core, ROB, IQ and LSQ capacity is shared by the threads */
+    if (core->smt && oo_smt_dispatch_stall(core, e))
+    {
+        return TRUE;
+    }
+
     /* Ready to dispatch */
     return FALSE;
 }
@@ -389,7 +446,8 @@ oo_core_dispatch(OOCore *core)
              * entry for this instruction and let ROB handle this exception */
             if (e->ins.exception)
             {
-                if (cq_full(&core->rob.cq))
+                if (cq_full(&core->rob.cq)
+                    || (core->smt && oo_smt_rob_full(core)))
                 {
                     /* Stall */
                     return;
@@ -408,13 +466,15 @@ oo_core_dispatch(OOCore *core)
                 do_insn_rename_and_read_reg_file(core, e);
                 rob_entry_create(&core->rob, e, FALSE);
                 iq_entry_create(core->iq, s->simcpu->params->iq_size, e);
-                if (e->ins.is_load || e->ins.is_store || e->ins.is_atomic)
+                if (e->ins.is_load || e->ins.is_store || e->ins.is_atomic
+                    || e->ins.is_vector)
                 {
                     lsq_entry_create(&core->lsq, e);
                 }
                 update_rd_rat_mapping(core, e);
             }
             e->ins_dispatch_id = core->ins_dispatch_id++;
+            e->pipe_cycles.dispatch = core->simcpu->clock;
             cpu_stage_flush(&core->dispatch);
         }
     }
@@ -54,26 +54,30 @@ oo_core_lsu(OOCore *core)
              * page-table entries is complete at this point. Now request the
              * memory controller to start simulating the delay for any DRAM
              * requests generated by this cache lookup */
-            if (s->simcpu->mem_hierarchy->mem_controller
-                    ->backend_mem_access_queue.cur_size
+            if (s->simcpu->mem_hierarchy->backend_mem_access_queue.cur_size
                 && !e->cache_lookup_complete_signal_sent)
             {
                 mem_controller_cache_lookup_complete_signal(
                     s->simcpu->mem_hierarchy->mem_controller,
-                    &s->simcpu->mem_hierarchy->mem_controller
-                         ->backend_mem_access_queue);
+                    &s->simcpu->mem_hierarchy->backend_mem_access_queue);
                 e->cache_lookup_complete_signal_sent = TRUE;
             }
 
             /* Number of CPU cycles spent by this instruction in memory stage
              * equals memory access delay for this instruction */
-            if (!s->simcpu->mem_hierarchy->mem_controller
-                     ->backend_mem_access_queue.cur_size)
+            if (!s->simcpu->mem_hierarchy->backend_mem_access_queue.cur_size)
             {
-                s->simcpu->mem_hierarchy->mem_controller
-                    ->backend_mem_access_queue.cur_idx
+                /* Next batch of the elements of a vector load or store */
+                if (e->ins.is_vector
+                    && vector_unit_resume(s->simcpu->vector_unit, s, e))
+                {
+                    return;
+                }
+
+                s->simcpu->mem_hierarchy->backend_mem_access_queue.cur_idx
                     = 0;
                 core->lsq.entries[e->lsq_idx].mem_request_complete = TRUE;
+                e->pipe_cycles.memory = s->simcpu->clock;
                 cpu_stage_flush(&core->lsu);
             }
             else
@@ -197,8 +201,10 @@ oo_core_lsq(OOCore *core)
             {
                 process_lsq_entry_load(core, lsqe);
             }
-            else if (e->ins.is_store)
+            else if (e->ins.is_store || e->ins.is_vector)
             {
+                /* Vector instructions are executed at the ROB head, as the
+                 * stores */
                 process_lsq_entry_store(core, lsqe);
             }
         }
@@ -0,0 +1,396 @@
+/**
+ * Simultaneous multithreading for the out of order core
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../riscv_cpu_priv.h"
+#include "../utils/circular_queue.h"
+#include "ooo.h"
+#include "riscv_sim_cpu.h"
+
+/* Threads which have not run yet in the current cycle do not see the
+ * instructions issued by the other threads until they run, so the threads are
+ * checked in hart order */
+static int
+thread_ran(const OOSmtCore *smt, int thread)
+{
+    return (smt->ran_mask >> thread) & 1;
+}
+
+static int
+thread_active(const OOSmtCore *smt, int thread)
+{
+    return (smt->active_mask >> thread) & 1;
+}
+
+static int
+iq_count(const IssueQueueEntry *iq, int size)
+{
+    int i;
+    int count = 0;
+
+    for (i = 0; i < size; ++i)
+    {
+        count += iq[i].valid;
+    }
+    return count;
+}
+
+/* Instructions fetched but not issued yet, used by the ICOUNT policy */
+static int
+thread_icount(const OOCore *core)
+{
+    return core->fetch.has_data + core->decode.has_data
+           + core->dispatch.has_data
+           + iq_count(core->iq, core->simcpu->params->iq_size);
+}
+
+/* Threads still fetching an instruction or stopped on an exception cannot use
+ * the fetch slot */
+static int
+fetch_ready(const OOCore *core)
+{
+    return core->fetch.has_data && !core->fetch.stage_exec_done;
+}
+
+static int
+select_fetch_thread(const OOSmtCore *smt)
+{
+    int i, t, count;
+    int best = -1;
+    int best_count = 0;
+
+    /* Both policies scan starting after the last fetching thread, so that
+     * ties are broken round-robin */
+    for (i = 1; i <= smt->num_threads; ++i)
+    {
+        t = (smt->fetch_thread + i) % smt->num_threads;
+        if (!thread_active(smt, t) || !fetch_ready(smt->threads[t]))
+        {
+            continue;
+        }
+
+        if (smt->fetch_policy == SMT_FETCH_ROUND_ROBIN)
+        {
+            return t;
+        }
+
+        count = thread_icount(smt->threads[t]);
+        if ((best == -1) || (count < best_count))
+        {
+            best = t;
+            best_count = count;
+        }
+    }
+
+    return (best == -1) ? smt->fetch_thread : best;
+}
+
+static int
+next_active_thread(const OOSmtCore *smt, int thread)
+{
+    int i, t;
+
+    for (i = 1; i <= smt->num_threads; ++i)
+    {
+        t = (thread + i) % smt->num_threads;
+        if (thread_active(smt, t))
+        {
+            return t;
+        }
+    }
+    return thread;
+}
+
+/* The priority thread keeps the issue ports and the functional units it asked
+ * for in the previous cycle away from the threads running before it in the
+ * current cycle. Without this, the thread running first would take the shared
+ * units every cycle. */
+static int
+priority_reserved(const OOCore *core)
+{
+    const OOSmtCore *smt = core->smt;
+
+    return (smt->priority_thread != core->smt_thread)
+           && thread_active(smt, smt->priority_thread)
+           && !thread_ran(smt, smt->priority_thread);
+}
+
+/* Consecutive harts form a core, the first one allocates the shared state */
+void
+oo_smt_attach(OOCore *core, const SimParams *p)
+{
+    OOSmtCore *smt;
+    RISCVSIMCPUState *boot_hart = core->simcpu->boot_hart;
+    int core_id = core->simcpu->core_id;
+
+    core->smt_thread = core_id % p->smt_threads;
+    if (core->smt_thread == 0)
+    {
+        smt = (OOSmtCore *)calloc(1, sizeof(OOSmtCore));
+        assert(smt);
+        smt->num_threads = p->smt_threads;
+        smt->resource_policy = p->smt_resource_policy;
+        smt->fetch_policy = p->smt_fetch_policy;
+    }
+    else
+    {
+        smt = ((OOCore *)boot_hart->harts[core_id - core->smt_thread]->core)
+                  ->smt;
+    }
+
+    smt->threads[core->smt_thread] = core;
+    ++smt->num_attached;
+    core->smt = smt;
+}
+
+void
+oo_smt_detach(OOCore *core)
+{
+    OOSmtCore *smt = core->smt;
+
+    smt->threads[core->smt_thread] = NULL;
+    if (--smt->num_attached == 0)
+    {
+        free(smt);
+    }
+    core->smt = NULL;
+}
+
+static void
+thread_enter(OOCore *core)
+{
+    core->smt->active_mask |= (1u << core->smt_thread);
+    core->issue_demand = 0;
+    core->fu_demand = 0;
+}
+
+static void
+thread_leave(OOCore *core)
+{
+    core->smt->active_mask &= ~(1u << core->smt_thread);
+    core->smt->ran_mask &= ~(1u << core->smt_thread);
+}
+
+static void
+begin_cycle(OOSmtCore *smt)
+{
+    smt->ran_mask = 0;
+    smt->issue_ports_used = 0;
+    smt->fetch_thread = select_fetch_thread(smt);
+    smt->priority_thread = next_active_thread(smt, smt->priority_thread);
+}
+
+/* Steps a thread by a cycle. The cycle loop of the machine steps the threads
+ * of the core in hart order, the first thread stepped in a cycle begins it for
+ * the core. Returns TRUE once the thread left the pipeline. */
+int
+oo_smt_step(OOCore *core)
+{
+    OOSmtCore *smt = core->smt;
+    uint64_t stamp = core->simcpu->boot_hart->machine_clock + 1;
+
+    if (smt->cycle_stamp != stamp)
+    {
+        smt->cycle_stamp = stamp;
+        begin_cycle(smt);
+    }
+
+    if (!thread_active(smt, core->smt_thread))
+    {
+        thread_enter(core);
+    }
+
+    smt->ran_mask |= (1u << core->smt_thread);
+    if (oo_core_cycle(core))
+    {
+        thread_leave(core);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/* A single thread starts a fetch every cycle */
+int
+oo_smt_fetch_allowed(const OOCore *core)
+{
+    return core->smt->fetch_thread == core->smt_thread;
+}
+
+/* Checks the occupancy of a structure allocated at dispatch. With the shared
+ * policy, a thread can take any entry left by the active threads, with the
+ * partitioned policy every thread gets size / num_threads entries. */
+static int
+structure_full(const OOCore *core, int size,
+               int (*count)(const OOCore *core))
+{
+    int t;
+    int used = 0;
+    const OOSmtCore *smt = core->smt;
+
+    if (smt->resource_policy == SMT_RESOURCES_PARTITIONED)
+    {
+        return count(core) >= (size / smt->num_threads);
+    }
+
+    for (t = 0; t < smt->num_threads; ++t)
+    {
+        if (thread_active(smt, t) || (t == core->smt_thread))
+        {
+            used += count(smt->threads[t]);
+        }
+    }
+    return used >= size;
+}
+
+static int
+rob_count(const OOCore *core)
+{
+    return cq_count(&core->rob.cq);
+}
+
+static int
+lsq_count(const OOCore *core)
+{
+    return cq_count(&core->lsq.cq);
+}
+
+static int
+thread_iq_count(const OOCore *core)
+{
+    return iq_count(core->iq, core->simcpu->params->iq_size);
+}
+
+int
+oo_smt_rob_full(const OOCore *core)
+{
+    return structure_full(core, core->simcpu->params->rob_size, &rob_count);
+}
+
+int
+oo_smt_dispatch_stall(const OOCore *core, const InstructionLatch *e)
+{
+    const SimParams *p = core->simcpu->params;
+
+    return oo_smt_rob_full(core)
+           || structure_full(core, p->iq_size, &thread_iq_count)
+           || ((e->ins.is_load || e->ins.is_store || e->ins.is_atomic
+                || e->ins.is_vector)
+               && structure_full(core, p->lsq_size, &lsq_count));
+}
+
+/* Issue ports left for the thread in the current cycle */
+int
+oo_smt_issue_ports(const OOCore *core)
+{
+    int ports;
+    int reserved = 0;
+    const OOSmtCore *smt = core->smt;
+
+    ports = core->simcpu->params->iq_issue_ports;
+    if (smt->resource_policy == SMT_RESOURCES_PARTITIONED)
+    {
+        return (ports / smt->num_threads) ? (ports / smt->num_threads) : 1;
+    }
+
+    if (priority_reserved(core))
+    {
+        reserved = smt->threads[smt->priority_thread]->issue_demand;
+    }
+
+    ports -= smt->issue_ports_used + reserved;
+    return (ports > 0) ? ports : 0;
+}
+
+static const CPUStage *
+fu_first_stage(const OOCore *core, int fu_type)
+{
+    switch (fu_type)
+    {
+        case FU_ALU:
+        {
+            return &core->ialu[0];
+        }
+        case FU_MUL:
+        {
+            return &core->imul[0];
+        }
+        case FU_DIV:
+        {
+            return &core->idiv[0];
+        }
+        case FU_FPU_ALU:
+        {
+            return &core->fpu_alu;
+        }
+        case FU_FPU_FMA:
+        {
+            return &core->fpu_fma[0];
+        }
+    }
+    return NULL;
+}
+
+/* Functional units are shared by the threads. The first stage of a unit is
+ * busy if another thread issued to it in the current cycle, or if it still
+ * holds an instruction which started executing in an earlier cycle. */
+int
+oo_smt_fu_busy(const OOCore *core, int fu_type)
+{
+    int t;
+    const CPUStage *stage;
+    const OOSmtCore *smt = core->smt;
+
+    if (priority_reserved(core)
+        && ((smt->threads[smt->priority_thread]->fu_demand >> fu_type) & 1))
+    {
+        return TRUE;
+    }
+
+    for (t = 0; t < smt->num_threads; ++t)
+    {
+        if ((t == core->smt_thread) || !thread_active(smt, t))
+        {
+            continue;
+        }
+
+        stage = fu_first_stage(smt->threads[t], fu_type);
+        if (stage->has_data && (thread_ran(smt, t) || stage->stage_exec_done))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+void
+oo_smt_end_issue(OOCore *core, int issued, int demand, uint32_t fu_demand)
+{
+    core->smt->issue_ports_used += issued;
+    core->issue_demand = demand;
+    core->fu_demand = fu_demand;
+}
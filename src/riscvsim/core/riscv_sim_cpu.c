@@ -44,6 +44,7 @@
 #include "../../rtc_timer.h"
 
 #define WRITE_STATS_TO_SHM_CLOCK_CYCLES_INTERVAL 500000
+#define LR_SC_HOLD_CYCLES 128
 #define GET_TIME(time) clock_gettime(CLOCK_MONOTONIC, &time)
 #define GET_TIMER_DIFF(start, end)                                             \
     (1000000000L * (end.tv_sec - start.tv_sec) + end.tv_nsec - start.tv_nsec)
@@ -112,12 +113,10 @@ bpu_enabled_decode_stage_handler(struct RISCVCPUState *s, InstructionLatch *e)
                 /* Invalidate the entries added to mem_request_queue on the speculated path */
                 mem_controller_invalidate_mem_request_queue_entries(
                     s->simcpu->mem_hierarchy->mem_controller,
-                    &s->simcpu->mem_hierarchy->mem_controller
-                         ->frontend_mem_access_queue);
+                    &s->simcpu->mem_hierarchy->frontend_mem_access_queue);
 
                 mem_controller_reset_cpu_stage_queue(
-                    &s->simcpu->mem_hierarchy->mem_controller
-                         ->frontend_mem_access_queue);
+                    &s->simcpu->mem_hierarchy->frontend_mem_access_queue);
 
                 /* Start fetching the target from next cycle */
                 s->simcpu->skip_fetch_cycle = TRUE;
@@ -296,39 +295,309 @@ bpu_disabled_execute_stage_handler(struct RISCVCPUState *s, InstructionLatch *e)
     return mispredict;
 }
 
-static void
-copy_cache_stats_to_global_stats(RISCVSIMCPUState *simcpu)
+/* Copies the stats of the caches and of the coherence directory of the memory
+ * hierarchy into stats */
+void
+copy_mem_hierarchy_stats(const MemoryHierarchy *m, SimStats *stats)
 {
-    int i;
+    int i, j;
     const CacheStats *cache_stats;
+    const CoherenceStats *coh_stats;
 
     /* Update cache stats */
-    if (simcpu->params->enable_l1_caches)
+    if (m->p->enable_l1_caches)
     {
         for (i = 0; i < NUM_MAX_PRV_LEVELS; ++i)
         {
-            cache_stats = cache_get_stats(simcpu->mem_hierarchy->icache);
-            simcpu->stats[i].icache_read = cache_stats[i].total_read_cnt;
-            simcpu->stats[i].icache_read_miss = cache_stats[i].read_miss_cnt;
+            cache_stats = cache_get_stats(m->icache);
+            stats[i].icache_read = cache_stats[i].total_read_cnt;
+            stats[i].icache_read_miss = cache_stats[i].read_miss_cnt;
+
+            cache_stats = cache_get_stats(m->dcache);
+            stats[i].dcache_read = cache_stats[i].total_read_cnt;
+            stats[i].dcache_read_miss = cache_stats[i].read_miss_cnt;
+            stats[i].dcache_write = cache_stats[i].total_write_cnt;
+            stats[i].dcache_write_miss = cache_stats[i].write_miss_cnt;
+
+            if (m->dcache->victim_cache)
+            {
+                cache_stats = cache_get_stats(m->dcache->victim_cache);
+                stats[i].victim_cache_read = cache_stats[i].total_read_cnt;
+                stats[i].victim_cache_read_miss = cache_stats[i].read_miss_cnt;
+                stats[i].victim_cache_fill = cache_stats[i].victim_fill_cnt;
+            }
 
-            cache_stats = cache_get_stats(simcpu->mem_hierarchy->dcache);
-            simcpu->stats[i].dcache_read = cache_stats[i].total_read_cnt;
-            simcpu->stats[i].dcache_read_miss = cache_stats[i].read_miss_cnt;
-            simcpu->stats[i].dcache_write = cache_stats[i].total_write_cnt;
-            simcpu->stats[i].dcache_write_miss = cache_stats[i].write_miss_cnt;
+            if (m->directory)
+            {
+                coh_stats
+                    = coherence_get_stats(m->directory, m->coherence_agent);
+                stats[i].coherence_invalidations = coh_stats[i].invalidations;
+                stats[i].coherence_downgrades = coh_stats[i].downgrades;
+                stats[i].coherence_c2c_transfers
+                    = coh_stats[i].c2c_transfers;
+                stats[i].coherence_upgrade_misses
+                    = coh_stats[i].upgrade_misses;
+            }
 
-            if (simcpu->params->enable_l2_cache)
+            for (j = 0; j < m->num_shared_cache_levels; ++j)
             {
-                cache_stats = cache_get_stats(simcpu->mem_hierarchy->l2_cache);
-                simcpu->stats[i].l2_cache_read = cache_stats[i].total_read_cnt;
-                simcpu->stats[i].l2_cache_read_miss
+                cache_stats = cache_get_stats(m->shared_caches[j]);
+                stats[i].shared_cache_read[j]
+                    = cache_stats[i].total_read_cnt;
+                stats[i].shared_cache_read_miss[j]
                     = cache_stats[i].read_miss_cnt;
-                simcpu->stats[i].l2_cache_write
+                stats[i].shared_cache_write[j]
                     = cache_stats[i].total_write_cnt;
-                simcpu->stats[i].l2_cache_write_miss
+                stats[i].shared_cache_write_miss[j]
                     = cache_stats[i].write_miss_cnt;
+                stats[i].shared_cache_back_invalidate[j]
+                    = cache_stats[i].back_invalidate_cnt;
+                stats[i].shared_cache_victim_fill[j]
+                    = cache_stats[i].victim_fill_cnt;
+            }
+        }
+    }
+}
+
+static const char *roi_context_str[NUM_ROI_CONTEXTS] = {"roi", "other"};
+
+/* Returns the ROI_CONTEXT_* of the address space selected by satp */
+static int
+roi_get_context(const RISCVSIMCPUState *simcpu)
+{
+    const RISCVCPUState *s = simcpu->emu_cpu_state;
+    uint64_t asid;
+
+    if (simcpu->params->roi_filter == ROI_FILTER_ASID)
+    {
+        asid = (s->cur_xlen == 32) ? ((s->satp >> 22) & 0x1ff)
+                                   : (((uint64_t)s->satp >> 44) & 0xffff);
+        return (asid == simcpu->params->roi_asid) ? ROI_CONTEXT_IN
+                                                  : ROI_CONTEXT_OTHER;
+    }
+    return (s->satp == simcpu->roi_satp) ? ROI_CONTEXT_IN : ROI_CONTEXT_OTHER;
+}
+
+static void
+roi_set_context(RISCVSIMCPUState *simcpu, SimStats *stats, int context)
+{
+    simcpu->roi_context = context;
+    simcpu->stats = stats;
+    if (simcpu->params->enable_bpu)
+    {
+        simcpu->bpu->stats = stats;
+    }
+}
+
+/* The memory hierarchy keeps its stats for the whole simulation run, so the
+ * ones since the last context switch are added to the current context */
+static void
+roi_update_mem_stats(RISCVSIMCPUState *simcpu)
+{
+    SimStats mem_stats[NUM_MAX_PRV_LEVELS];
+
+    memset((void *)mem_stats, 0, sizeof(mem_stats));
+    copy_mem_hierarchy_stats(simcpu->mem_hierarchy, mem_stats);
+    sim_stats_add(simcpu->stats, mem_stats, simcpu->roi_mem_stats);
+    memcpy(simcpu->roi_mem_stats, mem_stats, sizeof(mem_stats));
+}
+
+static void
+roi_start(RISCVSIMCPUState *simcpu, target_ulong satp)
+{
+    int context;
+
+    sim_stats_reset(&simcpu->roi_stats[ROI_CONTEXT_IN * NUM_MAX_PRV_LEVELS]);
+    sim_stats_reset(
+        &simcpu->roi_stats[ROI_CONTEXT_OTHER * NUM_MAX_PRV_LEVELS]);
+    memset((void *)simcpu->roi_mem_stats, 0, sizeof(simcpu->roi_mem_stats));
+    copy_mem_hierarchy_stats(simcpu->mem_hierarchy, simcpu->roi_mem_stats);
+
+    simcpu->roi_satp = satp;
+    context = roi_get_context(simcpu);
+    roi_set_context(simcpu, &simcpu->roi_stats[context * NUM_MAX_PRV_LEVELS],
+                    context);
+}
+
+/* The stats of the contexts add up to the stats of the run */
+static void
+roi_sum_stats(RISCVSIMCPUState *simcpu)
+{
+    int i;
+
+    sim_stats_reset(simcpu->all_stats);
+    for (i = 0; i < NUM_ROI_CONTEXTS; ++i)
+    {
+        sim_stats_add(simcpu->all_stats,
+                      &simcpu->roi_stats[i * NUM_MAX_PRV_LEVELS], NULL);
+    }
+}
+
+static void
+roi_stop(RISCVSIMCPUState *simcpu)
+{
+    roi_update_mem_stats(simcpu);
+    roi_set_context(simcpu, simcpu->all_stats, simcpu->roi_context);
+    roi_sum_stats(simcpu);
+}
+
+/* Called on every write to satp in simulation mode */
+void
+riscv_sim_cpu_roi_switch(RISCVSIMCPUState *simcpu)
+{
+    int context;
+
+    if (simcpu->roi_stats)
+    {
+        context = roi_get_context(simcpu);
+        if (context != simcpu->roi_context)
+        {
+            roi_update_mem_stats(simcpu);
+            roi_set_context(simcpu,
+                            &simcpu->roi_stats[context * NUM_MAX_PRV_LEVELS],
+                            context);
+        }
+    }
+}
+
+/* Registers the stats of every module of a hart. The modules shared by the
+ * harts are registered by their owner. */
+static void
+register_hart_stats(RISCVSIMCPUState *simcpu, SimRegistry *r)
+{
+    int i;
+    char module[REGISTRY_NAME_LEN];
+    const MemoryHierarchy *m = simcpu->mem_hierarchy;
+
+    snprintf(module, sizeof(module), "hart%d.core", simcpu->core_id);
+    sim_stats_register(simcpu->all_stats, r, module);
+    sim_registry_add_latency_histogram(r, module, "load_to_use_latency",
+                                       simcpu->load_to_use_hist);
+    sim_registry_add_latency_histogram(r, module, "dispatch_to_commit_latency",
+                                       simcpu->dispatch_to_commit_hist);
+    sim_registry_add_latency_histogram(r, module, "page_walk_latency",
+                                       simcpu->page_walk_hist);
+    for (i = 0; simcpu->roi_stats && i < NUM_ROI_CONTEXTS; ++i)
+    {
+        snprintf(module, sizeof(module), "hart%d.%s", simcpu->core_id,
+                 roi_context_str[i]);
+        sim_stats_register(&simcpu->roi_stats[i * NUM_MAX_PRV_LEVELS], r,
+                           module);
+    }
+
+    if (simcpu->params->enable_l1_caches)
+    {
+        if (m->owns_l1_caches)
+        {
+            snprintf(module, sizeof(module), "hart%d.l1i", simcpu->core_id);
+            cache_register_stats(m->icache, r, module);
+            snprintf(module, sizeof(module), "hart%d.l1d", simcpu->core_id);
+            cache_register_stats(m->dcache, r, module);
+            if (m->dcache->victim_cache)
+            {
+                snprintf(module, sizeof(module), "hart%d.l1d_victim",
+                         simcpu->core_id);
+                cache_register_stats(m->dcache->victim_cache, r, module);
             }
         }
+
+        if (m->directory)
+        {
+            snprintf(module, sizeof(module), "hart%d.coherence",
+                     simcpu->core_id);
+            coherence_register_stats(m->directory, m->coherence_agent, r,
+                                     module);
+        }
+
+        for (i = 0; m->owns_shared_levels && i < m->num_shared_cache_levels;
+             ++i)
+        {
+            snprintf(module, sizeof(module), "l%d", i + 2);
+            cache_register_stats(m->shared_caches[i], r, module);
+        }
+    }
+
+    /* Harts running on host threads have a memory controller each */
+    if (m->owns_mem_controller)
+    {
+        if (simcpu->core_id)
+        {
+            snprintf(module, sizeof(module), "hart%d.dram", simcpu->core_id);
+        }
+        else
+        {
+            snprintf(module, sizeof(module), "dram");
+        }
+        dram_register_stats(m->mem_controller->dram, r, module);
+    }
+}
+
+static void
+stats_export_start(RISCVSIMCPUState *boot_hart)
+{
+    int i;
+    char *timestamp;
+
+    /* Registered once all the harts and their memory hierarchy exist */
+    if (NULL == boot_hart->registry)
+    {
+        boot_hart->registry = sim_registry_init();
+        for (i = 0; i < boot_hart->num_harts; ++i)
+        {
+            register_hart_stats(boot_hart->harts[i], boot_hart->registry);
+        }
+    }
+
+    timestamp
+        = sim_log_get_current_timestamp(boot_hart->params->sim_file_prefix);
+    sim_registry_open(boot_hart->registry, boot_hart->params->sim_file_path,
+                      timestamp);
+    free(timestamp);
+
+    boot_hart->next_stats_sample = boot_hart->params->stats_export_interval
+                                       ? boot_hart->params->stats_export_interval
+                                       : UINT64_MAX;
+}
+
+static void
+stats_export_sample(RISCVSIMCPUState *boot_hart, int final)
+{
+    int i;
+    uint64_t commits = 0;
+
+    for (i = 0; i < boot_hart->num_harts; ++i)
+    {
+        /* Updated on stop otherwise */
+        if (boot_hart->harts[i]->roi_stats && !final)
+        {
+            roi_sum_stats(boot_hart->harts[i]);
+        }
+        commits += boot_hart->harts[i]->icount;
+    }
+    sim_registry_sample(boot_hart->registry, boot_hart->clock, commits, final);
+}
+
+/* Called by the boot hart every cycle when the stats export is enabled */
+void
+riscv_sim_cpu_sample_stats(RISCVSIMCPUState *simcpu)
+{
+    if (simcpu->clock >= simcpu->next_stats_sample)
+    {
+        stats_export_sample(simcpu, FALSE);
+        simcpu->next_stats_sample += simcpu->params->stats_export_interval;
+    }
+}
+
+static void
+copy_cache_stats_to_global_stats(RISCVSIMCPUState *simcpu)
+{
+    if (simcpu->roi_stats)
+    {
+        roi_update_mem_stats(simcpu);
+    }
+    else
+    {
+        copy_mem_hierarchy_stats(simcpu->mem_hierarchy, simcpu->stats);
     }
 }
 
@@ -374,10 +643,17 @@ setup_stats_shm(RISCVSIMCPUState *simcpu)
     sim_log_param_to_file(sim_log, "%s: %s", "posix shared memory name", simcpu->params->sim_stats_shm_name);
 }
 
+static const char *topdown_category_str[NUM_TD_CATEGORIES]
+    = {"retiring",       "bad-speculation", "frontend-icache",
+       "frontend-itlb",  "frontend-bubble", "backend-core",
+       "backend-mem-l1", "backend-mem-l2",  "backend-mem-dram"};
+
 static void
 print_performance_summary(RISCVSIMCPUState *simcpu, uint64_t sim_time)
 {
-    int i;
+    int i, j;
+    uint64_t fused, insns, cycles;
+    double slots_per_insn;
 
     sim_log_event(sim_log, "%s", "Performance Summary:");
 
@@ -392,13 +668,64 @@ print_performance_summary(RISCVSIMCPUState *simcpu, uint64_t sim_time)
                           / (double)simcpu->stats[i].cycles);
     }
 
+    /* CPI stack: the commit slots of each top-down category, converted to
+     * cycles per committed instruction */
+    for (i = 0; i < NUM_MAX_PRV_LEVELS; ++i)
+    {
+        if (!simcpu->stats[i].ins_simulated)
+        {
+            continue;
+        }
+
+        slots_per_insn = (double)topdown_slots_per_cycle(simcpu->params)
+                         * (double)simcpu->stats[i].ins_simulated;
+        for (j = 0; j < NUM_TD_CATEGORIES; ++j)
+        {
+            sim_log_param(sim_log, "%s-mode-cpi-%s: %.4lf", cpu_mode_str[i],
+                          topdown_category_str[j],
+                          (double)simcpu->stats[i].td_slots[j]
+                              / slots_per_insn);
+        }
+    }
+
+    /* Fusion rate: fused pairs per committed instruction */
+    for (i = FUSION_NONE + 1; simcpu->params->enable_fusion
+                              && i < NUM_FUSION_PATTERNS;
+         ++i)
+    {
+        fused = 0;
+        for (j = 0; j < NUM_MAX_PRV_LEVELS; ++j)
+        {
+            fused += simcpu->stats[j].fused_pairs[i];
+        }
+        sim_log_param(sim_log, "fused-%s: %lu (%.2lf%%)", fusion_pattern_str[i],
+                      fused,
+                      100.0 * (double)fused
+                          / (double)(simcpu->icount ? simcpu->icount : 1));
+    }
+
+    for (i = 0; simcpu->roi_stats && i < NUM_ROI_CONTEXTS; ++i)
+    {
+        insns = 0;
+        cycles = 0;
+        for (j = 0; j < NUM_MAX_PRV_LEVELS; ++j)
+        {
+            insns += simcpu->roi_stats[i * NUM_MAX_PRV_LEVELS + j].ins_simulated;
+            cycles += simcpu->roi_stats[i * NUM_MAX_PRV_LEVELS + j].cycles;
+        }
+        sim_log_param(sim_log, "%s-commits: %lu", roi_context_str[i], insns);
+        sim_log_param(sim_log, "%s-cycles: %lu", roi_context_str[i], cycles);
+        sim_log_param(sim_log, "%s-ipc: %.4lf", roi_context_str[i],
+                      (double)insns / (double)(cycles ? cycles : 1));
+    }
+
     sim_log_param(sim_log, "total-commits: %lu", simcpu->icount);
     sim_log_param(sim_log, "total-cycles: %lu", simcpu->clock);
     sim_log_param(sim_log, "total-ipc: %.4lf",
                   (double)simcpu->icount / (double)simcpu->clock);
     sim_log_param(sim_log, "simulation-time: %lu milliseconds", sim_time);
     sim_log_param(sim_log, "total-commits-per-millisecond: %lu",
-                  simcpu->icount / sim_time);
+                  simcpu->icount / (sim_time ? sim_time : 1));
 }
 
 void
@@ -437,6 +764,19 @@ update_insn_commit_stats(RISCVCPUState *s, InstructionLatch *e)
     ++s->simcpu->stats[s->priv].ins_simulated;
     ++s->simcpu->stats[s->priv].ins_type[e->ins.type];
 
+    if (e->pipe_cycles.dispatch)
+    {
+        latency_histogram_add(s->simcpu->dispatch_to_commit_hist,
+                              s->simcpu->clock - e->pipe_cycles.dispatch);
+    }
+
+    if ((e->ins.is_load || e->ins.is_atomic_load) && e->pipe_cycles.memory
+        && e->pipe_cycles.issue)
+    {
+        latency_histogram_add(s->simcpu->load_to_use_hist,
+                              e->pipe_cycles.memory - e->pipe_cycles.issue);
+    }
+
     if ((e->ins.type == INS_TYPE_COND_BRANCH) && e->is_branch_taken)
     {
         ++s->simcpu->stats[s->priv].ins_cond_branch_taken;
@@ -471,12 +811,111 @@ update_insn_commit_stats(RISCVCPUState *s, InstructionLatch *e)
             }
         }
     }
+
+    /* A fused pair commits as two instructions */
+    if (e->ins.fusion)
+    {
+        ++s->simcpu->icount;
+        ++s->simcpu->stats[s->priv].ins_simulated;
+        ++s->simcpu->stats[s->priv].ins_type[e->ins.fused_type];
+        ++s->simcpu->stats[s->priv].fused_pairs[e->ins.fusion];
+    }
+}
+
+/* When the second instruction of a fused pair raises an exception, the first
+ * one is committed alone, so that the exception is taken on the second one as
+ * without fusion */
+void
+commit_fused_head(RISCVCPUState *s, InstructionLatch *e)
+{
+    s->reg[e->ins.rd] = (target_ulong)execute_fused_head(&e->ins);
+    ++s->simcpu->stats[s->priv].int_regfile_writes;
+    ++s->simcpu->icount;
+    ++s->simcpu->stats[s->priv].ins_simulated;
+    ++s->simcpu->stats[s->priv].ins_type[e->ins.fused_type];
+}
+
+/* Commit slots per cycle used by the top-down accounting */
+int
+topdown_slots_per_cycle(const SimParams *p)
+{
+    return (CORE_TYPE_OOCORE == p->core_type) ? p->rob_commit_ports : 1;
+}
+
+/* Top-down category of an empty commit slot, when the back-end ran out of
+ * instructions because of the front-end. The fetch stage in progress tells
+ * whether it waits on a page walk, on a miss in the instruction cache, or the
+ * instructions are just not there yet */
+int
+topdown_frontend_stall(RISCVSIMCPUState *simcpu, const CPUStage *fetch)
+{
+    const InstructionLatch *e;
+
+    if (!fetch->has_data || !fetch->stage_exec_done)
+    {
+        return TD_FRONTEND_BUBBLE;
+    }
+
+    e = get_insn_latch(simcpu->insn_latch_pool, fetch->insn_latch_index);
+    if (e->elasped_clock_cycles <= e->fetch_page_walk_cycles)
+    {
+        return TD_FRONTEND_ITLB;
+    }
+
+    if (MEM_LEVEL_L1 != e->fetch_mem_level)
+    {
+        return TD_FRONTEND_ICACHE;
+    }
+
+    return TD_FRONTEND_BUBBLE;
+}
+
+/* System instructions are executed by the emulator and stall the pipeline for
+ * system_insn_latency cycles, of which only their own slot is retiring */
+void
+topdown_system_insn(RISCVSIMCPUState *simcpu, int priv)
+{
+    uint64_t slots = (uint64_t)simcpu->params->system_insn_latency
+                     * topdown_slots_per_cycle(simcpu->params);
+
+    if (slots)
+    {
+        ++simcpu->stats[priv].td_slots[TD_RETIRING];
+        simcpu->stats[priv].td_slots[TD_BACKEND_CORE] += slots - 1;
+    }
+}
+
+/* System instructions commit in the emulator, from the latch left by the
+ * exception which stopped the simulation */
+void
+trace_system_insn(RISCVSIMCPUState *simcpu)
+{
+    InstructionLatch *e;
+
+    e = get_insn_latch(simcpu->insn_latch_pool,
+                       simcpu->exception->insn_latch_index);
+
+    if (simcpu->params->do_pipe_trace)
+    {
+        sim_pipe_trace_commit(simcpu->pipe_trace, simcpu->clock, e);
+    }
+
+    if (simcpu->params->do_profile)
+    {
+        sim_profile_commit(simcpu->profile, e);
+        sim_profile_head_cycles(simcpu->profile, e->ins.pc,
+                                simcpu->params->system_insn_latency);
+    }
+
+    /* So that it is not squashed when the pipeline is reset */
+    e->status = INSN_LATCH_FREE;
 }
 
 void
 write_stats_to_stats_display_shm(RISCVSIMCPUState *simcpu)
 {
-    if ((simcpu->clock % WRITE_STATS_TO_SHM_CLOCK_CYCLES_INTERVAL) == 0)
+    if (simcpu->stats_shm_ptr
+        && ((simcpu->clock % WRITE_STATS_TO_SHM_CLOCK_CYCLES_INTERVAL) == 0))
     {
         /* Since cache stats are stored separately inside the Cache structure,
          * they have to be copied to global stats structure before writing stats
@@ -503,11 +942,40 @@ set_max_clock_cycles_for_non_pipe_fu(RISCVCPUState *s, int fu_type,
     return 1;
 }
 
+/* Level of the memory hierarchy which served the access just simulated:
+ * DRAM if it queued any DRAM requests, the shared caches if it missed in L1,
+ * else L1. Lookups queued until the end of the cycle update the level of the
+ * stage once they are done. */
+static int
+get_mem_level(const Cache *l1, uint64_t l1_misses_before,
+              const StageMemAccessQueue *q)
+{
+    if (q->cur_size > q->deferred_entry)
+    {
+        return MEM_LEVEL_DRAM;
+    }
+
+    if (cache_miss_count(l1) != l1_misses_before)
+    {
+        return MEM_LEVEL_L2;
+    }
+
+    return MEM_LEVEL_L1;
+}
+
 /* Read the instruction from TinyEMU memory map into the instruction latch */
 void
 fetch_cpu_stage_exec(RISCVCPUState *s, InstructionLatch *e)
 {
+    int page_fault;
+    uint64_t host_time;
+    uint64_t l1_misses = cache_miss_count(s->simcpu->mem_hierarchy->icache);
+
     e->max_clock_cycles = 1;
+    e->fetch_page_walk_cycles = 0;
+    e->fetch_mem_level = MEM_LEVEL_L1;
+    e->pipe_cycles.seq = ++s->simcpu->fetch_seq;
+    e->pipe_cycles.fetch = s->simcpu->clock;
     e->cache_lookup_complete_signal_sent = FALSE;
     s->hw_pg_tb_wlk_stage_id = FETCH;
     s->ins_tlb_lookup_accounted = FALSE;
@@ -515,16 +983,21 @@ fetch_cpu_stage_exec(RISCVCPUState *s, InstructionLatch *e)
 
     /* Reset page walk delay before fetching current instruction. This is the
      * cache hierarchy lookup delay for page table entries, on a TLB miss */
-    s->simcpu->mem_hierarchy->mem_controller->page_walk_delay = 0;
+    s->simcpu->mem_hierarchy->page_walk_delay = 0;
 
     /* elasped_clock_cycles: number of CPU cycles spent by this instruction
      * in fetch stage so far */
     e->elasped_clock_cycles = 1;
-    s->simcpu->mem_hierarchy->mem_controller->frontend_mem_access_queue.cur_size
-        = 0;
+    s->simcpu->mem_hierarchy->frontend_mem_access_queue.cur_size = 0;
+    s->simcpu->mem_hierarchy->frontend_mem_access_queue.mem_level
+        = &e->fetch_mem_level;
 
     /* Fetch instruction from TinyEMU memory map */
-    if (s->simcpu->temu_mem_map_wrapper->read_insn(s, e))
+    host_time = host_profile_start(s->simcpu->host_profile);
+    page_fault = s->simcpu->temu_mem_map_wrapper->read_insn(s, e);
+    host_time = host_profile_mark(s->simcpu->host_profile, HOST_PROFILE_MMU,
+                                  host_time);
+    if (page_fault)
     {
         /* This instruction has raised a page fault exception during
          * fetch */
@@ -533,13 +1006,27 @@ fetch_cpu_stage_exec(RISCVCPUState *s, InstructionLatch *e)
     }
     else
     {
+        e->insn_paddr = s->code_guest_paddr;
+
         /* max_clock_cycles: Number of CPU cycles required for TLB and Cache
          * look-up */
         e->max_clock_cycles
-            = s->simcpu->mem_hierarchy->mem_controller->page_walk_delay
+            = s->simcpu->mem_hierarchy->page_walk_delay
               + s->simcpu->mem_hierarchy->insn_read_delay(
                     s->simcpu->mem_hierarchy, s->code_guest_paddr, 4, FETCH,
                     s->priv);
+        host_profile_mark(s->simcpu->host_profile, HOST_PROFILE_MEM_HIERARCHY,
+                          host_time);
+        e->fetch_page_walk_cycles
+            = s->simcpu->mem_hierarchy->page_walk_delay;
+        if (e->fetch_page_walk_cycles)
+        {
+            latency_histogram_add(s->simcpu->page_walk_hist,
+                                  e->fetch_page_walk_cycles);
+        }
+        e->fetch_mem_level = get_mem_level(
+            s->simcpu->mem_hierarchy->icache, l1_misses,
+            &s->simcpu->mem_hierarchy->frontend_mem_access_queue);
 
         sim_assert((e->max_clock_cycles), "error: %s at line %d in %s(): %s",
                    __FILE__, __LINE__, __func__,
@@ -569,6 +1056,8 @@ fetch_cpu_stage_exec(RISCVCPUState *s, InstructionLatch *e)
 void
 decode_cpu_stage_exec(RISCVCPUState *s, InstructionLatch *e)
 {
+    e->pipe_cycles.decode = s->simcpu->clock;
+
     /* For decoding floating point instructions */
     e->ins.current_fs = s->fs;
     e->ins.rm = get_insn_rm(s, (e->ins.binary >> 12) & 7);
@@ -582,15 +1071,34 @@ decode_cpu_stage_exec(RISCVCPUState *s, InstructionLatch *e)
 void
 mem_cpu_stage_exec(RISCVCPUState *s, InstructionLatch *e)
 {
+    int page_fault;
+    uint64_t host_time;
+    uint64_t l1_misses = cache_miss_count(s->simcpu->mem_hierarchy->dcache);
+
     e->max_clock_cycles = 1;
+    e->data_page_walk_cycles = 0;
+    e->data_mem_level = MEM_LEVEL_L1;
     e->cache_lookup_complete_signal_sent = FALSE;
     s->hw_pg_tb_wlk_stage_id = MEMORY;
 
     /* Reset page walk delay before executing current memory instruction. This
      * is the cache hierarchy lookup delay for page table entries, on a TLB miss */
-    s->simcpu->mem_hierarchy->mem_controller->page_walk_delay = 0;
+    s->simcpu->mem_hierarchy->page_walk_delay = 0;
+    s->simcpu->mem_hierarchy->backend_mem_access_queue.mem_level
+        = &e->data_mem_level;
+    e->data_paddr = 0;
 
-    if (s->simcpu->temu_mem_map_wrapper->exec_load_store_atomic(s, e))
+    if (e->ins.is_vector)
+    {
+        vector_unit_exec(s->simcpu->vector_unit, s, e);
+        return;
+    }
+
+    host_time = host_profile_start(s->simcpu->host_profile);
+    page_fault = s->simcpu->temu_mem_map_wrapper->exec_load_store_atomic(s, e);
+    host_time = host_profile_mark(s->simcpu->host_profile, HOST_PROFILE_MMU,
+                                  host_time);
+    if (page_fault)
     {
         /* This load, store or atomic instruction raised a page
          * fault exception */
@@ -602,7 +1110,7 @@ mem_cpu_stage_exec(RISCVCPUState *s, InstructionLatch *e)
         /* Memory access was successful, no page fault, so calculate the memory
          * access latency */
         e->max_clock_cycles
-            = s->simcpu->mem_hierarchy->mem_controller->page_walk_delay;
+            = s->simcpu->mem_hierarchy->page_walk_delay;
 
         if (s->is_device_io || !s->data_guest_paddr)
         {
@@ -613,6 +1121,18 @@ mem_cpu_stage_exec(RISCVCPUState *s, InstructionLatch *e)
         else
         {
             /* RAM access */
+            e->data_paddr = s->data_guest_paddr;
+            if (e->ins.is_atomic_load && !e->ins.lr_yielded)
+            {
+                /* LR and AMOs obtain the line in modified state, so that the
+                 * following SC or the write of the AMO does not need an
+                 * upgrade */
+                e->max_clock_cycles
+                    += s->simcpu->mem_hierarchy->data_own_delay(
+                        s->simcpu->mem_hierarchy, s->data_guest_paddr,
+                        e->ins.bytes_to_rw, MEMORY, s->priv);
+            }
+
             if ((e->ins.is_load || e->ins.is_atomic_load))
             {
                 e->max_clock_cycles
@@ -628,14 +1148,31 @@ mem_cpu_stage_exec(RISCVCPUState *s, InstructionLatch *e)
                 }
             }
 
-            if ((e->ins.is_store || e->ins.is_atomic_store))
+            /* A failed SC takes a cycle, but does not write to memory */
+            if (e->ins.is_store || e->ins.is_atomic_store)
             {
                 e->max_clock_cycles += 1;
-                s->simcpu->mem_hierarchy->data_write_delay(
-                    s->simcpu->mem_hierarchy, s->data_guest_paddr,
-                    e->ins.bytes_to_rw, MEMORY, s->priv);
+                if (!e->ins.sc_failed)
+                {
+                    s->simcpu->mem_hierarchy->data_write_delay(
+                        s->simcpu->mem_hierarchy, s->data_guest_paddr,
+                        e->ins.bytes_to_rw, MEMORY, s->priv);
+                }
             }
+            host_profile_mark(s->simcpu->host_profile,
+                              HOST_PROFILE_MEM_HIERARCHY, host_time);
+        }
+
+        e->data_page_walk_cycles
+            = s->simcpu->mem_hierarchy->page_walk_delay;
+        if (e->data_page_walk_cycles)
+        {
+            latency_histogram_add(s->simcpu->page_walk_hist,
+                                  e->data_page_walk_cycles);
         }
+        e->data_mem_level = get_mem_level(
+            s->simcpu->mem_hierarchy->dcache, l1_misses,
+            &s->simcpu->mem_hierarchy->backend_mem_access_queue);
 
         sim_assert((e->max_clock_cycles), "error: %s at line %d in %s(): %s",
                    __FILE__, __LINE__, __func__,
@@ -644,78 +1181,378 @@ mem_cpu_stage_exec(RISCVCPUState *s, InstructionLatch *e)
     }
 }
 
-void
-riscv_sim_cpu_start(RISCVSIMCPUState *simcpu, target_ulong pc)
+/* Drops the reservation of the hart when the reserved line leaves its data
+ * cache, either invalidated by a store from another hart or evicted */
+static void
+sim_cpu_coherence_line_lost(void *opaque, target_ulong paddr)
 {
-    if (!simcpu->simulation)
+    RISCVCPUState *s = (RISCVCPUState *)opaque;
+    int line_bits = s->simcpu->mem_hierarchy->dcache->word_bits;
+
+    if ((s->simcpu->load_res_paddr >> line_bits) == (paddr >> line_bits))
     {
-        simcpu->simulation = TRUE;
-        simcpu->clock = 0;
-        simcpu->icount = 0;
+        s->load_res = (target_ulong)-1;
+    }
+}
 
-        sim_stats_reset(simcpu->stats);
-        GET_TIME(simcpu->sim_start_time);
+/* The SC of a constrained LR/SC loop eventually succeeds: a hart keeps the
+ * line it reserved for LR_SC_HOLD_CYCLES cycles, so a LR of another hart in
+ * that time reads the line without taking it away, and without reserving it.
+ * Otherwise, harts running the same loop in step keep taking the line from
+ * each other between their LR and SC. */
+int
+riscv_sim_cpu_reservation_held(RISCVCPUState *s, target_ulong paddr)
+{
+    int i, line_bits;
+    RISCVCPUState *h;
 
-        simcpu->temu_rtc_time_at_simstart
-            = rtc_get_elasped_time(simcpu->emu_cpu_state->rtc);
+    if (NULL == s->simcpu->mem_hierarchy->directory)
+    {
+        return FALSE;
+    }
 
-        /* Reset BPU at every new simulation run */
-        if (simcpu->params->enable_bpu && simcpu->params->flush_bpu_on_simstart)
+    line_bits = s->simcpu->mem_hierarchy->dcache->word_bits;
+    for (i = 0; i < s->num_harts; ++i)
+    {
+        h = s->harts[i];
+        if ((h != s) && (h->load_res != (target_ulong)-1)
+            && ((h->simcpu->load_res_paddr >> line_bits)
+                == (paddr >> line_bits))
+            && (h->simcpu->clock
+                < h->simcpu->load_res_clock + LR_SC_HOLD_CYCLES))
         {
-            bpu_flush(simcpu->bpu);
+            return TRUE;
         }
+    }
+    return FALSE;
+}
 
-        /* Reset Caches at every new simulation run */
-        if (simcpu->params->enable_l1_caches)
-        {
-            cache_reset_stats(simcpu->mem_hierarchy->icache);
-            cache_reset_stats(simcpu->mem_hierarchy->dcache);
+/* The threads of an SMT core share the data cache, so a line leaving it is
+ * lost for all of them */
+static void
+sim_cpu_smt_coherence_line_lost(void *opaque, target_ulong paddr)
+{
+    int i;
+    RISCVSIMCPUState *simcpu = (RISCVSIMCPUState *)opaque;
+    RISCVSIMCPUState *boot_hart = simcpu->boot_hart;
 
-            if (simcpu->params->flush_sim_mem_on_simstart)
-            {
-                cache_flush(simcpu->mem_hierarchy->icache);
-                cache_flush(simcpu->mem_hierarchy->dcache);
-            }
+    for (i = 0; (i < simcpu->params->smt_threads)
+                && (simcpu->core_id + i < boot_hart->num_harts);
+         ++i)
+    {
+        sim_cpu_coherence_line_lost(
+            boot_hart->harts[simcpu->core_id + i]->emu_cpu_state, paddr);
+    }
+}
 
-            if (simcpu->params->enable_l2_cache)
-            {
-                cache_reset_stats(simcpu->mem_hierarchy->l2_cache);
+/* Returns the first thread of the SMT core of a hart which is not the first
+ * one, NULL otherwise */
+static RISCVSIMCPUState *
+get_smt_leader(const RISCVSIMCPUState *simcpu)
+{
+    int thread;
 
-                if (simcpu->params->flush_sim_mem_on_simstart)
-                {
-                    cache_flush(simcpu->mem_hierarchy->l2_cache);
-                }
-            }
+    if (simcpu->params->smt_threads <= 1)
+    {
+        return NULL;
+    }
+
+    thread = simcpu->core_id % simcpu->params->smt_threads;
+    if (thread == 0)
+    {
+        return NULL;
+    }
+    return simcpu->boot_hart->harts[simcpu->core_id - thread];
+}
+
+static void
+get_hart_file_name(const RISCVSIMCPUState *simcpu, char *buf, size_t size,
+                   const char *name)
+{
+    sim_log_get_hart_file_name(buf, size, name, simcpu->core_id);
+}
+
+static void
+sim_cpu_start_hart(RISCVSIMCPUState *simcpu, target_ulong pc)
+{
+    char trace_file[PATH_MAX];
+
+    /* The counter CSRs keep counting from their values of the previous run */
+    riscv_cpu_save_hpm_counters(simcpu->emu_cpu_state);
+
+    simcpu->simulation = TRUE;
+    simcpu->clock = 0;
+    simcpu->icount = 0;
+
+    sim_stats_reset(simcpu->stats);
+    memset((void *)simcpu->load_to_use_hist, 0,
+           sizeof(simcpu->load_to_use_hist));
+    memset((void *)simcpu->dispatch_to_commit_hist, 0,
+           sizeof(simcpu->dispatch_to_commit_hist));
+    memset((void *)simcpu->page_walk_hist, 0, sizeof(simcpu->page_walk_hist));
+    if (simcpu->host_profile)
+    {
+        sim_host_profile_reset(simcpu->host_profile);
+    }
+    GET_TIME(simcpu->sim_start_time);
+
+    simcpu->temu_rtc_time_at_simstart
+        = rtc_get_elasped_time(simcpu->emu_cpu_state->rtc);
+
+    /* Reservations made in emulation mode are not tracked by the coherence
+     * model */
+    simcpu->emu_cpu_state->load_res = (target_ulong)-1;
+
+    /* Reset BPU at every new simulation run */
+    if (simcpu->params->enable_bpu && simcpu->params->flush_bpu_on_simstart)
+    {
+        bpu_flush(simcpu->bpu);
+    }
+
+    /* Reset private caches at every new simulation run, L1 caches shared by
+     * the threads of an SMT core are reset by the first thread */
+    if (simcpu->params->enable_l1_caches
+        && simcpu->mem_hierarchy->owns_l1_caches)
+    {
+        cache_reset_stats(simcpu->mem_hierarchy->icache);
+        cache_reset_stats(simcpu->mem_hierarchy->dcache);
+
+        if (simcpu->params->flush_sim_mem_on_simstart)
+        {
+            cache_flush(simcpu->mem_hierarchy->icache);
+            cache_flush(simcpu->mem_hierarchy->dcache);
         }
+    }
+
+    /* Open trace file if running in trace mode */
+    if (simcpu->params->do_sim_trace)
+    {
+        simcpu->params->create_ins_str = TRUE;
+        get_hart_file_name(simcpu, trace_file, sizeof(trace_file),
+                           simcpu->params->sim_trace_file);
+        sim_log_event(sim_log, "Starting simulation trace "
+                               "at pc = 0x%" PR_target_ulong " in file: %s",
+                      pc, trace_file);
+        sim_trace_start(simcpu->trace, trace_file);
+    }
+
+    /* Open pipeline view trace file if enabled */
+    if (simcpu->params->do_pipe_trace)
+    {
+        simcpu->params->create_ins_str = TRUE;
+        simcpu->fetch_seq = 0;
+        get_hart_file_name(simcpu, trace_file, sizeof(trace_file),
+                           simcpu->params->pipe_trace_file);
+        sim_log_event(sim_log, "Starting pipeline view trace "
+                               "at pc = 0x%" PR_target_ulong " in file: %s",
+                      pc, trace_file);
+        sim_pipe_trace_start(simcpu->pipe_trace, trace_file);
+    }
+
+    if (simcpu->params->do_profile)
+    {
+        sim_profile_reset(simcpu->profile);
+    }
+}
+
+static void
+sim_cpu_reset_shared_mem(RISCVSIMCPUState *simcpu)
+{
+    int i;
 
-        /* Reset DRAMs at every new simulation run */
-        switch (simcpu->mem_hierarchy->mem_controller->dram_model_type)
+    /* Reset shared caches at every new simulation run */
+    if (simcpu->params->enable_l1_caches)
+    {
+        for (i = 0; i < simcpu->mem_hierarchy->num_shared_cache_levels; ++i)
         {
-            case MEM_MODEL_BASE:
+            cache_reset_stats(simcpu->mem_hierarchy->shared_caches[i]);
+
+            if (simcpu->params->flush_sim_mem_on_simstart)
             {
-                break;
+                cache_flush(simcpu->mem_hierarchy->shared_caches[i]);
             }
-            case MEM_MODEL_DRAMSIM:
+        }
+
+        if (simcpu->mem_hierarchy->directory)
+        {
+            coherence_reset_stats(simcpu->mem_hierarchy->directory);
+
+            if (simcpu->params->flush_sim_mem_on_simstart)
             {
-                dramsim_wrapper_destroy();
-                dramsim_wrapper_init(simcpu->params->dramsim_config_file,
-                                     simcpu->params->sim_file_path);
-                break;
+                coherence_flush(simcpu->mem_hierarchy->directory);
             }
-            case MEM_MODEL_RAMULATOR:
+        }
+    }
+
+    /* Reset DRAM at every new simulation run, dropping the requests left in
+     * flight by the harts at the end of the previous run */
+    mem_controller_reset(simcpu->mem_hierarchy->mem_controller);
+    dram_reset_stats(simcpu->mem_hierarchy->mem_controller->dram);
+
+    switch (simcpu->mem_hierarchy->mem_controller->dram_model_type)
+    {
+        case MEM_MODEL_BASE:
+        {
+            break;
+        }
+        case MEM_MODEL_DRAMSIM:
+        {
+            dramsim_wrapper_destroy();
+            dramsim_wrapper_init(simcpu->params->dramsim_config_file,
+                                 simcpu->params->sim_file_path);
+            break;
+        }
+        case MEM_MODEL_RAMULATOR:
+        {
+            break;
+        }
+        case MEM_MODEL_ANALYTICAL:
+        {
+            analytical_dram_reset(
+                simcpu->mem_hierarchy->mem_controller->dram->analytical_dram);
+            break;
+        }
+    }
+}
+
+/* Harts running a step on the host threads, or in the cycle loop of the
+ * machine, do not switch the mode of the other harts while they run, the
+ * switch is made once the step completes. Returns TRUE if the switch is
+ * deferred. */
+static int
+defer_mode_switch(RISCVSIMCPUState *simcpu, int to_simulation,
+                  target_ulong pc)
+{
+    RISCVSIMCPUState *boot_hart = simcpu->boot_hart;
+    HartThreads *ht = boot_hart->host_threads;
+
+    if (!boot_hart->stepping && ((NULL == ht) || !hart_threads_in_step(ht)))
+    {
+        return FALSE;
+    }
+
+    if (NULL != ht)
+    {
+        pthread_mutex_lock(&ht->lock);
+    }
+    if (!boot_hart->mode_switch_pending)
+    {
+        boot_hart->mode_switch_pending = TRUE;
+        boot_hart->mode_switch_to_simulation = to_simulation;
+        boot_hart->mode_switch_pc = pc;
+        boot_hart->mode_switch_hart = simcpu->core_id;
+    }
+    if (NULL != ht)
+    {
+        pthread_mutex_unlock(&ht->lock);
+    }
+    return TRUE;
+}
+
+void
+riscv_sim_cpu_process_mode_switch(RISCVSIMCPUState *simcpu)
+{
+    RISCVSIMCPUState *boot_hart = simcpu->boot_hart;
+
+    if (boot_hart->mode_switch_pending)
+    {
+        boot_hart->mode_switch_pending = FALSE;
+        if (boot_hart->mode_switch_to_simulation)
+        {
+            riscv_sim_cpu_start(boot_hart->harts[boot_hart->mode_switch_hart],
+                                boot_hart->mode_switch_pc);
+        }
+        else
+        {
+            riscv_sim_cpu_stop(boot_hart->harts[boot_hart->mode_switch_hart],
+                               boot_hart->mode_switch_pc);
+        }
+    }
+}
+
+/* Forks the children of the sweep. In a child, the simulated harts are
+ * rebuilt with the simulation parameters of its variant and the new boot hart
+ * is returned. */
+static RISCVSIMCPUState *
+sim_cpu_fork_sweep(RISCVSIMCPUState *boot_hart)
+{
+    int i, num_harts;
+    SimSweep *sweep = boot_hart->sweep;
+    SimParams *p;
+    struct RISCVCPUState *cpus[NUM_MAX_HARTS] = { NULL };
+
+    p = sim_sweep_fork(sweep, boot_hart->params);
+    if (NULL == p)
+    {
+        return boot_hart;
+    }
+
+    num_harts = boot_hart->num_harts;
+    for (i = 0; i < num_harts; ++i)
+    {
+        cpus[i] = boot_hart->harts[i]->emu_cpu_state;
+    }
+
+    /* The boot hart owns the shared memory hierarchy, so it is freed last */
+    boot_hart->sweep = NULL;
+    for (i = num_harts - 1; i >= 0; --i)
+    {
+        riscv_sim_cpu_free(&cpus[i]->simcpu);
+    }
+
+    for (i = 0; i < num_harts; ++i)
+    {
+        target_set_sim_params(cpus[i], p);
+        cpus[i]->simcpu = riscv_sim_cpu_init(p, cpus[i], i,
+                                             i ? cpus[0]->simcpu : NULL);
+    }
+
+    cpus[0]->simcpu->sweep = sweep;
+    return cpus[0]->simcpu;
+}
+
+void
+riscv_sim_cpu_start(RISCVSIMCPUState *simcpu, target_ulong pc)
+{
+    int i;
+    RISCVSIMCPUState *boot_hart = simcpu->boot_hart;
+    /* The address space of the hart executing the start marker */
+    target_ulong satp = simcpu->emu_cpu_state->satp;
+
+    if (!simcpu->simulation && !defer_mode_switch(simcpu, TRUE, pc))
+    {
+        /* Variants of the sweep are forked the first time simulation starts */
+        if ((NULL != boot_hart->sweep) && !boot_hart->sweep->forked)
+        {
+            boot_hart = sim_cpu_fork_sweep(boot_hart);
+        }
+
+        for (i = 0; i < boot_hart->num_harts; ++i)
+        {
+            sim_cpu_start_hart(boot_hart->harts[i], pc);
+        }
+        boot_hart->machine_clock = 0;
+
+        /* Shared cache levels and the memory controller are owned by the
+         * boot hart */
+        sim_cpu_reset_shared_mem(boot_hart);
+
+        for (i = 0; i < boot_hart->num_harts; ++i)
+        {
+            if (boot_hart->harts[i]->roi_stats)
             {
-                break;
+                roi_start(boot_hart->harts[i], satp);
             }
         }
 
-        /* Open trace file if running in trace mode */
-        if (simcpu->params->do_sim_trace)
+        if (boot_hart->params->do_stats_export)
+        {
+            stats_export_start(boot_hart);
+        }
+
+        if (NULL != boot_hart->lockstep)
         {
-            simcpu->params->create_ins_str = TRUE;
-            sim_log_event(sim_log, "Starting simulation trace "
-                                   "at pc = 0x%" PR_target_ulong " in file: %s",
-                          pc, simcpu->params->sim_trace_file);
-            sim_trace_start(simcpu->trace, simcpu->params->sim_trace_file);
+            lockstep_start(boot_hart->lockstep);
         }
 
         sim_log_event(sim_log, "Switching to full-system simulation "
@@ -724,25 +1561,166 @@ riscv_sim_cpu_start(RISCVSIMCPUState *simcpu, target_ulong pc)
     }
 }
 
-void
-riscv_sim_cpu_stop(RISCVSIMCPUState *simcpu, target_ulong pc)
+static void
+print_latency_hists(const RISCVSIMCPUState *simcpu, const char *file_name)
 {
-    char *timestamp;
+    int num_hists = 0;
+    const char *names[5];
+    const uint64_t *hists[5];
+    const Dram *d = simcpu->mem_hierarchy->mem_controller->dram;
+
+    names[num_hists] = "load_to_use";
+    hists[num_hists++] = simcpu->load_to_use_hist;
+    names[num_hists] = "dispatch_to_commit";
+    hists[num_hists++] = simcpu->dispatch_to_commit_hist;
+    names[num_hists] = "page_walk";
+    hists[num_hists++] = simcpu->page_walk_hist;
+
+    /* Harts running on host threads have a memory controller each */
+    if (simcpu->mem_hierarchy->owns_mem_controller)
+    {
+        names[num_hists] = "dram_read";
+        hists[num_hists++] = d->latency_hist[MEM_ACCESS_READ];
+        names[num_hists] = "dram_write";
+        hists[num_hists++] = d->latency_hist[MEM_ACCESS_WRITE];
+    }
+
+    sim_stats_print_latency_to_file(simcpu->params->sim_file_path, file_name,
+                                    names, hists, num_hists);
+}
+
+static void
+sim_cpu_stop_hart(RISCVSIMCPUState *simcpu, const char *timestamp)
+{
+    int i;
     uint64_t sim_time;
+    char file_name[PATH_MAX];
+    char roi_file_name[PATH_MAX + 8];
+
+    simcpu->simulation = FALSE;
+
+    /* Reservations made with coherent caches do not keep the other harts
+     * from storing through their write TLB, emulation mode would miss the
+     * stores dropping them */
+    simcpu->emu_cpu_state->load_res = (target_ulong)-1;
+
+    if (simcpu->roi_stats)
+    {
+        roi_stop(simcpu);
+    }
+    GET_TIME(simcpu->sim_end_time);
+    sim_time = GET_TIMER_DIFF(simcpu->sim_start_time, simcpu->sim_end_time)
+               / 1000000;
+
+    if (simcpu->boot_hart->num_harts > 1)
+    {
+        sim_log_event(sim_log, "hart %d:", simcpu->core_id);
+    }
+    print_performance_summary(simcpu, sim_time);
+
+    if (simcpu->params->do_sim_trace)
+    {
+        sim_trace_stop(simcpu->trace);
+        get_hart_file_name(simcpu, file_name, sizeof(file_name),
+                           simcpu->params->sim_trace_file);
+        sim_log_event(sim_log, "Saved simulation trace in %s", file_name);
+    }
+
+    if (simcpu->params->do_pipe_trace)
+    {
+        sim_pipe_trace_stop(simcpu->pipe_trace);
+        get_hart_file_name(simcpu, file_name, sizeof(file_name),
+                           simcpu->params->pipe_trace_file);
+        sim_log_event(sim_log, "Saved pipeline view trace in %s", file_name);
+    }
+
+    copy_cache_stats_to_global_stats(simcpu);
+    get_hart_file_name(simcpu, file_name, sizeof(file_name), timestamp);
+    sim_stats_print_to_file(simcpu->stats, simcpu->params->sim_file_path,
+                            sim_time, file_name);
+
+    print_latency_hists(simcpu, file_name);
+
+    for (i = 0; simcpu->roi_stats && i < NUM_ROI_CONTEXTS; ++i)
+    {
+        snprintf(roi_file_name, sizeof(roi_file_name), "%s%s%s", file_name,
+                 simcpu->core_id ? "_" : "",
+                 roi_context_str[i]);
+        sim_stats_print_to_file(&simcpu->roi_stats[i * NUM_MAX_PRV_LEVELS],
+                                simcpu->params->sim_file_path, sim_time,
+                                roi_file_name);
+    }
+
+    if (simcpu->params->do_profile)
+    {
+        sim_profile_print_to_file(simcpu->profile,
+                                  simcpu->params->sim_file_path, file_name);
+        sim_log_event(sim_log, "Saved profile in %s/%sprofile.csv",
+                      simcpu->params->sim_file_path, file_name);
+    }
+
+    if (simcpu->host_profile)
+    {
+        sim_host_profile_print_to_file(
+            simcpu->host_profile, simcpu->params->sim_file_path, file_name,
+            GET_TIMER_DIFF(simcpu->sim_start_time, simcpu->sim_end_time));
+    }
+}
+
+/* Returns the count of the event selected by mhpmevent since simulation
+ * started, in the privilege modes it does not inhibit. The counts of the
+ * last simulation run are kept in emulation mode. */
+uint64_t
+riscv_sim_cpu_hpm_event_count(RISCVSIMCPUState *simcpu, uint64_t mhpmevent)
+{
+    int i, num_stats;
+    uint64_t count = 0;
+    const SimStats *stats;
+    const uint64_t inhibit[NUM_MAX_PRV_LEVELS]
+        = {HPM_EVENT_UINH, HPM_EVENT_SINH, 0, HPM_EVENT_MINH};
+
+    if ((mhpmevent & HPM_EVENT_MASK) == HPM_EVENT_NONE)
+    {
+        return 0;
+    }
 
     if (simcpu->simulation)
     {
-        simcpu->simulation = FALSE;
-        GET_TIME(simcpu->sim_end_time);
-        sim_time = GET_TIMER_DIFF(simcpu->sim_start_time, simcpu->sim_end_time)
-                   / 1000000;
+        copy_cache_stats_to_global_stats(simcpu);
+    }
+
+    /* Counted in every context with a region of interest filter */
+    stats = simcpu->stats;
+    num_stats = NUM_MAX_PRV_LEVELS;
+    if (simcpu->roi_stats && simcpu->simulation)
+    {
+        stats = simcpu->roi_stats;
+        num_stats = NUM_ROI_CONTEXTS * NUM_MAX_PRV_LEVELS;
+    }
+
+    for (i = 0; i < num_stats; ++i)
+    {
+        if (!(mhpmevent & inhibit[i % NUM_MAX_PRV_LEVELS]))
+        {
+            count += sim_stats_hpm_event(&stats[i], mhpmevent & HPM_EVENT_MASK);
+        }
+    }
+    return count;
+}
 
-        print_performance_summary(simcpu, sim_time);
+void
+riscv_sim_cpu_stop(RISCVSIMCPUState *simcpu, target_ulong pc)
+{
+    int i;
+    char *timestamp;
+    RISCVSIMCPUState *boot_hart = simcpu->boot_hart;
 
+    if (simcpu->simulation && !defer_mode_switch(simcpu, FALSE, pc))
+    {
         timestamp
             = sim_log_get_current_timestamp(simcpu->params->sim_file_prefix);
 
-        switch (simcpu->mem_hierarchy->mem_controller->dram_model_type)
+        switch (boot_hart->mem_hierarchy->mem_controller->dram_model_type)
         {
             case MEM_MODEL_BASE:
             {
@@ -768,18 +1746,41 @@ riscv_sim_cpu_stop(RISCVSIMCPUState *simcpu, target_ulong pc)
                     simcpu->params->sim_file_path, timestamp);
                 break;
             }
+            case MEM_MODEL_ANALYTICAL:
+            {
+                analytical_dram_print_stats(
+                    boot_hart->mem_hierarchy->mem_controller->dram
+                        ->analytical_dram,
+                    simcpu->params->sim_file_path, timestamp);
+                break;
+            }
         }
 
-        if (simcpu->params->do_sim_trace)
+        for (i = 0; i < boot_hart->num_harts; ++i)
         {
-            sim_trace_stop(simcpu->trace);
-            sim_log_event(sim_log, "Saved simulation trace in %s",
-                          simcpu->params->sim_trace_file);
+            sim_cpu_stop_hart(boot_hart->harts[i], timestamp);
         }
 
-        copy_cache_stats_to_global_stats(simcpu);
-        sim_stats_print_to_file(simcpu->stats, simcpu->params->sim_file_path,
-                                sim_time, timestamp);
+        if (NULL != boot_hart->registry)
+        {
+            stats_export_sample(boot_hart, TRUE);
+            sim_registry_close(boot_hart->registry);
+        }
+
+        if (NULL != boot_hart->lockstep)
+        {
+            lockstep_stop(boot_hart->lockstep, boot_hart->params,
+                          boot_hart->stats,
+                          GET_TIMER_DIFF(boot_hart->sim_start_time,
+                                         boot_hart->sim_end_time)
+                              / 1000000,
+                          timestamp);
+        }
+
+        if (NULL != boot_hart->sweep)
+        {
+            sim_sweep_finish(boot_hart->sweep, boot_hart->params, timestamp);
+        }
 
         sim_log_event(sim_log, "Switching to emulation mode "
                                "mode at pc = 0x%" PR_target_ulong,
@@ -789,21 +1790,281 @@ riscv_sim_cpu_stop(RISCVSIMCPUState *simcpu, target_ulong pc)
     }
 }
 
-void
-riscv_sim_cpu_reset(RISCVSIMCPUState *simcpu)
+/* Squashes the instructions in flight in the pipeline of the hart */
+static void
+reset_pipeline(RISCVSIMCPUState *simcpu)
 {
     simcpu->exception->pending = FALSE;
     simcpu->skip_fetch_cycle = FALSE;
+
+    /* The instructions in flight are squashed */
+    if (simcpu->params->do_pipe_trace)
+    {
+        sim_pipe_trace_mark_flush(simcpu->pipe_trace, simcpu->insn_latch_pool);
+    }
     reset_insn_latch_pool(simcpu->insn_latch_pool);
-    mem_controller_reset(simcpu->mem_hierarchy->mem_controller);
+    if (simcpu->params->do_pipe_trace)
+    {
+        sim_pipe_trace_squash(simcpu->pipe_trace, simcpu->insn_latch_pool);
+    }
+    if (simcpu->vector_unit)
+    {
+        vector_unit_reset(simcpu->vector_unit);
+    }
     simcpu->core_reset(simcpu->core);
 }
 
+void
+riscv_sim_cpu_reset(RISCVSIMCPUState *simcpu)
+{
+    memory_hierarchy_flush(simcpu->mem_hierarchy);
+    reset_pipeline(simcpu);
+}
+
+/* Counts the instructions committed by the hart, returns TRUE if it must leave
+ * the pipeline. A hart running alone returns to its emulator once the
+ * n_cycles instructions of its interval commit. In the cycle loop of the
+ * machine, the instructions are added to the instruction counter of the hart,
+ * which leaves the pipeline only to take an interrupt or to let a mode switch
+ * complete. */
+int
+riscv_sim_cpu_commit(RISCVSIMCPUState *simcpu, int num_insns)
+{
+    RISCVCPUState *s = simcpu->emu_cpu_state;
+
+    if (simcpu->boot_hart->stepping)
+    {
+        s->insn_counter += num_insns;
+        return simcpu->boot_hart->mode_switch_pending
+               || get_pending_irq_mask(s);
+    }
+
+    s->n_cycles -= num_insns;
+    return s->n_cycles <= 0;
+}
+
+/* A hart out of the pipeline enters it again at the PC of its emulator,
+ * unless it waits for an interrupt or a mode switch is pending. An interrupt
+ * pending for the hart is taken by its emulator first. Returns TRUE if the
+ * hart is in the pipeline. */
+static int
+hart_enter(RISCVSIMCPUState *simcpu)
+{
+    RISCVCPUState *s = simcpu->emu_cpu_state;
+
+    /* An interrupt may have been raised by another hart */
+    if (s->power_down_flag && ((s->mip & s->mie) != 0))
+    {
+        s->power_down_flag = FALSE;
+    }
+
+    if (!simcpu->simulation || s->power_down_flag
+        || simcpu->boot_hart->mode_switch_pending)
+    {
+        return FALSE;
+    }
+
+    if (get_pending_irq_mask(s))
+    {
+        riscv_cpu_interp(s, 1);
+    }
+
+    /* The requests of the other harts to the memory controller are left in
+     * progress */
+    memory_hierarchy_flush(simcpu->mem_hierarchy);
+    reset_pipeline(simcpu);
+    s->code_ptr = NULL;
+    s->code_end = NULL;
+    s->code_to_pc_addend = s->pc;
+    simcpu->in_pipeline = TRUE;
+    return TRUE;
+}
+
+/* The emulator of the hart resumes at the instruction which raised the
+ * exception, handled right away, or after the instruction committed last */
+static void
+hart_leave(RISCVSIMCPUState *simcpu)
+{
+    RISCVCPUState *s = simcpu->emu_cpu_state;
+
+    simcpu->in_pipeline = FALSE;
+    s->pc = simcpu->exception->pc;
+    ++simcpu->stats[s->priv].pipeline_flush;
+
+    if (simcpu->exception->cause != SIM_TEMU_TIMEOUT_EXCEPTION)
+    {
+        simcpu->exit_pending = TRUE;
+        riscv_cpu_interp(s, 1);
+        simcpu->exit_pending = FALSE;
+    }
+}
+
+static uint64_t
+harts_insn_count(const RISCVSIMCPUState *boot_hart)
+{
+    int i;
+    uint64_t count = 0;
+
+    for (i = 0; i < boot_hart->num_harts; ++i)
+    {
+        count += boot_hart->harts[i]->emu_cpu_state->insn_counter;
+    }
+    return count;
+}
+
+/* A hart can run in the cycle loop if it is in the pipeline, or if it can
+ * enter it */
+static int
+hart_can_run(const RISCVSIMCPUState *simcpu)
+{
+    const RISCVCPUState *s = simcpu->emu_cpu_state;
+
+    return simcpu->in_pipeline
+           || (simcpu->simulation && !simcpu->boot_hart->mode_switch_pending
+               && (!s->power_down_flag || ((s->mip & s->mie) != 0)));
+}
+
+/* Runs the given cycle of the machine on the hart */
+static void
+hart_cycle(RISCVSIMCPUState *simcpu, uint64_t cycle)
+{
+    if (simcpu->in_pipeline || hart_enter(simcpu))
+    {
+        /* A hart back from its emulator waits for the cycles of the system
+         * instruction it executed */
+        if (simcpu->clock <= cycle)
+        {
+            memory_hierarchy_clock(simcpu->mem_hierarchy);
+            if (simcpu->core_step(simcpu->core))
+            {
+                hart_leave(simcpu);
+            }
+        }
+    }
+
+    /* Harts out of the pipeline follow the clock of the machine, mtime
+     * follows the clock of the boot hart */
+    if (!simcpu->in_pipeline && (simcpu->clock <= cycle))
+    {
+        simcpu->clock = cycle + 1;
+    }
+}
+
+/* Ends the given number of cycles of the machine, once every hart ran them:
+ * the lookups queued by the harts are performed in hart order, and the memory
+ * controller shared by the harts is clocked. Returns TRUE if the harts keep
+ * running. */
+static int
+machine_cycles_end(RISCVSIMCPUState *boot_hart, int cycles)
+{
+    int i;
+    int running = FALSE;
+    uint64_t host_time;
+    SimHostProfile *hp = boot_hart->host_profile;
+
+    for (i = 0; i < boot_hart->num_harts; ++i)
+    {
+        memory_hierarchy_drain(boot_hart->harts[i]->mem_hierarchy);
+    }
+
+    host_time = host_profile_start(hp);
+    for (i = 0; i < cycles; ++i)
+    {
+        mem_controller_clock(boot_hart->mem_hierarchy->mem_controller);
+    }
+    host_profile_mark(hp, HOST_PROFILE_DRAM, host_time);
+    boot_hart->machine_clock += cycles;
+
+    for (i = 0; i < boot_hart->num_harts; ++i)
+    {
+        running = running || hart_can_run(boot_hart->harts[i]);
+    }
+
+    return running
+           && ((harts_insn_count(boot_hart) - boot_hart->step_start_insns)
+               < boot_hart->step_max_insns);
+}
+
+/* Barrier function of the host threads */
+static int
+machine_sync(void *opaque)
+{
+    RISCVSIMCPUState *boot_hart = (RISCVSIMCPUState *)opaque;
+
+    return machine_cycles_end(boot_hart, boot_hart->host_threads->sync_quantum);
+}
+
+/* Cycle loop of a multi-hart machine. Every cycle, the timing core of every
+ * hart in the pipeline is stepped by a cycle, in hart order, then the cycle
+ * of the machine ends, see machine_cycles_end(). A hart leaves the pipeline
+ * on the exceptions handled by its emulator, to take an interrupt or to wait
+ * for one, and enters it again from the next cycle, while the other harts
+ * keep running. Returns once the harts committed max_insns instructions, or
+ * once none of them can run, which completes a pending mode switch.
+ *
+ * If the harts run on host threads, every hart runs its cycles on its own
+ * thread instead, and the machine ends them every sync_quantum cycles, see
+ * riscv_sim_cpu_run_hart(). */
+void
+riscv_sim_cpu_run_harts(RISCVSIMCPUState *simcpu, int max_insns)
+{
+    int i;
+    RISCVSIMCPUState *boot_hart = simcpu->boot_hart;
+
+    boot_hart->step_start_insns = harts_insn_count(boot_hart);
+    boot_hart->step_max_insns = max_insns;
+    boot_hart->stepping = TRUE;
+    if (NULL != boot_hart->host_threads)
+    {
+        hart_threads_run(boot_hart->host_threads, max_insns);
+    }
+    else
+    {
+        do
+        {
+            for (i = 0; i < boot_hart->num_harts; ++i)
+            {
+                hart_cycle(boot_hart->harts[i], boot_hart->machine_clock);
+            }
+        } while (machine_cycles_end(boot_hart, 1));
+    }
+    boot_hart->stepping = FALSE;
+
+    riscv_sim_cpu_process_mode_switch(boot_hart);
+}
+
+/* Runs the hart on its host thread, in the cycle loop of the machine */
+void
+riscv_sim_cpu_run_hart(RISCVSIMCPUState *simcpu)
+{
+    int cycles;
+    RISCVSIMCPUState *boot_hart = simcpu->boot_hart;
+    HartThreads *ht = boot_hart->host_threads;
+
+    do
+    {
+        for (cycles = 0; cycles < ht->sync_quantum; ++cycles)
+        {
+            hart_cycle(simcpu, boot_hart->machine_clock + cycles);
+        }
+    } while (hart_threads_sync(ht, simcpu->core_id, &machine_sync, boot_hart));
+}
+
 int
 riscv_sim_cpu_switch_to_cpu_simulation(RISCVSIMCPUState *simcpu)
 {
     int sim_exit_status;
 
+    /* In the cycle loop of the machine, the hart left the pipeline already,
+     * on an exception handled now by its emulator */
+    if (simcpu->boot_hart->stepping)
+    {
+        sim_assert((simcpu->exit_pending), "error: %s at line %d in %s(): %s",
+                   __FILE__, __LINE__, __func__,
+                   "hart entered its emulator without an exception to handle");
+        return simcpu->exception->cause;
+    }
+
     riscv_sim_cpu_reset(simcpu);
     sim_exit_status = simcpu->core_run(simcpu->core);
 
@@ -814,28 +2075,57 @@ riscv_sim_cpu_switch_to_cpu_simulation(RISCVSIMCPUState *simcpu)
     return sim_exit_status;
 }
 
+void
+riscv_sim_cpu_set_host_threads(RISCVSIMCPUState *simcpu, HartThreads *ht)
+{
+    simcpu->host_threads = ht;
+}
+
+/* boot_hart is NULL when creating the boot hart, which owns the memory
+ * hierarchy below the L1 caches shared by all the harts */
 RISCVSIMCPUState *
-riscv_sim_cpu_init(const SimParams *p, struct RISCVCPUState *s)
+riscv_sim_cpu_init(const SimParams *p, struct RISCVCPUState *s, int core_id,
+                   RISCVSIMCPUState *boot_hart)
 {
     RISCVSIMCPUState *simcpu;
+    RISCVSIMCPUState *smt_leader;
 
     simcpu = calloc(1, sizeof(RISCVSIMCPUState));
     assert(simcpu);
 
+    simcpu->core_id = core_id;
+    simcpu->boot_hart = boot_hart ? boot_hart : simcpu;
+    sim_assert((simcpu->boot_hart->num_harts < NUM_MAX_HARTS),
+               "error: %s at line %d in %s(): %s", __FILE__, __LINE__, __func__,
+               "maximum number of harts exceeded");
+    simcpu->boot_hart->harts[simcpu->boot_hart->num_harts++] = simcpu;
+
     simcpu->emu_cpu_state = s;
     simcpu->pc = 0x1000;
     simcpu->clock = 0;
     simcpu->params = (SimParams *)p;
     simcpu->return_to_sim = FALSE;
 
-    simcpu->stats = (SimStats *)calloc(NUM_MAX_PRV_LEVELS, sizeof(SimStats));
+    simcpu->all_stats
+        = (SimStats *)calloc(NUM_MAX_PRV_LEVELS, sizeof(SimStats));
+    simcpu->stats = simcpu->all_stats;
     assert(simcpu->stats != NULL);
 
+    if (ROI_FILTER_NONE != p->roi_filter)
+    {
+        simcpu->roi_stats = (SimStats *)calloc(
+            NUM_ROI_CONTEXTS * NUM_MAX_PRV_LEVELS, sizeof(SimStats));
+        assert(simcpu->roi_stats);
+    }
+
     simcpu->insn_latch_pool = (InstructionLatch *)calloc(
         INSN_LATCH_POOL_SIZE, sizeof(InstructionLatch));
     assert(simcpu->insn_latch_pool);
 
-    sim_params_log_options(p);
+    if (NULL == boot_hart)
+    {
+        sim_params_log_options(p);
+    }
 
     switch (p->core_type)
     {
@@ -844,6 +2134,7 @@ riscv_sim_cpu_init(const SimParams *p, struct RISCVCPUState *s)
             simcpu->core = (void *)in_core_init(simcpu->params, simcpu);
             simcpu->core_reset = in_core_reset;
             simcpu->core_run = in_core_run;
+            simcpu->core_step = in_core_step;
             simcpu->core_free = in_core_free;
             break;
         }
@@ -852,21 +2143,47 @@ riscv_sim_cpu_init(const SimParams *p, struct RISCVCPUState *s)
             simcpu->core = (void *)oo_core_init(simcpu->params, simcpu);
             simcpu->core_reset = oo_core_reset;
             simcpu->core_run = oo_core_run;
+            simcpu->core_step = oo_core_step;
             simcpu->core_free = oo_core_free;
             break;
         }
     }
 
-    sim_params_log_exec_unit_config(p);
-
-    simcpu->mem_hierarchy = memory_hierarchy_init(simcpu->params, sim_log);
+    smt_leader = get_smt_leader(simcpu);
+    if (NULL == boot_hart)
+    {
+        sim_params_log_exec_unit_config(p);
+        simcpu->mem_hierarchy
+            = memory_hierarchy_init(simcpu->params, sim_log, NULL, NULL);
+    }
+    else
+    {
+        simcpu->mem_hierarchy = memory_hierarchy_init(
+            simcpu->params, sim_log, boot_hart->mem_hierarchy,
+            smt_leader ? smt_leader->mem_hierarchy : NULL);
+    }
 
-    /* Seed for random eviction, if used in BPU and caches */
-    srand(time(NULL));
+    if (simcpu->mem_hierarchy->directory && (p->smt_threads > 1))
+    {
+        if (NULL == smt_leader)
+        {
+            coherence_set_line_lost_handler(
+                simcpu->mem_hierarchy->directory,
+                simcpu->mem_hierarchy->coherence_agent,
+                &sim_cpu_smt_coherence_line_lost, simcpu);
+        }
+    }
+    else if (simcpu->mem_hierarchy->directory)
+    {
+        coherence_set_line_lost_handler(simcpu->mem_hierarchy->directory,
+                                        simcpu->mem_hierarchy->coherence_agent,
+                                        &sim_cpu_coherence_line_lost, s);
+    }
 
     if (p->enable_bpu)
     {
-        simcpu->bpu = bpu_init(p, simcpu->stats);
+        simcpu->bpu = bpu_init(p, simcpu->stats,
+                               smt_leader ? smt_leader->bpu : NULL);
         simcpu->bpu_fetch_stage_handler = &bpu_enabled_fetch_stage_handler;
         simcpu->bpu_decode_stage_handler = &bpu_enabled_decode_stage_handler;
         simcpu->bpu_execute_stage_handler = &bpu_enabled_execute_stage_handler;
@@ -878,11 +2195,40 @@ riscv_sim_cpu_init(const SimParams *p, struct RISCVCPUState *s)
         simcpu->bpu_execute_stage_handler = &bpu_disabled_execute_stage_handler;
     }
 
+    if (p->enable_vector)
+    {
+        simcpu->vector_unit = vector_unit_init(
+            p, p->enable_l1_caches ? p->l1_data_cache.line_size
+                                   : p->cache_line_size);
+    }
+
     simcpu->temu_mem_map_wrapper = temu_mem_map_wrapper_init();
     simcpu->exception = sim_exception_init();
     simcpu->trace = sim_trace_init();
+    simcpu->pipe_trace = sim_pipe_trace_init(p);
+
+    if (p->do_profile)
+    {
+        simcpu->profile = sim_profile_init(p);
+    }
+
+    if (p->do_host_profile)
+    {
+        simcpu->host_profile = sim_host_profile_init();
+    }
 
-    if (p->enable_stats_display)
+    if (p->sweep_file && (NULL == boot_hart))
+    {
+        simcpu->sweep = sim_sweep_init(p);
+    }
+
+    if (p->lockstep_file && (NULL == boot_hart))
+    {
+        simcpu->lockstep = lockstep_init(p);
+    }
+
+    /* sim-stats-display tool shows the stats of the boot hart */
+    if (p->enable_stats_display && (NULL == boot_hart))
     {
         setup_stats_shm(simcpu);
     }
@@ -896,7 +2242,15 @@ riscv_sim_cpu_init(const SimParams *p, struct RISCVCPUState *s)
 void
 riscv_sim_cpu_free(RISCVSIMCPUState **simcpu)
 {
-    free((*simcpu)->stats);
+    if ((*simcpu)->registry)
+    {
+        sim_registry_free(&(*simcpu)->registry);
+    }
+
+    free((*simcpu)->all_stats);
+    (*simcpu)->all_stats = NULL;
+    free((*simcpu)->roi_stats);
+    (*simcpu)->roi_stats = NULL;
     (*simcpu)->stats = NULL;
 
     free((*simcpu)->insn_latch_pool);
@@ -913,5 +2267,31 @@ riscv_sim_cpu_free(RISCVSIMCPUState **simcpu)
     temu_mem_map_wrapper_free(&(*simcpu)->temu_mem_map_wrapper);
     sim_exception_free(&(*simcpu)->exception);
     sim_trace_free(&(*simcpu)->trace);
+    sim_pipe_trace_free(&(*simcpu)->pipe_trace);
+
+    if ((*simcpu)->profile)
+    {
+        sim_profile_free(&(*simcpu)->profile);
+    }
+
+    if ((*simcpu)->host_profile)
+    {
+        sim_host_profile_free(&(*simcpu)->host_profile);
+    }
+
+    if ((*simcpu)->sweep)
+    {
+        sim_sweep_free(&(*simcpu)->sweep);
+    }
+
+    if ((*simcpu)->lockstep)
+    {
+        lockstep_free(&(*simcpu)->lockstep);
+    }
+
+    if ((*simcpu)->vector_unit)
+    {
+        vector_unit_free(&(*simcpu)->vector_unit);
+    }
     free(*simcpu);
 }
@@ -38,9 +38,16 @@
 #include "../riscv_sim_typedefs.h"
 #include "../utils/cpu_latches.h"
 #include "../utils/sim_exception.h"
+#include "../utils/sim_host_profile.h"
 #include "../utils/sim_params.h"
+#include "../utils/sim_pipe_trace.h"
+#include "../utils/sim_profile.h"
 #include "../utils/sim_stats.h"
+#include "../utils/sim_sweep.h"
 #include "../utils/sim_trace.h"
+#include "hart_threads.h"
+#include "lockstep.h"
+#include "vector_unit.h"
 
 /* Forward declare */
 struct RISCVCPUState;
@@ -58,6 +65,11 @@ typedef struct RISCVSIMCPUState
                                       (temu_rtc_time_at_simstart + clock) */
     int skip_fetch_cycle;
 
+    /* Physical address reserved by the last LR, the reservation is dropped
+     * when the line leaves the coherent data cache of this hart */
+    target_ulong load_res_paddr;
+    uint64_t load_res_clock; /* Clock cycle of the LR */
+
     /* Simulator maintains a pool of free instruction latches known as
      * insn_latch_pool. Every instruction fetched into the pipeline is allocated
      * a instruction latch from this pool. The pointer of this latch is passed
@@ -66,7 +78,22 @@ typedef struct RISCVSIMCPUState
      * pool for reuse by following instructions. */
     InstructionLatch *insn_latch_pool;
 
+    /* Per-mode stats being updated. With a region of interest filter, they
+     * point during simulation to the stats of the current context in
+     * roi_stats, which add up to all_stats when simulation stops. */
     SimStats *stats;
+    SimStats *all_stats;
+    SimStats *roi_stats; /* NULL without region of interest filter */
+    int roi_context;     /* ROI_CONTEXT_* */
+    target_ulong roi_satp;
+    SimStats roi_mem_stats[NUM_MAX_PRV_LEVELS]; /* Memory hierarchy stats at
+                                                   the last context switch */
+
+    /* Latency histograms of the simulation run, in CPU cycles: load issue to
+     * data, dispatch to commit, and hardware page walks */
+    uint64_t load_to_use_hist[NUM_LATENCY_BUCKETS];
+    uint64_t dispatch_to_commit_hist[NUM_LATENCY_BUCKETS];
+    uint64_t page_walk_hist[NUM_LATENCY_BUCKETS];
     SimParams *params;
     BranchPredUnit *bpu;
 
@@ -87,6 +114,11 @@ typedef struct RISCVSIMCPUState
     /* For generating simulation trace */
     SimTrace *trace;
 
+    /* For generating pipeline view trace */
+    SimPipeTrace *pipe_trace;
+    SimProfile *profile;
+    uint64_t fetch_seq; /* Instructions fetched in this simulation run */
+
     /* Pointer to shared memory area to write stats, which is read by
      * sim-stats-display tool */
     SimStats *stats_shm_ptr;
@@ -105,19 +137,84 @@ typedef struct RISCVSIMCPUState
 
     struct RISCVCPUState *emu_cpu_state; /* Pointer to emulated CPU state */
 
+    /* Harts of a multi-hart machine enter and leave simulation mode together.
+     * The list of harts is kept by the boot hart (core_id 0), and every hart
+     * points to the boot hart. */
+    struct RISCVSIMCPUState *boot_hart;
+    int num_harts;
+    struct RISCVSIMCPUState *harts[NUM_MAX_HARTS];
+
+    /* Set if the harts run on host threads */
+    HartThreads *host_threads;
+
+    /* In a multi-hart machine, the timing cores of the harts are stepped
+     * together, one cycle at a time, by the cycle loop of the machine (see
+     * riscv_sim_cpu_run_harts()). Set while the loop runs, cycles elapsed in
+     * it since simulation start, and the instructions to commit in the
+     * current run of the loop, kept by the boot hart. */
+    int stepping;
+    uint64_t machine_clock;
+    uint64_t step_start_insns;
+    uint64_t step_max_insns;
+
+    /* Set while the hart is in the pipeline in the cycle loop, and once it
+     * left it on an exception its emulator has to handle */
+    int in_pipeline;
+    int exit_pending;
+
+    /* Switch to or from simulation mode requested by a hart during a step of
+     * the host threads or of the cycle loop, kept by the boot hart until the
+     * step completes */
+    int mode_switch_pending;
+    int mode_switch_to_simulation;
+    target_ulong mode_switch_pc;
+    int mode_switch_hart;
+
+    /* Design-space sweep, kept by the boot hart */
+    SimSweep *sweep;
+
+    /* Stats registry of all the harts, kept by the boot hart, NULL if the
+     * stats export is disabled */
+    SimRegistry *registry;
+    uint64_t next_stats_sample; /* Clock cycle of the next sample */
+
+    /* Host time spent in the regions of the simulator run by this hart, NULL
+     * if host profiling is disabled */
+    SimHostProfile *host_profile;
+
+    /* Variants timed in lockstep with the committed instructions of the boot
+     * hart, NULL if lockstep simulation is disabled */
+    Lockstep *lockstep;
+
+    /* Vector unit of the hart, NULL if the vector extension is disabled */
+    VectorUnit *vector_unit;
+
     /*----------  Set based on core type: in-order or out-of-order  ----------*/
     void *core;
     void (*core_reset)(void *core);
     void (*core_free)(void *core);
     int (*core_run)(void *core);
+    int (*core_step)(void *core);
 } RISCVSIMCPUState;
 
 RISCVSIMCPUState *riscv_sim_cpu_init(const SimParams *p,
-                                     struct RISCVCPUState *s);
+                                     struct RISCVCPUState *s, int core_id,
+                                     RISCVSIMCPUState *boot_hart);
 int riscv_sim_cpu_switch_to_cpu_simulation(RISCVSIMCPUState *simcpu);
 void riscv_sim_cpu_start(RISCVSIMCPUState *simcpu, target_ulong pc);
 void riscv_sim_cpu_stop(RISCVSIMCPUState *simcpu, target_ulong pc);
 void riscv_sim_cpu_reset(RISCVSIMCPUState *simcpu);
+void riscv_sim_cpu_run_harts(RISCVSIMCPUState *simcpu, int max_insns);
+void riscv_sim_cpu_run_hart(RISCVSIMCPUState *simcpu);
+int riscv_sim_cpu_commit(RISCVSIMCPUState *simcpu, int num_insns);
+int riscv_sim_cpu_reservation_held(struct RISCVCPUState *s,
+                                   target_ulong paddr);
+void riscv_sim_cpu_set_host_threads(RISCVSIMCPUState *simcpu, HartThreads *ht);
+void riscv_sim_cpu_process_mode_switch(RISCVSIMCPUState *simcpu);
+uint64_t riscv_sim_cpu_hpm_event_count(RISCVSIMCPUState *simcpu,
+                                       uint64_t mhpmevent);
+void riscv_sim_cpu_roi_switch(RISCVSIMCPUState *simcpu);
+void riscv_sim_cpu_sample_stats(RISCVSIMCPUState *simcpu);
 void riscv_sim_cpu_free(RISCVSIMCPUState **simcpu);
 
 int get_data_mem_access_latency(struct RISCVCPUState *s, InstructionLatch *e);
@@ -127,7 +224,13 @@ void decode_cpu_stage_exec(struct RISCVCPUState *s, InstructionLatch *e);
 void update_arch_reg_int(struct RISCVCPUState *s, InstructionLatch *e);
 void update_arch_reg_fp(struct RISCVCPUState *s, InstructionLatch *e);
 void update_insn_commit_stats(struct RISCVCPUState *s, InstructionLatch *e);
+void commit_fused_head(struct RISCVCPUState *s, InstructionLatch *e);
+int topdown_slots_per_cycle(const SimParams *p);
+int topdown_frontend_stall(RISCVSIMCPUState *simcpu, const CPUStage *fetch);
+void topdown_system_insn(RISCVSIMCPUState *simcpu, int priv);
+void trace_system_insn(RISCVSIMCPUState *simcpu);
 void write_stats_to_stats_display_shm(RISCVSIMCPUState *simcpu);
+void copy_mem_hierarchy_stats(const MemoryHierarchy *m, SimStats *stats);
 int set_max_clock_cycles_for_non_pipe_fu(struct RISCVCPUState *s, int fu_type,
                                          InstructionLatch *e);
 #endif
@@ -0,0 +1,414 @@
+/**
+ * Vector Unit Timing Model
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../cutils.h"
+#include "../../riscv_cpu_priv.h"
+#include "../memory_hierarchy/memory_controller.h"
+#include "../utils/sim_log.h"
+#include "riscv_sim_cpu.h"
+#include "vector_unit.h"
+
+static uint64_t
+max_u64(uint64_t a, uint64_t b)
+{
+    return (a > b) ? a : b;
+}
+
+/* Cycles at which the first and the last elements of the vector registers in
+ * mask are available */
+static void
+regs_ready(const VectorUnit *u, uint32_t mask, uint64_t *first,
+           uint64_t *last)
+{
+    int i;
+
+    *first = 0;
+    *last = 0;
+    for (i = 0; i < 32; ++i)
+    {
+        if (mask & (1u << i))
+        {
+            *first = max_u64(*first, u->reg_first_ready[i]);
+            *last = max_u64(*last, u->reg_last_ready[i]);
+        }
+    }
+}
+
+static void
+regs_set_ready(VectorUnit *u, uint32_t mask, uint64_t first, uint64_t last)
+{
+    int i;
+
+    for (i = 0; i < 32; ++i)
+    {
+        if (mask & (1u << i))
+        {
+            u->reg_first_ready[i] = first;
+            u->reg_last_ready[i] = last;
+        }
+    }
+}
+
+/* Cycle at which an instruction whose sources are in src_regs can start */
+static uint64_t
+start_cycle(const VectorUnit *u, uint32_t src_regs, uint64_t now,
+            uint64_t pipe_free, uint64_t *src_last)
+{
+    uint64_t src_first;
+
+    regs_ready(u, src_regs, &src_first, src_last);
+    return max_u64(max_u64(now, pipe_free),
+                   u->chaining ? src_first : *src_last);
+}
+
+/* Called by riscv_vector_exec() for every element accessed in RAM. A request
+ * is sent to the memory hierarchy for each new cache line. Returns TRUE to end
+ * the batch, when the backend memory access queue is half full, counting the
+ * lookups queued until the end of the cycle. */
+static int
+vector_unit_mem_access(void *opaque, uint64_t paddr, int bytes, int is_write)
+{
+    VectorUnit *u = (VectorUnit *)opaque;
+    RISCVCPUState *s = u->s;
+    MemoryHierarchy *m = s->simcpu->mem_hierarchy;
+    target_ulong line = (target_ulong)paddr >> u->line_bits;
+    uint64_t done;
+
+    if (line != u->last_line || is_write != u->last_write)
+    {
+        done = u->batch_lines / u->mem_lines_per_cycle;
+        if (is_write)
+        {
+            m->data_write_delay(m, paddr, bytes, MEMORY, s->priv);
+            done += 1;
+        }
+        else
+        {
+            done += m->data_read_delay(m, paddr, bytes, MEMORY, s->priv);
+        }
+
+        if (!u->batch_lines)
+        {
+            u->batch_first = done;
+        }
+        u->batch_last = max_u64(u->batch_last, done);
+        u->last_line = line;
+        u->last_write = is_write;
+        ++u->lines;
+        ++u->batch_lines;
+        ++s->simcpu->stats[s->priv].vec_mem_lines;
+    }
+
+    return m->backend_mem_access_queue.cur_size
+               + m->backend_mem_access_queue.deferred
+           >= BACKEND_MEM_ACCESS_QUEUE_SIZE / 2;
+}
+
+/* Write the scalar operands read by the pipeline into the architectural
+ * registers before the functional execution. On the out-of-order core this is
+ * a no-op as the instruction is at the ROB head, on the in-order core older
+ * instructions may still be in the commit stage. */
+static void
+write_scalar_operands(RISCVCPUState *s, const InstructionLatch *e)
+{
+    if (e->ins.has_src1 && e->ins.rs1)
+    {
+        s->reg[e->ins.rs1] = e->ins.rs1_val;
+    }
+    if (e->ins.has_src2 && e->ins.rs2)
+    {
+        s->reg[e->ins.rs2] = e->ins.rs2_val;
+    }
+#if FLEN > 0
+    if (e->ins.has_fp_src1)
+    {
+        s->fp_reg[e->ins.rs1] = e->ins.rs1_val;
+    }
+#endif
+}
+
+static void
+vector_unit_begin_batch(VectorUnit *u, uint64_t start)
+{
+    u->batch_start = start;
+    u->batch_lines = 0;
+    u->batch_first = 0;
+    u->batch_last = 0;
+}
+
+/* Stage latency for the lines of the batch sent to the memory hierarchy */
+static void
+vector_unit_end_batch(VectorUnit *u, RISCVCPUState *s, InstructionLatch *e)
+{
+    uint64_t now = s->simcpu->clock;
+    uint64_t base, issue;
+
+    base = u->batch_start
+           + s->simcpu->mem_hierarchy->page_walk_delay;
+    issue = (u->batch_lines + u->mem_lines_per_cycle - 1)
+            / u->mem_lines_per_cycle;
+    if (u->batch_lines)
+    {
+        if (u->lines == u->batch_lines)
+        {
+            u->first_done = base + u->batch_first;
+        }
+        u->last_done = max_u64(u->last_done, base + u->batch_last);
+    }
+    u->mem_free = base + issue;
+    e->max_clock_cycles = (int)(base - now) + (int)max_u64(issue, 1);
+}
+
+static void
+vector_unit_set_exception(InstructionLatch *e, int ret)
+{
+    e->ins.exception = TRUE;
+    e->ins.exception_cause = (ret == RVV_EXEC_ILLEGAL)
+                                 ? SIM_ILLEGAL_OPCODE_EXCEPTION
+                                 : SIM_MMU_EXCEPTION;
+}
+
+/* Results of an instruction whose functional execution is complete */
+static void
+vector_unit_complete(VectorUnit *u, RISCVCPUState *s, InstructionLatch *e)
+{
+    uint64_t now = s->simcpu->clock;
+
+    if (u->info.op_class == RVV_CLASS_LOAD)
+    {
+        if (!u->lines)
+        {
+            u->first_done = now + 1;
+            u->last_done = now + 1;
+        }
+        regs_set_ready(u, u->info.dst_regs, u->first_done, u->last_done);
+    }
+
+    if (e->ins.has_dest)
+    {
+        e->ins.buffer = s->reg[e->ins.rd];
+    }
+#if FLEN > 0
+    else if (e->ins.has_fp_dest)
+    {
+        e->ins.buffer = s->fp_reg[e->ins.rd];
+    }
+#endif
+    u->in_progress = FALSE;
+}
+
+static void
+vector_unit_exec_arith(VectorUnit *u, RISCVCPUState *s, InstructionLatch *e)
+{
+    const RVVInsnInfo *info = &u->info;
+    uint64_t now = s->simcpu->clock;
+    uint64_t beats, occupancy, start, src_last, first, last;
+    int lat = u->latency[info->op_class];
+
+    beats = ((uint64_t)info->elems * info->elem_bytes + u->lanes * 8 - 1)
+            / (u->lanes * 8);
+    beats = max_u64(beats, 1);
+    occupancy = beats;
+    if (info->op_class == RVV_CLASS_DIV || info->op_class == RVV_CLASS_FDIV)
+    {
+        occupancy = beats * lat;
+    }
+
+    start = start_cycle(u, info->src_regs, now, u->arith_free, &src_last);
+    if (src_last > start)
+    {
+        ++s->simcpu->stats[s->priv].vec_chained;
+    }
+    s->simcpu->stats[s->priv].vec_stall_cycles += start - now;
+    s->simcpu->stats[s->priv].vec_beats += occupancy;
+
+    first = start + lat;
+    last = max_u64(start + lat + occupancy - 1, src_last + lat);
+    u->arith_free = start + occupancy;
+    regs_set_ready(u, info->dst_regs, first, last);
+
+    /* The stage is held until the instruction enters the pipe, or until the
+     * result is complete if it is written to a scalar register */
+    if (info->scalar_dest)
+    {
+        e->max_clock_cycles = (int)max_u64(last - now, 1);
+    }
+    else
+    {
+        e->max_clock_cycles = (int)(start - now) + 1;
+    }
+}
+
+VectorUnit *
+vector_unit_init(const SimParams *p, int line_size)
+{
+    VectorUnit *u;
+
+    u = (VectorUnit *)calloc(1, sizeof(VectorUnit));
+    assert(u);
+    u->lanes = p->vector_lanes;
+    u->chaining = p->vector_chaining;
+    u->latency[RVV_CLASS_CFG] = 1;
+    u->latency[RVV_CLASS_ALU] = p->vector_alu_latency;
+    u->latency[RVV_CLASS_MUL] = p->vector_mul_latency;
+    u->latency[RVV_CLASS_DIV] = p->vector_div_latency;
+    u->latency[RVV_CLASS_FPU] = p->vector_fpu_latency;
+    u->latency[RVV_CLASS_FDIV] = p->vector_fpu_div_latency;
+    u->latency[RVV_CLASS_LOAD] = 1;
+    u->latency[RVV_CLASS_STORE] = 1;
+    u->mem_lines_per_cycle = p->vector_mem_lines_per_cycle;
+    u->line_bits = ctz32(line_size);
+    vector_unit_reset(u);
+    return u;
+}
+
+void
+vector_unit_reset(VectorUnit *u)
+{
+    memset(u->reg_first_ready, 0, sizeof(u->reg_first_ready));
+    memset(u->reg_last_ready, 0, sizeof(u->reg_last_ready));
+    u->arith_free = 0;
+    u->mem_free = 0;
+    u->in_progress = FALSE;
+}
+
+/* Executes the vector instruction in the latch and sets the number of cycles
+ * it holds the stage. A load or store accessing many lines may end its first
+ * batch here, the following ones are sent by vector_unit_resume(). */
+void
+vector_unit_exec(VectorUnit *u, RISCVCPUState *s, InstructionLatch *e)
+{
+    uint64_t now = s->simcpu->clock;
+    uint64_t src_last;
+    int ret;
+
+    u->s = s;
+    u->in_progress = FALSE;
+    u->lines = 0;
+    u->first_done = 0;
+    u->last_done = 0;
+    u->last_line = (target_ulong)-1;
+    u->last_write = FALSE;
+    vector_unit_begin_batch(u, 0);
+
+    write_scalar_operands(s, e);
+    ret = riscv_vector_exec(s, e->ins.binary, &u->info,
+                            vector_unit_mem_access, u);
+    if (ret == RVV_EXEC_ILLEGAL)
+    {
+        vector_unit_set_exception(e, ret);
+        return;
+    }
+
+    switch (u->info.op_class)
+    {
+        case RVV_CLASS_CFG:
+        {
+            e->max_clock_cycles = 1;
+            break;
+        }
+
+        case RVV_CLASS_LOAD:
+        case RVV_CLASS_STORE:
+        {
+            /* The lines were accessed relative to the start of the batch */
+            u->batch_start = start_cycle(u, u->info.src_regs, now, u->mem_free,
+                                         &src_last);
+            s->simcpu->stats[s->priv].vec_stall_cycles += u->batch_start - now;
+            vector_unit_end_batch(u, s, e);
+            break;
+        }
+
+        default:
+        {
+            if (ret == RVV_EXEC_OK)
+            {
+                vector_unit_exec_arith(u, s, e);
+            }
+            break;
+        }
+    }
+
+    if (ret == RVV_EXEC_FAULT)
+    {
+        vector_unit_set_exception(e, ret);
+    }
+    else if (ret == RVV_EXEC_PARTIAL)
+    {
+        u->in_progress = TRUE;
+    }
+    else
+    {
+        vector_unit_complete(u, s, e);
+    }
+}
+
+/* Called once the DRAM requests of a batch are drained. Sends the next batch
+ * of a load or store and returns TRUE, or returns FALSE if the instruction is
+ * complete. */
+int
+vector_unit_resume(VectorUnit *u, RISCVCPUState *s, InstructionLatch *e)
+{
+    MemoryHierarchy *m = s->simcpu->mem_hierarchy;
+    int ret;
+
+    if (!u->in_progress || e->ins.exception)
+    {
+        return FALSE;
+    }
+
+    m->backend_mem_access_queue.cur_idx = 0;
+    m->page_walk_delay = 0;
+    e->cache_lookup_complete_signal_sent = FALSE;
+    e->elasped_clock_cycles = 1;
+    vector_unit_begin_batch(u, s->simcpu->clock);
+
+    write_scalar_operands(s, e);
+    ret = riscv_vector_exec(s, e->ins.binary, NULL, vector_unit_mem_access, u);
+    vector_unit_end_batch(u, s, e);
+    if (ret == RVV_EXEC_FAULT)
+    {
+        u->in_progress = FALSE;
+        vector_unit_set_exception(e, ret);
+    }
+    else if (ret == RVV_EXEC_OK)
+    {
+        vector_unit_complete(u, s, e);
+    }
+    return TRUE;
+}
+
+void
+vector_unit_free(VectorUnit **u)
+{
+    free(*u);
+    *u = NULL;
+}
@@ -0,0 +1,97 @@
+/**
+ * Vector Unit
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _VECTOR_UNIT_H_
+#define _VECTOR_UNIT_H_
+
+#include "../../riscv_vector.h"
+#include "../riscv_sim_typedefs.h"
+#include "../utils/cpu_latches.h"
+#include "../utils/sim_params.h"
+
+struct RISCVCPUState;
+
+/* Timing model of the vector unit of a hart. Vector instructions are
+ * executed in the memory stage of the in-order core, and at the head of the
+ * ROB from the LSQ on the out-of-order core, so they never execute
+ * speculatively. The functional execution is done by riscv_vector_exec(); the
+ * unit only computes when the results become available.
+ *
+ * The unit has an arithmetic pipe and a memory pipe, each working on one
+ * instruction at a time. An arithmetic instruction processes lanes * 8 bytes
+ * of elements per cycle (a beat), and its first result is available after
+ * the latency of its class. Divisions are not pipelined, a beat occupies the
+ * pipe for the whole latency. The first and the last cycle at which each
+ * vector register is written are tracked: with chaining, an instruction
+ * starts as soon as the first elements of its sources are available,
+ * otherwise it waits for its sources to be complete.
+ *
+ * Loads and stores send one request per cache line to the memory hierarchy,
+ * mem_lines_per_cycle lines per cycle. The elements are accessed in batches,
+ * a batch ends when the backend memory access queue is half full; the next
+ * batch is sent once the DRAM requests of the previous one are drained. The
+ * pipeline stage is held for the issue of the lines only, the consumers of
+ * a load wait on the vector register scoreboard. */
+typedef struct VectorUnit
+{
+    int lanes;
+    int chaining;
+    int latency[RVV_NUM_CLASSES];
+    int mem_lines_per_cycle;
+    int line_bits;
+
+    /* Cycles at which the first and the last elements of a vector register
+     * are written */
+    uint64_t reg_first_ready[32];
+    uint64_t reg_last_ready[32];
+
+    /* Cycles at which the pipes accept the next instruction */
+    uint64_t arith_free;
+    uint64_t mem_free;
+
+    /* Load or store in progress */
+    struct RISCVCPUState *s;
+    RVVInsnInfo info;
+    int in_progress;
+    uint64_t batch_start;     /* Cycle at which the current batch starts */
+    uint64_t lines;           /* Lines accessed by the instruction */
+    uint64_t batch_lines;     /* Lines accessed in the current batch */
+    uint64_t batch_first;     /* Return of the first and the last line of */
+    uint64_t batch_last;      /* the batch, relative to batch_start */
+    uint64_t first_done;      /* Cycle at which the first line returns */
+    uint64_t last_done;       /* Cycle at which the last line returns */
+    target_ulong last_line;   /* Last line accessed, -1 if none */
+    int last_write;
+} VectorUnit;
+
+VectorUnit *vector_unit_init(const SimParams *p, int line_size);
+void vector_unit_reset(VectorUnit *u);
+void vector_unit_exec(VectorUnit *u, struct RISCVCPUState *s,
+                      InstructionLatch *e);
+int vector_unit_resume(VectorUnit *u, struct RISCVCPUState *s,
+                       InstructionLatch *e);
+void vector_unit_free(VectorUnit **u);
+#endif
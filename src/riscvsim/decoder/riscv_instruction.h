@@ -91,9 +91,13 @@ typedef struct RVInstruction
     int is_atomic_load;
     int is_atomic_store;
     int is_atomic_operate;
+    int sc_failed; /* Set by a failed SC, which does not write to memory */
+    int lr_yielded; /* Set by a LR which did not reserve, see
+                       riscv_sim_cpu_reservation_held() */
 
     int is_load;
     int is_store;
+    int is_vector; /* Executed by the vector unit in the memory stage */
     int bytes_to_rw;
     int is_unsigned;
     target_ulong mem_addr;
@@ -120,6 +124,14 @@ typedef struct RVInstruction
     /* for updating performance counters */
     int type;
     int data_class;
+
+    /* Set when the instruction preceding this one was fused into it, see
+     * FUSION_* patterns. fused_pc and fused_type belong to the preceding
+     * instruction, fused_imm is its shift amount for FUSION_SLLI_SRLI */
+    int fusion;
+    int fused_type;
+    int32_t fused_imm;
+    target_ulong fused_pc;
 } RVInstruction;
 
 /* Decode RISC-V instruction in binary format and fill the decoded information
@@ -127,4 +139,5 @@ typedef struct RVInstruction
 void decode_riscv_binary(RVInstruction *, uint32_t);
 void generate_riscv_instruction_string(RVInstruction *i);
 void execute_riscv_instruction(RVInstruction *i, uint32_t *fflags);
+uint64_t execute_fused_head(const RVInstruction *i);
 #endif /* End RVInstruction */
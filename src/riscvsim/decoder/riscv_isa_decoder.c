@@ -694,6 +694,77 @@ chk_op_exceptions(RVInstruction *i)
     return 0;
 }
 
+/* Vector instructions are executed as a whole by the vector unit, only the
+ * scalar operands are decoded here so that the pipeline tracks the
+ * dependences on the integer and floating point registers */
+static void
+decode_vector_insn(RVInstruction *i)
+{
+    uint32_t insn = i->binary;
+
+    i->is_vector = TRUE;
+    i->fu_type = FU_ALU;
+    i->type = INS_TYPE_VECTOR;
+
+    if (i->major_opcode != VECTOR_MASK)
+    {
+        /* Loads and stores: base address in rs1, stride in rs2 */
+        i->has_src1 = TRUE;
+        if (((insn >> 26) & 3) == 2)
+        {
+            i->has_src2 = TRUE;
+        }
+        return;
+    }
+
+    switch (i->funct3)
+    {
+        case 0x4: /* OPIVX */
+        case 0x6: /* OPMVX */
+        {
+            i->has_src1 = TRUE;
+            break;
+        }
+        case 0x5: /* OPFVF */
+        {
+            i->has_fp_src1 = TRUE;
+            break;
+        }
+        case 0x2: /* OPMVV */
+        {
+            /* vmv.x.s, vcpop.m, vfirst.m */
+            if ((insn >> 26) == 0x10)
+            {
+                i->has_dest = TRUE;
+            }
+            break;
+        }
+        case 0x1: /* OPFVV */
+        {
+            /* vfmv.f.s */
+            if ((insn >> 26) == 0x10)
+            {
+                i->has_fp_dest = TRUE;
+                i->set_fs = TRUE;
+            }
+            break;
+        }
+        case 0x7: /* vsetvli, vsetivli, vsetvl */
+        {
+            i->has_dest = TRUE;
+            if ((insn >> 30) != 3)
+            {
+                i->has_src1 = TRUE;
+            }
+            if ((insn >> 25) == 0x40)
+            {
+                i->has_src2 = TRUE;
+            }
+            break;
+        }
+    }
+}
+
 /**
  * @param  Encoded 32-bit instruction binary
  * @return Decoded RVInstruction
@@ -988,6 +1059,11 @@ decode_riscv_binary(struct RVInstruction *ins, uint32_t insn)
             }
             case FLOAD_MASK:
             {
+                if (IS_VECTOR_MEM_WIDTH(ins->funct3))
+                {
+                    decode_vector_insn(ins);
+                    break;
+                }
                 if (ins->current_fs == 0)
                 {
                     goto exception;
@@ -1019,6 +1095,11 @@ decode_riscv_binary(struct RVInstruction *ins, uint32_t insn)
             }
             case FSTORE_MASK:
             {
+                if (IS_VECTOR_MEM_WIDTH(ins->funct3))
+                {
+                    decode_vector_insn(ins);
+                    break;
+                }
                 if (ins->current_fs == 0)
                 {
                     goto exception;
@@ -1137,6 +1218,11 @@ decode_riscv_binary(struct RVInstruction *ins, uint32_t insn)
                 }
                 break;
             }
+            case VECTOR_MASK:
+            {
+                decode_vector_insn(ins);
+                break;
+            }
             default:
             {
                 goto exception;
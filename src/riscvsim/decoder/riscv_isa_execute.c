@@ -705,6 +705,40 @@ execute_ext_c_path(RVInstruction *i)
     }
 }
 
+/* Result of the first instruction of a fused pair, which is the first
+ * source operand of the second one */
+uint64_t
+execute_fused_head(const RVInstruction *i)
+{
+    switch (i->fusion)
+    {
+        case FUSION_SLLI_SRLI:
+        {
+            return i->rs1_val << i->fused_imm;
+        }
+        case FUSION_ADD_LOAD:
+        {
+            return i->rs1_val + i->rs2_val;
+        }
+    }
+
+    /* lui and auipc results are computed when fusing */
+    return i->rs1_val;
+}
+
+static void
+execute_fused_pair(RVInstruction *i, uint32_t *fflags)
+{
+    uint64_t rs1_val = i->rs1_val;
+    int fusion = i->fusion;
+
+    i->rs1_val = execute_fused_head(i);
+    i->fusion = FUSION_NONE;
+    execute_riscv_instruction(i, fflags);
+    i->fusion = fusion;
+    i->rs1_val = rs1_val;
+}
+
 void
 execute_riscv_instruction(RVInstruction *i, uint32_t *fflags)
 {
@@ -717,6 +751,19 @@ execute_riscv_instruction(RVInstruction *i, uint32_t *fflags)
         return;
     }
 
+    if (i->fusion)
+    {
+        execute_fused_pair(i, fflags);
+        return;
+    }
+
+    /* Vector instructions are executed by the vector unit in the memory
+     * stage */
+    if (i->is_vector)
+    {
+        return;
+    }
+
     /* For 32-bit integer and floating point instructions */
     switch (i->major_opcode)
     {
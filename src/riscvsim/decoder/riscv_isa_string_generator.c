@@ -1025,6 +1025,34 @@ set_fence_str(RVInstruction *i)
     }
 }
 
+/* Vector instructions are shown by their class and vector registers only */
+static void
+set_vector_str(RVInstruction *i)
+{
+    uint32_t vd = (i->binary >> 7) & 0x1f;
+    uint32_t vs2 = (i->binary >> 20) & 0x1f;
+
+    if (i->major_opcode == FLOAD_MASK)
+    {
+        snprintf(i->str, RISCV_INS_STR_MAX_LENGTH, "vload v%d,(%s)", vd,
+                 reg[i->rs1]);
+    }
+    else if (i->major_opcode == FSTORE_MASK)
+    {
+        snprintf(i->str, RISCV_INS_STR_MAX_LENGTH, "vstore v%d,(%s)", vd,
+                 reg[i->rs1]);
+    }
+    else if (i->funct3 == 7)
+    {
+        snprintf(i->str, RISCV_INS_STR_MAX_LENGTH, "vsetvl %s", reg[i->rd]);
+    }
+    else
+    {
+        snprintf(i->str, RISCV_INS_STR_MAX_LENGTH, "vop.%d v%d,v%d",
+                 i->funct3, vd, vs2);
+    }
+}
+
 void
 generate_riscv_instruction_string(RVInstruction *i)
 {
@@ -1037,6 +1065,12 @@ generate_riscv_instruction_string(RVInstruction *i)
         return;
     }
 
+    if (i->is_vector)
+    {
+        set_vector_str(i);
+        return;
+    }
+
     /* For 32-bit integer and floating point instructions */
     switch (i->major_opcode)
     {
@@ -0,0 +1,396 @@
+/**
+ * Analytical DRAM model
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../riscv_sim_macros.h"
+#include "../utils/sim_log.h"
+#include "analytical_dram.h"
+
+static const char *addr_field_str[NUM_ADDR_FIELDS] = {"ro", "ra", "ba", "ch", "co"};
+
+/* Converts DRAM clock cycles into CPU clock cycles, rounding up */
+static int
+dram_to_cpu_cycles(int dram_cycles, int dram_freq_mhz, int cpu_freq_mhz)
+{
+    return (int)(((uint64_t)dram_cycles * cpu_freq_mhz + dram_freq_mhz - 1)
+                 / dram_freq_mhz);
+}
+
+static inline uint64_t
+max_u64(uint64_t a, uint64_t b)
+{
+    return (a > b) ? a : b;
+}
+
+static int
+log2_int(uint64_t x)
+{
+    int bits = 0;
+
+    while (x > 1)
+    {
+        x >>= 1;
+        ++bits;
+    }
+
+    return bits;
+}
+
+/* Address mapping is specified as a string of 2 letter fields ordered from the
+ * most significant to the least significant bits of the physical address,
+ * e.g. "rorabachco" means row:rank:bank:channel:column. Bits below the column
+ * field address the bytes within a burst. */
+static void
+setup_address_mapping(AnalyticalDram *a, const AnalyticalDramParams *ap,
+                      int line_size, uint64_t ram_size)
+{
+    int i, j;
+    int shift;
+    int order[NUM_ADDR_FIELDS];
+    int used_bits = 0;
+    const char *mapping = ap->address_mapping;
+
+    sim_assert((strlen(mapping) == (2 * NUM_ADDR_FIELDS)),
+               "error: %s at line %d in %s(): %s", __FILE__, __LINE__,
+               __func__, "analytical dram address_mapping must specify each "
+                         "of ro, ra, ba, ch and co fields exactly once");
+
+    for (i = 0; i < NUM_ADDR_FIELDS; ++i)
+    {
+        order[i] = -1;
+        for (j = 0; j < NUM_ADDR_FIELDS; ++j)
+        {
+            if (strncmp(&mapping[2 * i], addr_field_str[j], 2) == 0)
+            {
+                order[i] = j;
+            }
+        }
+
+        sim_assert((order[i] != -1), "error: %s at line %d in %s(): %s",
+                   __FILE__, __LINE__, __func__,
+                   "analytical dram address_mapping has invalid field");
+
+        for (j = 0; j < i; ++j)
+        {
+            sim_assert((order[i] != order[j]),
+                       "error: %s at line %d in %s(): %s", __FILE__, __LINE__,
+                       __func__, "analytical dram address_mapping has "
+                                 "repeated field");
+        }
+    }
+
+    a->field_bits[ADDR_FIELD_CHANNEL] = log2_int(a->num_channels);
+    a->field_bits[ADDR_FIELD_RANK] = log2_int(a->num_ranks);
+    a->field_bits[ADDR_FIELD_BANK] = log2_int(a->num_banks);
+    a->field_bits[ADDR_FIELD_COLUMN] = log2_int(ap->row_buffer_size / line_size);
+
+    for (i = ADDR_FIELD_RANK; i < NUM_ADDR_FIELDS; ++i)
+    {
+        used_bits += a->field_bits[i];
+    }
+
+    /* Row field covers the rest of the guest RAM */
+    a->field_bits[ADDR_FIELD_ROW]
+        = max_int(1, log2_int(ram_size) - log2_int(line_size) - used_bits);
+
+    /* Assign the bit positions starting from the least significant field */
+    shift = log2_int(line_size);
+    for (i = NUM_ADDR_FIELDS - 1; i >= 0; --i)
+    {
+        a->field_shift[order[i]] = shift;
+        shift += a->field_bits[order[i]];
+    }
+}
+
+static inline uint64_t
+get_addr_field(const AnalyticalDram *a, target_ulong addr,
+               AnalyticalDramAddrField field)
+{
+    return (addr >> a->field_shift[field])
+           & ((1ULL << a->field_bits[field]) - 1);
+}
+
+static void
+analytical_dram_log_config(const AnalyticalDram *a,
+                           const AnalyticalDramParams *ap)
+{
+    int i;
+
+    sim_log_param_to_file(sim_log, "%s: %d", "channels", a->num_channels);
+    sim_log_param_to_file(sim_log, "%s: %d", "ranks", a->num_ranks);
+    sim_log_param_to_file(sim_log, "%s: %d", "banks", a->num_banks);
+    sim_log_param_to_file(sim_log, "%s: %d bytes", "row_buffer_size", ap->row_buffer_size);
+    sim_log_param_to_file(sim_log, "%s: %d bytes", "bus_width", ap->bus_width);
+    sim_log_param_to_file(sim_log, "%s: %s", "page_policy", dram_page_policy_str[a->page_policy]);
+    sim_log_param_to_file(sim_log, "%s: %s", "address_mapping", ap->address_mapping);
+    for (i = 0; i < NUM_ADDR_FIELDS; ++i)
+    {
+        sim_log_param_to_file(sim_log, "%s: bits %d to %d", addr_field_str[i],
+                              a->field_shift[i],
+                              a->field_shift[i] + a->field_bits[i] - 1);
+    }
+    sim_log_param_to_file(sim_log, "%s: %d MHz", "freq_mhz", ap->freq_mhz);
+    sim_log_param_to_file(sim_log, "%s: %d cpu cycle(s)", "tRCD", a->t_rcd);
+    sim_log_param_to_file(sim_log, "%s: %d cpu cycle(s)", "tCAS", a->t_cas);
+    sim_log_param_to_file(sim_log, "%s: %d cpu cycle(s)", "tRP", a->t_rp);
+    sim_log_param_to_file(sim_log, "%s: %d cpu cycle(s)", "tRAS", a->t_ras);
+    sim_log_param_to_file(sim_log, "%s: %d cpu cycle(s)", "tBURST", a->t_burst);
+    sim_log_param_to_file(sim_log, "%s: %d cpu cycle(s)", "tREFI", a->t_refi);
+    sim_log_param_to_file(sim_log, "%s: %d cpu cycle(s)", "tRFC", a->t_rfc);
+}
+
+AnalyticalDram *
+analytical_dram_create(const SimParams *p, int line_size)
+{
+    AnalyticalDram *a;
+    const AnalyticalDramParams *ap = &p->analytical_dram;
+
+    a = (AnalyticalDram *)calloc(1, sizeof(AnalyticalDram));
+    assert(a);
+
+    a->num_channels = ap->num_channels;
+    a->num_ranks = ap->num_ranks;
+    a->num_banks = ap->num_banks;
+    a->page_policy = ap->page_policy;
+
+    a->t_rcd = dram_to_cpu_cycles(ap->t_rcd, ap->freq_mhz, p->cpu_freq_mhz);
+    a->t_cas = dram_to_cpu_cycles(ap->t_cas, ap->freq_mhz, p->cpu_freq_mhz);
+    a->t_rp = dram_to_cpu_cycles(ap->t_rp, ap->freq_mhz, p->cpu_freq_mhz);
+    a->t_ras = dram_to_cpu_cycles(ap->t_ras, ap->freq_mhz, p->cpu_freq_mhz);
+    a->t_refi = dram_to_cpu_cycles(ap->t_refi, ap->freq_mhz, p->cpu_freq_mhz);
+    a->t_rfc = dram_to_cpu_cycles(ap->t_rfc, ap->freq_mhz, p->cpu_freq_mhz);
+
+    /* Double data rate bus transfers bus_width bytes on both the clock
+     * edges */
+    a->t_burst = dram_to_cpu_cycles(
+        max_int(1, line_size / (2 * ap->bus_width)), ap->freq_mhz,
+        p->cpu_freq_mhz);
+
+    setup_address_mapping(a, ap, line_size,
+                          (uint64_t)p->guest_ram_size * 1024 * 1024);
+
+    a->banks = (AnalyticalDramBank *)calloc(
+        a->num_channels * a->num_ranks * a->num_banks,
+        sizeof(AnalyticalDramBank));
+    assert(a->banks);
+
+    a->bus_ready_cycle = (uint64_t *)calloc(a->num_channels, sizeof(uint64_t));
+    assert(a->bus_ready_cycle);
+
+    analytical_dram_log_config(a, ap);
+    return a;
+}
+
+/* Returns the start of the latest refresh of the given rank at or before
+ * cycle, or 0 if the rank was not yet refreshed. Refreshes of the ranks are
+ * staggered uniformly within tREFI. */
+static uint64_t
+get_last_refresh_cycle(const AnalyticalDram *a, int rank, uint64_t cycle)
+{
+    uint64_t phase = ((uint64_t)rank * a->t_refi) / a->num_ranks;
+
+    if ((0 == a->t_refi) || (cycle < phase))
+    {
+        return 0;
+    }
+
+    return phase + (((cycle - phase) / a->t_refi) * a->t_refi);
+}
+
+int
+analytical_dram_get_latency(AnalyticalDram *a, target_ulong addr,
+                            MemAccessType type, uint64_t cur_cycle)
+{
+    int channel, rank;
+    uint64_t row;
+    uint64_t start, refresh, col_cycle, data_cycle, done, precharge;
+    AnalyticalDramBank *bank;
+
+    channel = get_addr_field(a, addr, ADDR_FIELD_CHANNEL);
+    rank = get_addr_field(a, addr, ADDR_FIELD_RANK);
+    row = get_addr_field(a, addr, ADDR_FIELD_ROW);
+    bank = &a->banks[(((channel * a->num_ranks) + rank) * a->num_banks)
+                     + get_addr_field(a, addr, ADDR_FIELD_BANK)];
+
+    start = max_u64(cur_cycle, bank->ready_cycle);
+
+    /* Wait for the refresh in progress, refresh also closes the rows of all
+     * the banks in the rank */
+    refresh = get_last_refresh_cycle(a, rank, start);
+    if (refresh && (start < (refresh + a->t_rfc)))
+    {
+        start = refresh + a->t_rfc;
+        a->stats.refresh_stalls++;
+    }
+
+    if (bank->row_open && (bank->activate_cycle < refresh))
+    {
+        bank->row_open = FALSE;
+    }
+
+    if (bank->row_open && (bank->open_row == row))
+    {
+        /* Row hit: column access only */
+        col_cycle = start;
+        a->stats.row_hits++;
+    }
+    else if (!bank->row_open)
+    {
+        /* Row empty: activate and column access */
+        bank->activate_cycle = start;
+        col_cycle = start + a->t_rcd;
+        a->stats.row_empty++;
+    }
+    else
+    {
+        /* Row conflict: precharge the open row, which can not happen before
+         * tRAS elapses since its activation, then activate and column
+         * access */
+        precharge = max_u64(start, bank->activate_cycle + a->t_ras);
+        bank->activate_cycle = precharge + a->t_rp;
+        col_cycle = bank->activate_cycle + a->t_rcd;
+        a->stats.row_conflicts++;
+    }
+
+    /* Data transfer occupies the channel data bus for tBURST */
+    data_cycle = col_cycle + a->t_cas;
+    if (data_cycle < a->bus_ready_cycle[channel])
+    {
+        data_cycle = a->bus_ready_cycle[channel];
+        a->stats.bus_stalls++;
+    }
+    done = data_cycle + a->t_burst;
+    a->bus_ready_cycle[channel] = done;
+
+    switch (a->page_policy)
+    {
+        case DRAM_PAGE_POLICY_OPEN:
+        {
+            /* Keep the row open for the following accesses */
+            bank->row_open = TRUE;
+            bank->open_row = row;
+            bank->ready_cycle = col_cycle + a->t_burst;
+            break;
+        }
+        case DRAM_PAGE_POLICY_CLOSED:
+        {
+            /* Precharge the row right after the access */
+            bank->row_open = FALSE;
+            bank->ready_cycle
+                = max_u64(done, bank->activate_cycle + a->t_ras) + a->t_rp;
+            break;
+        }
+    }
+
+    if (type == MEM_ACCESS_READ)
+    {
+        a->stats.reads++;
+    }
+    else
+    {
+        a->stats.writes++;
+    }
+    a->stats.total_latency += (done - cur_cycle);
+
+    return max_int(1, (int)(done - cur_cycle));
+}
+
+void
+analytical_dram_reset(AnalyticalDram *a)
+{
+    memset((void *)a->banks, 0, a->num_channels * a->num_ranks * a->num_banks
+                                    * sizeof(AnalyticalDramBank));
+    memset((void *)a->bus_ready_cycle, 0, a->num_channels * sizeof(uint64_t));
+    memset((void *)&a->stats, 0, sizeof(AnalyticalDramStats));
+}
+
+void
+analytical_dram_register_stats(const AnalyticalDram *a, SimRegistry *r,
+                               const char *module)
+{
+    sim_registry_add_counter(r, module, "row_hits", &a->stats.row_hits);
+    sim_registry_add_counter(r, module, "row_empty", &a->stats.row_empty);
+    sim_registry_add_counter(r, module, "row_conflicts",
+                             &a->stats.row_conflicts);
+    sim_registry_add_counter(r, module, "refresh_stalls",
+                             &a->stats.refresh_stalls);
+    sim_registry_add_counter(r, module, "bus_stalls", &a->stats.bus_stalls);
+}
+
+void
+analytical_dram_print_stats(const AnalyticalDram *a, const char *pathname,
+                            const char *timestamp)
+{
+    FILE *fp;
+    char *filename;
+    char buffer[1024];
+    uint64_t accesses = a->stats.reads + a->stats.writes;
+
+    /* Generate stats filename with format: analytical_dram_timestamp.csv */
+    sprintf(buffer, "analytical_dram_%s.csv", timestamp);
+
+    filename = (char *)malloc(strlen(pathname) + strlen(buffer) + 2);
+    assert(filename);
+
+    strcpy(filename, pathname);
+    strcat(filename, "/");
+    strcat(filename, buffer);
+
+    fp = fopen(filename, "w");
+    assert(fp);
+
+    fprintf(fp, "%s,%s\n", "stat-name", "value");
+    fprintf(fp, "%s,%lu\n", "reads", a->stats.reads);
+    fprintf(fp, "%s,%lu\n", "writes", a->stats.writes);
+    fprintf(fp, "%s,%lu\n", "row_hits", a->stats.row_hits);
+    fprintf(fp, "%s,%lu\n", "row_empty", a->stats.row_empty);
+    fprintf(fp, "%s,%lu\n", "row_conflicts", a->stats.row_conflicts);
+    fprintf(fp, "%s,%lu\n", "refresh_stalls", a->stats.refresh_stalls);
+    fprintf(fp, "%s,%lu\n", "bus_stalls", a->stats.bus_stalls);
+    fprintf(fp, "%s,%lu\n", "total_latency_cycles", a->stats.total_latency);
+    fprintf(fp, "%s,%.2lf\n", "avg_latency_cycles",
+            accesses ? ((double)a->stats.total_latency / (double)accesses)
+                     : 0.0);
+
+    fclose(fp);
+    sim_log_event(sim_log, "Saved analytical dram statistics in %s", filename);
+    free(filename);
+}
+
+void
+analytical_dram_free(AnalyticalDram **a)
+{
+    free((*a)->banks);
+    (*a)->banks = NULL;
+    free((*a)->bus_ready_cycle);
+    (*a)->bus_ready_cycle = NULL;
+    free(*a);
+    *a = NULL;
+}
@@ -0,0 +1,119 @@
+/**
+ * Analytical DRAM model
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _ANALYTICAL_DRAM_H_
+#define _ANALYTICAL_DRAM_H_
+
+#include "../../cutils.h"
+#include "../riscv_sim_typedefs.h"
+#include "../utils/sim_params.h"
+#include "../utils/sim_registry.h"
+#include "memory_controller_utils.h"
+
+/* Fields of the physical address used by the address mapping */
+typedef enum AnalyticalDramAddrField {
+    ADDR_FIELD_ROW = 0x0,
+    ADDR_FIELD_RANK = 0x1,
+    ADDR_FIELD_BANK = 0x2,
+    ADDR_FIELD_CHANNEL = 0x3,
+    ADDR_FIELD_COLUMN = 0x4,
+    NUM_ADDR_FIELDS = 0x5,
+} AnalyticalDramAddrField;
+
+typedef struct AnalyticalDramBank
+{
+    int row_open;
+    uint64_t open_row;
+
+    /* CPU cycle at which the last row was activated */
+    uint64_t activate_cycle;
+
+    /* CPU cycle from which the bank can accept the next command */
+    uint64_t ready_cycle;
+} AnalyticalDramBank;
+
+typedef struct AnalyticalDramStats
+{
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t row_hits;
+    uint64_t row_empty;
+    uint64_t row_conflicts;
+    uint64_t refresh_stalls;
+    uint64_t bus_stalls;
+    uint64_t total_latency;
+} AnalyticalDramStats;
+
+/* Analytical DRAM model computes the latency of every request from the state
+ * of the target bank and channel, without simulating individual DRAM
+ * commands. Each bank keeps its open row, so the latency of a request is:
+ * - row hit: tCAS
+ * - row empty (bank precharged): tRCD + tCAS
+ * - row conflict: tRP + tRCD + tCAS, where the precharge also waits for tRAS
+ *   after the previous activate
+ * followed by tBURST on the channel data bus, which is shared by all the
+ * ranks and banks of a channel. With closed page policy, the row is
+ * precharged right after the access, which costs tRP before the next
+ * access to the bank. Every rank is refreshed periodically every tREFI, which
+ * blocks the rank for tRFC and closes all its rows.
+ *
+ * All the timings are converted from DRAM clock cycles to CPU cycles at
+ * initialization. */
+typedef struct AnalyticalDram
+{
+    int num_channels;
+    int num_ranks;
+    int num_banks;
+    int page_policy;
+
+    /* Bit position and width of every field in the physical address */
+    int field_shift[NUM_ADDR_FIELDS];
+    int field_bits[NUM_ADDR_FIELDS];
+
+    /* Timings in CPU cycles */
+    int t_rcd;
+    int t_cas;
+    int t_rp;
+    int t_ras;
+    int t_burst;
+    int t_refi;
+    int t_rfc;
+
+    AnalyticalDramBank *banks;
+    uint64_t *bus_ready_cycle; /* One per channel */
+    AnalyticalDramStats stats;
+} AnalyticalDram;
+
+AnalyticalDram *analytical_dram_create(const SimParams *p, int line_size);
+int analytical_dram_get_latency(AnalyticalDram *a, target_ulong addr,
+                                MemAccessType type, uint64_t cur_cycle);
+void analytical_dram_reset(AnalyticalDram *a);
+void analytical_dram_register_stats(const AnalyticalDram *a, SimRegistry *r,
+                                    const char *module);
+void analytical_dram_print_stats(const AnalyticalDram *a, const char *pathname,
+                                 const char *timestamp);
+void analytical_dram_free(AnalyticalDram **a);
+#endif /* _ANALYTICAL_DRAM_H_ */
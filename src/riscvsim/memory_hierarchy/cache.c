@@ -35,11 +35,411 @@
 
 #include "../utils/sim_log.h"
 #include "cache.h"
+#include "coherence.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (BIT_SIZE == 64)
+#include <immintrin.h>
+#define CACHE_SIMD_TAG_MATCH
+#endif
+
+/* Tags of every set are padded to a multiple of this many entries, so that the
+ * vectorized tag match never reads past the set */
+#define CACHE_TAG_VECTOR_WIDTH 4
+
+/* Signature passed to the eviction policy on a line fill. As the cache model
+ * does not know the PC of the access, signature based policies (SHiP) use the
+ * 16KB memory region of the line instead. */
+#define CACHE_EVICT_SIGNATURE(paddr) ((uint64_t)(paddr) >> 14)
+
+static inline target_ulong *
+cache_set_tags(const Cache *c, int set)
+{
+    return c->tags + (set * c->tag_stride);
+}
+
+static inline int
+cache_blk_valid(const Cache *c, int set, int way)
+{
+    return GET_BIT(c->valid[(set * c->mask_words) + (way / 64)], way % 64);
+}
+
+static inline int
+cache_blk_dirty(const Cache *c, int set, int way)
+{
+    return GET_BIT(c->dirty[(set * c->mask_words) + (way / 64)], way % 64);
+}
+
+static inline void
+cache_blk_fill(const Cache *c, int set, int way, target_ulong tag)
+{
+    cache_set_tags(c, set)[way] = tag;
+    SET_BIT(c->valid[(set * c->mask_words) + (way / 64)], way % 64);
+    c->dirty[(set * c->mask_words) + (way / 64)] &= ~(1ULL << (way % 64));
+}
+
+static inline void
+cache_blk_set_dirty(const Cache *c, int set, int way)
+{
+    SET_BIT(c->dirty[(set * c->mask_words) + (way / 64)], way % 64);
+}
+
+static inline void
+cache_blk_clear_dirty(const Cache *c, int set, int way)
+{
+    c->dirty[(set * c->mask_words) + (way / 64)] &= ~(1ULL << (way % 64));
+}
+
+static inline void
+cache_blk_invalidate(const Cache *c, int set, int way)
+{
+    c->valid[(set * c->mask_words) + (way / 64)] &= ~(1ULL << (way % 64));
+    c->dirty[(set * c->mask_words) + (way / 64)] &= ~(1ULL << (way % 64));
+}
+
+/* Returns the way holding a valid line with the given tag, -1 otherwise */
+static int
+find_way_scalar(const Cache *c, int set, target_ulong tag)
+{
+    int i;
+    const target_ulong *tags = cache_set_tags(c, set);
+
+    for (i = 0; i < c->num_ways; ++i)
+    {
+        if ((tags[i] == tag) && cache_blk_valid(c, set, i))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+#ifdef CACHE_SIMD_TAG_MATCH
+/* Compares 2 tags per instruction */
+__attribute__((target("sse4.1"))) static int
+find_way_sse41(const Cache *c, int set, target_ulong tag)
+{
+    int i;
+    uint64_t match;
+    const target_ulong *tags = cache_set_tags(c, set);
+    const uint64_t *valid = &c->valid[set * c->mask_words];
+    __m128i key = _mm_set1_epi64x((long long)tag);
+
+    for (i = 0; i < c->num_ways; i += 2)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)&tags[i]);
+        match = (uint64_t)_mm_movemask_pd(
+            _mm_castsi128_pd(_mm_cmpeq_epi64(v, key)));
+        match &= (valid[i / 64] >> (i % 64)) & 0x3;
+        if (match)
+        {
+            return i + __builtin_ctzll(match);
+        }
+    }
+
+    return -1;
+}
+
+/* Compares 4 tags per instruction */
+__attribute__((target("avx2"))) static int
+find_way_avx2(const Cache *c, int set, target_ulong tag)
+{
+    int i;
+    uint64_t match;
+    const target_ulong *tags = cache_set_tags(c, set);
+    const uint64_t *valid = &c->valid[set * c->mask_words];
+    __m256i key = _mm256_set1_epi64x((long long)tag);
+
+    for (i = 0; i < c->num_ways; i += 4)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)&tags[i]);
+        match = (uint64_t)_mm256_movemask_pd(
+            _mm256_castsi256_pd(_mm256_cmpeq_epi64(v, key)));
+        match &= (valid[i / 64] >> (i % 64)) & 0xf;
+        if (match)
+        {
+            return i + __builtin_ctzll(match);
+        }
+    }
+
+    return -1;
+}
+#endif
+
+/* Select the fastest tag match routine supported by the host */
+static PFN_FIND_WAY
+get_find_way_handler(const char **name)
+{
+#ifdef CACHE_SIMD_TAG_MATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        *name = "avx2";
+        return &find_way_avx2;
+    }
+
+    if (__builtin_cpu_supports("sse4.1"))
+    {
+        *name = "sse4.1";
+        return &find_way_sse41;
+    }
+#endif
+
+    *name = "scalar";
+    return &find_way_scalar;
+}
+
+static inline uint32_t
+cache_get_set(const Cache *c, target_ulong paddr)
+{
+    return (paddr >> c->word_bits) & ((1 << c->set_bits) - 1);
+}
+
+static inline int
+cache_line_size(const Cache *c)
+{
+    return WORD_SIZE * c->max_words_per_blk;
+}
+
+/* Returns an invalid way in the set if present, otherwise the victim selected
+ * by the eviction policy. Invalid ways appear after back-invalidations and
+ * exclusive fills. */
+static int
+cache_select_victim(const Cache *c, int set)
+{
+    int i;
+    int way;
+    const uint64_t *valid = &c->valid[set * c->mask_words];
+
+    for (i = 0; i < c->mask_words; ++i)
+    {
+        if (~valid[i])
+        {
+            way = (i * 64) + __builtin_ctzll(~valid[i]);
+            if (way < c->num_ways)
+            {
+                return way;
+            }
+            break;
+        }
+    }
+
+    return c->evict_policy->evict(c->evict_policy, set);
+}
+
+/* Returns TRUE if the line must be written back on eviction */
+static inline int
+cache_blk_needs_writeback(const Cache *c, int set, int way)
+{
+    /* Write-through caches set the dirty bit as well, but their contents are
+     * already present in the next level */
+    return (c->cache_write_policy == WriteBack) && cache_blk_dirty(c, set, way);
+}
+
+/* Cache which receives the lines evicted from the cache c, if any */
+static const Cache *
+get_victim_fill_target(const Cache *c)
+{
+    if (NULL != c->victim_cache)
+    {
+        return c->victim_cache;
+    }
+
+    if ((NULL != c->next_level_cache)
+        && (c->next_level_cache->inclusion_policy
+            == CACHE_INCLUSION_EXCLUSIVE))
+    {
+        return c->next_level_cache;
+    }
+
+    return NULL;
+}
+
+static int
+write_line_internal(const Cache *c, target_ulong paddr, void *p_mem_access_info,
+                    int priv)
+{
+    /* Write the complete line to next-level cache if present, otherwise to
+     * memory */
+    if (NULL != c->next_level_cache)
+    {
+        return cache_write(c->next_level_cache, paddr, cache_line_size(c),
+                           p_mem_access_info, priv);
+    }
+
+    return mem_controller_create_mem_request(c->mem_controller, paddr,
+                                             cache_line_size(c),
+                                             MEM_ACCESS_WRITE,
+                                             p_mem_access_info);
+}
+
+/* Invalidates the lines in the address range [paddr, paddr + bytes) from the
+ * cache c and all the caches above it. Sets *pdirty if any of the invalidated
+ * lines is dirty. Returns the number of lines invalidated. */
+static int
+invalidate_range(const Cache *c, target_ulong paddr, int bytes, int priv,
+                 int *pdirty)
+{
+    int i;
+    int way;
+    int count = 0;
+    uint32_t set;
+    target_ulong addr;
+
+    for (i = 0; i < c->num_prev_level_caches; ++i)
+    {
+        count += invalidate_range(c->prev_level_caches[i], paddr, bytes, priv,
+                                  pdirty);
+    }
+
+    /* Line size of the upper levels is never larger than the line size of the
+     * lower levels, so the range is aligned to the line size of c */
+    for (addr = paddr; addr < (paddr + bytes); addr += cache_line_size(c))
+    {
+        set = cache_get_set(c, addr);
+        way = (*c->pfn_find_way)(c, set, addr >> c->word_bits);
+        if (way >= 0)
+        {
+            if (cache_blk_needs_writeback(c, set, way))
+            {
+                *pdirty = TRUE;
+            }
+            cache_blk_invalidate(c, set, way);
+            ++count;
+
+            if (NULL != c->directory)
+            {
+                coherence_evict(c->directory, c->coherence_agent, addr);
+            }
+        }
+    }
+
+    return count;
+}
+
+/* Inserts a line evicted from the cache above into the cache c. Clean victim
+ * fills are assumed to be absorbed by a write buffer, so only the dirty fills
+ * and the evictions caused by the fill add to the latency. */
+static int
+victim_fill(const Cache *c, target_ulong paddr, int dirty,
+            void *p_mem_access_info, int priv)
+{
+    int way;
+    int latency = 0;
+    uint32_t set = cache_get_set(c, paddr);
+    target_ulong tag = paddr >> c->word_bits;
+
+    c->stats[priv].victim_fill_cnt++;
+
+    way = (*c->pfn_find_way)(c, set, tag);
+    if (way < 0)
+    {
+        way = cache_select_victim(c, set);
+        latency += (*c->pfn_victim_evict_handler)(c, set, way,
+                                                  p_mem_access_info, priv);
+        cache_blk_fill(c, set, way, tag);
+        c->evict_policy->insert(c->evict_policy, set, way,
+                                CACHE_EVICT_SIGNATURE(paddr));
+    }
+    else
+    {
+        c->evict_policy->use(c->evict_policy, set, way);
+    }
+
+    if (dirty)
+    {
+        latency += c->write_latency;
+        latency += (*c->pfn_write_handler)(c, paddr, cache_line_size(c), set,
+                                           way, p_mem_access_info, priv);
+    }
+
+    return latency;
+}
+
+/* Common eviction path for the victim line in the given set and way */
+static int
+evict_line(const Cache *c, int set, int way, int dirty, void *p_mem_access_info,
+           int priv)
+{
+    int i;
+    int latency = 0;
+    const Cache *target;
+    target_ulong victim_paddr;
+
+    if (!cache_blk_valid(c, set, way))
+    {
+        return 0;
+    }
+
+    victim_paddr = cache_set_tags(c, set)[way] << c->word_bits;
+
+    /* Inclusive cache must back-invalidate the copies of the victim present
+     * in the levels above it. Dirty copies are written back along with the
+     * victim. */
+    if (c->inclusion_policy == CACHE_INCLUSION_INCLUSIVE)
+    {
+        for (i = 0; i < c->num_prev_level_caches; ++i)
+        {
+            c->stats[priv].back_invalidate_cnt
+                += invalidate_range(c->prev_level_caches[i], victim_paddr,
+                                    cache_line_size(c), priv, &dirty);
+        }
+    }
+
+    target = get_victim_fill_target(c);
+    if (NULL != target)
+    {
+        /* Victim cache or an exclusive next level receives all the evicted
+         * lines, clean or dirty */
+        latency += victim_fill(target, victim_paddr, dirty, p_mem_access_info,
+                               priv);
+    }
+    else if (dirty)
+    {
+        latency += write_line_internal(c, victim_paddr, p_mem_access_info,
+                                       priv);
+    }
+
+    cache_blk_invalidate(c, set, way);
+
+    /* Lines moved into the victim cache are still held by the same coherence
+     * agent */
+    if ((NULL != c->directory) && (NULL == c->victim_cache))
+    {
+        coherence_evict(c->directory, c->coherence_agent, victim_paddr);
+    }
+    return latency;
+}
+
+/* Removes the line containing paddr from the cache c, which holds its lines
+ * exclusive of the requesting cache. Returns TRUE on hit. */
+static int
+extract_line(const Cache *c, target_ulong paddr, int priv, int *pdirty)
+{
+    int way;
+    uint32_t set = cache_get_set(c, paddr);
+
+    c->stats[priv].total_read_cnt++;
+
+    way = (*c->pfn_find_way)(c, set, paddr >> c->word_bits);
+    if (way < 0)
+    {
+        c->stats[priv].read_miss_cnt++;
+        return FALSE;
+    }
+
+    if (cache_blk_needs_writeback(c, set, way))
+    {
+        *pdirty = TRUE;
+    }
+    cache_blk_invalidate(c, set, way);
+    return TRUE;
+}
 
 static void
-update_tag_address(const Cache *c, uint32_t *pset, CacheBlk **pblk,
-                   target_ulong *ptag, target_ulong *paddr,
-                   int *pbytes_to_access, int available_bytes)
+update_tag_address(const Cache *c, uint32_t *pset, target_ulong *ptag,
+                   target_ulong *paddr, int *pbytes_to_access,
+                   int available_bytes)
 {
     /* Update pbytes_to_access to account for the available_bytes already
      * accessed */
@@ -48,7 +448,6 @@ update_tag_address(const Cache *c, uint32_t *pset, CacheBlk **pblk,
     /* Calculate set, tag and physical address to access remaining bytes not
      * present in the current cache line */
     *pset = (*pset + 1) % c->num_sets;
-    *pblk = c->blk[*pset];
     *ptag = (*ptag + 1) % c->max_tag_val;
     *paddr = *ptag << c->word_bits;
 }
@@ -69,16 +468,46 @@ read_data_internal(const Cache *c, target_ulong paddr, int bytes_to_read,
                                              p_mem_access_info);
 }
 
+/* Reads the line to be allocated in the cache c. The line is moved out of the
+ * victim cache or an exclusive next level if found there, in which case
+ * *pdirty is set if the moved line is dirty. */
+static int
+fill_line_internal(const Cache *c, target_ulong paddr, int bytes_to_read,
+                   void *p_mem_access_info, int priv, int *pdirty)
+{
+    const Cache *next = c->next_level_cache;
+
+    /* Victim cache is probed in parallel with the next level */
+    if ((NULL != c->victim_cache)
+        && extract_line(c->victim_cache, paddr, priv, pdirty))
+    {
+        return c->victim_cache->read_latency;
+    }
+
+    if ((NULL != next) && (next->inclusion_policy == CACHE_INCLUSION_EXCLUSIVE))
+    {
+        if (extract_line(next, paddr, priv, pdirty))
+        {
+            return next->read_latency;
+        }
+
+        /* Exclusive level does not allocate the line on a fill miss */
+        return next->read_latency
+               + fill_line_internal(next, paddr, bytes_to_read,
+                                    p_mem_access_info, priv, pdirty);
+    }
+
+    return read_data_internal(c, paddr, bytes_to_read, p_mem_access_info, priv);
+}
+
 static int
 read_allocate_handler(const Cache *c, target_ulong paddr, int bytes_to_read,
                       int set, void *p_mem_access_info, int priv)
 {
     target_ulong tag;
     int latency = 0;
-
-    CacheBlk *blk = c->blk[set];
-    /* Select victim using the set policy */
-    int victim = c->evict_policy->evict(c->evict_policy, set);
+    int dirty = FALSE;
+    int victim;
 
     /* As we want to allocate complete line, bytes_to_read = cache line width in
      * bytes and paddr is the address of the zeroth byte in the cache line */
@@ -86,20 +515,28 @@ read_allocate_handler(const Cache *c, target_ulong paddr, int bytes_to_read,
     bytes_to_read = (WORD_SIZE * c->max_words_per_blk);
     tag = paddr >> (c->word_bits);
 
+    /* Read the line contents and adjust the latency accordingly. The line is
+     * read before the victim is selected, as a back-invalidation or a victim
+     * cache swap during the fill can free a way in this set. */
+    latency += fill_line_internal(c, paddr, bytes_to_read, p_mem_access_info,
+                                  priv, &dirty);
+
+    /* Select victim using the set policy */
+    victim = cache_select_victim(c, set);
+
     /* Handle victim eviction according to set policy */
-    latency += (*c->pfn_victim_evict_handler)(c, &(blk[victim]), set, victim,
+    latency += (*c->pfn_victim_evict_handler)(c, set, victim,
                                               p_mem_access_info, priv);
 
-    /* Read the line contents into the cache line selected as victim and adjust
-     * the latency accordingly */
-    latency
-        += read_data_internal(c, paddr, bytes_to_read, p_mem_access_info, priv);
-
-    blk[victim].tag = tag;
-    blk[victim].status = Valid;
+    cache_blk_fill(c, set, victim, tag);
+    if (dirty)
+    {
+        cache_blk_set_dirty(c, set, victim);
+    }
 
     /* Update the status bits used for victim selection policy */
-    c->evict_policy->use(c->evict_policy, set, victim);
+    c->evict_policy->insert(c->evict_policy, set, victim,
+                            CACHE_EVICT_SIGNATURE(paddr));
 
     return latency;
 }
@@ -123,45 +560,33 @@ cache_read(const Cache *c, target_ulong paddr, int bytes_to_read,
     int latency = c->read_latency;
     int available_bytes = 0;
     int cache_miss_updated = 0;
-    CacheBlk *blk = c->blk[set];
 
     c->stats[priv].total_read_cnt++;
 
     while (bytes_to_read > 0)
     {
-        for (i = 0; i < c->num_ways; ++i)
+        i = (*c->pfn_find_way)(c, set, tag);
+        if (i >= 0)
         {
-            if ((blk[i].tag == tag) && (blk[i].status == Valid))
+            /* Tag-match: Physical address is present in the cache */
+            c->evict_policy->use(c->evict_policy, set, i);
+
+            if ((start_byte + bytes_to_read)
+                <= (c->max_words_per_blk * WORD_SIZE))
             {
-                /* Tag-match: Physical address is present in the cache */
-                c->evict_policy->use(c->evict_policy, set, i);
-
-                if ((start_byte + bytes_to_read)
-                    <= (c->max_words_per_blk * WORD_SIZE))
-                {
-                    /* All required bytes are present in the cache */
-                    return latency;
-                }
-
-                /* Required bytes are possibly split across 2 cache lines */
-                /* Calculate the bytes available to read in the current cache
-                 * line */
-                available_bytes
-                    = ((c->max_words_per_blk * WORD_SIZE) - start_byte);
-
-                /* Adjust the remaining bytes to read, tag, set and physical
-                 * address */
-                update_tag_address(c, &set, &blk, &tag, &paddr, &bytes_to_read,
-                                   available_bytes);
-                break;
+                /* All required bytes are present in the cache */
+                return latency;
             }
-        }
 
-        if (i < c->num_ways)
-        {
-            /* It means above loop was broken because required bytes were not
-             * found in the same cache line. So, start looking again for new tag
-             * and address */
+            /* Required bytes are possibly split across 2 cache lines */
+            /* Calculate the bytes available to read in the current cache
+             * line */
+            available_bytes = ((c->max_words_per_blk * WORD_SIZE) - start_byte);
+
+            /* Adjust the remaining bytes to read, tag, set and physical
+             * address, and start looking again for new tag and address */
+            update_tag_address(c, &set, &tag, &paddr, &bytes_to_read,
+                               available_bytes);
             continue;
         }
 
@@ -190,7 +615,7 @@ cache_read(const Cache *c, target_ulong paddr, int bytes_to_read,
 
             /* Adjust the remaining bytes to read, tag, set and physical
              * address */
-            update_tag_address(c, &set, &blk, &tag, &paddr, &bytes_to_read,
+            update_tag_address(c, &set, &tag, &paddr, &bytes_to_read,
                                available_bytes);
             continue;
         }
@@ -203,10 +628,8 @@ static int
 writeback_handler(const Cache *c, target_ulong paddr, int bytes_to_write,
                   int set, int way, void *p_mem_access_info, int priv)
 {
-    /* Just update dirty bit and status bits, no need to write to next cache */
-    CacheBlk *blk = c->blk[set];
-    blk[way].dirty = Dirty;
-    c->evict_policy->use(c->evict_policy, set, way);
+    /* Just update dirty bit, no need to write to next cache */
+    cache_blk_set_dirty(c, set, way);
     return 0;
 }
 
@@ -214,10 +637,8 @@ static int
 writethrough_handler(const Cache *c, target_ulong paddr, int bytes_to_write,
                      int set, int way, void *p_mem_access_info, int priv)
 {
-    /* Update the dirty bit and status bits */
-    CacheBlk *blk = c->blk[set];
-    blk[way].dirty = Dirty;
-    c->evict_policy->use(c->evict_policy, set, way);
+    /* Update the dirty bit */
+    cache_blk_set_dirty(c, set, way);
 
     /* Propagate write to next-level cache if available, memory otherwise */
     if (NULL != c->next_level_cache)
@@ -236,7 +657,6 @@ write_allocate_handler(const Cache *c, target_ulong paddr, int bytes_to_write,
                        int set, void *p_mem_access_info, int priv)
 {
     int latency = 0;
-    CacheBlk *blk = c->blk[set];
 
     /* As we want to allocate complete line, bytes_to_read = cache line width in
      * bytes and paddr is the address of the zeroth byte in the cache line */
@@ -246,20 +666,30 @@ write_allocate_handler(const Cache *c, target_ulong paddr, int bytes_to_write,
      * as we have to read contents for the whole cache line */
     target_ulong new_paddr = paddr & c->tag_bits_mask;
     target_ulong tag = paddr >> (c->word_bits);
+    int dirty = FALSE;
+    int victim;
+
+    /* Read the line contents and adjust the latency accordingly, before the
+     * victim is selected as for read allocation */
+    latency += fill_line_internal(c, new_paddr, bytes_to_read,
+                                  p_mem_access_info, priv, &dirty);
 
     /* Select victim using the set policy */
-    int victim = c->evict_policy->evict(c->evict_policy, set);
+    victim = cache_select_victim(c, set);
+
     /* Handle victim eviction according to set policy */
-    latency += (*c->pfn_victim_evict_handler)(c, &(blk[victim]), set, victim,
+    latency += (*c->pfn_victim_evict_handler)(c, set, victim,
                                               p_mem_access_info, priv);
 
-    /* Read the line contents into the cache line selected as victim and adjust
-     * the latency accordingly */
-    latency += read_data_internal(c, new_paddr, bytes_to_read,
-                                  p_mem_access_info, priv);
+    cache_blk_fill(c, set, victim, tag);
+    if (dirty)
+    {
+        cache_blk_set_dirty(c, set, victim);
+    }
 
-    blk[victim].tag = tag;
-    blk[victim].status = Valid;
+    /* Update the status bits used for victim selection policy */
+    c->evict_policy->insert(c->evict_policy, set, victim,
+                            CACHE_EVICT_SIGNATURE(new_paddr));
 
     /* Handle the cache write using underlying write policy */
     latency += (*c->pfn_write_handler)(c, paddr, bytes_to_write, set, victim,
@@ -287,46 +717,22 @@ write_no_allocate_handler(const Cache *c, target_ulong paddr,
 }
 
 static int
-writeback_victim_evict_handler(const Cache *c, CacheBlk *pBlk, int set, int way,
+writeback_victim_evict_handler(const Cache *c, int set, int way,
                                void *p_mem_access_info, int priv)
 {
-    int latency = 0;
-
-    if (NULL != pBlk)
-    {
-        /* If the cache line contents are dirty, write to next level cache if
-         * present, otherwise write to memory */
-        if (Valid == pBlk->status && Dirty == pBlk->dirty)
-        {
-            if (NULL != c->next_level_cache)
-            {
-                latency += cache_write(c->next_level_cache,
-                                       (pBlk->tag << c->word_bits),
-                                       (WORD_SIZE * c->max_words_per_blk),
-                                       p_mem_access_info, priv);
-            }
-            else
-            {
-                latency += mem_controller_create_mem_request(
-                    c->mem_controller, pBlk->tag << c->word_bits,
-                    (WORD_SIZE * c->max_words_per_blk), MEM_ACCESS_WRITE,
-                    p_mem_access_info);
-            }
-        }
-        memset(pBlk, 0, sizeof(CacheBlk));
-    }
-
-    return latency;
+    /* If the cache line contents are dirty, write to next level cache if
+     * present, otherwise write to memory */
+    return evict_line(c, set, way, cache_blk_needs_writeback(c, set, way),
+                      p_mem_access_info, priv);
 }
 
 static int
-writethrough_victim_evict_handler(const Cache *c, CacheBlk *pBlk, int set,
-                                  int way, void *p_mem_access_info, int priv)
+writethrough_victim_evict_handler(const Cache *c, int set, int way,
+                                  void *p_mem_access_info, int priv)
 {
     /* No need to write to next level cache or memory as we have already written
      * it */
-    memset(pBlk, 0, sizeof(CacheBlk));
-    return 0;
+    return evict_line(c, set, way, FALSE, p_mem_access_info, priv);
 }
 
 int
@@ -340,48 +746,39 @@ cache_write(const Cache *c, target_ulong paddr, int bytes_to_write,
     int latency = c->write_latency;
     int available_bytes = 0;
     int cache_miss_updated = 0;
-    CacheBlk *blk = c->blk[set];
 
     c->stats[priv].total_write_cnt++;
 
     while (bytes_to_write > 0)
     {
-        for (i = 0; i < c->num_ways; ++i)
+        i = (*c->pfn_find_way)(c, set, tag);
+        if (i >= 0)
         {
-            if ((blk[i].tag == tag) && (blk[i].status == Valid))
+            /* Tag-match: Physical address is present in the cache */
+            c->evict_policy->use(c->evict_policy, set, i);
+
+            if ((start_byte + bytes_to_write)
+                <= (c->max_words_per_blk * WORD_SIZE))
             {
-                /* Tag-match: Physical address is present in the cache */
-                if ((start_byte + bytes_to_write)
-                    <= (c->max_words_per_blk * WORD_SIZE))
-                {
-                    /* All required bytes are present in the cache */
-                    latency += (*c->pfn_write_handler)(c, paddr, bytes_to_write,
-                                                       set, i,
-                                                       p_mem_access_info, priv);
-                    return latency;
-                }
-
-                /* Required bytes are possibly split across 2 cache lines */
-                available_bytes
-                    = ((c->max_words_per_blk * WORD_SIZE) - start_byte);
-
-                /* Write the cache line with the bytes_to_write set to actual
-                 * bytes found in this cache line */
-                latency += (*c->pfn_write_handler)(
-                    c, paddr, available_bytes, set, i, p_mem_access_info, priv);
-
-                /* Adjust the remaining bytes to write */
-                update_tag_address(c, &set, &blk, &tag, &paddr, &bytes_to_write,
-                                   available_bytes);
-                break;
+                /* All required bytes are present in the cache */
+                latency += (*c->pfn_write_handler)(c, paddr, bytes_to_write,
+                                                   set, i, p_mem_access_info,
+                                                   priv);
+                return latency;
             }
-        }
 
-        if (i < c->num_ways)
-        {
-            /* It means above loop was broken because required bytes were not
-             * found in the same cache line. So, start looking again for new tag
-             * and address */
+            /* Required bytes are possibly split across 2 cache lines */
+            available_bytes = ((c->max_words_per_blk * WORD_SIZE) - start_byte);
+
+            /* Write the cache line with the bytes_to_write set to actual
+             * bytes found in this cache line */
+            latency += (*c->pfn_write_handler)(c, paddr, available_bytes, set,
+                                               i, p_mem_access_info, priv);
+
+            /* Adjust the remaining bytes to write and start looking again for
+             * new tag and address */
+            update_tag_address(c, &set, &tag, &paddr, &bytes_to_write,
+                               available_bytes);
             continue;
         }
 
@@ -410,7 +807,7 @@ cache_write(const Cache *c, target_ulong paddr, int bytes_to_write,
                 set, p_mem_access_info, priv);
 
             /* Adjust the remaining bytes to write */
-            update_tag_address(c, &set, &blk, &tag, &paddr, &bytes_to_write,
+            update_tag_address(c, &set, &tag, &paddr, &bytes_to_write,
                                available_bytes);
             continue;
         }
@@ -422,13 +819,16 @@ cache_write(const Cache *c, target_ulong paddr, int bytes_to_write,
 void
 cache_flush(Cache *c)
 {
-    int i;
-
     c->evict_policy->reset(c->evict_policy);
 
-    for (i = 0; i < c->num_sets; ++i)
+    memset((void *)c->tags, 0,
+           c->num_sets * c->tag_stride * sizeof(target_ulong));
+    memset((void *)c->valid, 0, c->num_sets * c->mask_words * sizeof(uint64_t));
+    memset((void *)c->dirty, 0, c->num_sets * c->mask_words * sizeof(uint64_t));
+
+    if (NULL != c->victim_cache)
     {
-        memset((void *)c->blk[i], 0, sizeof(CacheBlk) * c->num_ways);
+        cache_flush(c->victim_cache);
     }
 }
 
@@ -438,10 +838,38 @@ cache_get_stats(const Cache *c)
     return (const CacheStats *)(c->stats);
 }
 
+void
+cache_register_stats(const Cache *c, SimRegistry *r, const char *module)
+{
+    sim_registry_add_mode_counter(r, module, "reads",
+                                  &c->stats[0].total_read_cnt,
+                                  sizeof(CacheStats));
+    sim_registry_add_mode_counter(r, module, "read_misses",
+                                  &c->stats[0].read_miss_cnt,
+                                  sizeof(CacheStats));
+    sim_registry_add_mode_counter(r, module, "writes",
+                                  &c->stats[0].total_write_cnt,
+                                  sizeof(CacheStats));
+    sim_registry_add_mode_counter(r, module, "write_misses",
+                                  &c->stats[0].write_miss_cnt,
+                                  sizeof(CacheStats));
+    sim_registry_add_mode_counter(r, module, "back_invalidations",
+                                  &c->stats[0].back_invalidate_cnt,
+                                  sizeof(CacheStats));
+    sim_registry_add_mode_counter(r, module, "victim_fills",
+                                  &c->stats[0].victim_fill_cnt,
+                                  sizeof(CacheStats));
+}
+
 void
 cache_reset_stats(Cache *c)
 {
     memset((void *)c->stats, 0, NUM_MAX_PRV_LEVELS * sizeof(CacheStats));
+
+    if (NULL != c->victim_cache)
+    {
+        cache_reset_stats(c->victim_cache);
+    }
 }
 
 static void
@@ -461,6 +889,7 @@ cache_log_config(const Cache *c)
     sim_log_param_to_file(sim_log, "%s: %s", "read_alloc_policy", cache_ra_str[c->cache_read_alloc_policy]);
     sim_log_param_to_file(sim_log, "%s: %s", "write_alloc_policy", cache_wa_str[c->cache_write_alloc_policy]);
     sim_log_param_to_file(sim_log, "%s: %s", "write_policy", cache_wp_str[c->cache_write_policy]);
+    sim_log_param_to_file(sim_log, "%s: %s", "inclusion", cache_inclusion_str[c->inclusion_policy]);
     sim_log_param_to_file(sim_log, "%s: %d cycle(s)", "read_latency", c->read_latency);
     sim_log_param_to_file(sim_log, "%s: %d cycle(s)", "write_latency", c->write_latency);
 }
@@ -471,37 +900,37 @@ get_num_cache_blks(int size_kb, int cache_line_size)
     return (int)((size_kb * 1024) / cache_line_size);
 }
 
-Cache *
-cache_init(CacheTypes type, CacheLevels level, int size_kb, int cache_line_size,
-           uint32_t ways, int read_latency, int write_latency,
-           Cache *next_level_cache, int words_per_blk, int evict_policy,
-           CacheWritePolicy write_policy,
-           CacheReadAllocPolicy read_alloc_policy,
-           CacheWriteAllocPolicy write_alloc_policy,
-           MemoryController *mem_controller)
+static Cache *
+cache_create(CacheTypes type, CacheLevels level, const CacheParams *cp,
+             uint32_t blks, Cache *next_level_cache,
+             MemoryController *mem_controller)
 {
-    int i;
-    uint32_t blks = get_num_cache_blks(size_kb, cache_line_size);
-    Cache *c = (Cache *)malloc(sizeof(Cache));
+    const char *tag_match;
+    Cache *c = (Cache *)calloc(1, sizeof(Cache));
+    assert(c);
 
     c->type = type;
     c->level = level;
     c->num_blks = blks;
-    c->num_ways = ways;
-    c->num_sets = (blks / ways);
-
-    /* Allocate memory for all cache line pointers */
-    c->blk = (CacheBlk **)calloc(c->num_sets, sizeof(CacheBlk *));
-    assert(c->blk);
-
-    /* Allocate memory for cache blocks */
-    for (i = 0; i < c->num_sets; ++i)
-    {
-        c->blk[i] = (CacheBlk *)calloc(c->num_ways, sizeof(CacheBlk));
-        assert(c->blk[i]);
-    }
-
-    c->max_words_per_blk = words_per_blk;
+    c->num_ways = cp->ways;
+    c->num_sets = (blks / cp->ways);
+
+    /* Allocate tag store, tags of each set are padded for vector loads */
+    c->tag_stride = ((c->num_ways + CACHE_TAG_VECTOR_WIDTH - 1)
+                     / CACHE_TAG_VECTOR_WIDTH)
+                    * CACHE_TAG_VECTOR_WIDTH;
+    c->mask_words = (c->num_ways + 63) / 64;
+
+    c->tags = (target_ulong *)calloc(c->num_sets * c->tag_stride,
+                                     sizeof(target_ulong));
+    assert(c->tags);
+    c->valid = (uint64_t *)calloc(c->num_sets * c->mask_words, sizeof(uint64_t));
+    assert(c->valid);
+    c->dirty = (uint64_t *)calloc(c->num_sets * c->mask_words, sizeof(uint64_t));
+    assert(c->dirty);
+    c->pfn_find_way = get_find_way_handler(&tag_match);
+
+    c->max_words_per_blk = cp->line_size / WORD_SIZE;
 
     /* No. of bits required to represent byte offset within the cache line */
     c->word_bits = GET_NUM_BITS(WORD_SIZE * c->max_words_per_blk);
@@ -517,8 +946,8 @@ cache_init(CacheTypes type, CacheLevels level, int size_kb, int cache_line_size,
                        << c->word_bits;
     c->max_tag_val = (1 << c->tag_bits);
 
-    c->read_latency = read_latency;
-    c->write_latency = write_latency;
+    c->read_latency = cp->read_latency;
+    c->write_latency = cp->write_latency;
     c->mem_controller = mem_controller;
 
     c->next_level_cache = next_level_cache;
@@ -526,18 +955,31 @@ cache_init(CacheTypes type, CacheLevels level, int size_kb, int cache_line_size,
     {
         assert(c->mem_controller);
     }
+    else
+    {
+        /* Link to the level below, used for back-invalidations */
+        sim_assert((next_level_cache->num_prev_level_caches
+                    < CACHE_MAX_PREV_LEVELS),
+                   "error: %s at line %d in %s(): %s", __FILE__, __LINE__,
+                   __func__, "too many caches linked to the next level cache");
+        next_level_cache
+            ->prev_level_caches[next_level_cache->num_prev_level_caches++]
+            = c;
+    }
 
     c->stats = (CacheStats *)calloc(NUM_MAX_PRV_LEVELS, sizeof(CacheStats));
     assert(c->stats);
 
     c->evict_policy
-        = evict_policy_create(c->num_sets, c->num_ways, evict_policy);
-    c->cache_write_policy = write_policy;
-    c->cache_read_alloc_policy = read_alloc_policy;
-    c->cache_write_alloc_policy = write_alloc_policy;
+        = evict_policy_create(c->num_sets, c->num_ways, cp->evict);
+    c->cache_write_policy = (CacheWritePolicy)cp->write_policy;
+    c->cache_read_alloc_policy = (CacheReadAllocPolicy)cp->read_allocate_policy;
+    c->cache_write_alloc_policy
+        = (CacheWriteAllocPolicy)cp->write_allocate_policy;
+    c->inclusion_policy = cp->inclusion_policy;
 
     /* Set write policy handler function pointer */
-    switch (write_policy)
+    switch (c->cache_write_policy)
     {
         case WriteBack:
         {
@@ -555,7 +997,7 @@ cache_init(CacheTypes type, CacheLevels level, int size_kb, int cache_line_size,
     }
 
     /* Set cache line allocation handler function pointer on read-miss */
-    switch (read_alloc_policy)
+    switch (c->cache_read_alloc_policy)
     {
         case ReadAllocate:
         {
@@ -571,7 +1013,7 @@ cache_init(CacheTypes type, CacheLevels level, int size_kb, int cache_line_size,
     }
 
     /* Set cache line allocation handler function pointer on write-miss */
-    switch (write_alloc_policy)
+    switch (c->cache_write_alloc_policy)
     {
         case WriteAllocate:
         {
@@ -587,21 +1029,164 @@ cache_init(CacheTypes type, CacheLevels level, int size_kb, int cache_line_size,
     }
 
     cache_log_config(c);
+    sim_log_param_to_file(sim_log, "%s: %s", "tag_match", tag_match);
     return c;
 }
 
+Cache *
+cache_init(CacheTypes type, CacheLevels level, const CacheParams *cp,
+           Cache *next_level_cache, MemoryController *mem_controller)
+{
+    return cache_create(type, level, cp,
+                        get_num_cache_blks(cp->size, cp->line_size),
+                        next_level_cache, mem_controller);
+}
+
 void
-cache_free(Cache **c)
+cache_add_victim_cache(Cache *c, int num_entries, int latency)
+{
+    CacheParams vp;
+
+    assert(NULL == c->victim_cache);
+
+    /* Victim cache is fully associative, uses the line size and policies of
+     * the cache it is attached to and evicts into the same next level */
+    vp.size = 0;
+    vp.ways = num_entries;
+    vp.read_latency = latency;
+    vp.write_latency = latency;
+    vp.line_size = cache_line_size(c);
+    vp.evict = EVICT_POLICY_TRUE_LRU;
+    vp.read_allocate_policy = c->cache_read_alloc_policy;
+    vp.write_allocate_policy = c->cache_write_alloc_policy;
+    vp.write_policy = c->cache_write_policy;
+    vp.inclusion_policy = CACHE_INCLUSION_NINE;
+
+    c->victim_cache
+        = cache_create(VictimCache, (CacheLevels)c->level, &vp, num_entries,
+                       c->next_level_cache, c->mem_controller);
+}
+
+void
+cache_set_coherence_agent(Cache *c, struct CoherenceDirectory *directory,
+                          int agent)
+{
+    c->directory = directory;
+    c->coherence_agent = agent;
+
+    if (NULL != c->victim_cache)
+    {
+        cache_set_coherence_agent(c->victim_cache, directory, agent);
+    }
+}
+
+/* Invalidates the line containing paddr from the cache c and its victim cache,
+ * on behalf of the coherence directory. Dirty contents are dropped, as the
+ * line is supplied to the requester. Returns TRUE if the line was found. */
+int
+cache_invalidate_line(const Cache *c, target_ulong paddr)
+{
+    int way;
+    uint32_t set = cache_get_set(c, paddr);
+
+    way = (*c->pfn_find_way)(c, set, paddr >> c->word_bits);
+    if (way >= 0)
+    {
+        cache_blk_invalidate(c, set, way);
+        return TRUE;
+    }
+
+    if (NULL != c->victim_cache)
+    {
+        return cache_invalidate_line(c->victim_cache, paddr);
+    }
+
+    return FALSE;
+}
+
+/* Writes back the line containing paddr from the cache c or its victim cache
+ * if it is dirty, and keeps a clean copy. Returns the latency of the
+ * write-back. */
+int
+cache_clean_line(const Cache *c, target_ulong paddr, void *p_mem_access_info,
+                 int priv)
+{
+    int way;
+    uint32_t set = cache_get_set(c, paddr);
+
+    way = (*c->pfn_find_way)(c, set, paddr >> c->word_bits);
+    if (way >= 0)
+    {
+        if (!cache_blk_needs_writeback(c, set, way))
+        {
+            return 0;
+        }
+        cache_blk_clear_dirty(c, set, way);
+        return write_line_internal(c, paddr & c->tag_bits_mask,
+                                   p_mem_access_info, priv);
+    }
+
+    if (NULL != c->victim_cache)
+    {
+        return cache_clean_line(c->victim_cache, paddr, p_mem_access_info,
+                                priv);
+    }
+
+    return 0;
+}
+
+/* Returns TRUE if all the lines holding the given bytes are present in the
+ * cache c, without updating its replacement state or statistics */
+int
+cache_probe(const Cache *c, target_ulong paddr, int bytes)
+{
+    target_ulong tag;
+    target_ulong last_tag = (paddr + bytes - 1) >> c->word_bits;
+
+    for (tag = paddr >> c->word_bits; tag <= last_tag; ++tag)
+    {
+        if ((*c->pfn_find_way)(c, cache_get_set(c, tag << c->word_bits), tag)
+            < 0)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Misses of the cache c in all the privilege modes, 0 if c is NULL */
+uint64_t
+cache_miss_count(const Cache *c)
 {
     int i;
+    uint64_t misses = 0;
 
-    for (i = 0; i < (*c)->num_sets; ++i)
+    if (NULL == c)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < NUM_MAX_PRV_LEVELS; ++i)
+    {
+        misses += c->stats[i].read_miss_cnt + c->stats[i].write_miss_cnt;
+    }
+    return misses;
+}
+
+void
+cache_free(Cache **c)
+{
+    if (NULL != (*c)->victim_cache)
     {
-        free((*c)->blk[i]);
-        (*c)->blk[i] = NULL;
+        cache_free(&(*c)->victim_cache);
     }
-    free((*c)->blk);
-    (*c)->blk = NULL;
+    free((*c)->tags);
+    (*c)->tags = NULL;
+    free((*c)->valid);
+    (*c)->valid = NULL;
+    free((*c)->dirty);
+    (*c)->dirty = NULL;
     free((*c)->stats);
     (*c)->stats = NULL;
     evict_policy_free(&(*c)->evict_policy);
@@ -33,13 +33,18 @@
 #include "../riscv_sim_typedefs.h"
 #include "../utils/evict_policy.h"
 #include "../utils/sim_params.h"
+#include "../utils/sim_registry.h"
 #include "memory_controller.h"
 
 /* Word size in the target architecture */
 #define WORD_SIZE (sizeof(target_ulong))
 
-struct CacheBlk;
+/* Maximum number of caches directly above a cache level: L1 instruction, L1
+ * data and the victim cache of L1 data of every hart sharing the level */
+#define CACHE_MAX_PREV_LEVELS (4 * NUM_MAX_HARTS)
+
 struct Cache;
+struct CoherenceDirectory;
 
 typedef int (*PFN_GET_VICTIM_INDEX)(const struct Cache *c, int set);
 typedef int (*PFN_READ_ALLOC_HANDLER)(const struct Cache *c, target_ulong paddr,
@@ -52,16 +57,17 @@ typedef int (*PFN_WRITE_ALLOC_HANDLER)(const struct Cache *c,
                                        target_ulong paddr, int bytes_to_write,
                                        int set, void *p_mem_access_info,
                                        int priv);
-typedef int (*PFN_VICTIM_EVICTION_HANDLER)(const struct Cache *c,
-                                           struct CacheBlk *pBlk, int set,
+typedef int (*PFN_VICTIM_EVICTION_HANDLER)(const struct Cache *c, int set,
                                            int way, void *p_mem_access_info,
                                            int priv);
+typedef int (*PFN_FIND_WAY)(const struct Cache *c, int set, target_ulong tag);
 
 /* Cache types */
 typedef enum CacheTypes {
     InstructionCache = 0x1,
     DataCache = 0x2,
     SharedCache = 0x3,
+    VictimCache = 0x4,
 } CacheTypes;
 
 /* Cache Levels, add levels as required */
@@ -69,17 +75,9 @@ typedef enum CacheLevels {
     L1 = 0x1,
     L2 = 0x2,
     L3 = 0x3,
+    L4 = 0x4,
 } CacheLevels;
 
-/* Status of the cache block */
-typedef enum BlockStatus {
-    Unused = 0x0,
-    Valid = 0x1,
-} BlockStatus;
-
-/* Block status, used if WriteBack policy is set */
-typedef enum BlockDirtyStatus { NonDirty = 0x0, Dirty = 0x1 } BlockDirtyStatus;
-
 /* Cache line allocate policy on write-miss */
 typedef enum CacheWriteAllocPolicy {
     WriteAllocate = 0x0,
@@ -105,25 +103,34 @@ typedef struct CacheStats
     uint64_t total_write_cnt;
     uint64_t read_miss_cnt;
     uint64_t write_miss_cnt;
+    uint64_t back_invalidate_cnt; /* Upper level lines invalidated to maintain
+                                     inclusion */
+    uint64_t victim_fill_cnt;     /* Lines received from the upper level on
+                                     eviction */
 } CacheStats;
 
-/* Single cache line */
-typedef struct CacheBlk
-{
-    uint8_t status;
-    uint8_t dirty;
-    target_ulong tag;
-} CacheBlk;
-
 /* Cache object storing cache blocks, status bits and policies to be used */
 
-/* Cache hierarchy model consists of two levels of physically indexed,
+/* Cache hierarchy model consists of multiple levels of physically indexed,
  * physically tagged blocking caches. Level-1 caches include a separate
- * instruction and data cache, whereas Level-2 consists of an optional unified
- * cache. The cache accesses are non-pipelined and follow a non-inclusive
- * non-exclusive design, meaning the contents of the lower level cache are
- * neither strictly inclusive nor exclusive of the higher-level cache. L2 cache
- * can be accessed in parallel by split L1 caches.*/
+ * instruction and data cache, followed by an optional list of unified caches
+ * (L2 up to L4), where the last one acts as the last level cache (LLC). Each
+ * level has its own size, associativity, latency, line size and policies. The
+ * cache accesses are non-pipelined. L2 cache can be accessed in parallel by
+ * split L1 caches.
+ *
+ * Inclusion policy of each shared level describes its contents with respect to
+ * the levels above it:
+ * - nine: non-inclusive non-exclusive, contents of the lower level cache are
+ *   neither strictly inclusive nor exclusive of the higher-level cache
+ * - inclusive: eviction of a line back-invalidates its copies in all the
+ *   levels above
+ * - exclusive: lines are not allocated on a fill from the level above, a hit
+ *   moves the line up, and lines evicted from the level above are filled in
+ *   (victim-fill)
+ *
+ * L1 data cache can optionally be backed by a small fully associative victim
+ * cache, which holds the lines evicted from it and is probed on a miss. */
 typedef struct Cache
 {
     int level;
@@ -147,6 +154,7 @@ typedef struct Cache
     CacheWritePolicy cache_write_policy;
     CacheReadAllocPolicy cache_read_alloc_policy;
     CacheWriteAllocPolicy cache_write_alloc_policy;
+    int inclusion_policy;
 
     MemoryController *mem_controller;
 
@@ -166,28 +174,58 @@ typedef struct Cache
        used(Write-Allocate/Write-No-Allocate) */
     PFN_VICTIM_EVICTION_HANDLER pfn_victim_evict_handler;
 
-    CacheBlk **blk;
+    /* Tag store is kept as a structure of arrays: tags for all the ways of a
+     * set are contiguous (padded to tag_stride entries), and valid and dirty
+     * status of a set are bitmasks of mask_words 64-bit words. This allows
+     * matching several tags with a single vector compare. */
+    target_ulong *tags;
+    uint64_t *valid;
+    uint64_t *dirty;
+    int tag_stride;
+    int mask_words;
+
+    /* Tag match routine, vectorized if supported by the host */
+    PFN_FIND_WAY pfn_find_way;
 
     /* Pointer to the next level cache, if NULL it means it is the last level
      * cache (LLC) */
     struct Cache *next_level_cache;
+
+    /* Caches directly above this level, targets for back-invalidation */
+    struct Cache *prev_level_caches[CACHE_MAX_PREV_LEVELS];
+    int num_prev_level_caches;
+
+    /* Optional victim cache, NULL if not present */
+    struct Cache *victim_cache;
+
+    /* Coherence directory tracking the lines of this cache, NULL if the cache
+     * is not kept coherent. Victim cache belongs to the same agent as the
+     * cache it is attached to. */
+    struct CoherenceDirectory *directory;
+    int coherence_agent;
     CacheStats *stats;
     EvictPolicy *evict_policy;
 } Cache;
 
-Cache *cache_init(CacheTypes type, CacheLevels level, int size_kb,
-                  int cache_line_size, uint32_t ways, int read_latency,
-                  int write_latency, Cache *next_level_cache, int words_per_blk,
-                  int evict_policy, CacheWritePolicy write_policy,
-                  CacheReadAllocPolicy read_alloc_policy,
-                  CacheWriteAllocPolicy write_alloc_policy,
-                  MemoryController *mem_controller);
+Cache *cache_init(CacheTypes type, CacheLevels level, const CacheParams *cp,
+                  Cache *next_level_cache, MemoryController *mem_controller);
+void cache_add_victim_cache(struct Cache *c, int num_entries, int latency);
 void cache_flush(struct Cache *c);
 void cache_reset_stats(struct Cache *c);
 const CacheStats *cache_get_stats(const struct Cache *c);
+void cache_register_stats(const struct Cache *c, SimRegistry *r,
+                          const char *module);
 int cache_read(const struct Cache *c, target_ulong paddr, int bytes_to_read,
                void *p_mem_access_info, int priv);
 int cache_write(const struct Cache *c, target_ulong paddr, int bytes_to_read,
                 void *p_mem_access_info, int priv);
+void cache_set_coherence_agent(struct Cache *c,
+                               struct CoherenceDirectory *directory,
+                               int agent);
+int cache_invalidate_line(const struct Cache *c, target_ulong paddr);
+int cache_clean_line(const struct Cache *c, target_ulong paddr,
+                     void *p_mem_access_info, int priv);
+int cache_probe(const struct Cache *c, target_ulong paddr, int bytes);
+uint64_t cache_miss_count(const struct Cache *c);
 void cache_free(Cache **c);
 #endif
@@ -0,0 +1,538 @@
+/**
+ * Directory based cache coherence
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../riscv_sim_macros.h"
+#include "../utils/sim_log.h"
+#include "coherence.h"
+
+/* Initial number of directory entries, the table doubles in size whenever it
+ * is half full */
+#define COHERENCE_DIR_INITIAL_ENTRIES 4096
+
+/* Entries not holding any line have no sharers */
+static inline int
+dir_entry_used(const CoherenceDirectoryEntry *e)
+{
+    return (0 != e->sharers);
+}
+
+static inline uint32_t
+dir_hash(const CoherenceDirectory *d, target_ulong line)
+{
+    return (uint32_t)(((uint64_t)line * 0x9e3779b97f4a7c15ULL) >> 32)
+           & (d->num_entries - 1);
+}
+
+static CoherenceDirectoryEntry *
+dir_lookup(const CoherenceDirectory *d, target_ulong line)
+{
+    uint32_t i = dir_hash(d, line);
+
+    while (dir_entry_used(&d->entries[i]))
+    {
+        if (d->entries[i].line == line)
+        {
+            return &d->entries[i];
+        }
+        i = (i + 1) & (d->num_entries - 1);
+    }
+
+    return NULL;
+}
+
+static void
+dir_alloc_entries(CoherenceDirectory *d, uint32_t num_entries)
+{
+    d->num_entries = num_entries;
+    d->num_used = 0;
+    d->entries = (CoherenceDirectoryEntry *)calloc(
+        num_entries, sizeof(CoherenceDirectoryEntry));
+    assert(d->entries);
+}
+
+static void
+dir_grow(CoherenceDirectory *d)
+{
+    uint32_t i, j;
+    uint32_t old_num_entries = d->num_entries;
+    CoherenceDirectoryEntry *old_entries = d->entries;
+
+    dir_alloc_entries(d, 2 * old_num_entries);
+    for (i = 0; i < old_num_entries; ++i)
+    {
+        if (dir_entry_used(&old_entries[i]))
+        {
+            j = dir_hash(d, old_entries[i].line);
+            while (dir_entry_used(&d->entries[j]))
+            {
+                j = (j + 1) & (d->num_entries - 1);
+            }
+            d->entries[j] = old_entries[i];
+            ++d->num_used;
+        }
+    }
+    free(old_entries);
+}
+
+/* Adds an entry for the line, held by the given agent in the given state.
+ * Pointers to the other entries are invalidated. */
+static void
+dir_insert(CoherenceDirectory *d, target_ulong line, int agent, int state)
+{
+    uint32_t i;
+
+    if (2 * (d->num_used + 1) > d->num_entries)
+    {
+        dir_grow(d);
+    }
+
+    i = dir_hash(d, line);
+    while (dir_entry_used(&d->entries[i]))
+    {
+        i = (i + 1) & (d->num_entries - 1);
+    }
+
+    d->entries[i].line = line;
+    d->entries[i].sharers = 1U << agent;
+    d->entries[i].owner = (state == COHERENCE_STATE_SHARED) ? -1 : agent;
+    d->entries[i].owner_state = state;
+    ++d->num_used;
+}
+
+/* Removes the entry using backward shift deletion, so that the probe sequence
+ * of the remaining entries stays intact. Pointers to the other entries are
+ * invalidated. */
+static void
+dir_remove(CoherenceDirectory *d, CoherenceDirectoryEntry *e)
+{
+    uint32_t mask = d->num_entries - 1;
+    uint32_t i = (uint32_t)(e - d->entries);
+    uint32_t j = i;
+    uint32_t k;
+
+    for (;;)
+    {
+        d->entries[i].sharers = 0;
+        do
+        {
+            j = (j + 1) & mask;
+            if (!dir_entry_used(&d->entries[j]))
+            {
+                --d->num_used;
+                return;
+            }
+            k = dir_hash(d, d->entries[j].line);
+        } while ((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j)));
+
+        d->entries[i] = d->entries[j];
+        i = j;
+    }
+}
+
+static void
+agent_line_lost(const CoherenceDirectory *d, int agent, target_ulong line)
+{
+    const CoherenceAgent *a = &d->agents[agent];
+
+    if (NULL != a->pfn_line_lost)
+    {
+        (*a->pfn_line_lost)(a->opaque, line << d->line_bits);
+    }
+}
+
+static int
+read_line(CoherenceDirectory *d, int agent, target_ulong line,
+          void *p_mem_access_info, int priv)
+{
+    int owner;
+    int latency = 0;
+    int writeback = FALSE;
+    CoherenceDirectoryEntry *e;
+    CoherenceStats *stats = &d->agents[agent].stats[priv];
+
+    e = dir_lookup(d, line);
+    if (NULL == e)
+    {
+        /* No other agent holds the line */
+        dir_insert(d, line, agent, COHERENCE_STATE_EXCLUSIVE);
+        return 0;
+    }
+
+    if (e->sharers & (1U << agent))
+    {
+        return 0;
+    }
+
+    owner = e->owner;
+    if (owner >= 0)
+    {
+        switch (e->owner_state)
+        {
+            case COHERENCE_STATE_EXCLUSIVE:
+            {
+                /* Clean line, supplied by the shared level */
+                stats->downgrades++;
+                latency += d->downgrade_latency;
+                e->owner = -1;
+                break;
+            }
+            case COHERENCE_STATE_MODIFIED:
+            {
+                stats->downgrades++;
+                stats->c2c_transfers++;
+                latency += d->downgrade_latency + d->c2c_latency;
+                if (d->protocol == COHERENCE_MOESI)
+                {
+                    e->owner_state = COHERENCE_STATE_OWNED;
+                }
+                else
+                {
+                    e->owner = -1;
+                    writeback = TRUE;
+                }
+                break;
+            }
+            case COHERENCE_STATE_OWNED:
+            {
+                stats->c2c_transfers++;
+                latency += d->c2c_latency;
+                break;
+            }
+        }
+    }
+    e->sharers |= (1U << agent);
+
+    /* Owner writes back the line off the critical path of the request. This
+     * is done after updating the directory, as the write-back may evict lines
+     * from the shared levels and back-invalidate them in the agents. */
+    if (writeback)
+    {
+        cache_clean_line(d->agents[owner].dcache, line << d->line_bits,
+                         p_mem_access_info, priv);
+    }
+
+    return latency;
+}
+
+static int
+write_line(CoherenceDirectory *d, int agent, target_ulong line, int priv)
+{
+    int i;
+    int allocate;
+    int latency = 0;
+    uint32_t others;
+    CoherenceDirectoryEntry *e;
+    CoherenceStats *stats = &d->agents[agent].stats[priv];
+
+    e = dir_lookup(d, line);
+    if (NULL != e)
+    {
+        if ((e->owner == agent)
+            && ((e->owner_state == COHERENCE_STATE_EXCLUSIVE)
+                || (e->owner_state == COHERENCE_STATE_MODIFIED)))
+        {
+            /* Silent upgrade, the entry is written only on the transition
+             * so that a write hit does not modify the directory */
+            if (e->owner_state == COHERENCE_STATE_EXCLUSIVE)
+            {
+                e->owner_state = COHERENCE_STATE_MODIFIED;
+            }
+            return 0;
+        }
+
+        if (e->sharers & (1U << agent))
+        {
+            stats->upgrade_misses++;
+        }
+
+        others = e->sharers & ~(1U << agent);
+        if (others)
+        {
+            if ((e->owner >= 0) && (e->owner != agent)
+                && ((e->owner_state == COHERENCE_STATE_MODIFIED)
+                    || (e->owner_state == COHERENCE_STATE_OWNED)))
+            {
+                stats->c2c_transfers++;
+                latency += d->c2c_latency;
+            }
+
+            /* Invalidations are sent to all the sharers in parallel */
+            latency += d->invalidate_latency;
+            for (i = 0; i < d->num_agents; ++i)
+            {
+                if (others & (1U << i))
+                {
+                    if (cache_invalidate_line(d->agents[i].dcache,
+                                              line << d->line_bits))
+                    {
+                        stats->invalidations++;
+                    }
+                    agent_line_lost(d, i, line);
+                }
+            }
+        }
+    }
+
+    /* Requester holds the line in M state, unless the write is not allocated
+     * in its data cache */
+    allocate = ((NULL != e) && (e->sharers & (1U << agent)))
+               || (d->agents[agent].dcache->cache_write_alloc_policy
+                   == WriteAllocate);
+    if (NULL == e)
+    {
+        if (allocate)
+        {
+            dir_insert(d, line, agent, COHERENCE_STATE_MODIFIED);
+        }
+    }
+    else if (allocate)
+    {
+        e->sharers = 1U << agent;
+        e->owner = agent;
+        e->owner_state = COHERENCE_STATE_MODIFIED;
+    }
+    else
+    {
+        dir_remove(d, e);
+    }
+
+    return latency;
+}
+
+/* Returns the additional latency for the agent to read the given bytes */
+int
+coherence_read(CoherenceDirectory *d, int agent, target_ulong paddr, int bytes,
+               void *p_mem_access_info, int priv)
+{
+    int latency = 0;
+    target_ulong line;
+    target_ulong last_line = (paddr + bytes - 1) >> d->line_bits;
+
+    for (line = paddr >> d->line_bits; line <= last_line; ++line)
+    {
+        latency += read_line(d, agent, line, p_mem_access_info, priv);
+    }
+
+    return latency;
+}
+
+/* Returns the additional latency for the agent to obtain the given bytes in
+ * modified state */
+int
+coherence_write(CoherenceDirectory *d, int agent, target_ulong paddr,
+                int bytes, void *p_mem_access_info, int priv)
+{
+    int latency = 0;
+    target_ulong line;
+    target_ulong last_line = (paddr + bytes - 1) >> d->line_bits;
+
+    for (line = paddr >> d->line_bits; line <= last_line; ++line)
+    {
+        latency += write_line(d, agent, line, priv);
+    }
+
+    return latency;
+}
+
+/* Returns TRUE if the agent holds the lines of the given bytes with the
+ * permission to read them, or to write them if is_write is set, so that the
+ * access does not change the directory */
+int
+coherence_permits(const CoherenceDirectory *d, int agent, target_ulong paddr,
+                  int bytes, int is_write)
+{
+    target_ulong line;
+    target_ulong last_line = (paddr + bytes - 1) >> d->line_bits;
+    const CoherenceDirectoryEntry *e;
+
+    for (line = paddr >> d->line_bits; line <= last_line; ++line)
+    {
+        e = dir_lookup(d, line);
+        if ((NULL == e) || !(e->sharers & (1U << agent)))
+        {
+            return FALSE;
+        }
+
+        if (is_write
+            && ((e->owner != agent)
+                || ((e->owner_state != COHERENCE_STATE_EXCLUSIVE)
+                    && (e->owner_state != COHERENCE_STATE_MODIFIED))))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Called by the data cache of the agent when the line containing paddr is
+ * evicted from it */
+void
+coherence_evict(CoherenceDirectory *d, int agent, target_ulong paddr)
+{
+    target_ulong line = paddr >> d->line_bits;
+    CoherenceDirectoryEntry *e = dir_lookup(d, line);
+
+    if ((NULL == e) || !(e->sharers & (1U << agent)))
+    {
+        return;
+    }
+
+    e->sharers &= ~(1U << agent);
+    if (e->owner == agent)
+    {
+        /* Dirty line is written back by the evicting cache */
+        e->owner = -1;
+    }
+
+    if (!e->sharers)
+    {
+        dir_remove(d, e);
+    }
+
+    agent_line_lost(d, agent, line);
+}
+
+int
+coherence_add_agent(CoherenceDirectory *d, Cache *dcache)
+{
+    int agent = d->num_agents;
+
+    sim_assert((agent < NUM_MAX_HARTS), "error: %s at line %d in %s(): %s",
+               __FILE__, __LINE__, __func__,
+               "too many caches added to the coherence directory");
+    sim_assert((dcache->word_bits == d->line_bits),
+               "error: %s at line %d in %s(): %s", __FILE__, __LINE__,
+               __func__, "line size of the coherent caches must be same");
+
+    d->agents[agent].dcache = dcache;
+    d->agents[agent].pfn_line_lost = NULL;
+    d->agents[agent].opaque = NULL;
+    d->agents[agent].stats
+        = (CoherenceStats *)calloc(NUM_MAX_PRV_LEVELS, sizeof(CoherenceStats));
+    assert(d->agents[agent].stats);
+    ++d->num_agents;
+
+    cache_set_coherence_agent(dcache, d, agent);
+    return agent;
+}
+
+void
+coherence_set_line_lost_handler(CoherenceDirectory *d, int agent,
+                                PFN_COHERENCE_LINE_LOST pfn, void *opaque)
+{
+    d->agents[agent].pfn_line_lost = pfn;
+    d->agents[agent].opaque = opaque;
+}
+
+const CoherenceStats *
+coherence_get_stats(const CoherenceDirectory *d, int agent)
+{
+    return (const CoherenceStats *)d->agents[agent].stats;
+}
+
+void
+coherence_register_stats(const CoherenceDirectory *d, int agent,
+                         SimRegistry *r, const char *module)
+{
+    const CoherenceStats *stats = d->agents[agent].stats;
+
+    sim_registry_add_mode_counter(r, module, "invalidations",
+                                  &stats[0].invalidations,
+                                  sizeof(CoherenceStats));
+    sim_registry_add_mode_counter(r, module, "downgrades", &stats[0].downgrades,
+                                  sizeof(CoherenceStats));
+    sim_registry_add_mode_counter(r, module, "c2c_transfers",
+                                  &stats[0].c2c_transfers,
+                                  sizeof(CoherenceStats));
+    sim_registry_add_mode_counter(r, module, "upgrade_misses",
+                                  &stats[0].upgrade_misses,
+                                  sizeof(CoherenceStats));
+}
+
+void
+coherence_reset_stats(CoherenceDirectory *d)
+{
+    int i;
+
+    for (i = 0; i < d->num_agents; ++i)
+    {
+        memset((void *)d->agents[i].stats, 0,
+               NUM_MAX_PRV_LEVELS * sizeof(CoherenceStats));
+    }
+}
+
+/* Must be called along with flushing all the coherent caches */
+void
+coherence_flush(CoherenceDirectory *d)
+{
+    memset((void *)d->entries, 0,
+           d->num_entries * sizeof(CoherenceDirectoryEntry));
+    d->num_used = 0;
+}
+
+CoherenceDirectory *
+coherence_init(const SimParams *p, int line_size)
+{
+    CoherenceDirectory *d;
+
+    d = (CoherenceDirectory *)calloc(1, sizeof(CoherenceDirectory));
+    assert(d);
+
+    d->protocol = p->coherence_protocol;
+    d->line_bits = GET_NUM_BITS(line_size);
+    d->invalidate_latency = p->coherence_invalidate_latency;
+    d->downgrade_latency = p->coherence_downgrade_latency;
+    d->c2c_latency = p->coherence_c2c_latency;
+    dir_alloc_entries(d, COHERENCE_DIR_INITIAL_ENTRIES);
+
+    sim_log_event_to_file(sim_log, "%s", "Setting up coherence directory");
+    sim_log_param_to_file(sim_log, "%s: %s", "protocol",
+                          coherence_protocol_str[d->protocol]);
+    sim_log_param_to_file(sim_log, "%s: %d bytes", "line_size", line_size);
+    return d;
+}
+
+void
+coherence_free(CoherenceDirectory **d)
+{
+    int i;
+
+    for (i = 0; i < (*d)->num_agents; ++i)
+    {
+        free((*d)->agents[i].stats);
+        (*d)->agents[i].stats = NULL;
+    }
+    free((*d)->entries);
+    (*d)->entries = NULL;
+    free(*d);
+    *d = NULL;
+}
@@ -0,0 +1,127 @@
+/**
+ * Directory based cache coherence
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _COHERENCE_H_
+#define _COHERENCE_H_
+
+#include "../riscv_sim_typedefs.h"
+#include "../utils/sim_params.h"
+#include "cache.h"
+
+/* State of a line in the L1 data cache of an agent */
+typedef enum CoherenceState {
+    COHERENCE_STATE_INVALID = 0x0,
+    COHERENCE_STATE_SHARED = 0x1,
+    COHERENCE_STATE_EXCLUSIVE = 0x2,
+    COHERENCE_STATE_OWNED = 0x3,
+    COHERENCE_STATE_MODIFIED = 0x4,
+} CoherenceState;
+
+/* Called when a line leaves the data cache of an agent, either invalidated on
+ * behalf of another agent or evicted */
+typedef void (*PFN_COHERENCE_LINE_LOST)(void *opaque, target_ulong paddr);
+
+/* Statistical counters for the requests made by an agent */
+typedef struct CoherenceStats
+{
+    uint64_t invalidations; /* Lines invalidated in the other agents */
+    uint64_t downgrades;    /* Lines downgraded in the other agents */
+    uint64_t c2c_transfers; /* Lines supplied by the cache of another agent */
+    uint64_t upgrade_misses; /* Writes to a line held in shared or owned
+                                state */
+} CoherenceStats;
+
+typedef struct CoherenceDirectoryEntry
+{
+    target_ulong line;
+    uint32_t sharers; /* Bitmask of the agents holding the line */
+    int owner;        /* Agent holding the line in E, O or M state, or -1 */
+    int owner_state;
+} CoherenceDirectoryEntry;
+
+typedef struct CoherenceAgent
+{
+    const Cache *dcache;
+    PFN_COHERENCE_LINE_LOST pfn_line_lost;
+    void *opaque;
+    CoherenceStats *stats;
+} CoherenceAgent;
+
+/* Directory at the shared cache levels keeps track of the sharers and the
+ * owner of every line held in the L1 data caches (agents) of the harts. The
+ * directory is sparse: only the lines present in at least one agent have an
+ * entry, kept in an open addressing hash table.
+ *
+ * - A read miss makes the requester a sharer. If no other agent holds the
+ *   line, it is granted in exclusive (E) state. If another agent holds the
+ *   line in M state, the owner is downgraded: with MESI it writes the line
+ *   back and keeps a shared copy, with MOESI it keeps the dirty line in owned
+ *   (O) state. Dirty lines (M or O) are supplied cache-to-cache.
+ * - A write to a line held in S or O state is an upgrade miss. A write
+ *   invalidates the copies of all the other agents, a dirty copy is supplied
+ *   cache-to-cache. The requester ends up in M state, writes to a line in E
+ *   state upgrade silently.
+ *
+ * Invalidations are sent to all the sharers in parallel, so a request pays
+ * invalidate_latency once. The coherence latencies are added on top of the
+ * latency of the cache hierarchy access. Instruction caches are not kept
+ * coherent, as RISC-V requires FENCE.I for instruction fetch to observe
+ * stores. */
+typedef struct CoherenceDirectory
+{
+    int protocol;
+    int line_bits;
+    int invalidate_latency;
+    int downgrade_latency;
+    int c2c_latency;
+
+    int num_agents;
+    CoherenceAgent agents[NUM_MAX_HARTS];
+
+    CoherenceDirectoryEntry *entries;
+    uint32_t num_entries; /* Power of 2 */
+    uint32_t num_used;
+} CoherenceDirectory;
+
+CoherenceDirectory *coherence_init(const SimParams *p, int line_size);
+int coherence_add_agent(CoherenceDirectory *d, Cache *dcache);
+void coherence_set_line_lost_handler(CoherenceDirectory *d, int agent,
+                                     PFN_COHERENCE_LINE_LOST pfn, void *opaque);
+int coherence_read(CoherenceDirectory *d, int agent, target_ulong paddr,
+                   int bytes, void *p_mem_access_info, int priv);
+int coherence_write(CoherenceDirectory *d, int agent, target_ulong paddr,
+                    int bytes, void *p_mem_access_info, int priv);
+int coherence_permits(const CoherenceDirectory *d, int agent,
+                      target_ulong paddr, int bytes, int is_write);
+void coherence_evict(CoherenceDirectory *d, int agent, target_ulong paddr);
+const CoherenceStats *coherence_get_stats(const CoherenceDirectory *d,
+                                          int agent);
+void coherence_register_stats(const CoherenceDirectory *d, int agent,
+                              SimRegistry *r, const char *module);
+void coherence_flush(CoherenceDirectory *d);
+void coherence_reset_stats(CoherenceDirectory *d);
+void coherence_free(CoherenceDirectory **d);
+#endif
@@ -64,6 +64,11 @@ dram_log_config(const Dram *d, const SimParams *p)
                                   p->sim_file_path);
             break;
         }
+        case MEM_MODEL_ANALYTICAL:
+        {
+            /* Analytical model logs its own configuration on creation */
+            break;
+        }
     }
 }
 
@@ -94,6 +99,13 @@ base_dram_model_get_max_clock_cycles(Dram *d, PendingMemAccessEntry *e)
     return max_clock_cycles;
 }
 
+static int
+analytical_dram_model_get_max_clock_cycles(Dram *d, PendingMemAccessEntry *e)
+{
+    return analytical_dram_get_latency(d->analytical_dram, e->addr, e->type,
+                                       d->clock);
+}
+
 #define DRAMSIM3_RAM_BASE_ADDR 0x0
 #define TINYEMU_RAM_BASE_ADDR 0x80000000
 
@@ -155,62 +167,42 @@ ramulator_get_max_clock_cycles(Dram *d, PendingMemAccessEntry *e)
     return max_clock_cycles;
 }
 
+/* Signals the completion of a request to the pipeline stage of the hart which
+ * issued it */
 static void
-read_complete_callback(target_ulong addr, StageMemAccessQueue *f,
-                       StageMemAccessQueue *b)
+complete_callback(const PendingMemAccessEntry *e)
 {
     int i;
+    StageMemAccessQueue *q = e->stage_queue;
 
-    for (i = 0; i < f->cur_idx; ++i)
+    for (i = 0; i < q->cur_idx; ++i)
     {
-        if ((f->entry[i].valid) && (f->entry[i].addr == addr)
-            && (f->entry[i].type == MEM_ACCESS_READ))
+        if ((q->entry[i].valid) && (q->entry[i].addr == e->addr)
+            && (q->entry[i].type == e->type))
         {
-            f->entry[i].valid = FALSE;
-            --f->cur_size;
-            return;
-        }
-    }
-
-    for (i = 0; i < b->cur_idx; ++i)
-    {
-        if ((b->entry[i].valid) && (b->entry[i].addr == addr)
-            && (b->entry[i].type == MEM_ACCESS_READ))
-        {
-            b->entry[i].valid = FALSE;
-            --b->cur_size;
+            q->entry[i].valid = FALSE;
+            --q->cur_size;
             return;
         }
     }
 }
 
 static void
-write_complete_callback(target_ulong addr, StageMemAccessQueue *f,
-                        StageMemAccessQueue *b)
+dram_account_request(Dram *d, const PendingMemAccessEntry *e)
 {
-    int i;
+    uint64_t latency = d->clock - e->start_cycle;
 
-    for (i = 0; i < f->cur_idx; ++i)
+    if (e->type == MEM_ACCESS_WRITE)
     {
-        if ((f->entry[i].valid) && (f->entry[i].addr == addr)
-            && (f->entry[i].type == MEM_ACCESS_WRITE))
-        {
-            f->entry[i].valid = FALSE;
-            --f->cur_size;
-            return;
-        }
+        ++d->writes;
+        d->write_latency += latency;
     }
-
-    for (i = 0; i < b->cur_idx; ++i)
+    else
     {
-        if ((b->entry[i].valid) && (b->entry[i].addr == addr)
-            && (b->entry[i].type == MEM_ACCESS_WRITE))
-        {
-            b->entry[i].valid = FALSE;
-            --b->cur_size;
-            return;
-        }
+        ++d->reads;
+        d->read_latency += latency;
     }
+    latency_histogram_add(d->latency_hist[e->type], latency);
 }
 
 int
@@ -231,8 +223,7 @@ dram_send_request(Dram *d, PendingMemAccessEntry *e)
      * controller */
     if (e->type == MEM_ACCESS_WRITE)
     {
-        write_complete_callback(e->addr, d->frontend_mem_access_queue,
-                                d->backend_mem_access_queue);
+        complete_callback(e);
     }
 
     d->active_mem_request = e;
@@ -243,19 +234,23 @@ dram_send_request(Dram *d, PendingMemAccessEntry *e)
 int
 dram_clock(Dram *d)
 {
+    d->clock++;
+
     if (d->mem_access_active)
     {
         if (d->elasped_clock_cycles == d->max_clock_cycles)
         {
+            dram_account_request(d, d->active_mem_request);
             d->mem_access_active = FALSE;
             d->max_clock_cycles = 0;
             d->elasped_clock_cycles = 0;
 
-            if (d->active_mem_request->type == MEM_ACCESS_READ)
+            /* Requests invalidated after they were sent belong to a pipeline
+             * which was flushed since */
+            if ((d->active_mem_request->type == MEM_ACCESS_READ)
+                && d->active_mem_request->valid)
             {
-                read_complete_callback(d->active_mem_request->addr,
-                                       d->frontend_mem_access_queue,
-                                       d->backend_mem_access_queue);
+                complete_callback(d->active_mem_request);
             }
 
             d->active_mem_request->valid = FALSE;
@@ -282,9 +277,36 @@ dram_reset(Dram *d)
     d->last_accessed_page_num = 0;
 }
 
+void
+dram_reset_stats(Dram *d)
+{
+    d->reads = 0;
+    d->writes = 0;
+    d->read_latency = 0;
+    d->write_latency = 0;
+    memset((void *)d->latency_hist, 0, sizeof(d->latency_hist));
+}
+
+void
+dram_register_stats(const Dram *d, SimRegistry *r, const char *module)
+{
+    sim_registry_add_counter(r, module, "reads", &d->reads);
+    sim_registry_add_counter(r, module, "writes", &d->writes);
+    sim_registry_add_counter(r, module, "read_latency", &d->read_latency);
+    sim_registry_add_counter(r, module, "write_latency", &d->write_latency);
+    sim_registry_add_latency_histogram(r, module, "read_latency_hist",
+                                       d->latency_hist[MEM_ACCESS_READ]);
+    sim_registry_add_latency_histogram(r, module, "write_latency_hist",
+                                       d->latency_hist[MEM_ACCESS_WRITE]);
+
+    if (d->analytical_dram)
+    {
+        analytical_dram_register_stats(d->analytical_dram, r, module);
+    }
+}
+
 Dram *
-dram_create(const SimParams *p, StageMemAccessQueue *f,
-                 StageMemAccessQueue *b)
+dram_create(const SimParams *p)
 {
     Dram *d;
 
@@ -292,8 +314,6 @@ dram_create(const SimParams *p, StageMemAccessQueue *f,
     assert(d);
 
     d->mem_access_latency = p->mem_access_latency;
-    d->frontend_mem_access_queue = f;
-    d->backend_mem_access_queue = b;
 
     d->dram_model_type = p->dram_model_type;
 
@@ -314,11 +334,21 @@ dram_create(const SimParams *p, StageMemAccessQueue *f,
         case MEM_MODEL_RAMULATOR:
         {
             ramulator_wrapper_init(p->ramulator_config_file,
-                                   p->cache_line_size);
+                                   sim_params_get_llc_line_size(p));
             d->get_max_clock_cycles_for_request
                 = &ramulator_get_max_clock_cycles;
             break;
         }
+        case MEM_MODEL_ANALYTICAL:
+        {
+            /* If caches are enabled, only the LLC sends requests to memory */
+            d->analytical_dram = analytical_dram_create(
+                p, p->enable_l1_caches ? sim_params_get_llc_line_size(p)
+                                       : p->burst_length);
+            d->get_max_clock_cycles_for_request
+                = &analytical_dram_model_get_max_clock_cycles;
+            break;
+        }
     }
 
     dram_reset(d);
@@ -345,6 +375,11 @@ dram_free(Dram **d)
             ramulator_wrapper_destroy();
             break;
         }
+        case MEM_MODEL_ANALYTICAL:
+        {
+            analytical_dram_free(&(*d)->analytical_dram);
+            break;
+        }
     }
     free(*d);
 }
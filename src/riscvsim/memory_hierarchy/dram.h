@@ -30,6 +30,8 @@
 #include "../../cutils.h"
 #include "../riscv_sim_typedefs.h"
 #include "../utils/sim_params.h"
+#include "../utils/sim_registry.h"
+#include "analytical_dram.h"
 #include "memory_controller_utils.h"
 
 typedef struct Dram
@@ -48,11 +50,6 @@ typedef struct Dram
     int max_clock_cycles;
     PendingMemAccessEntry *active_mem_request;
 
-    /* These queues are used to control the stall on fetch and memory CPU
-     * pipeline stages */
-    StageMemAccessQueue *frontend_mem_access_queue;
-    StageMemAccessQueue *backend_mem_access_queue;
-
     /* Set based on type of DRAM model used: base or dramsim */
     int (*get_max_clock_cycles_for_request)(struct Dram *d,
                                             PendingMemAccessEntry *e);
@@ -62,13 +59,28 @@ typedef struct Dram
 
     /* Fixed configurable latency in CPU cycles used by the base DRAM model */
     int mem_access_latency;
+
+    /* Following parameters are used by analytical DRAM model */
+    AnalyticalDram *analytical_dram;
+
+    /* CPU cycles elapsed since the creation of DRAM */
+    uint64_t clock;
+
+    /* Requests processed by any DRAM model, and their latency in CPU cycles
+     * from the end of their cache lookup, per MemAccessType */
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t read_latency;
+    uint64_t write_latency;
+    uint64_t latency_hist[NUM_MEM_ACCESS_TYPES][NUM_LATENCY_BUCKETS];
 } Dram;
 
-Dram *dram_create(const SimParams *p, StageMemAccessQueue *f,
-                  StageMemAccessQueue *b);
+Dram *dram_create(const SimParams *p);
 int dram_can_accept_request(const Dram *d);
 int dram_clock(Dram *d);
 void dram_reset(Dram *d);
+void dram_reset_stats(Dram *d);
+void dram_register_stats(const Dram *d, SimRegistry *r, const char *module);
 void dram_send_request(Dram *d, PendingMemAccessEntry *e);
 void dram_free(Dram **d);
 #endif /* _BASE_DRAM_H_ */
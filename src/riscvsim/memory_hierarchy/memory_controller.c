@@ -51,13 +51,6 @@ mem_controller_log_config(const MemoryController *m)
 void
 mem_controller_reset(MemoryController *m)
 {
-    /* Invalidate the entries added to mem_request_queue on the speculated path */
-    mem_controller_invalidate_mem_request_queue_entries(
-        m, &m->frontend_mem_access_queue);
-    mem_controller_invalidate_mem_request_queue_entries(
-        m, &m->backend_mem_access_queue);
-    mem_controller_reset_cpu_stage_queue(&m->frontend_mem_access_queue);
-    mem_controller_reset_cpu_stage_queue(&m->backend_mem_access_queue);
     mem_controller_reset_mem_request_queue(m);
     dram_reset(m->dram);
 }
@@ -73,6 +66,12 @@ mem_controller_reset_cpu_stage_queue(StageMemAccessQueue *q)
 {
     q->cur_idx = 0;
     q->cur_size = 0;
+    q->deferred = 0;
+    q->deferred_delay = 0;
+    q->deferred_wait = 0;
+    q->deferred_entry = FALSE;
+    q->lookup_complete = FALSE;
+    q->mem_level = NULL;
 }
 
 void
@@ -83,9 +82,11 @@ mem_controller_reset_mem_request_queue(MemoryController *m)
 
 static void
 fill_memory_request_entry(PendingMemAccessEntry *e, target_ulong paddr,
-                          MemAccessType type, int is_pte)
+                          MemAccessType type, int is_pte,
+                          StageMemAccessQueue *stage_queue)
 {
     e->addr = paddr;
+    e->stage_queue = stage_queue;
     e->type = type;
     e->req_pte = is_pte;
     e->valid = TRUE;
@@ -101,9 +102,29 @@ mem_controller_create_mem_request(MemoryController *m, target_ulong paddr,
                                   void *p_mem_access_info)
 {
     target_ulong start_offset;
-    int index, source_cpu_stage_id;
+    int index;
+    StageMemAccessQueue *q;
+    const MemAccessInfo *info = (const MemAccessInfo *)p_mem_access_info;
 
-    source_cpu_stage_id = *(int *)p_mem_access_info;
+    switch (info->stage_id)
+    {
+        case FETCH:
+        {
+            q = info->frontend_mem_access_queue;
+            break;
+        }
+        case MEMORY:
+        {
+            q = info->backend_mem_access_queue;
+            break;
+        }
+        default:
+        {
+            sim_assert((0), "error: %s at line %d in %s(): %s", __FILE__,
+                       __LINE__, __func__,
+                       "memory access generated by incorrect pipeline stage");
+        }
+    }
 
     /*  Align the address for this access to the burst_length */
     start_offset = paddr % m->burst_length;
@@ -115,36 +136,10 @@ mem_controller_create_mem_request(MemoryController *m, target_ulong paddr,
 
     while (bytes_to_access > 0)
     {
-        switch (source_cpu_stage_id)
-        {
-            case FETCH:
-            {
-                fill_memory_request_entry(
-                    &m->frontend_mem_access_queue
-                         .entry[m->frontend_mem_access_queue.cur_idx],
-                    paddr, type, FALSE);
-                ++m->frontend_mem_access_queue.cur_idx;
-                ++m->frontend_mem_access_queue.cur_size;
-                break;
-            }
-            case MEMORY:
-            {
-                fill_memory_request_entry(
-                    &m->backend_mem_access_queue
-                         .entry[m->backend_mem_access_queue.cur_idx],
-                    paddr, type, FALSE);
-                ++m->backend_mem_access_queue.cur_idx;
-                ++m->backend_mem_access_queue.cur_size;
-                break;
-            }
-            default:
-            {
-                sim_assert(
-                    (0), "error: %s at line %d in %s(): %s", __FILE__, __LINE__,
-                    __func__,
-                    "memory access generated by incorrect pipeline stage");
-            }
-        }
+        fill_memory_request_entry(&q->entry[q->cur_idx], paddr, type, FALSE,
+                                  q);
+        ++q->cur_idx;
+        ++q->cur_size;
 
         /* Add requests to the mem_request_queue */
         index = cq_enqueue(&m->mem_request_queue.cq);
@@ -153,7 +148,7 @@ mem_controller_create_mem_request(MemoryController *m, target_ulong paddr,
                    __LINE__, __func__, "memory request queue is full");
 
         fill_memory_request_entry(&m->mem_request_queue.entry[index], paddr,
-                                  type, FALSE);
+                                  type, FALSE, q);
 
         /* Calculate remaining transactions for this access */
         bytes_to_access -= m->burst_length;
@@ -205,22 +200,11 @@ mem_controller_init(const SimParams *p)
     m->burst_length = p->burst_length;
     m->dram_model_type = p->dram_model_type;
 
-    m->frontend_mem_access_queue.max_size = FRONTEND_MEM_ACCESS_QUEUE_SIZE;
-    m->frontend_mem_access_queue.entry = (PendingMemAccessEntry *)calloc(
-        m->frontend_mem_access_queue.max_size, sizeof(PendingMemAccessEntry));
-    assert(m->frontend_mem_access_queue.entry);
-
-    m->backend_mem_access_queue.max_size = BACKEND_MEM_ACCESS_QUEUE_SIZE;
-    m->backend_mem_access_queue.entry = (PendingMemAccessEntry *)calloc(
-        m->backend_mem_access_queue.max_size, sizeof(PendingMemAccessEntry));
-    assert(m->backend_mem_access_queue.entry);
-
     cq_init(&m->mem_request_queue.cq, MEM_REQUEST_QUEUE_SIZE);
     memset((void *)m->mem_request_queue.entry, 0,
            sizeof(PendingMemAccessEntry) * MEM_REQUEST_QUEUE_SIZE);
 
-    m->dram = dram_create(p, &m->frontend_mem_access_queue,
-                          &m->backend_mem_access_queue);
+    m->dram = dram_create(p);
 
     switch (m->dram_model_type)
     {
@@ -239,6 +223,11 @@ mem_controller_init(const SimParams *p)
             mem_controller_set_burst_length(m, p->burst_length);
             break;
         }
+        case MEM_MODEL_ANALYTICAL:
+        {
+            mem_controller_set_burst_length(m, p->burst_length);
+            break;
+        }
         default:
         {
             sim_assert((0), "error: %s at line %d in %s(): %s", __FILE__,
@@ -253,14 +242,50 @@ void
 mem_controller_free(MemoryController **m)
 {
     dram_free(&(*m)->dram);
-    free((*m)->backend_mem_access_queue.entry);
-    (*m)->backend_mem_access_queue.entry = NULL;
-    free((*m)->frontend_mem_access_queue.entry);
-    (*m)->frontend_mem_access_queue.entry = NULL;
     free(*m);
     *m = NULL;
 }
 
+/* The DRAM latency of a request counts from the end of its cache lookup, so
+ * that it includes the time spent waiting for the requests ahead */
+static void
+start_mem_request(MemoryController *m, PendingMemAccessEntry *e)
+{
+    if (!e->start_access)
+    {
+        e->start_access = TRUE;
+        e->start_cycle = m->dram->clock;
+    }
+}
+
+/* Requests of the hart owning stage_queue for the address of one of its
+ * entries */
+static int
+stage_request(const PendingMemAccessEntry *e,
+              const StageMemAccessQueue *stage_queue, target_ulong addr)
+{
+    return (e->stage_queue == stage_queue) && (e->addr == addr);
+}
+
+/* Releases the entry held by the lookups of the stage queued until the end of
+ * the cycle, once they are done and the stage has waited for their latency */
+static int
+stage_lookups_done(StageMemAccessQueue *q)
+{
+    if (q->deferred || (q->deferred_wait < q->deferred_delay))
+    {
+        return FALSE;
+    }
+
+    q->deferred_entry = FALSE;
+    q->lookup_complete = FALSE;
+    --q->cur_size;
+    return TRUE;
+}
+
+/* Starts the requests generated by the cache lookup of the stage. If the
+ * lookup was queued until the end of the cycle, this is repeated by
+ * memory_hierarchy_clock() every cycle until it is done. */
 void
 mem_controller_cache_lookup_complete_signal(MemoryController *m,
                                             StageMemAccessQueue *stage_queue)
@@ -268,6 +293,15 @@ mem_controller_cache_lookup_complete_signal(MemoryController *m,
     int i, j;
     target_ulong addr;
 
+    if (stage_queue->deferred_entry)
+    {
+        stage_queue->lookup_complete = TRUE;
+        if (!stage_lookups_done(stage_queue))
+        {
+            return;
+        }
+    }
+
     for (j = 0; j < stage_queue->cur_idx; ++j)
     {
         addr = stage_queue->entry[j].addr;
@@ -279,9 +313,10 @@ mem_controller_cache_lookup_complete_signal(MemoryController *m,
                 for (i = m->mem_request_queue.cq.front;
                      i <= m->mem_request_queue.cq.rear; i++)
                 {
-                    if (m->mem_request_queue.entry[i].addr == addr)
+                    if (stage_request(&m->mem_request_queue.entry[i],
+                                      stage_queue, addr))
                     {
-                        m->mem_request_queue.entry[i].start_access = TRUE;
+                        start_mem_request(m, &m->mem_request_queue.entry[i]);
                     }
                 }
             }
@@ -290,17 +325,19 @@ mem_controller_cache_lookup_complete_signal(MemoryController *m,
                 for (i = m->mem_request_queue.cq.front;
                      i < m->mem_request_queue.cq.max_size; i++)
                 {
-                    if (m->mem_request_queue.entry[i].addr == addr)
+                    if (stage_request(&m->mem_request_queue.entry[i],
+                                      stage_queue, addr))
                     {
-                        m->mem_request_queue.entry[i].start_access = TRUE;
+                        start_mem_request(m, &m->mem_request_queue.entry[i]);
                     }
                 }
 
                 for (i = 0; i <= m->mem_request_queue.cq.rear; i++)
                 {
-                    if (m->mem_request_queue.entry[i].addr == addr)
+                    if (stage_request(&m->mem_request_queue.entry[i],
+                                      stage_queue, addr))
                     {
-                        m->mem_request_queue.entry[i].start_access = TRUE;
+                        start_mem_request(m, &m->mem_request_queue.entry[i]);
                     }
                 }
             }
@@ -326,7 +363,8 @@ mem_controller_invalidate_mem_request_queue_entries(
                 for (i = m->mem_request_queue.cq.front;
                      i <= m->mem_request_queue.cq.rear; i++)
                 {
-                    if (m->mem_request_queue.entry[i].addr == addr)
+                    if (stage_request(&m->mem_request_queue.entry[i],
+                                      stage_queue, addr))
                     {
                         m->mem_request_queue.entry[i].valid = FALSE;
                     }
@@ -337,7 +375,8 @@ mem_controller_invalidate_mem_request_queue_entries(
                 for (i = m->mem_request_queue.cq.front;
                      i < m->mem_request_queue.cq.max_size; i++)
                 {
-                    if (m->mem_request_queue.entry[i].addr == addr)
+                    if (stage_request(&m->mem_request_queue.entry[i],
+                                      stage_queue, addr))
                     {
                         m->mem_request_queue.entry[i].valid = FALSE;
                     }
@@ -345,7 +384,8 @@ mem_controller_invalidate_mem_request_queue_entries(
 
                 for (i = 0; i <= m->mem_request_queue.cq.rear; i++)
                 {
-                    if (m->mem_request_queue.entry[i].addr == addr)
+                    if (stage_request(&m->mem_request_queue.entry[i],
+                                      stage_queue, addr))
                     {
                         m->mem_request_queue.entry[i].valid = FALSE;
                     }
@@ -57,19 +57,15 @@ typedef struct MemoryController
     /* Memory controller burst length in bytes (or cache line size) */
     int burst_length;
 
-    /* These queues are used to control the stall on fetch and memory CPU
-     * pipeline stages */
-    StageMemAccessQueue frontend_mem_access_queue;
-    StageMemAccessQueue backend_mem_access_queue;
-
     /* A single FIFO queue known as mem_request_queue comprising all the pending
-     * memory access requests */
+     * memory access requests, of all the harts sharing the controller. Every
+     * request points to the stage queue of its hart, which stalls the fetch or
+     * memory pipeline stage until the request completes. */
     MemRequestQueue mem_request_queue;
-
-    /* To keep track of cache lookup cycle(s) for reading/writing page table
-     * entries during hardware page walk */
-    int page_walk_delay;
     Dram *dram;
+
+    /* Memory hierarchies of the harts sharing the controller */
+    int num_hierarchies;
 } MemoryController;
 
 MemoryController *mem_controller_init(const SimParams *p);
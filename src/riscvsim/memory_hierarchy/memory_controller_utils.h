@@ -35,10 +35,15 @@ typedef enum MemAccessType {
     MEM_ACCESS_WRITE = 0x1,
 } MemAccessType;
 
+#define NUM_MEM_ACCESS_TYPES 2
+
+struct StageMemAccessQueue;
+
 typedef struct PendingMemAccessEntry
 {
     int valid;
     int start_access;
+    uint64_t start_cycle; /* DRAM clock when the cache lookup completed */
     int bytes_to_access;
     int max_bytes_to_access;
     target_ulong addr;
@@ -47,13 +52,38 @@ typedef struct PendingMemAccessEntry
     int stage_queue_index;
     int stage_queue_type;
     MemAccessType type;
+
+    /* Stage queue of the hart which issued the request, signalled once the
+     * request completes */
+    struct StageMemAccessQueue *stage_queue;
 } PendingMemAccessEntry;
 
+/* Passed down the memory hierarchy as p_mem_access_info along with every
+ * access. Memory requests generated on behalf of the access stall the
+ * pipeline stage of the requesting hart, through its stage queues. */
+typedef struct MemAccessInfo
+{
+    int stage_id; /* CPU pipeline stage which generated the access */
+    struct StageMemAccessQueue *frontend_mem_access_queue;
+    struct StageMemAccessQueue *backend_mem_access_queue;
+} MemAccessInfo;
+
 typedef struct StageMemAccessQueue
 {
     int cur_idx;
     int max_size;
     int cur_size;
     PendingMemAccessEntry *entry;
+
+    /* Lookups of the stage queued until the end of the cycle, see
+     * memory_hierarchy_drain(). They hold one more entry in cur_size until
+     * they are done and the stage has waited for the part of their latency
+     * not returned to it. */
+    int deferred;        /* Queued lookups not done yet */
+    int deferred_delay;  /* Latency of the done lookups not returned */
+    int deferred_wait;   /* Cycles waited since the stage signalled */
+    int deferred_entry;  /* Set while the entry is held */
+    int lookup_complete; /* Stage signalled the end of its lookup delay */
+    int *mem_level;      /* Memory level of the access of the stage */
 } StageMemAccessQueue;
 #endif
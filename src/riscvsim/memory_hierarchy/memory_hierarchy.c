@@ -34,14 +34,27 @@
 #include "dramsim_wrapper_c_connector.h"
 #include "memory_hierarchy.h"
 
+static MemAccessInfo
+mem_access_info(MemoryHierarchy *mem_hierarchy, int stage_id)
+{
+    MemAccessInfo info;
+
+    info.stage_id = stage_id;
+    info.frontend_mem_access_queue = &mem_hierarchy->frontend_mem_access_queue;
+    info.backend_mem_access_queue = &mem_hierarchy->backend_mem_access_queue;
+    return info;
+}
+
 static int
 mem_hierarchy_cache_disabled_read(MemoryHierarchy *mem_hierarchy,
                                   target_ulong paddr, int bytes, int stage_id,
                                   int priv)
 {
+    MemAccessInfo info = mem_access_info(mem_hierarchy, stage_id);
+
     mem_controller_create_mem_request(mem_hierarchy->mem_controller, paddr,
                                       bytes, MEM_ACCESS_READ,
-                                      (void *)&stage_id);
+                                      (void *)&info);
     return 1;
 }
 
@@ -50,9 +63,11 @@ mem_hierarchy_cache_disabled_write(MemoryHierarchy *mem_hierarchy,
                                    target_ulong paddr, int bytes, int stage_id,
                                    int priv)
 {
+    MemAccessInfo info = mem_access_info(mem_hierarchy, stage_id);
+
     mem_controller_create_mem_request(mem_hierarchy->mem_controller, paddr,
                                       bytes, MEM_ACCESS_WRITE,
-                                      (void *)&stage_id);
+                                      (void *)&info);
     return 1;
 }
 
@@ -60,7 +75,9 @@ static int
 mem_hierarchy_icache_read(MemoryHierarchy *mem_hierarchy, target_ulong paddr,
                           int bytes, int stage_id, int priv)
 {
-    return cache_read(mem_hierarchy->icache, paddr, bytes, (void *)&stage_id,
+    MemAccessInfo info = mem_access_info(mem_hierarchy, stage_id);
+
+    return cache_read(mem_hierarchy->icache, paddr, bytes, (void *)&info,
                       priv);
 }
 
@@ -68,7 +85,9 @@ static int
 mem_hierarchy_dcache_read(MemoryHierarchy *mem_hierarchy, target_ulong paddr,
                           int bytes, int stage_id, int priv)
 {
-    return cache_read(mem_hierarchy->dcache, paddr, bytes, (void *)&stage_id,
+    MemAccessInfo info = mem_access_info(mem_hierarchy, stage_id);
+
+    return cache_read(mem_hierarchy->dcache, paddr, bytes, (void *)&info,
                       priv);
 }
 
@@ -76,16 +95,68 @@ static int
 mem_hierarchy_dcache_write(MemoryHierarchy *mem_hierarchy, target_ulong paddr,
                            int bytes, int stage_id, int priv)
 {
-    return cache_write(mem_hierarchy->dcache, paddr, bytes, (void *)&stage_id,
+    MemAccessInfo info = mem_access_info(mem_hierarchy, stage_id);
+
+    return cache_write(mem_hierarchy->dcache, paddr, bytes, (void *)&info,
                        priv);
 }
 
+static int
+mem_hierarchy_coherent_dcache_read(MemoryHierarchy *mem_hierarchy,
+                                   target_ulong paddr, int bytes, int stage_id,
+                                   int priv)
+{
+    MemAccessInfo info = mem_access_info(mem_hierarchy, stage_id);
+
+    return coherence_read(mem_hierarchy->directory,
+                          mem_hierarchy->coherence_agent, paddr, bytes,
+                          (void *)&info, priv)
+           + cache_read(mem_hierarchy->dcache, paddr, bytes, (void *)&info,
+                        priv);
+}
+
+static int
+mem_hierarchy_coherent_dcache_write(MemoryHierarchy *mem_hierarchy,
+                                    target_ulong paddr, int bytes,
+                                    int stage_id, int priv)
+{
+    MemAccessInfo info = mem_access_info(mem_hierarchy, stage_id);
+
+    return coherence_write(mem_hierarchy->directory,
+                           mem_hierarchy->coherence_agent, paddr, bytes,
+                           (void *)&info, priv)
+           + cache_write(mem_hierarchy->dcache, paddr, bytes,
+                         (void *)&info, priv);
+}
+
+static int
+mem_hierarchy_coherent_dcache_own(MemoryHierarchy *mem_hierarchy,
+                                  target_ulong paddr, int bytes, int stage_id,
+                                  int priv)
+{
+    MemAccessInfo info = mem_access_info(mem_hierarchy, stage_id);
+
+    return coherence_write(mem_hierarchy->directory,
+                           mem_hierarchy->coherence_agent, paddr, bytes,
+                           (void *)&info, priv);
+}
+
+static int
+mem_hierarchy_no_coherence_own(MemoryHierarchy *mem_hierarchy,
+                               target_ulong paddr, int bytes, int stage_id,
+                               int priv)
+{
+    return 0;
+}
+
 static int
 mem_hierarchy_pte_read_cache(MemoryHierarchy *mem_hierarchy,
                               target_ulong paddr, int bytes, int stage_id,
                               int priv)
 {
-    return cache_read(mem_hierarchy->page_walk_cache, paddr, bytes, (void *)&stage_id,
+    MemAccessInfo info = mem_access_info(mem_hierarchy, stage_id);
+
+    return cache_read(mem_hierarchy->page_walk_cache, paddr, bytes, (void *)&info,
                       priv);
 }
 
@@ -93,10 +164,198 @@ static int
 mem_hierarchy_pte_write_cache(MemoryHierarchy *mem_hierarchy, target_ulong paddr,
                         int bytes, int stage_id, int priv)
 {
-    return cache_write(mem_hierarchy->page_walk_cache, paddr, bytes, (void *)&stage_id,
+    MemAccessInfo info = mem_access_info(mem_hierarchy, stage_id);
+
+    return cache_write(mem_hierarchy->page_walk_cache, paddr, bytes, (void *)&info,
                        priv);
 }
 
+/* Latency returned to the stage for a queued lookup, the stage waits for the
+ * rest of the latency once the lookup is done. Writes are not timed. */
+static const int deferred_lookup_delay[NUM_MEM_LOOKUP_TYPES] = {
+    1, 1, -1, 0, 1, -1,
+};
+
+static StageMemAccessQueue *
+lookup_stage_queue(MemoryHierarchy *mem_hierarchy, int stage_id)
+{
+    if (FETCH == stage_id)
+    {
+        return &mem_hierarchy->frontend_mem_access_queue;
+    }
+
+    return &mem_hierarchy->backend_mem_access_queue;
+}
+
+/* Returns TRUE if the lookup hits in the private L1 caches of the hart, with
+ * the coherence permission needed, so that it touches nothing shared with the
+ * other harts */
+static int
+lookup_is_private(const MemoryHierarchy *mem_hierarchy, int type,
+                  target_ulong paddr, int bytes)
+{
+    int is_write;
+    int coherent = (NULL != mem_hierarchy->directory);
+    const Cache *c = mem_hierarchy->dcache;
+
+    is_write = (MEM_LOOKUP_DATA_WRITE == type) || (MEM_LOOKUP_DATA_OWN == type)
+               || (MEM_LOOKUP_PTE_WRITE == type);
+    if (MEM_LOOKUP_INSN_READ == type)
+    {
+        c = mem_hierarchy->icache;
+        coherent = FALSE;
+    }
+    else if ((MEM_LOOKUP_PTE_READ == type) || (MEM_LOOKUP_PTE_WRITE == type))
+    {
+        c = mem_hierarchy->page_walk_cache;
+    }
+
+    if (MEM_LOOKUP_DATA_OWN == type)
+    {
+        return !coherent
+               || coherence_permits(mem_hierarchy->directory,
+                                    mem_hierarchy->coherence_agent, paddr,
+                                    bytes, TRUE);
+    }
+
+    if ((NULL == c) || (is_write && (c->cache_write_policy != WriteBack))
+        || !cache_probe(c, paddr, bytes))
+    {
+        return FALSE;
+    }
+
+    return !coherent
+           || coherence_permits(mem_hierarchy->directory,
+                                mem_hierarchy->coherence_agent, paddr, bytes,
+                                is_write);
+}
+
+static int
+defer_lookup(MemoryHierarchy *mem_hierarchy, int type, target_ulong paddr,
+             int bytes, int stage_id, int priv)
+{
+    DeferredLookup *d;
+    StageMemAccessQueue *q;
+
+    if (lookup_is_private(mem_hierarchy, type, paddr, bytes))
+    {
+        return mem_hierarchy->pfn_lookup[type](mem_hierarchy, paddr, bytes,
+                                               stage_id, priv);
+    }
+
+    if (mem_hierarchy->num_deferred == mem_hierarchy->max_deferred)
+    {
+        mem_hierarchy->max_deferred *= 2;
+        mem_hierarchy->deferred = (DeferredLookup *)realloc(
+            mem_hierarchy->deferred,
+            mem_hierarchy->max_deferred * sizeof(DeferredLookup));
+        assert(mem_hierarchy->deferred);
+    }
+
+    d = &mem_hierarchy->deferred[mem_hierarchy->num_deferred++];
+    d->type = type;
+    d->paddr = paddr;
+    d->bytes = bytes;
+    d->stage_id = stage_id;
+    d->priv = priv;
+
+    /* Stage is stalled by an additional entry until the lookups are done */
+    q = lookup_stage_queue(mem_hierarchy, stage_id);
+    if (!q->deferred_entry)
+    {
+        q->deferred_entry = TRUE;
+        q->lookup_complete = FALSE;
+        q->deferred_delay = 0;
+        q->deferred_wait = 0;
+        ++q->cur_size;
+    }
+    ++q->deferred;
+
+    if (deferred_lookup_delay[type] < 0)
+    {
+        return 0;
+    }
+    return deferred_lookup_delay[type];
+}
+
+static int
+mem_hierarchy_deferred_insn_read(MemoryHierarchy *mem_hierarchy,
+                                 target_ulong paddr, int bytes, int stage_id,
+                                 int priv)
+{
+    return defer_lookup(mem_hierarchy, MEM_LOOKUP_INSN_READ, paddr, bytes,
+                        stage_id, priv);
+}
+
+static int
+mem_hierarchy_deferred_data_read(MemoryHierarchy *mem_hierarchy,
+                                 target_ulong paddr, int bytes, int stage_id,
+                                 int priv)
+{
+    return defer_lookup(mem_hierarchy, MEM_LOOKUP_DATA_READ, paddr, bytes,
+                        stage_id, priv);
+}
+
+static int
+mem_hierarchy_deferred_data_write(MemoryHierarchy *mem_hierarchy,
+                                  target_ulong paddr, int bytes, int stage_id,
+                                  int priv)
+{
+    return defer_lookup(mem_hierarchy, MEM_LOOKUP_DATA_WRITE, paddr, bytes,
+                        stage_id, priv);
+}
+
+static int
+mem_hierarchy_deferred_data_own(MemoryHierarchy *mem_hierarchy,
+                                target_ulong paddr, int bytes, int stage_id,
+                                int priv)
+{
+    return defer_lookup(mem_hierarchy, MEM_LOOKUP_DATA_OWN, paddr, bytes,
+                        stage_id, priv);
+}
+
+static int
+mem_hierarchy_deferred_pte_read(MemoryHierarchy *mem_hierarchy,
+                                target_ulong paddr, int bytes, int stage_id,
+                                int priv)
+{
+    return defer_lookup(mem_hierarchy, MEM_LOOKUP_PTE_READ, paddr, bytes,
+                        stage_id, priv);
+}
+
+static int
+mem_hierarchy_deferred_pte_write(MemoryHierarchy *mem_hierarchy,
+                                 target_ulong paddr, int bytes, int stage_id,
+                                 int priv)
+{
+    return defer_lookup(mem_hierarchy, MEM_LOOKUP_PTE_WRITE, paddr, bytes,
+                        stage_id, priv);
+}
+
+static void
+mem_hierarchy_set_deferred_lookups(MemoryHierarchy *m)
+{
+    m->defer_lookups = TRUE;
+    m->max_deferred = 16;
+    m->deferred
+        = (DeferredLookup *)calloc(m->max_deferred, sizeof(DeferredLookup));
+    assert(m->deferred);
+
+    m->pfn_lookup[MEM_LOOKUP_INSN_READ] = m->insn_read_delay;
+    m->pfn_lookup[MEM_LOOKUP_DATA_READ] = m->data_read_delay;
+    m->pfn_lookup[MEM_LOOKUP_DATA_WRITE] = m->data_write_delay;
+    m->pfn_lookup[MEM_LOOKUP_DATA_OWN] = m->data_own_delay;
+    m->pfn_lookup[MEM_LOOKUP_PTE_READ] = m->pte_read_delay;
+    m->pfn_lookup[MEM_LOOKUP_PTE_WRITE] = m->pte_write_delay;
+
+    m->insn_read_delay = &mem_hierarchy_deferred_insn_read;
+    m->data_read_delay = &mem_hierarchy_deferred_data_read;
+    m->data_write_delay = &mem_hierarchy_deferred_data_write;
+    m->data_own_delay = &mem_hierarchy_deferred_data_own;
+    m->pte_read_delay = &mem_hierarchy_deferred_pte_read;
+    m->pte_write_delay = &mem_hierarchy_deferred_pte_write;
+}
+
 static void
 mem_hierarchy_set_page_walk_cache(MemoryHierarchy *m, const SimParams *p)
 {
@@ -114,28 +373,62 @@ mem_hierarchy_set_page_walk_cache(MemoryHierarchy *m, const SimParams *p)
     }
 }
 
+/* If shared is not NULL, the shared cache levels and the memory controller of
+ * shared are used, and only the private L1 caches are created. If l1_sibling
+ * is not NULL, its L1 caches are used as well. */
 MemoryHierarchy *
-memory_hierarchy_init(const SimParams *p, SimLog *log)
+memory_hierarchy_init(const SimParams *p, SimLog *log,
+                      const MemoryHierarchy *shared,
+                      const MemoryHierarchy *l1_sibling)
 {
-    int words_per_cache_line;
+    int i;
+    Cache *next_level_cache;
     MemoryHierarchy *mem_hierarchy;
 
     mem_hierarchy = (MemoryHierarchy *)calloc(1, sizeof(MemoryHierarchy));
     assert(mem_hierarchy);
     mem_hierarchy->p = (SimParams *)p;
 
+    mem_hierarchy->owns_shared_levels = (NULL == shared);
+    mem_hierarchy->owns_l1_caches = (NULL == l1_sibling);
+    mem_hierarchy->owns_mem_controller = mem_hierarchy->owns_shared_levels;
+
     /* Setup memory controller */
-    mem_hierarchy->mem_controller = mem_controller_init(p);
+    if (mem_hierarchy->owns_mem_controller)
+    {
+        mem_hierarchy->mem_controller = mem_controller_init(p);
+    }
+    else
+    {
+        mem_hierarchy->mem_controller = shared->mem_controller;
+    }
+    ++mem_hierarchy->mem_controller->num_hierarchies;
+
+    mem_hierarchy->frontend_mem_access_queue.max_size
+        = FRONTEND_MEM_ACCESS_QUEUE_SIZE;
+    mem_hierarchy->frontend_mem_access_queue.entry
+        = (PendingMemAccessEntry *)calloc(
+            mem_hierarchy->frontend_mem_access_queue.max_size,
+            sizeof(PendingMemAccessEntry));
+    assert(mem_hierarchy->frontend_mem_access_queue.entry);
+
+    mem_hierarchy->backend_mem_access_queue.max_size
+        = BACKEND_MEM_ACCESS_QUEUE_SIZE;
+    mem_hierarchy->backend_mem_access_queue.entry
+        = (PendingMemAccessEntry *)calloc(
+            mem_hierarchy->backend_mem_access_queue.max_size,
+            sizeof(PendingMemAccessEntry));
+    assert(mem_hierarchy->backend_mem_access_queue.entry);
 
     /* Setup caches */
-    if (p->enable_l1_caches)
+    if (p->enable_l1_caches && mem_hierarchy->owns_shared_levels)
     {
-        words_per_cache_line = p->cache_line_size /  sizeof(target_ulong);
         mem_hierarchy->cache_line_size = p->cache_line_size;
 
-        /* If caches are enabled, set burst length to cache line size */
+        /* If caches are enabled, set burst length to the line size of the
+         * last level cache, as only the LLC sends requests to memory */
         mem_controller_set_burst_length(mem_hierarchy->mem_controller,
-                                        mem_hierarchy->cache_line_size);
+                                        sim_params_get_llc_line_size(p));
 
         /* If DRAMSim3 memory model is used, its burst length must be equal to
          * cache line size */
@@ -145,51 +438,97 @@ memory_hierarchy_init(const SimParams *p, SimLog *log)
                         == dramsim_get_burst_size()),
                        "error: %s at line %d in %s(): %s", __FILE__, __LINE__,
                        __func__, "DRAMSim3 burst length must be equal to "
-                                 "MARSS-RISCV cache line size or CPU memory "
+                                 "MARSS-RISCV LLC line size or CPU memory "
                                  "controller burst length");
         }
 
-        if (p->enable_l2_cache)
+        /* Shared levels are created starting from the LLC, so that every
+         * level can be linked to the level below it */
+        mem_hierarchy->num_shared_cache_levels = p->num_shared_cache_levels;
+        next_level_cache = NULL;
+        for (i = mem_hierarchy->num_shared_cache_levels - 1; i >= 0; --i)
+        {
+            sim_log_event_to_file(log, "Setting up L%d-cache", i + 2);
+            mem_hierarchy->shared_caches[i] = cache_init(
+                SharedCache, (CacheLevels)(L2 + i), &p->shared_cache[i],
+                next_level_cache, mem_hierarchy->mem_controller);
+            next_level_cache = mem_hierarchy->shared_caches[i];
+        }
+
+        /* Private data caches are kept coherent only if there are multiple
+         * harts */
+        if ((p->num_harts > 1) && (p->coherence_protocol != COHERENCE_NONE))
+        {
+            mem_hierarchy->directory
+                = coherence_init(p, p->l1_data_cache.line_size);
+        }
+    }
+    else if (p->enable_l1_caches)
+    {
+        mem_hierarchy->cache_line_size = p->cache_line_size;
+        if (mem_hierarchy->owns_mem_controller)
         {
-            sim_log_event_to_file(log, "%s", "Setting up L2-cache");
-            mem_hierarchy->l2_cache = cache_init(
-                SharedCache, L2, p->l2_shared_cache_size,
-                mem_hierarchy->cache_line_size, p->l2_shared_cache_ways,
-                p->l2_shared_cache_read_latency,
-                p->l2_shared_cache_write_latency, NULL, words_per_cache_line,
-                p->l2_shared_cache_evict,
-                (CacheWritePolicy)p->cache_write_policy,
-                (CacheReadAllocPolicy)p->cache_read_allocate_policy,
-                (CacheWriteAllocPolicy)p->cache_write_allocate_policy,
-                mem_hierarchy->mem_controller);
+            mem_controller_set_burst_length(mem_hierarchy->mem_controller,
+                                            shared->mem_controller
+                                                ->burst_length);
+        }
+        mem_hierarchy->num_shared_cache_levels
+            = shared->num_shared_cache_levels;
+        for (i = 0; i < mem_hierarchy->num_shared_cache_levels; ++i)
+        {
+            mem_hierarchy->shared_caches[i] = shared->shared_caches[i];
+        }
+        mem_hierarchy->directory = shared->directory;
+    }
+
+    if (p->enable_l1_caches && !mem_hierarchy->owns_l1_caches)
+    {
+        mem_hierarchy->icache = l1_sibling->icache;
+        mem_hierarchy->dcache = l1_sibling->dcache;
+        mem_hierarchy->coherence_agent = l1_sibling->coherence_agent;
+    }
+    else if (p->enable_l1_caches)
+    {
+        next_level_cache = NULL;
+        if (mem_hierarchy->num_shared_cache_levels)
+        {
+            next_level_cache = mem_hierarchy->shared_caches[0];
         }
 
         sim_log_event_to_file(log, "%s", "Setting up L1-instruction cache");
-        mem_hierarchy->icache = cache_init(
-            InstructionCache, L1, p->l1_code_cache_size,
-            mem_hierarchy->cache_line_size, p->l1_code_cache_ways,
-            p->l1_code_cache_read_latency, 1, mem_hierarchy->l2_cache,
-            words_per_cache_line, p->l1_code_cache_evict,
-            (CacheWritePolicy)p->cache_write_policy,
-            (CacheReadAllocPolicy)p->cache_read_allocate_policy,
-            (CacheWriteAllocPolicy)p->cache_write_allocate_policy,
-            mem_hierarchy->mem_controller);
+        mem_hierarchy->icache
+            = cache_init(InstructionCache, L1, &p->l1_code_cache,
+                         next_level_cache, mem_hierarchy->mem_controller);
 
         sim_log_event_to_file(log, "%s", "Setting up L1-data cache");
-        mem_hierarchy->dcache = cache_init(
-            DataCache, L1, p->l1_data_cache_size,
-            mem_hierarchy->cache_line_size, p->l1_data_cache_ways,
-            p->l1_data_cache_read_latency, p->l1_data_cache_write_latency,
-            mem_hierarchy->l2_cache, words_per_cache_line,
-            p->l1_data_cache_evict, (CacheWritePolicy)p->cache_write_policy,
-            (CacheReadAllocPolicy)p->cache_read_allocate_policy,
-            (CacheWriteAllocPolicy)p->cache_write_allocate_policy,
-            mem_hierarchy->mem_controller);
+        mem_hierarchy->dcache
+            = cache_init(DataCache, L1, &p->l1_data_cache, next_level_cache,
+                         mem_hierarchy->mem_controller);
+
+        if (p->enable_victim_cache)
+        {
+            sim_log_event_to_file(log, "%s", "Setting up victim cache");
+            cache_add_victim_cache(mem_hierarchy->dcache,
+                                   p->victim_cache_entries,
+                                   p->victim_cache_latency);
+        }
+
+        if (NULL != mem_hierarchy->directory)
+        {
+            mem_hierarchy->coherence_agent = coherence_add_agent(
+                mem_hierarchy->directory, mem_hierarchy->dcache);
+        }
     }
 
     mem_hierarchy_set_page_walk_cache(mem_hierarchy, p);
 
-    if (mem_hierarchy->page_walk_cache)
+    if (mem_hierarchy->page_walk_cache && mem_hierarchy->directory)
+    {
+        /* Page walk cache is the L1 data cache */
+        mem_hierarchy->pte_read_delay = &mem_hierarchy_coherent_dcache_read;
+        mem_hierarchy->pte_write_delay = &mem_hierarchy_coherent_dcache_write;
+    }
+    else if (mem_hierarchy->page_walk_cache)
     {
         mem_hierarchy->pte_read_delay = &mem_hierarchy_pte_read_cache;
         mem_hierarchy->pte_write_delay = &mem_hierarchy_pte_write_cache;
@@ -200,7 +539,15 @@ memory_hierarchy_init(const SimParams *p, SimLog *log)
         mem_hierarchy->pte_write_delay = &mem_hierarchy_cache_disabled_write;
     }
 
-    if (p->enable_l1_caches)
+    mem_hierarchy->data_own_delay = &mem_hierarchy_no_coherence_own;
+    if (p->enable_l1_caches && mem_hierarchy->directory)
+    {
+        mem_hierarchy->insn_read_delay = &mem_hierarchy_icache_read;
+        mem_hierarchy->data_read_delay = &mem_hierarchy_coherent_dcache_read;
+        mem_hierarchy->data_write_delay = &mem_hierarchy_coherent_dcache_write;
+        mem_hierarchy->data_own_delay = &mem_hierarchy_coherent_dcache_own;
+    }
+    else if (p->enable_l1_caches)
     {
         mem_hierarchy->insn_read_delay = &mem_hierarchy_icache_read;
         mem_hierarchy->data_read_delay = &mem_hierarchy_dcache_read;
@@ -213,23 +560,184 @@ memory_hierarchy_init(const SimParams *p, SimLog *log)
         mem_hierarchy->data_write_delay = &mem_hierarchy_cache_disabled_write;
     }
 
+    if (p->num_harts > 1)
+    {
+        mem_hierarchy_set_deferred_lookups(mem_hierarchy);
+    }
+
     return mem_hierarchy;
 }
 
+static void
+release_stage_queue(MemoryHierarchy *mem_hierarchy, StageMemAccessQueue *q)
+{
+    if (q->deferred_entry && q->lookup_complete)
+    {
+        mem_controller_cache_lookup_complete_signal(
+            mem_hierarchy->mem_controller, q);
+    }
+}
+
+/* Performs the lookups queued by the hart since the last call. Called for
+ * every hart in hart order, while no hart is running. */
+void
+memory_hierarchy_drain(MemoryHierarchy *mem_hierarchy)
+{
+    int i;
+    int delay;
+    int level;
+    int cur_idx;
+    int stale[2];
+    uint64_t l1_misses;
+    const Cache *l1;
+    const DeferredLookup *d;
+    StageMemAccessQueue *q;
+
+    /* Lookups queued before the stage queue was reset by a flush are
+     * dropped, they come first */
+    stale[0] = -mem_hierarchy->frontend_mem_access_queue.deferred;
+    stale[1] = -mem_hierarchy->backend_mem_access_queue.deferred;
+    for (i = 0; i < mem_hierarchy->num_deferred; ++i)
+    {
+        ++stale[FETCH != mem_hierarchy->deferred[i].stage_id];
+    }
+
+    for (i = 0; i < mem_hierarchy->num_deferred; ++i)
+    {
+        d = &mem_hierarchy->deferred[i];
+        if (stale[FETCH != d->stage_id] > 0)
+        {
+            --stale[FETCH != d->stage_id];
+            continue;
+        }
+
+        q = lookup_stage_queue(mem_hierarchy, d->stage_id);
+        l1 = (FETCH == d->stage_id) ? mem_hierarchy->icache
+                                    : mem_hierarchy->dcache;
+        l1_misses = cache_miss_count(l1);
+        cur_idx = q->cur_idx;
+
+        delay = mem_hierarchy->pfn_lookup[d->type](mem_hierarchy, d->paddr,
+                                                   d->bytes, d->stage_id,
+                                                   d->priv)
+                - deferred_lookup_delay[d->type];
+        if ((deferred_lookup_delay[d->type] >= 0) && (delay > 0))
+        {
+            q->deferred_delay += delay;
+        }
+
+        level = MEM_LEVEL_L1;
+        if (q->cur_idx != cur_idx)
+        {
+            level = MEM_LEVEL_DRAM;
+        }
+        else if (cache_miss_count(l1) != l1_misses)
+        {
+            level = MEM_LEVEL_L2;
+        }
+
+        if ((NULL != q->mem_level) && (level > *q->mem_level))
+        {
+            *q->mem_level = level;
+        }
+    }
+
+    mem_hierarchy->num_deferred = 0;
+    mem_hierarchy->frontend_mem_access_queue.deferred = 0;
+    mem_hierarchy->backend_mem_access_queue.deferred = 0;
+
+    /* The stages which waited for the latency of their lookups already start
+     * their requests before the memory controller is clocked */
+    release_stage_queue(mem_hierarchy,
+                        &mem_hierarchy->frontend_mem_access_queue);
+    release_stage_queue(mem_hierarchy,
+                        &mem_hierarchy->backend_mem_access_queue);
+}
+
+static void
+clock_stage_queue(MemoryHierarchy *mem_hierarchy, StageMemAccessQueue *q)
+{
+    if (q->deferred_entry && q->lookup_complete)
+    {
+        ++q->deferred_wait;
+        release_stage_queue(mem_hierarchy, q);
+    }
+}
+
+/* Called every cycle of the hart before its pipeline, to release the stages
+ * waiting for their queued lookups */
+void
+memory_hierarchy_clock(MemoryHierarchy *mem_hierarchy)
+{
+    if (mem_hierarchy->defer_lookups)
+    {
+        clock_stage_queue(mem_hierarchy,
+                          &mem_hierarchy->frontend_mem_access_queue);
+        clock_stage_queue(mem_hierarchy,
+                          &mem_hierarchy->backend_mem_access_queue);
+    }
+}
+
+/* Drops the memory accesses in flight of the hart, when its pipeline is
+ * flushed. The requests of the other harts sharing the memory controller are
+ * left in progress. */
+void
+memory_hierarchy_flush(MemoryHierarchy *mem_hierarchy)
+{
+    MemoryController *m = mem_hierarchy->mem_controller;
+
+    /* Invalidate the entries added to mem_request_queue on the speculated path */
+    mem_controller_invalidate_mem_request_queue_entries(
+        m, &mem_hierarchy->frontend_mem_access_queue);
+    mem_controller_invalidate_mem_request_queue_entries(
+        m, &mem_hierarchy->backend_mem_access_queue);
+    mem_controller_reset_cpu_stage_queue(
+        &mem_hierarchy->frontend_mem_access_queue);
+    mem_controller_reset_cpu_stage_queue(
+        &mem_hierarchy->backend_mem_access_queue);
+    mem_hierarchy->page_walk_delay = 0;
+    mem_hierarchy->num_deferred = 0;
+
+    if (m->num_hierarchies == 1)
+    {
+        mem_controller_reset(m);
+    }
+}
+
 void
 memory_hierarchy_free(MemoryHierarchy **mem_hierarchy)
 {
+    int i;
+
     if ((*mem_hierarchy)->p->enable_l1_caches)
     {
-        if ((*mem_hierarchy)->l2_cache)
+        if ((*mem_hierarchy)->owns_shared_levels)
+        {
+            for (i = 0; i < (*mem_hierarchy)->num_shared_cache_levels; ++i)
+            {
+                cache_free(&(*mem_hierarchy)->shared_caches[i]);
+            }
+
+            if (NULL != (*mem_hierarchy)->directory)
+            {
+                coherence_free(&(*mem_hierarchy)->directory);
+            }
+        }
+        if ((*mem_hierarchy)->owns_l1_caches)
         {
-            cache_free(&(*mem_hierarchy)->l2_cache);
+            cache_free(&(*mem_hierarchy)->dcache);
+            cache_free(&(*mem_hierarchy)->icache);
         }
-        cache_free(&(*mem_hierarchy)->dcache);
-        cache_free(&(*mem_hierarchy)->icache);
     }
 
-    mem_controller_free(&(*mem_hierarchy)->mem_controller);
+    --(*mem_hierarchy)->mem_controller->num_hierarchies;
+    if ((*mem_hierarchy)->owns_mem_controller)
+    {
+        mem_controller_free(&(*mem_hierarchy)->mem_controller);
+    }
+    free((*mem_hierarchy)->deferred);
+    free((*mem_hierarchy)->backend_mem_access_queue.entry);
+    free((*mem_hierarchy)->frontend_mem_access_queue.entry);
 
     free(*mem_hierarchy);
     *mem_hierarchy = NULL;
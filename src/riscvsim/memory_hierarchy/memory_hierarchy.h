@@ -34,21 +34,80 @@
 #include "../utils/sim_log.h"
 #include "../utils/sim_params.h"
 #include "cache.h"
+#include "coherence.h"
 #include "memory_controller.h"
 
+struct MemoryHierarchy;
+
+typedef int (*PFN_MEM_HIERARCHY_LOOKUP)(struct MemoryHierarchy *mmu,
+                                        target_ulong paddr, int bytes,
+                                        int cpu_stage_id, int priv);
+
+/* Lookups made through the pointers of MemoryHierarchy */
+typedef enum MemLookupType {
+    MEM_LOOKUP_INSN_READ = 0x0,
+    MEM_LOOKUP_DATA_READ = 0x1,
+    MEM_LOOKUP_DATA_WRITE = 0x2,
+    MEM_LOOKUP_DATA_OWN = 0x3,
+    MEM_LOOKUP_PTE_READ = 0x4,
+    MEM_LOOKUP_PTE_WRITE = 0x5,
+} MemLookupType;
+
+#define NUM_MEM_LOOKUP_TYPES 6
+
+typedef struct DeferredLookup
+{
+    int type;
+    target_ulong paddr;
+    int bytes;
+    int stage_id;
+    int priv;
+} DeferredLookup;
+
 /* Memory hierarchy to simulate the delays, We do not model the actual data
  * in the hierarchy for simplicity, but just the addresses for simulating
  * the delays.*/
 typedef struct MemoryHierarchy
 {
     MemoryController *mem_controller;
+
+    /* These queues are used to control the stall on fetch and memory CPU
+     * pipeline stages of the hart, until its requests to the memory
+     * controller complete */
+    StageMemAccessQueue frontend_mem_access_queue;
+    StageMemAccessQueue backend_mem_access_queue;
+
+    /* To keep track of cache lookup cycle(s) for reading/writing page table
+     * entries during hardware page walk */
+    int page_walk_delay;
+
     Cache *icache;
     Cache *dcache;
-    Cache *l2_cache;
+
+    /* Unified caches below L1 ordered from L2 towards the last level cache
+     * (LLC), shared_caches[num_shared_cache_levels - 1] is the LLC */
+    int num_shared_cache_levels;
+    Cache *shared_caches[NUM_MAX_SHARED_CACHE_LEVELS];
     Cache *page_walk_cache;
     SimParams *p;
 
-    /* If caches are enabled */
+    /* In a multi-hart machine, every hart has its own L1 caches, while the
+     * shared cache levels and the memory controller are created once by the
+     * boot hart and referenced by the hierarchy of every other hart. The
+     * stage queues are private to the hart. */
+    int owns_shared_levels;
+    int owns_mem_controller;
+
+    /* The threads of an SMT core share the L1 caches created by the first
+     * thread */
+    int owns_l1_caches;
+
+    /* Directory keeping the L1 data caches of the harts coherent, shared by
+     * all the harts. NULL if coherence is not modeled. */
+    CoherenceDirectory *directory;
+    int coherence_agent;
+
+    /* If caches are enabled, line size of the split L1 caches */
     int cache_line_size;
 
     /* Pointers are set based on whether caches are enabled or disabled */
@@ -59,14 +118,37 @@ typedef struct MemoryHierarchy
     int (*data_write_delay)(struct MemoryHierarchy *mmu, target_ulong paddr,
                             int bytes, int cpu_stage_id, int priv);
 
+    /* Obtains the line in modified state before an LR or AMO, returns the
+     * coherence delay */
+    int (*data_own_delay)(struct MemoryHierarchy *mmu, target_ulong paddr,
+                          int bytes, int cpu_stage_id, int priv);
+
     /* Page table entries read/write delays are simulated via Data Cache, if
      * found, else directly sent to memory */
     int (*pte_read_delay)(struct MemoryHierarchy *mmu, target_ulong paddr,
                           int bytes, int cpu_stage_id, int priv);
     int (*pte_write_delay)(struct MemoryHierarchy *mmu, target_ulong paddr,
                                int bytes, int cpu_stage_id, int priv);
+
+    /* In a multi-hart machine, the lookups which do not hit in the private
+     * L1 caches of the hart are queued, and performed in hart order by
+     * memory_hierarchy_drain() at the end of the cycle, or at the end of the
+     * sync quantum if the harts run on host threads. Only the hart touches
+     * its L1 caches and its coherence directory entries in between, so that
+     * the harts can run in parallel. The pointers above then queue the
+     * lookups, performed by the ones in pfn_lookup. */
+    int defer_lookups;
+    PFN_MEM_HIERARCHY_LOOKUP pfn_lookup[NUM_MEM_LOOKUP_TYPES];
+    DeferredLookup *deferred;
+    int num_deferred;
+    int max_deferred;
 } MemoryHierarchy;
 
-MemoryHierarchy *memory_hierarchy_init(const SimParams *p, SimLog *log);
+MemoryHierarchy *memory_hierarchy_init(const SimParams *p, SimLog *log,
+                                       const MemoryHierarchy *shared,
+                                       const MemoryHierarchy *l1_sibling);
+void memory_hierarchy_flush(MemoryHierarchy *mem_hierarchy);
+void memory_hierarchy_drain(MemoryHierarchy *mem_hierarchy);
+void memory_hierarchy_clock(MemoryHierarchy *mem_hierarchy);
 void memory_hierarchy_free(MemoryHierarchy **mmu);
 #endif
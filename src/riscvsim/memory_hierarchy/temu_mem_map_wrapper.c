@@ -32,28 +32,51 @@
 
 #define MEMORY_OP_A(size)                                                      \
     {                                                                          \
-        uint##size##_t rval;                                                   \
+        uint##size##_t rval, *aptr = NULL;                                     \
         target_ulong addr = e->ins.mem_addr;                                   \
         uint32_t funct3 = e->ins.binary >> 27;                                 \
         switch (funct3)                                                        \
         {                                                                      \
             case 2: /* lr.w */                                                 \
-                if (target_read_u##size(s, &rval, addr))                       \
+                if (target_sim_read_u##size(s, &rval, addr))                   \
                     goto mmu_exception;                                        \
                 val = (int##size##_t)rval;                                     \
-                s->load_res = e->ins.mem_addr;                                 \
+                if (riscv_sim_cpu_reservation_held(s, s->data_guest_paddr))    \
+                {                                                              \
+                    e->ins.lr_yielded = TRUE;                                  \
+                    break;                                                     \
+                }                                                              \
+                target_set_reservation(s, e->ins.mem_addr);                    \
+                s->load_res_val = rval;                                        \
+                s->simcpu->load_res_paddr = s->data_guest_paddr;               \
+                s->simcpu->load_res_clock = s->simcpu->clock;                  \
                 break;                                                         \
             case 3: /* sc.w */                                                 \
-                if (s->load_res == addr)                                       \
+                if ((s->load_res == addr) && s->host_atomics)                  \
+                {                                                              \
+                    if (target_sim_get_atomic_ptr_u##size(s, &aptr, addr))     \
+                        goto mmu_exception;                                    \
+                }                                                              \
+                if (aptr)                                                      \
+                {                                                              \
+                    rval = s->load_res_val;                                    \
+                    val = !__atomic_compare_exchange_n(                        \
+                        aptr, &rval, (uint##size##_t)e->ins.rs2_val, FALSE,    \
+                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);                   \
+                    e->ins.sc_failed = val;                                    \
+                }                                                              \
+                else if (s->load_res == addr)                                  \
                 {                                                              \
-                    if (target_write_u##size(s, addr, e->ins.rs2_val))         \
+                    if (target_sim_write_u##size(s, addr, e->ins.rs2_val))     \
                         goto mmu_exception;                                    \
                     val = 0;                                                   \
                 }                                                              \
                 else                                                           \
                 {                                                              \
+                    e->ins.sc_failed = TRUE;                                   \
                     val = 1;                                                   \
                 }                                                              \
+                s->load_res = (target_ulong)-1;                                \
                 break;                                                         \
             case 1:    /* amiswap.w */                                         \
             case 0:    /* amoadd.w */                                          \
@@ -64,7 +87,18 @@
             case 0x14: /* amomax.w */                                          \
             case 0x18: /* amominu.w */                                         \
             case 0x1c: /* amomaxu.w */                                         \
-                if (target_read_u##size(s, &rval, addr))                       \
+                if (s->host_atomics)                                           \
+                {                                                              \
+                    if (target_sim_get_atomic_ptr_u##size(s, &aptr, addr))     \
+                        goto mmu_exception;                                    \
+                }                                                              \
+                do                                                             \
+                {                                                              \
+                if (aptr)                                                      \
+                {                                                              \
+                    rval = __atomic_load_n(aptr, __ATOMIC_SEQ_CST);            \
+                }                                                              \
+                else if (target_sim_read_u##size(s, &rval, addr))              \
                 {                                                              \
                     goto mmu_exception;                                        \
                 }                                                              \
@@ -103,7 +137,11 @@
                             val2 = (int##size##_t)val;                         \
                         break;                                                 \
                 }                                                              \
-                if (target_write_u##size(s, addr, val2))                       \
+                } while (aptr                                                  \
+                         && !__atomic_compare_exchange_n(                      \
+                             aptr, &rval, (uint##size##_t)val2, FALSE,         \
+                             __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));             \
+                if (!aptr && target_sim_write_u##size(s, addr, val2))          \
                 {                                                              \
                     goto mmu_exception;                                        \
                 }                                                              \
@@ -149,7 +187,7 @@ temu_exec_load_store_insn(RISCVCPUState *s, InstructionLatch *e)
             case 1:
             {
                 uint8_t rval;
-                if (target_read_u8(s, &rval, addr))
+                if (target_sim_read_u8(s, &rval, addr))
                     goto mmu_exception;
                 if (e->ins.is_unsigned)
                 {
@@ -165,7 +203,7 @@ temu_exec_load_store_insn(RISCVCPUState *s, InstructionLatch *e)
             case 2:
             {
                 uint16_t rval;
-                if (target_read_u16(s, &rval, addr))
+                if (target_sim_read_u16(s, &rval, addr))
                     goto mmu_exception;
                 if (e->ins.is_unsigned)
                 {
@@ -181,7 +219,7 @@ temu_exec_load_store_insn(RISCVCPUState *s, InstructionLatch *e)
             case 4:
             {
                 uint32_t rval;
-                if (target_read_u32(s, &rval, addr))
+                if (target_sim_read_u32(s, &rval, addr))
                     goto mmu_exception;
                 if (e->ins.is_unsigned)
                 {
@@ -197,7 +235,7 @@ temu_exec_load_store_insn(RISCVCPUState *s, InstructionLatch *e)
             case 8:
             {
                 uint64_t rval;
-                if (target_read_u64(s, &rval, addr))
+                if (target_sim_read_u64(s, &rval, addr))
                     goto mmu_exception;
                 if (e->ins.is_unsigned)
                 {
@@ -217,28 +255,28 @@ temu_exec_load_store_insn(RISCVCPUState *s, InstructionLatch *e)
         {
             case 1:
             {
-                if (target_write_u8(s, addr, e->ins.rs2_val))
+                if (target_sim_write_u8(s, addr, e->ins.rs2_val))
                     goto mmu_exception;
                 break;
             }
 
             case 2:
             {
-                if (target_write_u16(s, addr, e->ins.rs2_val))
+                if (target_sim_write_u16(s, addr, e->ins.rs2_val))
                     goto mmu_exception;
                 break;
             }
 
             case 4:
             {
-                if (target_write_u32(s, addr, e->ins.rs2_val))
+                if (target_sim_write_u32(s, addr, e->ins.rs2_val))
                     goto mmu_exception;
                 break;
             }
 
             case 8:
             {
-                if (target_write_u64(s, addr, e->ins.rs2_val))
+                if (target_sim_write_u64(s, addr, e->ins.rs2_val))
                     goto mmu_exception;
                 break;
             }
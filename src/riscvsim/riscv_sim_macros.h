@@ -78,6 +78,11 @@
 #define FNMADD_MASK 0x4F
 #define F_ARITHMETIC_MASK 0x53
 
+/* Vector Instructions, the loads and stores use the FLOAD_MASK and
+ * FSTORE_MASK major opcodes with one of these widths */
+#define VECTOR_MASK 0x57
+#define IS_VECTOR_MEM_WIDTH(funct3) (((funct3) == 0) || ((funct3) >= 5))
+
 /* Used as stage IDs for in-order pipeline */
 #define PCGEN 0x0
 #define FETCH 0x1
@@ -107,9 +112,13 @@
 
 #define NUM_MAX_PRV_LEVELS 4
 
+/* Maximum number of unified cache levels below the split L1 caches (L2 up to
+ * L4). The last configured level acts as the last level cache (LLC) */
+#define NUM_MAX_SHARED_CACHE_LEVELS 3
+
 /* Used for updating performance counters */
 
-#define NUM_MAX_INS_TYPES 21
+#define NUM_MAX_INS_TYPES 22
 #define INS_TYPE_LOAD 0x0
 #define INS_TYPE_STORE 0x1
 #define INS_TYPE_ATOMIC 0x2
@@ -131,10 +140,75 @@
 #define INS_TYPE_LOAD_HALF_WORD 0x12
 #define INS_TYPE_LOAD_WORD 0x13
 #define INS_TYPE_LOAD_DOUBLE_WORD 0x14
+#define INS_TYPE_VECTOR 0x15
 
 #define INS_CLASS_INT 0x11
 #define INS_CLASS_FP 0x12
 
+/* Macro-op fusion patterns, named after the instruction pair fused */
+#define NUM_FUSION_PATTERNS 5
+#define FUSION_NONE 0x0
+#define FUSION_LUI_ADDI 0x1
+#define FUSION_AUIPC_JALR 0x2
+#define FUSION_SLLI_SRLI 0x3
+#define FUSION_ADD_LOAD 0x4
+
+/* Top-down categories, each commit slot of every cycle is attributed to one of
+ * these */
+#define NUM_TD_CATEGORIES 9
+#define TD_RETIRING 0x0
+#define TD_BAD_SPECULATION 0x1
+#define TD_FRONTEND_ICACHE 0x2
+#define TD_FRONTEND_ITLB 0x3
+#define TD_FRONTEND_BUBBLE 0x4
+#define TD_BACKEND_CORE 0x5
+#define TD_BACKEND_MEM_L1 0x6
+#define TD_BACKEND_MEM_L2 0x7
+#define TD_BACKEND_MEM_DRAM 0x8
+
+/* Level of the memory hierarchy which served an access, L2 covers all the
+ * shared cache levels below L1 */
+#define MEM_LEVEL_L1 0x0
+#define MEM_LEVEL_L2 0x1
+#define MEM_LEVEL_DRAM 0x2
+
+/* Events counted by the mhpmcounter CSRs, selected by the low byte of the
+ * mhpmevent CSRs. The UINH, SINH and MINH bits of mhpmevent (Sscofpmf) stop
+ * the counting in user, supervisor and machine mode. */
+#define NUM_HPM_EVENTS 15
+#define HPM_EVENT_NONE 0x0
+#define HPM_EVENT_ICACHE_MISS 0x1
+#define HPM_EVENT_DCACHE_READ_MISS 0x2
+#define HPM_EVENT_DCACHE_WRITE_MISS 0x3
+#define HPM_EVENT_L2_MISS 0x4
+#define HPM_EVENT_ITLB_MISS 0x5
+#define HPM_EVENT_DTLB_MISS 0x6
+#define HPM_EVENT_PAGE_WALK 0x7
+#define HPM_EVENT_BRANCH 0x8
+#define HPM_EVENT_BRANCH_MISPREDICT 0x9
+#define HPM_EVENT_INSN_MEM_STALL 0xa
+#define HPM_EVENT_DATA_MEM_STALL 0xb
+#define HPM_EVENT_EXEC_UNIT_STALL 0xc
+#define HPM_EVENT_PIPELINE_FLUSH 0xd
+#define HPM_EVENT_FUSED_PAIR 0xe
+#define HPM_EVENT_MASK 0xffULL
+#define HPM_EVENT_UINH (1ULL << 60)
+#define HPM_EVENT_SINH (1ULL << 61)
+#define HPM_EVENT_MINH (1ULL << 62)
+
+/* Bits of mhpmcounter3..31 in the counteren CSRs and counter bitmaps */
+#define HPM_COUNTERS_MASK 0xfffffff8
+
+/* Region of interest filters, which select the address spaces whose stats are
+ * kept apart from the ones of the other contexts */
+#define ROI_FILTER_NONE 0x0
+#define ROI_FILTER_MARKER 0x1 /* satp of the hart starting the simulation */
+#define ROI_FILTER_ASID 0x2   /* ASID field of satp */
+
+#define NUM_ROI_CONTEXTS 2
+#define ROI_CONTEXT_IN 0x0
+#define ROI_CONTEXT_OTHER 0x1
+
 /* For Branch prediction unit */
 #define BPU_MISS 0x0
 #define BPU_HIT 0x1
@@ -177,5 +251,12 @@
 /* Eviction policies for set associative data structures */
 #define EVICT_POLICY_RANDOM 0x0
 #define EVICT_POLICY_BIT_PLRU 0x1
+#define EVICT_POLICY_TRUE_LRU 0x2
+#define EVICT_POLICY_TREE_PLRU 0x3
+#define EVICT_POLICY_SRRIP 0x4
+#define EVICT_POLICY_BRRIP 0x5
+#define EVICT_POLICY_DRRIP 0x6
+#define EVICT_POLICY_SHIP 0x7
+#define NUM_MAX_EVICT_POLICIES 8
 
 #endif
@@ -119,6 +119,22 @@ cq_full(const CQ *p)
     return 0;
 }
 
+/* Number of elements in the queue */
+int
+cq_count(const CQ *p)
+{
+    if (cq_empty(p))
+    {
+        return 0;
+    }
+
+    if (p->rear >= p->front)
+    {
+        return p->rear - p->front + 1;
+    }
+    return p->max_size - p->front + p->rear + 1;
+}
+
 void
 cq_reset(CQ *p)
 {
@@ -46,6 +46,7 @@ int cq_enqueue(CQ *p);
 int cq_dequeue(CQ *p);
 int cq_empty(const CQ *p);
 int cq_full(const CQ *p);
+int cq_count(const CQ *p);
 int cq_front(const CQ *p);
 int cq_rear(const CQ *p);
 void cq_set_rear(CQ *p, int rear);
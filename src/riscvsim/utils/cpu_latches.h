@@ -33,6 +33,19 @@
 #include "../bpu/bpu.h"
 #include "../decoder/riscv_instruction.h"
 
+/* Cycles at which an instruction went through the pipeline stages, for the
+ * pipeline view trace. 0 means that the stage was not reached. */
+typedef struct PipeStageCycles
+{
+    uint64_t seq; /* Fetch order, 0 if the instruction was not fetched */
+    uint64_t fetch;
+    uint64_t decode;
+    uint64_t dispatch;
+    uint64_t issue;
+    uint64_t complete; /* Execution complete */
+    uint64_t memory;   /* Memory access complete */
+} PipeStageCycles;
+
 /* Instruction latch acts as a place holder for single instruction and keeps
  * complete information concerning it. This information is updated as the
  * instruction passes through the pipeline. This information includes status
@@ -67,6 +80,21 @@ typedef struct InstructionLatch
     target_ulong predicted_target;
     BPUResponsePkt bpu_resp_pkt;
 
+    /* Physical addresses of the instruction and of the RAM location accessed
+     * by a load, store or atomic (0 for device accesses) */
+    target_ulong insn_paddr;
+    target_ulong data_paddr;
+
+    /* Page walk part of the latency of the fetch and of the data access, and
+     * the MEM_LEVEL_* which served them, for the top-down accounting and the
+     * profiler */
+    int fetch_page_walk_cycles;
+    int data_page_walk_cycles;
+    int fetch_mem_level;
+    int data_mem_level;
+
+    PipeStageCycles pipe_cycles;
+
     uint64_t ins_dispatch_id;
 } InstructionLatch;
 
@@ -34,31 +34,151 @@
 #include "sim_log.h"
 #include "sim_params.h"
 
+/* Seed for the per-instance pseudo random number generator, every new
+ * instance gets a different but reproducible seed */
+#define EVICT_POLICY_RNG_SEED 0x9e3779b97f4a7c15ULL
+
+/* Re-reference prediction value (RRPV) width for RRIP family of policies */
+#define RRIP_RRPV_BITS 2
+#define RRIP_MAX_RRPV ((1 << RRIP_RRPV_BITS) - 1)
+
+/* BRRIP inserts with long re-reference interval once every 32 fills */
+#define BRRIP_LONG_INSERT_PROBABILITY 32
+
+/* DRRIP set dueling: number of leader sets dedicated to each of SRRIP and
+ * BRRIP, and width of the policy selection counter */
+#define DRRIP_NUM_LEADER_SETS 32
+#define DRRIP_PSEL_BITS 10
+#define DRRIP_PSEL_MAX ((1 << DRRIP_PSEL_BITS) - 1)
+
+/* SHiP signature history counter table (SHCT) */
+#define SHIP_SHCT_BITS 14
+#define SHIP_SHCT_SIZE (1 << SHIP_SHCT_BITS)
+#define SHIP_SHCT_MAX 7
+
+static uint64_t evict_policy_instances;
+
+/* xorshift64* generator, much cheaper than rand() and keeps every instance
+ * independent of others */
+uint64_t
+evict_policy_rand(EvictPolicy *p)
+{
+    uint64_t x = p->rng_state;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    p->rng_state = x;
+    return x * 0x2545f4914f6cdd1dULL;
+}
+
+/*----------  Random  ----------*/
+
+static void
+random_use(EvictPolicy *p, int set, int way)
+{
+    return;
+}
+
+static void
+random_insert(EvictPolicy *p, int set, int way, uint64_t signature)
+{
+    return;
+}
+
+static int
+random_evict(EvictPolicy *p, int set)
+{
+    return evict_policy_rand(p) % p->num_ways;
+}
+
+/*----------  Bit-PLRU  ----------*/
+
+/* MRU bit map for all the ways in a set is stored in words_per_set 64-bit
+ * words, so associativity is not limited to 64 ways */
+typedef struct BitPlruData
+{
+    int words_per_set;
+} BitPlruData;
+
+static void
+bit_plru_init(EvictPolicy *p)
+{
+    BitPlruData *d;
+
+    d = calloc(1, sizeof(BitPlruData));
+    assert(d);
+    d->words_per_set = (p->num_ways + 63) / 64;
+
+    p->sets = calloc(p->num_sets * d->words_per_set, sizeof(uint64_t));
+    assert(p->sets);
+    p->data = d;
+}
+
+static void
+bit_plru_reset(EvictPolicy *p)
+{
+    BitPlruData *d = (BitPlruData *)p->data;
+
+    memset(p->sets, 0, p->num_sets * d->words_per_set * sizeof(uint64_t));
+}
+
+static int
+bit_plru_all_set(const uint64_t *mru, int num_ways)
+{
+    int i;
+
+    for (i = 0; i < num_ways / 64; ++i)
+    {
+        if (mru[i] != UINT64_MAX)
+        {
+            return 0;
+        }
+    }
+
+    if (num_ways % 64)
+    {
+        return (mru[i] == (uint64_t)BITMASK(num_ways % 64));
+    }
+
+    return 1;
+}
+
 static void
 bit_plru_use(EvictPolicy *p, int set, int way)
 {
+    BitPlruData *d = (BitPlruData *)p->data;
+    uint64_t *mru = (uint64_t *)p->sets + (set * d->words_per_set);
+
     if (p->num_ways == 1)
     {
         return;
     }
 
     /* Set MRU bit for this way in this set to 1 */
-    SET_BIT(p->sets[set], way);
+    SET_BIT(mru[way / 64], way % 64);
 
     /* Whenever the last remaining 0 bit of a set's status bits is set to 1, all
      * other bits are reset to 0. */
-    if (p->sets[set] == BITMASK(p->num_ways))
+    if (bit_plru_all_set(mru, p->num_ways))
     {
-        p->sets[set] = 0;
-        SET_BIT(p->sets[set], way);
+        memset(mru, 0, d->words_per_set * sizeof(uint64_t));
+        SET_BIT(mru[way / 64], way % 64);
     }
 }
 
+static void
+bit_plru_insert(EvictPolicy *p, int set, int way, uint64_t signature)
+{
+    bit_plru_use(p, set, way);
+}
+
 static int
 bit_plru_evict(EvictPolicy *p, int set)
 {
-    int i = 0;
-    uint64_t current_set = p->sets[set];
+    int i;
+    BitPlruData *d = (BitPlruData *)p->data;
+    const uint64_t *mru = (uint64_t *)p->sets + (set * d->words_per_set);
 
     if (p->num_ways == 1)
     {
@@ -66,79 +186,521 @@ bit_plru_evict(EvictPolicy *p, int set)
     }
 
     /* Return the first way address whose MRU bit is set to 0 */
-    for (i = 0; i < p->num_ways; i++)
+    for (i = 0; i < d->words_per_set; i++)
     {
-        if (GET_BIT(current_set, i) == 0)
+        if (mru[i] != UINT64_MAX)
         {
-            return i;
+            return (i * 64) + __builtin_ctzll(~mru[i]);
         }
     }
 
     sim_assert((0), "error: %s at line %d in %s(): %s", __FILE__, __LINE__,
                __func__, "for bit-plru eviction, there should be at least one "
                          "way open for eviction");
+    return 0;
 }
 
+/*----------  True LRU  ----------*/
+
+/* Every way holds the time-stamp of its last access, LRU way has the smallest
+ * time-stamp */
+typedef struct TrueLruData
+{
+    uint64_t clock;
+} TrueLruData;
+
 static void
-random_use(EvictPolicy *p, int set, int way)
+true_lru_init(EvictPolicy *p)
 {
-    return;
+    p->sets = calloc(p->num_sets * p->num_ways, sizeof(uint64_t));
+    assert(p->sets);
+    p->data = calloc(1, sizeof(TrueLruData));
+    assert(p->data);
+}
+
+static void
+true_lru_reset(EvictPolicy *p)
+{
+    memset(p->sets, 0, p->num_sets * p->num_ways * sizeof(uint64_t));
+    ((TrueLruData *)p->data)->clock = 0;
+}
+
+static void
+true_lru_use(EvictPolicy *p, int set, int way)
+{
+    uint64_t *stamp = (uint64_t *)p->sets + (set * p->num_ways);
+
+    stamp[way] = ++((TrueLruData *)p->data)->clock;
+}
+
+static void
+true_lru_insert(EvictPolicy *p, int set, int way, uint64_t signature)
+{
+    true_lru_use(p, set, way);
 }
 
 static int
-random_evict(EvictPolicy *p, int set)
+true_lru_evict(EvictPolicy *p, int set)
 {
-    return rand() % p->num_ways;
+    int i;
+    int victim = 0;
+    const uint64_t *stamp = (uint64_t *)p->sets + (set * p->num_ways);
+
+    for (i = 1; i < p->num_ways; ++i)
+    {
+        if (stamp[i] < stamp[victim])
+        {
+            victim = i;
+        }
+    }
+
+    return victim;
 }
 
+/*----------  Tree-PLRU  ----------*/
+
+/* Binary tree of (num_ways - 1) nodes per set stored in heap order starting
+ * at index 1. Each node points towards the pseudo-LRU half of its sub-tree,
+ * 0 for left and 1 for right. */
 static void
-evict_policy_reset(EvictPolicy *p)
+tree_plru_init(EvictPolicy *p)
 {
-    memset((void *)p->sets, 0, p->num_sets * sizeof(uint64_t));
+    sim_assert(((p->num_ways & (p->num_ways - 1)) == 0),
+               "error: %s at line %d in %s(): %s", __FILE__, __LINE__,
+               __func__, "tree-plru eviction requires power of 2 ways");
+
+    p->sets = calloc(p->num_sets * p->num_ways, sizeof(uint8_t));
+    assert(p->sets);
 }
 
-EvictPolicy *
-evict_policy_create(int sets, int ways, int policy_type)
+static void
+tree_plru_reset(EvictPolicy *p)
 {
-    EvictPolicy *p;
+    memset(p->sets, 0, p->num_sets * p->num_ways * sizeof(uint8_t));
+}
 
-    p = calloc(1, sizeof(EvictPolicy));
-    assert(p);
+static void
+tree_plru_use(EvictPolicy *p, int set, int way)
+{
+    int node = 1;
+    int half = p->num_ways >> 1;
+    uint8_t *tree = (uint8_t *)p->sets + (set * p->num_ways);
 
-    p->num_sets = sets;
-    p->num_ways = ways;
-    p->type = policy_type;
+    /* Walk from root to the leaf for this way, pointing every node on the
+     * path away from it */
+    while (half)
+    {
+        if (way & half)
+        {
+            tree[node] = 0;
+            node = (node << 1) | 1;
+        }
+        else
+        {
+            tree[node] = 1;
+            node = node << 1;
+        }
+        half >>= 1;
+    }
+}
 
-    p->sets = calloc(p->num_sets, sizeof(uint64_t));
+static void
+tree_plru_insert(EvictPolicy *p, int set, int way, uint64_t signature)
+{
+    tree_plru_use(p, set, way);
+}
+
+static int
+tree_plru_evict(EvictPolicy *p, int set)
+{
+    int node = 1;
+    int way = 0;
+    int half = p->num_ways >> 1;
+    const uint8_t *tree = (uint8_t *)p->sets + (set * p->num_ways);
+
+    while (half)
+    {
+        if (tree[node])
+        {
+            way |= half;
+            node = (node << 1) | 1;
+        }
+        else
+        {
+            node = node << 1;
+        }
+        half >>= 1;
+    }
+
+    return way;
+}
+
+/*----------  RRIP family (SRRIP, BRRIP, DRRIP)  ----------*/
+
+/* Every way holds its re-reference prediction value (RRPV) */
+typedef struct DrripData
+{
+    int leader_stride;
+    int psel;
+} DrripData;
+
+typedef enum RripLeaderType {
+    RRIP_FOLLOWER = 0x0,
+    RRIP_SRRIP_LEADER = 0x1,
+    RRIP_BRRIP_LEADER = 0x2,
+} RripLeaderType;
+
+static void
+rrip_init(EvictPolicy *p)
+{
+    p->sets = calloc(p->num_sets * p->num_ways, sizeof(uint8_t));
     assert(p->sets);
+}
+
+static void
+rrip_reset(EvictPolicy *p)
+{
+    /* Empty ways are predicted to be re-referenced in distant future */
+    memset(p->sets, RRIP_MAX_RRPV, p->num_sets * p->num_ways * sizeof(uint8_t));
+}
+
+static void
+rrip_use(EvictPolicy *p, int set, int way)
+{
+    uint8_t *rrpv = (uint8_t *)p->sets + (set * p->num_ways);
+
+    /* Hit priority: predict near-immediate re-reference */
+    rrpv[way] = 0;
+}
+
+static void
+srrip_insert(EvictPolicy *p, int set, int way, uint64_t signature)
+{
+    uint8_t *rrpv = (uint8_t *)p->sets + (set * p->num_ways);
+
+    rrpv[way] = RRIP_MAX_RRPV - 1;
+}
+
+static void
+brrip_insert(EvictPolicy *p, int set, int way, uint64_t signature)
+{
+    uint8_t *rrpv = (uint8_t *)p->sets + (set * p->num_ways);
+
+    if ((evict_policy_rand(p) % BRRIP_LONG_INSERT_PROBABILITY) == 0)
+    {
+        rrpv[way] = RRIP_MAX_RRPV - 1;
+    }
+    else
+    {
+        rrpv[way] = RRIP_MAX_RRPV;
+    }
+}
 
-    switch (p->type)
+static int
+rrip_evict(EvictPolicy *p, int set)
+{
+    int i;
+    uint8_t *rrpv = (uint8_t *)p->sets + (set * p->num_ways);
+
+    /* Find the first way predicted to be re-referenced in distant future,
+     * ageing all the ways until one is found */
+    for (;;)
     {
-        case EVICT_POLICY_RANDOM:
+        for (i = 0; i < p->num_ways; ++i)
+        {
+            if (rrpv[i] == RRIP_MAX_RRPV)
+            {
+                return i;
+            }
+        }
+
+        for (i = 0; i < p->num_ways; ++i)
         {
-            p->use = &random_use;
-            p->evict = &random_evict;
+            rrpv[i]++;
+        }
+    }
+}
+
+static void
+drrip_init(EvictPolicy *p)
+{
+    DrripData *d;
+
+    rrip_init(p);
+
+    d = calloc(1, sizeof(DrripData));
+    assert(d);
+
+    /* Leader sets are spread evenly across the cache, alternating between
+     * SRRIP and BRRIP leaders */
+    d->leader_stride = p->num_sets / (2 * DRRIP_NUM_LEADER_SETS);
+    if (d->leader_stride < 1)
+    {
+        d->leader_stride = 1;
+    }
+    p->data = d;
+}
+
+static void
+drrip_reset(EvictPolicy *p)
+{
+    rrip_reset(p);
+    ((DrripData *)p->data)->psel = (DRRIP_PSEL_MAX + 1) / 2;
+}
+
+static RripLeaderType
+drrip_get_leader_type(const DrripData *d, int set)
+{
+    int leader;
+
+    if (set % d->leader_stride)
+    {
+        return RRIP_FOLLOWER;
+    }
+
+    leader = set / d->leader_stride;
+    if (leader >= (2 * DRRIP_NUM_LEADER_SETS))
+    {
+        return RRIP_FOLLOWER;
+    }
+
+    return (leader & 1) ? RRIP_BRRIP_LEADER : RRIP_SRRIP_LEADER;
+}
+
+static void
+drrip_insert(EvictPolicy *p, int set, int way, uint64_t signature)
+{
+    DrripData *d = (DrripData *)p->data;
+
+    /* Insertion happens on a miss, so misses in leader sets train PSEL */
+    switch (drrip_get_leader_type(d, set))
+    {
+        case RRIP_SRRIP_LEADER:
+        {
+            if (d->psel < DRRIP_PSEL_MAX)
+            {
+                d->psel++;
+            }
+            srrip_insert(p, set, way, signature);
             break;
         }
-        case EVICT_POLICY_BIT_PLRU:
+        case RRIP_BRRIP_LEADER:
         {
-            p->use = &bit_plru_use;
-            p->evict = &bit_plru_evict;
+            if (d->psel > 0)
+            {
+                d->psel--;
+            }
+            brrip_insert(p, set, way, signature);
             break;
         }
-        default:
+        case RRIP_FOLLOWER:
         {
+            /* Followers use BRRIP when SRRIP leaders miss more */
+            if (d->psel > (DRRIP_PSEL_MAX / 2))
+            {
+                brrip_insert(p, set, way, signature);
+            }
+            else
+            {
+                srrip_insert(p, set, way, signature);
+            }
             break;
         }
     }
+}
+
+/*----------  SHiP  ----------*/
+
+/* SRRIP augmented with a signature history counter table (SHCT), which learns
+ * whether entries inserted by a signature get re-referenced. Entries whose
+ * signature is predicted dead are inserted with distant RRPV. */
+typedef struct ShipEntry
+{
+    uint8_t rrpv;
+    uint8_t valid;
+    uint8_t outcome;
+    uint16_t signature;
+} ShipEntry;
+
+typedef struct ShipData
+{
+    uint8_t shct[SHIP_SHCT_SIZE];
+} ShipData;
+
+static void
+ship_init(EvictPolicy *p)
+{
+    p->sets = calloc(p->num_sets * p->num_ways, sizeof(ShipEntry));
+    assert(p->sets);
+    p->data = calloc(1, sizeof(ShipData));
+    assert(p->data);
+}
+
+static void
+ship_reset(EvictPolicy *p)
+{
+    int i;
+    ShipEntry *e = (ShipEntry *)p->sets;
+    ShipData *d = (ShipData *)p->data;
+
+    for (i = 0; i < p->num_sets * p->num_ways; ++i)
+    {
+        e[i].rrpv = RRIP_MAX_RRPV;
+        e[i].valid = 0;
+        e[i].outcome = 0;
+        e[i].signature = 0;
+    }
+
+    /* Start weakly re-referenced, so that no signature is predicted dead
+     * before it is trained */
+    memset(d->shct, 1, sizeof(d->shct));
+}
+
+static uint16_t
+ship_hash_signature(uint64_t signature)
+{
+    signature ^= signature >> SHIP_SHCT_BITS;
+    signature ^= signature >> (2 * SHIP_SHCT_BITS);
+    return (uint16_t)(signature & (SHIP_SHCT_SIZE - 1));
+}
+
+static void
+ship_use(EvictPolicy *p, int set, int way)
+{
+    ShipEntry *e = (ShipEntry *)p->sets + (set * p->num_ways) + way;
+    ShipData *d = (ShipData *)p->data;
+
+    e->rrpv = 0;
+    e->outcome = 1;
+    if (e->valid && d->shct[e->signature] < SHIP_SHCT_MAX)
+    {
+        d->shct[e->signature]++;
+    }
+}
+
+static void
+ship_insert(EvictPolicy *p, int set, int way, uint64_t signature)
+{
+    ShipEntry *e = (ShipEntry *)p->sets + (set * p->num_ways) + way;
+    ShipData *d = (ShipData *)p->data;
+
+    e->valid = 1;
+    e->outcome = 0;
+    e->signature = ship_hash_signature(signature);
+    e->rrpv = d->shct[e->signature] ? (RRIP_MAX_RRPV - 1) : RRIP_MAX_RRPV;
+}
+
+static int
+ship_evict(EvictPolicy *p, int set)
+{
+    int i;
+    ShipEntry *e = (ShipEntry *)p->sets + (set * p->num_ways);
+    ShipData *d = (ShipData *)p->data;
+
+    for (;;)
+    {
+        for (i = 0; i < p->num_ways; ++i)
+        {
+            if (e[i].rrpv == RRIP_MAX_RRPV)
+            {
+                /* Victim was never re-referenced, so train its signature
+                 * towards dead */
+                if (e[i].valid && !e[i].outcome && d->shct[e[i].signature])
+                {
+                    d->shct[e[i].signature]--;
+                }
+                e[i].valid = 0;
+                return i;
+            }
+        }
+
+        for (i = 0; i < p->num_ways; ++i)
+        {
+            e[i].rrpv++;
+        }
+    }
+}
+
+/*----------  Policy registry  ----------*/
+
+static void
+evict_policy_no_init(EvictPolicy *p)
+{
+    return;
+}
+
+static void
+evict_policy_no_reset(EvictPolicy *p)
+{
+    return;
+}
+
+static void
+evict_policy_free_state(EvictPolicy *p)
+{
+    free(p->sets);
+    p->sets = NULL;
+    free(p->data);
+    p->data = NULL;
+}
+
+/* Indexed by EVICT_POLICY_* type */
+static const EvictPolicyOps evict_policy_ops[NUM_MAX_EVICT_POLICIES] = {
+    [EVICT_POLICY_RANDOM] = {evict_policy_no_init, evict_policy_no_reset,
+                             random_use, random_insert, random_evict,
+                             evict_policy_free_state},
+    [EVICT_POLICY_BIT_PLRU] = {bit_plru_init, bit_plru_reset, bit_plru_use,
+                               bit_plru_insert, bit_plru_evict,
+                               evict_policy_free_state},
+    [EVICT_POLICY_TRUE_LRU] = {true_lru_init, true_lru_reset, true_lru_use,
+                               true_lru_insert, true_lru_evict,
+                               evict_policy_free_state},
+    [EVICT_POLICY_TREE_PLRU] = {tree_plru_init, tree_plru_reset,
+                                tree_plru_use, tree_plru_insert,
+                                tree_plru_evict, evict_policy_free_state},
+    [EVICT_POLICY_SRRIP] = {rrip_init, rrip_reset, rrip_use, srrip_insert,
+                            rrip_evict, evict_policy_free_state},
+    [EVICT_POLICY_BRRIP] = {rrip_init, rrip_reset, rrip_use, brrip_insert,
+                            rrip_evict, evict_policy_free_state},
+    [EVICT_POLICY_DRRIP] = {drrip_init, drrip_reset, rrip_use, drrip_insert,
+                            rrip_evict, evict_policy_free_state},
+    [EVICT_POLICY_SHIP] = {ship_init, ship_reset, ship_use, ship_insert,
+                           ship_evict, evict_policy_free_state},
+};
+
+EvictPolicy *
+evict_policy_create(int sets, int ways, int policy_type)
+{
+    EvictPolicy *p;
+    const EvictPolicyOps *ops;
+
+    sim_assert((policy_type >= 0 && policy_type < NUM_MAX_EVICT_POLICIES),
+               "error: %s at line %d in %s(): %s", __FILE__, __LINE__,
+               __func__, "invalid eviction policy");
+
+    p = calloc(1, sizeof(EvictPolicy));
+    assert(p);
+
+    p->num_sets = sets;
+    p->num_ways = ways;
+    p->type = policy_type;
+    p->rng_state = EVICT_POLICY_RNG_SEED * (++evict_policy_instances);
+
+    ops = &evict_policy_ops[p->type];
+    ops->init(p);
+    p->reset = ops->reset;
+    p->use = ops->use;
+    p->insert = ops->insert;
+    p->evict = ops->evict;
 
-    p->reset = &evict_policy_reset;
+    p->reset(p);
     return p;
 }
 
 void
 evict_policy_free(EvictPolicy **p)
 {
-    free((*p)->sets);
+    evict_policy_ops[(*p)->type].free(*p);
     free(*p);
+    *p = NULL;
 }
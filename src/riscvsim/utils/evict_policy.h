@@ -29,21 +29,54 @@
 
 #include <inttypes.h>
 
+struct EvictPolicy;
+
+/* Interface implemented by every replacement policy. A new policy is added by
+ * implementing these routines and registering them in evict_policy_ops[] in
+ * evict_policy.c against its EVICT_POLICY_* type.
+ *
+ * use():    called when the given way is hit
+ * insert(): called after a new entry is filled into the given way on a miss,
+ *           signature is an opaque value identifying the entry (e.g. PC or
+ *           memory region), used by signature based policies like SHiP
+ * evict():  returns the way to be replaced in the given set */
+typedef struct EvictPolicyOps
+{
+    void (*init)(struct EvictPolicy *p);
+    void (*reset)(struct EvictPolicy *p);
+    void (*use)(struct EvictPolicy *p, int set, int way);
+    void (*insert)(struct EvictPolicy *p, int set, int way,
+                   uint64_t signature);
+    int (*evict)(struct EvictPolicy *p, int set);
+    void (*free)(struct EvictPolicy *p);
+} EvictPolicyOps;
+
 typedef struct EvictPolicy
 {
     int type;
     int num_sets;
     int num_ways;
 
-    /* MRU bit map for all the ways in a set */
-    uint64_t *sets;
+    /* Replacement state for all the ways in a set, layout is specific to the
+     * policy used */
+    void *sets;
+
+    /* Additional policy specific state, e.g. PSEL counter for DRRIP or
+     * signature history counter table for SHiP */
+    void *data;
+
+    /* Per-instance xorshift pseudo random number generator state */
+    uint64_t rng_state;
 
     /* This pointers are set according to eviction policy used */
     void (*reset)(struct EvictPolicy *p);
     void (*use)(struct EvictPolicy *p, int set, int way);
+    void (*insert)(struct EvictPolicy *p, int set, int way,
+                   uint64_t signature);
     int (*evict)(struct EvictPolicy *p, int set);
 } EvictPolicy;
 
 EvictPolicy *evict_policy_create(int sets, int ways, int policy_type);
+uint64_t evict_policy_rand(EvictPolicy *p);
 void evict_policy_free(EvictPolicy **);
 #endif /* _EVICT_POLICY_H_ */
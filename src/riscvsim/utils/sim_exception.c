@@ -35,6 +35,7 @@ sim_exception_set(SimException *s, const InstructionLatch *e)
 {
     s->pending = TRUE;
     s->cause = e->ins.exception_cause;
+    s->insn_latch_index = e->insn_latch_index;
 
     switch (s->cause)
     {
@@ -37,6 +37,7 @@ typedef struct SimException
     int cause;
     int cpu_stage;
     target_ulong pc;
+    int insn_latch_index; /* Latch of the instruction which caused it */
     uint32_t insn;
     char insn_str[RISCV_INS_STR_MAX_LENGTH];
 } SimException;
@@ -0,0 +1,114 @@
+/**
+ * Host Self-Profiling of the Simulator
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_host_profile.h"
+#include "sim_log.h"
+
+const char *host_profile_region_str[NUM_HOST_PROFILE_REGIONS]
+    = {"dram",    "commit", "memory", "execute", "issue",        "dispatch",
+       "decode",  "fetch",  "fusion", "mmu",     "mem_hierarchy"};
+
+SimHostProfile *
+sim_host_profile_init(void)
+{
+    SimHostProfile *hp;
+
+    hp = (SimHostProfile *)calloc(1, sizeof(SimHostProfile));
+    assert(hp);
+    sim_host_profile_reset(hp);
+    return hp;
+}
+
+void
+sim_host_profile_reset(SimHostProfile *hp)
+{
+    memset((void *)hp->ticks, 0, sizeof(hp->ticks));
+    memset((void *)hp->calls, 0, sizeof(hp->calls));
+    clock_gettime(CLOCK_MONOTONIC, &hp->start_time);
+    hp->start_ticks = host_profile_ticks();
+}
+
+/* Calibrates the tick counter against the monotonic clock over the profiled
+ * interval, the time stamp counter of x86 hosts runs at a constant rate */
+double
+sim_host_profile_ns_per_tick(const SimHostProfile *hp)
+{
+    struct timespec now;
+    uint64_t ticks, ns;
+
+    ticks = host_profile_ticks() - hp->start_ticks;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ns = 1000000000ULL * (now.tv_sec - hp->start_time.tv_sec) + now.tv_nsec
+         - hp->start_time.tv_nsec;
+    return ticks ? (double)ns / ticks : 1.0;
+}
+
+void
+sim_host_profile_print_to_file(const SimHostProfile *hp, const char *pathname,
+                               const char *timestamp, uint64_t sim_time_ns)
+{
+    int i;
+    FILE *fp;
+    uint64_t ns;
+    double ns_per_tick, ns_per_call, percent;
+    char filename[PATH_MAX];
+
+    snprintf(filename, sizeof(filename), "%s/%shost_profile.csv", pathname,
+             timestamp);
+    fp = fopen(filename, "w");
+    assert(fp);
+
+    ns_per_tick = sim_host_profile_ns_per_tick(hp);
+    fprintf(fp, "%s\n", "region,calls,host_ns,host_ns_per_call,percent");
+    for (i = 0; i < NUM_HOST_PROFILE_REGIONS; ++i)
+    {
+        ns = (uint64_t)(hp->ticks[i] * ns_per_tick);
+        ns_per_call = hp->calls[i] ? (double)ns / hp->calls[i] : 0.0;
+        percent = sim_time_ns ? (double)ns * 100 / sim_time_ns : 0.0;
+        fprintf(fp, "%s,%lu,%lu,%.2lf,%.2lf\n", host_profile_region_str[i],
+                hp->calls[i], ns, ns_per_call, percent);
+        sim_log_param(sim_log,
+                      "host-%s: %lu ns, %lu calls, %.2lf ns/call (%.2lf%%)",
+                      host_profile_region_str[i], ns, hp->calls[i],
+                      ns_per_call, percent);
+    }
+
+    fclose(fp);
+    sim_log_event(sim_log, "Saved host profile in %s", filename);
+}
+
+void
+sim_host_profile_free(SimHostProfile **hp)
+{
+    free(*hp);
+    *hp = NULL;
+}
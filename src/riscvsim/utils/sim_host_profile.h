@@ -0,0 +1,113 @@
+/**
+ * Host Self-Profiling of the Simulator
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _SIM_HOST_PROFILE_H_
+#define _SIM_HOST_PROFILE_H_
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Regions of the simulator timed on the host. The pipeline stages partition
+ * the time of a simulated cycle, MMU and MEM_HIERARCHY are nested inside the
+ * fetch and memory stages which call them. */
+#define NUM_HOST_PROFILE_REGIONS 11
+#define HOST_PROFILE_DRAM 0x0
+#define HOST_PROFILE_COMMIT 0x1
+#define HOST_PROFILE_MEMORY 0x2
+#define HOST_PROFILE_EXECUTE 0x3
+#define HOST_PROFILE_ISSUE 0x4
+#define HOST_PROFILE_DISPATCH 0x5
+#define HOST_PROFILE_DECODE 0x6
+#define HOST_PROFILE_FETCH 0x7
+#define HOST_PROFILE_FUSION 0x8
+#define HOST_PROFILE_MMU 0x9
+#define HOST_PROFILE_MEM_HIERARCHY 0xa
+
+extern const char *host_profile_region_str[NUM_HOST_PROFILE_REGIONS];
+
+typedef struct SimHostProfile
+{
+    uint64_t ticks[NUM_HOST_PROFILE_REGIONS];
+    uint64_t calls[NUM_HOST_PROFILE_REGIONS];
+
+    /* Tick counter and wall clock when profiling started, used to convert the
+     * ticks to nanoseconds */
+    uint64_t start_ticks;
+    struct timespec start_time;
+} SimHostProfile;
+
+/* Time stamp counter on x86 hosts, monotonic clock in nanoseconds elsewhere */
+static inline uint64_t
+host_profile_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/* Returns the start of a timed region, or 0 without reading the counter if
+ * profiling is disabled (hp is NULL) */
+static inline uint64_t
+host_profile_start(SimHostProfile *hp)
+{
+    return (NULL != hp) ? host_profile_ticks() : 0;
+}
+
+/* Charges the time since start to region and returns the current ticks, so
+ * that back to back regions read the counter once each */
+static inline uint64_t
+host_profile_mark(SimHostProfile *hp, int region, uint64_t start)
+{
+    uint64_t now;
+
+    if (NULL == hp)
+    {
+        return 0;
+    }
+    now = host_profile_ticks();
+    hp->ticks[region] += now - start;
+    ++hp->calls[region];
+    return now;
+}
+
+SimHostProfile *sim_host_profile_init(void);
+void sim_host_profile_reset(SimHostProfile *hp);
+double sim_host_profile_ns_per_tick(const SimHostProfile *hp);
+void sim_host_profile_print_to_file(const SimHostProfile *hp,
+                                    const char *pathname, const char *timestamp,
+                                    uint64_t sim_time_ns);
+void sim_host_profile_free(SimHostProfile **hp);
+#endif
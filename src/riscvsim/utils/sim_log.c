@@ -27,6 +27,7 @@
 #include <assert.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "sim_log.h"
@@ -160,4 +161,21 @@ sim_log_get_current_timestamp(const char* sim_file_prefix)
     }
 
     return timestamp;
-}
\ No newline at end of file
+}
+/* Files written by every hart other than the boot hart are suffixed with the
+ * hart id */
+void
+sim_log_get_hart_file_name(char *buf, size_t size, const char *name, int hart)
+{
+    size_t len = strlen(name);
+
+    if (hart)
+    {
+        snprintf(buf, size, "%s%shart%d", name,
+                 (len && name[len - 1] == '_') ? "" : "_", hart);
+    }
+    else
+    {
+        snprintf(buf, size, "%s", name);
+    }
+}
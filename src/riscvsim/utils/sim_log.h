@@ -55,5 +55,7 @@ void sim_log_param(SimLog *s, const char *fmt, ...);
 void sim_log_event_to_file(SimLog *s, const char *fmt, ...);
 void sim_log_param_to_file(SimLog *s, const char *fmt, ...);
 char *sim_log_get_current_timestamp(const char* sim_file_prefix);
+void sim_log_get_hart_file_name(char *buf, size_t size, const char *name,
+                                int hart);
 void sim_log_free(SimLog **s);
 #endif
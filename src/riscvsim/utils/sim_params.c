@@ -41,18 +41,30 @@
 
 const char *core_type_str[] = {"in-order", "out-of-order"};
 const char *sim_param_status[] = {"false", "true"};
-const char *evict_policy_str[] = {"random", "bit-plru"};
+const char *fusion_pattern_str[]
+    = {"none", "lui_addi", "auipc_jalr", "slli_srli", "add_load"};
+const char *evict_policy_str[]
+    = {"random", "bit-plru", "true-lru", "tree-plru",
+       "srrip",  "brrip",    "drrip",    "ship"};
 const char *cache_ra_str[] = {"true", "false"};
 const char *cache_wa_str[] = {"true", "false"};
 const char *cache_wp_str[] = {"writeback", "writethrough"};
+const char *cache_inclusion_str[] = {"nine", "inclusive", "exclusive"};
+const char *coherence_protocol_str[] = {"none", "mesi", "moesi"};
+const char *smt_resource_policy_str[] = {"shared", "partitioned"};
+const char *smt_fetch_policy_str[] = {"round-robin", "icount"};
 const char *bpu_type_str[] = {"bimodal", "adaptive"};
 const char *bpu_aliasing_func_type_str[] = {"xor", "and", "none"};
-const char *dram_model_type_str[] = {"base", "dramsim3", "ramulator"};
+const char *dram_model_type_str[]
+    = {"base", "dramsim3", "ramulator", "analytical"};
+const char *dram_page_policy_str[] = {"open", "closed"};
 const char *cpu_mode_str[] = {"user", "supervisor", "hypervisor", "machine"};
 
 void
 sim_params_log_options(const SimParams *p)
 {
+    int i;
+
     sim_log_event_to_file(sim_log, "%s", "Setting up TinyEMU options");
     sim_log_param_to_file(sim_log, "%s: %d", "code_tlb_size", p->tlb_size);
     sim_log_param_to_file(sim_log, "%s: %d", "load_tlb_size", p->tlb_size);
@@ -80,6 +92,25 @@ sim_params_log_options(const SimParams *p)
 
     sim_log_param_to_file(sim_log, "%s: %s", "-sim-log-file", p->sim_log_file);
 
+    if (p->sweep_file)
+    {
+        sim_log_param_to_file(sim_log, "%s: %s", "-sim-sweep-file",
+                              p->sweep_file);
+        sim_log_param_to_file(sim_log, "%s: %d", "-sim-sweep-jobs",
+                              p->sweep_jobs);
+    }
+
+    if (p->lockstep_file)
+    {
+        sim_log_param_to_file(sim_log, "%s: %s", "-sim-lockstep-file",
+                              p->lockstep_file);
+    }
+
+    if (p->elf_file)
+    {
+        sim_log_param_to_file(sim_log, "%s: %s", "-sim-elf", p->elf_file);
+    }
+
     if (p->do_sim_trace)
     {
         sim_log_param_to_file(sim_log, "%s", "-sim-trace");
@@ -87,6 +118,50 @@ sim_params_log_options(const SimParams *p)
                               p->sim_trace_file);
     }
 
+    if (p->do_pipe_trace)
+    {
+        sim_log_param_to_file(sim_log, "%s", "-sim-pipe-trace");
+        sim_log_param_to_file(sim_log, "%s: %s", "-sim-pipe-trace-file",
+                              p->pipe_trace_file);
+        sim_log_param_to_file(sim_log, "%s: %" PRIu64 ":%" PRIu64,
+                              "-sim-pipe-trace-cycles",
+                              p->pipe_trace_start_cycle,
+                              p->pipe_trace_end_cycle);
+        sim_log_param_to_file(sim_log, "%s: 0x%" PRIx64 ":0x%" PRIx64,
+                              "-sim-pipe-trace-pc", p->pipe_trace_start_pc,
+                              p->pipe_trace_end_pc);
+    }
+
+    if (p->roi_filter == ROI_FILTER_MARKER)
+    {
+        sim_log_param_to_file(sim_log, "%s", "-sim-roi");
+    }
+    else if (p->roi_filter == ROI_FILTER_ASID)
+    {
+        sim_log_param_to_file(sim_log, "%s: %" PRIu64, "-sim-roi-asid",
+                              p->roi_asid);
+    }
+
+    if (p->do_stats_export)
+    {
+        sim_log_param_to_file(sim_log, "%s: %" PRIu64 " cycle(s)",
+                              "-sim-stats-export-interval",
+                              p->stats_export_interval);
+    }
+
+    if (p->do_host_profile)
+    {
+        sim_log_param_to_file(sim_log, "%s", "-sim-host-profile");
+    }
+
+    if (p->do_profile)
+    {
+        sim_log_param_to_file(sim_log, "%s", "-sim-profile");
+        sim_log_param_to_file(sim_log, "%s: %s", "-sim-profile-symbols",
+                              p->profile_symbol_file ? p->profile_symbol_file
+                                                     : "none");
+    }
+
     if (p->flush_sim_mem_on_simstart)
     {
         sim_log_param_to_file(sim_log, "%s", "-sim-flush-mem");
@@ -107,6 +182,41 @@ sim_params_log_options(const SimParams *p)
                           core_type_str[p->core_type]);
     sim_log_param_to_file(sim_log, "%s: %lu MHz", "rtc_freq_mhz", p->rtc_freq_mhz);
     sim_log_param_to_file(sim_log, "%s: %lu MHz", "cpu_freq_mhz", p->cpu_freq_mhz);
+    sim_log_param_to_file(sim_log, "%s: %d", "num_harts", p->num_harts);
+    if (p->num_harts > 1)
+    {
+        sim_log_param_to_file(sim_log, "%s: %d", "hart_quantum",
+                              p->hart_quantum);
+        sim_log_param_to_file(sim_log, "%s: %s", "parallel_harts",
+                              sim_param_status[p->parallel_harts]);
+        if (p->parallel_harts)
+        {
+            sim_log_param_to_file(sim_log, "%s: %d cycle(s)%s",
+                                  "sync_quantum", p->sync_quantum,
+                                  (p->sync_quantum == 1) ? " (deterministic)"
+                                                         : "");
+        }
+    }
+    sim_log_param_to_file(sim_log, "%s: %s", "enable_vector",
+                          sim_param_status[p->enable_vector]);
+    if (p->enable_vector)
+    {
+        sim_log_param_to_file(sim_log, "%s: %d bits", "vlen", p->vlen);
+        sim_log_param_to_file(sim_log, "%s: %d", "vector_lanes",
+                              p->vector_lanes);
+        sim_log_param_to_file(sim_log, "%s: %s", "vector_chaining",
+                              sim_param_status[p->vector_chaining]);
+        sim_log_param_to_file(sim_log, "%s: %d", "vector_mem_lines_per_cycle",
+                              p->vector_mem_lines_per_cycle);
+    }
+    sim_log_param_to_file(sim_log, "%s: %s", "enable_fusion",
+                          sim_param_status[p->enable_fusion]);
+    for (i = FUSION_NONE + 1; p->enable_fusion && i < NUM_FUSION_PATTERNS; ++i)
+    {
+        sim_log_param_to_file(sim_log, "%s_%s: %s", "fusion",
+                              fusion_pattern_str[i],
+                              sim_param_status[p->fusion[i]]);
+    }
     sim_log_param_to_file(sim_log, "%s: %s", "enable_bpu",
                           sim_param_status[p->enable_bpu]);
     if (p->enable_bpu)
@@ -118,12 +228,56 @@ sim_params_log_options(const SimParams *p)
     }
     sim_log_param_to_file(sim_log, "%s: %s", "enable_l1_caches",
                           sim_param_status[p->enable_l1_caches]);
-    sim_log_param_to_file(sim_log, "%s: %s", "enable_l2_cache",
-                          sim_param_status[p->enable_l2_cache]);
+    sim_log_param_to_file(sim_log, "%s: %s", "enable_victim_cache",
+                          sim_param_status[p->enable_victim_cache]);
+    if (p->enable_victim_cache)
+    {
+        sim_log_param_to_file(sim_log, "%s: %d", "victim_cache_entries",
+                              p->victim_cache_entries);
+        sim_log_param_to_file(sim_log, "%s: %d cycle(s)",
+                              "victim_cache_latency", p->victim_cache_latency);
+    }
+    sim_log_param_to_file(sim_log, "%s: %d", "num_shared_cache_levels",
+                          p->num_shared_cache_levels);
+    if (p->num_harts > 1)
+    {
+        sim_log_param_to_file(sim_log, "%s: %s", "coherence_protocol",
+                              coherence_protocol_str[p->coherence_protocol]);
+        if (p->coherence_protocol != COHERENCE_NONE)
+        {
+            sim_log_param_to_file(sim_log, "%s: %d cycle(s)",
+                                  "coherence_invalidate_latency",
+                                  p->coherence_invalidate_latency);
+            sim_log_param_to_file(sim_log, "%s: %d cycle(s)",
+                                  "coherence_downgrade_latency",
+                                  p->coherence_downgrade_latency);
+            sim_log_param_to_file(sim_log, "%s: %d cycle(s)",
+                                  "coherence_c2c_latency",
+                                  p->coherence_c2c_latency);
+        }
+    }
     sim_log_param_to_file(sim_log, "%s: %s", "dram_model_type",
                           dram_model_type_str[p->dram_model_type]);
 }
 
+static void
+set_default_cache_params(const SimParams *p, CacheParams *c, int read_latency,
+                         int write_latency, int size, int ways, int evict)
+{
+    c->size = size;
+    c->ways = ways;
+    c->read_latency = read_latency;
+    c->write_latency = write_latency;
+    c->evict = evict;
+
+    /* Common cache parameters are inherited by every level */
+    c->line_size = p->cache_line_size;
+    c->read_allocate_policy = p->cache_read_allocate_policy;
+    c->write_allocate_policy = p->cache_write_allocate_policy;
+    c->write_policy = p->cache_write_policy;
+    c->inclusion_policy = DEF_CACHE_INCLUSION_POLICY;
+}
+
 static void
 sim_params_set_defaults(SimParams *p)
 {
@@ -142,6 +296,9 @@ sim_params_set_defaults(SimParams *p)
     p->sim_trace_file = strdup(DEF_SIM_TRACE_FILE);
     assert(p->sim_trace_file);
 
+    p->pipe_trace_file = strdup(DEF_PIPE_TRACE_FILE);
+    assert(p->pipe_trace_file);
+
     p->sim_log_file = strdup(DEF_SIM_LOG_FILE);
     assert(p->sim_log_file);
 
@@ -159,6 +316,9 @@ sim_params_set_defaults(SimParams *p)
     p->iq_issue_ports = DEF_IQ_ISSUE_PORTS;
     p->rob_size = DEF_ROB_SIZE;
     p->lsq_size = DEF_LSQ_SIZE;
+    p->smt_threads = DEF_SMT_THREADS;
+    p->smt_resource_policy = DEF_SMT_RESOURCE_POLICY;
+    p->smt_fetch_policy = DEF_SMT_FETCH_POLICY;
 
     p->num_alu_stages = DEF_NUM_ALU_STAGES;
     p->alu_stage_latency = (int *)malloc(sizeof(int) * p->num_alu_stages);
@@ -210,6 +370,23 @@ sim_params_set_defaults(SimParams *p)
         p->fpu_fma_stage_latency[i] = DEF_STAGE_LATENCY;
     }
 
+    p->enable_vector = DEF_ENABLE_VECTOR;
+    p->vlen = DEF_VLEN;
+    p->vector_lanes = DEF_VECTOR_LANES;
+    p->vector_chaining = DEF_VECTOR_CHAINING;
+    p->vector_alu_latency = DEF_VECTOR_ALU_LATENCY;
+    p->vector_mul_latency = DEF_VECTOR_MUL_LATENCY;
+    p->vector_div_latency = DEF_VECTOR_DIV_LATENCY;
+    p->vector_fpu_latency = DEF_VECTOR_FPU_LATENCY;
+    p->vector_fpu_div_latency = DEF_VECTOR_FPU_DIV_LATENCY;
+    p->vector_mem_lines_per_cycle = DEF_VECTOR_MEM_LINES_PER_CYCLE;
+
+    p->enable_fusion = DEF_ENABLE_FUSION;
+    for (i = FUSION_NONE + 1; i < NUM_FUSION_PATTERNS; ++i)
+    {
+        p->fusion[i] = DEF_ENABLE_FUSION;
+    }
+
     p->enable_bpu = DEF_ENABLE_BPU;
     p->btb_size = DEF_BTB_SIZE;
     p->btb_ways = DEF_BTB_WAYS;
@@ -223,29 +400,46 @@ sim_params_set_defaults(SimParams *p)
     p->btb_eviction_policy = DEF_BTB_EVICT_POLICY;
     p->flush_bpu_on_simstart = DEF_FLUSH_BPU_ON_SIMSTART;
 
-    p->enable_l1_caches = DEF_ENABLE_L1_CACHE;
-    p->l1_code_cache_read_latency = DEF_L1_CODE_CACHE_READ_LATENCY;
-    p->l1_code_cache_size = DEF_L1_CODE_CACHE_SIZE;
-    p->l1_code_cache_ways = DEF_L1_CODE_CACHE_WAYS;
-    p->l1_code_cache_evict = DEF_L1_CODE_CACHE_EVICT;
-    p->l1_data_cache_read_latency = DEF_L1_DATA_CACHE_READ_LATENCY;
-    p->l1_data_cache_write_latency = DEF_L1_DATA_CACHE_WRITE_LATENCY;
-    p->l1_data_cache_size = DEF_L1_DATA_CACHE_SIZE;
-    p->l1_data_cache_ways = DEF_L1_DATA_CACHE_WAYS;
-    p->l1_data_cache_evict = DEF_L1_DATA_CACHE_EVICT;
-
-    p->enable_l2_cache = DEF_ENABLE_L2_CACHE;
-    p->l2_shared_cache_read_latency = DEF_L2_CACHE_READ_LATENCY;
-    p->l2_shared_cache_write_latency = DEF_L2_CACHE_WRITE_LATENCY;
-    p->l2_shared_cache_size = DEF_L2_CACHE_SIZE;
-    p->l2_shared_cache_ways = DEF_L2_CACHE_WAYS;
-    p->l2_shared_cache_evict = DEF_L2_CACHE_EVICT;
-
     p->cache_line_size = DEF_CACHE_LINE_SIZE;
     p->cache_read_allocate_policy = DEF_CACHE_READ_ALLOC_POLICY;
     p->cache_write_allocate_policy = DEF_CACHE_WRITE_ALLOC_POLICY;
     p->cache_write_policy = DEF_CACHE_WRITE_POLICY;
 
+    p->enable_l1_caches = DEF_ENABLE_L1_CACHE;
+    set_default_cache_params(p, &p->l1_code_cache,
+                             DEF_L1_CODE_CACHE_READ_LATENCY,
+                             DEF_L1_CODE_CACHE_READ_LATENCY,
+                             DEF_L1_CODE_CACHE_SIZE, DEF_L1_CODE_CACHE_WAYS,
+                             DEF_L1_CODE_CACHE_EVICT);
+    set_default_cache_params(p, &p->l1_data_cache,
+                             DEF_L1_DATA_CACHE_READ_LATENCY,
+                             DEF_L1_DATA_CACHE_WRITE_LATENCY,
+                             DEF_L1_DATA_CACHE_SIZE, DEF_L1_DATA_CACHE_WAYS,
+                             DEF_L1_DATA_CACHE_EVICT);
+
+    p->enable_victim_cache = DEF_ENABLE_VICTIM_CACHE;
+    p->victim_cache_entries = DEF_VICTIM_CACHE_ENTRIES;
+    p->victim_cache_latency = DEF_VICTIM_CACHE_LATENCY;
+
+    p->coherence_protocol = DEF_COHERENCE_PROTOCOL;
+    p->coherence_invalidate_latency = DEF_COHERENCE_INVALIDATE_LATENCY;
+    p->coherence_downgrade_latency = DEF_COHERENCE_DOWNGRADE_LATENCY;
+    p->coherence_c2c_latency = DEF_COHERENCE_C2C_LATENCY;
+
+    /* Only L2 is enabled by default, deeper levels must be added via the
+     * config file */
+    p->num_shared_cache_levels = DEF_ENABLE_L2_CACHE ? 1 : 0;
+    set_default_cache_params(p, &p->shared_cache[0], DEF_L2_CACHE_READ_LATENCY,
+                             DEF_L2_CACHE_WRITE_LATENCY, DEF_L2_CACHE_SIZE,
+                             DEF_L2_CACHE_WAYS, DEF_L2_CACHE_EVICT);
+    for (i = 1; i < NUM_MAX_SHARED_CACHE_LEVELS; ++i)
+    {
+        set_default_cache_params(p, &p->shared_cache[i],
+                                 DEF_L3_CACHE_READ_LATENCY,
+                                 DEF_L3_CACHE_WRITE_LATENCY, DEF_L3_CACHE_SIZE,
+                                 DEF_L3_CACHE_WAYS, DEF_L3_CACHE_EVICT);
+    }
+
     p->tlb_size = DEF_TLB_SIZE;
     p->dram_model_type = DEF_MEM_MODEL;
     p->burst_length = DEF_DRAM_BURST_SIZE;
@@ -259,11 +453,31 @@ sim_params_set_defaults(SimParams *p)
     p->ramulator_config_file = strdup(DEF_RAMULATOR_CONFIG_FILE);
     assert(p->ramulator_config_file);
 
+    p->analytical_dram.num_channels = DEF_ADRAM_CHANNELS;
+    p->analytical_dram.num_ranks = DEF_ADRAM_RANKS;
+    p->analytical_dram.num_banks = DEF_ADRAM_BANKS;
+    p->analytical_dram.row_buffer_size = DEF_ADRAM_ROW_BUFFER_SIZE;
+    p->analytical_dram.bus_width = DEF_ADRAM_BUS_WIDTH;
+    p->analytical_dram.address_mapping = strdup(DEF_ADRAM_ADDRESS_MAPPING);
+    assert(p->analytical_dram.address_mapping);
+    p->analytical_dram.page_policy = DEF_ADRAM_PAGE_POLICY;
+    p->analytical_dram.freq_mhz = DEF_ADRAM_FREQ_MHZ;
+    p->analytical_dram.t_rcd = DEF_ADRAM_TRCD;
+    p->analytical_dram.t_cas = DEF_ADRAM_TCAS;
+    p->analytical_dram.t_rp = DEF_ADRAM_TRP;
+    p->analytical_dram.t_ras = DEF_ADRAM_TRAS;
+    p->analytical_dram.t_refi = DEF_ADRAM_TREFI;
+    p->analytical_dram.t_rfc = DEF_ADRAM_TRFC;
+
     p->sim_emulate_after_icount = DEF_SIM_EMULATE_AFTER_ICOUNT;
     p->system_insn_latency = DEF_STAGE_LATENCY;
     p->bpu_flush_on_context_switch = DEF_BPU_FLUSH_ON_CONTEXT_SWITCH;
     p->rtc_freq_mhz = DEF_RTC_FREQ_MHZ;
     p->cpu_freq_mhz = DEF_CPU_FREQ_MHZ;
+    p->num_harts = DEF_NUM_HARTS;
+    p->hart_quantum = DEF_HART_QUANTUM;
+    p->parallel_harts = DEF_PARALLEL_HARTS;
+    p->sync_quantum = DEF_SYNC_QUANTUM;
 }
 
 static int
@@ -301,10 +515,44 @@ validate_param_p2(const char *param_name, int val)
                __FILE__, __LINE__, __func__, param_name);
 }
 
+static void
+validate_cache_params(const char *cache_name, const CacheParams *c,
+                      int min_line_size)
+{
+    char param_name[64];
+
+    snprintf(param_name, sizeof(param_name), "%s.latency", cache_name);
+    validate_param(param_name, 0, 1, 2048, c->read_latency);
+    snprintf(param_name, sizeof(param_name), "%s.write_latency", cache_name);
+    validate_param(param_name, 0, 1, 2048, c->write_latency);
+    snprintf(param_name, sizeof(param_name), "%s.size", cache_name);
+    validate_param(param_name, 0, 1, 2048, c->size);
+    snprintf(param_name, sizeof(param_name), "%s.ways", cache_name);
+    validate_param(param_name, 0, 1, 2048, c->ways);
+    snprintf(param_name, sizeof(param_name), "%s.eviction", cache_name);
+    validate_param(param_name, 1, 0, NUM_MAX_EVICT_POLICIES - 1, c->evict);
+    snprintf(param_name, sizeof(param_name), "%s.line_size", cache_name);
+    validate_param_p2(param_name, c->line_size);
+    validate_param(param_name, 0, min_line_size, 0, c->line_size);
+    snprintf(param_name, sizeof(param_name), "%s.allocate_on_read_miss",
+             cache_name);
+    validate_param(param_name, 1, 0, 1, c->read_allocate_policy);
+    snprintf(param_name, sizeof(param_name), "%s.allocate_on_write_miss",
+             cache_name);
+    validate_param(param_name, 1, 0, 1, c->write_allocate_policy);
+    snprintf(param_name, sizeof(param_name), "%s.write_policy", cache_name);
+    validate_param(param_name, 1, 0, 1, c->write_policy);
+    snprintf(param_name, sizeof(param_name), "%s.inclusion", cache_name);
+    validate_param(param_name, 1, 0, CACHE_INCLUSION_EXCLUSIVE,
+                   c->inclusion_policy);
+}
+
 void
 sim_params_validate(SimParams *p)
 {
     int i;
+    int prev_line_size;
+    char cache_name[64];
     char trace_file_name[1024];
 
     validate_param("start_in_sim", 1, 0, 1, p->start_in_sim);
@@ -320,9 +568,107 @@ sim_params_validate(SimParams *p)
         validate_param("iq_issue_ports", 0, 1, 2048, p->iq_issue_ports);
         validate_param("rob_size", 0, 1, 2048, p->rob_size);
         validate_param("lsq_size", 0, 1, 2048, p->lsq_size);
+        validate_param("smt_threads", 1, 1, NUM_MAX_SMT_THREADS,
+                       p->smt_threads);
+    }
+
+    if (p->smt_threads > 1)
+    {
+        sim_assert((p->core_type == CORE_TYPE_OOCORE),
+                   "error: %s at line %d in %s(): %s", __FILE__, __LINE__,
+                   __func__, "smt_threads requires the out-of-order core");
+        sim_assert(((p->num_harts % p->smt_threads) == 0),
+                   "error: %s at line %d in %s(): %s", __FILE__, __LINE__,
+                   __func__, "num_harts must be a multiple of smt_threads");
+
+        /* The threads of a core are stepped by a single cycle loop */
+        sim_assert((!p->parallel_harts), "error: %s at line %d in %s(): %s",
+                   __FILE__, __LINE__, __func__,
+                   "smt_threads cannot be used with parallel_harts");
+
+        /* Every thread needs at least one entry of the partitioned
+         * structures */
+        if (p->smt_resource_policy == SMT_RESOURCES_PARTITIONED)
+        {
+            validate_param("rob_size", 0, p->smt_threads, 2048, p->rob_size);
+            validate_param("iq_size", 0, p->smt_threads, 2048, p->iq_size);
+            validate_param("lsq_size", 0, p->smt_threads, 2048, p->lsq_size);
+        }
     }
 
     validate_param("rtc_freq_mhz", 1, 1, 1000, p->rtc_freq_mhz);
+    validate_param("num_harts", 1, 1, NUM_MAX_HARTS, p->num_harts);
+    validate_param("hart_quantum", 0, 1, 0, p->hart_quantum);
+    validate_param("parallel_harts", 1, 0, 1, p->parallel_harts);
+    if (p->parallel_harts)
+    {
+        validate_param("sync_quantum", 1, 1, 100000, p->sync_quantum);
+    }
+
+    if (p->sweep_file)
+    {
+        validate_param("sweep_jobs", 0, 0, 0, p->sweep_jobs);
+
+        /* Only the calling thread is present in the forked children */
+        sim_assert((!p->parallel_harts), "error: %s at line %d in %s(): %s",
+                   __FILE__, __LINE__, __func__,
+                   "sweep file requires parallel_harts disabled");
+
+        /* The children write to disk images they share with the parent */
+        sim_assert((!p->drives_rw), "error: %s at line %d in %s(): %s",
+                   __FILE__, __LINE__, __func__,
+                   "sweep file requires snapshot or read-only disk images");
+    }
+
+    if (p->lockstep_file)
+    {
+        /* Variants replay the instructions committed by a single in-order
+         * hart, and have a DRAM model instance each */
+        sim_assert((p->core_type == CORE_TYPE_INCORE),
+                   "error: %s at line %d in %s(): %s", __FILE__, __LINE__,
+                   __func__, "lockstep file requires the in-order core");
+        sim_assert((p->num_harts == 1), "error: %s at line %d in %s(): %s",
+                   __FILE__, __LINE__, __func__,
+                   "lockstep file requires a single hart");
+        sim_assert(((p->dram_model_type == MEM_MODEL_BASE)
+                    || (p->dram_model_type == MEM_MODEL_ANALYTICAL)),
+                   "error: %s at line %d in %s(): %s", __FILE__, __LINE__,
+                   __func__, "lockstep file requires base or analytical "
+                             "memory model");
+        sim_assert((!p->sweep_file), "error: %s at line %d in %s(): %s",
+                   __FILE__, __LINE__, __func__,
+                   "lockstep file cannot be used with a sweep file");
+    }
+
+    if (p->enable_vector)
+    {
+        validate_param("vlen", 1, 64, 4096, p->vlen);
+        validate_param_p2("vlen", p->vlen);
+        validate_param("vector_lanes", 1, 1, 64, p->vector_lanes);
+        validate_param_p2("vector_lanes", p->vector_lanes);
+        validate_param("vector_alu_latency", 0, 1, 0, p->vector_alu_latency);
+        validate_param("vector_mul_latency", 0, 1, 0, p->vector_mul_latency);
+        validate_param("vector_div_latency", 0, 1, 0, p->vector_div_latency);
+        validate_param("vector_fpu_latency", 0, 1, 0, p->vector_fpu_latency);
+        validate_param("vector_fpu_div_latency", 0, 1, 0,
+                       p->vector_fpu_div_latency);
+        validate_param("vector_mem_lines_per_cycle", 0, 1, 0,
+                       p->vector_mem_lines_per_cycle);
+
+        /* The lockstep variants have no vector unit */
+        sim_assert((!p->lockstep_file), "error: %s at line %d in %s(): %s",
+                   __FILE__, __LINE__, __func__,
+                   "lockstep file cannot be used with the vector unit");
+    }
+
+    /* A fused pair commits as a single latch, which the lockstep variants
+     * cannot follow */
+    if (p->enable_fusion)
+    {
+        sim_assert((!p->lockstep_file), "error: %s at line %d in %s(): %s",
+                   __FILE__, __LINE__, __func__,
+                   "lockstep file cannot be used with macro-op fusion");
+    }
 
     /* Validate FU config */
     validate_param("num_alu_stages", 0, 1, 2048, p->num_alu_stages);
@@ -379,6 +725,8 @@ sim_params_validate(SimParams *p)
     {
         validate_param_p2("btb_size", p->btb_size);
         validate_param("btb_ways", 0, 1, 2048, p->btb_ways);
+        validate_param("btb_eviction_policy", 1, 0, NUM_MAX_EVICT_POLICIES - 1,
+                       p->btb_eviction_policy);
         validate_param("bpu_type", 1, 0, 1, p->bpu_type);
         validate_param("bpu_flush_on_context_switch", 1, 0, 1,
                        p->bpu_flush_on_context_switch);
@@ -407,48 +755,101 @@ sim_params_validate(SimParams *p)
 
     if (p->enable_l1_caches)
     {
-        validate_param("l1_code_cache_read_latency", 0, 1, 2048,
-                       p->l1_code_cache_read_latency);
-        validate_param("l1_code_cache_size", 0, 1, 2048, p->l1_code_cache_size);
-        validate_param("l1_code_cache_ways", 0, 1, 2048, p->l1_code_cache_ways);
-        validate_param("l1_code_cache_evict", 1, 0, 1, p->l1_code_cache_evict);
-
-        validate_param("l1_data_cache_read_latency", 0, 1, 2048,
-                       p->l1_data_cache_read_latency);
-        validate_param("l1_data_cache_write_latency", 0, 1, 2048,
-                       p->l1_data_cache_write_latency);
-        validate_param("l1_data_cache_size", 0, 1, 2048, p->l1_data_cache_size);
-        validate_param("l1_data_cache_ways", 0, 1, 2048, p->l1_data_cache_ways);
-        validate_param("l1_data_cache_evict", 1, 0, 1, p->l1_data_cache_evict);
-
         validate_param_p2("cache_line_size", p->cache_line_size);
-        validate_param("cache_read_allocate_policy", 1, 0, 1,
-                       p->cache_read_allocate_policy);
-        validate_param("cache_write_allocate_policy", 1, 0, 1,
-                       p->cache_write_allocate_policy);
-        validate_param("cache_write_policy", 1, 0, 1, p->cache_write_policy);
+        validate_cache_params("icache", &p->l1_code_cache, p->cache_line_size);
+        validate_cache_params("dcache", &p->l1_data_cache, p->cache_line_size);
 
-        validate_param("enable_l2_cache", 1, 0, 1, p->enable_l2_cache);
+        validate_param("enable_victim_cache", 1, 0, 1, p->enable_victim_cache);
+        if (p->enable_victim_cache)
+        {
+            validate_param("victim_cache.entries", 0, 1, 2048,
+                           p->victim_cache_entries);
+            validate_param("victim_cache.latency", 0, 1, 2048,
+                           p->victim_cache_latency);
+        }
 
-        if (p->enable_l2_cache)
+        validate_param("num_shared_cache_levels", 1, 0,
+                       NUM_MAX_SHARED_CACHE_LEVELS, p->num_shared_cache_levels);
+
+        validate_param("coherence.protocol", 1, COHERENCE_NONE,
+                       COHERENCE_MOESI, p->coherence_protocol);
+        validate_param("coherence.invalidate_latency", 0, 0, 0,
+                       p->coherence_invalidate_latency);
+        validate_param("coherence.downgrade_latency", 0, 0, 0,
+                       p->coherence_downgrade_latency);
+        validate_param("coherence.c2c_latency", 0, 0, 0,
+                       p->coherence_c2c_latency);
+
+        /* Line size of a shared level can not be smaller than the line size
+         * of the level above it */
+        prev_line_size = p->cache_line_size;
+        for (i = 0; i < p->num_shared_cache_levels; ++i)
         {
-            validate_param("l2_shared_cache_read_latency", 0, 1, 2048,
-                           p->l2_shared_cache_read_latency);
-            validate_param("l2_shared_cache_write_latency", 0, 1, 2048,
-                           p->l2_shared_cache_write_latency);
-            validate_param("l2_shared_cache_size", 0, 1, 2048,
-                           p->l2_shared_cache_size);
-            validate_param("l2_shared_cache_ways", 0, 1, 2048,
-                           p->l2_shared_cache_ways);
-            validate_param("l2_shared_cache_evict", 1, 0, 1,
-                           p->l2_shared_cache_evict);
+            snprintf(cache_name, sizeof(cache_name), "shared_caches[%d]", i);
+            validate_cache_params(cache_name, &p->shared_cache[i],
+                                  prev_line_size);
+
+            /* Lines are moved between an exclusive level and the level above
+             * it as a whole */
+            if (p->shared_cache[i].inclusion_policy
+                == CACHE_INCLUSION_EXCLUSIVE)
+            {
+                sim_assert((p->shared_cache[i].line_size == prev_line_size),
+                           "error: %s at line %d in %s(): %s%s%s", __FILE__,
+                           __LINE__, __func__, "line_size of exclusive cache ",
+                           cache_name,
+                           " must be equal to the line size of the level "
+                           "above it");
+            }
+            prev_line_size = p->shared_cache[i].line_size;
         }
     }
+    else
+    {
+        /* Shared caches are only modeled below the L1 caches */
+        p->num_shared_cache_levels = 0;
+    }
 
     validate_param("tlb_size", 0, 1, 2048, p->tlb_size);
     validate_param("burst_length", 0, 1, 2048, (int)p->burst_length);
     validate_param("mem_access_latency", 0, 1, 2048, p->mem_access_latency);
 
+    if (p->dram_model_type == MEM_MODEL_ANALYTICAL)
+    {
+        validate_param_p2("analytical_dram_model.channels",
+                          p->analytical_dram.num_channels);
+        validate_param_p2("analytical_dram_model.ranks",
+                          p->analytical_dram.num_ranks);
+        validate_param_p2("analytical_dram_model.banks",
+                          p->analytical_dram.num_banks);
+        validate_param_p2("analytical_dram_model.row_buffer_size",
+                          p->analytical_dram.row_buffer_size);
+        validate_param_p2("analytical_dram_model.bus_width",
+                          p->analytical_dram.bus_width);
+        validate_param("analytical_dram_model.freq_mhz", 0, 1, 0,
+                       p->analytical_dram.freq_mhz);
+        validate_param("analytical_dram_model.tRCD", 0, 1, 0,
+                       p->analytical_dram.t_rcd);
+        validate_param("analytical_dram_model.tCAS", 0, 1, 0,
+                       p->analytical_dram.t_cas);
+        validate_param("analytical_dram_model.tRP", 0, 1, 0,
+                       p->analytical_dram.t_rp);
+        validate_param("analytical_dram_model.tRAS", 0, 0, 0,
+                       p->analytical_dram.t_ras);
+
+        /* tREFI set to 0 disables refresh */
+        validate_param("analytical_dram_model.tREFI", 0, 0, 0,
+                       p->analytical_dram.t_refi);
+        validate_param("analytical_dram_model.tRFC", 0, 0, 0,
+                       p->analytical_dram.t_rfc);
+        if (p->analytical_dram.t_refi)
+        {
+            validate_param("analytical_dram_model.tRFC", 1, 0,
+                           p->analytical_dram.t_refi - 1,
+                           p->analytical_dram.t_rfc);
+        }
+    }
+
     /* Create full trace file name */
     strcpy(trace_file_name, p->sim_file_path);
     strcat(trace_file_name, "/");
@@ -457,6 +858,28 @@ sim_params_validate(SimParams *p)
 
     free(p->sim_trace_file);
     p->sim_trace_file = strdup(trace_file_name);
+
+    /* Create full pipeline view trace file name */
+    strcpy(trace_file_name, p->sim_file_path);
+    strcat(trace_file_name, "/");
+    strcat(trace_file_name, p->sim_file_prefix);
+    strcat(trace_file_name, ".pipeview");
+
+    free(p->pipe_trace_file);
+    p->pipe_trace_file = strdup(trace_file_name);
+}
+
+/* Returns the line size of the cache closest to memory, which determines the
+ * size of every request sent to the memory controller */
+int
+sim_params_get_llc_line_size(const SimParams *p)
+{
+    if (p->num_shared_cache_levels)
+    {
+        return p->shared_cache[p->num_shared_cache_levels - 1].line_size;
+    }
+
+    return p->cache_line_size;
 }
 
 static void
@@ -505,9 +928,303 @@ log_default_param_str(const char *obj, const char *param, const char *val)
                   obj, obj, param, val);
 }
 
+/* Returns EVICT_POLICY_* type for the given policy name, or -1 if the name is
+ * invalid. "lru" selects bit-PLRU, as in older versions, true LRU is
+ * "true-lru". */
+static int
+parse_evict_policy_str(const char *str)
+{
+    int i;
+
+    if (strcmp(str, "lru") == 0)
+    {
+        sim_log_event(sim_log, "parsing config file: eviction policy lru is "
+                               "an alias of bit-plru, true LRU is true-lru");
+        return EVICT_POLICY_BIT_PLRU;
+    }
+
+    for (i = 0; i < NUM_MAX_EVICT_POLICIES; ++i)
+    {
+        if (strcmp(str, evict_policy_str[i]) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void
+inherit_common_cache_params(const SimParams *p, CacheParams *c)
+{
+    c->line_size = p->cache_line_size;
+    c->read_allocate_policy = p->cache_read_allocate_policy;
+    c->write_allocate_policy = p->cache_write_allocate_policy;
+    c->write_policy = p->cache_write_policy;
+}
+
+static void
+parse_analytical_dram_params(JSONValue obj, const char *obj_name,
+                             AnalyticalDramParams *ap)
+{
+    const char *tag_name;
+    const char *str;
+
+    if (json_is_undefined(obj))
+    {
+        log_default_param_str(obj_name, "", "");
+    }
+
+    tag_name = "channels";
+    if (vm_get_int(obj, tag_name, &ap->num_channels) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, ap->num_channels);
+    }
+
+    tag_name = "ranks";
+    if (vm_get_int(obj, tag_name, &ap->num_ranks) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, ap->num_ranks);
+    }
+
+    tag_name = "banks";
+    if (vm_get_int(obj, tag_name, &ap->num_banks) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, ap->num_banks);
+    }
+
+    tag_name = "row_buffer_size";
+    if (vm_get_int(obj, tag_name, &ap->row_buffer_size) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, ap->row_buffer_size);
+    }
+
+    tag_name = "bus_width";
+    if (vm_get_int(obj, tag_name, &ap->bus_width) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, ap->bus_width);
+    }
+
+    tag_name = "freq_mhz";
+    if (vm_get_int(obj, tag_name, &ap->freq_mhz) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, ap->freq_mhz);
+    }
+
+    tag_name = "tRCD";
+    if (vm_get_int(obj, tag_name, &ap->t_rcd) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, ap->t_rcd);
+    }
+
+    tag_name = "tCAS";
+    if (vm_get_int(obj, tag_name, &ap->t_cas) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, ap->t_cas);
+    }
+
+    tag_name = "tRP";
+    if (vm_get_int(obj, tag_name, &ap->t_rp) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, ap->t_rp);
+    }
+
+    tag_name = "tRAS";
+    if (vm_get_int(obj, tag_name, &ap->t_ras) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, ap->t_ras);
+    }
+
+    tag_name = "tREFI";
+    if (vm_get_int(obj, tag_name, &ap->t_refi) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, ap->t_refi);
+    }
+
+    tag_name = "tRFC";
+    if (vm_get_int(obj, tag_name, &ap->t_rfc) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, ap->t_rfc);
+    }
+
+    tag_name = "address_mapping";
+    if (vm_get_str(obj, tag_name, &str) < 0)
+    {
+        log_default_param_str(obj_name, tag_name, ap->address_mapping);
+    }
+    else
+    {
+        free(ap->address_mapping);
+        ap->address_mapping = strdup(str);
+        assert(ap->address_mapping);
+    }
+
+    tag_name = "page_policy";
+    if (vm_get_str(obj, tag_name, &str) < 0)
+    {
+        log_default_param_str(obj_name, tag_name,
+                              dram_page_policy_str[ap->page_policy]);
+    }
+    else
+    {
+        if (strcmp(str, "open") == 0)
+        {
+            ap->page_policy = DRAM_PAGE_POLICY_OPEN;
+        }
+        else if (strcmp(str, "closed") == 0)
+        {
+            ap->page_policy = DRAM_PAGE_POLICY_CLOSED;
+        }
+        else
+        {
+            sim_assert((0), "error: %s at line %d in %s(): error parsing "
+                            "param - %s->%s has invalid value",
+                       __FILE__, __LINE__, __func__, obj_name, tag_name);
+        }
+    }
+}
+
+static void
+parse_cache_params(JSONValue obj, const char *obj_name, CacheParams *c,
+                   int is_shared)
+{
+    const char *tag_name, *str;
+
+    if (json_is_undefined(obj))
+    {
+        log_default_param_str(obj_name, "", "");
+    }
+
+    tag_name = "latency";
+    if (vm_get_int(obj, tag_name, &c->read_latency) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, c->read_latency);
+    }
+
+    tag_name = "write_latency";
+    if (vm_get_int(obj, tag_name, &c->write_latency) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, c->write_latency);
+    }
+
+    tag_name = "size";
+    if (vm_get_int(obj, tag_name, &c->size) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, c->size);
+    }
+
+    tag_name = "ways";
+    if (vm_get_int(obj, tag_name, &c->ways) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, c->ways);
+    }
+
+    tag_name = "eviction";
+    if (vm_get_str(obj, tag_name, &str) < 0)
+    {
+        log_default_param_str(obj_name, tag_name, evict_policy_str[c->evict]);
+    }
+    else
+    {
+        c->evict = parse_evict_policy_str(str);
+        sim_assert((c->evict >= 0), "error: %s at line %d in %s(): error "
+                                    "parsing param - %s->%s has invalid value",
+                   __FILE__, __LINE__, __func__, obj_name, tag_name);
+    }
+
+    if (!is_shared)
+    {
+        /* Split L1 caches always use the common cache parameters */
+        return;
+    }
+
+    tag_name = "line_size";
+    if (vm_get_int(obj, tag_name, &c->line_size) < 0)
+    {
+        log_default_param_int(obj_name, tag_name, c->line_size);
+    }
+
+    tag_name = "allocate_on_write_miss";
+    if (vm_get_str(obj, tag_name, &str) < 0)
+    {
+        log_default_param_str(obj_name, tag_name,
+                              cache_wa_str[c->write_allocate_policy]);
+    }
+    else
+    {
+        if (strcmp(str, "true") == 0)
+        {
+            c->write_allocate_policy = CACHE_WRITE_ALLOC;
+        }
+        else if (strcmp(str, "false") == 0)
+        {
+            c->write_allocate_policy = CACHE_WRITE_NO_ALLOC;
+        }
+        else
+        {
+            sim_assert((0), "error: %s at line %d in %s(): error parsing "
+                            "param - %s->%s has invalid value",
+                       __FILE__, __LINE__, __func__, obj_name, tag_name);
+        }
+    }
+
+    tag_name = "write_policy";
+    if (vm_get_str(obj, tag_name, &str) < 0)
+    {
+        log_default_param_str(obj_name, tag_name,
+                              cache_wp_str[c->write_policy]);
+    }
+    else
+    {
+        if (strcmp(str, "writeback") == 0)
+        {
+            c->write_policy = CACHE_WRITEBACK;
+        }
+        else if (strcmp(str, "writethrough") == 0)
+        {
+            c->write_policy = CACHE_WRITETHROUGH;
+        }
+        else
+        {
+            sim_assert((0), "error: %s at line %d in %s(): error parsing "
+                            "param - %s->%s has invalid value",
+                       __FILE__, __LINE__, __func__, obj_name, tag_name);
+        }
+    }
+
+    tag_name = "inclusion";
+    if (vm_get_str(obj, tag_name, &str) < 0)
+    {
+        log_default_param_str(obj_name, tag_name,
+                              cache_inclusion_str[c->inclusion_policy]);
+    }
+    else
+    {
+        if (strcmp(str, "nine") == 0)
+        {
+            c->inclusion_policy = CACHE_INCLUSION_NINE;
+        }
+        else if (strcmp(str, "inclusive") == 0)
+        {
+            c->inclusion_policy = CACHE_INCLUSION_INCLUSIVE;
+        }
+        else if (strcmp(str, "exclusive") == 0)
+        {
+            c->inclusion_policy = CACHE_INCLUSION_EXCLUSIVE;
+        }
+        else
+        {
+            sim_assert((0), "error: %s at line %d in %s(): error parsing "
+                            "param - %s->%s has invalid value",
+                       __FILE__, __LINE__, __func__, obj_name, tag_name);
+        }
+    }
+}
+
 void
 sim_params_parse(SimParams *p, JSONValue cfg)
 {
+    int i;
     char buf1[256];
     const char *tag_name, *str;
     JSONValue core_obj, obj, obj1;
@@ -562,6 +1279,48 @@ sim_params_parse(SimParams *p, JSONValue cfg)
         log_default_param_int(buf1, tag_name, p->cpu_freq_mhz);
     }
 
+    tag_name = "num_harts";
+    if (vm_get_int(core_obj, tag_name, &p->num_harts) < 0)
+    {
+        log_default_param_int(buf1, tag_name, p->num_harts);
+    }
+
+    tag_name = "hart_quantum";
+    if (vm_get_int(core_obj, tag_name, &p->hart_quantum) < 0)
+    {
+        log_default_param_int(buf1, tag_name, p->hart_quantum);
+    }
+
+    tag_name = "parallel_harts";
+    if (vm_get_str(core_obj, tag_name, &str) < 0)
+    {
+        log_default_param_str(buf1, tag_name,
+                              sim_param_status[p->parallel_harts]);
+    }
+    else
+    {
+        if (strcmp(str, "false") == 0)
+        {
+            p->parallel_harts = DISABLE;
+        }
+        else if (strcmp(str, "true") == 0)
+        {
+            p->parallel_harts = ENABLE;
+        }
+        else
+        {
+            sim_assert((0), "error: %s at line %d in %s(): error parsing "
+                            "param - %s->%s has invalid value",
+                       __FILE__, __LINE__, __func__, buf1, tag_name);
+        }
+    }
+
+    tag_name = "sync_quantum";
+    if (vm_get_int(core_obj, tag_name, &p->sync_quantum) < 0)
+    {
+        log_default_param_int(buf1, tag_name, p->sync_quantum);
+    }
+
     if (p->core_type == CORE_TYPE_INCORE)
     {
         snprintf(buf1, sizeof(buf1), "%s", "incore");
@@ -617,6 +1376,60 @@ sim_params_parse(SimParams *p, JSONValue cfg)
         {
             log_default_param_int(buf1, tag_name, p->lsq_size);
         }
+
+        tag_name = "smt_threads";
+        if (vm_get_int(obj1, tag_name, &p->smt_threads) < 0)
+        {
+            log_default_param_int(buf1, tag_name, p->smt_threads);
+        }
+
+        tag_name = "smt_resource_policy";
+        if (vm_get_str(obj1, tag_name, &str) < 0)
+        {
+            log_default_param_str(
+                buf1, tag_name, smt_resource_policy_str[p->smt_resource_policy]);
+        }
+        else
+        {
+            if (strcmp(str, "shared") == 0)
+            {
+                p->smt_resource_policy = SMT_RESOURCES_SHARED;
+            }
+            else if (strcmp(str, "partitioned") == 0)
+            {
+                p->smt_resource_policy = SMT_RESOURCES_PARTITIONED;
+            }
+            else
+            {
+                sim_assert((0), "error: %s at line %d in %s(): error parsing "
+                                "param - %s->%s has invalid value",
+                           __FILE__, __LINE__, __func__, buf1, tag_name);
+            }
+        }
+
+        tag_name = "smt_fetch_policy";
+        if (vm_get_str(obj1, tag_name, &str) < 0)
+        {
+            log_default_param_str(buf1, tag_name,
+                                  smt_fetch_policy_str[p->smt_fetch_policy]);
+        }
+        else
+        {
+            if (strcmp(str, "round-robin") == 0)
+            {
+                p->smt_fetch_policy = SMT_FETCH_ROUND_ROBIN;
+            }
+            else if (strcmp(str, "icount") == 0)
+            {
+                p->smt_fetch_policy = SMT_FETCH_ICOUNT;
+            }
+            else
+            {
+                sim_assert((0), "error: %s at line %d in %s(): error parsing "
+                                "param - %s->%s has invalid value",
+                           __FILE__, __LINE__, __func__, buf1, tag_name);
+            }
+        }
     }
 
     snprintf(buf1, sizeof(buf1), "%s", "functional_units");
@@ -821,6 +1634,149 @@ sim_params_parse(SimParams *p, JSONValue cfg)
         log_default_param_int(buf1, tag_name,
                               p->fpu_alu_latency[FU_FPU_ALU_FCLASS]);
     }
+    /* Vector unit */
+    snprintf(buf1, sizeof(buf1), "%s", "vector_unit");
+    obj = json_object_get(core_obj, buf1);
+
+    if (json_is_undefined(obj))
+    {
+        log_default_param_str(buf1, "", "");
+    }
+
+    tag_name = "enable";
+    if (vm_get_str(obj, tag_name, &str) < 0)
+    {
+        log_default_param_str(buf1, tag_name, sim_param_status[p->enable_vector]);
+    }
+    else
+    {
+        if (strcmp(str, "false") == 0)
+        {
+            p->enable_vector = DISABLE;
+        }
+        else if (strcmp(str, "true") == 0)
+        {
+            p->enable_vector = ENABLE;
+        }
+        else
+        {
+            sim_assert((0), "error: %s at line %d in %s(): error parsing "
+                            "param - %s->%s has invalid value",
+                       __FILE__, __LINE__, __func__, buf1, tag_name);
+        }
+    }
+
+    tag_name = "vlen";
+    if (vm_get_int(obj, tag_name, &p->vlen) < 0)
+    {
+        log_default_param_int(buf1, tag_name, p->vlen);
+    }
+
+    tag_name = "lanes";
+    if (vm_get_int(obj, tag_name, &p->vector_lanes) < 0)
+    {
+        log_default_param_int(buf1, tag_name, p->vector_lanes);
+    }
+
+    tag_name = "chaining";
+    if (vm_get_str(obj, tag_name, &str) < 0)
+    {
+        log_default_param_str(buf1, tag_name, sim_param_status[p->vector_chaining]);
+    }
+    else
+    {
+        if (strcmp(str, "false") == 0)
+        {
+            p->vector_chaining = DISABLE;
+        }
+        else if (strcmp(str, "true") == 0)
+        {
+            p->vector_chaining = ENABLE;
+        }
+        else
+        {
+            sim_assert((0), "error: %s at line %d in %s(): error parsing "
+                            "param - %s->%s has invalid value",
+                       __FILE__, __LINE__, __func__, buf1, tag_name);
+        }
+    }
+
+    tag_name = "alu_latency";
+    if (vm_get_int(obj, tag_name, &p->vector_alu_latency) < 0)
+    {
+        log_default_param_int(buf1, tag_name, p->vector_alu_latency);
+    }
+
+    tag_name = "mul_latency";
+    if (vm_get_int(obj, tag_name, &p->vector_mul_latency) < 0)
+    {
+        log_default_param_int(buf1, tag_name, p->vector_mul_latency);
+    }
+
+    tag_name = "div_latency";
+    if (vm_get_int(obj, tag_name, &p->vector_div_latency) < 0)
+    {
+        log_default_param_int(buf1, tag_name, p->vector_div_latency);
+    }
+
+    tag_name = "fpu_latency";
+    if (vm_get_int(obj, tag_name, &p->vector_fpu_latency) < 0)
+    {
+        log_default_param_int(buf1, tag_name, p->vector_fpu_latency);
+    }
+
+    tag_name = "fpu_div_latency";
+    if (vm_get_int(obj, tag_name, &p->vector_fpu_div_latency) < 0)
+    {
+        log_default_param_int(buf1, tag_name, p->vector_fpu_div_latency);
+    }
+
+    tag_name = "mem_lines_per_cycle";
+    if (vm_get_int(obj, tag_name, &p->vector_mem_lines_per_cycle) < 0)
+    {
+        log_default_param_int(buf1, tag_name, p->vector_mem_lines_per_cycle);
+    }
+
+    /* Macro-op fusion */
+    snprintf(buf1, sizeof(buf1), "%s", "fusion");
+    obj = json_object_get(core_obj, buf1);
+
+    if (json_is_undefined(obj))
+    {
+        log_default_param_str(buf1, "", "");
+    }
+
+    for (i = FUSION_NONE + 1; i < NUM_FUSION_PATTERNS; ++i)
+    {
+        tag_name = fusion_pattern_str[i];
+        if (vm_get_str(obj, tag_name, &str) < 0)
+        {
+            log_default_param_str(buf1, tag_name,
+                                  sim_param_status[p->fusion[i]]);
+        }
+        else
+        {
+            if (strcmp(str, "false") == 0)
+            {
+                p->fusion[i] = DISABLE;
+            }
+            else if (strcmp(str, "true") == 0)
+            {
+                p->fusion[i] = ENABLE;
+            }
+            else
+            {
+                sim_assert((0), "error: %s at line %d in %s(): error parsing "
+                                "param - %s->%s has invalid value",
+                           __FILE__, __LINE__, __func__, buf1, tag_name);
+            }
+        }
+
+        if (p->fusion[i])
+        {
+            p->enable_fusion = ENABLE;
+        }
+    }
 
     /* BPU */
     snprintf(buf1, sizeof(buf1), "%s", "bpu");
@@ -908,20 +1864,11 @@ sim_params_parse(SimParams *p, JSONValue cfg)
         }
         else
         {
-            if (strcmp(str, "random") == 0)
-            {
-                p->btb_eviction_policy = EVICT_POLICY_RANDOM;
-            }
-            else if (strcmp(str, "lru") == 0)
-            {
-                p->btb_eviction_policy = EVICT_POLICY_BIT_PLRU;
-            }
-            else
-            {
-                sim_assert((0), "error: %s at line %d in %s(): error parsing "
-                                "param - %s->%s has invalid value",
-                           __FILE__, __LINE__, __func__, buf1, tag_name);
-            }
+            p->btb_eviction_policy = parse_evict_policy_str(str);
+            sim_assert((p->btb_eviction_policy >= 0),
+                       "error: %s at line %d in %s(): error parsing "
+                       "param - %s->%s has invalid value",
+                       __FILE__, __LINE__, __func__, buf1, tag_name);
         }
 
         tag_name = "bpu_type";
@@ -1074,108 +2021,8 @@ sim_params_parse(SimParams *p, JSONValue cfg)
 
     if (p->enable_l1_caches)
     {
-        snprintf(buf1, sizeof(buf1), "%s", "icache");
-        obj = json_object_get(obj1, buf1);
-
-        if (json_is_undefined(obj))
-        {
-            log_default_param_str(buf1, "", "");
-        }
-
-        tag_name = "latency";
-        if (vm_get_int(obj, tag_name, &p->l1_code_cache_read_latency) < 0)
-        {
-            log_default_param_int(buf1, tag_name,
-                                  p->l1_code_cache_read_latency);
-        }
-
-        tag_name = "size";
-        if (vm_get_int(obj, tag_name, &p->l1_code_cache_size) < 0)
-        {
-            log_default_param_int(buf1, tag_name, p->l1_code_cache_size);
-        }
-
-        tag_name = "ways";
-        if (vm_get_int(obj, tag_name, &p->l1_code_cache_ways) < 0)
-        {
-            log_default_param_int(buf1, tag_name, p->l1_code_cache_ways);
-        }
-
-        tag_name = "eviction";
-        if (vm_get_str(obj, tag_name, &str) < 0)
-        {
-            log_default_param_str(buf1, tag_name,
-                                  evict_policy_str[p->l1_code_cache_evict]);
-        }
-        else
-        {
-            if (strcmp(str, "lru") == 0)
-            {
-                p->l1_code_cache_evict = EVICT_POLICY_BIT_PLRU;
-            }
-            else if (strcmp(str, "random") == 0)
-            {
-                p->l1_code_cache_evict = EVICT_POLICY_RANDOM;
-            }
-            else
-            {
-                sim_assert((0), "error: %s at line %d in %s(): error parsing "
-                                "param - %s->%s has invalid value",
-                           __FILE__, __LINE__, __func__, buf1, tag_name);
-            }
-        }
-
-        snprintf(buf1, sizeof(buf1), "%s", "dcache");
-        obj = json_object_get(obj1, buf1);
-
-        if (json_is_undefined(obj))
-        {
-            log_default_param_str(buf1, "", "");
-        }
-
-        tag_name = "latency";
-        if (vm_get_int(obj, tag_name, &p->l1_data_cache_read_latency) < 0)
-        {
-            log_default_param_int(buf1, tag_name,
-                                  p->l1_data_cache_read_latency);
-        }
-
-        tag_name = "size";
-        if (vm_get_int(obj, tag_name, &p->l1_data_cache_size) < 0)
-        {
-            log_default_param_int(buf1, tag_name, p->l1_data_cache_size);
-        }
-
-        tag_name = "ways";
-        if (vm_get_int(obj, tag_name, &p->l1_data_cache_ways) < 0)
-        {
-            log_default_param_int(buf1, tag_name, p->l1_data_cache_ways);
-        }
-
-        tag_name = "eviction";
-        if (vm_get_str(obj, tag_name, &str) < 0)
-        {
-            log_default_param_str(buf1, tag_name,
-                                  evict_policy_str[p->l1_data_cache_evict]);
-        }
-        else
-        {
-            if (strcmp(str, "lru") == 0)
-            {
-                p->l1_data_cache_evict = EVICT_POLICY_BIT_PLRU;
-            }
-            else if (strcmp(str, "random") == 0)
-            {
-                p->l1_data_cache_evict = EVICT_POLICY_RANDOM;
-            }
-            else
-            {
-                sim_assert((0), "error: %s at line %d in %s(): error parsing "
-                                "param - %s->%s has invalid value",
-                           __FILE__, __LINE__, __func__, buf1, tag_name);
-            }
-        }
-
+        /* Common cache parameters are parsed first, as these are inherited by
+         * every cache level */
         tag_name = "line_size";
         if (vm_get_int(obj1, tag_name, &p->cache_line_size) < 0)
         {
@@ -1230,29 +2077,32 @@ sim_params_parse(SimParams *p, JSONValue cfg)
             }
         }
 
-        snprintf(buf1, sizeof(buf1), "%s", "l2_shared_cache");
-        obj = json_object_get(obj1, buf1);
+        inherit_common_cache_params(p, &p->l1_code_cache);
+        parse_cache_params(json_object_get(obj1, "icache"), "icache",
+                           &p->l1_code_cache, FALSE);
 
-        if (json_is_undefined(obj))
-        {
-            log_default_param_str(buf1, "", "");
-        }
+        inherit_common_cache_params(p, &p->l1_data_cache);
+        parse_cache_params(json_object_get(obj1, "dcache"), "dcache",
+                           &p->l1_data_cache, FALSE);
+
+        snprintf(buf1, sizeof(buf1), "%s", "victim_cache");
+        obj = json_object_get(obj1, buf1);
 
         tag_name = "enable";
         if (vm_get_str(obj, tag_name, &str) < 0)
         {
             log_default_param_str(buf1, tag_name,
-                                  sim_param_status[p->enable_l2_cache]);
+                                  sim_param_status[p->enable_victim_cache]);
         }
         else
         {
             if (strcmp(str, "false") == 0)
             {
-                p->enable_l2_cache = DISABLE;
+                p->enable_victim_cache = DISABLE;
             }
             else if (strcmp(str, "true") == 0)
             {
-                p->enable_l2_cache = ENABLE;
+                p->enable_victim_cache = ENABLE;
             }
             else
             {
@@ -1262,42 +2112,121 @@ sim_params_parse(SimParams *p, JSONValue cfg)
             }
         }
 
-        if (p->enable_l2_cache)
+        if (p->enable_victim_cache)
         {
+            tag_name = "entries";
+            if (vm_get_int(obj, tag_name, &p->victim_cache_entries) < 0)
+            {
+                log_default_param_int(buf1, tag_name, p->victim_cache_entries);
+            }
+
             tag_name = "latency";
-            if (vm_get_int(obj, tag_name, &p->l2_shared_cache_read_latency) < 0)
+            if (vm_get_int(obj, tag_name, &p->victim_cache_latency) < 0)
             {
-                log_default_param_int(buf1, tag_name,
-                                      p->l2_shared_cache_read_latency);
+                log_default_param_int(buf1, tag_name, p->victim_cache_latency);
             }
+        }
+
+        snprintf(buf1, sizeof(buf1), "%s", "coherence");
+        obj = json_object_get(obj1, buf1);
 
-            tag_name = "size";
-            if (vm_get_int(obj, tag_name, &p->l2_shared_cache_size) < 0)
+        tag_name = "protocol";
+        if (vm_get_str(obj, tag_name, &str) < 0)
+        {
+            log_default_param_str(buf1, tag_name,
+                                  coherence_protocol_str[p->coherence_protocol]);
+        }
+        else
+        {
+            if (strcmp(str, "none") == 0)
+            {
+                p->coherence_protocol = COHERENCE_NONE;
+            }
+            else if (strcmp(str, "mesi") == 0)
+            {
+                p->coherence_protocol = COHERENCE_MESI;
+            }
+            else if (strcmp(str, "moesi") == 0)
+            {
+                p->coherence_protocol = COHERENCE_MOESI;
+            }
+            else
             {
-                log_default_param_int(buf1, tag_name, p->l2_shared_cache_size);
+                sim_assert((0), "error: %s at line %d in %s(): error parsing "
+                                "param - %s->%s has invalid value",
+                           __FILE__, __LINE__, __func__, buf1, tag_name);
             }
+        }
+
+        tag_name = "invalidate_latency";
+        if (vm_get_int(obj, tag_name, &p->coherence_invalidate_latency) < 0)
+        {
+            log_default_param_int(buf1, tag_name,
+                                  p->coherence_invalidate_latency);
+        }
+
+        tag_name = "downgrade_latency";
+        if (vm_get_int(obj, tag_name, &p->coherence_downgrade_latency) < 0)
+        {
+            log_default_param_int(buf1, tag_name,
+                                  p->coherence_downgrade_latency);
+        }
+
+        tag_name = "c2c_latency";
+        if (vm_get_int(obj, tag_name, &p->coherence_c2c_latency) < 0)
+        {
+            log_default_param_int(buf1, tag_name, p->coherence_c2c_latency);
+        }
+
+        for (i = 0; i < NUM_MAX_SHARED_CACHE_LEVELS; ++i)
+        {
+            inherit_common_cache_params(p, &p->shared_cache[i]);
+        }
 
-            tag_name = "ways";
-            if (vm_get_int(obj, tag_name, &p->l2_shared_cache_ways) < 0)
+        /* Shared cache levels are specified as a list ordered from L2 towards
+         * the last level cache */
+        snprintf(buf1, sizeof(buf1), "%s", "shared_caches");
+        obj = json_object_get(obj1, buf1);
+
+        if (obj.type == JSON_ARRAY)
+        {
+            p->num_shared_cache_levels = obj.u.array->len;
+            sim_assert((p->num_shared_cache_levels
+                        <= NUM_MAX_SHARED_CACHE_LEVELS),
+                       "error: %s at line %d in %s(): error parsing param - "
+                       "%s can specify at most %d levels",
+                       __FILE__, __LINE__, __func__, buf1,
+                       NUM_MAX_SHARED_CACHE_LEVELS);
+
+            for (i = 0; i < p->num_shared_cache_levels; ++i)
             {
-                log_default_param_int(buf1, tag_name, p->l2_shared_cache_ways);
+                snprintf(buf1, sizeof(buf1), "shared_caches[%d]", i);
+                parse_cache_params(json_array_get(obj, i), buf1,
+                                   &p->shared_cache[i], TRUE);
             }
+        }
+        else
+        {
+            /* Older configuration files only specify a single L2 cache */
+            snprintf(buf1, sizeof(buf1), "%s", "l2_shared_cache");
+            obj = json_object_get(obj1, buf1);
 
-            tag_name = "eviction";
+            tag_name = "enable";
             if (vm_get_str(obj, tag_name, &str) < 0)
             {
                 log_default_param_str(
-                    buf1, tag_name, evict_policy_str[p->l2_shared_cache_evict]);
+                    buf1, tag_name,
+                    sim_param_status[p->num_shared_cache_levels ? 1 : 0]);
             }
             else
             {
-                if (strcmp(str, "lru") == 0)
+                if (strcmp(str, "false") == 0)
                 {
-                    p->l2_shared_cache_evict = EVICT_POLICY_BIT_PLRU;
+                    p->num_shared_cache_levels = 0;
                 }
-                else if (strcmp(str, "random") == 0)
+                else if (strcmp(str, "true") == 0)
                 {
-                    p->l2_shared_cache_evict = EVICT_POLICY_RANDOM;
+                    p->num_shared_cache_levels = 1;
                 }
                 else
                 {
@@ -1307,6 +2236,11 @@ sim_params_parse(SimParams *p, JSONValue cfg)
                                __FILE__, __LINE__, __func__, buf1, tag_name);
                 }
             }
+
+            if (p->num_shared_cache_levels)
+            {
+                parse_cache_params(obj, buf1, &p->shared_cache[0], TRUE);
+            }
         }
     }
 
@@ -1393,6 +2327,13 @@ sim_params_parse(SimParams *p, JSONValue cfg)
             }
             break;
         }
+        case MEM_MODEL_ANALYTICAL:
+        {
+            snprintf(buf1, sizeof(buf1), "%s", "analytical_dram_model");
+            parse_analytical_dram_params(json_object_get(obj1, buf1), buf1,
+                                         &p->analytical_dram);
+            break;
+        }
         default:
         {
             sim_assert((0),
@@ -1496,6 +2437,12 @@ sim_params_free(SimParams *p)
     free(p->sim_trace_file);
     p->sim_trace_file = NULL;
 
+    free(p->pipe_trace_file);
+    p->pipe_trace_file = NULL;
+
+    free(p->profile_symbol_file);
+    p->profile_symbol_file = NULL;
+
     free(p->sim_log_file);
     p->sim_log_file = NULL;
 
@@ -1511,8 +2458,23 @@ sim_params_free(SimParams *p)
     free(p->ramulator_config_file);
     p->ramulator_config_file = NULL;
 
+    free(p->analytical_dram.address_mapping);
+    p->analytical_dram.address_mapping = NULL;
+
     free(p->sim_stats_shm_name);
     p->sim_stats_shm_name = NULL;
 
+    free(p->cfg_file);
+    p->cfg_file = NULL;
+
+    free(p->sweep_file);
+    p->sweep_file = NULL;
+
+    free(p->lockstep_file);
+    p->lockstep_file = NULL;
+
+    free(p->elf_file);
+    p->elf_file = NULL;
+
     free(p);
 }
\ No newline at end of file
@@ -78,6 +78,36 @@ enum CACHE_WRITE_POLICY
     CACHE_WRITETHROUGH,
 };
 
+/* Inclusion of a shared cache level with respect to the levels above it */
+enum CACHE_INCLUSION_POLICY
+{
+    CACHE_INCLUSION_NINE,
+    CACHE_INCLUSION_INCLUSIVE,
+    CACHE_INCLUSION_EXCLUSIVE,
+};
+
+/* Coherence protocol for the private data caches of a multi-hart machine */
+enum COHERENCE_PROTOCOL
+{
+    COHERENCE_NONE,
+    COHERENCE_MESI,
+    COHERENCE_MOESI,
+};
+
+/* Sharing of ROB, IQ, LSQ and issue ports among the threads of an SMT core */
+enum SMT_RESOURCE_POLICY
+{
+    SMT_RESOURCES_SHARED,
+    SMT_RESOURCES_PARTITIONED,
+};
+
+/* Selection of the thread fetching in a cycle on an SMT core */
+enum SMT_FETCH_POLICY
+{
+    SMT_FETCH_ROUND_ROBIN,
+    SMT_FETCH_ICOUNT,
+};
+
 enum BPU_ALIAS_FUNC
 {
     BPU_ALIAS_FUNC_XOR,
@@ -90,6 +120,14 @@ enum MEM_MODEL_TYPE
     MEM_MODEL_BASE,
     MEM_MODEL_DRAMSIM,
     MEM_MODEL_RAMULATOR,
+    MEM_MODEL_ANALYTICAL,
+};
+
+/* Row buffer management policy for analytical DRAM model */
+enum DRAM_PAGE_POLICY
+{
+    DRAM_PAGE_POLICY_OPEN,
+    DRAM_PAGE_POLICY_CLOSED,
 };
 
 /* Default values for simulation parameters */
@@ -102,6 +140,7 @@ enum MEM_MODEL_TYPE
 #define DEF_SIM_FILE_PATH "."
 #define DEF_SIM_FILE_PREFIX "sim"
 #define DEF_SIM_TRACE_FILE DEF_SIM_FILE_PREFIX".trace"
+#define DEF_PIPE_TRACE_FILE DEF_SIM_FILE_PREFIX".pipeview"
 #define DEF_SIM_LOG_FILE DEF_SIM_FILE_PREFIX".log"
 #define DEF_SIM_STATS_SHM_NAME DEF_SIM_FILE_PREFIX"-shm"
 
@@ -114,6 +153,25 @@ enum MEM_MODEL_TYPE
 #define DEF_ROB_COMMIT_PORTS 1
 #define DEF_LSQ_SIZE 16
 
+/* Maximum number of hardware threads (SMT) per out-of-order core */
+#define NUM_MAX_SMT_THREADS 4
+#define DEF_SMT_THREADS 1
+#define DEF_SMT_RESOURCE_POLICY SMT_RESOURCES_SHARED
+#define DEF_SMT_FETCH_POLICY SMT_FETCH_ROUND_ROBIN
+
+#define DEF_ENABLE_VECTOR DISABLE
+#define DEF_VLEN 256
+#define DEF_VECTOR_LANES 2
+#define DEF_VECTOR_CHAINING ENABLE
+#define DEF_VECTOR_ALU_LATENCY 1
+#define DEF_VECTOR_MUL_LATENCY 3
+#define DEF_VECTOR_DIV_LATENCY 20
+#define DEF_VECTOR_FPU_LATENCY 4
+#define DEF_VECTOR_FPU_DIV_LATENCY 20
+#define DEF_VECTOR_MEM_LINES_PER_CYCLE 1
+
+#define DEF_ENABLE_FUSION DISABLE
+
 #define DEF_NUM_ALU_STAGES 1
 #define DEF_NUM_MUL_STAGES 1
 #define DEF_NUM_DIV_STAGES 1
@@ -154,6 +212,24 @@ enum MEM_MODEL_TYPE
 #define DEF_L2_CACHE_WAYS 16
 #define DEF_L2_CACHE_EVICT EVICT_POLICY_RANDOM
 
+/* Used for every shared cache level configured after L2 */
+#define DEF_L3_CACHE_READ_LATENCY 20
+#define DEF_L3_CACHE_WRITE_LATENCY 20
+#define DEF_L3_CACHE_SIZE 2048
+#define DEF_L3_CACHE_WAYS 16
+#define DEF_L3_CACHE_EVICT EVICT_POLICY_RANDOM
+
+#define DEF_CACHE_INCLUSION_POLICY CACHE_INCLUSION_NINE
+
+#define DEF_ENABLE_VICTIM_CACHE DISABLE
+#define DEF_VICTIM_CACHE_ENTRIES 8
+#define DEF_VICTIM_CACHE_LATENCY 1
+
+#define DEF_COHERENCE_PROTOCOL COHERENCE_MESI
+#define DEF_COHERENCE_INVALIDATE_LATENCY 10
+#define DEF_COHERENCE_DOWNGRADE_LATENCY 10
+#define DEF_COHERENCE_C2C_LATENCY 15
+
 #define DEF_CACHE_READ_ALLOC_POLICY CACHE_READ_ALLOC
 #define DEF_CACHE_WRITE_ALLOC_POLICY CACHE_WRITE_ALLOC
 #define DEF_CACHE_WRITE_POLICY CACHE_WRITEBACK
@@ -169,21 +245,86 @@ enum MEM_MODEL_TYPE
 #define DEF_DRAMSIM_CONFIG_FILE "DRAMsim3/configs/DDR4_4Gb_x16_2400.ini"
 #define DEF_RAMULATOR_CONFIG_FILE "ramulator/configs/DDR4-config.cfg"
 
+/* Analytical DRAM model defaults, roughly a single channel DDR4-2400 with
+ * timings in DRAM clock cycles */
+#define DEF_ADRAM_CHANNELS 1
+#define DEF_ADRAM_RANKS 1
+#define DEF_ADRAM_BANKS 16
+#define DEF_ADRAM_ROW_BUFFER_SIZE 8192
+#define DEF_ADRAM_BUS_WIDTH 8
+#define DEF_ADRAM_ADDRESS_MAPPING "rorabachco"
+#define DEF_ADRAM_PAGE_POLICY DRAM_PAGE_POLICY_OPEN
+#define DEF_ADRAM_FREQ_MHZ 1200
+#define DEF_ADRAM_TRCD 16
+#define DEF_ADRAM_TCAS 16
+#define DEF_ADRAM_TRP 16
+#define DEF_ADRAM_TRAS 39
+#define DEF_ADRAM_TREFI 9360
+#define DEF_ADRAM_TRFC 420
+
 #define DEF_SIM_EMULATE_AFTER_ICOUNT 0
 
 #define DEF_RTC_FREQ_MHZ 10
 #define DEF_CPU_FREQ_MHZ 1000
 
+/* Maximum number of harts (simulated cores) in the machine */
+#define NUM_MAX_HARTS 8
+#define DEF_NUM_HARTS 1
+#define DEF_HART_QUANTUM 1000
+#define DEF_PARALLEL_HARTS DISABLE
+#define DEF_SYNC_QUANTUM 500
+
 extern const char *core_type_str[];
 extern const char *sim_param_status[];
 extern const char *evict_policy_str[];
 extern const char *cache_ra_str[];
 extern const char *cache_wa_str[];
 extern const char *cache_wp_str[];
+extern const char *cache_inclusion_str[];
+extern const char *coherence_protocol_str[];
+extern const char *smt_resource_policy_str[];
+extern const char *smt_fetch_policy_str[];
 extern const char *bpu_type_str[];
 extern const char *bpu_aliasing_func_type_str[];
 extern const char *dram_model_type_str[];
+extern const char *dram_page_policy_str[];
 extern const char *cpu_mode_str[];
+extern const char *fusion_pattern_str[];
+
+/* Parameters for a single cache, used for split L1 caches as well as for every
+ * shared cache level */
+/* Analytical DRAM model parameters, timings are in DRAM clock cycles */
+typedef struct AnalyticalDramParams
+{
+    int num_channels;
+    int num_ranks;
+    int num_banks;
+    int row_buffer_size; /* bytes */
+    int bus_width;       /* bytes */
+    char *address_mapping;
+    int page_policy;
+    int freq_mhz;
+    int t_rcd;
+    int t_cas;
+    int t_rp;
+    int t_ras;
+    int t_refi;
+    int t_rfc;
+} AnalyticalDramParams;
+
+typedef struct CacheParams
+{
+    int size; /* KB */
+    int ways;
+    int read_latency;
+    int write_latency;
+    int line_size; /* Bytes */
+    int evict;
+    int read_allocate_policy;
+    int write_allocate_policy;
+    int write_policy;
+    int inclusion_policy;
+} CacheParams;
 
 typedef struct SimParams
 {
@@ -195,6 +336,37 @@ typedef struct SimParams
     int create_ins_str;
     int do_sim_trace;
     char *sim_trace_file;
+
+    /* Pipeline view trace, limited to the instructions fetched within the
+     * cycle and PC ranges (an end of 0 means no limit) */
+    int do_pipe_trace;
+    char *pipe_trace_file;
+    uint64_t pipe_trace_start_cycle;
+    uint64_t pipe_trace_end_cycle;
+    uint64_t pipe_trace_start_pc;
+    uint64_t pipe_trace_end_pc;
+
+    /* Per-PC profile, symbolized with the optional guest ELF or System.map
+     * file */
+    int do_profile;
+    char *profile_symbol_file;
+
+    /* Region of interest filter, ROI_FILTER_* */
+    int roi_filter;
+    uint64_t roi_asid;
+
+    /* Unified stats export, sampled every stats_export_interval cycles if not
+     * 0, and when simulation stops */
+    int do_stats_export;
+    uint64_t stats_export_interval;
+
+    /* Host time of the pipeline stages, memory hierarchy and DRAM model */
+    int do_host_profile;
+
+    /* Static bare-metal ELF loaded in place of the boot files of the config
+     * and simulated from its entry point, NULL to boot the config */
+    char *elf_file;
+
     char *sim_file_path;
     char *sim_file_prefix;
     char *sim_log_file;
@@ -213,6 +385,12 @@ typedef struct SimParams
     int rob_commit_ports;
     int lsq_size;
 
+    /* Simultaneous multithreading: smt_threads consecutive harts are the
+     * hardware threads of one out-of-order core */
+    int smt_threads;
+    int smt_resource_policy;
+    int smt_fetch_policy;
+
     /* FU Latencies in CPU cycles */
     int num_alu_stages;
     int *alu_stage_latency;
@@ -229,6 +407,25 @@ typedef struct SimParams
     int num_fpu_fma_stages;
     int *fpu_fma_stage_latency;
 
+    /* Vector unit (RVV 1.0): vlen bits per register, vector_lanes 64 bit
+     * lanes, and the latencies in CPU cycles of the first result of an
+     * operation */
+    int enable_vector;
+    int vlen;
+    int vector_lanes;
+    int vector_chaining;
+    int vector_alu_latency;
+    int vector_mul_latency;
+    int vector_div_latency;
+    int vector_fpu_latency;
+    int vector_fpu_div_latency;
+    int vector_mem_lines_per_cycle;
+
+    /* Macro-op fusion: fusion[FUSION_*] enables each pattern, enable_fusion
+     * is set if any of them is enabled */
+    int enable_fusion;
+    int fusion[NUM_FUSION_PATTERNS];
+
     /* BPU */
     int enable_bpu;
     int bpu_flush_on_context_switch;
@@ -246,25 +443,26 @@ typedef struct SimParams
 
     /* L1 Caches */
     int enable_l1_caches;
-    int l1_code_cache_read_latency;
-    int l1_code_cache_size;
-    int l1_code_cache_ways;
-    int l1_code_cache_evict;
-    int l1_data_cache_read_latency;
-    int l1_data_cache_write_latency;
-    int l1_data_cache_size;
-    int l1_data_cache_ways;
-    int l1_data_cache_evict;
-
-    /* L2 Caches */
-    int enable_l2_cache;
-    int l2_shared_cache_read_latency;
-    int l2_shared_cache_write_latency;
-    int l2_shared_cache_size;
-    int l2_shared_cache_ways;
-    int l2_shared_cache_evict;
-
-    /* Common cache parameters */
+    CacheParams l1_code_cache;
+    CacheParams l1_data_cache;
+
+    /* Fully associative victim cache after L1 data cache */
+    int enable_victim_cache;
+    int victim_cache_entries;
+    int victim_cache_latency;
+
+    /* Coherence of the L1 data caches of a multi-hart machine, maintained by a
+     * directory at the shared levels */
+    int coherence_protocol;
+    int coherence_invalidate_latency;
+    int coherence_downgrade_latency;
+    int coherence_c2c_latency;
+
+    /* Shared caches below L1, ordered from L2 towards the last level cache */
+    int num_shared_cache_levels;
+    CacheParams shared_cache[NUM_MAX_SHARED_CACHE_LEVELS];
+
+    /* Common cache parameters, used as defaults for every cache level */
     int cache_line_size;
     int cache_read_allocate_policy;
     int cache_write_allocate_policy;
@@ -284,10 +482,40 @@ typedef struct SimParams
     /* Ramulator Params */
     char *ramulator_config_file;
 
+    AnalyticalDramParams analytical_dram;
+
     uint64_t sim_emulate_after_icount;
     int system_insn_latency;
     int rtc_freq_mhz;
     int cpu_freq_mhz;
+
+    /* Multi-hart machine: in emulation mode, every hart executes
+     * hart_quantum instructions before the next hart is scheduled in
+     * round-robin order, in simulation mode the harts advance cycle by cycle */
+    int num_harts;
+    int hart_quantum;
+
+    /* With parallel_harts, every hart runs on its own host thread. Harts in
+     * simulation mode synchronize every sync_quantum cycles, sync_quantum 1
+     * selects the deterministic mode where the harts take turns in hart order
+     * every cycle. */
+    int parallel_harts;
+    int sync_quantum;
+
+    /* Machine config file, and the sweep file with the variants of the
+     * configuration simulated by the children forked when simulation starts.
+     * sweep_jobs 0 selects the number of host CPUs. */
+    char *cfg_file;
+    char *sweep_file;
+    int sweep_jobs;
+
+    /* Set if the disk images are opened read-write (-rw), in which case the
+     * writes of the guest reach the image files */
+    int drives_rw;
+
+    /* File with the variants of the memory hierarchy and branch predictor
+     * timed in lockstep with the in-order core */
+    char *lockstep_file;
 } SimParams;
 
 SimParams *sim_params_init();
@@ -295,5 +523,6 @@ void sim_params_parse(SimParams *p, JSONValue cfg);
 void sim_params_log_options(const SimParams *p);
 void sim_params_log_exec_unit_config(const SimParams *p);
 void sim_params_validate(SimParams *p);
+int sim_params_get_llc_line_size(const SimParams *p);
 void sim_params_free(SimParams *p);
 #endif
@@ -0,0 +1,164 @@
+/**
+ * Pipeline View Trace Generator Utility
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <assert.h>
+#include <stdlib.h>
+
+#include "../riscv_sim_macros.h"
+#include "sim_pipe_trace.h"
+
+static uint64_t
+get_tick(uint64_t cycle)
+{
+    return cycle * PIPE_TRACE_TICKS_PER_CYCLE;
+}
+
+static void
+write_insn(const SimPipeTrace *s, uint64_t retire_cycle,
+           const InstructionLatch *e)
+{
+    const PipeStageCycles *c = &e->pipe_cycles;
+    uint64_t complete = c->complete;
+    uint64_t store = 0;
+
+    /* Instructions which never left the pipeline before fetch are not
+     * traced */
+    if (!c->seq)
+    {
+        return;
+    }
+
+    if ((c->fetch < s->start_cycle) || (s->end_cycle && c->fetch > s->end_cycle)
+        || ((uint64_t)e->ins.pc < s->start_pc)
+        || (s->end_pc && (uint64_t)e->ins.pc > s->end_pc))
+    {
+        return;
+    }
+
+    if (c->memory)
+    {
+        complete = c->memory;
+        if (e->ins.is_store || e->ins.is_atomic_store)
+        {
+            store = c->memory;
+        }
+    }
+
+    fprintf(s->trace_fp, "O3PipeView:fetch:%" PRIu64 ":0x%" PRIx64
+                         ":0:%" PRIu64 ":%s\n",
+            get_tick(c->fetch), (uint64_t)e->ins.pc, c->seq, e->ins.str);
+    fprintf(s->trace_fp, "O3PipeView:decode:%" PRIu64 "\n",
+            get_tick(c->decode));
+    fprintf(s->trace_fp, "O3PipeView:rename:%" PRIu64 "\n",
+            get_tick(c->dispatch));
+    fprintf(s->trace_fp, "O3PipeView:dispatch:%" PRIu64 "\n",
+            get_tick(c->dispatch));
+    fprintf(s->trace_fp, "O3PipeView:issue:%" PRIu64 "\n", get_tick(c->issue));
+    fprintf(s->trace_fp, "O3PipeView:complete:%" PRIu64 "\n",
+            get_tick(complete));
+    fprintf(s->trace_fp,
+            "O3PipeView:retire:%" PRIu64 ":store:%" PRIu64 "\n",
+            get_tick(retire_cycle), get_tick(store));
+}
+
+void
+sim_pipe_trace_start(SimPipeTrace *s, const char *filename)
+{
+    s->trace_fp = fopen(filename, "w");
+    assert(s->trace_fp);
+}
+
+void
+sim_pipe_trace_stop(SimPipeTrace *s)
+{
+    fclose(s->trace_fp);
+    s->trace_fp = NULL;
+}
+
+void
+sim_pipe_trace_commit(const SimPipeTrace *s, uint64_t clock_cycle,
+                      const InstructionLatch *e)
+{
+    write_insn(s, clock_cycle, e);
+}
+
+/* Records the latches in flight before the pipeline is flushed */
+void
+sim_pipe_trace_mark_flush(SimPipeTrace *s, const InstructionLatch *pool)
+{
+    int i;
+
+    if (NULL == s->trace_fp)
+    {
+        return;
+    }
+
+    for (i = 0; i < INSN_LATCH_POOL_SIZE; ++i)
+    {
+        s->allocated[i] = (INSN_LATCH_ALLOCATED == pool[i].status);
+    }
+}
+
+/* After the flush, writes the latches freed by it as squashed */
+void
+sim_pipe_trace_squash(const SimPipeTrace *s, const InstructionLatch *pool)
+{
+    int i;
+
+    if (NULL == s->trace_fp)
+    {
+        return;
+    }
+
+    for (i = 0; i < INSN_LATCH_POOL_SIZE; ++i)
+    {
+        if (s->allocated[i] && (INSN_LATCH_FREE == pool[i].status))
+        {
+            write_insn(s, 0, &pool[i]);
+        }
+    }
+}
+
+SimPipeTrace *
+sim_pipe_trace_init(const SimParams *p)
+{
+    SimPipeTrace *s;
+
+    s = calloc(1, sizeof(SimPipeTrace));
+    assert(s);
+    s->start_cycle = p->pipe_trace_start_cycle;
+    s->end_cycle = p->pipe_trace_end_cycle;
+    s->start_pc = p->pipe_trace_start_pc;
+    s->end_pc = p->pipe_trace_end_pc;
+    return s;
+}
+
+void
+sim_pipe_trace_free(SimPipeTrace **s)
+{
+    free(*s);
+    *s = NULL;
+}
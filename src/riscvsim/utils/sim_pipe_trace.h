@@ -0,0 +1,67 @@
+/**
+ * Pipeline View Trace Generator Utility
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _SIM_PIPE_TRACE_H_
+#define _SIM_PIPE_TRACE_H_
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "cpu_latches.h"
+#include "sim_params.h"
+
+/* Ticks per CPU cycle in the trace, which is the default cycle time of the
+ * O3PipeView tools */
+#define PIPE_TRACE_TICKS_PER_CYCLE 1000
+
+/* Writes the life cycle of every instruction in the O3PipeView format of gem5,
+ * which is read by Konata and gem5's o3-pipeview.py. An instruction is written
+ * when it commits, or when it is squashed by a flush of the pipeline, in which
+ * case its retire tick is 0. The rename and dispatch ticks are the same, as
+ * the cores rename on dispatch, and the complete tick of loads, stores and
+ * atomics is the one of their memory access, the store tick being the same
+ * for stores. */
+typedef struct SimPipeTrace
+{
+    FILE *trace_fp;
+    uint64_t start_cycle;
+    uint64_t end_cycle;
+    uint64_t start_pc;
+    uint64_t end_pc;
+
+    /* Latches allocated before a flush of the pipeline */
+    int allocated[INSN_LATCH_POOL_SIZE];
+} SimPipeTrace;
+
+SimPipeTrace *sim_pipe_trace_init(const SimParams *p);
+void sim_pipe_trace_start(SimPipeTrace *s, const char *filename);
+void sim_pipe_trace_stop(SimPipeTrace *s);
+void sim_pipe_trace_commit(const SimPipeTrace *s, uint64_t clock_cycle,
+                           const InstructionLatch *e);
+void sim_pipe_trace_mark_flush(SimPipeTrace *s, const InstructionLatch *pool);
+void sim_pipe_trace_squash(const SimPipeTrace *s, const InstructionLatch *pool);
+void sim_pipe_trace_free(SimPipeTrace **s);
+#endif
@@ -0,0 +1,444 @@
+/**
+ * Per-PC Profiler
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <assert.h>
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../riscv_sim_macros.h"
+#include "sim_log.h"
+#include "sim_profile.h"
+
+#define PROFILE_INITIAL_SIZE 4096
+
+static uint64_t
+hash_pc(uint64_t pc, uint64_t size)
+{
+    /* Instructions are at least 2 byte aligned */
+    return ((pc >> 1) * 0x9e3779b97f4a7c15ULL) & (size - 1);
+}
+
+static SimProfileEntry *
+find_slot(SimProfileEntry *table, uint64_t size, uint64_t pc)
+{
+    uint64_t i = hash_pc(pc, size);
+
+    while (table[i].valid && table[i].pc != pc)
+    {
+        i = (i + 1) & (size - 1);
+    }
+    return &table[i];
+}
+
+static void
+grow_table(SimProfile *s)
+{
+    uint64_t i;
+    uint64_t new_size = s->size * 2;
+    SimProfileEntry *table;
+
+    table = (SimProfileEntry *)calloc(new_size, sizeof(SimProfileEntry));
+    assert(table);
+
+    for (i = 0; i < s->size; ++i)
+    {
+        if (s->table[i].valid)
+        {
+            *find_slot(table, new_size, s->table[i].pc) = s->table[i];
+        }
+    }
+
+    free(s->table);
+    s->table = table;
+    s->size = new_size;
+}
+
+static SimProfileEntry *
+get_entry(SimProfile *s, uint64_t pc)
+{
+    SimProfileEntry *p;
+
+    p = find_slot(s->table, s->size, pc);
+    if (!p->valid)
+    {
+        if (2 * (s->num_entries + 1) > s->size)
+        {
+            grow_table(s);
+            p = find_slot(s->table, s->size, pc);
+        }
+        p->valid = TRUE;
+        p->pc = pc;
+        ++s->num_entries;
+    }
+    return p;
+}
+
+static void
+count_misses(uint64_t *misses, int mem_level)
+{
+    if (mem_level != MEM_LEVEL_L1)
+    {
+        ++misses[0];
+    }
+
+    if (mem_level == MEM_LEVEL_DRAM)
+    {
+        ++misses[1];
+    }
+}
+
+void
+sim_profile_commit(SimProfile *s, const InstructionLatch *e)
+{
+    SimProfileEntry *p = get_entry(s, e->ins.pc);
+
+    p->commits += e->ins.fusion ? 2 : 1;
+    count_misses(p->icache_misses, e->fetch_mem_level);
+    count_misses(p->dcache_misses, e->data_mem_level);
+
+    /* A TLB hit has no page walk latency */
+    if (e->fetch_page_walk_cycles)
+    {
+        ++p->itlb_misses;
+    }
+
+    if (e->data_page_walk_cycles)
+    {
+        ++p->dtlb_misses;
+    }
+
+    if (e->mispredict)
+    {
+        ++p->mispredicts;
+    }
+}
+
+void
+sim_profile_head_cycles(SimProfile *s, uint64_t pc, uint64_t cycles)
+{
+    get_entry(s, pc)->head_cycles += cycles;
+}
+
+void
+sim_profile_reset(SimProfile *s)
+{
+    memset((void *)s->table, 0, s->size * sizeof(SimProfileEntry));
+    s->num_entries = 0;
+}
+
+/*----------  Symbols  ----------*/
+
+static void
+add_symbol(SimProfile *s, int *capacity, uint64_t addr, const char *name)
+{
+    if (s->num_symbols == *capacity)
+    {
+        *capacity = *capacity ? 2 * *capacity : 1024;
+        s->symbols = (SimProfileSymbol *)realloc(
+            s->symbols, *capacity * sizeof(SimProfileSymbol));
+        assert(s->symbols);
+    }
+
+    s->symbols[s->num_symbols].addr = addr;
+    s->symbols[s->num_symbols].name = strdup(name);
+    assert(s->symbols[s->num_symbols].name);
+    ++s->num_symbols;
+}
+
+/* Loads the function and code label symbols of the symbol tables */
+#define LOAD_ELF_SYMBOLS(Ehdr, Shdr, Sym, ST_TYPE)                             \
+    do                                                                         \
+    {                                                                          \
+        const Ehdr *eh = (const Ehdr *)buf;                                    \
+        const Shdr *sh = (const Shdr *)(buf + eh->e_shoff);                    \
+        const Sym *sym;                                                        \
+        const char *strtab;                                                    \
+        uint64_t i, j;                                                         \
+                                                                               \
+        sim_assert((eh->e_shoff + eh->e_shnum * sizeof(Shdr) <= len),          \
+                   "error: %s at line %d in %s(): %s", __FILE__, __LINE__,     \
+                   __func__, "truncated ELF file");                            \
+        for (i = 0; i < eh->e_shnum; ++i)                                      \
+        {                                                                      \
+            if (sh[i].sh_type != SHT_SYMTAB || sh[i].sh_link >= eh->e_shnum)   \
+            {                                                                  \
+                continue;                                                      \
+            }                                                                  \
+            sym = (const Sym *)(buf + sh[i].sh_offset);                        \
+            strtab = (const char *)(buf + sh[sh[i].sh_link].sh_offset);        \
+            for (j = 0; j < sh[i].sh_size / sizeof(Sym); ++j)                  \
+            {                                                                  \
+                if (sym[j].st_name && sym[j].st_shndx != SHN_UNDEF             \
+                    && sym[j].st_shndx < eh->e_shnum                           \
+                    && (sh[sym[j].st_shndx].sh_flags & SHF_EXECINSTR)          \
+                    && (ST_TYPE(sym[j].st_info) == STT_FUNC                    \
+                        || ST_TYPE(sym[j].st_info) == STT_NOTYPE))             \
+                {                                                              \
+                    add_symbol(s, &capacity, sym[j].st_value,                  \
+                               strtab + sym[j].st_name);                       \
+                }                                                              \
+            }                                                                  \
+        }                                                                      \
+    } while (0)
+
+static void
+load_elf_symbols(SimProfile *s, const uint8_t *buf, size_t len)
+{
+    int capacity = s->num_symbols;
+
+    if (buf[EI_CLASS] == ELFCLASS64)
+    {
+        LOAD_ELF_SYMBOLS(Elf64_Ehdr, Elf64_Shdr, Elf64_Sym, ELF64_ST_TYPE);
+    }
+    else
+    {
+        LOAD_ELF_SYMBOLS(Elf32_Ehdr, Elf32_Shdr, Elf32_Sym, ELF32_ST_TYPE);
+    }
+}
+
+/* System.map lines are: address type name, only text symbols are loaded */
+static void
+load_system_map_symbols(SimProfile *s, FILE *fp)
+{
+    int capacity = s->num_symbols;
+    char line[1024];
+    char name[512];
+    char type;
+    uint64_t addr;
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (sscanf(line, "%" SCNx64 " %c %511s", &addr, &type, name) == 3
+            && (type == 't' || type == 'T' || type == 'w' || type == 'W'))
+        {
+            add_symbol(s, &capacity, addr, name);
+        }
+    }
+}
+
+static int
+compare_symbols(const void *a, const void *b)
+{
+    const SimProfileSymbol *x = (const SimProfileSymbol *)a;
+    const SimProfileSymbol *y = (const SimProfileSymbol *)b;
+
+    return (x->addr > y->addr) - (x->addr < y->addr);
+}
+
+static void
+load_symbols(SimProfile *s, const char *filename)
+{
+    FILE *fp;
+    long len;
+    uint8_t *buf;
+
+    fp = fopen(filename, "rb");
+    sim_assert((fp), "error: %s at line %d in %s(): %s %s", __FILE__,
+               __LINE__, __func__, "cannot open profile symbol file", filename);
+
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    rewind(fp);
+
+    if (len > EI_NIDENT && fgetc(fp) == ELFMAG0 && fgetc(fp) == ELFMAG1
+        && fgetc(fp) == ELFMAG2 && fgetc(fp) == ELFMAG3)
+    {
+        buf = (uint8_t *)malloc(len);
+        assert(buf);
+        rewind(fp);
+        sim_assert((fread(buf, 1, len, fp) == (size_t)len),
+                   "error: %s at line %d in %s(): %s", __FILE__, __LINE__,
+                   __func__, "cannot read profile symbol file");
+        load_elf_symbols(s, buf, len);
+        free(buf);
+    }
+    else
+    {
+        rewind(fp);
+        load_system_map_symbols(s, fp);
+    }
+    fclose(fp);
+
+    qsort(s->symbols, s->num_symbols, sizeof(SimProfileSymbol),
+          compare_symbols);
+}
+
+/* Returns the symbol containing pc, NULL if none */
+static const SimProfileSymbol *
+find_symbol(const SimProfile *s, uint64_t pc)
+{
+    int lo = 0;
+    int hi = s->num_symbols - 1;
+    int mid;
+    const SimProfileSymbol *sym = NULL;
+
+    while (lo <= hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (s->symbols[mid].addr <= pc)
+        {
+            sym = &s->symbols[mid];
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    return sym;
+}
+
+/*----------  Report  ----------*/
+
+static int
+compare_entries(const void *a, const void *b)
+{
+    const SimProfileEntry *x = *(const SimProfileEntry *const *)a;
+    const SimProfileEntry *y = *(const SimProfileEntry *const *)b;
+
+    if (x->head_cycles != y->head_cycles)
+    {
+        return (x->head_cycles < y->head_cycles) ? 1 : -1;
+    }
+    return (x->pc > y->pc) - (x->pc < y->pc);
+}
+
+static FILE *
+open_profile_file(const char *pathname, const char *timestamp,
+                  const char *suffix)
+{
+    char filename[2048];
+    FILE *fp;
+
+    snprintf(filename, sizeof(filename), "%s/%s%s", pathname, timestamp,
+             suffix);
+    fp = fopen(filename, "w");
+    assert(fp);
+    return fp;
+}
+
+/* Writes the entries sorted by the cycles at the head of the pipeline to
+ * <timestamp>profile.csv, and the same cycles per symbol and PC to
+ * <timestamp>profile.folded, in the folded stack format read by
+ * flamegraph.pl */
+void
+sim_profile_print_to_file(const SimProfile *s, const char *pathname,
+                          const char *timestamp)
+{
+    uint64_t i, n = 0, total_cycles = 0;
+    const SimProfileEntry **sorted;
+    const SimProfileEntry *p;
+    const SimProfileSymbol *sym;
+    FILE *fp, *folded_fp;
+
+    sorted = (const SimProfileEntry **)malloc(
+        (s->num_entries ? s->num_entries : 1) * sizeof(SimProfileEntry *));
+    assert(sorted);
+
+    for (i = 0; i < s->size; ++i)
+    {
+        if (s->table[i].valid)
+        {
+            sorted[n++] = &s->table[i];
+            total_cycles += s->table[i].head_cycles;
+        }
+    }
+    qsort(sorted, n, sizeof(SimProfileEntry *), compare_entries);
+
+    fp = open_profile_file(pathname, timestamp, "profile.csv");
+    folded_fp = open_profile_file(pathname, timestamp, "profile.folded");
+    fprintf(fp, "pc,symbol,commits,head_cycles,head_cycles_pct,"
+                "l1i_misses,l2i_misses,l1d_misses,l2d_misses,itlb_misses,"
+                "dtlb_misses,mispredicts\n");
+
+    for (i = 0; i < n; ++i)
+    {
+        p = sorted[i];
+        sym = find_symbol(s, p->pc);
+
+        fprintf(fp, "0x%" PRIx64 ",", p->pc);
+        if (sym)
+        {
+            fprintf(fp, "%s+0x%" PRIx64, sym->name, p->pc - sym->addr);
+        }
+        fprintf(fp,
+                ",%" PRIu64 ",%" PRIu64 ",%.4lf,%" PRIu64 ",%" PRIu64
+                ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+                "\n",
+                p->commits, p->head_cycles,
+                100.0 * (double)p->head_cycles
+                    / (double)(total_cycles ? total_cycles : 1),
+                p->icache_misses[0], p->icache_misses[1], p->dcache_misses[0],
+                p->dcache_misses[1], p->itlb_misses, p->dtlb_misses,
+                p->mispredicts);
+
+        if (p->head_cycles)
+        {
+            fprintf(folded_fp, "%s;0x%" PRIx64 " %" PRIu64 "\n",
+                    sym ? sym->name : "[unknown]", p->pc, p->head_cycles);
+        }
+    }
+
+    fclose(fp);
+    fclose(folded_fp);
+    free(sorted);
+}
+
+SimProfile *
+sim_profile_init(const SimParams *p)
+{
+    SimProfile *s;
+
+    s = (SimProfile *)calloc(1, sizeof(SimProfile));
+    assert(s);
+
+    s->size = PROFILE_INITIAL_SIZE;
+    s->table = (SimProfileEntry *)calloc(s->size, sizeof(SimProfileEntry));
+    assert(s->table);
+
+    if (p->profile_symbol_file)
+    {
+        load_symbols(s, p->profile_symbol_file);
+    }
+    return s;
+}
+
+void
+sim_profile_free(SimProfile **s)
+{
+    int i;
+
+    for (i = 0; i < (*s)->num_symbols; ++i)
+    {
+        free((*s)->symbols[i].name);
+    }
+    free((*s)->symbols);
+    free((*s)->table);
+    free(*s);
+    *s = NULL;
+}
@@ -0,0 +1,82 @@
+/**
+ * Per-PC Profiler
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _SIM_PROFILE_H_
+#define _SIM_PROFILE_H_
+
+#include <inttypes.h>
+
+#include "cpu_latches.h"
+#include "sim_params.h"
+
+/* Cache levels below which a miss is counted: L1, and the shared levels taken
+ * as L2 */
+#define PROFILE_CACHE_LEVELS 2
+
+/* Events recorded for one PC. head_cycles are the cycles the instruction
+ * spent as the oldest one in flight, at the head of the ROB on the
+ * out-of-order core. */
+typedef struct SimProfileEntry
+{
+    uint64_t pc;
+    uint64_t commits;
+    uint64_t head_cycles;
+    uint64_t icache_misses[PROFILE_CACHE_LEVELS];
+    uint64_t dcache_misses[PROFILE_CACHE_LEVELS];
+    uint64_t itlb_misses;
+    uint64_t dtlb_misses;
+    uint64_t mispredicts;
+    int valid;
+} SimProfileEntry;
+
+typedef struct SimProfileSymbol
+{
+    uint64_t addr;
+    char *name;
+} SimProfileSymbol;
+
+/* Per-PC profile of a simulation run, kept in an open addressing hash table
+ * keyed by PC, which doubles in size when half full. PCs are optionally
+ * symbolized with the function symbols of a guest ELF file or a System.map
+ * file. */
+typedef struct SimProfile
+{
+    SimProfileEntry *table;
+    uint64_t size;
+    uint64_t num_entries;
+
+    SimProfileSymbol *symbols; /* Sorted by address */
+    int num_symbols;
+} SimProfile;
+
+SimProfile *sim_profile_init(const SimParams *p);
+void sim_profile_reset(SimProfile *s);
+void sim_profile_commit(SimProfile *s, const InstructionLatch *e);
+void sim_profile_head_cycles(SimProfile *s, uint64_t pc, uint64_t cycles);
+void sim_profile_print_to_file(const SimProfile *s, const char *pathname,
+                               const char *timestamp);
+void sim_profile_free(SimProfile **s);
+#endif
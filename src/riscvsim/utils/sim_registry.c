@@ -0,0 +1,327 @@
+/**
+ * Unified Statistics Registry
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../riscv_sim_macros.h"
+#include "sim_log.h"
+#include "sim_params.h"
+#include "sim_registry.h"
+
+#define REGISTRY_INITIAL_ENTRIES 256
+#define REGISTRY_VERSION 1
+
+/* Columns written before the registered values in every sample */
+#define REGISTRY_NUM_SAMPLE_COLUMNS 2
+
+static const char *registry_kind_str[] = {"counter", "histogram"};
+
+/* Lowest latency of every bucket */
+const char *latency_bucket_str[NUM_LATENCY_BUCKETS]
+    = {"0",   "2",    "4",    "8",    "16",   "32",    "64",    "128",
+       "256", "512", "1024", "2048", "4096", "8192", "16384", "32768"};
+
+/* Magic number at the start of the columnar file */
+static const char registry_magic[8] = {'M', 'A', 'R', 'S', 'S', 'S', 'T', 'B'};
+
+SimRegistry *
+sim_registry_init(void)
+{
+    SimRegistry *r;
+
+    r = (SimRegistry *)calloc(1, sizeof(SimRegistry));
+    assert(r);
+
+    r->max_entries = REGISTRY_INITIAL_ENTRIES;
+    r->entries = (SimRegistryEntry *)calloc(r->max_entries,
+                                            sizeof(SimRegistryEntry));
+    assert(r->entries);
+    r->num_columns = REGISTRY_NUM_SAMPLE_COLUMNS;
+    return r;
+}
+
+void
+sim_registry_add(SimRegistry *r, const char *module, const char *name,
+                 int kind, const uint64_t *value, int num_values,
+                 size_t stride, const char **labels)
+{
+    SimRegistryEntry *e;
+
+    /* Modules register their values before the files are opened, as the
+     * schema is fixed */
+    sim_assert((NULL == r->json_fp), "error: %s at line %d in %s(): %s",
+               __FILE__, __LINE__, __func__,
+               "stats registered while the stats files are open");
+
+    if (r->num_entries == r->max_entries)
+    {
+        r->max_entries *= 2;
+        r->entries = (SimRegistryEntry *)realloc(
+            r->entries, r->max_entries * sizeof(SimRegistryEntry));
+        assert(r->entries);
+    }
+
+    e = &r->entries[r->num_entries++];
+    snprintf(e->name, sizeof(e->name), "%s.%s", module, name);
+    e->kind = kind;
+    e->value = value;
+    e->num_values = num_values;
+    e->stride = stride;
+    e->labels = labels;
+    r->num_columns += num_values;
+}
+
+void
+sim_registry_add_mode_counter(SimRegistry *r, const char *module,
+                              const char *name, const uint64_t *value,
+                              size_t stride)
+{
+    sim_registry_add(r, module, name, REGISTRY_COUNTER, value,
+                     NUM_MAX_PRV_LEVELS, stride / sizeof(uint64_t),
+                     cpu_mode_str);
+}
+
+void
+sim_registry_add_counter(SimRegistry *r, const char *module, const char *name,
+                         const uint64_t *value)
+{
+    sim_registry_add(r, module, name, REGISTRY_COUNTER, value, 1, 1, NULL);
+}
+
+void
+sim_registry_add_latency_histogram(SimRegistry *r, const char *module,
+                                   const char *name, const uint64_t *buckets)
+{
+    sim_registry_add(r, module, name, REGISTRY_HISTOGRAM, buckets,
+                     NUM_LATENCY_BUCKETS, 1, latency_bucket_str);
+}
+
+static FILE *
+open_stats_file(const char *pathname, const char *timestamp,
+                const char *suffix, const char *mode)
+{
+    FILE *fp;
+    char filename[PATH_MAX];
+
+    snprintf(filename, sizeof(filename), "%s/%s%s", pathname, timestamp,
+             suffix);
+    fp = fopen(filename, mode);
+    sim_assert((fp), "error: %s at line %d in %s(): %s %s", __FILE__,
+               __LINE__, __func__, "failed to open", filename);
+    sim_log_event(sim_log, "Saving stats in %s", filename);
+    return fp;
+}
+
+static void
+write_column_name(FILE *fp, const char *name, int kind)
+{
+    uint8_t k = (uint8_t)kind;
+    uint16_t len = (uint16_t)strlen(name);
+
+    fwrite(&len, sizeof(len), 1, fp);
+    fwrite(name, 1, len, fp);
+    fwrite(&k, sizeof(k), 1, fp);
+}
+
+/* Columnar file header: magic, version and number of columns as 32-bit
+ * integers, followed by the name length (16-bit), name and kind (8-bit) of
+ * every column. Integers are in host byte order. */
+static void
+write_columnar_schema(const SimRegistry *r)
+{
+    int i, j;
+    uint32_t word;
+    char name[REGISTRY_NAME_LEN * 2];
+    const SimRegistryEntry *e;
+
+    fwrite(registry_magic, 1, sizeof(registry_magic), r->columnar_fp);
+    word = REGISTRY_VERSION;
+    fwrite(&word, sizeof(word), 1, r->columnar_fp);
+    word = r->num_columns;
+    fwrite(&word, sizeof(word), 1, r->columnar_fp);
+
+    write_column_name(r->columnar_fp, "cycle", REGISTRY_COUNTER);
+    write_column_name(r->columnar_fp, "commits", REGISTRY_COUNTER);
+    for (i = 0; i < r->num_entries; ++i)
+    {
+        e = &r->entries[i];
+        for (j = 0; j < e->num_values; ++j)
+        {
+            if (e->labels)
+            {
+                snprintf(name, sizeof(name), "%s.%s", e->name, e->labels[j]);
+            }
+            else if (e->num_values > 1)
+            {
+                snprintf(name, sizeof(name), "%s.%d", e->name, j);
+            }
+            else
+            {
+                snprintf(name, sizeof(name), "%s", e->name);
+            }
+            write_column_name(r->columnar_fp, name, e->kind);
+        }
+    }
+}
+
+/* First line of the JSON lines file */
+static void
+write_json_schema(const SimRegistry *r)
+{
+    int i, j;
+    const SimRegistryEntry *e;
+
+    fprintf(r->json_fp, "{\"schema\":{\"version\":%d,\"stats\":[",
+            REGISTRY_VERSION);
+    for (i = 0; i < r->num_entries; ++i)
+    {
+        e = &r->entries[i];
+        fprintf(r->json_fp, "%s{\"name\":\"%s\",\"kind\":\"%s\"",
+                i ? "," : "", e->name, registry_kind_str[e->kind]);
+        if (e->labels)
+        {
+            fprintf(r->json_fp, ",\"labels\":[");
+            for (j = 0; j < e->num_values; ++j)
+            {
+                fprintf(r->json_fp, "%s\"%s\"", j ? "," : "", e->labels[j]);
+            }
+            fprintf(r->json_fp, "]");
+        }
+        else if (e->num_values > 1)
+        {
+            fprintf(r->json_fp, ",\"size\":%d", e->num_values);
+        }
+        fprintf(r->json_fp, "}");
+    }
+    fprintf(r->json_fp, "]}}\n");
+}
+
+void
+sim_registry_open(SimRegistry *r, const char *pathname, const char *timestamp)
+{
+    r->json_fp = open_stats_file(pathname, timestamp, "stats.jsonl", "w");
+    r->columnar_fp = open_stats_file(pathname, timestamp, "stats.bin", "wb");
+
+    free(r->block);
+    r->block = (uint64_t *)calloc((size_t)r->num_columns * REGISTRY_BLOCK_ROWS,
+                                  sizeof(uint64_t));
+    assert(r->block);
+    r->block_rows = 0;
+
+    write_json_schema(r);
+    write_columnar_schema(r);
+}
+
+/* A block is the number of rows as a 32-bit integer, followed by every column
+ * of the rows */
+static void
+flush_block(SimRegistry *r)
+{
+    int i;
+    uint32_t rows = r->block_rows;
+
+    if (rows)
+    {
+        fwrite(&rows, sizeof(rows), 1, r->columnar_fp);
+        for (i = 0; i < r->num_columns; ++i)
+        {
+            fwrite(&r->block[(size_t)i * REGISTRY_BLOCK_ROWS], sizeof(uint64_t),
+                   rows, r->columnar_fp);
+        }
+        fflush(r->columnar_fp);
+        r->block_rows = 0;
+    }
+}
+
+void
+sim_registry_sample(SimRegistry *r, uint64_t cycle, uint64_t commits,
+                    int final)
+{
+    int i, j, col;
+    uint64_t value;
+    const SimRegistryEntry *e;
+
+    fprintf(r->json_fp,
+            "{\"cycle\":%" PRIu64 ",\"commits\":%" PRIu64
+            ",\"final\":%s,\"stats\":{",
+            cycle, commits, final ? "true" : "false");
+
+    r->block[0 * REGISTRY_BLOCK_ROWS + r->block_rows] = cycle;
+    r->block[1 * REGISTRY_BLOCK_ROWS + r->block_rows] = commits;
+    col = REGISTRY_NUM_SAMPLE_COLUMNS;
+
+    for (i = 0; i < r->num_entries; ++i)
+    {
+        e = &r->entries[i];
+        fprintf(r->json_fp, "%s\"%s\":%s", i ? "," : "", e->name,
+                (e->num_values > 1 || e->labels) ? "[" : "");
+        for (j = 0; j < e->num_values; ++j)
+        {
+            value = e->value[j * e->stride];
+            fprintf(r->json_fp, "%s%" PRIu64, j ? "," : "", value);
+            r->block[(size_t)col++ * REGISTRY_BLOCK_ROWS + r->block_rows]
+                = value;
+        }
+        if (e->num_values > 1 || e->labels)
+        {
+            fprintf(r->json_fp, "]");
+        }
+    }
+    fprintf(r->json_fp, "}}\n");
+    fflush(r->json_fp);
+
+    if (++r->block_rows == REGISTRY_BLOCK_ROWS)
+    {
+        flush_block(r);
+    }
+}
+
+void
+sim_registry_close(SimRegistry *r)
+{
+    if (r->json_fp)
+    {
+        flush_block(r);
+        fclose(r->json_fp);
+        fclose(r->columnar_fp);
+        r->json_fp = NULL;
+        r->columnar_fp = NULL;
+    }
+}
+
+void
+sim_registry_free(SimRegistry **r)
+{
+    sim_registry_close(*r);
+    free((*r)->block);
+    free((*r)->entries);
+    free(*r);
+    *r = NULL;
+}
@@ -0,0 +1,112 @@
+/**
+ * Unified Statistics Registry
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _SIM_REGISTRY_H_
+#define _SIM_REGISTRY_H_
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stddef.h>
+
+#define REGISTRY_NAME_LEN 64
+
+/* Rows of the columnar file buffered before they are written as a block */
+#define REGISTRY_BLOCK_ROWS 64
+
+#define REGISTRY_COUNTER 0x0
+#define REGISTRY_HISTOGRAM 0x1
+
+/* Latency histograms have log2 buckets: bucket 0 counts the latencies below 2
+ * cycles, bucket i the ones in [2^i, 2^(i+1)) cycles, and the last bucket all
+ * the longer ones */
+#define NUM_LATENCY_BUCKETS 16
+
+extern const char *latency_bucket_str[NUM_LATENCY_BUCKETS];
+
+static inline void
+latency_histogram_add(uint64_t *buckets, uint64_t cycles)
+{
+    int i = (cycles > 1) ? (63 - __builtin_clzll(cycles)) : 0;
+
+    ++buckets[(i < NUM_LATENCY_BUCKETS) ? i : (NUM_LATENCY_BUCKETS - 1)];
+}
+
+/* A counter or histogram registered by a module. The registry keeps a pointer
+ * to the live values, which are read only when a sample is written, so
+ * updating a registered counter costs nothing more than before. */
+typedef struct SimRegistryEntry
+{
+    char name[REGISTRY_NAME_LEN]; /* module.counter */
+    int kind;                     /* REGISTRY_* */
+    const uint64_t *value;
+    int num_values;
+    size_t stride; /* In 64-bit words between two values */
+    const char **labels; /* Name of every value, NULL to use the index */
+} SimRegistryEntry;
+
+/* Registry of the statistical counters of all the modules of the simulator:
+ * core, caches, coherence directory and DRAM. Samples of every registered
+ * value are written at the given interval of simulated cycles and when
+ * simulation stops, to:
+ * - a JSON lines file, whose first line is the schema
+ * - a columnar binary file with the schema in its header, followed by blocks
+ *   of up to REGISTRY_BLOCK_ROWS samples stored column by column */
+typedef struct SimRegistry
+{
+    SimRegistryEntry *entries;
+    int num_entries;
+    int max_entries;
+    int num_columns; /* Including the cycle and commits columns */
+
+    FILE *json_fp;
+    FILE *columnar_fp;
+    uint64_t *block; /* Column-major, num_columns x REGISTRY_BLOCK_ROWS */
+    int block_rows;
+} SimRegistry;
+
+SimRegistry *sim_registry_init(void);
+void sim_registry_add(SimRegistry *r, const char *module, const char *name,
+                      int kind, const uint64_t *value, int num_values,
+                      size_t stride, const char **labels);
+
+/* Registers a counter kept for every privilege mode, in an array of
+ * structures of stride bytes */
+void sim_registry_add_mode_counter(SimRegistry *r, const char *module,
+                                   const char *name, const uint64_t *value,
+                                   size_t stride);
+void sim_registry_add_counter(SimRegistry *r, const char *module,
+                              const char *name, const uint64_t *value);
+void sim_registry_add_latency_histogram(SimRegistry *r, const char *module,
+                                        const char *name,
+                                        const uint64_t *buckets);
+
+void sim_registry_open(SimRegistry *r, const char *pathname,
+                       const char *timestamp);
+void sim_registry_sample(SimRegistry *r, uint64_t cycle, uint64_t commits,
+                         int final);
+void sim_registry_close(SimRegistry *r);
+void sim_registry_free(SimRegistry **r);
+#endif
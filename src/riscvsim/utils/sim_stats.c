@@ -28,6 +28,8 @@
  * THE SOFTWARE.
  */
 #include <assert.h>
+#include <limits.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -35,6 +37,7 @@
 
 #include "../../riscv_cpu_priv.h"
 #include "sim_log.h"
+#include "sim_registry.h"
 #include "sim_stats.h"
 
 #define SIM_STAT_PRINT_TO_FILE_HEADER(fp)                                      \
@@ -44,13 +47,22 @@
                 "hypervisor", "machine", "total");                             \
     } while (0)
 
-#define SIM_STAT_PRINT_TO_FILE(fp, stats, name, attr)                          \
+/* Value of a field in the stats of one privilege mode */
+#define SIM_STAT_VALUE(stats, field)                                           \
+    (*(const uint64_t *)((const char *)(stats) + (field)->offset))
+
+#define SIM_STAT_PRINT_TO_FILE(fp, stats, field)                               \
     do                                                                         \
     {                                                                          \
-        fprintf(                                                               \
-            fp, "%s,%lu,%lu,%lu,%lu,%lu\n", name, stats[0].attr,               \
-            stats[1].attr, stats[2].attr, stats[3].attr,                       \
-            (stats[0].attr + stats[1].attr + stats[2].attr + stats[3].attr));  \
+        fprintf(fp, "%s,%lu,%lu,%lu,%lu,%lu\n", (field)->name,                 \
+                SIM_STAT_VALUE(&stats[0], field),                              \
+                SIM_STAT_VALUE(&stats[1], field),                              \
+                SIM_STAT_VALUE(&stats[2], field),                              \
+                SIM_STAT_VALUE(&stats[3], field),                              \
+                (SIM_STAT_VALUE(&stats[0], field)                              \
+                 + SIM_STAT_VALUE(&stats[1], field)                            \
+                 + SIM_STAT_VALUE(&stats[2], field)                            \
+                 + SIM_STAT_VALUE(&stats[3], field)));                         \
     } while (0)
 
 #define SIM_STAT_PRINT_HEADER_TO_TERMINAL(fp)                                  \
@@ -69,10 +81,168 @@
             (stats[0].attr + stats[1].attr + stats[2].attr + stats[3].attr));  \
     } while (0)
 
+/* Stats in the order of the stats file. The ones of the caches and of the
+ * coherence directory are copied from the memory hierarchy when simulation
+ * stops, and are registered by the memory hierarchy itself. */
+typedef struct SimStatField
+{
+    const char *name;
+    size_t offset;
+    int mem_hierarchy;
+} SimStatField;
+
+#define SIM_STAT_FIELD(name, attr) {name, offsetof(SimStats, attr), FALSE}
+#define SIM_STAT_MEM_FIELD(name, attr) {name, offsetof(SimStats, attr), TRUE}
+
+#define SIM_STAT_SHARED_CACHE_FIELDS(level, i)                                 \
+    SIM_STAT_MEM_FIELD("L" #level "_cache_reads", shared_cache_read[i]),       \
+        SIM_STAT_MEM_FIELD("L" #level "_cache_read_misses",                    \
+                           shared_cache_read_miss[i]),                         \
+        SIM_STAT_MEM_FIELD("L" #level "_cache_writes", shared_cache_write[i]), \
+        SIM_STAT_MEM_FIELD("L" #level "_cache_write_misses",                   \
+                           shared_cache_write_miss[i]),                        \
+        SIM_STAT_MEM_FIELD("L" #level "_cache_back_invalidations",             \
+                           shared_cache_back_invalidate[i]),                   \
+        SIM_STAT_MEM_FIELD("L" #level "_cache_victim_fills",                   \
+                           shared_cache_victim_fill[i])
+
+/* sim_time_milli_sec is written before this row */
+#define SIM_STAT_SIM_TIME_ROW 3
+
+static const SimStatField sim_stat_fields[] = {
+    SIM_STAT_FIELD("cycles", cycles),
+    SIM_STAT_FIELD("commits", ins_simulated),
+    SIM_STAT_FIELD("ins_fetch", ins_fetch),
+    SIM_STAT_FIELD("insn_mem_delay", insn_mem_delay),
+    SIM_STAT_FIELD("data_mem_delay", data_mem_delay),
+    SIM_STAT_FIELD("exec_unit_delay", exec_unit_delay),
+    SIM_STAT_FIELD("load_insn", ins_type[INS_TYPE_LOAD]),
+    SIM_STAT_FIELD("store_insn", ins_type[INS_TYPE_STORE]),
+    SIM_STAT_FIELD("atomic_insn", ins_type[INS_TYPE_ATOMIC]),
+    SIM_STAT_FIELD("system_insn", ins_emulated),
+    SIM_STAT_FIELD("aritmetic_insn", ins_type[INS_TYPE_ARITMETIC]),
+    SIM_STAT_FIELD("cond_branches", ins_type[INS_TYPE_COND_BRANCH]),
+    SIM_STAT_FIELD("jal_insn", ins_type[INS_TYPE_JAL]),
+    SIM_STAT_FIELD("jalr_insn", ins_type[INS_TYPE_JALR]),
+    SIM_STAT_FIELD("int_mul_insn", ins_type[INS_TYPE_INT_MUL]),
+    SIM_STAT_FIELD("int_div_insn", ins_type[INS_TYPE_INT_DIV]),
+    SIM_STAT_FIELD("fp_load_insn", ins_type[INS_TYPE_FP_LOAD]),
+    SIM_STAT_FIELD("fp_store_insn", ins_type[INS_TYPE_FP_STORE]),
+    SIM_STAT_FIELD("fp_add_insn", ins_type[INS_TYPE_FP_ADD]),
+    SIM_STAT_FIELD("fp_mul_insn", ins_type[INS_TYPE_FP_MUL]),
+    SIM_STAT_FIELD("fp_fma_insn", ins_type[INS_TYPE_FP_FMA]),
+    SIM_STAT_FIELD("fp_div_sqrt_insn", ins_type[INS_TYPE_FP_DIV_SQRT]),
+    SIM_STAT_FIELD("fp_misc_insn", ins_type[INS_TYPE_FP_MISC]),
+    SIM_STAT_FIELD("load_byte_insn", ins_type[INS_TYPE_LOAD_BYTE]),
+    SIM_STAT_FIELD("load_half_word_insn", ins_type[INS_TYPE_LOAD_HALF_WORD]),
+    SIM_STAT_FIELD("load_word_insn", ins_type[INS_TYPE_LOAD_WORD]),
+    SIM_STAT_FIELD("load_double_word_insn",
+                   ins_type[INS_TYPE_LOAD_DOUBLE_WORD]),
+    SIM_STAT_FIELD("vector_insn", ins_type[INS_TYPE_VECTOR]),
+    SIM_STAT_FIELD("fused_lui_addi", fused_pairs[FUSION_LUI_ADDI]),
+    SIM_STAT_FIELD("fused_auipc_jalr", fused_pairs[FUSION_AUIPC_JALR]),
+    SIM_STAT_FIELD("fused_slli_srli", fused_pairs[FUSION_SLLI_SRLI]),
+    SIM_STAT_FIELD("fused_add_load", fused_pairs[FUSION_ADD_LOAD]),
+    SIM_STAT_FIELD("td_retiring", td_slots[TD_RETIRING]),
+    SIM_STAT_FIELD("td_bad_speculation", td_slots[TD_BAD_SPECULATION]),
+    SIM_STAT_FIELD("td_frontend_icache", td_slots[TD_FRONTEND_ICACHE]),
+    SIM_STAT_FIELD("td_frontend_itlb", td_slots[TD_FRONTEND_ITLB]),
+    SIM_STAT_FIELD("td_frontend_bubble", td_slots[TD_FRONTEND_BUBBLE]),
+    SIM_STAT_FIELD("td_backend_core", td_slots[TD_BACKEND_CORE]),
+    SIM_STAT_FIELD("td_backend_mem_l1", td_slots[TD_BACKEND_MEM_L1]),
+    SIM_STAT_FIELD("td_backend_mem_l2", td_slots[TD_BACKEND_MEM_L2]),
+    SIM_STAT_FIELD("td_backend_mem_dram", td_slots[TD_BACKEND_MEM_DRAM]),
+    SIM_STAT_FIELD("itlb_reads", code_tlb_lookups),
+    SIM_STAT_FIELD("itlb_hits", code_tlb_hits),
+    SIM_STAT_FIELD("load_tlb_reads", load_tlb_lookups),
+    SIM_STAT_FIELD("load_tlb_hits", load_tlb_hits),
+    SIM_STAT_FIELD("store_tlb_reads", store_tlb_lookups),
+    SIM_STAT_FIELD("store_tlb_hits", store_tlb_hits),
+    SIM_STAT_FIELD("cond_branches_taken", ins_cond_branch_taken),
+    SIM_STAT_FIELD("cond_branches_pred_correct", bpu_cond_correct),
+    SIM_STAT_FIELD("cond_branches_pred_incorrect", bpu_cond_incorrect),
+    SIM_STAT_FIELD("uncond_branches_pred_correct", bpu_uncond_correct),
+    SIM_STAT_FIELD("uncond_branches_pred_incorrect", bpu_uncond_incorrect),
+    SIM_STAT_FIELD("btb_reads", btb_probes),
+    SIM_STAT_FIELD("btb_hits", btb_hits),
+    SIM_STAT_FIELD("btb_inserts", btb_inserts),
+    SIM_STAT_FIELD("btb_updates", btb_updates),
+    SIM_STAT_FIELD("int_regfile_reads", int_regfile_reads),
+    SIM_STAT_FIELD("int_regfile_writes", int_regfile_writes),
+    SIM_STAT_FIELD("fp_regfile_reads", fp_regfile_reads),
+    SIM_STAT_FIELD("fp_regfile_writes", fp_regfile_writes),
+    SIM_STAT_FIELD("csr_reads", csr_reads),
+    SIM_STAT_FIELD("csr_writes", csr_writes),
+    SIM_STAT_FIELD("fu_alu_accesses", fu_access[FU_ALU]),
+    SIM_STAT_FIELD("fu_mul_accesses", fu_access[FU_MUL]),
+    SIM_STAT_FIELD("fu_div_accesses", fu_access[FU_DIV]),
+    SIM_STAT_FIELD("fu_fpu_alu_accesses", fu_access[FU_FPU_ALU]),
+    SIM_STAT_FIELD("fu_fpu_fma_accesses", fu_access[FU_FPU_FMA]),
+    SIM_STAT_FIELD("vec_beats", vec_beats),
+    SIM_STAT_FIELD("vec_chained", vec_chained),
+    SIM_STAT_FIELD("vec_mem_lines", vec_mem_lines),
+    SIM_STAT_FIELD("vec_stall_cycles", vec_stall_cycles),
+    SIM_STAT_FIELD("ins_page_walks", ins_page_walks),
+    SIM_STAT_FIELD("load_page_walks", load_page_walks),
+    SIM_STAT_FIELD("store_page_walks", store_page_walks),
+    SIM_STAT_FIELD("misaligned_fetch", exceptions[CAUSE_MISALIGNED_FETCH]),
+    SIM_STAT_FIELD("fault_fetch", exceptions[CAUSE_FAULT_FETCH]),
+    SIM_STAT_FIELD("illegal_instruction",
+                   exceptions[CAUSE_ILLEGAL_INSTRUCTION]),
+    SIM_STAT_FIELD("breakpoint", exceptions[CAUSE_BREAKPOINT]),
+    SIM_STAT_FIELD("misaligned_load", exceptions[CAUSE_MISALIGNED_LOAD]),
+    SIM_STAT_FIELD("fault_load", exceptions[CAUSE_FAULT_LOAD]),
+    SIM_STAT_FIELD("misaligned_store", exceptions[CAUSE_MISALIGNED_STORE]),
+    SIM_STAT_FIELD("fault_store", exceptions[CAUSE_FAULT_STORE]),
+    SIM_STAT_FIELD("user_ecall", exceptions[CAUSE_USER_ECALL]),
+    SIM_STAT_FIELD("supervisor_ecall", exceptions[CAUSE_SUPERVISOR_ECALL]),
+    SIM_STAT_FIELD("hypervisor_ecall", exceptions[CAUSE_HYPERVISOR_ECALL]),
+    SIM_STAT_FIELD("machine_ecall", exceptions[CAUSE_MACHINE_ECALL]),
+    SIM_STAT_FIELD("fetch_page_fault", exceptions[CAUSE_FETCH_PAGE_FAULT]),
+    SIM_STAT_FIELD("load_page_fault", exceptions[CAUSE_LOAD_PAGE_FAULT]),
+    SIM_STAT_FIELD("store_page_fault", exceptions[CAUSE_STORE_PAGE_FAULT]),
+    SIM_STAT_FIELD("user_software_interrupt",
+                   interrupts[CAUSE_USER_SOFTWARE_INTERRUPT]),
+    SIM_STAT_FIELD("supervisor_software_interrupt",
+                   interrupts[CAUSE_SUPERVISOR_SOFTWARE_INTERRUPT]),
+    SIM_STAT_FIELD("machine_software_interrupt",
+                   interrupts[CAUSE_MACHINE_SOFTWARE_INTERRUPT]),
+    SIM_STAT_FIELD("user_timer_interrupt",
+                   interrupts[CAUSE_USER_TIMER_INTERRUPT]),
+    SIM_STAT_FIELD("supervisor_timer_interrupt",
+                   interrupts[CAUSE_SUPERVISOR_TIMER_INTERRUPT]),
+    SIM_STAT_FIELD("machine_timer_interrupt",
+                   interrupts[CAUSE_MACHINE_TIMER_INTERRUPT]),
+    SIM_STAT_FIELD("user_external_interrupt",
+                   interrupts[CAUSE_USER_EXTERNAL_INTERRUPT]),
+    SIM_STAT_FIELD("supervisor_external_interrupt",
+                   interrupts[CAUSE_SUPERVISOR_EXTERNAL_INTERRUPT]),
+    SIM_STAT_FIELD("machine_external_interrupt",
+                   interrupts[CAUSE_MACHINE_EXTERNAL_INTERRUPT]),
+    SIM_STAT_FIELD("pipeline_flush", pipeline_flush),
+    SIM_STAT_MEM_FIELD("L1_icache_reads", icache_read),
+    SIM_STAT_MEM_FIELD("L1_icache_read_misses", icache_read_miss),
+    SIM_STAT_MEM_FIELD("L1_dcache_reads", dcache_read),
+    SIM_STAT_MEM_FIELD("L1_dcache_read_misses", dcache_read_miss),
+    SIM_STAT_MEM_FIELD("L1_dcache_writes", dcache_write),
+    SIM_STAT_MEM_FIELD("L1_dcache_write_misses", dcache_write_miss),
+    SIM_STAT_MEM_FIELD("victim_cache_reads", victim_cache_read),
+    SIM_STAT_MEM_FIELD("victim_cache_read_misses", victim_cache_read_miss),
+    SIM_STAT_MEM_FIELD("victim_cache_fills", victim_cache_fill),
+    SIM_STAT_SHARED_CACHE_FIELDS(2, 0),
+    SIM_STAT_SHARED_CACHE_FIELDS(3, 1),
+    SIM_STAT_SHARED_CACHE_FIELDS(4, 2),
+    SIM_STAT_MEM_FIELD("coherence_invalidations", coherence_invalidations),
+    SIM_STAT_MEM_FIELD("coherence_downgrades", coherence_downgrades),
+    SIM_STAT_MEM_FIELD("coherence_c2c_transfers", coherence_c2c_transfers),
+    SIM_STAT_MEM_FIELD("coherence_upgrade_misses", coherence_upgrade_misses),
+};
+
 void
 sim_stats_print_to_file(const SimStats *s, const char *pathname,
                         uint64_t sim_time_milli_sec, const char *timestamp)
 {
+    size_t i;
     FILE *fp;
     char *filename;
     char buffer[1024];
@@ -92,138 +262,173 @@ sim_stats_print_to_file(const SimStats *s, const char *pathname,
 
     SIM_STAT_PRINT_TO_FILE_HEADER(fp);
 
-    SIM_STAT_PRINT_TO_FILE(fp, s, "cycles", cycles);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "commits", ins_simulated);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "ins_fetch", ins_fetch);
-
-    /* Add simulation time required on host machine to stats file, but only the
-     * total time */
-    fprintf(fp, "%s,%lu,%lu,%lu,%lu,%lu\n", "sim_time_milli_sec", (uint64_t)0,
-            (uint64_t)0, (uint64_t)0, (uint64_t)0, sim_time_milli_sec);
-
-    SIM_STAT_PRINT_TO_FILE(fp, s, "insn_mem_delay", insn_mem_delay);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "data_mem_delay", data_mem_delay);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "exec_unit_delay", exec_unit_delay);
-
-    SIM_STAT_PRINT_TO_FILE(fp, s, "load_insn", ins_type[INS_TYPE_LOAD]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "store_insn", ins_type[INS_TYPE_STORE]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "atomic_insn", ins_type[INS_TYPE_ATOMIC]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "system_insn", ins_emulated);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "aritmetic_insn",
-                           ins_type[INS_TYPE_ARITMETIC]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "cond_branches",
-                           ins_type[INS_TYPE_COND_BRANCH]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "jal_insn", ins_type[INS_TYPE_JAL]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "jalr_insn", ins_type[INS_TYPE_JALR]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "int_mul_insn", ins_type[INS_TYPE_INT_MUL]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "int_div_insn", ins_type[INS_TYPE_INT_DIV]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fp_load_insn", ins_type[INS_TYPE_FP_LOAD]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fp_store_insn", ins_type[INS_TYPE_FP_STORE]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fp_add_insn", ins_type[INS_TYPE_FP_ADD]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fp_mul_insn", ins_type[INS_TYPE_FP_MUL]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fp_fma_insn", ins_type[INS_TYPE_FP_FMA]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fp_div_sqrt_insn",
-                           ins_type[INS_TYPE_FP_DIV_SQRT]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fp_misc_insn", ins_type[INS_TYPE_FP_MISC]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "load_byte_insn",
-                           ins_type[INS_TYPE_LOAD_BYTE]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "load_half_word_insn",
-                           ins_type[INS_TYPE_LOAD_HALF_WORD]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "load_word_insn",
-                           ins_type[INS_TYPE_LOAD_WORD]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "load_double_word_insn",
-                           ins_type[INS_TYPE_LOAD_DOUBLE_WORD]);
-
-    SIM_STAT_PRINT_TO_FILE(fp, s, "itlb_reads", code_tlb_lookups);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "itlb_hits", code_tlb_hits);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "load_tlb_reads", load_tlb_lookups);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "load_tlb_hits", load_tlb_hits);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "store_tlb_reads", store_tlb_lookups);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "store_tlb_hits", store_tlb_hits);
-
-    SIM_STAT_PRINT_TO_FILE(fp, s, "cond_branches_taken", ins_cond_branch_taken);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "cond_branches_pred_correct",
-                           bpu_cond_correct);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "cond_branches_pred_incorrect",
-                           bpu_cond_incorrect);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "uncond_branches_pred_correct",
-                           bpu_uncond_correct);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "uncond_branches_pred_incorrect",
-                           bpu_uncond_incorrect);
-
-    SIM_STAT_PRINT_TO_FILE(fp, s, "btb_reads", btb_probes);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "btb_hits", btb_hits);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "btb_inserts", btb_inserts);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "btb_updates", btb_updates);
-
-    SIM_STAT_PRINT_TO_FILE(fp, s, "int_regfile_reads", int_regfile_reads);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "int_regfile_writes", int_regfile_writes);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fp_regfile_reads", fp_regfile_reads);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fp_regfile_writes", fp_regfile_writes);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "csr_reads", csr_reads);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "csr_writes", csr_writes);
-
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fu_alu_accesses", fu_access[FU_ALU]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fu_mul_accesses", fu_access[FU_MUL]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fu_div_accesses", fu_access[FU_DIV]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fu_fpu_alu_accesses", fu_access[FU_FPU_ALU]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fu_fpu_fma_accesses", fu_access[FU_FPU_FMA]);
-
-    SIM_STAT_PRINT_TO_FILE(fp, s, "ins_page_walks", ins_page_walks);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "load_page_walks", load_page_walks);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "store_page_walks", store_page_walks);
-
-    SIM_STAT_PRINT_TO_FILE(fp, s, "misaligned_fetch", exceptions[CAUSE_MISALIGNED_FETCH]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fault_fetch", exceptions[CAUSE_FAULT_FETCH]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "illegal_instruction", exceptions[CAUSE_ILLEGAL_INSTRUCTION]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "breakpoint", exceptions[CAUSE_BREAKPOINT]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "misaligned_load", exceptions[CAUSE_MISALIGNED_LOAD]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fault_load", exceptions[CAUSE_FAULT_LOAD]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "misaligned_store", exceptions[CAUSE_MISALIGNED_STORE]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fault_store", exceptions[CAUSE_FAULT_STORE]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "user_ecall", exceptions[CAUSE_USER_ECALL]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "supervisor_ecall", exceptions[CAUSE_SUPERVISOR_ECALL]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "hypervisor_ecall", exceptions[CAUSE_HYPERVISOR_ECALL]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "machine_ecall", exceptions[CAUSE_MACHINE_ECALL]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "fetch_page_fault", exceptions[CAUSE_FETCH_PAGE_FAULT]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "load_page_fault", exceptions[CAUSE_LOAD_PAGE_FAULT]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "store_page_fault", exceptions[CAUSE_STORE_PAGE_FAULT]);
-
-    SIM_STAT_PRINT_TO_FILE(fp, s, "user_software_interrupt", interrupts[CAUSE_USER_SOFTWARE_INTERRUPT]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "supervisor_software_interrupt", interrupts[CAUSE_SUPERVISOR_SOFTWARE_INTERRUPT]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "machine_software_interrupt", interrupts[CAUSE_MACHINE_SOFTWARE_INTERRUPT]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "user_timer_interrupt", interrupts[CAUSE_USER_TIMER_INTERRUPT]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "supervisor_timer_interrupt", interrupts[CAUSE_SUPERVISOR_TIMER_INTERRUPT]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "machine_timer_interrupt", interrupts[CAUSE_MACHINE_TIMER_INTERRUPT]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "user_external_interrupt", interrupts[CAUSE_USER_EXTERNAL_INTERRUPT]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "supervisor_external_interrupt", interrupts[CAUSE_SUPERVISOR_EXTERNAL_INTERRUPT]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "machine_external_interrupt", interrupts[CAUSE_MACHINE_EXTERNAL_INTERRUPT]);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "pipeline_flush", pipeline_flush);
-
-    SIM_STAT_PRINT_TO_FILE(fp, s, "L1_icache_reads", icache_read);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "L1_icache_read_misses", icache_read_miss);
-
-    SIM_STAT_PRINT_TO_FILE(fp, s, "L1_dcache_reads", dcache_read);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "L1_dcache_read_misses", dcache_read_miss);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "L1_dcache_writes", dcache_write);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "L1_dcache_write_misses", dcache_write_miss);
-
-    SIM_STAT_PRINT_TO_FILE(fp, s, "L2_cache_reads", l2_cache_read);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "L2_cache_read_misses", l2_cache_read_miss);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "L2_cache_writes", l2_cache_write);
-    SIM_STAT_PRINT_TO_FILE(fp, s, "L2_cache_write_misses", l2_cache_write_miss);
+    for (i = 0; i < countof(sim_stat_fields); ++i)
+    {
+        /* Add simulation time required on host machine to stats file, but
+         * only the total time */
+        if (i == SIM_STAT_SIM_TIME_ROW)
+        {
+            fprintf(fp, "%s,%lu,%lu,%lu,%lu,%lu\n", "sim_time_milli_sec",
+                    (uint64_t)0, (uint64_t)0, (uint64_t)0, (uint64_t)0,
+                    sim_time_milli_sec);
+        }
+
+        SIM_STAT_PRINT_TO_FILE(fp, s, &sim_stat_fields[i]);
+    }
 
     fclose(fp);
     sim_log_event(sim_log, "Saved simulation stats in %s", filename);
     free(filename);
 }
 
+void
+sim_stats_print_latency_to_file(const char *pathname, const char *timestamp,
+                                const char **names, const uint64_t **hists,
+                                int num_hists)
+{
+    int i, j;
+    FILE *fp;
+    char filename[PATH_MAX];
+
+    snprintf(filename, sizeof(filename), "%s/%slatency.csv", pathname,
+             timestamp);
+    fp = fopen(filename, "w");
+    assert(fp);
+
+    fprintf(fp, "%s", "min-latency");
+    for (j = 0; j < num_hists; ++j)
+    {
+        fprintf(fp, ",%s", names[j]);
+    }
+    fprintf(fp, "\n");
+
+    for (i = 0; i < NUM_LATENCY_BUCKETS; ++i)
+    {
+        fprintf(fp, "%s", latency_bucket_str[i]);
+        for (j = 0; j < num_hists; ++j)
+        {
+            fprintf(fp, ",%lu", hists[j][i]);
+        }
+        fprintf(fp, "\n");
+    }
+
+    fclose(fp);
+    sim_log_event(sim_log, "Saved latency histograms in %s", filename);
+}
+
+void
+sim_stats_register(const SimStats *s, SimRegistry *r, const char *module)
+{
+    size_t i;
+
+    for (i = 0; i < countof(sim_stat_fields); ++i)
+    {
+        if (!sim_stat_fields[i].mem_hierarchy)
+        {
+            sim_registry_add_mode_counter(
+                r, module, sim_stat_fields[i].name,
+                &SIM_STAT_VALUE(s, &sim_stat_fields[i]), sizeof(SimStats));
+        }
+    }
+}
+
 void
 sim_stats_reset(SimStats *s)
 {
     memset((void *)s, 0, NUM_MAX_PRV_LEVELS * sizeof(SimStats));
 }
 
+void
+sim_stats_add(SimStats *s, const SimStats *a, const SimStats *b)
+{
+    size_t i;
+    uint64_t *ps = (uint64_t *)s;
+    const uint64_t *pa = (const uint64_t *)a;
+    const uint64_t *pb = (const uint64_t *)b;
+
+    /* SimStats only holds 64-bit counters */
+    for (i = 0; i < NUM_MAX_PRV_LEVELS * sizeof(SimStats) / sizeof(uint64_t);
+         ++i)
+    {
+        ps[i] += pa[i] - (pb ? pb[i] : 0);
+    }
+}
+
+uint64_t
+sim_stats_hpm_event(const SimStats *s, int event)
+{
+    int i;
+    uint64_t count = 0;
+
+    switch (event)
+    {
+        case HPM_EVENT_ICACHE_MISS:
+        {
+            return s->icache_read_miss;
+        }
+        case HPM_EVENT_DCACHE_READ_MISS:
+        {
+            return s->dcache_read_miss;
+        }
+        case HPM_EVENT_DCACHE_WRITE_MISS:
+        {
+            return s->dcache_write_miss;
+        }
+        case HPM_EVENT_L2_MISS:
+        {
+            return s->shared_cache_read_miss[0] + s->shared_cache_write_miss[0];
+        }
+        case HPM_EVENT_ITLB_MISS:
+        {
+            return s->code_tlb_lookups - s->code_tlb_hits;
+        }
+        case HPM_EVENT_DTLB_MISS:
+        {
+            return (s->load_tlb_lookups - s->load_tlb_hits)
+                   + (s->store_tlb_lookups - s->store_tlb_hits);
+        }
+        case HPM_EVENT_PAGE_WALK:
+        {
+            return s->ins_page_walks + s->load_page_walks
+                   + s->store_page_walks;
+        }
+        case HPM_EVENT_BRANCH:
+        {
+            return s->ins_type[INS_TYPE_COND_BRANCH] + s->ins_type[INS_TYPE_JAL]
+                   + s->ins_type[INS_TYPE_JALR];
+        }
+        case HPM_EVENT_BRANCH_MISPREDICT:
+        {
+            return s->bpu_cond_incorrect + s->bpu_uncond_incorrect;
+        }
+        case HPM_EVENT_INSN_MEM_STALL:
+        {
+            return s->insn_mem_delay;
+        }
+        case HPM_EVENT_DATA_MEM_STALL:
+        {
+            return s->data_mem_delay;
+        }
+        case HPM_EVENT_EXEC_UNIT_STALL:
+        {
+            return s->exec_unit_delay;
+        }
+        case HPM_EVENT_PIPELINE_FLUSH:
+        {
+            return s->pipeline_flush;
+        }
+        case HPM_EVENT_FUSED_PAIR:
+        {
+            for (i = 0; i < NUM_FUSION_PATTERNS; ++i)
+            {
+                count += s->fused_pairs[i];
+            }
+            return count;
+        }
+    }
+    return 0;
+}
+
 int
 sim_file_path_valid(const char *path)
 {
@@ -33,6 +33,7 @@
 #include <inttypes.h>
 
 #include "../riscv_sim_macros.h"
+#include "sim_registry.h"
 
 typedef struct SimStats
 {
@@ -50,6 +51,12 @@ typedef struct SimStats
     uint64_t ins_type[NUM_MAX_INS_TYPES];
     uint64_t ins_cond_branch_taken;
 
+    /* Fused instruction pairs committed, per FUSION_* pattern */
+    uint64_t fused_pairs[NUM_FUSION_PATTERNS];
+
+    /* Top-down commit slots, per TD_* category */
+    uint64_t td_slots[NUM_TD_CATEGORIES];
+
     /* Register Access */
     uint64_t csr_reads;
     uint64_t csr_writes;
@@ -61,6 +68,14 @@ typedef struct SimStats
     /* FU_Access */
     uint64_t fu_access[NUM_MAX_FU];
 
+    /* Vector unit */
+    uint64_t vec_beats;        /* Cycles the vector lanes were busy */
+    uint64_t vec_chained;      /* Operations started before their sources
+                                  were complete */
+    uint64_t vec_mem_lines;    /* Cache lines accessed by vector loads and
+                                  stores */
+    uint64_t vec_stall_cycles; /* Cycles waiting for sources or a busy pipe */
+
     /* BPU */
     uint64_t btb_probes;
     uint64_t btb_hits;
@@ -93,10 +108,25 @@ typedef struct SimStats
     uint64_t dcache_write;
     uint64_t dcache_read_miss;
     uint64_t dcache_write_miss;
-    uint64_t l2_cache_read;
-    uint64_t l2_cache_write;
-    uint64_t l2_cache_read_miss;
-    uint64_t l2_cache_write_miss;
+
+    /* Victim cache after L1 data cache */
+    uint64_t victim_cache_read;
+    uint64_t victim_cache_read_miss;
+    uint64_t victim_cache_fill;
+
+    /* Shared caches, index 0 is L2 */
+    uint64_t shared_cache_read[NUM_MAX_SHARED_CACHE_LEVELS];
+    uint64_t shared_cache_write[NUM_MAX_SHARED_CACHE_LEVELS];
+    uint64_t shared_cache_read_miss[NUM_MAX_SHARED_CACHE_LEVELS];
+    uint64_t shared_cache_write_miss[NUM_MAX_SHARED_CACHE_LEVELS];
+    uint64_t shared_cache_back_invalidate[NUM_MAX_SHARED_CACHE_LEVELS];
+    uint64_t shared_cache_victim_fill[NUM_MAX_SHARED_CACHE_LEVELS];
+
+    /* Coherence of L1 data caches, for the requests made by this hart */
+    uint64_t coherence_invalidations;
+    uint64_t coherence_downgrades;
+    uint64_t coherence_c2c_transfers;
+    uint64_t coherence_upgrade_misses;
 
     /* Exceptions */
     uint64_t interrupts[24];
@@ -114,5 +144,22 @@ void sim_stats_print_to_file(const SimStats *s, const char *pathname,
  * simulation completes */
 void sim_stats_print_to_terminal(const SimStats *s);
 void sim_stats_reset(SimStats *s);
+
+/* Latency histograms of NUM_LATENCY_BUCKETS buckets are printed to file in
+ * CSV format, one column per histogram, when simulation completes */
+void sim_stats_print_latency_to_file(const char *pathname,
+                                     const char *timestamp, const char **names,
+                                     const uint64_t **hists, int num_hists);
+
+/* Registers the per-mode stats, except the ones copied from the memory
+ * hierarchy, in the stats registry */
+void sim_stats_register(const SimStats *s, SimRegistry *r, const char *module);
+
+/* Adds the per-mode stats a, less b if not NULL, to s */
+void sim_stats_add(SimStats *s, const SimStats *a, const SimStats *b);
+
+/* Returns the count of the HPM_EVENT_* event in the stats of one privilege
+ * mode */
+uint64_t sim_stats_hpm_event(const SimStats *s, int event);
 int sim_file_path_valid(const char *path);
 #endif
@@ -0,0 +1,648 @@
+/**
+ * Design-space sweep
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "sim_log.h"
+#include "sim_sweep.h"
+
+/* Parent process state used by the SIGCHLD handler */
+static SimSweep *sweep_parent;
+
+/* Stats of all the variants, one column per stats file */
+typedef struct SweepTable
+{
+    int num_rows;
+    int max_rows;
+    int num_cols;
+    int max_cols;
+    char **names;
+    char **labels;
+    char ***cells; /* cells[row][col], NULL if the stat is missing */
+} SweepTable;
+
+static JSONValue
+sweep_load_json(const char *filename)
+{
+    FILE *fp;
+    long size;
+    char *buf;
+    JSONValue val;
+
+    fp = fopen(filename, "rb");
+    sim_assert((fp), "error: %s at line %d in %s(): cannot open %s", __FILE__,
+               __LINE__, __func__, filename);
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    buf = (char *)malloc(size);
+    assert(buf);
+    sim_assert((fread(buf, 1, size, fp) == (size_t)size),
+               "error: %s at line %d in %s(): cannot read %s", __FILE__,
+               __LINE__, __func__, filename);
+    fclose(fp);
+
+    val = json_parse_value_len(buf, size);
+    free(buf);
+    sim_assert((!json_is_error(val)), "error: %s at line %d in %s(): %s: %s",
+               __FILE__, __LINE__, __func__, filename, json_get_error(val));
+    return val;
+}
+
+static int
+sweep_name_valid(const char *name)
+{
+    if ('\0' == *name)
+    {
+        return FALSE;
+    }
+
+    for (; *name; ++name)
+    {
+        if (!(((*name >= 'a') && (*name <= 'z'))
+              || ((*name >= 'A') && (*name <= 'Z'))
+              || ((*name >= '0') && (*name <= '9')) || (*name == '_')
+              || (*name == '-') || (*name == '.')))
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* Lays the properties of overlay over cfg. Objects are merged property by
+ * property, any other value (including arrays) replaces the value in cfg. The
+ * values are moved out of overlay. */
+static void
+sweep_overlay_config(JSONValue cfg, JSONValue overlay, int top_level)
+{
+    int i;
+    const char *name;
+    JSONProperty *prop;
+    JSONValue dst;
+
+    for (i = 0; i < overlay.u.obj->len; ++i)
+    {
+        prop = &overlay.u.obj->props[i];
+        name = json_get_str(prop->name);
+
+        if (top_level && (0 == strcmp(name, "name")))
+        {
+            continue;
+        }
+
+        dst = json_object_get(cfg, name);
+        if ((JSON_OBJ == prop->value.type) && (JSON_OBJ == dst.type))
+        {
+            sweep_overlay_config(dst, prop->value, FALSE);
+        }
+        else
+        {
+            json_object_set(cfg, name, prop->value);
+            prop->value = json_undefined_new();
+        }
+    }
+}
+
+/* Loads the variants of a sweep file. Variants are checked here, so that
+ * errors in the file are reported before the guest boots. The variants point
+ * into *cfg, which is kept by the caller. */
+SimSweepVariant *
+sim_sweep_load_variants(const char *file_name, JSONValue *cfg,
+                        int *num_variants)
+{
+    int i, j, n;
+    SimSweepVariant *v;
+    JSONValue variants, obj;
+
+    *cfg = sweep_load_json(file_name);
+    variants = json_object_get(*cfg, "variants");
+    sim_assert((JSON_ARRAY == variants.type),
+               "error: %s at line %d in %s(): %s must have a variants array",
+               __FILE__, __LINE__, __func__, file_name);
+
+    n = variants.u.array->len;
+    sim_assert((n > 0), "error: %s at line %d in %s(): %s has no variants",
+               __FILE__, __LINE__, __func__, file_name);
+
+    v = (SimSweepVariant *)calloc(n, sizeof(SimSweepVariant));
+    assert(v);
+
+    for (i = 0; i < n; ++i)
+    {
+        obj = json_array_get(variants, i);
+        sim_assert((JSON_OBJ == obj.type),
+                   "error: %s at line %d in %s(): variant %d is not an object",
+                   __FILE__, __LINE__, __func__, i);
+        sim_assert((JSON_STR == json_object_get(obj, "name").type),
+                   "error: %s at line %d in %s(): variant %d has no name",
+                   __FILE__, __LINE__, __func__, i);
+
+        v[i].name = json_get_str(json_object_get(obj, "name"));
+        v[i].overlay = obj;
+        sim_assert((sweep_name_valid(v[i].name)),
+                   "error: %s at line %d in %s(): invalid variant name %s",
+                   __FILE__, __LINE__, __func__, v[i].name);
+
+        for (j = 0; j < i; ++j)
+        {
+            sim_assert((strcmp(v[i].name, v[j].name)),
+                       "error: %s at line %d in %s(): duplicate variant %s",
+                       __FILE__, __LINE__, __func__, v[i].name);
+        }
+    }
+
+    *num_variants = n;
+    return v;
+}
+
+/* Returns the simulation parameters of variant v: the config file cfg_file
+ * with the properties of the variant laid over it. Command line options are
+ * inherited from base, and the stats files are named after prefix. The overlay
+ * of the variant is consumed. */
+SimParams *
+sim_sweep_variant_params(const char *cfg_file, SimSweepVariant *v,
+                         const SimParams *base, const char *prefix)
+{
+    SimParams *p;
+    JSONValue cfg;
+
+    p = sim_params_init();
+    p->start_in_sim = base->start_in_sim;
+    p->flush_sim_mem_on_simstart = base->flush_sim_mem_on_simstart;
+    p->flush_bpu_on_simstart = base->flush_bpu_on_simstart;
+    p->do_sim_trace = base->do_sim_trace;
+    p->do_pipe_trace = base->do_pipe_trace;
+    p->pipe_trace_start_cycle = base->pipe_trace_start_cycle;
+    p->pipe_trace_end_cycle = base->pipe_trace_end_cycle;
+    p->pipe_trace_start_pc = base->pipe_trace_start_pc;
+    p->pipe_trace_end_pc = base->pipe_trace_end_pc;
+    p->do_profile = base->do_profile;
+    p->roi_filter = base->roi_filter;
+    p->roi_asid = base->roi_asid;
+    p->do_stats_export = base->do_stats_export;
+    p->stats_export_interval = base->stats_export_interval;
+    p->do_host_profile = base->do_host_profile;
+    if (base->profile_symbol_file)
+    {
+        p->profile_symbol_file = strdup(base->profile_symbol_file);
+    }
+    p->sim_emulate_after_icount = base->sim_emulate_after_icount;
+    p->dram_model_type = base->dram_model_type;
+    p->guest_ram_size = base->guest_ram_size;
+
+    free(p->sim_file_path);
+    p->sim_file_path = strdup(base->sim_file_path);
+    free(p->sim_file_prefix);
+    p->sim_file_prefix = strdup(prefix);
+    free(p->cfg_file);
+    p->cfg_file = strdup(cfg_file);
+
+    cfg = sweep_load_json(cfg_file);
+    sweep_overlay_config(cfg, v->overlay, TRUE);
+    sim_params_parse(p, cfg);
+    json_free(cfg);
+
+    /* The machine is shared with the base configuration */
+    sim_assert((p->num_harts == base->num_harts),
+               "error: %s at line %d in %s(): %s", __FILE__, __LINE__, __func__,
+               "variants cannot change num_harts");
+    sim_assert(((p->enable_vector == base->enable_vector)
+                && (p->vlen == base->vlen)),
+               "error: %s at line %d in %s(): %s", __FILE__, __LINE__, __func__,
+               "variants cannot change vector_unit enable and vlen");
+    sim_params_validate(p);
+    return p;
+}
+
+SimSweep *
+sim_sweep_init(const SimParams *p)
+{
+    long num_cpus;
+    SimSweep *s;
+
+    s = (SimSweep *)calloc(1, sizeof(SimSweep));
+    assert(s);
+
+    s->cfg_file = strdup(p->cfg_file);
+    assert(s->cfg_file);
+    s->child = -1;
+
+    /* By default, the children and the parent use all the host CPUs */
+    s->jobs = p->sweep_jobs;
+    if (0 == s->jobs)
+    {
+        num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        s->jobs = (num_cpus > 1) ? (int)(num_cpus - 1) : 1;
+    }
+
+    s->variants = sim_sweep_load_variants(p->sweep_file, &s->sweep_cfg,
+                                          &s->num_variants);
+
+    /* Job slots and the results of the children are shared with the parent */
+    s->shared_size = sizeof(SimSweepShared)
+                     + s->num_variants * sizeof(SimSweepResult);
+    s->shared = (SimSweepShared *)mmap(NULL, s->shared_size,
+                                       PROT_READ | PROT_WRITE,
+                                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    sim_assert((MAP_FAILED != s->shared), "error: %s at line %d in %s(): %s",
+               __FILE__, __LINE__, __func__, "cannot map sweep results");
+    sim_assert((0 == sem_init(&s->shared->job_slots, 1, s->jobs)),
+               "error: %s at line %d in %s(): %s", __FILE__, __LINE__, __func__,
+               "cannot create sweep job slots");
+
+    sim_log_event_to_file(sim_log, "Sweep of %d variants from %s, %d job(s)",
+                          s->num_variants, p->sweep_file, s->jobs);
+    return s;
+}
+
+/* Reaps the children, every child that exits releases its job slot */
+static void
+sweep_sigchld_handler(int sig)
+{
+    int i, status, saved_errno = errno;
+    pid_t pid;
+
+    (void)sig;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        for (i = 0; i < sweep_parent->num_variants; ++i)
+        {
+            if (sweep_parent->variants[i].pid == pid)
+            {
+                sweep_parent->variants[i].exit_status = status;
+                ++sweep_parent->num_exited;
+                sem_post(&sweep_parent->shared->job_slots);
+                break;
+            }
+        }
+    }
+    errno = saved_errno;
+}
+
+static SimParams *
+sweep_child_init(SimSweep *s, const SimParams *base, const sigset_t *mask)
+{
+    int fds[2];
+    char prefix[PATH_MAX];
+    char file_name[PATH_MAX + 32];
+    SimParams *p;
+    SimSweepVariant *v = &s->variants[s->child];
+
+    signal(SIGCHLD, SIG_DFL);
+    sigprocmask(SIG_SETMASK, mask, NULL);
+
+    /* The console stays with the parent: the child reads from a pipe nobody
+     * writes to and its output goes to a file */
+    sim_assert((0 == pipe(fds)), "error: %s at line %d in %s(): %s", __FILE__,
+               __LINE__, __func__, "cannot create sweep console pipe");
+    dup2(fds[0], STDIN_FILENO);
+    close(fds[0]);
+
+    snprintf(prefix, sizeof(prefix), "%s_sweep_%s", base->sim_file_prefix,
+             v->name);
+    snprintf(file_name, sizeof(file_name), "%s/%s.out", base->sim_file_path,
+             prefix);
+    sim_assert((freopen(file_name, "w", stdout)),
+               "error: %s at line %d in %s(): cannot open %s", __FILE__,
+               __LINE__, __func__, file_name);
+    dup2(STDOUT_FILENO, STDERR_FILENO);
+
+    snprintf(file_name, sizeof(file_name), "%s/%s.log", base->sim_file_path,
+             prefix);
+    sim_log_free(&sim_log);
+    sim_log = sim_log_init(file_name);
+    assert(sim_log->log_fp);
+    sim_log_event(sim_log, "Simulating sweep variant %s", v->name);
+
+    p = sim_sweep_variant_params(s->cfg_file, v, base, prefix);
+    free(p->sim_log_file);
+    p->sim_log_file = strdup(file_name);
+    s->child_params = p;
+
+    while (sem_wait(&s->shared->job_slots) < 0)
+    {
+        sim_assert((EINTR == errno), "error: %s at line %d in %s(): %s",
+                   __FILE__, __LINE__, __func__, "cannot get a sweep job slot");
+    }
+    return p;
+}
+
+/* Forks a child for every variant. Returns the simulation parameters of the
+ * variant in the child and NULL in the parent. */
+SimParams *
+sim_sweep_fork(SimSweep *s, const SimParams *base)
+{
+    int i;
+    pid_t pid;
+    struct sigaction sa;
+    sigset_t mask, old_mask;
+
+    s->forked = TRUE;
+    sweep_parent = s;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = &sweep_sigchld_handler;
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGCHLD, &sa, NULL);
+
+    fflush(stdout);
+    fflush(stderr);
+    fflush(sim_log->log_fp);
+
+    /* A child exiting early is reaped once its pid is known */
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &old_mask);
+
+    for (i = 0; i < s->num_variants; ++i)
+    {
+        pid = fork();
+        sim_assert((pid >= 0), "error: %s at line %d in %s(): %s", __FILE__,
+                   __LINE__, __func__, "cannot fork sweep variant");
+
+        if (0 == pid)
+        {
+            s->child = i;
+            return sweep_child_init(s, base, &old_mask);
+        }
+        s->variants[i].pid = pid;
+    }
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+
+    sim_log_event(sim_log, "Forked %d sweep variants, %d running at a time",
+                  s->num_variants, s->jobs);
+    return NULL;
+}
+
+static int
+sweep_table_row(SweepTable *t, const char *name)
+{
+    int i;
+
+    for (i = 0; i < t->num_rows; ++i)
+    {
+        if (0 == strcmp(t->names[i], name))
+        {
+            return i;
+        }
+    }
+
+    if (t->num_rows == t->max_rows)
+    {
+        t->max_rows = t->max_rows ? 2 * t->max_rows : 64;
+        t->names = (char **)realloc(t->names, t->max_rows * sizeof(char *));
+        t->cells = (char ***)realloc(t->cells, t->max_rows * sizeof(char **));
+        assert(t->names && t->cells);
+    }
+
+    t->names[t->num_rows] = strdup(name);
+    t->cells[t->num_rows] = (char **)calloc(t->max_cols, sizeof(char *));
+    assert(t->names[t->num_rows] && t->cells[t->num_rows]);
+    return t->num_rows++;
+}
+
+/* Adds the total column of a stats file to the table */
+static void
+sweep_table_add_file(SweepTable *t, const char *label, const char *file_name)
+{
+    int row, col;
+    FILE *fp;
+    char line[1024];
+    char *value;
+
+    fp = fopen(file_name, "r");
+    if (NULL == fp)
+    {
+        sim_log_event(sim_log, "Sweep stats file %s not found", file_name);
+        return;
+    }
+
+    col = t->num_cols++;
+    t->labels[col] = strdup(label);
+
+    /* Skip the header */
+    if (NULL == fgets(line, sizeof(line), fp))
+    {
+        fclose(fp);
+        return;
+    }
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        value = strrchr(line, ',');
+        if ((NULL == value) || (value == line))
+        {
+            continue;
+        }
+
+        *value++ = '\0';
+        *strchr(line, ',') = '\0';
+        row = sweep_table_row(t, line);
+        t->cells[row][col] = strdup(value);
+    }
+    fclose(fp);
+}
+
+static void
+sweep_add_stats(SweepTable *t, const SimParams *p, const char *label,
+                const char *timestamp)
+{
+    int i;
+    char name[PATH_MAX];
+    char col_label[PATH_MAX];
+    char file_name[PATH_MAX + 32];
+
+    for (i = 0; i < p->num_harts; ++i)
+    {
+        sim_log_get_hart_file_name(name, sizeof(name), timestamp, i);
+        snprintf(file_name, sizeof(file_name), "%s/%s.csv", p->sim_file_path,
+                 name);
+        sim_log_get_hart_file_name(col_label, sizeof(col_label), label, i);
+        sweep_table_add_file(t, col_label, file_name);
+    }
+}
+
+/* Writes the table to file_name and frees it */
+static void
+sweep_table_write(SweepTable *t, const char *file_name)
+{
+    int i, j;
+    FILE *fp;
+
+    fp = fopen(file_name, "w");
+    assert(fp);
+
+    fprintf(fp, "stat-name");
+    for (j = 0; j < t->num_cols; ++j)
+    {
+        fprintf(fp, ",%s", t->labels[j]);
+    }
+    fprintf(fp, "\n");
+
+    for (i = 0; i < t->num_rows; ++i)
+    {
+        fprintf(fp, "%s", t->names[i]);
+        for (j = 0; j < t->num_cols; ++j)
+        {
+            fprintf(fp, ",%s", t->cells[i][j] ? t->cells[i][j] : "");
+            free(t->cells[i][j]);
+        }
+        fprintf(fp, "\n");
+        free(t->cells[i]);
+        free(t->names[i]);
+    }
+    fclose(fp);
+
+    for (j = 0; j < t->num_cols; ++j)
+    {
+        free(t->labels[j]);
+    }
+    free(t->labels);
+    free(t->names);
+    free(t->cells);
+}
+
+static void
+sweep_merge_stats(SimSweep *s, const SimParams *p, const char *timestamp)
+{
+    int i;
+    char file_name[PATH_MAX];
+    SweepTable t;
+    sigset_t mask, old_mask;
+
+    /* Wait for all the children to exit */
+    sim_log_event(sim_log, "Waiting for %d sweep variant(s)",
+                  s->num_variants - s->num_exited);
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &old_mask);
+    while (s->num_exited < s->num_variants)
+    {
+        sigsuspend(&old_mask);
+    }
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+
+    memset(&t, 0, sizeof(t));
+    t.max_cols = (1 + s->num_variants) * p->num_harts;
+    t.labels = (char **)calloc(t.max_cols, sizeof(char *));
+    assert(t.labels);
+
+    sweep_add_stats(&t, p, "base", timestamp);
+    for (i = 0; i < s->num_variants; ++i)
+    {
+        if (!s->shared->results[i].done)
+        {
+            sim_log_event(sim_log,
+                          "Sweep variant %s did not complete (status %d)",
+                          s->variants[i].name, s->variants[i].exit_status);
+            continue;
+        }
+        sweep_add_stats(&t, p, s->variants[i].name,
+                        s->shared->results[i].timestamp);
+    }
+
+    snprintf(file_name, sizeof(file_name), "%s/%ssweep.csv", p->sim_file_path,
+             timestamp);
+    sweep_table_write(&t, file_name);
+
+    sim_log_event(sim_log, "Saved sweep statistics in %s", file_name);
+}
+
+/* Merges the total column of num_files stats files into file_name, one
+ * column per file */
+void
+sim_sweep_merge_files(const char *file_name, int num_files,
+                      const char *const *labels, const char *const *files)
+{
+    int i;
+    SweepTable t;
+
+    memset(&t, 0, sizeof(t));
+    t.max_cols = num_files;
+    t.labels = (char **)calloc(t.max_cols, sizeof(char *));
+    assert(t.labels);
+
+    for (i = 0; i < num_files; ++i)
+    {
+        sweep_table_add_file(&t, labels[i], files[i]);
+    }
+    sweep_table_write(&t, file_name);
+}
+
+/* Called once the stats of a simulation run are written. A child records the
+ * name of its stats files and exits, the parent merges the stats of all the
+ * variants after its first run. */
+void
+sim_sweep_finish(SimSweep *s, const SimParams *p, const char *timestamp)
+{
+    SimSweepResult *r;
+
+    if (s->child >= 0)
+    {
+        r = &s->shared->results[s->child];
+        snprintf(r->timestamp, sizeof(r->timestamp), "%s", timestamp);
+        r->done = TRUE;
+        sim_log_event(sim_log, "Sweep variant %s done",
+                      s->variants[s->child].name);
+        exit(0);
+    }
+
+    if (s->forked && !s->merged)
+    {
+        s->merged = TRUE;
+        sweep_merge_stats(s, p, timestamp);
+    }
+}
+
+void
+sim_sweep_free(SimSweep **s)
+{
+    if ((*s)->child < 0)
+    {
+        sem_destroy(&(*s)->shared->job_slots);
+    }
+    munmap((*s)->shared, (*s)->shared_size);
+
+    if ((*s)->child_params)
+    {
+        sim_params_free((*s)->child_params);
+    }
+    json_free((*s)->sweep_cfg);
+    free((*s)->variants);
+    free((*s)->cfg_file);
+    free(*s);
+    *s = NULL;
+}
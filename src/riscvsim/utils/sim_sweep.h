@@ -0,0 +1,111 @@
+/**
+ * Design-space sweep
+ *
+ * MARSS-RISCV : Micro-Architectural System Simulator for RISC-V
+ *
+ * Copyright (c) 2020 Gaurav Kothari {gkothar1@binghamton.edu}
+ * State University of New York at Binghamton
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _SIM_SWEEP_H_
+#define _SIM_SWEEP_H_
+
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/types.h>
+
+#include "../../json.h"
+#include "sim_params.h"
+
+#define SIM_SWEEP_TIMESTAMP_SIZE 1024
+
+typedef struct SimSweepVariant
+{
+    const char *name;
+    JSONValue overlay; /* Config file properties overridden by the variant */
+    pid_t pid;
+    int exit_status;
+} SimSweepVariant;
+
+/* Written by the children, read by the parent */
+typedef struct SimSweepResult
+{
+    int done;
+    char timestamp[SIM_SWEEP_TIMESTAMP_SIZE]; /* Names the stats files */
+} SimSweepResult;
+
+typedef struct SimSweepShared
+{
+    sem_t job_slots;
+    SimSweepResult results[];
+} SimSweepShared;
+
+/* A sweep simulates variants of the machine configuration from a single boot.
+ * The first time simulation starts, one child process is forked per variant,
+ * sharing the guest RAM and device state with the parent copy-on-write. Every
+ * child rebuilds the simulated harts with the simulation parameters of its
+ * variant, which are the machine config file with the properties of the
+ * variant object laid over it, and exits when simulation stops. At most jobs
+ * children simulate at the same time, the others wait for a job slot.
+ *
+ * The parent keeps simulating the base configuration. When its simulation
+ * stops, it waits for all the children and merges the total column of the
+ * stats files of every variant into a single CSV file.
+ *
+ * Sweep file format:
+ *
+ * {
+ *     variants: [
+ *         { name: "rob32", core: { oocore: { rob_size: 32 } } },
+ *         { name: "rob128", core: { oocore: { rob_size: 128 } } },
+ *     ],
+ * }
+ */
+typedef struct SimSweep
+{
+    char *cfg_file;
+    int jobs;
+
+    JSONValue sweep_cfg;
+    SimSweepVariant *variants;
+    int num_variants;
+
+    int forked;
+    int merged;
+    int child; /* Variant simulated by this process, -1 in the parent */
+    SimParams *child_params;
+
+    volatile sig_atomic_t num_exited;
+    SimSweepShared *shared;
+    size_t shared_size;
+} SimSweep;
+
+SimSweepVariant *sim_sweep_load_variants(const char *file_name, JSONValue *cfg,
+                                         int *num_variants);
+SimParams *sim_sweep_variant_params(const char *cfg_file, SimSweepVariant *v,
+                                    const SimParams *base, const char *prefix);
+void sim_sweep_merge_files(const char *file_name, int num_files,
+                           const char *const *labels,
+                           const char *const *files);
+SimSweep *sim_sweep_init(const SimParams *p);
+SimParams *sim_sweep_fork(SimSweep *s, const SimParams *base);
+void sim_sweep_finish(SimSweep *s, const SimParams *p, const char *timestamp);
+void sim_sweep_free(SimSweep **s);
+#endif
@@ -187,10 +187,12 @@ print_caches_stats()
         = GET_TOTAL_STAT(dcache_read) - GET_TOTAL_STAT(dcache_read_miss);
     uint64_t dcache_write_hit
         = GET_TOTAL_STAT(dcache_write) - GET_TOTAL_STAT(dcache_write_miss);
-    uint64_t l2_cache_read_hit
-        = GET_TOTAL_STAT(l2_cache_read) - GET_TOTAL_STAT(l2_cache_read_miss);
-    uint64_t l2_cache_write_hit
-        = GET_TOTAL_STAT(l2_cache_write) - GET_TOTAL_STAT(l2_cache_write_miss);
+    uint64_t victim_cache_hit = GET_TOTAL_STAT(victim_cache_read)
+                                - GET_TOTAL_STAT(victim_cache_read_miss);
+    uint64_t shared_cache_read_hit;
+    uint64_t shared_cache_write_hit;
+    char name[32];
+    int i;
 
     printf("%-22s : %-22" PRIu64 " (%0.2lf %%)\n", "icache-hits", icache_hit,
            ((double)icache_hit / (double)GET_TOTAL_STAT(icache_read)) * 100);
@@ -205,15 +207,43 @@ print_caches_stats()
            ((double)dcache_write_hit / (double)GET_TOTAL_STAT(dcache_write))
                * 100);
 
-    printf("%-22s : %-22" PRIu64 " (%0.2lf %%)\n", "l2-shared-read-hits",
-           l2_cache_read_hit,
-           ((double)l2_cache_read_hit / (double)GET_TOTAL_STAT(l2_cache_read))
-               * 100);
+    if (GET_TOTAL_STAT(victim_cache_read))
+    {
+        printf("%-22s : %-22" PRIu64 " (%0.2lf %%)\n", "victim-cache-hits",
+               victim_cache_hit,
+               ((double)victim_cache_hit
+                / (double)GET_TOTAL_STAT(victim_cache_read))
+                   * 100);
+    }
 
-    printf("%-22s : %-22" PRIu64 " (%0.2lf %%)\n", "l2-shared-write-hits",
-           l2_cache_write_hit,
-           ((double)l2_cache_write_hit / (double)GET_TOTAL_STAT(l2_cache_write))
-               * 100);
+    for (i = 0; i < NUM_MAX_SHARED_CACHE_LEVELS; ++i)
+    {
+        /* Skip the levels which are not configured */
+        if (!GET_TOTAL_STAT(shared_cache_read[i])
+            && !GET_TOTAL_STAT(shared_cache_write[i]))
+        {
+            continue;
+        }
+
+        shared_cache_read_hit = GET_TOTAL_STAT(shared_cache_read[i])
+                                - GET_TOTAL_STAT(shared_cache_read_miss[i]);
+        shared_cache_write_hit = GET_TOTAL_STAT(shared_cache_write[i])
+                                 - GET_TOTAL_STAT(shared_cache_write_miss[i]);
+
+        snprintf(name, sizeof(name), "l%d-shared-read-hits", i + 2);
+        printf("%-22s : %-22" PRIu64 " (%0.2lf %%)\n", name,
+               shared_cache_read_hit,
+               ((double)shared_cache_read_hit
+                / (double)GET_TOTAL_STAT(shared_cache_read[i]))
+                   * 100);
+
+        snprintf(name, sizeof(name), "l%d-shared-write-hits", i + 2);
+        printf("%-22s : %-22" PRIu64 " (%0.2lf %%)\n", name,
+               shared_cache_write_hit,
+               ((double)shared_cache_write_hit
+                / (double)GET_TOTAL_STAT(shared_cache_write[i]))
+                   * 100);
+    }
 
     printf("\n");
 }
@@ -624,6 +624,22 @@ static struct option options[] = {
     {"sim-file-path", required_argument},
     {"sim-file-prefix", required_argument},
     {"sim-stop-after-icount", required_argument},
+    {"sim-sweep-file", required_argument},
+    {"sim-sweep-jobs", required_argument},
+    {"sim-lockstep-file", required_argument},
+    {"sim-pipe-trace", no_argument},
+    {"sim-pipe-trace-cycles", required_argument},
+    {"sim-pipe-trace-pc", required_argument},
+    {"sim-profile", no_argument},
+    {"sim-profile-symbols", required_argument},
+    {"sim-roi", no_argument},
+    {"sim-roi-asid", required_argument},
+    {"sim-stats-export", no_argument},
+    {"sim-stats-export-interval", required_argument},
+    {"sim-host-profile", no_argument},
+    {"sim-elf", required_argument},
+    {"ram-file", required_argument},
+    {"ram-huge-pages", no_argument},
     {NULL},
 };
 
@@ -634,6 +650,8 @@ void help(void)
            "usage: marss-riscv [options] config_file\n"
            "options are:\n"
            "-m ram_size                         set the RAM size in MB\n"
+           "-ram-file file                      start with the RAM contents of a raw image file, read on demand\n"
+           "-ram-huge-pages                     back the RAM with host huge pages\n"
            "-rw                                 allow write access to the disk image (default=snapshot)\n"
            "-ctrlc                              the C-c key stops the emulator instead of being sent to the\n"
            "                                    emulated software\n"
@@ -642,13 +660,28 @@ void help(void)
            "-sim-stats-display [posix-shm-name] dump simulation performance stats to a shared memory location <posix-shm-name>, read by sim-stats-display tool\n"
            "-sim-mem-model [base,\n"
            "                dramsim3,\n"
-           "                ramulator]          type of simulated memory model\n"
+           "                ramulator,\n"
+           "                analytical]         type of simulated memory model\n"
            "-sim-flush-mem                      flush simulator memory hierarchy on every new simulation run\n"
            "-sim-flush-bpu                      flush branch prediction unit on every new simulation run\n"
            "-sim-trace                          generate instruction commit trace in [trace-file-name] during simulation\n"
            "-sim-file-path [directory path]     path of the directory to store stats, log, and trace file\n"
            "-sim-file-prefix [prefix]           prefix appended to stats, log, and trace file names\n"
            "-sim-emulate-after-icount [icount]  switch to emulation mode after simulating icount instructions every time simulation starts\n"
+           "-sim-sweep-file [sweep-file]        simulate the configuration variants of sweep-file in child processes forked when simulation starts\n"
+           "-sim-sweep-jobs [jobs]              number of sweep variants simulated at the same time (default: number of host CPUs - 1)\n"
+           "-sim-lockstep-file [lockstep-file]  time the memory hierarchy and branch predictor variants of lockstep-file along with the in-order core\n"
+           "-sim-pipe-trace                     generate pipeline view trace (O3PipeView format, read by Konata) in [prefix].pipeview during simulation\n"
+           "-sim-pipe-trace-cycles [start:end]  only trace the instructions fetched within this range of simulation cycles (end 0: no limit)\n"
+           "-sim-pipe-trace-pc [start:end]      only trace the instructions within this range of PCs (end 0: no limit)\n"
+           "-sim-profile                        generate per-PC hotspot and miss profile in [prefix]_[timestamp]_profile.csv and .folded (flamegraph) files\n"
+           "-sim-profile-symbols [file]         symbolize the profile with a guest ELF or System.map file\n"
+           "-sim-roi                            split the stats into the address space executing the start marker (roi) and the rest (other)\n"
+           "-sim-roi-asid [asid]                split the stats into the address space with the given satp ASID (roi) and the rest (other)\n"
+           "-sim-stats-export                   write the stats of all the modules to [prefix]_[timestamp]_stats.jsonl (JSON lines) and .bin (columnar) files\n"
+           "-sim-stats-export-interval [cycles] enable -sim-stats-export, also writing the stats every given number of cycles\n"
+           "-sim-host-profile                   measure the host time spent in the pipeline stages, memory hierarchy and DRAM model\n"
+           "-sim-elf [file]                     run a static bare-metal RISC-V ELF in simulation mode, in place of the boot files of the config\n"
            "\n"
            "Console keys:\n"
            "Press C-a x to exit the emulator, C-a h to get some help.\n");
@@ -676,8 +709,22 @@ int main(int argc, char **argv)
     char sim_log_file_name[1024];
     const char *path, *cmdline, *build_preload_file;
     char *sim_file_path = NULL, *sim_file_prefix = NULL, *sim_stats_shm_name = NULL;
+    char *sim_sweep_file = NULL;
+    int sim_sweep_jobs = 0;
+    char *sim_lockstep_file = NULL;
+    int marss_do_pipe_trace = FALSE;
+    uint64_t pipe_trace_range[4] = {0, 0, 0, 0};
+    int marss_do_profile = FALSE;
+    char *sim_profile_symbols = NULL;
+    int marss_roi_filter = ROI_FILTER_NONE;
+    uint64_t marss_roi_asid = 0;
+    int marss_do_stats_export = FALSE;
+    uint64_t marss_stats_export_interval = 0;
+    int marss_do_host_profile = FALSE;
+    char *sim_elf_file = NULL;
+    const char *ram_file = NULL;
     int c, option_index, i, ram_size, accel_enable;
-    BOOL allow_ctrlc;
+    BOOL allow_ctrlc, ram_huge_pages = FALSE;
     BlockDeviceModeEnum drive_mode;
     VirtMachineParams p_s, *p = &p_s;
     int marss_start_in_sim = FALSE;
@@ -737,6 +784,10 @@ int main(int argc, char **argv)
                 {
                     marss_mem_model = MEM_MODEL_RAMULATOR;
                 }
+                else if (strcmp(optarg, "analytical") == 0)
+                {
+                    marss_mem_model = MEM_MODEL_ANALYTICAL;
+                }
                 else
                 {
                     fprintf(stderr, "unknown sim-mem-model type, see help\n");
@@ -764,6 +815,65 @@ int main(int argc, char **argv)
             case 15: /* sim-stop-after-icount */
                 marss_sim_emulate_after_icount = strtoll(optarg, NULL, 10);
                 break;
+            case 16: /* sim-sweep-file */
+                sim_sweep_file = optarg;
+                break;
+            case 17: /* sim-sweep-jobs */
+                sim_sweep_jobs = strtol(optarg, NULL, 10);
+                break;
+            case 18: /* sim-lockstep-file */
+                sim_lockstep_file = optarg;
+                break;
+            case 19: /* sim-pipe-trace */
+                marss_do_pipe_trace = TRUE;
+                break;
+            case 20: /* sim-pipe-trace-cycles */
+                if (sscanf(optarg, "%" SCNu64 ":%" SCNu64, &pipe_trace_range[0],
+                           &pipe_trace_range[1]) != 2) {
+                    fprintf(stderr, "invalid sim-pipe-trace-cycles range, see help\n");
+                    exit(1);
+                }
+                break;
+            case 21: /* sim-pipe-trace-pc */
+                if (sscanf(optarg, "%" SCNx64 ":%" SCNx64, &pipe_trace_range[2],
+                           &pipe_trace_range[3]) != 2) {
+                    fprintf(stderr, "invalid sim-pipe-trace-pc range, see help\n");
+                    exit(1);
+                }
+                break;
+            case 22: /* sim-profile */
+                marss_do_profile = TRUE;
+                break;
+            case 23: /* sim-profile-symbols */
+                marss_do_profile = TRUE;
+                sim_profile_symbols = optarg;
+                break;
+            case 24: /* sim-roi */
+                marss_roi_filter = ROI_FILTER_MARKER;
+                break;
+            case 25: /* sim-roi-asid */
+                marss_roi_filter = ROI_FILTER_ASID;
+                marss_roi_asid = strtoull(optarg, NULL, 0);
+                break;
+            case 26: /* sim-stats-export */
+                marss_do_stats_export = TRUE;
+                break;
+            case 27: /* sim-stats-export-interval */
+                marss_do_stats_export = TRUE;
+                marss_stats_export_interval = strtoull(optarg, NULL, 0);
+                break;
+            case 28: /* sim-host-profile */
+                marss_do_host_profile = TRUE;
+                break;
+            case 29: /* sim-elf */
+                sim_elf_file = optarg;
+                break;
+            case 30: /* ram-file */
+                ram_file = optarg;
+                break;
+            case 31: /* ram-huge-pages */
+                ram_huge_pages = TRUE;
+                break;
             default:
                 fprintf(stderr, "unknown option index: %d\n", option_index);
                 exit(1);
@@ -795,6 +905,17 @@ int main(int argc, char **argv)
     p->sim_params->flush_sim_mem_on_simstart = marss_flush_sim_mem_on_simstart;
     p->sim_params->flush_bpu_on_simstart = marss_flush_bpu_on_simstart;
     p->sim_params->do_sim_trace = marss_do_sim_trace;
+    p->sim_params->do_pipe_trace = marss_do_pipe_trace;
+    p->sim_params->pipe_trace_start_cycle = pipe_trace_range[0];
+    p->sim_params->pipe_trace_end_cycle = pipe_trace_range[1];
+    p->sim_params->pipe_trace_start_pc = pipe_trace_range[2];
+    p->sim_params->pipe_trace_end_pc = pipe_trace_range[3];
+    p->sim_params->do_profile = marss_do_profile;
+    p->sim_params->roi_filter = marss_roi_filter;
+    p->sim_params->roi_asid = marss_roi_asid;
+    p->sim_params->do_stats_export = marss_do_stats_export;
+    p->sim_params->stats_export_interval = marss_stats_export_interval;
+    p->sim_params->do_host_profile = marss_do_host_profile;
     p->sim_params->sim_emulate_after_icount = marss_sim_emulate_after_icount;
     p->sim_params->dram_model_type = marss_mem_model;
 
@@ -813,6 +934,36 @@ int main(int argc, char **argv)
         p->sim_params->sim_stats_shm_name = strdup(sim_stats_shm_name);
     }
 
+    p->sim_params->cfg_file = strdup(path);
+    p->sim_params->drives_rw = (drive_mode == BF_MODE_RW);
+    if (sim_sweep_file) {
+        /* the children of a sweep share the disk images with the parent */
+        if (drive_mode == BF_MODE_RW) {
+            fprintf(stderr, "-sim-sweep-file cannot be used with -rw\n");
+            exit(1);
+        }
+        p->sim_params->sweep_file = strdup(sim_sweep_file);
+        p->sim_params->sweep_jobs = sim_sweep_jobs;
+    }
+
+    if (sim_lockstep_file) {
+        p->sim_params->lockstep_file = strdup(sim_lockstep_file);
+    }
+
+    if (sim_profile_symbols) {
+        p->sim_params->profile_symbol_file = strdup(sim_profile_symbols);
+    }
+
+    if (sim_elf_file) {
+        /* the boot files are looked up relative to the config file */
+        p->sim_params->elf_file = realpath(sim_elf_file, NULL);
+        if (!p->sim_params->elf_file) {
+            fprintf(stderr, "cannot open %s: %s\n", sim_elf_file,
+                    strerror(errno));
+            exit(1);
+        }
+    }
+
     /* Create the log-file full name */
     strcpy(sim_log_file_name, p->sim_params->sim_file_path);
     strcat(sim_log_file_name, "/");
@@ -847,6 +998,9 @@ int main(int argc, char **argv)
     if (ram_size > 0) {
         p->ram_size = (uint64_t)ram_size << 20;
     }
+    if (ram_file)
+        p->ram_file = strdup(ram_file);
+    p->ram_huge_pages = ram_huge_pages;
     if (accel_enable != -1)
         p->accel_enable = accel_enable;
     if (cmdline) {